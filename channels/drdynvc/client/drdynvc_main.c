@@ -802,6 +802,74 @@ static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
 	}
 }
 
+/**
+ * Send data as DATA_FIRST_COMPRESSED/DATA_COMPRESSED PDUs.
+ * The send history is shared by all channels, so the PDUs are queued in the
+ * order they were compressed.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_write_data_compressed(drdynvcPlugin* drdynvc, UINT32 ChannelId,
+                                          const BYTE* data, UINT32 dataSize)
+{
+	UINT status = CHANNEL_RC_OK;
+	const UINT32 totalSize = dataSize;
+	const BOOL fragmented = dataSize > DRDYNVC_COMPRESSED_MAX_SIZE;
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+
+	EnterCriticalSection(&drdynvc->zgfxLock);
+
+	/* Disconnected, the data is dropped as drdynvc_send would do */
+	if (!drdynvc->zgfxOut)
+		goto out;
+
+	while ((status == CHANNEL_RC_OK) && (dataSize > 0))
+	{
+		size_t pos;
+		BYTE Cmd = DATA_COMPRESSED_PDU;
+		UINT8 cbChId;
+		UINT8 cbLen = 0;
+		const UINT32 chunkLength = MIN(dataSize, DRDYNVC_COMPRESSED_MAX_SIZE);
+		wStream* data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
+
+		if (!data_out)
+		{
+			WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
+			status = CHANNEL_RC_NO_MEMORY;
+			goto out;
+		}
+
+		Stream_SetPosition(data_out, 1);
+		cbChId = drdynvc_write_variable_uint(data_out, ChannelId);
+
+		if (fragmented && (dataSize == totalSize))
+		{
+			Cmd = DATA_FIRST_COMPRESSED_PDU;
+			cbLen = drdynvc_write_variable_uint(data_out, totalSize);
+		}
+
+		if (!zgfx_compress_segment_to_stream(drdynvc->zgfxOut, data_out, data, chunkLength))
+		{
+			WLog_Print(drdynvc->log, WLOG_ERROR, "zgfx_compress_segment_to_stream failed!");
+			Stream_Release(data_out);
+			status = ERROR_INTERNAL_ERROR;
+			goto out;
+		}
+
+		pos = Stream_GetPosition(data_out);
+		Stream_SetPosition(data_out, 0);
+		Stream_Write_UINT8(data_out, (Cmd << 4) | cbChId | (cbLen << 2));
+		Stream_SetPosition(data_out, pos);
+		data += chunkLength;
+		dataSize -= chunkLength;
+		status = drdynvc_send(drdynvc, data_out);
+	}
+
+out:
+	LeaveCriticalSection(&drdynvc->zgfxLock);
+	return status;
+}
+
 /**
  * Function description
  *
@@ -825,6 +893,13 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 
 	WLog_Print(drdynvc->log, WLOG_TRACE, "write_data: ChannelId=%" PRIu32 " size=%" PRIu32 "",
 	           ChannelId, dataSize);
+
+	if (drdynvc->compress && (dataSize > 0))
+	{
+		status = drdynvc_write_data_compressed(drdynvc, ChannelId, data, dataSize);
+		goto out;
+	}
+
 	data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
 
 	if (!data_out)
@@ -892,6 +967,7 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 		}
 	}
 
+out:
 	if (status != CHANNEL_RC_OK)
 	{
 		WLog_Print(drdynvc->log, WLOG_ERROR, "VirtualChannelWriteEx failed with %s [%08" PRIX32 "]",
@@ -973,6 +1049,8 @@ static UINT drdynvc_process_capability_request(drdynvcPlugin* drdynvc, int Sp, i
 		Stream_Read_UINT16(s, drdynvc->PriorityCharge3);
 	}
 
+	/* Version 3 allows compressed data, our response accepts the offered version */
+	drdynvc->compress = (drdynvc->version >= 3) && drdynvc->zgfxOut;
 	status = drdynvc_send_capability_response(drdynvc);
 	drdynvc->state = DRDYNVC_STATE_READY;
 	return status;
@@ -1178,6 +1256,72 @@ static UINT drdynvc_process_data(drdynvcPlugin* drdynvc, int Sp, int cbChId, wSt
 	return status;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_process_data_compressed(drdynvcPlugin* drdynvc, int Sp, int cbChId,
+                                            wStream* s, UINT32 ThreadingFlags, BOOL first)
+{
+	UINT status = CHANNEL_RC_OK;
+	UINT32 Length = 0;
+	UINT32 ChannelId;
+	wStream* data;
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+
+	if (!Stream_CheckAndLogRequiredLength(
+	        TAG, s, drdynvc_cblen_to_bytes(cbChId) + (first ? drdynvc_cblen_to_bytes(Sp) : 0)))
+		return ERROR_INVALID_DATA;
+
+	ChannelId = drdynvc_read_variable_uint(s, cbChId);
+
+	if (first)
+		Length = drdynvc_read_variable_uint(s, Sp);
+
+	WLog_Print(drdynvc->log, WLOG_TRACE,
+	           "process_data_compressed: Sp=%d cbChId=%d, ChannelId=%" PRIu32 " Length=%" PRIu32 "",
+	           Sp, cbChId, ChannelId, Length);
+
+	if (!drdynvc->zgfxIn)
+		return ERROR_INVALID_DATA;
+
+	data = StreamPool_Take(dvcman->pool, DRDYNVC_COMPRESSED_MAX_SIZE);
+
+	if (!data)
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	/* Always decompress, the history must be kept even for unknown channels */
+	if (!zgfx_decompress_segment_to_stream(drdynvc->zgfxIn, Stream_Pointer(s),
+	                                       (UINT32)Stream_GetRemainingLength(s), data))
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "zgfx_decompress_segment_to_stream failed!");
+		Stream_Release(data);
+		return ERROR_INVALID_DATA;
+	}
+
+	Stream_SealLength(data);
+	Stream_SetPosition(data, 0);
+
+	if (first)
+		status =
+		    dvcman_receive_channel_data_first(drdynvc, drdynvc->channel_mgr, ChannelId, Length);
+
+	if (status == CHANNEL_RC_OK)
+		status = dvcman_receive_channel_data(drdynvc, drdynvc->channel_mgr, ChannelId, data,
+		                                     ThreadingFlags);
+
+	Stream_Release(data);
+
+	if (status != CHANNEL_RC_OK)
+		status = dvcman_close_channel(drdynvc->channel_mgr, ChannelId, TRUE);
+
+	return status;
+}
+
 /**
  * Function description
  *
@@ -1241,6 +1385,12 @@ static UINT drdynvc_order_recv(drdynvcPlugin* drdynvc, wStream* s, UINT32 Thread
 		case CLOSE_REQUEST_PDU:
 			return drdynvc_process_close_request(drdynvc, Sp, cbChId, s);
 
+		case DATA_FIRST_COMPRESSED_PDU:
+			return drdynvc_process_data_compressed(drdynvc, Sp, cbChId, s, ThreadingFlags, TRUE);
+
+		case DATA_COMPRESSED_PDU:
+			return drdynvc_process_data_compressed(drdynvc, Sp, cbChId, s, ThreadingFlags, FALSE);
+
 		default:
 			WLog_Print(drdynvc->log, WLOG_ERROR, "unknown drdynvc cmd 0x%x", Cmd);
 			return ERROR_INTERNAL_ERROR;
@@ -1485,6 +1635,51 @@ error:
  *
  * @return 0 on success, otherwise a Win32 error code
  */
+static void drdynvc_compression_free(drdynvcPlugin* drdynvc)
+{
+	EnterCriticalSection(&drdynvc->zgfxLock);
+	drdynvc->compress = FALSE;
+	zgfx_context_free(drdynvc->zgfxOut);
+	drdynvc->zgfxOut = NULL;
+	LeaveCriticalSection(&drdynvc->zgfxLock);
+
+	zgfx_context_free(drdynvc->zgfxIn);
+	drdynvc->zgfxIn = NULL;
+}
+
+/**
+ * Creates the compression histories of a new connection, received data is always
+ * decompressed while data is only sent compressed if enabled in the settings.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_compression_init(drdynvcPlugin* drdynvc, rdpSettings* settings)
+{
+	drdynvc_compression_free(drdynvc);
+	drdynvc->zgfxIn = zgfx_context_new_ex(FALSE, DRDYNVC_COMPRESSION_HISTORY_SIZE);
+
+	if (!drdynvc->zgfxIn)
+		goto fail;
+
+	if (freerdp_settings_get_bool(settings, FreeRDP_DynamicChannelCompression))
+	{
+		ZGFX_CONTEXT* zgfxOut = zgfx_context_new_ex(TRUE, DRDYNVC_COMPRESSION_HISTORY_SIZE);
+
+		if (!zgfxOut)
+			goto fail;
+
+		EnterCriticalSection(&drdynvc->zgfxLock);
+		drdynvc->zgfxOut = zgfxOut;
+		LeaveCriticalSection(&drdynvc->zgfxLock);
+	}
+
+	return CHANNEL_RC_OK;
+fail:
+	WLog_Print(drdynvc->log, WLOG_ERROR, "zgfx_context_new_ex failed!");
+	drdynvc_compression_free(drdynvc);
+	return CHANNEL_RC_NO_MEMORY;
+}
+
 static UINT drdynvc_virtual_channel_event_connected(drdynvcPlugin* drdynvc, LPVOID pData,
                                                     UINT32 dataLength)
 {
@@ -1532,6 +1727,9 @@ static UINT drdynvc_virtual_channel_event_connected(drdynvcPlugin* drdynvc, LPVO
 		goto error;
 	}
 
+	if ((error = drdynvc_compression_init(drdynvc, settings)))
+		goto error;
+
 	drdynvc->state = DRDYNVC_STATE_CAPABILITIES;
 
 	if (!(drdynvc->thread = CreateThread(NULL, 0, drdynvc_virtual_channel_client_thread,
@@ -1600,6 +1798,7 @@ static UINT drdynvc_virtual_channel_event_disconnected(drdynvcPlugin* drdynvc)
 	if (drdynvc->queue)
 		MessageQueue_Clear(drdynvc->queue);
 	drdynvc->OpenHandle = 0;
+	drdynvc_compression_free(drdynvc);
 
 	if (drdynvc->data_in)
 	{
@@ -1629,6 +1828,8 @@ static UINT drdynvc_virtual_channel_event_terminated(drdynvcPlugin* drdynvc)
 		drdynvc->channel_mgr = NULL;
 	}
 	drdynvc->InitHandle = 0;
+	drdynvc_compression_free(drdynvc);
+	DeleteCriticalSection(&drdynvc->zgfxLock);
 	free(drdynvc->context);
 	free(drdynvc);
 	return CHANNEL_RC_OK;
@@ -1799,6 +2000,7 @@ BOOL VCAPITYPE VirtualChannelEntryEx(PCHANNEL_ENTRY_POINTS_EX pEntryPoints, PVOI
 	sprintf_s(drdynvc->channelDef.name, ARRAYSIZE(drdynvc->channelDef.name),
 	          DRDYNVC_SVC_CHANNEL_NAME);
 	drdynvc->state = DRDYNVC_STATE_INITIAL;
+	InitializeCriticalSection(&drdynvc->zgfxLock);
 	pEntryPointsEx = (CHANNEL_ENTRY_POINTS_FREERDP_EX*)pEntryPoints;
 
 	if ((pEntryPointsEx->cbSize >= sizeof(CHANNEL_ENTRY_POINTS_FREERDP_EX)) &&
@@ -1809,6 +2011,7 @@ BOOL VCAPITYPE VirtualChannelEntryEx(PCHANNEL_ENTRY_POINTS_EX pEntryPoints, PVOI
 		if (!context)
 		{
 			WLog_Print(drdynvc->log, WLOG_ERROR, "calloc failed!");
+			DeleteCriticalSection(&drdynvc->zgfxLock);
 			free(drdynvc);
 			return FALSE;
 		}
@@ -1835,6 +2038,7 @@ BOOL VCAPITYPE VirtualChannelEntryEx(PCHANNEL_ENTRY_POINTS_EX pEntryPoints, PVOI
 	{
 		WLog_Print(drdynvc->log, WLOG_ERROR, "pVirtualChannelInit failed with %s [%08" PRIX32 "]",
 		           WTSErrorToString(rc), rc);
+		DeleteCriticalSection(&drdynvc->zgfxLock);
 		free(drdynvc->context);
 		free(drdynvc);
 		return FALSE;
@@ -33,6 +33,7 @@
 #include <freerdp/addin.h>
 #include <freerdp/channels/log.h>
 #include <freerdp/client/drdynvc.h>
+#include <freerdp/codec/zgfx.h>
 #include <freerdp/freerdp.h>
 
 typedef struct drdynvc_plugin drdynvcPlugin;
@@ -118,6 +119,12 @@ struct drdynvc_plugin
 	int PriorityCharge3;
 	rdpContext* rdpcontext;
 
+	/* Compression history per direction, shared by all channels */
+	BOOL compress;
+	ZGFX_CONTEXT* zgfxIn;
+	ZGFX_CONTEXT* zgfxOut;
+	CRITICAL_SECTION zgfxLock;
+
 	IWTSVirtualChannelManager* channel_mgr;
 };
 
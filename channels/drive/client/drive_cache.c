@@ -0,0 +1,668 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/string.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#endif
+
+#include <freerdp/channels/log.h>
+
+#include "drive_cache.h"
+
+#define TAG CHANNELS_TAG("drive.client")
+
+/* Limits that keep the memory and the number of inotify watches bounded, the whole
+ * cache is flushed once one is exceeded. */
+#define DRIVE_CACHE_MAX_DIRS 256
+#define DRIVE_CACHE_MAX_ENTRIES 65536
+
+/* Larger listings are still served, but not kept */
+#define DRIVE_CACHE_MAX_LISTING 4096
+
+/* Entries of a directory are dropped after this many ms, bounds how long changes that
+ * inotify does not report stay unseen */
+#define DRIVE_CACHE_MAX_AGE 1000
+
+DRIVE_DIR_LISTING* drive_dir_listing_new(void)
+{
+	DRIVE_DIR_LISTING* listing = (DRIVE_DIR_LISTING*)calloc(1, sizeof(DRIVE_DIR_LISTING));
+
+	if (!listing)
+		return NULL;
+
+	listing->refs = 1;
+	listing->error = ERROR_NO_MORE_FILES;
+	return listing;
+}
+
+BOOL drive_dir_listing_append(DRIVE_DIR_LISTING* listing, const WIN32_FIND_DATAW* data)
+{
+	WINPR_ASSERT(listing);
+	WINPR_ASSERT(data);
+
+	if (listing->count >= DRIVE_CACHE_MAX_LISTING)
+		return FALSE;
+
+	if (listing->count == listing->capacity)
+	{
+		const size_t capacity = listing->capacity ? listing->capacity * 2 : 32;
+		WIN32_FIND_DATAW* tmp = (WIN32_FIND_DATAW*)realloc(
+		    listing->entries, capacity * sizeof(WIN32_FIND_DATAW));
+
+		if (!tmp)
+			return FALSE;
+
+		listing->entries = tmp;
+		listing->capacity = capacity;
+	}
+
+	listing->entries[listing->count++] = *data;
+	return TRUE;
+}
+
+void drive_dir_listing_release(DRIVE_DIR_LISTING* listing)
+{
+	if (!listing)
+		return;
+
+	if (InterlockedDecrement(&listing->refs) > 0)
+		return;
+
+	free(listing->entries);
+	free(listing);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+#define DRIVE_CACHE_WATCH_MASK                                                            \
+	(IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+	 IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+/* File systems changed by other hosts or user space, inotify does not see these changes */
+static const long drive_cache_remote_fs[] = {
+	0x6969,     /* NFS */
+	0x517B,     /* SMB */
+	0xFE534D42, /* SMB2 */
+	0xFF534D42, /* CIFS */
+	0x65735546, /* FUSE */
+	0x01021997, /* 9P */
+	0x00C36400, /* Ceph */
+	0x5346414F, /* AFS */
+	0x73757245, /* Coda */
+	0x564C      /* NCP */
+};
+
+typedef struct
+{
+	int wd;
+	UINT64 filled;
+	size_t entries;
+	wHashTable* infos;    /* file name -> BY_HANDLE_FILE_INFORMATION */
+	wHashTable* listings; /* search pattern -> DRIVE_DIR_LISTING */
+} DRIVE_CACHE_DIR;
+
+struct S_DRIVE_CACHE
+{
+	CRITICAL_SECTION lock;
+	int fd;
+	UINT64 generation;
+	size_t entries;
+	wHashTable* dirs;    /* directory path -> DRIVE_CACHE_DIR */
+	wHashTable* watches; /* watch descriptor -> DRIVE_CACHE_DIR */
+
+	UINT64 infoHits;
+	UINT64 infoMisses;
+	UINT64 listingHits;
+	UINT64 listingMisses;
+};
+
+static UINT32 drive_cache_wstr_hash(const void* key)
+{
+	const WCHAR* str = (const WCHAR*)key;
+	UINT32 hash = 5381;
+
+	while (*str)
+		hash = (hash * 33) ^ *str++;
+
+	return hash;
+}
+
+static BOOL drive_cache_wstr_equals(const void* a, const void* b)
+{
+	return _wcscmp((const WCHAR*)a, (const WCHAR*)b) == 0;
+}
+
+static void* drive_cache_wstr_clone(const void* str)
+{
+	return _wcsdup((const WCHAR*)str);
+}
+
+static void drive_cache_listing_free(void* obj)
+{
+	drive_dir_listing_release((DRIVE_DIR_LISTING*)obj);
+}
+
+static wHashTable* drive_cache_table_new(OBJECT_FREE_FN valueFree)
+{
+	wObject* obj;
+	wHashTable* table = HashTable_New(FALSE);
+
+	if (!table)
+		return NULL;
+
+	if (!HashTable_SetHashFunction(table, drive_cache_wstr_hash))
+	{
+		HashTable_Free(table);
+		return NULL;
+	}
+
+	obj = HashTable_KeyObject(table);
+	obj->fnObjectEquals = drive_cache_wstr_equals;
+	obj->fnObjectNew = drive_cache_wstr_clone;
+	obj->fnObjectFree = free;
+	HashTable_ValueObject(table)->fnObjectFree = valueFree;
+	return table;
+}
+
+static void drive_cache_dir_free(void* obj)
+{
+	DRIVE_CACHE_DIR* dir = (DRIVE_CACHE_DIR*)obj;
+
+	if (!dir)
+		return;
+
+	HashTable_Free(dir->infos);
+	HashTable_Free(dir->listings);
+	free(dir);
+}
+
+static BOOL drive_cache_dir_unwatch(const void* key, void* value, void* arg)
+{
+	DRIVE_CACHE* cache = (DRIVE_CACHE*)arg;
+	DRIVE_CACHE_DIR* dir = (DRIVE_CACHE_DIR*)value;
+
+	WINPR_UNUSED(key);
+	inotify_rm_watch(cache->fd, dir->wd);
+	return TRUE;
+}
+
+static void drive_cache_flush(DRIVE_CACHE* cache)
+{
+	HashTable_Foreach(cache->dirs, drive_cache_dir_unwatch, cache);
+	HashTable_Clear(cache->watches);
+	HashTable_Clear(cache->dirs);
+	cache->entries = 0;
+	cache->generation++;
+}
+
+static void drive_cache_dir_clear(DRIVE_CACHE* cache, DRIVE_CACHE_DIR* dir)
+{
+	HashTable_Clear(dir->infos);
+	HashTable_Clear(dir->listings);
+	cache->entries -= dir->entries;
+	dir->entries = 0;
+	cache->generation++;
+}
+
+/* Applies all pending inotify events, called with the lock held */
+static void drive_cache_process_events(DRIVE_CACHE* cache)
+{
+	union
+	{
+		struct inotify_event event;
+		char buffer[4096];
+	} events;
+
+	while (1)
+	{
+		ssize_t offset = 0;
+		const ssize_t length = read(cache->fd, events.buffer, sizeof(events.buffer));
+
+		if (length <= 0)
+			break;
+
+		while (offset < length)
+		{
+			const struct inotify_event* event =
+			    (const struct inotify_event*)&events.buffer[offset];
+			DRIVE_CACHE_DIR* dir;
+
+			offset += (ssize_t)(sizeof(struct inotify_event) + event->len);
+
+			/* Subdirectories moved or deleted, cached paths below them are gone as well */
+			if ((event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF)) ||
+			    ((event->mask & IN_ISDIR) && (event->mask & (IN_MOVED_FROM | IN_DELETE))))
+			{
+				drive_cache_flush(cache);
+				continue;
+			}
+
+			dir = (DRIVE_CACHE_DIR*)HashTable_GetItemValue(cache->watches,
+			                                               (void*)(size_t)event->wd);
+
+			if (dir)
+				drive_cache_dir_clear(cache, dir);
+		}
+	}
+}
+
+static BOOL drive_cache_is_remote(const char* path)
+{
+	size_t index;
+	struct statfs fs = { 0 };
+
+	/* Unknown, do not trust inotify either */
+	if (statfs(path, &fs) != 0)
+		return TRUE;
+
+	for (index = 0; index < ARRAYSIZE(drive_cache_remote_fs); index++)
+	{
+		if ((long)fs.f_type == drive_cache_remote_fs[index])
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static DRIVE_CACHE_DIR* drive_cache_dir_get(DRIVE_CACHE* cache, const WCHAR* path, BOOL create)
+{
+	int wd;
+	char* utf8 = NULL;
+	DRIVE_CACHE_DIR* dir = (DRIVE_CACHE_DIR*)HashTable_GetItemValue(cache->dirs, path);
+
+	if (dir || !create)
+		return dir;
+
+	if (HashTable_Count(cache->dirs) >= DRIVE_CACHE_MAX_DIRS)
+		drive_cache_flush(cache);
+
+	if (ConvertFromUnicode(CP_UTF8, 0, path, -1, &utf8, 0, NULL, NULL) <= 0)
+		return NULL;
+
+	if (drive_cache_is_remote(utf8))
+	{
+		free(utf8);
+		return NULL;
+	}
+
+	wd = inotify_add_watch(cache->fd, utf8, DRIVE_CACHE_WATCH_MASK);
+	free(utf8);
+
+	if (wd < 0)
+		return NULL;
+
+	/* The directory is already watched under another name (e.g. through a symlink) */
+	if (HashTable_Contains(cache->watches, (void*)(size_t)wd))
+		return NULL;
+
+	dir = (DRIVE_CACHE_DIR*)calloc(1, sizeof(DRIVE_CACHE_DIR));
+
+	if (!dir)
+		goto fail;
+
+	dir->wd = wd;
+	dir->filled = GetTickCount64();
+	dir->infos = drive_cache_table_new(free);
+	dir->listings = drive_cache_table_new(drive_cache_listing_free);
+
+	if (!dir->infos || !dir->listings)
+		goto fail;
+
+	if (!HashTable_Insert(cache->dirs, path, dir))
+		goto fail;
+
+	if (!HashTable_Insert(cache->watches, (void*)(size_t)wd, dir))
+	{
+		/* frees dir */
+		HashTable_Remove(cache->dirs, path);
+		inotify_rm_watch(cache->fd, wd);
+		return NULL;
+	}
+
+	return dir;
+fail:
+	drive_cache_dir_free(dir);
+	inotify_rm_watch(cache->fd, wd);
+	return NULL;
+}
+
+/* Splits path at the last separator, the directory part is returned in newly allocated memory */
+static WCHAR* drive_cache_split(const WCHAR* path, const WCHAR** name)
+{
+	size_t length;
+	WCHAR* dirpath;
+	const WCHAR* sep = _wcsrchr(path, L'/');
+
+	if (!sep)
+		return NULL;
+
+	/* keep the separator of the root directory */
+	length = (sep == path) ? 1 : (size_t)(sep - path);
+	dirpath = (WCHAR*)calloc(length + 1, sizeof(WCHAR));
+
+	if (!dirpath)
+		return NULL;
+
+	memcpy(dirpath, path, length * sizeof(WCHAR));
+	*name = sep + 1;
+	return dirpath;
+}
+
+/* Looks up the directory of path, on a miss the directory is watched and a ticket issued */
+static DRIVE_CACHE_DIR* drive_cache_lookup(DRIVE_CACHE* cache, const WCHAR* path,
+                                           const WCHAR** name, UINT64* ticket)
+{
+	DRIVE_CACHE_DIR* dir;
+	WCHAR* dirpath = drive_cache_split(path, name);
+
+	*ticket = 0;
+
+	if (!dirpath)
+		return NULL;
+
+	drive_cache_process_events(cache);
+	dir = drive_cache_dir_get(cache, dirpath, TRUE);
+	free(dirpath);
+
+	if (dir)
+	{
+		const UINT64 now = GetTickCount64();
+
+		if (now - dir->filled > DRIVE_CACHE_MAX_AGE)
+		{
+			drive_cache_dir_clear(cache, dir);
+			dir->filled = now;
+		}
+	}
+
+	/* Changes from now on invalidate whatever the caller is about to read */
+	if (dir)
+		*ticket = cache->generation + 1;
+
+	return dir;
+}
+
+/* Returns the directory to store an entry in, NULL if the ticket is outdated */
+static DRIVE_CACHE_DIR* drive_cache_store(DRIVE_CACHE* cache, const WCHAR* path,
+                                          const WCHAR** name, UINT64 ticket, size_t entries)
+{
+	DRIVE_CACHE_DIR* dir;
+	WCHAR* dirpath;
+
+	if (ticket == 0)
+		return NULL;
+
+	drive_cache_process_events(cache);
+
+	if (ticket != cache->generation + 1)
+		return NULL;
+
+	if (cache->entries + entries > DRIVE_CACHE_MAX_ENTRIES)
+	{
+		drive_cache_flush(cache);
+		return NULL;
+	}
+
+	if (!(dirpath = drive_cache_split(path, name)))
+		return NULL;
+
+	dir = drive_cache_dir_get(cache, dirpath, FALSE);
+	free(dirpath);
+	return dir;
+}
+
+DRIVE_CACHE* drive_cache_new(void)
+{
+	DRIVE_CACHE* cache = (DRIVE_CACHE*)calloc(1, sizeof(DRIVE_CACHE));
+
+	if (!cache)
+		return NULL;
+
+	cache->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (cache->fd < 0)
+	{
+		WLog_WARN(TAG, "inotify_init1 failed with %s, metadata cache disabled", strerror(errno));
+		free(cache);
+		return NULL;
+	}
+
+	if (!InitializeCriticalSectionAndSpinCount(&cache->lock, 4000))
+	{
+		close(cache->fd);
+		free(cache);
+		return NULL;
+	}
+
+	cache->dirs = drive_cache_table_new(drive_cache_dir_free);
+	cache->watches = HashTable_New(FALSE);
+
+	if (!cache->dirs || !cache->watches)
+	{
+		drive_cache_free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+void drive_cache_free(DRIVE_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+	WLog_DBG(TAG,
+	         "metadata cache: information %" PRIu64 " hits, %" PRIu64 " misses; "
+	         "listings %" PRIu64 " hits, %" PRIu64 " misses",
+	         cache->infoHits, cache->infoMisses, cache->listingHits, cache->listingMisses);
+
+	HashTable_Free(cache->watches);
+	HashTable_Free(cache->dirs);
+	close(cache->fd);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
+
+BOOL drive_cache_get_info(DRIVE_CACHE* cache, const WCHAR* path, BY_HANDLE_FILE_INFORMATION* info,
+                          UINT64* ticket)
+{
+	const WCHAR* name = NULL;
+	DRIVE_CACHE_DIR* dir;
+	const BY_HANDLE_FILE_INFORMATION* cached = NULL;
+
+	WINPR_ASSERT(info);
+	WINPR_ASSERT(ticket);
+	*ticket = 0;
+
+	if (!cache || !path)
+		return FALSE;
+
+	EnterCriticalSection(&cache->lock);
+
+	if ((dir = drive_cache_lookup(cache, path, &name, ticket)))
+		cached = (const BY_HANDLE_FILE_INFORMATION*)HashTable_GetItemValue(dir->infos, name);
+
+	if (cached)
+	{
+		*info = *cached;
+		*ticket = 0;
+		cache->infoHits++;
+	}
+	else
+		cache->infoMisses++;
+
+	LeaveCriticalSection(&cache->lock);
+	return cached != NULL;
+}
+
+void drive_cache_put_info(DRIVE_CACHE* cache, const WCHAR* path,
+                          const BY_HANDLE_FILE_INFORMATION* info, UINT64 ticket)
+{
+	const WCHAR* name = NULL;
+	DRIVE_CACHE_DIR* dir;
+	BY_HANDLE_FILE_INFORMATION* copy;
+
+	if (!cache || !path || !info)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	dir = drive_cache_store(cache, path, &name, ticket, 1);
+
+	if (!dir || HashTable_Contains(dir->infos, name))
+		goto out;
+
+	if (!(copy = (BY_HANDLE_FILE_INFORMATION*)malloc(sizeof(BY_HANDLE_FILE_INFORMATION))))
+		goto out;
+
+	*copy = *info;
+
+	if (!HashTable_Insert(dir->infos, name, copy))
+	{
+		free(copy);
+		goto out;
+	}
+
+	dir->entries++;
+	cache->entries++;
+out:
+	LeaveCriticalSection(&cache->lock);
+}
+
+DRIVE_DIR_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern,
+                                           UINT64* ticket)
+{
+	const WCHAR* name = NULL;
+	DRIVE_CACHE_DIR* dir;
+	DRIVE_DIR_LISTING* listing = NULL;
+
+	WINPR_ASSERT(ticket);
+	*ticket = 0;
+
+	if (!cache || !pattern)
+		return NULL;
+
+	EnterCriticalSection(&cache->lock);
+
+	if ((dir = drive_cache_lookup(cache, pattern, &name, ticket)))
+		listing = (DRIVE_DIR_LISTING*)HashTable_GetItemValue(dir->listings, pattern);
+
+	if (listing)
+	{
+		InterlockedIncrement(&listing->refs);
+		*ticket = 0;
+		cache->listingHits++;
+	}
+	else
+		cache->listingMisses++;
+
+	LeaveCriticalSection(&cache->lock);
+	return listing;
+}
+
+void drive_cache_put_listing(DRIVE_CACHE* cache, const WCHAR* pattern, DRIVE_DIR_LISTING* listing,
+                             UINT64 ticket)
+{
+	const WCHAR* name = NULL;
+	DRIVE_CACHE_DIR* dir;
+
+	if (!cache || !pattern || !listing)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	dir = drive_cache_store(cache, pattern, &name, ticket, listing->count + 1);
+
+	if (!dir || HashTable_Contains(dir->listings, pattern))
+		goto out;
+
+	InterlockedIncrement(&listing->refs);
+
+	if (!HashTable_Insert(dir->listings, pattern, listing))
+	{
+		drive_dir_listing_release(listing);
+		goto out;
+	}
+
+	dir->entries += listing->count + 1;
+	cache->entries += listing->count + 1;
+out:
+	LeaveCriticalSection(&cache->lock);
+}
+
+#else
+
+DRIVE_CACHE* drive_cache_new(void)
+{
+	return NULL;
+}
+
+void drive_cache_free(DRIVE_CACHE* cache)
+{
+	WINPR_UNUSED(cache);
+}
+
+BOOL drive_cache_get_info(DRIVE_CACHE* cache, const WCHAR* path, BY_HANDLE_FILE_INFORMATION* info,
+                          UINT64* ticket)
+{
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(path);
+	WINPR_UNUSED(info);
+	*ticket = 0;
+	return FALSE;
+}
+
+void drive_cache_put_info(DRIVE_CACHE* cache, const WCHAR* path,
+                          const BY_HANDLE_FILE_INFORMATION* info, UINT64 ticket)
+{
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(path);
+	WINPR_UNUSED(info);
+	WINPR_UNUSED(ticket);
+}
+
+DRIVE_DIR_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern,
+                                           UINT64* ticket)
+{
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(pattern);
+	*ticket = 0;
+	return NULL;
+}
+
+void drive_cache_put_listing(DRIVE_CACHE* cache, const WCHAR* pattern, DRIVE_DIR_LISTING* listing,
+                             UINT64 ticket)
+{
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(pattern);
+	WINPR_UNUSED(listing);
+	WINPR_UNUSED(ticket);
+}
+
+#endif
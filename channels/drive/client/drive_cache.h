@@ -0,0 +1,69 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+#define FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/file.h>
+
+/*
+ * Per drive cache of file information and directory listings.
+ *
+ * Every cached directory is watched with inotify, any change inside it drops all
+ * entries of that directory. Pending events are applied before each lookup, so
+ * changes made through the drive itself are never answered from a stale entry.
+ * Directories on network and FUSE file systems, where inotify misses changes made
+ * elsewhere, are not cached, and no entry is kept for longer than a second.
+ * Without inotify support drive_cache_new returns NULL and all functions below
+ * treat a NULL cache as always empty.
+ *
+ * A lookup that misses returns a ticket that has to be passed to the matching put
+ * function. Entries are only stored if nothing changed since the ticket was taken.
+ */
+
+typedef struct S_DRIVE_CACHE DRIVE_CACHE;
+
+/* Entries found by FindFirstFileW/FindNextFileW and the error the enumeration ended with */
+typedef struct
+{
+	volatile LONG refs;
+	size_t count;
+	size_t capacity;
+	WIN32_FIND_DATAW* entries;
+	DWORD error;
+} DRIVE_DIR_LISTING;
+
+DRIVE_DIR_LISTING* drive_dir_listing_new(void);
+BOOL drive_dir_listing_append(DRIVE_DIR_LISTING* listing, const WIN32_FIND_DATAW* data);
+void drive_dir_listing_release(DRIVE_DIR_LISTING* listing);
+
+DRIVE_CACHE* drive_cache_new(void);
+void drive_cache_free(DRIVE_CACHE* cache);
+
+BOOL drive_cache_get_info(DRIVE_CACHE* cache, const WCHAR* path, BY_HANDLE_FILE_INFORMATION* info,
+                          UINT64* ticket);
+void drive_cache_put_info(DRIVE_CACHE* cache, const WCHAR* path,
+                          const BY_HANDLE_FILE_INFORMATION* info, UINT64 ticket);
+
+/* Returns a reference the caller has to release, pattern is the FindFirstFileW argument */
+DRIVE_DIR_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern,
+                                           UINT64* ticket);
+void drive_cache_put_listing(DRIVE_CACHE* cache, const WCHAR* pattern, DRIVE_DIR_LISTING* listing,
+                             UINT64 ticket);
+
+#endif /* FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H */
@@ -38,11 +38,20 @@
 #include <winpr/path.h>
 #include <winpr/file.h>
 #include <winpr/stream.h>
+#include <winpr/interlocked.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/channels/rdpdr.h>
 
 #include "drive_file.h"
 
+/* Read-ahead starts after this many reads that each continued where the last one ended */
+#define DRIVE_FILE_READ_AHEAD_MIN_SEQUENTIAL 2
+#define DRIVE_FILE_READ_AHEAD_SIZE (1024 * 1024)
+/* Changes made outside the session are only seen by reading the file again, so a
+ * read-ahead buffer is not used once it is older than this many ms */
+#define DRIVE_FILE_READ_AHEAD_MAX_AGE 250
+
 #ifdef WITH_DEBUG_RDPDR
 #define DEBUG_WSTR(msg, wstr)                                            \
 	do                                                                   \
@@ -403,6 +412,9 @@ BOOL drive_file_free(DRIVE_FILE* file)
 	rc = TRUE;
 fail:
 	DEBUG_WSTR("Free %s", file->fullpath);
+	drive_dir_listing_release(file->listing);
+	free(file->listing_pattern);
+	free(file->read_ahead);
 	free(file->fullpath);
 	free(file);
 	return rc;
@@ -419,7 +431,51 @@ BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset)
 		return FALSE;
 
 	loffset.QuadPart = (LONGLONG)Offset;
-	return SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN);
+
+	if (!SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN))
+		return FALSE;
+
+	file->offset = Offset;
+	return TRUE;
+}
+
+static BOOL drive_file_read_cached(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
+{
+	UINT64 skip;
+	UINT64 available;
+
+	if (!file->read_ahead || !file->write_generation)
+		return FALSE;
+
+	if ((*file->write_generation != file->read_ahead_generation) ||
+	    (GetTickCount64() - file->read_ahead_time > DRIVE_FILE_READ_AHEAD_MAX_AGE))
+	{
+		file->read_ahead_length = 0;
+		file->read_ahead_eof = FALSE;
+		return FALSE;
+	}
+
+	if (file->offset < file->read_ahead_offset)
+		return FALSE;
+
+	skip = file->offset - file->read_ahead_offset;
+
+	if (skip > file->read_ahead_length)
+		return FALSE;
+
+	available = file->read_ahead_length - skip;
+
+	/* A short answer is only correct if the buffer ends at the end of the file */
+	if (available < *Length)
+	{
+		if (!file->read_ahead_eof)
+			return FALSE;
+
+		*Length = (UINT32)available;
+	}
+
+	CopyMemory(buffer, &file->read_ahead[skip], *Length);
+	return TRUE;
 }
 
 BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
@@ -431,52 +487,138 @@ BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
 
 	DEBUG_WSTR("Read file %s", file->fullpath);
 
-	if (ReadFile(file->file_handle, buffer, *Length, &read, NULL))
+	if (file->offset == file->next_read)
+		file->sequential_reads++;
+	else
+		file->sequential_reads = 0;
+
+	/* Served from the buffer the file position is not advanced, every read and write
+	 * seeks to its offset first. */
+	if (drive_file_read_cached(file, buffer, Length))
+		read = *Length;
+	else if (!ReadFile(file->file_handle, buffer, *Length, &read, NULL))
+		return FALSE;
+
+	*Length = read;
+	file->offset += read;
+	file->next_read = file->offset;
+	return TRUE;
+}
+
+void drive_file_read_ahead(DRIVE_FILE* file)
+{
+	DWORD read = 0;
+	LONG generation;
+	LARGE_INTEGER loffset;
+
+	if (!file || file->is_dir || !file->write_generation)
+		return;
+
+	if ((file->sequential_reads < DRIVE_FILE_READ_AHEAD_MIN_SEQUENTIAL) ||
+	    (file->next_read > INT64_MAX))
+		return;
+
+	/* Taken before reading, a write racing with the read leaves the buffer stale */
+	generation = *file->write_generation;
+
+	if ((generation == file->read_ahead_generation) &&
+	    (file->next_read >= file->read_ahead_offset) &&
+	    (GetTickCount64() - file->read_ahead_time <= DRIVE_FILE_READ_AHEAD_MAX_AGE))
 	{
-		*Length = read;
-		return TRUE;
+		const UINT64 end = file->read_ahead_offset + file->read_ahead_length;
+
+		/* Still holds the end of the file or plenty of data for the next reads */
+		if (file->read_ahead_eof || (file->next_read + DRIVE_FILE_READ_AHEAD_SIZE / 2 <= end))
+			return;
 	}
 
-	return FALSE;
+	if (!file->read_ahead && !(file->read_ahead = (BYTE*)malloc(DRIVE_FILE_READ_AHEAD_SIZE)))
+		return;
+
+	file->read_ahead_length = 0;
+	file->read_ahead_eof = FALSE;
+	loffset.QuadPart = (LONGLONG)file->next_read;
+
+	if (!SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN) ||
+	    !ReadFile(file->file_handle, file->read_ahead, DRIVE_FILE_READ_AHEAD_SIZE, &read, NULL))
+		return;
+
+	file->read_ahead_offset = file->next_read;
+	file->read_ahead_length = read;
+	file->read_ahead_eof = read < DRIVE_FILE_READ_AHEAD_SIZE;
+	file->read_ahead_generation = generation;
+	file->read_ahead_time = GetTickCount64();
+}
+
+/**
+ * Called before and after every modification. A read-ahead that overlaps with the
+ * change took the generation before the second increment and is never current.
+ */
+static void drive_file_modified(DRIVE_FILE* file)
+{
+	if (file->write_generation)
+		InterlockedIncrement(file->write_generation);
 }
 
 BOOL drive_file_write(DRIVE_FILE* file, BYTE* buffer, UINT32 Length)
 {
 	DWORD written;
+	BOOL rc = TRUE;
 
 	if (!file || !buffer)
 		return FALSE;
 
 	DEBUG_WSTR("Write file %s", file->fullpath);
 
+	drive_file_modified(file);
+
 	while (Length > 0)
 	{
 		if (!WriteFile(file->file_handle, buffer, Length, &written, NULL))
-			return FALSE;
+		{
+			rc = FALSE;
+			break;
+		}
 
 		Length -= written;
 		buffer += written;
+		file->offset += written;
 	}
 
-	return TRUE;
+	drive_file_modified(file);
+	return rc;
 }
 
-BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
+static BOOL drive_file_get_information(DRIVE_FILE* file, BY_HANDLE_FILE_INFORMATION* info)
 {
-	BY_HANDLE_FILE_INFORMATION fileInformation;
 	BOOL status;
 	HANDLE hFile;
+	UINT64 ticket = 0;
 
-	if (!file || !output)
-		return FALSE;
+	if (drive_cache_get_info(file->cache, file->fullpath, info, &ticket))
+		return TRUE;
 
 	hFile = CreateFileW(file->fullpath, 0, FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
 	                    FILE_ATTRIBUTE_NORMAL, NULL);
 	if (hFile == INVALID_HANDLE_VALUE)
-		goto out_fail;
-	status = GetFileInformationByHandle(hFile, &fileInformation);
+		return FALSE;
+	status = GetFileInformationByHandle(hFile, info);
 	CloseHandle(hFile);
 	if (!status)
+		return FALSE;
+
+	drive_cache_put_info(file->cache, file->fullpath, info, ticket);
+	return TRUE;
+}
+
+BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
+{
+	BY_HANDLE_FILE_INFORMATION fileInformation;
+
+	if (!file || !output)
+		return FALSE;
+
+	if (!drive_file_get_information(file, &fileInformation))
 		goto out_fail;
 
 	switch (FsInformationClass)
@@ -549,8 +691,8 @@ out_fail:
 	return FALSE;
 }
 
-BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
-                                wStream* input)
+static BOOL drive_file_apply_information(DRIVE_FILE* file, UINT32 FsInformationClass,
+                                         UINT32 Length, wStream* input)
 {
 	INT64 size;
 	WCHAR* fullpath;
@@ -571,9 +713,6 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	UINT8 ReplaceIfExists;
 	DWORD attr;
 
-	if (!file || !input)
-		return FALSE;
-
 	switch (FsInformationClass)
 	{
 		case FileBasicInformation:
@@ -763,6 +902,64 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	return TRUE;
 }
 
+BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
+                                wStream* input)
+{
+	BOOL rc;
+
+	if (!file || !input)
+		return FALSE;
+
+	/* Truncation, renames and deletion invalidate read-ahead buffers */
+	drive_file_modified(file);
+	rc = drive_file_apply_information(file, FsInformationClass, Length, input);
+	drive_file_modified(file);
+	return rc;
+}
+
+static void drive_file_reset_listing(DRIVE_FILE* file)
+{
+	drive_dir_listing_release(file->listing);
+	free(file->listing_pattern);
+	file->listing = NULL;
+	file->listing_pattern = NULL;
+	file->listing_index = 0;
+}
+
+static BOOL drive_file_next_cached_entry(DRIVE_FILE* file)
+{
+	if (file->listing_index >= file->listing->count)
+	{
+		SetLastError(file->listing->error);
+		return FALSE;
+	}
+
+	file->find_data = file->listing->entries[file->listing_index++];
+	return TRUE;
+}
+
+/* Adds the current entry to the listing being built, gives up on it if it gets too large */
+static void drive_file_record_entry(DRIVE_FILE* file)
+{
+	if (file->listing_pattern && !drive_dir_listing_append(file->listing, &file->find_data))
+		drive_file_reset_listing(file);
+}
+
+/* Stores the listing being built if the enumeration ended regularly */
+static void drive_file_finish_listing(DRIVE_FILE* file, DWORD error)
+{
+	if (file->listing_pattern &&
+	    ((error == ERROR_NO_MORE_FILES) || (error == ERROR_FILE_NOT_FOUND)))
+	{
+		file->listing->error = error;
+		drive_cache_put_listing(file->cache, file->listing_pattern, file->listing,
+		                        file->listing_ticket);
+	}
+
+	drive_file_reset_listing(file);
+	SetLastError(error);
+}
+
 BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYTE InitialQuery,
                                 const WCHAR* path, UINT32 PathLength, wStream* output)
 {
@@ -774,20 +971,62 @@ BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYT
 
 	if (InitialQuery != 0)
 	{
+		DWORD error;
+		UINT64 ticket = 0;
+
 		/* release search handle */
 		if (file->find_handle != INVALID_HANDLE_VALUE)
 			FindClose(file->find_handle);
 
+		file->find_handle = INVALID_HANDLE_VALUE;
+		drive_file_reset_listing(file);
 		ent_path = drive_file_combine_fullpath(file->basepath, path, PathLength);
-		/* open new search handle and retrieve the first entry */
-		file->find_handle = FindFirstFileW(ent_path, &file->find_data);
-		free(ent_path);
 
-		if (file->find_handle == INVALID_HANDLE_VALUE)
+		if (!ent_path)
+			goto out_fail;
+
+		if ((file->listing = drive_cache_get_listing(file->cache, ent_path, &ticket)))
+		{
+			free(ent_path);
+
+			if (!drive_file_next_cached_entry(file))
+				goto out_fail;
+		}
+		else
+		{
+			/* open new search handle and retrieve the first entry */
+			file->find_handle = FindFirstFileW(ent_path, &file->find_data);
+			error = GetLastError();
+
+			if ((ticket != 0) && (file->listing = drive_dir_listing_new()))
+			{
+				file->listing_pattern = ent_path;
+				file->listing_ticket = ticket;
+			}
+			else
+				free(ent_path);
+
+			if (file->find_handle == INVALID_HANDLE_VALUE)
+			{
+				drive_file_finish_listing(file, error);
+				goto out_fail;
+			}
+
+			drive_file_record_entry(file);
+		}
+	}
+	else if ((file->find_handle == INVALID_HANDLE_VALUE) && file->listing)
+	{
+		if (!drive_file_next_cached_entry(file))
 			goto out_fail;
 	}
 	else if (!FindNextFileW(file->find_handle, &file->find_data))
+	{
+		drive_file_finish_listing(file, GetLastError());
 		goto out_fail;
+	}
+	else
+		drive_file_record_entry(file);
 
 	length = _wcslen(file->find_data.cFileName) * 2;
 
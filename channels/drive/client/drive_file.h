@@ -29,6 +29,8 @@
 #include <winpr/stream.h>
 #include <freerdp/channels/log.h>
 
+#include "drive_cache.h"
+
 #define TAG CHANNELS_TAG("drive.client")
 
 typedef struct
@@ -47,6 +49,30 @@ typedef struct
 	UINT32 DesiredAccess;
 	UINT32 CreateDisposition;
 	UINT32 CreateOptions;
+
+	/* Sequential read detection and read-ahead. offset is the position the next read or
+	 * write starts at, write_generation is shared by all files of a drive and changes
+	 * before and after every modification, a read-ahead buffer filled before the last
+	 * change is stale. read_ahead_time bounds how long changes made outside the session
+	 * can go unseen. */
+	UINT64 offset;
+	UINT64 next_read;
+	UINT32 sequential_reads;
+	BYTE* read_ahead;
+	UINT64 read_ahead_offset;
+	UINT32 read_ahead_length;
+	BOOL read_ahead_eof;
+	LONG read_ahead_generation;
+	UINT64 read_ahead_time;
+	volatile LONG* write_generation;
+
+	/* Metadata cache of the drive, may be NULL. listing is either served from the cache
+	 * (no find_handle) or built from the enumeration to be stored under listing_pattern. */
+	DRIVE_CACHE* cache;
+	DRIVE_DIR_LISTING* listing;
+	size_t listing_index;
+	WCHAR* listing_pattern;
+	UINT64 listing_ticket;
 } DRIVE_FILE;
 
 DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathLength, UINT32 id,
@@ -57,6 +83,7 @@ BOOL drive_file_free(DRIVE_FILE* file);
 BOOL drive_file_open(DRIVE_FILE* file);
 BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset);
 BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length);
+void drive_file_read_ahead(DRIVE_FILE* file);
 BOOL drive_file_write(DRIVE_FILE* file, BYTE* buffer, UINT32 Length);
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output);
 BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
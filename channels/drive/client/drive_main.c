@@ -45,6 +45,9 @@
 
 #include "drive_file.h"
 
+/* IRPs for different files are processed concurrently by this many threads per drive */
+#define DRIVE_WORKER_THREADS 4
+
 typedef struct
 {
 	DEVICE device;
@@ -53,10 +56,22 @@ typedef struct
 	BOOL automount;
 	UINT32 PathLength;
 	wListDictionary* files;
+	DRIVE_CACHE* cache;
 
 	HANDLE thread;
 	wMessageQueue* IrpQueue;
 
+	/* The dispatcher thread sorts IRPs into lanes, one per FileId. A lane is owned by a
+	 * single worker until it runs empty, so the IRPs of a file complete in order. */
+	CRITICAL_SECTION lock;
+	wListDictionary* lanes;
+	wMessageQueue* WorkQueue;
+	HANDLE workers[DRIVE_WORKER_THREADS];
+	size_t namespaceOps;
+	wArrayList* deferred;
+	HANDLE deferredIdle;
+	volatile LONG writeGeneration;
+
 	DEVMAN* devman;
 
 	rdpContext* rdpcontext;
@@ -193,6 +208,8 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 	else
 	{
 		void* key = (void*)(size_t)file->id;
+		file->write_generation = &drive->writeGeneration;
+		file->cache = drive->cache;
 
 		if (!ListDictionary_Add(drive->files, key, file))
 		{
@@ -267,6 +284,7 @@ static UINT drive_process_irp_close(DRIVE_DEVICE* drive, IRP* irp)
  */
 static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 {
+	UINT error;
 	DRIVE_FILE* file;
 	UINT32 Length;
 	UINT64 Offset;
@@ -315,7 +333,12 @@ static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 		}
 	}
 
-	return irp->Complete(irp);
+	if ((error = irp->Complete(irp)))
+		return error;
+
+	/* Fill the read-ahead buffer while the response is on its way */
+	drive_file_read_ahead(file);
+	return CHANNEL_RC_OK;
 }
 
 /**
@@ -748,6 +771,246 @@ static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
 	return error;
 }
 
+/* IRPs that add, remove or rename files are never processed concurrently */
+static BOOL drive_irp_changes_namespace(const IRP* irp)
+{
+	switch (irp->MajorFunction)
+	{
+		case IRP_MJ_CREATE:
+		case IRP_MJ_CLOSE:
+		case IRP_MJ_SET_INFORMATION:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/* Appends the IRP to the lane of its file, the lock must be held */
+static UINT drive_lane_post(DRIVE_DEVICE* drive, IRP* irp)
+{
+	wQueue* lane;
+	void* key = (void*)(size_t)irp->FileId;
+	const BOOL namespaceOp = drive_irp_changes_namespace(irp);
+	UINT error = CHANNEL_RC_OK;
+
+	if (namespaceOp)
+		drive->namespaceOps++;
+
+	lane = (wQueue*)ListDictionary_GetItemValue(drive->lanes, key);
+
+	if (lane)
+	{
+		/* A worker owns the lane and picks the IRP up once it is done with the previous ones */
+		if (!Queue_Enqueue(lane, irp))
+		{
+			WLog_ERR(TAG, "Queue_Enqueue failed!");
+			error = ERROR_INTERNAL_ERROR;
+		}
+
+		goto out;
+	}
+
+	lane = Queue_New(FALSE, -1, -1);
+
+	if (!lane || !ListDictionary_Add(drive->lanes, key, lane))
+	{
+		WLog_ERR(TAG, "Failed to create a lane for FileId %" PRIu32 "!", irp->FileId);
+		Queue_Free(lane);
+		error = CHANNEL_RC_NO_MEMORY;
+		goto out;
+	}
+
+	if (!MessageQueue_Post(drive->WorkQueue, NULL, 0, (void*)irp, NULL))
+	{
+		WLog_ERR(TAG, "MessageQueue_Post failed!");
+		ListDictionary_Remove(drive->lanes, key);
+		Queue_Free(lane);
+		error = ERROR_INTERNAL_ERROR;
+	}
+
+out:
+	if (error && namespaceOp)
+		drive->namespaceOps--;
+
+	return error;
+}
+
+/**
+ * A create must see the result of a close (delete on close) or rename sent before it, so
+ * a namespace change is held back while another one is in flight. IRPs for a file with a
+ * held back IRP are held back as well to keep their order, all others are posted directly.
+ * The lock must be held.
+ */
+static BOOL drive_irp_must_wait(DRIVE_DEVICE* drive, const IRP* irp)
+{
+	size_t index;
+	const size_t count = ArrayList_Count(drive->deferred);
+
+	if (drive_irp_changes_namespace(irp))
+		return (drive->namespaceOps > 0) || (count > 0);
+
+	for (index = 0; index < count; index++)
+	{
+		const IRP* deferred = (const IRP*)ArrayList_GetItem(drive->deferred, index);
+
+		if (deferred->FileId == irp->FileId)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Posts the held back IRPs up to the next namespace change that has to wait, the lock must
+ * be held */
+static UINT drive_post_deferred(DRIVE_DEVICE* drive)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	while (ArrayList_Count(drive->deferred) > 0)
+	{
+		IRP* irp = (IRP*)ArrayList_GetItem(drive->deferred, 0);
+
+		if (drive_irp_changes_namespace(irp) && (drive->namespaceOps > 0))
+			break;
+
+		ArrayList_RemoveAt(drive->deferred, 0);
+
+		if ((error = drive_lane_post(drive, irp)))
+			break;
+	}
+
+	if (ArrayList_Count(drive->deferred) == 0)
+		SetEvent(drive->deferredIdle);
+
+	return error;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drive_dispatch_irp(DRIVE_DEVICE* drive, IRP* irp)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	EnterCriticalSection(&drive->lock);
+
+	if (!drive_irp_must_wait(drive, irp))
+		error = drive_lane_post(drive, irp);
+	else if (ArrayList_Append(drive->deferred, irp))
+		ResetEvent(drive->deferredIdle);
+	else
+	{
+		WLog_ERR(TAG, "ArrayList_Append failed!");
+		error = ERROR_INTERNAL_ERROR;
+	}
+
+	LeaveCriticalSection(&drive->lock);
+	return error;
+}
+
+/**
+ * Retires a processed IRP and returns the next one of its lane, NULL if the lane is empty.
+ * error is only set if posting the held back IRPs failed.
+ */
+static IRP* drive_lane_next(DRIVE_DEVICE* drive, UINT32 FileId, BOOL namespaceOp, UINT* error)
+{
+	IRP* irp;
+	wQueue* lane;
+	void* key = (void*)(size_t)FileId;
+
+	EnterCriticalSection(&drive->lock);
+
+	if (namespaceOp && (--drive->namespaceOps == 0))
+	{
+		const UINT rc = drive_post_deferred(drive);
+
+		if (rc)
+			*error = rc;
+	}
+
+	lane = (wQueue*)ListDictionary_GetItemValue(drive->lanes, key);
+	WINPR_ASSERT(lane);
+	irp = (IRP*)Queue_Dequeue(lane);
+
+	if (!irp)
+	{
+		ListDictionary_Remove(drive->lanes, key);
+		Queue_Free(lane);
+	}
+
+	LeaveCriticalSection(&drive->lock);
+	return irp;
+}
+
+static DWORD WINAPI drive_worker_func(LPVOID arg)
+{
+	wMessage message;
+	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)arg;
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(drive);
+
+	while (1)
+	{
+		IRP* irp;
+
+		if (!MessageQueue_Wait(drive->WorkQueue) ||
+		    !MessageQueue_Peek(drive->WorkQueue, &message, TRUE))
+		{
+			WLog_ERR(TAG, "Waiting for the work queue failed!");
+			error = ERROR_INTERNAL_ERROR;
+
+			if (drive->rdpcontext)
+				setChannelError(drive->rdpcontext, error, "drive_worker_func reported an error");
+
+			break;
+		}
+
+		if (message.id == WMQ_QUIT)
+			break;
+
+		irp = (IRP*)message.wParam;
+
+		/* Keep draining the lane on errors, the IRPs queued behind a failed one would hang */
+		while (irp)
+		{
+			/* The IRP is freed once it is completed */
+			const UINT32 FileId = irp->FileId;
+			const BOOL namespaceOp = drive_irp_changes_namespace(irp);
+			UINT rc = drive_process_irp(drive, irp);
+
+			if (rc)
+			{
+				WLog_ERR(TAG, "drive_process_irp failed with error %" PRIu32 "!", rc);
+
+				if (drive->rdpcontext)
+					setChannelError(drive->rdpcontext, rc, "drive_worker_func reported an error");
+
+				error = rc;
+			}
+
+			rc = CHANNEL_RC_OK;
+			irp = drive_lane_next(drive, FileId, namespaceOp, &rc);
+
+			if (rc)
+			{
+				WLog_ERR(TAG, "drive_post_deferred failed with error %" PRIu32 "!", rc);
+
+				if (drive->rdpcontext)
+					setChannelError(drive->rdpcontext, rc, "drive_worker_func reported an error");
+
+				error = rc;
+			}
+		}
+	}
+
+	ExitThread(error);
+	return error;
+}
+
 static DWORD WINAPI drive_thread_func(LPVOID arg)
 {
 	IRP* irp;
@@ -784,9 +1047,9 @@ static DWORD WINAPI drive_thread_func(LPVOID arg)
 
 		if (irp)
 		{
-			if ((error = drive_process_irp(drive, irp)))
+			if ((error = drive_dispatch_irp(drive, irp)))
 			{
-				WLog_ERR(TAG, "drive_process_irp failed with error %" PRIu32 "!", error);
+				WLog_ERR(TAG, "drive_dispatch_irp failed with error %" PRIu32 "!", error);
 				break;
 			}
 		}
@@ -824,14 +1087,25 @@ static UINT drive_irp_request(DEVICE* device, IRP* irp)
 
 static UINT drive_free_int(DRIVE_DEVICE* drive)
 {
+	size_t index;
 	UINT error = CHANNEL_RC_OK;
 
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
 	CloseHandle(drive->thread);
+
+	for (index = 0; index < DRIVE_WORKER_THREADS; index++)
+		CloseHandle(drive->workers[index]);
+
+	ListDictionary_Free(drive->lanes);
 	ListDictionary_Free(drive->files);
+	drive_cache_free(drive->cache);
+	MessageQueue_Free(drive->WorkQueue);
 	MessageQueue_Free(drive->IrpQueue);
+	ArrayList_Free(drive->deferred);
+	CloseHandle(drive->deferredIdle);
+	DeleteCriticalSection(&drive->lock);
 	Stream_Free(drive->device.data, TRUE);
 	free(drive->path);
 	free(drive);
@@ -845,6 +1119,7 @@ static UINT drive_free_int(DRIVE_DEVICE* drive)
  */
 static UINT drive_free(DEVICE* device)
 {
+	size_t index;
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)device;
 	UINT error = CHANNEL_RC_OK;
 
@@ -859,6 +1134,32 @@ static UINT drive_free(DEVICE* device)
 		return error;
 	}
 
+	/* The dispatcher is gone, once the held back IRPs are posted every IRP is in a lane.
+	 * The quit messages are queued behind them, so the workers finish all of them first. */
+	if (WaitForSingleObject(drive->deferredIdle, INFINITE) == WAIT_FAILED)
+	{
+		error = GetLastError();
+		WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
+		return error;
+	}
+
+	for (index = 0; index < DRIVE_WORKER_THREADS; index++)
+	{
+		if (!MessageQueue_PostQuit(drive->WorkQueue, 0))
+			break;
+	}
+
+	for (index = 0; index < DRIVE_WORKER_THREADS; index++)
+	{
+		if (drive->workers[index] &&
+		    (WaitForSingleObject(drive->workers[index], INFINITE) == WAIT_FAILED))
+		{
+			error = GetLastError();
+			WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
+			return error;
+		}
+	}
+
 	return drive_free_int(drive);
 }
 
@@ -900,6 +1201,13 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 			return CHANNEL_RC_NO_MEMORY;
 		}
 
+		if (!InitializeCriticalSectionAndSpinCount(&drive->lock, 4000))
+		{
+			WLog_ERR(TAG, "InitializeCriticalSectionAndSpinCount failed!");
+			free(drive);
+			return ERROR_INTERNAL_ERROR;
+		}
+
 		drive->device.type = RDPDR_DTYP_FILESYSTEM;
 		drive->device.IRPRequest = drive_irp_request;
 		drive->device.Free = drive_free;
@@ -961,6 +1269,8 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		}
 
 		ListDictionary_ValueObject(drive->files)->fnObjectFree = drive_file_objfree;
+		/* Optional, without it all metadata requests go to the file system */
+		drive->cache = drive_cache_new();
 		drive->IrpQueue = MessageQueue_New(NULL);
 
 		if (!drive->IrpQueue)
@@ -970,6 +1280,18 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 			goto out_error;
 		}
 
+		drive->lanes = ListDictionary_New(FALSE);
+		drive->WorkQueue = MessageQueue_New(NULL);
+		drive->deferred = ArrayList_New(FALSE);
+		drive->deferredIdle = CreateEvent(NULL, TRUE, TRUE, NULL);
+
+		if (!drive->lanes || !drive->WorkQueue || !drive->deferred || !drive->deferredIdle)
+		{
+			WLog_ERR(TAG, "Failed to allocate the IRP lanes!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out_error;
+		}
+
 		if ((error = pEntryPoints->RegisterDevice(pEntryPoints->devman, (DEVICE*)drive)))
 		{
 			WLog_ERR(TAG, "RegisterDevice failed with error %" PRIu32 "!", error);
@@ -980,9 +1302,24 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		          CreateThread(NULL, 0, drive_thread_func, drive, CREATE_SUSPENDED, NULL)))
 		{
 			WLog_ERR(TAG, "CreateThread failed!");
+			error = ERROR_INTERNAL_ERROR;
 			goto out_error;
 		}
 
+		for (i = 0; i < DRIVE_WORKER_THREADS; i++)
+		{
+			if (!(drive->workers[i] =
+			          CreateThread(NULL, 0, drive_worker_func, drive, CREATE_SUSPENDED, NULL)))
+			{
+				WLog_ERR(TAG, "CreateThread failed!");
+				error = ERROR_INTERNAL_ERROR;
+				goto out_error;
+			}
+		}
+
+		for (i = 0; i < DRIVE_WORKER_THREADS; i++)
+			ResumeThread(drive->workers[i]);
+
 		ResumeThread(drive->thread);
 	}
 
@@ -36,6 +36,7 @@
 #include <winpr/collections.h>
 
 #include <freerdp/addin.h>
+#include <freerdp/codec/color.h>
 #include <freerdp/channels/log.h>
 
 #include "rdpgfx_common.h"
@@ -45,6 +46,8 @@
 
 #define TAG CHANNELS_TAG("rdpgfx.client")
 
+static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx);
+
 static void free_surfaces(RdpgfxClientContext* context, wHashTable* SurfaceTable)
 {
 	UINT error = 0;
@@ -333,6 +336,7 @@ static UINT rdpgfx_send_supported_caps(RDPGFX_CHANNEL_CALLBACK* callback)
  */
 static UINT rdpgfx_recv_caps_confirm_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 {
+	UINT error;
 	RDPGFX_CAPSET capsSet;
 	RDPGFX_CAPS_CONFIRM_PDU pdu;
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
@@ -352,7 +356,12 @@ static UINT rdpgfx_recv_caps_confirm_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStr
 	if (!context)
 		return ERROR_BAD_CONFIGURATION;
 
-	return IFCALLRESULT(CHANNEL_RC_OK, context->CapsConfirm, context, &pdu);
+	error = IFCALLRESULT(CHANNEL_RC_OK, context->CapsConfirm, context, &pdu);
+
+	if (error != CHANNEL_RC_OK)
+		return error;
+
+	return rdpgfx_send_cache_offer(gfx);
 }
 
 /**
@@ -531,6 +540,223 @@ fail:
 	return error;
 }
 
+static BOOL rdpgfx_persistent_cache_enabled(RDPGFX_PLUGIN* gfx)
+{
+	if (!freerdp_settings_get_bool(gfx->settings, FreeRDP_BitmapCachePersistEnabled))
+		return FALSE;
+
+	return freerdp_settings_get_string(gfx->settings, FreeRDP_GfxCachePersistFile) != NULL;
+}
+
+static void rdpgfx_free_cache_import_offer(RDPGFX_PLUGIN* gfx)
+{
+	persistent_cache_free(gfx->CacheImportStore);
+	free(gfx->CacheImportEntries);
+	gfx->CacheImportStore = NULL;
+	gfx->CacheImportEntries = NULL;
+	gfx->CacheImportEntriesCount = 0;
+}
+
+/**
+ * Offer the bitmaps saved by a previous session to the server.
+ * The store stays open until the reply arrives, the entries are then
+ * imported into the cache slots the server assigned to them.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
+{
+	int status;
+	size_t count;
+	UINT16 index = 0;
+	UINT error = CHANNEL_RC_OK;
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+	RDPGFX_CACHE_IMPORT_OFFER_PDU pdu = { 0 };
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+	const char* filename = freerdp_settings_get_string(gfx->settings, FreeRDP_GfxCachePersistFile);
+
+	rdpgfx_free_cache_import_offer(gfx);
+
+	if (!context || !context->ImportCacheEntry || !rdpgfx_persistent_cache_enabled(gfx))
+		return CHANNEL_RC_OK;
+
+	gfx->CacheImportStore = persistent_cache_new();
+
+	if (!gfx->CacheImportStore)
+		return CHANNEL_RC_NO_MEMORY;
+
+	if (!persistent_cache_open(gfx->CacheImportStore, filename, FALSE))
+	{
+		rdpgfx_free_cache_import_offer(gfx);
+		return CHANNEL_RC_OK;
+	}
+
+	count = persistent_cache_get_count(gfx->CacheImportStore);
+	count = MIN(count, MIN(gfx->MaxCacheSlots, RDPGFX_CACHE_ENTRY_MAX_COUNT));
+
+	if (count == 0)
+		goto out;
+
+	gfx->CacheImportEntries =
+	    (PERSISTENT_CACHE_ENTRY*)calloc(count, sizeof(PERSISTENT_CACHE_ENTRY));
+	pdu.cacheEntries =
+	    (RDPGFX_CACHE_ENTRY_METADATA*)calloc(count, sizeof(RDPGFX_CACHE_ENTRY_METADATA));
+
+	if (!gfx->CacheImportEntries || !pdu.cacheEntries)
+	{
+		error = CHANNEL_RC_NO_MEMORY;
+		goto out;
+	}
+
+	while ((index < count) &&
+	       ((status = persistent_cache_read_entry(gfx->CacheImportStore, &entry)) > 0))
+	{
+		/* Cache slots hold 32bpp bitmaps only */
+		if (FreeRDPGetBytesPerPixel(entry.format) != 4)
+			continue;
+
+		pdu.cacheEntries[index].cacheKey = entry.key64;
+		pdu.cacheEntries[index].bitmapLength = entry.size;
+		gfx->CacheImportEntries[index++] = entry;
+	}
+
+	gfx->CacheImportEntriesCount = index;
+	pdu.cacheEntriesCount = index;
+
+	if (index > 0)
+	{
+		WLog_Print(gfx->log, WLOG_DEBUG, "offering %" PRIu16 " persistent cache entries", index);
+		error = rdpgfx_send_cache_import_offer_pdu(context, &pdu);
+	}
+
+out:
+	free(pdu.cacheEntries);
+
+	if ((error != CHANNEL_RC_OK) || (gfx->CacheImportEntriesCount == 0))
+		rdpgfx_free_cache_import_offer(gfx);
+
+	return error;
+}
+
+/**
+ * Load the offered entries the server accepted into their cache slots.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
+                                           const RDPGFX_CACHE_IMPORT_REPLY_PDU* pdu)
+{
+	UINT16 index;
+	UINT error = CHANNEL_RC_OK;
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+
+	if (!context)
+		return ERROR_BAD_CONFIGURATION;
+
+	for (index = 0; index < MIN(pdu->importedEntriesCount, gfx->CacheImportEntriesCount); index++)
+	{
+		const UINT16 cacheSlot = pdu->cacheSlots[index];
+
+		/* Entries the server did not import are marked with slot 0 */
+		if (cacheSlot == 0)
+			continue;
+
+		error = IFCALLRESULT(CHANNEL_RC_OK, context->ImportCacheEntry, context, cacheSlot,
+		                     &gfx->CacheImportEntries[index]);
+
+		if (error != CHANNEL_RC_OK)
+		{
+			WLog_Print(gfx->log, WLOG_ERROR,
+			           "context->ImportCacheEntry failed with error %" PRIu32 "", error);
+			break;
+		}
+	}
+
+	rdpgfx_free_cache_import_offer(gfx);
+	return error;
+}
+
+static int rdpgfx_compare_cache_entry(const void* pva, const void* pvb)
+{
+	const PERSISTENT_CACHE_ENTRY* a = (const PERSISTENT_CACHE_ENTRY*)pva;
+	const PERSISTENT_CACHE_ENTRY* b = (const PERSISTENT_CACHE_ENTRY*)pvb;
+
+	if (a->key64 < b->key64)
+		return -1;
+
+	return (a->key64 > b->key64) ? 1 : 0;
+}
+
+/**
+ * Save the cache slots to the persistent cache so the next session can
+ * offer them. The server keys entries by a hash of their content, slots
+ * holding the same bitmap are stored once.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_save_persistent_cache(RDPGFX_PLUGIN* gfx)
+{
+	size_t x;
+	UINT16 index;
+	size_t count = 0;
+	size_t written = 0;
+	UINT error = CHANNEL_RC_OK;
+	PERSISTENT_CACHE_ENTRY* entries = NULL;
+	rdpPersistentCache* persistent = NULL;
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+	const char* filename = freerdp_settings_get_string(gfx->settings, FreeRDP_GfxCachePersistFile);
+
+	if (!context || !context->ExportCacheEntry || !rdpgfx_persistent_cache_enabled(gfx))
+		return CHANNEL_RC_OK;
+
+	entries = (PERSISTENT_CACHE_ENTRY*)calloc(gfx->MaxCacheSlots, sizeof(PERSISTENT_CACHE_ENTRY));
+
+	if (!entries)
+		return CHANNEL_RC_NO_MEMORY;
+
+	for (index = 0; index < gfx->MaxCacheSlots; index++)
+	{
+		if (!gfx->CacheSlots[index])
+			continue;
+
+		if (context->ExportCacheEntry(context, index + 1, &entries[count]) == CHANNEL_RC_OK)
+			count++;
+	}
+
+	/* Keep the previous store if nothing was cached in this session */
+	if (count == 0)
+		goto out;
+
+	qsort(entries, count, sizeof(PERSISTENT_CACHE_ENTRY), rdpgfx_compare_cache_entry);
+	persistent = persistent_cache_new();
+
+	if (!persistent || !persistent_cache_open(persistent, filename, TRUE))
+	{
+		error = ERROR_INTERNAL_ERROR;
+		goto out;
+	}
+
+	for (x = 0; (x < count) && (written < RDPGFX_CACHE_ENTRY_MAX_COUNT); x++)
+	{
+		if ((x > 0) && (entries[x].key64 == entries[x - 1].key64))
+			continue;
+
+		if (!persistent_cache_write_entry(persistent, &entries[x]))
+			continue;
+
+		written++;
+	}
+
+	if (!persistent_cache_close(persistent))
+		error = ERROR_INTERNAL_ERROR;
+
+	WLog_Print(gfx->log, WLOG_DEBUG, "saved %" PRIuz " persistent cache entries", written);
+out:
+	persistent_cache_free(persistent);
+	free(entries);
+	return error;
+}
+
 /**
  * Function description
  *
@@ -666,6 +892,9 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 
 	Stream_Read_UINT16(s, pdu.importedEntriesCount); /* cacheSlot (2 bytes) */
 
+	if (pdu.importedEntriesCount > RDPGFX_CACHE_ENTRY_MAX_COUNT)
+		return ERROR_INVALID_DATA;
+
 	if (!Stream_CheckAndLogRequiredLength(TAG, s, 2ull * pdu.importedEntriesCount))
 		return ERROR_INVALID_DATA;
 
@@ -684,8 +913,9 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 
 	DEBUG_RDPGFX(gfx->log, "RecvCacheImportReplyPdu: importedEntriesCount: %" PRIu16 "",
 	             pdu.importedEntriesCount);
+	error = rdpgfx_load_cache_import_reply(gfx, &pdu);
 
-	if (context)
+	if (context && (error == CHANNEL_RC_OK))
 	{
 		IFCALLRET(context->CacheImportReply, error, context, &pdu);
 
@@ -1760,6 +1990,8 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
 
 	DEBUG_RDPGFX(gfx->log, "OnClose");
+	rdpgfx_save_persistent_cache(gfx);
+	rdpgfx_free_cache_import_offer(gfx);
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
 
@@ -2061,6 +2293,8 @@ void rdpgfx_client_context_free(RdpgfxClientContext* context)
 
 	gfx = (RDPGFX_PLUGIN*)context->handle;
 
+	rdpgfx_save_persistent_cache(gfx);
+	rdpgfx_free_cache_import_offer(gfx);
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
 
@@ -78,6 +78,9 @@ typedef struct
 
 	UINT16 MaxCacheSlots;
 	void* CacheSlots[25600];
+	rdpPersistentCache* CacheImportStore;
+	PERSISTENT_CACHE_ENTRY* CacheImportEntries;
+	UINT16 CacheImportEntriesCount;
 	rdpContext* rdpcontext;
 
 	wLog* log;
@@ -100,6 +100,7 @@
 #include "xf_video.h"
 #include "xf_monitor.h"
 #include "xf_graphics.h"
+#include "xf_shm.h"
 #include "xf_keyboard.h"
 #include "xf_input.h"
 #include "xf_channels.h"
@@ -320,6 +321,30 @@ static BOOL xf_desktop_resize(rdpContext* context)
 	return TRUE;
 }
 
+/* Pushes an area of the GDI primary buffer to the primary pixmap, returns TRUE if shared
+ * memory was used and the caller has to XSync before the next frame is drawn. */
+static BOOL xf_sw_put_image(xfContext* xfc, INT32 x, INT32 y, UINT32 w, UINT32 h)
+{
+	rdpGdi* gdi = xfc->common.context.gdi;
+
+	WINPR_ASSERT(gdi);
+
+	if (!xfc->primaryShm)
+		xfc->primaryShm = xf_shm_image_new(xfc, gdi->width, gdi->height, gdi->stride);
+
+	if (xfc->primaryShm &&
+	    freerdp_image_copy(xf_shm_image_data(xfc->primaryShm), gdi->dstFormat, gdi->stride,
+	                       (UINT32)x, (UINT32)y, w, h, gdi->primary_buffer, gdi->dstFormat,
+	                       gdi->stride, (UINT32)x, (UINT32)y, &gdi->palette, FREERDP_FLIP_NONE))
+	{
+		xf_shm_put_image(xfc, xfc->primary, xfc->gc, xfc->primaryShm, x, y, x, y, w, h);
+		return TRUE;
+	}
+
+	XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, x, y, x, y, w, h);
+	return FALSE;
+}
+
 static BOOL xf_sw_end_paint(rdpContext* context)
 {
 	int i;
@@ -327,6 +352,7 @@ static BOOL xf_sw_end_paint(rdpContext* context)
 	UINT32 w, h;
 	int ninvalid;
 	HGDI_RGN cinvalid;
+	BOOL shared = FALSE;
 	xfContext* xfc = (xfContext*)context;
 	rdpGdi* gdi = context->gdi;
 
@@ -348,8 +374,12 @@ static BOOL xf_sw_end_paint(rdpContext* context)
 				return TRUE;
 
 			xf_lock_x11(xfc);
-			XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, x, y, x, y, w, h);
+			shared = xf_sw_put_image(xfc, x, y, w, h);
 			xf_draw_screen(xfc, x, y, w, h);
+
+			if (shared)
+				XSync(xfc->display, False);
+
 			xf_unlock_x11(xfc);
 		}
 		else
@@ -365,11 +395,17 @@ static BOOL xf_sw_end_paint(rdpContext* context)
 				y = cinvalid[i].y;
 				w = cinvalid[i].w;
 				h = cinvalid[i].h;
-				XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, x, y, x, y, w, h);
+				if (xf_sw_put_image(xfc, x, y, w, h))
+					shared = TRUE;
+
 				xf_draw_screen(xfc, x, y, w, h);
 			}
 
-			XFlush(xfc->display);
+			/* The shared image is overwritten by the next frame, wait until the server read it */
+			if (shared)
+				XSync(xfc->display, False);
+			else
+				XFlush(xfc->display);
 			xf_unlock_x11(xfc);
 		}
 	}
@@ -399,6 +435,9 @@ static BOOL xf_sw_desktop_resize(rdpContext* context)
 	if (!gdi_resize(gdi, settings->DesktopWidth, settings->DesktopHeight))
 		goto out;
 
+	xf_shm_image_free(xfc, xfc->primaryShm);
+	xfc->primaryShm = NULL;
+
 	if (xfc->image)
 	{
 		xfc->image->data = NULL;
@@ -715,6 +754,9 @@ static void xf_window_free(xfContext* xfc)
 	}
 #endif
 
+	xf_shm_image_free(xfc, xfc->primaryShm);
+	xfc->primaryShm = NULL;
+
 	if (xfc->image)
 	{
 		xfc->image->data = NULL;
@@ -1008,6 +1050,8 @@ static void xf_check_extensions(xfContext* context)
 		}
 	}
 #endif
+
+	context->xshmAvailable = xf_shm_check(context);
 }
 
 #ifdef WITH_XI
@@ -25,11 +25,51 @@
 #include <freerdp/log.h>
 #include "xf_gfx.h"
 #include "xf_rail.h"
+#include "xf_shm.h"
 
 #include <X11/Xutil.h>
 
 #define TAG CLIENT_TAG("x11")
 
+static void xf_gfx_put_image(xfContext* xfc, xfGfxSurface* surface, Drawable drawable, int src_x,
+                             int src_y, int dst_x, int dst_y, unsigned int width,
+                             unsigned int height)
+{
+	if (surface->shm)
+		xf_shm_put_image(xfc, drawable, xfc->gc, surface->shm, src_x, src_y, dst_x, dst_y, width,
+		                 height);
+	else
+		XPutImage(xfc->display, drawable, xfc->gc, surface->image, src_x, src_y, dst_x, dst_y,
+		          width, height);
+}
+
+/* Releases the pixel buffers of a surface, including the shared one */
+static void xf_gfx_surface_free_image(xfContext* xfc, xfGfxSurface* surface)
+{
+	if (surface->shm)
+	{
+		if (surface->stage == xf_shm_image_data(surface->shm))
+			surface->stage = NULL;
+		else
+			surface->gdi.data = NULL;
+
+		xf_shm_image_free(xfc, surface->shm);
+		surface->shm = NULL;
+	}
+	else if (surface->image)
+	{
+		surface->image->data = NULL;
+		XDestroyImage(surface->image);
+	}
+
+	surface->image = NULL;
+	_aligned_free(surface->gdi.data);
+	surface->gdi.data = NULL;
+	_aligned_free(surface->stage);
+	surface->stage = NULL;
+}
+
+/* Queues the invalid region of a surface, the caller has to XSync before the surface is changed */
 static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
@@ -88,8 +128,8 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 
 		if (xfc->remote_app)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			xf_gfx_put_image(xfc, surface, xfc->primary, nXSrc, nYSrc, nXDst, nYDst, dwidth,
+			                 dheight);
 			xf_lock_x11(xfc);
 			xf_rail_paint(xfc, nXDst, nYDst, nXDst + dwidth, nYDst + dheight);
 			xf_unlock_x11(xfc);
@@ -98,15 +138,15 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 #ifdef WITH_XRENDER
 		    if (settings->SmartSizing || settings->MultiTouchGestures)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			xf_gfx_put_image(xfc, surface, xfc->primary, nXSrc, nYSrc, nXDst, nYDst, dwidth,
+			                 dheight);
 			xf_draw_screen(xfc, nXDst, nYDst, dwidth, dheight);
 		}
 		else
 #endif
 		{
-			XPutImage(xfc->display, xfc->drawable, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			xf_gfx_put_image(xfc, surface, xfc->drawable, nXSrc, nYSrc, nXDst, nYDst, dwidth,
+			                 dheight);
 		}
 	}
 
@@ -114,7 +154,6 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 fail:
 	region16_clear(&surface->gdi.invalidRegion);
 	XSetClipMask(xfc->display, xfc->gc, None);
-	XSync(xfc->display, False);
 	return rc;
 }
 
@@ -124,6 +163,7 @@ static UINT xf_UpdateSurfaces(RdpgfxClientContext* context)
 	UINT32 index;
 	UINT status = CHANNEL_RC_OK;
 	UINT16* pSurfaceIds = NULL;
+	BOOL updated = FALSE;
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 	xfContext* xfc;
 
@@ -154,12 +194,20 @@ static UINT xf_UpdateSurfaces(RdpgfxClientContext* context)
 		status = ERROR_INTERNAL_ERROR;
 
 		if (surface->gdi.outputMapped)
+		{
 			status = xf_OutputUpdate(xfc, surface);
+			updated = TRUE;
+		}
 
 		if (status != 0)
 			break;
 	}
 
+	/* One round trip per frame, the server has to be done reading shared surfaces before the
+	 * next frame is decoded into them */
+	if (updated)
+		XSync(xfc->display, False);
+
 	free(pSurfaceIds);
 	LeaveCriticalSection(&context->mux);
 	return status;
@@ -261,6 +309,7 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 {
 	UINT ret = CHANNEL_RC_NO_MEMORY;
 	size_t size;
+	BOOL direct;
 	xfGfxSurface* surface;
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 	xfContext* xfc = (xfContext*)gdi->context;
@@ -305,7 +354,17 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	surface->gdi.scanline = surface->gdi.width * FreeRDPGetBytesPerPixel(surface->gdi.format);
 	surface->gdi.scanline = x11_pad_scanline(surface->gdi.scanline, xfc->scanline_pad);
 	size = surface->gdi.scanline * surface->gdi.height * 1ULL;
-	surface->gdi.data = (BYTE*)_aligned_malloc(size, 16);
+	direct = AreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format);
+
+	/* The buffer the XImage points to is shared with the X server if possible */
+	if (direct)
+		surface->shm = xf_shm_image_new(xfc, surface->gdi.mappedWidth, surface->gdi.height,
+		                                surface->gdi.scanline);
+
+	if (surface->shm)
+		surface->gdi.data = xf_shm_image_data(surface->shm);
+	else
+		surface->gdi.data = (BYTE*)_aligned_malloc(size, 16);
 
 	if (!surface->gdi.data)
 	{
@@ -315,7 +374,9 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 
 	ZeroMemory(surface->gdi.data, size);
 
-	if (AreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
+	if (surface->shm)
+		surface->image = xf_shm_image_get(surface->shm);
+	else if (direct)
 	{
 		surface->image =
 		    XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
@@ -329,7 +390,13 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 		surface->stageScanline = width * bytes;
 		surface->stageScanline = x11_pad_scanline(surface->stageScanline, xfc->scanline_pad);
 		size = surface->stageScanline * surface->gdi.height * 1ULL;
-		surface->stage = (BYTE*)_aligned_malloc(size, 16);
+		surface->shm = xf_shm_image_new(xfc, surface->gdi.mappedWidth, surface->gdi.height,
+		                                surface->stageScanline);
+
+		if (surface->shm)
+			surface->stage = xf_shm_image_data(surface->shm);
+		else
+			surface->stage = (BYTE*)_aligned_malloc(size, 16);
 
 		if (!surface->stage)
 		{
@@ -338,16 +405,20 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 		}
 
 		ZeroMemory(surface->stage, size);
-		surface->image =
-		    XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0, (char*)surface->stage,
-		                 surface->gdi.mappedWidth, surface->gdi.mappedHeight, xfc->scanline_pad,
-		                 surface->stageScanline);
+
+		if (surface->shm)
+			surface->image = xf_shm_image_get(surface->shm);
+		else
+			surface->image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
+			                              (char*)surface->stage, surface->gdi.mappedWidth,
+			                              surface->gdi.mappedHeight, xfc->scanline_pad,
+			                              surface->stageScanline);
 	}
 
 	if (!surface->image)
 	{
 		WLog_ERR(TAG, "%s: an error occurred when creating the XImage", __FUNCTION__);
-		goto error_surface_image;
+		goto out_free_gdidata;
 	}
 
 	surface->image->byte_order = LSBFirst;
@@ -358,17 +429,12 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	if (context->SetSurfaceData(context, surface->gdi.surfaceId, (void*)surface) != CHANNEL_RC_OK)
 	{
 		WLog_ERR(TAG, "%s: an error occurred during SetSurfaceData", __FUNCTION__);
-		goto error_set_surface_data;
+		goto out_free_gdidata;
 	}
 
 	return CHANNEL_RC_OK;
-error_set_surface_data:
-	surface->image->data = NULL;
-	XDestroyImage(surface->image);
-error_surface_image:
-	_aligned_free(surface->stage);
 out_free_gdidata:
-	_aligned_free(surface->gdi.data);
+	xf_gfx_surface_free_image(xfc, surface);
 out_free:
 	free(surface);
 	return ret;
@@ -385,6 +451,8 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 	rdpCodecs* codecs = NULL;
 	xfGfxSurface* surface = NULL;
 	UINT status;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
+	xfContext* xfc = (xfContext*)gdi->context;
 	EnterCriticalSection(&context->mux);
 	surface = (xfGfxSurface*)context->GetSurfaceData(context, deleteSurface->surfaceId);
 
@@ -396,10 +464,7 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 #ifdef WITH_GFX_H264
 		h264_context_free(surface->gdi.h264);
 #endif
-		surface->image->data = NULL;
-		XDestroyImage(surface->image);
-		_aligned_free(surface->gdi.data);
-		_aligned_free(surface->stage);
+		xf_gfx_surface_free_image(xfc, surface);
 		region16_uninit(&surface->gdi.invalidRegion);
 		codecs = surface->gdi.codecs;
 		free(surface);
@@ -0,0 +1,230 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM Output
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <freerdp/log.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#ifdef WITH_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
+#include "xf_shm.h"
+
+#define TAG CLIENT_TAG("x11")
+
+struct xf_shm_image
+{
+	XImage* image;
+#ifdef WITH_XSHM
+	XShmSegmentInfo info;
+	BOOL attached;
+#endif
+};
+
+#ifdef WITH_XSHM
+static BOOL xf_shm_error = FALSE;
+
+static int xf_shm_error_handler(Display* display, XErrorEvent* event)
+{
+	WINPR_UNUSED(display);
+	WINPR_UNUSED(event);
+	xf_shm_error = TRUE;
+	return 0;
+}
+
+static BOOL xf_shm_attach(xfContext* xfc, XShmSegmentInfo* info)
+{
+	Status status;
+	int (*handler)(Display*, XErrorEvent*);
+
+	xf_lock_x11(xfc);
+	XSync(xfc->display, False);
+	xf_shm_error = FALSE;
+	handler = XSetErrorHandler(xf_shm_error_handler);
+	status = XShmAttach(xfc->display, info);
+	XSync(xfc->display, False);
+	XSetErrorHandler(handler);
+	xf_unlock_x11(xfc);
+
+	/* The segment goes away once both sides detached, even if the client crashes */
+	shmctl(info->shmid, IPC_RMID, NULL);
+	return status && !xf_shm_error;
+}
+
+static XImage* xf_shm_create_ximage(xfContext* xfc, XShmSegmentInfo* info, UINT32 width,
+                                    UINT32 height)
+{
+	XImage* image = XShmCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, NULL, info,
+	                                width, height);
+
+	if (!image)
+		return NULL;
+
+	image->byte_order = LSBFirst;
+	image->bitmap_bit_order = LSBFirst;
+	return image;
+}
+#endif
+
+BOOL xf_shm_check(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+#ifdef WITH_XSHM
+	return XShmQueryExtension(xfc->display);
+#else
+	return FALSE;
+#endif
+}
+
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height, UINT32 stride)
+{
+#ifdef WITH_XSHM
+	xfShmImage* shm;
+
+	WINPR_ASSERT(xfc);
+
+	if (!xfc->xshmAvailable)
+		return NULL;
+
+	shm = (xfShmImage*)calloc(1, sizeof(xfShmImage));
+
+	if (!shm)
+		return NULL;
+
+	shm->info.shmid = -1;
+
+	if (!(shm->image = xf_shm_create_ximage(xfc, &shm->info, width, height)))
+		goto fail;
+
+	/* The server derives the row length from the image width, widen the image to the stride */
+	if ((UINT32)shm->image->bytes_per_line != stride)
+	{
+		const UINT32 bpp = (UINT32)shm->image->bits_per_pixel;
+
+		XDestroyImage(shm->image);
+		shm->image = NULL;
+
+		if ((bpp < 8) || (((stride * 8) % bpp) != 0))
+			goto fail;
+
+		if (!(shm->image = xf_shm_create_ximage(xfc, &shm->info, stride * 8 / bpp, height)))
+			goto fail;
+
+		if ((UINT32)shm->image->bytes_per_line != stride)
+			goto fail;
+	}
+
+	shm->info.shmid = shmget(IPC_PRIVATE, 1ull * stride * height, IPC_CREAT | 0600);
+
+	if (shm->info.shmid < 0)
+		goto fail;
+
+	shm->info.shmaddr = shmat(shm->info.shmid, NULL, 0);
+
+	if (shm->info.shmaddr == (char*)-1)
+	{
+		shm->info.shmaddr = NULL;
+		shmctl(shm->info.shmid, IPC_RMID, NULL);
+		goto fail;
+	}
+
+	shm->info.readOnly = True;
+	shm->image->data = shm->info.shmaddr;
+
+	if (!xf_shm_attach(xfc, &shm->info))
+	{
+		WLog_WARN(TAG, "XShmAttach failed, falling back to XPutImage");
+		xfc->xshmAvailable = FALSE;
+		goto fail;
+	}
+
+	shm->attached = TRUE;
+	return shm;
+fail:
+	xf_shm_image_free(xfc, shm);
+	return NULL;
+#else
+	WINPR_UNUSED(xfc);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	WINPR_UNUSED(stride);
+	return NULL;
+#endif
+}
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* shm)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!shm)
+		return;
+
+#ifdef WITH_XSHM
+	if (shm->attached)
+	{
+		xf_lock_x11(xfc);
+		XShmDetach(xfc->display, &shm->info);
+		xf_unlock_x11(xfc);
+	}
+
+	if (shm->info.shmaddr)
+		shmdt(shm->info.shmaddr);
+#endif
+
+	if (shm->image)
+	{
+		shm->image->data = NULL;
+		XDestroyImage(shm->image);
+	}
+
+	free(shm);
+}
+
+BYTE* xf_shm_image_data(xfShmImage* shm)
+{
+	WINPR_ASSERT(shm);
+	WINPR_ASSERT(shm->image);
+	return (BYTE*)shm->image->data;
+}
+
+XImage* xf_shm_image_get(xfShmImage* shm)
+{
+	WINPR_ASSERT(shm);
+	return shm->image;
+}
+
+void xf_shm_put_image(xfContext* xfc, Drawable drawable, GC gc, xfShmImage* shm, int src_x,
+                      int src_y, int dst_x, int dst_y, unsigned int width, unsigned int height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(shm);
+
+#ifdef WITH_XSHM
+	XShmPutImage(xfc->display, drawable, gc, shm->image, src_x, src_y, dst_x, dst_y, width,
+	             height, False);
+#else
+	XPutImage(xfc->display, drawable, gc, shm->image, src_x, src_y, dst_x, dst_y, width, height);
+#endif
+}
@@ -0,0 +1,48 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM Output
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_X11_SHM_H
+#define FREERDP_CLIENT_X11_SHM_H
+
+#include "xf_client.h"
+#include "xfreerdp.h"
+
+/*
+ * Images backed by a shared memory segment the X server reads from directly,
+ * pixels do not have to be copied through the X connection.
+ * The caller has to XSync before changing pixels of an area that was put, the
+ * server may read the segment any time until it processed the request.
+ */
+
+/* Returns TRUE if the display supports MIT-SHM, attaching may still fail (e.g. remote displays) */
+BOOL xf_shm_check(xfContext* xfc);
+
+/**
+ * Creates an image of height rows with stride bytes each.
+ * Returns NULL if shared memory is not available, callers fall back to XPutImage.
+ * A failure to attach disables shared memory for the rest of the session.
+ */
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height, UINT32 stride);
+void xf_shm_image_free(xfContext* xfc, xfShmImage* shm);
+
+BYTE* xf_shm_image_data(xfShmImage* shm);
+XImage* xf_shm_image_get(xfShmImage* shm);
+
+void xf_shm_put_image(xfContext* xfc, Drawable drawable, GC gc, xfShmImage* shm, int src_x,
+                      int src_y, int dst_x, int dst_y, unsigned int width, unsigned int height);
+
+#endif /* FREERDP_CLIENT_X11_SHM_H */
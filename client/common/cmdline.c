@@ -741,6 +741,24 @@ fail:
 	return FALSE;
 }
 
+static BOOL set_default_cache_file(rdpSettings* settings, size_t id, const char* name)
+{
+	BOOL rc;
+	char* path;
+
+	if (freerdp_settings_get_string(settings, id))
+		return TRUE;
+
+	path = GetCombinedPath(freerdp_settings_get_string(settings, FreeRDP_ConfigPath), name);
+
+	if (!path)
+		return FALSE;
+
+	rc = freerdp_settings_set_string(settings, id, path);
+	free(path);
+	return rc;
+}
+
 static BOOL read_pem_file(rdpSettings* settings, size_t id, const char* file)
 {
 	INT64 s;
@@ -1990,6 +2008,10 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 		{
 			settings->Decorations = enable;
 		}
+		CommandLineSwitchCase(arg, "dvc-compression")
+		{
+			settings->DynamicChannelCompression = enable;
+		}
 		CommandLineSwitchCase(arg, "dynamic-resolution")
 		{
 			if (settings->SmartSizing)
@@ -2539,6 +2561,14 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 			if (!freerdp_settings_set_uint32(settings, FreeRDP_TcpAckTimeout, (UINT32)val))
 				return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
 		}
+		CommandLineSwitchCase(arg, "input-coalesce")
+		{
+			ULONGLONG val;
+			if (!value_to_uint(arg->Value, &val, 0, 1000))
+				return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+			if (!freerdp_settings_set_uint32(settings, FreeRDP_InputCoalesceInterval, (UINT32)val))
+				return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+		}
 		CommandLineSwitchCase(arg, "aero")
 		{
 			settings->AllowDesktopComposition = enable;
@@ -2625,6 +2655,13 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 			if (enable)
 				settings->SupportGraphicsPipeline = TRUE;
 		}
+		CommandLineSwitchCase(arg, "gfx-direct")
+		{
+			settings->GfxDirectOutput = enable;
+
+			if (enable)
+				settings->SupportGraphicsPipeline = TRUE;
+		}
 		CommandLineSwitchCase(arg, "gfx-progressive")
 		{
 			settings->GfxProgressive = enable;
@@ -2893,6 +2930,10 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 
 			settings->TlsSecLevel = (UINT32)val;
 		}
+		CommandLineSwitchCase(arg, "tls-kernel-offload")
+		{
+			settings->TlsKernelOffload = enable;
+		}
 		CommandLineSwitchCase(arg, "cert")
 		{
 			int rc = 0;
@@ -3077,6 +3118,40 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 		{
 			settings->BitmapCacheEnabled = enable;
 		}
+		CommandLineSwitchCase(arg, "persist-cache")
+		{
+			settings->BitmapCachePersistEnabled = enable;
+
+			if (enable)
+			{
+				if (!set_default_cache_file(settings, FreeRDP_BitmapCachePersistFile,
+				                            "bitmapcache.frbc") ||
+				    !set_default_cache_file(settings, FreeRDP_GfxCachePersistFile,
+				                            "gfxcache.frbc"))
+					return COMMAND_LINE_ERROR_MEMORY;
+			}
+		}
+		CommandLineSwitchCase(arg, "persist-cache-file")
+		{
+			if (!freerdp_settings_set_string(settings, FreeRDP_BitmapCachePersistFile, arg->Value))
+				return COMMAND_LINE_ERROR_MEMORY;
+
+			if (!set_default_cache_file(settings, FreeRDP_GfxCachePersistFile, "gfxcache.frbc"))
+				return COMMAND_LINE_ERROR_MEMORY;
+
+			settings->BitmapCachePersistEnabled = TRUE;
+		}
+		CommandLineSwitchCase(arg, "persist-gfx-cache-file")
+		{
+			if (!freerdp_settings_set_string(settings, FreeRDP_GfxCachePersistFile, arg->Value))
+				return COMMAND_LINE_ERROR_MEMORY;
+
+			if (!set_default_cache_file(settings, FreeRDP_BitmapCachePersistFile,
+			                            "bitmapcache.frbc"))
+				return COMMAND_LINE_ERROR_MEMORY;
+
+			settings->BitmapCachePersistEnabled = TRUE;
+		}
 		CommandLineSwitchCase(arg, "offscreen-cache")
 		{
 			settings->OffscreenSupportLevel = (UINT32)enable;
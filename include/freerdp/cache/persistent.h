@@ -0,0 +1,96 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_PERSISTENT_CACHE_H
+#define FREERDP_PERSISTENT_CACHE_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/settings.h>
+
+#define PERSISTENT_CACHE_VERSION 2
+
+/* [MS-RDPBCGR] 2.2.1.17.1: at most 169 keys per persistent key list PDU */
+#define PERSISTENT_KEYS_MAX_PER_PDU 169
+#define PERSISTENT_KEYS_MAX_TOTAL 262144
+#define PERSISTENT_CACHE_MAX_CELLS 5
+
+typedef struct rdp_persistent_cache rdpPersistentCache;
+
+/**
+ * A single cached bitmap.
+ * When read from a store, data points into the loaded file or a decoded
+ * copy owned by the store and stays valid until persistent_cache_close or
+ * persistent_cache_free.
+ */
+typedef struct
+{
+	UINT64 key64;
+	UINT32 cacheId;
+	UINT32 width;
+	UINT32 height;
+	UINT32 format;
+	UINT32 size;
+	const BYTE* data;
+} PERSISTENT_CACHE_ENTRY;
+
+/**
+ * Tracks which entries of a store, read in file order, are used for the bitmap
+ * cache cells. The persistent key list PDU and the bitmap cache both use it so
+ * the client only advertises the bitmaps it actually loads.
+ */
+typedef struct
+{
+	UINT32 numCells;
+	UINT32 maxEntries[PERSISTENT_CACHE_MAX_CELLS];
+	UINT32 numEntries[PERSISTENT_CACHE_MAX_CELLS];
+	UINT32 total;
+} PERSISTENT_CACHE_LIMITS;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	FREERDP_API BOOL persistent_cache_open(rdpPersistentCache* persistent, const char* filename,
+	                                       BOOL write);
+	FREERDP_API BOOL persistent_cache_close(rdpPersistentCache* persistent);
+
+	FREERDP_API size_t persistent_cache_get_count(const rdpPersistentCache* persistent);
+
+	FREERDP_API int persistent_cache_read_entry(rdpPersistentCache* persistent,
+	                                            PERSISTENT_CACHE_ENTRY* entry);
+	FREERDP_API BOOL persistent_cache_write_entry(rdpPersistentCache* persistent,
+	                                              const PERSISTENT_CACHE_ENTRY* entry);
+
+	FREERDP_API BOOL persistent_cache_limits_init(PERSISTENT_CACHE_LIMITS* limits,
+	                                              const rdpSettings* settings);
+
+	/**
+	 * Returns TRUE if the entry is used, pIndex receives its index in cell cacheId.
+	 */
+	FREERDP_API BOOL persistent_cache_limits_accept(PERSISTENT_CACHE_LIMITS* limits,
+	                                                UINT32 cacheId, UINT32* pIndex);
+
+	FREERDP_API rdpPersistentCache* persistent_cache_new(void);
+	FREERDP_API void persistent_cache_free(rdpPersistentCache* persistent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_PERSISTENT_CACHE_H */
@@ -27,6 +27,12 @@
 
 #define DRDYNVC_SVC_CHANNEL_NAME "drdynvc"
 
+/* MS-RDPEDYC 3.1.5.1.4 compressed data uses RDP 8.0 bulk compression with an 8 KB
+ * history shared by all channels of one direction, each PDU carries at most 1590
+ * uncompressed bytes. */
+#define DRDYNVC_COMPRESSION_HISTORY_SIZE 8192
+#define DRDYNVC_COMPRESSED_MAX_SIZE 1590
+
 /* defined in MS-RDPEDYC 2.2.5.1 Soft-Sync Request PDU (DYNVC_SOFT_SYNC_REQUEST) */
 enum
 {
@@ -302,6 +302,9 @@ typedef struct
 	UINT32 targetHeight;
 } RDPGFX_MAP_SURFACE_TO_SCALED_OUTPUT_PDU;
 
+/* [MS-RDPEGFX] 2.2.2.16: at most 5462 entries per cache import offer */
+#define RDPGFX_CACHE_ENTRY_MAX_COUNT 5462
+
 typedef struct
 {
 	UINT64 cacheKey;
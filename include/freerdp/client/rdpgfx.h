@@ -24,6 +24,7 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/channels/rdpgfx.h>
+#include <freerdp/cache/persistent.h>
 #include <freerdp/utils/profiler.h>
 
 /**
@@ -60,6 +61,10 @@ typedef UINT (*pcRdpgfxCacheImportReply)(RdpgfxClientContext* context,
                                          const RDPGFX_CACHE_IMPORT_REPLY_PDU* cacheImportReply);
 typedef UINT (*pcRdpgfxEvictCacheEntry)(RdpgfxClientContext* context,
                                         const RDPGFX_EVICT_CACHE_ENTRY_PDU* evictCacheEntry);
+typedef UINT (*pcRdpgfxImportCacheEntry)(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                         const PERSISTENT_CACHE_ENTRY* importCacheEntry);
+typedef UINT (*pcRdpgfxExportCacheEntry)(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                         PERSISTENT_CACHE_ENTRY* exportCacheEntry);
 typedef UINT (*pcRdpgfxMapSurfaceToOutput)(RdpgfxClientContext* context,
                                            const RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU* surfaceToOutput);
 typedef UINT (*pcRdpgfxMapSurfaceToScaledOutput)(
@@ -117,6 +122,8 @@ struct s_rdpgfx_client_context
 	pcRdpgfxCacheImportOffer CacheImportOffer;
 	pcRdpgfxCacheImportReply CacheImportReply;
 	pcRdpgfxEvictCacheEntry EvictCacheEntry;
+	pcRdpgfxImportCacheEntry ImportCacheEntry;
+	pcRdpgfxExportCacheEntry ExportCacheEntry;
 	pcRdpgfxMapSurfaceToOutput MapSurfaceToOutput;
 	pcRdpgfxMapSurfaceToScaledOutput MapSurfaceToScaledOutput;
 	pcRdpgfxMapSurfaceToWindow MapSurfaceToWindow;
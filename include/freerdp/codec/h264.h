@@ -49,12 +49,10 @@ typedef struct
 	UINT32 NumberOfThreads;
 
 	UINT32 iStride[3];
-	BYTE* pOldYUVData[3];
 	BYTE* pYUVData[3];
 
 	UINT32 iYUV444Size[3];
 	UINT32 iYUV444Stride[3];
-	BYTE* pOldYUV444Data[3];
 	BYTE* pYUV444Data[3];
 
 	UINT32 numSystemData;
@@ -62,12 +60,23 @@ typedef struct
 	const H264_CONTEXT_SUBSYSTEM* subsystem;
 	YUV_CONTEXT* yuv;
 
-	BOOL encodingBuffer;
 	BOOL firstLumaFrameDone;
 	BOOL firstChromaFrameDone;
 
 	void* lumaData;
 	wLog* log;
+
+	/* Encoder change detection, done on the source frame before color conversion.
+	 * pOldSrcData holds the source as of the last encoded frame, changedRects is a
+	 * scratch buffer reused between frames. */
+	BYTE* pOldSrcData;
+	size_t OldSrcSize;
+	UINT32 OldSrcStep;
+	BOOL OldSrcValid;
+	RECTANGLE_16* changedRects;
+	size_t maxChangedRects;
+	BOOL (*TileEqual)(const BYTE* pData1, const BYTE* pData2, UINT32 nStep, UINT32 nWidth,
+	                  UINT32 nHeight);
 } H264_CONTEXT;
 
 #ifdef __cplusplus
@@ -85,6 +94,8 @@ extern "C"
 		*meta = m;
 	}
 
+	/* The metablocks filled by avc420_compress and avc444_compress are owned by the
+	 * caller and must be released with free_h264_metablock. */
 	FREERDP_API INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                                  UINT32 nSrcStep, UINT32 nSrcWidth, UINT32 nSrcHeight,
 	                                  const RECTANGLE_16* regionRect, BYTE** ppDstData,
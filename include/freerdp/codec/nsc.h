@@ -66,6 +66,7 @@ extern "C"
 
 	FREERDP_API BOOL nsc_context_reset(NSC_CONTEXT* context, UINT32 width, UINT32 height);
 
+	FREERDP_API NSC_CONTEXT* nsc_context_new_ex(UINT32 ThreadingFlags);
 	FREERDP_API NSC_CONTEXT* nsc_context_new(void);
 	FREERDP_API void nsc_context_free(NSC_CONTEXT* context);
 
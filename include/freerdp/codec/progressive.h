@@ -43,6 +43,8 @@ extern "C"
 	                                     const REGION16* invalidRegion, BYTE** ppDstData,
 	                                     UINT32* pDstSize);
 
+	FREERDP_API BOOL progressive_compress_pending(PROGRESSIVE_CONTEXT* progressive);
+
 	FREERDP_API INT32 progressive_decompress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData,
 	                                         UINT32 SrcSize, BYTE* pDstData, UINT32 DstFormat,
 	                                         UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
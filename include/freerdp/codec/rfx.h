@@ -189,6 +189,13 @@ extern "C"
 	FREERDP_API BOOL rfx_write_message(RFX_CONTEXT* context, wStream* s,
 	                                   const RFX_MESSAGE* message);
 
+	/**
+	 * Writes the sync, context, codec versions and channels blocks that
+	 * rfx_write_message prepends to the first message of a context.
+	 * The context state is not changed.
+	 */
+	FREERDP_API BOOL rfx_write_message_header(RFX_CONTEXT* context, wStream* s);
+
 	FREERDP_API BOOL rfx_context_reset(RFX_CONTEXT* context, UINT32 width, UINT32 height);
 
 	FREERDP_API RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags);
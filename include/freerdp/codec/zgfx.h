@@ -32,6 +32,11 @@
 
 #define ZGFX_SEGMENTED_MAXSIZE 65535
 
+#define ZGFX_COMPRESSION_LEVEL_NONE 0
+#define ZGFX_COMPRESSION_LEVEL_FAST 1
+#define ZGFX_COMPRESSION_LEVEL_DEFAULT 2
+#define ZGFX_COMPRESSION_LEVEL_BEST 3
+
 typedef struct S_ZGFX_CONTEXT ZGFX_CONTEXT;
 
 #ifdef __cplusplus
@@ -47,9 +52,30 @@ extern "C"
 	                                        const BYTE* pUncompressed, UINT32 uncompressedSize,
 	                                        UINT32* pFlags);
 
+	/**
+	 * Compress SrcSize bytes (at most ZGFX_SEGMENTED_MAXSIZE) into a single
+	 * RDP8_BULK_ENCODED_DATA segment without the segmented descriptor, as used
+	 * by compressed dynamic virtual channel PDUs.
+	 */
+	FREERDP_API BOOL zgfx_compress_segment_to_stream(ZGFX_CONTEXT* zgfx, wStream* sDst,
+	                                                 const BYTE* pSrcData, UINT32 SrcSize);
+
+	/**
+	 * Decompress a single RDP8_BULK_ENCODED_DATA segment and append the result to sDst.
+	 */
+	FREERDP_API BOOL zgfx_decompress_segment_to_stream(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData,
+	                                                   UINT32 SrcSize, wStream* sDst);
+
 	FREERDP_API void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush);
+	FREERDP_API BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* zgfx, UINT32 level);
 
 	FREERDP_API ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor);
+
+	/**
+	 * Create a context with a history of HistorySize bytes instead of the 2.5 MB
+	 * of the graphics pipeline, both peers must agree on the size.
+	 */
+	FREERDP_API ZGFX_CONTEXT* zgfx_context_new_ex(BOOL Compressor, UINT32 HistorySize);
 	FREERDP_API void zgfx_context_free(ZGFX_CONTEXT* zgfx);
 
 #ifdef __cplusplus
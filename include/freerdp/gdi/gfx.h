@@ -42,6 +42,14 @@ struct gdi_gfx_surface
 	UINT64 windowId;
 	UINT32 outputTargetWidth;
 	UINT32 outputTargetHeight;
+
+	/* Buffer allocated by gdi_CreateSurface. While outputDirect is set, data, scanline,
+	 * width and height describe the surface area inside the GDI primary buffer instead. */
+	BYTE* buffer;
+	UINT32 bufferScanline;
+	UINT32 bufferWidth;
+	UINT32 bufferHeight;
+	BOOL outputDirect;
 };
 typedef struct gdi_gfx_surface gdiGfxSurface;
 
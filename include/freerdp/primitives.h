@@ -59,8 +59,9 @@ typedef INT32 pstatus_t;       /* match IppStatus. */
 /** @brief flags of primitives */
 enum
 {
-	PRIM_FLAGS_HAVE_EXTCPU = (1U << 0), /* primitives are using CPU extensions */
-	PRIM_FLAGS_HAVE_EXTGPU = (1U << 1), /* primitives are using the GPU */
+	PRIM_FLAGS_HAVE_EXTCPU = (1U << 0),  /* primitives are using CPU extensions */
+	PRIM_FLAGS_HAVE_EXTGPU = (1U << 1),  /* primitives are using the GPU */
+	PRIM_FLAGS_HAVE_EXTAVX2 = (1U << 2), /* primitives are using AVX2 */
 };
 
 /* Structures compatible with IPP */
@@ -55,6 +55,9 @@ struct proxy_config
 	BOOL ClientRdpSecurity;
 	BOOL ClientAllowFallbackToTls;
 
+	/* kernel TLS for both connections */
+	BOOL TlsKernelOffload;
+
 	/* channels */
 	BOOL GFX;
 	BOOL DisplayControl;
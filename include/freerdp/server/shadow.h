@@ -130,6 +130,7 @@ struct rdp_shadow_server
 	rdpShadowSurface* lobby;
 	rdpShadowCapture* capture;
 	rdpShadowSubsystem* subsystem;
+	wArrayList* encoderGroups;
 
 	DWORD port;
 	BOOL mayView;
@@ -154,6 +155,15 @@ struct rdp_shadow_server
 	freerdp_listener* listener;
 };
 
+typedef struct
+{
+	UINT64 frames;    /* published frames */
+	UINT64 captureMs; /* subsystem capture time between two published frames */
+	UINT64 stallMs;   /* capture waiting for the clients to finish the previous frame */
+	UINT64 publishMs; /* copying the damaged area into the published frame */
+	UINT64 encodeMs;  /* encoding and sending, summed over all clients */
+} SHADOW_SURFACE_STATS;
+
 struct rdp_shadow_surface
 {
 	rdpShadowServer* server;
@@ -168,6 +178,18 @@ struct rdp_shadow_surface
 
 	CRITICAL_SECTION lock;
 	REGION16 invalidRegion;
+	UINT64 generation; /* incremented for every frame published to the clients */
+
+	/* Copy of the last published frame, the clients encode from it without
+	 * holding the lock while the subsystem captures the next frame into data */
+	BYTE* frameData;
+	UINT32 frameWidth;
+	UINT32 frameHeight;
+	UINT32 frameScanline;
+	REGION16 frameRegion;
+
+	SHADOW_SURFACE_STATS stats;
+	UINT64 lastPublished;
 };
 
 struct S_RDP_SHADOW_ENTRY_POINTS
@@ -311,6 +333,17 @@ extern "C"
 	                                       UINT32 nHeight, BYTE* pData2, UINT32 nStep2,
 	                                       RECTANGLE_16* rect);
 
+	/**
+	 * Compares two frames in 16x16 tiles and stores the differing tiles in region.
+	 * capture may be NULL, otherwise its state is reused between calls and large
+	 * frames are compared in parallel stripes.
+	 * Returns 1 if the frames differ, 0 if they are equal and -1 on failure.
+	 */
+	FREERDP_API int shadow_capture_compare_region(rdpShadowCapture* capture, const BYTE* pData1,
+	                                              UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+	                                              const BYTE* pData2, UINT32 nStep2,
+	                                              REGION16* region);
+
 	FREERDP_API void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem);
 
 	FREERDP_API BOOL shadow_client_post_msg(rdpShadowClient* client, void* context, UINT32 type,
@@ -587,6 +587,7 @@ typedef struct
 #define FreeRDP_ForceEncryptedCsPdu (719)
 #define FreeRDP_HiDefRemoteApp (720)
 #define FreeRDP_CompressionLevel (721)
+#define FreeRDP_CompressionAdaptive (722)
 #define FreeRDP_IPv6Enabled (768)
 #define FreeRDP_ClientAddress (769)
 #define FreeRDP_ClientDir (770)
@@ -635,6 +636,7 @@ typedef struct
 #define FreeRDP_NtlmSamFile (1103)
 #define FreeRDP_FIPSMode (1104)
 #define FreeRDP_TlsSecLevel (1105)
+#define FreeRDP_TlsKernelOffload (1106)
 #define FreeRDP_MstscCookieMode (1152)
 #define FreeRDP_CookieMaxLength (1153)
 #define FreeRDP_PreconnectionId (1154)
@@ -802,6 +804,7 @@ typedef struct
 #define FreeRDP_BitmapCachePersistEnabled (2500)
 #define FreeRDP_BitmapCacheV2NumCells (2501)
 #define FreeRDP_BitmapCacheV2CellInfo (2502)
+#define FreeRDP_BitmapCachePersistFile (2503)
 #define FreeRDP_ColorPointerFlag (2560)
 #define FreeRDP_PointerCacheSize (2561)
 #define FreeRDP_KeyboardRemappingList (2622)
@@ -819,6 +822,7 @@ typedef struct
 #define FreeRDP_HasHorizontalWheel (2634)
 #define FreeRDP_HasExtendedMouseEvent (2635)
 #define FreeRDP_SuspendInput (2636)
+#define FreeRDP_InputCoalesceInterval (2637)
 #define FreeRDP_BrushSupportLevel (2688)
 #define FreeRDP_GlyphSupportLevel (2752)
 #define FreeRDP_GlyphCache (2753)
@@ -860,6 +864,9 @@ typedef struct
 #define FreeRDP_GfxAVC444v2 (3847)
 #define FreeRDP_GfxCapsFilter (3848)
 #define FreeRDP_GfxPlanar (3849)
+#define FreeRDP_GfxClearCodec (3850)
+#define FreeRDP_GfxCachePersistFile (3851)
+#define FreeRDP_GfxDirectOutput (3852)
 #define FreeRDP_BitmapCacheV3CodecId (3904)
 #define FreeRDP_DrawNineGridEnabled (3968)
 #define FreeRDP_DrawNineGridCacheSize (3969)
@@ -886,6 +893,7 @@ typedef struct
 #define FreeRDP_DynamicChannelArraySize (5057)
 #define FreeRDP_DynamicChannelArray (5058)
 #define FreeRDP_SupportDynamicChannels (5059)
+#define FreeRDP_DynamicChannelCompression (5060)
 #define FreeRDP_SupportEchoChannel (5184)
 #define FreeRDP_SupportDisplayControl (5185)
 #define FreeRDP_SupportGeometryTracking (5186)
@@ -1049,7 +1057,13 @@ struct rdp_settings
 	ALIGN64 BOOL ForceEncryptedCsPdu;    /* 719 */
 	ALIGN64 BOOL HiDefRemoteApp;         /* 720 */
 	ALIGN64 UINT32 CompressionLevel;     /* 721 */
-	UINT64 padding0768[768 - 722];       /* 722 */
+
+	/** CompressionAdaptive lets a server pick the bulk compressor per PDU.
+	 * Incompressible updates are sent raw, the other levels up to CompressionLevel
+	 * are chosen by measured ratio, CPU time and the autodetected bandwidth.
+	 */
+	ALIGN64 BOOL CompressionAdaptive; /* 722 */
+	UINT64 padding0768[768 - 723];    /* 723 */
 
 	/* Client Info (Extra) */
 	ALIGN64 BOOL IPv6Enabled;      /* 768 */
@@ -1119,7 +1133,8 @@ struct rdp_settings
 	ALIGN64 char* NtlmSamFile;                 /* 1103 */
 	ALIGN64 BOOL FIPSMode;                     /* 1104 */
 	ALIGN64 UINT32 TlsSecLevel;                /* 1105 */
-	UINT64 padding1152[1152 - 1106];           /* 1106 */
+	ALIGN64 BOOL TlsKernelOffload;             /* 1106 */
+	UINT64 padding1152[1152 - 1107];           /* 1107 */
 
 	/* Connection Cookie */
 	ALIGN64 BOOL MstscCookieMode;      /* 1152 */
@@ -1372,7 +1387,8 @@ struct rdp_settings
 	ALIGN64 BOOL BitmapCachePersistEnabled;                   /* 2500 */
 	ALIGN64 UINT32 BitmapCacheV2NumCells;                     /* 2501 */
 	ALIGN64 BITMAP_CACHE_V2_CELL_INFO* BitmapCacheV2CellInfo; /* 2502 */
-	UINT64 padding2560[2560 - 2503];                          /* 2503 */
+	ALIGN64 char* BitmapCachePersistFile;                     /* 2503 */
+	UINT64 padding2560[2560 - 2504];                          /* 2504 */
 
 	/* Pointer Capabilities */
 	ALIGN64 BOOL ColorPointerFlag;   /* 2560 */
@@ -1399,8 +1415,13 @@ struct rdp_settings
 	 * If used by an implementation ensure proper state resync after reenabling
 	 * input
 	 */
-	ALIGN64 BOOL SuspendInput;       /* 2636 */
-	UINT64 padding2688[2688 - 2637]; /* 2637 */
+	ALIGN64 BOOL SuspendInput; /* 2636 */
+
+	/** InputCoalesceInterval limits fast-path mouse moves to one PDU per interval (ms).
+	 * Moves in between are merged into the next PDU, 0 sends every move.
+	 */
+	ALIGN64 UINT32 InputCoalesceInterval; /* 2637 */
+	UINT64 padding2688[2688 - 2638];      /* 2638 */
 
 	/* Brush Capabilities */
 	ALIGN64 UINT32 BrushSupportLevel; /* 2688 */
@@ -1491,17 +1512,26 @@ struct rdp_settings
 	ALIGN64 UINT32 JpegQuality;      /* 3778 */
 	UINT64 padding3840[3840 - 3779]; /* 3779 */
 
-	ALIGN64 BOOL GfxThinClient;      /* 3840 */
-	ALIGN64 BOOL GfxSmallCache;      /* 3841 */
-	ALIGN64 BOOL GfxProgressive;     /* 3842 */
-	ALIGN64 BOOL GfxProgressiveV2;   /* 3843 */
-	ALIGN64 BOOL GfxH264;            /* 3844 */
-	ALIGN64 BOOL GfxAVC444;          /* 3845 */
-	ALIGN64 BOOL GfxSendQoeAck;      /* 3846 */
-	ALIGN64 BOOL GfxAVC444v2;        /* 3847 */
-	ALIGN64 UINT32 GfxCapsFilter;    /* 3848 */
-	ALIGN64 BOOL GfxPlanar;          /* 3849 */
-	UINT64 padding3904[3904 - 3850]; /* 3850 */
+	ALIGN64 BOOL GfxThinClient;        /* 3840 */
+	ALIGN64 BOOL GfxSmallCache;        /* 3841 */
+	ALIGN64 BOOL GfxProgressive;       /* 3842 */
+	ALIGN64 BOOL GfxProgressiveV2;     /* 3843 */
+	ALIGN64 BOOL GfxH264;              /* 3844 */
+	ALIGN64 BOOL GfxAVC444;            /* 3845 */
+	ALIGN64 BOOL GfxSendQoeAck;        /* 3846 */
+	ALIGN64 BOOL GfxAVC444v2;          /* 3847 */
+	ALIGN64 UINT32 GfxCapsFilter;      /* 3848 */
+	ALIGN64 BOOL GfxPlanar;            /* 3849 */
+	ALIGN64 BOOL GfxClearCodec;        /* 3850 */
+	ALIGN64 char* GfxCachePersistFile; /* 3851 */
+
+	/** GfxDirectOutput lets surfaces mapped 1:1 to the output decode straight into the
+	 * GDI primary buffer instead of copying them there on every update.
+	 * The primary buffer must only be read from EndPaint and only be resized from
+	 * DesktopResize while enabled.
+	 */
+	ALIGN64 BOOL GfxDirectOutput;    /* 3852 */
+	UINT64 padding3904[3904 - 3853]; /* 3853 */
 
 	/**
 	 * Caches
@@ -1578,7 +1608,13 @@ struct rdp_settings
 	ALIGN64 UINT32 DynamicChannelArraySize;   /* 5057 */
 	ALIGN64 ADDIN_ARGV** DynamicChannelArray; /* 5058 */
 	ALIGN64 BOOL SupportDynamicChannels;      /* 5059 */
-	UINT64 padding5184[5184 - 5060];          /* 5060 */
+
+	/** DynamicChannelCompression offers DVC capability version 3 and sends dynamic
+	 * channel data RDP8 bulk compressed if the peer negotiated it.
+	 * Compressed data received from the peer is always accepted.
+	 */
+	ALIGN64 BOOL DynamicChannelCompression; /* 5060 */
+	UINT64 padding5184[5184 - 5061];        /* 5061 */
 
 	ALIGN64 BOOL SupportEchoChannel;      /* 5184 */
 	ALIGN64 BOOL SupportDisplayControl;   /* 5185 */
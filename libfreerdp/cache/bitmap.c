@@ -42,6 +42,7 @@
 static rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index);
 static BOOL bitmap_cache_put(rdpBitmapCache* bitmap_cache, UINT32 id, UINT32 index,
                              rdpBitmap* bitmap);
+static rdpBitmap* bitmap_cache_get_or_load(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index);
 
 static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 {
@@ -53,7 +54,8 @@ static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 	if (memblt->cacheId == 0xFF)
 		bitmap = offscreen_cache_get(cache->offscreen, memblt->cacheIndex);
 	else
-		bitmap = bitmap_cache_get(cache->bitmap, (BYTE)memblt->cacheId, memblt->cacheIndex);
+		bitmap =
+		    bitmap_cache_get_or_load(cache->bitmap, (BYTE)memblt->cacheId, memblt->cacheIndex);
 
 	/* XP-SP2 servers sometimes ask for cached bitmaps they've never defined. */
 	if (bitmap == NULL)
@@ -74,7 +76,8 @@ static BOOL update_gdi_mem3blt(rdpContext* context, MEM3BLT_ORDER* mem3blt)
 	if (mem3blt->cacheId == 0xFF)
 		bitmap = offscreen_cache_get(cache->offscreen, mem3blt->cacheIndex);
 	else
-		bitmap = bitmap_cache_get(cache->bitmap, (BYTE)mem3blt->cacheId, mem3blt->cacheIndex);
+		bitmap =
+		    bitmap_cache_get_or_load(cache->bitmap, (BYTE)mem3blt->cacheId, mem3blt->cacheIndex);
 
 	/* XP-SP2 servers sometimes ask for cached bitmaps they've never defined. */
 	if (!bitmap)
@@ -150,6 +153,9 @@ static BOOL update_gdi_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDE
 
 	Bitmap_SetDimensions(bitmap, cacheBitmapV2->bitmapWidth, cacheBitmapV2->bitmapHeight);
 
+	if (cacheBitmapV2->flags & CBR2_PERSISTENT_KEY_PRESENT)
+		bitmap->key64 = ((UINT64)cacheBitmapV2->key2 << 32) | cacheBitmapV2->key1;
+
 	if (!bitmap->Decompress(context, bitmap, cacheBitmapV2->bitmapDataStream,
 	                        cacheBitmapV2->bitmapWidth, cacheBitmapV2->bitmapHeight,
 	                        cacheBitmapV2->bitmapBpp, cacheBitmapV2->bitmapLength,
@@ -189,6 +195,7 @@ static BOOL update_gdi_cache_bitmap_v3(rdpContext* context, CACHE_BITMAP_V3_ORDE
 
 	compressed = (bitmapData->codecID != RDP_CODEC_ID_NONE);
 	Bitmap_SetDimensions(bitmap, bitmapData->width, bitmapData->height);
+	bitmap->key64 = ((UINT64)cacheBitmapV3->key2 << 32) | cacheBitmapV3->key1;
 
 	if (!bitmap->Decompress(context, bitmap, bitmapData->data, bitmapData->width,
 	                        bitmapData->height, bitmapData->bpp, bitmapData->length, compressed,
@@ -234,7 +241,7 @@ rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index
 
 BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpBitmap* bitmap)
 {
-	if (id > bitmapCache->maxCells)
+	if (id >= bitmapCache->maxCells)
 	{
 		WLog_ERR(TAG, "put invalid bitmap cell id: %" PRIu32 "", id);
 		return FALSE;
@@ -251,9 +258,205 @@ BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpB
 	}
 
 	bitmapCache->cells[id].entries[index] = bitmap;
+
+	/* The server replaced the slot, forget the bitmap loaded from disk */
+	if (bitmapCache->persistentEntries && (index < bitmapCache->cells[id].number))
+		bitmapCache->persistentEntries[id][index].data = NULL;
+
 	return TRUE;
 }
 
+static BOOL bitmap_cache_persist_enabled(rdpBitmapCache* bitmapCache)
+{
+	const rdpSettings* settings = bitmapCache->context->settings;
+
+	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
+		return FALSE;
+
+	return freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile) != NULL;
+}
+
+static rdpBitmap* bitmap_cache_get_or_load(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index)
+{
+	rdpBitmap* bitmap;
+	PERSISTENT_CACHE_ENTRY* entry;
+	rdpContext* context = bitmapCache->context;
+
+	bitmap = bitmap_cache_get(bitmapCache, id, index);
+
+	if (bitmap || !bitmapCache->persistentEntries)
+		return bitmap;
+
+	if ((id >= bitmapCache->maxCells) || (index >= bitmapCache->cells[id].number))
+		return NULL;
+
+	/* Bitmaps advertised in the persistent key list are only decoded on first use */
+	entry = &bitmapCache->persistentEntries[id][index];
+
+	if (!entry->data)
+		return NULL;
+
+	bitmap = Bitmap_Alloc(context);
+
+	if (!bitmap)
+		return NULL;
+
+	Bitmap_SetDimensions(bitmap, (UINT16)entry->width, (UINT16)entry->height);
+	bitmap->format = entry->format;
+	bitmap->length = entry->size;
+	bitmap->key64 = entry->key64;
+	bitmap->data = (BYTE*)_aligned_malloc(entry->size, 16);
+
+	if (!bitmap->data)
+		goto fail;
+
+	CopyMemory(bitmap->data, entry->data, entry->size);
+
+	if (!bitmap->New(context, bitmap))
+		goto fail;
+
+	if (!bitmap_cache_put(bitmapCache, id, index, bitmap))
+		goto fail;
+
+	return bitmap;
+fail:
+	Bitmap_Free(context, bitmap);
+	return NULL;
+}
+
+static void bitmap_cache_free_persistent(rdpBitmapCache* bitmapCache)
+{
+	UINT32 i;
+
+	if (bitmapCache->persistentEntries)
+	{
+		for (i = 0; i < bitmapCache->maxCells; i++)
+			free(bitmapCache->persistentEntries[i]);
+	}
+
+	free(bitmapCache->persistentEntries);
+	persistent_cache_free(bitmapCache->persistent);
+	bitmapCache->persistentEntries = NULL;
+	bitmapCache->persistent = NULL;
+}
+
+static void bitmap_cache_load_persistent(rdpBitmapCache* bitmapCache)
+{
+	UINT32 i;
+	int status;
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+	PERSISTENT_CACHE_LIMITS limits = { 0 };
+	const char* filename;
+
+	if (!bitmap_cache_persist_enabled(bitmapCache))
+		return;
+
+	filename = freerdp_settings_get_string(bitmapCache->context->settings,
+	                                       FreeRDP_BitmapCachePersistFile);
+	bitmapCache->persistentEntries =
+	    (PERSISTENT_CACHE_ENTRY**)calloc(bitmapCache->maxCells, sizeof(PERSISTENT_CACHE_ENTRY*));
+	bitmapCache->persistent = persistent_cache_new();
+
+	if (!bitmapCache->persistentEntries || !bitmapCache->persistent ||
+	    !persistent_cache_limits_init(&limits, bitmapCache->context->settings))
+		goto fail;
+
+	for (i = 0; i < bitmapCache->maxCells; i++)
+	{
+		bitmapCache->persistentEntries[i] = (PERSISTENT_CACHE_ENTRY*)calloc(
+		    bitmapCache->cells[i].number, sizeof(PERSISTENT_CACHE_ENTRY));
+
+		if (!bitmapCache->persistentEntries[i])
+			goto fail;
+	}
+
+	/* A missing store is not an error, it is created on disconnect */
+	if (!persistent_cache_open(bitmapCache->persistent, filename, FALSE))
+		return;
+
+	/* Same assignment as the persistent key list PDU, see persistent_cache_limits_accept */
+	while ((status = persistent_cache_read_entry(bitmapCache->persistent, &entry)) > 0)
+	{
+		UINT32 index = 0;
+
+		if (!persistent_cache_limits_accept(&limits, entry.cacheId, &index))
+			continue;
+
+		if ((entry.cacheId >= bitmapCache->maxCells) ||
+		    (index >= bitmapCache->cells[entry.cacheId].number))
+			continue;
+
+		bitmapCache->persistentEntries[entry.cacheId][index] = entry;
+	}
+
+	if (status < 0)
+		goto fail;
+
+	WLog_DBG(TAG, "loaded %" PRIu32 " bitmaps from persistent cache %s", limits.total, filename);
+	return;
+fail:
+	WLog_WARN(TAG, "failed to load persistent cache %s", filename);
+	bitmap_cache_free_persistent(bitmapCache);
+}
+
+static void bitmap_cache_save_persistent(rdpBitmapCache* bitmapCache)
+{
+	UINT32 i, j;
+	BOOL rc = TRUE;
+	rdpPersistentCache* persistent;
+	const char* filename;
+
+	/* Only set up when persistence is enabled and the cache was fully created */
+	if (!bitmapCache->persistentEntries)
+		return;
+
+	filename = freerdp_settings_get_string(bitmapCache->context->settings,
+	                                       FreeRDP_BitmapCachePersistFile);
+	persistent = persistent_cache_new();
+
+	if (!persistent)
+		return;
+
+	if (!persistent_cache_open(persistent, filename, TRUE))
+		goto out;
+
+	for (i = 0; rc && (i < bitmapCache->maxCells); i++)
+	{
+		const BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
+
+		for (j = 0; rc && (j < cell->number); j++)
+		{
+			PERSISTENT_CACHE_ENTRY entry = { 0 };
+			const rdpBitmap* bitmap = cell->entries[j];
+
+			if (bitmap && bitmap->key64 && bitmap->data)
+			{
+				entry.key64 = bitmap->key64;
+				entry.cacheId = i;
+				entry.width = bitmap->width;
+				entry.height = bitmap->height;
+				entry.format = bitmap->format;
+				entry.size = bitmap->length;
+				entry.data = bitmap->data;
+			}
+			else if (!bitmap)
+				entry = bitmapCache->persistentEntries[i][j];
+
+			if (entry.data)
+				rc = persistent_cache_write_entry(persistent, &entry);
+		}
+	}
+
+	if (rc)
+		rc = persistent_cache_close(persistent);
+
+	if (!rc)
+		WLog_WARN(TAG, "failed to save persistent cache %s", filename);
+
+out:
+	persistent_cache_free(persistent);
+}
+
 void bitmap_cache_register_callbacks(rdpUpdate* update)
 {
 	rdpCache* cache;
@@ -317,6 +520,7 @@ rdpBitmapCache* bitmap_cache_new(rdpContext* context)
 		cell->number = nr;
 	}
 
+	bitmap_cache_load_persistent(bitmapCache);
 	return bitmapCache;
 fail:
 
@@ -329,6 +533,10 @@ void bitmap_cache_free(rdpBitmapCache* bitmapCache)
 	if (bitmapCache)
 	{
 		UINT32 i;
+
+		bitmap_cache_save_persistent(bitmapCache);
+		bitmap_cache_free_persistent(bitmapCache);
+
 		for (i = 0; i < bitmapCache->maxCells; i++)
 		{
 			UINT32 j;
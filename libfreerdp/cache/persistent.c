@@ -0,0 +1,562 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/stream.h>
+#include <winpr/synch.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/zgfx.h>
+#include <freerdp/cache/persistent.h>
+
+#define TAG FREERDP_TAG("cache.persistent")
+
+/**
+ * On disk layout, all values little endian:
+ *
+ * header: signature (4 bytes), version (4 bytes), count (4 bytes), reserved (4 bytes)
+ * entry:  key64 (8 bytes), cacheId (2 bytes), width (2 bytes), height (2 bytes),
+ *         flags (2 bytes), format (4 bytes), size (4 bytes), length (4 bytes),
+ *         crc32 (4 bytes), followed by length bytes of pixel data
+ *
+ * Pixel data is stored ZGFX compressed when that is smaller than the raw
+ * bitmap, each entry with a fresh history so it can be decoded on its own.
+ * The checksum covers the stored bytes.
+ *
+ * The whole file is loaded with a single read and uncompressed entries
+ * reference the data in place. Entries with a bad checksum are skipped.
+ * Files are written to a temporary file which replaces the store on close.
+ */
+#define PERSISTENT_CACHE_SIGNATURE 0x43425246 /* "FRBC" */
+#define PERSISTENT_CACHE_HEADER_LENGTH 16
+#define PERSISTENT_CACHE_ENTRY_LENGTH 32
+#define PERSISTENT_CACHE_ENTRY_COMPRESSED 0x0001
+#define PERSISTENT_CACHE_MAX_FILE_SIZE (1024ull * 1024ull * 1024ull)
+
+/* Entries are compressed independently, a larger history would not find more matches
+ * in most of them but costs window and hash chain memory. */
+#define PERSISTENT_CACHE_ZGFX_HISTORY (64 * 1024)
+
+struct rdp_persistent_cache
+{
+	FILE* fp;
+	BOOL write;
+	char* filename;
+	char* tmpname;
+	BYTE* buffer;
+	size_t length;
+	size_t offset;
+	size_t count;
+	ZGFX_CONTEXT* compressor;
+	ZGFX_CONTEXT* decompressor;
+	wStream* compressed;
+	BYTE** decoded;
+	size_t decodedCount;
+	size_t decodedSize;
+};
+
+static INIT_ONCE persistent_crc32_init_once = INIT_ONCE_STATIC_INIT;
+static UINT32 persistent_crc32_table[256];
+
+static BOOL CALLBACK persistent_crc32_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	UINT32 i, j;
+
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	for (i = 0; i < 256; i++)
+	{
+		UINT32 crc = i;
+
+		for (j = 0; j < 8; j++)
+			crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+
+		persistent_crc32_table[i] = crc;
+	}
+
+	return TRUE;
+}
+
+static UINT32 persistent_crc32(const BYTE* data, size_t length)
+{
+	size_t i;
+	UINT32 crc = 0xFFFFFFFF;
+
+	InitOnceExecuteOnce(&persistent_crc32_init_once, persistent_crc32_init, NULL, NULL);
+
+	for (i = 0; i < length; i++)
+		crc = persistent_crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+static BOOL persistent_cache_entry_valid(UINT32 width, UINT32 height, UINT32 format, UINT32 size)
+{
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+
+	if ((bpp == 0) || (width == 0) || (height == 0))
+		return FALSE;
+
+	return (1ull * width * height * bpp) == size;
+}
+
+/**
+ * Compress a bitmap into persistent->compressed.
+ * @return TRUE if the compressed form is smaller than the bitmap
+ */
+static BOOL persistent_cache_compress(rdpPersistentCache* persistent, const BYTE* data, UINT32 size)
+{
+	UINT32 flags = 0;
+
+	if (!persistent->compressor)
+	{
+		persistent->compressor = zgfx_context_new_ex(TRUE, PERSISTENT_CACHE_ZGFX_HISTORY);
+
+		if (!persistent->compressor ||
+		    !zgfx_context_set_compression_level(persistent->compressor,
+		                                        ZGFX_COMPRESSION_LEVEL_FAST))
+			return FALSE;
+	}
+
+	if (!persistent->compressed)
+	{
+		persistent->compressed = Stream_New(NULL, size);
+
+		if (!persistent->compressed)
+			return FALSE;
+	}
+
+	Stream_SetPosition(persistent->compressed, 0);
+	zgfx_context_reset(persistent->compressor, FALSE);
+
+	if (zgfx_compress_to_stream(persistent->compressor, persistent->compressed, data, size,
+	                            &flags) < 0)
+		return FALSE;
+
+	return Stream_GetPosition(persistent->compressed) < size;
+}
+
+/**
+ * Decompress a stored bitmap. The result is owned by the store and released
+ * when it is closed.
+ */
+static const BYTE* persistent_cache_decompress(rdpPersistentCache* persistent, const BYTE* data,
+                                               UINT32 length, UINT32 size)
+{
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+
+	if (!persistent->decompressor)
+	{
+		persistent->decompressor = zgfx_context_new(FALSE);
+
+		if (!persistent->decompressor)
+			return NULL;
+	}
+
+	if (persistent->decodedCount == persistent->decodedSize)
+	{
+		const size_t decodedSize = persistent->decodedSize ? persistent->decodedSize * 2 : 64;
+		BYTE** decoded = (BYTE**)realloc(persistent->decoded, decodedSize * sizeof(BYTE*));
+
+		if (!decoded)
+			return NULL;
+
+		persistent->decoded = decoded;
+		persistent->decodedSize = decodedSize;
+	}
+
+	zgfx_context_reset(persistent->decompressor, FALSE);
+
+	if ((zgfx_decompress(persistent->decompressor, data, length, &pDstData, &DstSize, 0) < 0) ||
+	    (DstSize != size))
+	{
+		free(pDstData);
+		return NULL;
+	}
+
+	persistent->decoded[persistent->decodedCount++] = pDstData;
+	return pDstData;
+}
+
+static BOOL persistent_cache_write_header(rdpPersistentCache* persistent)
+{
+	BYTE buffer[PERSISTENT_CACHE_HEADER_LENGTH] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+
+	WINPR_ASSERT(persistent);
+
+	if (persistent->count > UINT32_MAX)
+		return FALSE;
+
+	Stream_Write_UINT32(s, PERSISTENT_CACHE_SIGNATURE); /* signature (4 bytes) */
+	Stream_Write_UINT32(s, PERSISTENT_CACHE_VERSION);   /* version (4 bytes) */
+	Stream_Write_UINT32(s, (UINT32)persistent->count);  /* count (4 bytes) */
+	Stream_Write_UINT32(s, 0);                          /* reserved (4 bytes) */
+
+	return fwrite(buffer, sizeof(buffer), 1, persistent->fp) == 1;
+}
+
+static BOOL persistent_cache_open_read(rdpPersistentCache* persistent)
+{
+	INT64 length;
+	UINT32 signature, version, count;
+	wStream sbuffer = { 0 };
+	wStream* s;
+
+	persistent->fp = winpr_fopen(persistent->filename, "rb");
+
+	if (!persistent->fp)
+		return FALSE;
+
+	_fseeki64(persistent->fp, 0, SEEK_END);
+	length = _ftelli64(persistent->fp);
+	_fseeki64(persistent->fp, 0, SEEK_SET);
+
+	if ((length < PERSISTENT_CACHE_HEADER_LENGTH) ||
+	    ((UINT64)length > PERSISTENT_CACHE_MAX_FILE_SIZE))
+	{
+		WLog_WARN(TAG, "ignoring persistent cache %s with invalid size %" PRId64,
+		          persistent->filename, length);
+		return FALSE;
+	}
+
+	persistent->buffer = (BYTE*)malloc((size_t)length);
+
+	if (!persistent->buffer)
+		return FALSE;
+
+	if (fread(persistent->buffer, (size_t)length, 1, persistent->fp) != 1)
+		return FALSE;
+
+	persistent->length = (size_t)length;
+	fclose(persistent->fp);
+	persistent->fp = NULL;
+
+	s = Stream_StaticConstInit(&sbuffer, persistent->buffer, persistent->length);
+	Stream_Read_UINT32(s, signature); /* signature (4 bytes) */
+	Stream_Read_UINT32(s, version);   /* version (4 bytes) */
+	Stream_Read_UINT32(s, count);     /* count (4 bytes) */
+	Stream_Seek(s, 4);                /* reserved (4 bytes) */
+
+	if ((signature != PERSISTENT_CACHE_SIGNATURE) || (version != PERSISTENT_CACHE_VERSION))
+	{
+		WLog_WARN(TAG, "ignoring persistent cache %s with unsupported version %" PRIu32,
+		          persistent->filename, version);
+		return FALSE;
+	}
+
+	persistent->count = count;
+	persistent->offset = PERSISTENT_CACHE_HEADER_LENGTH;
+	return TRUE;
+}
+
+static BOOL persistent_cache_open_write(rdpPersistentCache* persistent)
+{
+	const size_t size = strlen(persistent->filename) + 5;
+
+	persistent->tmpname = (char*)calloc(size, sizeof(char));
+
+	if (!persistent->tmpname)
+		return FALSE;
+
+	sprintf_s(persistent->tmpname, size, "%s.tmp", persistent->filename);
+	persistent->fp = winpr_fopen(persistent->tmpname, "wb");
+
+	if (!persistent->fp)
+	{
+		WLog_ERR(TAG, "failed to create persistent cache %s", persistent->tmpname);
+		return FALSE;
+	}
+
+	persistent->count = 0;
+	return persistent_cache_write_header(persistent);
+}
+
+BOOL persistent_cache_open(rdpPersistentCache* persistent, const char* filename, BOOL write)
+{
+	BOOL rc;
+
+	if (!persistent || !filename)
+		return FALSE;
+
+	persistent_cache_close(persistent);
+	persistent->write = write;
+	persistent->filename = _strdup(filename);
+
+	if (!persistent->filename)
+		return FALSE;
+
+	if (write)
+		rc = persistent_cache_open_write(persistent);
+	else
+		rc = persistent_cache_open_read(persistent);
+
+	if (!rc)
+	{
+		if (persistent->fp && write)
+		{
+			fclose(persistent->fp);
+			persistent->fp = NULL;
+			winpr_DeleteFile(persistent->tmpname);
+		}
+
+		persistent_cache_close(persistent);
+	}
+
+	return rc;
+}
+
+BOOL persistent_cache_close(rdpPersistentCache* persistent)
+{
+	BOOL rc = TRUE;
+
+	if (!persistent)
+		return FALSE;
+
+	if (persistent->fp)
+	{
+		if (persistent->write)
+		{
+			rc = (_fseeki64(persistent->fp, 0, SEEK_SET) == 0) &&
+			     persistent_cache_write_header(persistent);
+			rc = (fclose(persistent->fp) == 0) && rc;
+
+			if (rc)
+				rc = MoveFileExA(persistent->tmpname, persistent->filename,
+				                 MOVEFILE_REPLACE_EXISTING);
+
+			if (!rc)
+			{
+				WLog_ERR(TAG, "failed to write persistent cache %s", persistent->filename);
+				winpr_DeleteFile(persistent->tmpname);
+			}
+		}
+		else
+			fclose(persistent->fp);
+	}
+
+	while (persistent->decodedCount > 0)
+		free(persistent->decoded[--persistent->decodedCount]);
+
+	free(persistent->filename);
+	free(persistent->tmpname);
+	free(persistent->buffer);
+	persistent->fp = NULL;
+	persistent->filename = NULL;
+	persistent->tmpname = NULL;
+	persistent->buffer = NULL;
+	persistent->length = 0;
+	persistent->offset = 0;
+	persistent->count = 0;
+	return rc;
+}
+
+size_t persistent_cache_get_count(const rdpPersistentCache* persistent)
+{
+	if (!persistent)
+		return 0;
+
+	return persistent->count;
+}
+
+/**
+ * Read the next valid entry of an opened store.
+ * @return 1 if an entry was read, 0 at the end of the store, -1 on error
+ */
+int persistent_cache_read_entry(rdpPersistentCache* persistent, PERSISTENT_CACHE_ENTRY* entry)
+{
+	if (!persistent || !entry || persistent->write)
+		return -1;
+
+	while (persistent->length - persistent->offset >= PERSISTENT_CACHE_ENTRY_LENGTH)
+	{
+		UINT16 cacheId, width, height, flags;
+		UINT32 format, size, length, crc;
+		UINT64 key64;
+		const BYTE* data;
+		wStream sbuffer = { 0 };
+		wStream* s = Stream_StaticConstInit(&sbuffer, &persistent->buffer[persistent->offset],
+		                                    persistent->length - persistent->offset);
+
+		Stream_Read_UINT64(s, key64);   /* key64 (8 bytes) */
+		Stream_Read_UINT16(s, cacheId); /* cacheId (2 bytes) */
+		Stream_Read_UINT16(s, width);   /* width (2 bytes) */
+		Stream_Read_UINT16(s, height);  /* height (2 bytes) */
+		Stream_Read_UINT16(s, flags);   /* flags (2 bytes) */
+		Stream_Read_UINT32(s, format);  /* format (4 bytes) */
+		Stream_Read_UINT32(s, size);    /* size (4 bytes) */
+		Stream_Read_UINT32(s, length);  /* length (4 bytes) */
+		Stream_Read_UINT32(s, crc);     /* crc32 (4 bytes) */
+
+		if (Stream_GetRemainingLength(s) < length)
+		{
+			WLog_WARN(TAG, "persistent cache %s is truncated", persistent->filename);
+			persistent->offset = persistent->length;
+			return 0;
+		}
+
+		persistent->offset += PERSISTENT_CACHE_ENTRY_LENGTH + length;
+		data = Stream_Pointer(s);
+
+		if (!persistent_cache_entry_valid(width, height, format, size) ||
+		    (persistent_crc32(data, length) != crc))
+		{
+			WLog_WARN(TAG, "skipping corrupted persistent cache entry 0x%016" PRIx64, key64);
+			continue;
+		}
+
+		if (flags & PERSISTENT_CACHE_ENTRY_COMPRESSED)
+			data = persistent_cache_decompress(persistent, data, length, size);
+		else if (length != size)
+			data = NULL;
+
+		if (!data)
+		{
+			WLog_WARN(TAG, "skipping undecodable persistent cache entry 0x%016" PRIx64, key64);
+			continue;
+		}
+
+		entry->key64 = key64;
+		entry->cacheId = cacheId;
+		entry->width = width;
+		entry->height = height;
+		entry->format = format;
+		entry->size = size;
+		entry->data = data;
+		return 1;
+	}
+
+	return 0;
+}
+
+BOOL persistent_cache_write_entry(rdpPersistentCache* persistent,
+                                  const PERSISTENT_CACHE_ENTRY* entry)
+{
+	UINT16 flags = 0;
+	UINT32 length;
+	const BYTE* data;
+	BYTE buffer[PERSISTENT_CACHE_ENTRY_LENGTH] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+
+	if (!persistent || !entry || !persistent->write || !persistent->fp || !entry->data)
+		return FALSE;
+
+	if ((entry->cacheId > UINT16_MAX) || (entry->width > UINT16_MAX) ||
+	    (entry->height > UINT16_MAX) ||
+	    !persistent_cache_entry_valid(entry->width, entry->height, entry->format, entry->size))
+		return FALSE;
+
+	data = entry->data;
+	length = entry->size;
+
+	if (persistent_cache_compress(persistent, entry->data, entry->size))
+	{
+		flags |= PERSISTENT_CACHE_ENTRY_COMPRESSED;
+		data = Stream_Buffer(persistent->compressed);
+		length = (UINT32)Stream_GetPosition(persistent->compressed);
+	}
+
+	Stream_Write_UINT64(s, entry->key64);                   /* key64 (8 bytes) */
+	Stream_Write_UINT16(s, (UINT16)entry->cacheId);         /* cacheId (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)entry->width);           /* width (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)entry->height);          /* height (2 bytes) */
+	Stream_Write_UINT16(s, flags);                          /* flags (2 bytes) */
+	Stream_Write_UINT32(s, entry->format);                  /* format (4 bytes) */
+	Stream_Write_UINT32(s, entry->size);                    /* size (4 bytes) */
+	Stream_Write_UINT32(s, length);                         /* length (4 bytes) */
+	Stream_Write_UINT32(s, persistent_crc32(data, length)); /* crc32 (4 bytes) */
+
+	if (fwrite(buffer, sizeof(buffer), 1, persistent->fp) != 1)
+		return FALSE;
+
+	if (fwrite(data, length, 1, persistent->fp) != 1)
+		return FALSE;
+
+	persistent->count++;
+	return TRUE;
+}
+
+BOOL persistent_cache_limits_init(PERSISTENT_CACHE_LIMITS* limits, const rdpSettings* settings)
+{
+	UINT32 x;
+	const PERSISTENT_CACHE_LIMITS empty = { 0 };
+
+	if (!limits || !settings)
+		return FALSE;
+
+	*limits = empty;
+	limits->numCells = MIN(freerdp_settings_get_uint32(settings, FreeRDP_BitmapCacheV2NumCells),
+	                       PERSISTENT_CACHE_MAX_CELLS);
+
+	for (x = 0; x < limits->numCells; x++)
+	{
+		const BITMAP_CACHE_V2_CELL_INFO* info =
+		    freerdp_settings_get_pointer_array(settings, FreeRDP_BitmapCacheV2CellInfo, x);
+
+		if (!info)
+			return FALSE;
+
+		/* totalEntriesCacheX of the key list PDU is 16 bit */
+		limits->maxEntries[x] = MIN(info->numEntries, UINT16_MAX);
+	}
+
+	return TRUE;
+}
+
+BOOL persistent_cache_limits_accept(PERSISTENT_CACHE_LIMITS* limits, UINT32 cacheId,
+                                    UINT32* pIndex)
+{
+	if (!limits || !pIndex || (cacheId >= limits->numCells))
+		return FALSE;
+
+	if ((limits->numEntries[cacheId] >= limits->maxEntries[cacheId]) ||
+	    (limits->total >= PERSISTENT_KEYS_MAX_TOTAL))
+		return FALSE;
+
+	*pIndex = limits->numEntries[cacheId]++;
+	limits->total++;
+	return TRUE;
+}
+
+rdpPersistentCache* persistent_cache_new(void)
+{
+	return (rdpPersistentCache*)calloc(1, sizeof(rdpPersistentCache));
+}
+
+void persistent_cache_free(rdpPersistentCache* persistent)
+{
+	if (!persistent)
+		return;
+
+	persistent_cache_close(persistent);
+	zgfx_context_free(persistent->compressor);
+	zgfx_context_free(persistent->decompressor);
+	Stream_Free(persistent->compressed, TRUE);
+	free(persistent->decoded);
+	free(persistent);
+}
@@ -0,0 +1,295 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/cache/persistent.h>
+
+#define TEST_ENTRY_COUNT 4
+
+static char* test_temp_filename(void)
+{
+	size_t x;
+	BYTE tmp[16] = { 0 };
+	char name[64] = { 0 };
+
+	winpr_RAND(tmp, sizeof(tmp));
+
+	for (x = 0; x < sizeof(tmp); x++)
+		_snprintf(&name[x * 2], sizeof(name) - 2 * x, "%02" PRIx8, tmp[x]);
+
+	return GetKnownSubPath(KNOWN_PATH_TEMP, name);
+}
+
+static BOOL test_write_store(const char* name, const PERSISTENT_CACHE_ENTRY* entries, size_t count)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	rdpPersistentCache* persistent = persistent_cache_new();
+
+	if (!persistent)
+		return FALSE;
+
+	if (!persistent_cache_open(persistent, name, TRUE))
+		goto fail;
+
+	for (x = 0; x < count; x++)
+	{
+		if (!persistent_cache_write_entry(persistent, &entries[x]))
+			goto fail;
+	}
+
+	rc = persistent_cache_close(persistent);
+fail:
+	persistent_cache_free(persistent);
+	return rc;
+}
+
+static BOOL test_corrupt_entry_data(const char* name, size_t offset)
+{
+	BYTE value = 0;
+	FILE* fp = winpr_fopen(name, "r+b");
+
+	if (!fp)
+		return FALSE;
+
+	if ((_fseeki64(fp, (INT64)offset, SEEK_SET) != 0) || (fread(&value, 1, 1, fp) != 1))
+		goto fail;
+
+	value ^= 0xFF;
+
+	if ((_fseeki64(fp, (INT64)offset, SEEK_SET) != 0) || (fwrite(&value, 1, 1, fp) != 1))
+		goto fail;
+
+	fclose(fp);
+	return TRUE;
+fail:
+	fclose(fp);
+	return FALSE;
+}
+
+static BOOL test_read_store(const char* name, const PERSISTENT_CACHE_ENTRY* entries, size_t count,
+                            size_t skip)
+{
+	int status;
+	size_t x = 0;
+	BOOL rc = FALSE;
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+	rdpPersistentCache* persistent = persistent_cache_new();
+
+	if (!persistent)
+		return FALSE;
+
+	if (!persistent_cache_open(persistent, name, FALSE))
+		goto fail;
+
+	if (persistent_cache_get_count(persistent) != count)
+		goto fail;
+
+	while ((status = persistent_cache_read_entry(persistent, &entry)) > 0)
+	{
+		const PERSISTENT_CACHE_ENTRY* expected;
+
+		if (x == skip)
+			x++;
+
+		if (x >= count)
+			goto fail;
+
+		expected = &entries[x++];
+
+		if ((entry.key64 != expected->key64) || (entry.cacheId != expected->cacheId) ||
+		    (entry.width != expected->width) || (entry.height != expected->height) ||
+		    (entry.format != expected->format) || (entry.size != expected->size))
+		{
+			fprintf(stderr, "entry 0x%016" PRIx64 " header mismatch\n", entry.key64);
+			goto fail;
+		}
+
+		if (memcmp(entry.data, expected->data, entry.size) != 0)
+		{
+			fprintf(stderr, "entry 0x%016" PRIx64 " data mismatch\n", entry.key64);
+			goto fail;
+		}
+	}
+
+	/* The skipped entry may be the last one */
+	if ((skip < count) && (x == skip))
+		x++;
+
+	rc = (status == 0) && (x == count);
+fail:
+	persistent_cache_free(persistent);
+	return rc;
+}
+
+static BOOL test_store_compressed(const char* name, const PERSISTENT_CACHE_ENTRY* entries,
+                                  size_t count)
+{
+	size_t x;
+	INT64 length;
+	size_t raw = 16;
+	FILE* fp = winpr_fopen(name, "rb");
+
+	if (!fp)
+		return FALSE;
+
+	_fseeki64(fp, 0, SEEK_END);
+	length = _ftelli64(fp);
+	fclose(fp);
+
+	for (x = 0; x < count; x++)
+		raw += 32 + entries[x].size;
+
+	return (length > 0) && ((size_t)length < raw);
+}
+
+static BOOL test_limits(void)
+{
+	UINT32 x;
+	UINT32 index = 0;
+	BOOL rc = FALSE;
+	BITMAP_CACHE_V2_CELL_INFO info = { 0 };
+	PERSISTENT_CACHE_LIMITS limits = { 0 };
+	rdpSettings* settings = freerdp_settings_new(0);
+
+	if (!settings || !freerdp_settings_set_uint32(settings, FreeRDP_BitmapCacheV2NumCells, 2))
+		goto fail;
+
+	info.numEntries = 2;
+
+	if (!freerdp_settings_set_pointer_array(settings, FreeRDP_BitmapCacheV2CellInfo, 0, &info))
+		goto fail;
+
+	info.numEntries = 0;
+
+	if (!freerdp_settings_set_pointer_array(settings, FreeRDP_BitmapCacheV2CellInfo, 1, &info))
+		goto fail;
+
+	if (!persistent_cache_limits_init(&limits, settings))
+		goto fail;
+
+	/* Cell 0 takes two entries, cell 1 none and cell 2 does not exist */
+	for (x = 0; x < 2; x++)
+	{
+		if (!persistent_cache_limits_accept(&limits, 0, &index) || (index != x))
+			goto fail;
+	}
+
+	if (persistent_cache_limits_accept(&limits, 0, &index) ||
+	    persistent_cache_limits_accept(&limits, 1, &index) ||
+	    persistent_cache_limits_accept(&limits, 2, &index))
+		goto fail;
+
+	rc = (limits.total == 2) && (limits.numEntries[0] == 2);
+fail:
+	freerdp_settings_free(settings);
+	return rc;
+}
+
+int TestPersistentCache(int argc, char* argv[])
+{
+	size_t x;
+	int rc = -1;
+	size_t offset = 16;
+	char* name = NULL;
+	BYTE* data[TEST_ENTRY_COUNT] = { 0 };
+	PERSISTENT_CACHE_ENTRY entries[TEST_ENTRY_COUNT] = { 0 };
+	PERSISTENT_CACHE_ENTRY invalid = { 0 };
+	rdpPersistentCache* persistent = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_limits())
+	{
+		fprintf(stderr, "persistent cache limits are not applied\n");
+		return -1;
+	}
+
+	for (x = 0; x < TEST_ENTRY_COUNT; x++)
+	{
+		PERSISTENT_CACHE_ENTRY* entry = &entries[x];
+
+		entry->key64 = 0x0123456789ABCDEFull + x;
+		entry->cacheId = (UINT32)(x % 3);
+		entry->width = 8 + 8 * (UINT32)x;
+		entry->height = 16;
+		entry->format = (x % 2) ? PIXEL_FORMAT_BGRX32 : PIXEL_FORMAT_RGB16;
+		entry->size = entry->width * entry->height * FreeRDPGetBytesPerPixel(entry->format);
+		data[x] = (BYTE*)malloc(entry->size);
+
+		if (!data[x])
+			goto fail;
+
+		/* Random data is stored as is, the last entry is compressible */
+		if (x == TEST_ENTRY_COUNT - 1)
+			memset(data[x], (int)x, entry->size);
+		else
+			winpr_RAND(data[x], entry->size);
+
+		entry->data = data[x];
+	}
+
+	name = test_temp_filename();
+
+	if (!name)
+		goto fail;
+
+	/* A missing store can not be opened for reading */
+	persistent = persistent_cache_new();
+
+	if (!persistent || persistent_cache_open(persistent, name, FALSE))
+		goto fail;
+
+	/* Entries with inconsistent dimensions are rejected */
+	invalid = entries[0];
+	invalid.size--;
+
+	if (!persistent_cache_open(persistent, name, TRUE) ||
+	    persistent_cache_write_entry(persistent, &invalid) || !persistent_cache_close(persistent))
+		goto fail;
+
+	if (!test_write_store(name, entries, TEST_ENTRY_COUNT))
+		goto fail;
+
+	if (!test_read_store(name, entries, TEST_ENTRY_COUNT, TEST_ENTRY_COUNT))
+	{
+		fprintf(stderr, "failed to read back persistent cache\n");
+		goto fail;
+	}
+
+	if (!test_store_compressed(name, entries, TEST_ENTRY_COUNT))
+	{
+		fprintf(stderr, "compressible entry was stored uncompressed\n");
+		goto fail;
+	}
+
+	/* Flip a pixel of the second entry, the checksum must drop it */
+	offset += 32 + entries[0].size + 32 + 5;
+
+	if (!test_corrupt_entry_data(name, offset))
+		goto fail;
+
+	if (!test_read_store(name, entries, TEST_ENTRY_COUNT, 1))
+	{
+		fprintf(stderr, "corrupted entry was not skipped\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	persistent_cache_free(persistent);
+
+	if (name)
+		winpr_DeleteFile(name);
+
+	free(name);
+
+	for (x = 0; x < TEST_ENTRY_COUNT; x++)
+		free(data[x]);
+
+	return rc;
+}
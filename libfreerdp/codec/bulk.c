@@ -20,6 +20,7 @@
 #include <winpr/assert.h>
 
 #include <freerdp/config.h>
+#include <freerdp/utils/stopwatch.h>
 
 #include "bulk.h"
 #include "../codec/mppc.h"
@@ -30,6 +31,32 @@
 
 //#define WITH_BULK_DEBUG 1
 
+/* Adaptive mode: level returned by the selector for PDUs sent uncompressed */
+#define BULK_COMPRESSION_NONE 0xFFFFFFFF
+#define BULK_ADAPTIVE_LEVELS (PACKET_COMPR_TYPE_RDP61 + 1)
+/* The fast-path updateCode has 4 bits */
+#define BULK_ADAPTIVE_TYPES 16
+/* Bytes probed and distinct byte values above which a PDU is treated as incompressible.
+ * 256 random bytes contain ~162 distinct values, bitmaps and orders far less. */
+#define BULK_ADAPTIVE_PROBE_SIZE 256
+#define BULK_ADAPTIVE_PROBE_MAX_SYMBOLS 150
+/* Every n-th PDU of an update type tries another level to refresh its estimates */
+#define BULK_ADAPTIVE_EXPLORE_INTERVAL 64
+/* Without a bandwidth measurement, types not shrinking below this ratio are sent raw */
+#define BULK_ADAPTIVE_MAX_RATIO 0.95
+/* Weight of a new sample in the moving averages */
+#define BULK_ADAPTIVE_WEIGHT 0.125
+/* Largest PDU the 8K history holds, same limit as fastpath applies to the 8K level */
+#define BULK_MPPC_8K_MAX_SIZE (8192 - 40)
+
+typedef struct
+{
+	/* compressed / uncompressed size per level, 0 if not measured yet */
+	double ratio[BULK_ADAPTIVE_LEVELS];
+	UINT32 count;
+	UINT32 explore;
+} BULK_ADAPTIVE_STATS;
+
 struct rdp_bulk
 {
 	ALIGN64 rdpContext* context;
@@ -42,6 +69,12 @@ struct rdp_bulk
 	ALIGN64 XCRUSH_CONTEXT* xcrushRecv;
 	ALIGN64 XCRUSH_CONTEXT* xcrushSend;
 	ALIGN64 BYTE OutputBuffer[65536];
+
+	/* adaptive mode */
+	ALIGN64 UINT32 MppcSendLevel;
+	ALIGN64 STOPWATCH* stopwatch;
+	ALIGN64 double CostPerByte[BULK_ADAPTIVE_LEVELS]; /* compression time in us per input byte */
+	ALIGN64 BULK_ADAPTIVE_STATS Stats[BULK_ADAPTIVE_TYPES];
 };
 
 #if defined(WITH_BULK_DEBUG)
@@ -108,7 +141,7 @@ static INLINE int bulk_compress_validate(rdpBulk* bulk, const BYTE* pSrcData, UI
 
 	v_pSrcData = pDstData;
 	v_SrcSize = DstSize;
-	v_Flags = Flags | bulk->CompressionLevel;
+	v_Flags = Flags;
 	status = bulk_decompress(bulk, v_pSrcData, v_SrcSize, &v_pDstData, &v_DstSize, v_Flags);
 
 	if (status < 0)
@@ -236,10 +269,177 @@ int bulk_decompress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize, const B
 	return status;
 }
 
-int bulk_compress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize, const BYTE** ppDstData,
-                  UINT32* pDstSize, UINT32* pFlags)
+static int bulk_compress_level(rdpBulk* bulk, UINT32 level, const BYTE* pSrcData, UINT32 SrcSize,
+                               const BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
 {
 	int status = -1;
+
+	switch (level)
+	{
+		case PACKET_COMPR_TYPE_8K:
+		case PACKET_COMPR_TYPE_64K:
+			/* The receiver decodes both levels with one history, a switch has to flush it */
+			if (level != bulk->MppcSendLevel)
+			{
+				mppc_set_compression_level(bulk->mppcSend, level);
+
+				if (bulk->MppcSendLevel != BULK_COMPRESSION_NONE)
+					mppc_context_reset(bulk->mppcSend, TRUE);
+
+				bulk->MppcSendLevel = level;
+			}
+
+			status = mppc_compress(bulk->mppcSend, pSrcData, SrcSize, bulk->OutputBuffer, ppDstData,
+			                       pDstSize, pFlags);
+			break;
+		case PACKET_COMPR_TYPE_RDP6:
+			status = ncrush_compress(bulk->ncrushSend, pSrcData, SrcSize, bulk->OutputBuffer,
+			                         ppDstData, pDstSize, pFlags);
+			break;
+		case PACKET_COMPR_TYPE_RDP61:
+			status = xcrush_compress(bulk->xcrushSend, pSrcData, SrcSize, bulk->OutputBuffer,
+			                         ppDstData, pDstSize, pFlags);
+			break;
+		case PACKET_COMPR_TYPE_RDP8:
+			WLog_ERR(TAG, "Unsupported bulk compression type %08" PRIx32, level);
+			status = -1;
+			break;
+		default:
+			WLog_ERR(TAG, "Unknown bulk compression type %08" PRIx32, level);
+			status = -1;
+			break;
+	}
+
+	return status;
+}
+
+static BOOL bulk_adaptive_is_incompressible(const BYTE* pSrcData, UINT32 SrcSize)
+{
+	UINT32 index;
+	UINT32 symbols = 0;
+	UINT64 seen[4] = { 0 };
+	const UINT32 size = MIN(SrcSize, BULK_ADAPTIVE_PROBE_SIZE);
+
+	/* Already compressed payloads (RemoteFX, H.264, JPEG) use nearly every byte value */
+	if (size < BULK_ADAPTIVE_PROBE_SIZE)
+		return FALSE;
+
+	for (index = 0; index < size; index++)
+	{
+		const BYTE value = pSrcData[index];
+		const UINT64 bit = 1ULL << (value & 63);
+
+		if (!(seen[value >> 6] & bit))
+		{
+			seen[value >> 6] |= bit;
+			symbols++;
+		}
+	}
+
+	return symbols > BULK_ADAPTIVE_PROBE_MAX_SYMBOLS;
+}
+
+static UINT32 bulk_adaptive_select(rdpBulk* bulk, BYTE type, const BYTE* pSrcData, UINT32 SrcSize)
+{
+	UINT32 level;
+	UINT32 minLevel;
+	UINT32 best = BULK_COMPRESSION_NONE;
+	UINT32 bandwidth = 0;
+	double bestCost;
+	double byteTime;
+	BULK_ADAPTIVE_STATS* stats = &bulk->Stats[type & (BULK_ADAPTIVE_TYPES - 1)];
+
+	if (bulk_adaptive_is_incompressible(pSrcData, SrcSize))
+		return BULK_COMPRESSION_NONE;
+
+	if (bulk->context->autodetect)
+		bandwidth = bulk->context->autodetect->netCharBandwidth;
+
+	/* Without a measured link there is nothing to trade, only the negotiated level is used */
+	if (bandwidth == 0)
+		minLevel = bulk->CompressionLevel;
+	else if (SrcSize <= BULK_MPPC_8K_MAX_SIZE)
+		minLevel = PACKET_COMPR_TYPE_8K;
+	else
+		minLevel = PACKET_COMPR_TYPE_64K;
+
+	if (bulk->CompressionLevel < minLevel)
+		return BULK_COMPRESSION_NONE;
+
+	/* Levels without a sample for this type are tried first */
+	for (level = minLevel; level <= bulk->CompressionLevel; level++)
+	{
+		if (stats->ratio[level] == 0.0)
+			return level;
+	}
+
+	stats->count++;
+
+	if ((stats->count % BULK_ADAPTIVE_EXPLORE_INTERVAL) == 0)
+	{
+		stats->explore = (stats->explore + 1) % (bulk->CompressionLevel + 1 - minLevel);
+		return minLevel + stats->explore;
+	}
+
+	/* Keep the negotiated level unless it does not pay off */
+	if (bandwidth == 0)
+	{
+		if (stats->ratio[bulk->CompressionLevel] > BULK_ADAPTIVE_MAX_RATIO)
+			return BULK_COMPRESSION_NONE;
+
+		return bulk->CompressionLevel;
+	}
+
+	/* Pick the level that gets a byte across the link the fastest:
+	 * time to compress it plus time to transmit what is left of it. */
+	byteTime = 8000.0 / bandwidth; /* us per byte at kbit/s */
+	bestCost = byteTime;
+
+	for (level = minLevel; level <= bulk->CompressionLevel; level++)
+	{
+		const double cost = bulk->CostPerByte[level] + stats->ratio[level] * byteTime;
+
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			best = level;
+		}
+	}
+
+	return best;
+}
+
+static void bulk_adaptive_update(rdpBulk* bulk, BYTE type, UINT32 level, UINT32 SrcSize,
+                                 UINT32 DstSize, UINT32 Flags)
+{
+	double ratio;
+	double cost;
+	BULK_ADAPTIVE_STATS* stats = &bulk->Stats[type & (BULK_ADAPTIVE_TYPES - 1)];
+
+	/* Data the compressor gave up on travels uncompressed */
+	if (!(Flags & PACKET_COMPRESSED))
+		DstSize = SrcSize;
+
+	ratio = (double)DstSize / SrcSize;
+	cost = (double)bulk->stopwatch->elapsed / SrcSize;
+
+	if (stats->ratio[level] == 0.0)
+		stats->ratio[level] = ratio;
+	else
+		stats->ratio[level] += (ratio - stats->ratio[level]) * BULK_ADAPTIVE_WEIGHT;
+
+	if (bulk->CostPerByte[level] == 0.0)
+		bulk->CostPerByte[level] = cost;
+	else
+		bulk->CostPerByte[level] += (cost - bulk->CostPerByte[level]) * BULK_ADAPTIVE_WEIGHT;
+}
+
+int bulk_compress(rdpBulk* bulk, BYTE type, const BYTE* pSrcData, UINT32 SrcSize,
+                  const BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
+{
+	int status = -1;
+	UINT32 level;
+	BOOL adaptive;
 	rdpMetrics* metrics;
 	UINT32 CompressedBytes;
 	UINT32 UncompressedBytes;
@@ -262,33 +462,33 @@ int bulk_compress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize, const BYT
 	}
 
 	*pDstSize = sizeof(bulk->OutputBuffer);
-	bulk_compression_level(bulk);
+	level = bulk_compression_level(bulk);
 	bulk_compression_max_size(bulk);
+	adaptive = bulk->context->settings->CompressionAdaptive;
 
-	switch (bulk->CompressionLevel)
+	if (adaptive)
 	{
-		case PACKET_COMPR_TYPE_8K:
-		case PACKET_COMPR_TYPE_64K:
-			mppc_set_compression_level(bulk->mppcSend, bulk->CompressionLevel);
-			status = mppc_compress(bulk->mppcSend, pSrcData, SrcSize, bulk->OutputBuffer, ppDstData,
-			                       pDstSize, pFlags);
-			break;
-		case PACKET_COMPR_TYPE_RDP6:
-			status = ncrush_compress(bulk->ncrushSend, pSrcData, SrcSize, bulk->OutputBuffer,
-			                         ppDstData, pDstSize, pFlags);
-			break;
-		case PACKET_COMPR_TYPE_RDP61:
-			status = xcrush_compress(bulk->xcrushSend, pSrcData, SrcSize, bulk->OutputBuffer,
-			                         ppDstData, pDstSize, pFlags);
-			break;
-		case PACKET_COMPR_TYPE_RDP8:
-			WLog_ERR(TAG, "Unsupported bulk compression type %08" PRIx32, bulk->CompressionLevel);
-			status = -1;
-			break;
-		default:
-			WLog_ERR(TAG, "Unknown bulk compression type %08" PRIx32, bulk->CompressionLevel);
-			status = -1;
-			break;
+		level = bulk_adaptive_select(bulk, type, pSrcData, SrcSize);
+
+		if (level == BULK_COMPRESSION_NONE)
+		{
+			*ppDstData = pSrcData;
+			*pDstSize = SrcSize;
+			*pFlags = 0;
+			metrics_write_bytes(metrics, SrcSize, SrcSize);
+			return 0;
+		}
+
+		stopwatch_reset(bulk->stopwatch);
+		stopwatch_start(bulk->stopwatch);
+	}
+
+	status = bulk_compress_level(bulk, level, pSrcData, SrcSize, ppDstData, pDstSize, pFlags);
+
+	if (adaptive && (status >= 0))
+	{
+		stopwatch_stop(bulk->stopwatch);
+		bulk_adaptive_update(bulk, type, level, SrcSize, *pDstSize, *pFlags);
 	}
 
 	if (status >= 0)
@@ -302,7 +502,7 @@ int bulk_compress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize, const BYT
 			         "Compress Type: %" PRIu32 " Flags: %s (0x%08" PRIX32
 			         ") Compression Ratio: %f (%" PRIu32 " / %" PRIu32 "), Total: %f (%" PRIu64
 			         " / %" PRIu64 ")",
-			         bulk->CompressionLevel, bulk_get_compression_flags_string(*pFlags), *pFlags,
+			         level, bulk_get_compression_flags_string(*pFlags), *pFlags,
 			         CompressionRatio, CompressedBytes, UncompressedBytes,
 			         metrics->TotalCompressionRatio, metrics->TotalCompressedBytes,
 			         metrics->TotalUncompressedBytes);
@@ -331,6 +531,7 @@ void bulk_reset(rdpBulk* bulk)
 	ncrush_context_reset(bulk->ncrushSend, FALSE);
 	xcrush_context_reset(bulk->xcrushRecv, FALSE);
 	xcrush_context_reset(bulk->xcrushSend, FALSE);
+	bulk->MppcSendLevel = BULK_COMPRESSION_NONE;
 }
 
 rdpBulk* bulk_new(rdpContext* context)
@@ -362,7 +563,11 @@ rdpBulk* bulk_new(rdpContext* context)
 	bulk->xcrushSend = xcrush_context_new(TRUE);
 	if (!bulk->xcrushSend)
 		goto fail;
+	bulk->stopwatch = stopwatch_create();
+	if (!bulk->stopwatch)
+		goto fail;
 	bulk->CompressionLevel = context->settings->CompressionLevel;
+	bulk->MppcSendLevel = BULK_COMPRESSION_NONE;
 
 	return bulk;
 fail:
@@ -381,5 +586,6 @@ void bulk_free(rdpBulk* bulk)
 	ncrush_context_free(bulk->ncrushSend);
 	xcrush_context_free(bulk->xcrushRecv);
 	xcrush_context_free(bulk->xcrushSend);
+	stopwatch_free(bulk->stopwatch);
 	free(bulk);
 }
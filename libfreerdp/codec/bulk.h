@@ -32,7 +32,11 @@ FREERDP_LOCAL UINT32 bulk_compression_max_size(rdpBulk* bulk);
 
 FREERDP_LOCAL int bulk_decompress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize,
                                   const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
-FREERDP_LOCAL int bulk_compress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize,
+/**
+ * Compresses one PDU, type is the update type (fast-path updateCode) the adaptive mode
+ * keeps its statistics for.
+ */
+FREERDP_LOCAL int bulk_compress(rdpBulk* bulk, BYTE type, const BYTE* pSrcData, UINT32 SrcSize,
                                 const BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags);
 
 FREERDP_LOCAL void bulk_reset(rdpBulk* bulk);
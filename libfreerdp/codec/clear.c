@@ -37,6 +37,19 @@
 
 #define CLEARCODEC_VBAR_SIZE 32768
 #define CLEARCODEC_VBAR_SHORT_SIZE 16384
+#define CLEARCODEC_VBAR_MAX_HEIGHT 52
+#define CLEARCODEC_GLYPH_CACHE_SIZE 4000
+#define CLEARCODEC_GLYPH_MAX_PIXELS 1024
+
+#define CLEARCODEC_SUBCODEC_UNCOMPRESSED 0
+#define CLEARCODEC_SUBCODEC_NSCODEC 1
+#define CLEARCODEC_SUBCODEC_RLEX 2
+
+/* Encoder tuning */
+#define CLEARCODEC_CELL_WIDTH 64
+#define CLEARCODEC_RLEX_MAX_COLORS 127
+#define CLEARCODEC_VBAR_HASH_BITS 13
+#define CLEARCODEC_VBAR_SHORT_HASH_BITS 12
 
 typedef struct
 {
@@ -52,6 +65,56 @@ typedef struct
 	BYTE* pixels;
 } CLEAR_VBAR_ENTRY;
 
+/**
+ * Encoder side mirror of a decoder cache entry.
+ * Entries live in the same slot the decoder stores them in, so a lookup
+ * directly yields the cache index to put on the wire.
+ */
+typedef struct
+{
+	BOOL valid;
+	UINT32 hash;
+	UINT32 count;
+	UINT32 next; /* slot + 1 of the next entry in the same hash bucket, 0 terminates */
+	UINT32 pixels[CLEARCODEC_VBAR_MAX_HEIGHT];
+} CLEAR_VBAR_KEY;
+
+typedef struct
+{
+	UINT32 size;
+	UINT32 cursor;
+	UINT32 bucketMask;
+	UINT32* buckets;
+	CLEAR_VBAR_KEY* keys;
+} CLEAR_VBAR_MIRROR;
+
+typedef struct
+{
+	BOOL valid;
+	UINT32 hash;
+	UINT32 width;
+	UINT32 height;
+	UINT32 pixels[CLEARCODEC_GLYPH_MAX_PIXELS];
+} CLEAR_GLYPH_KEY;
+
+typedef enum
+{
+	CLEAR_CELL_RESIDUAL,
+	CLEAR_CELL_BANDS,
+	CLEAR_CELL_RLEX,
+	CLEAR_CELL_NSCODEC,
+	CLEAR_CELL_UNCOMPRESSED
+} CLEAR_CELL_MODE;
+
+typedef struct
+{
+	UINT32 count;
+	UINT32 colors[CLEARCODEC_RLEX_MAX_COLORS];
+	UINT32 hits[CLEARCODEC_RLEX_MAX_COLORS];
+	UINT32 slotColor[256];
+	BYTE slotIndex[256]; /* palette index + 1, 0 marks an empty slot */
+} CLEAR_PALETTE;
+
 struct S_CLEAR_CONTEXT
 {
 	BOOL Compressor;
@@ -67,6 +130,21 @@ struct S_CLEAR_CONTEXT
 	CLEAR_VBAR_ENTRY VBarStorage[CLEARCODEC_VBAR_SIZE];
 	UINT32 ShortVBarStorageCursor;
 	CLEAR_VBAR_ENTRY ShortVBarStorage[CLEARCODEC_VBAR_SHORT_SIZE];
+
+	/* Encoder state, only allocated if Compressor is set */
+	BOOL PendingCacheReset;
+	wStream* Stream;
+	wStream* ResidualStream;
+	wStream* BandsStream;
+	wStream* SubcodecStream;
+	UINT32* EncodeBuffer;
+	size_t EncodeBufferSize;
+	BYTE* CellModes;
+	size_t CellModesSize;
+	UINT32 GlyphCursor;
+	CLEAR_GLYPH_KEY* GlyphKeys;
+	CLEAR_VBAR_MIRROR VBarMirror;
+	CLEAR_VBAR_MIRROR ShortVBarMirror;
 };
 
 static const UINT32 CLEAR_LOG2_FLOOR[256] = {
@@ -1083,18 +1161,793 @@ fail:
 	return rc;
 }
 
-int clear_compress(CLEAR_CONTEXT* clear, const BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
+static INLINE BOOL clear_write_run_length(wStream* s, UINT32 runLengthFactor)
+{
+	if (!Stream_EnsureRemainingCapacity(s, 7))
+		return FALSE;
+
+	if (runLengthFactor < 0xFF)
+		Stream_Write_UINT8(s, runLengthFactor);
+	else
+	{
+		Stream_Write_UINT8(s, 0xFF);
+
+		if (runLengthFactor < 0xFFFF)
+			Stream_Write_UINT16(s, runLengthFactor);
+		else
+		{
+			Stream_Write_UINT16(s, 0xFFFF);
+			Stream_Write_UINT32(s, runLengthFactor);
+		}
+	}
+
+	return TRUE;
+}
+
+static INLINE void clear_write_bgr(wStream* s, UINT32 color)
+{
+	Stream_Write_UINT8(s, color & 0xFF);
+	Stream_Write_UINT8(s, (color >> 8) & 0xFF);
+	Stream_Write_UINT8(s, (color >> 16) & 0xFF);
+}
+
+static INLINE UINT32 clear_hash_pixels(const UINT32* pixels, UINT32 count, UINT32 seed)
+{
+	UINT32 hash = 2166136261U ^ seed;
+
+	for (UINT32 i = 0; i < count; i++)
+		hash = (hash ^ pixels[i]) * 16777619U;
+
+	return hash;
+}
+
+static BOOL clear_vbar_mirror_init(CLEAR_VBAR_MIRROR* mirror, UINT32 size, UINT32 hashBits)
+{
+	mirror->size = size;
+	mirror->bucketMask = (1u << hashBits) - 1;
+	mirror->keys = (CLEAR_VBAR_KEY*)calloc(size, sizeof(CLEAR_VBAR_KEY));
+	mirror->buckets = (UINT32*)calloc(mirror->bucketMask + 1, sizeof(UINT32));
+	return mirror->keys && mirror->buckets;
+}
+
+static void clear_vbar_mirror_uninit(CLEAR_VBAR_MIRROR* mirror)
+{
+	free(mirror->keys);
+	free(mirror->buckets);
+	mirror->keys = NULL;
+	mirror->buckets = NULL;
+}
+
+static void clear_vbar_mirror_reset(CLEAR_VBAR_MIRROR* mirror)
+{
+	if (!mirror->keys || !mirror->buckets)
+		return;
+
+	mirror->cursor = 0;
+	memset(mirror->buckets, 0, (mirror->bucketMask + 1) * sizeof(UINT32));
+
+	for (UINT32 i = 0; i < mirror->size; i++)
+		mirror->keys[i].valid = FALSE;
+}
+
+static INT32 clear_vbar_mirror_find(const CLEAR_VBAR_MIRROR* mirror, UINT32 hash,
+                                    const UINT32* pixels, UINT32 count)
+{
+	UINT32 slot = mirror->buckets[hash & mirror->bucketMask];
+
+	while (slot)
+	{
+		const CLEAR_VBAR_KEY* key = &mirror->keys[slot - 1];
+
+		if ((key->hash == hash) && (key->count == count) &&
+		    (memcmp(key->pixels, pixels, count * sizeof(UINT32)) == 0))
+			return (INT32)(slot - 1);
+
+		slot = key->next;
+	}
+
+	return -1;
+}
+
+/* Stores an entry at the cursor position, exactly like the decoder does. */
+static void clear_vbar_mirror_insert(CLEAR_VBAR_MIRROR* mirror, UINT32 hash, const UINT32* pixels,
+                                     UINT32 count)
+{
+	const UINT32 index = mirror->cursor;
+	CLEAR_VBAR_KEY* key = &mirror->keys[index];
+	UINT32* head;
+
+	if (key->valid)
+	{
+		UINT32* link = &mirror->buckets[key->hash & mirror->bucketMask];
+
+		while (*link && (*link != index + 1))
+			link = &mirror->keys[*link - 1].next;
+
+		if (*link)
+			*link = key->next;
+	}
+
+	head = &mirror->buckets[hash & mirror->bucketMask];
+	key->valid = TRUE;
+	key->hash = hash;
+	key->count = count;
+	key->next = *head;
+	memcpy(key->pixels, pixels, count * sizeof(UINT32));
+	*head = index + 1;
+	mirror->cursor = (mirror->cursor + 1) % mirror->size;
+}
+
+static INT32 clear_palette_index(CLEAR_PALETTE* palette, UINT32 color)
+{
+	UINT32 slot = (color * 2654435761U) >> 24;
+
+	while (palette->slotIndex[slot])
+	{
+		if (palette->slotColor[slot] == color)
+			return palette->slotIndex[slot] - 1;
+
+		slot = (slot + 1) & 0xFF;
+	}
+
+	if (palette->count >= CLEARCODEC_RLEX_MAX_COLORS)
+		return -1;
+
+	palette->slotColor[slot] = color;
+	palette->slotIndex[slot] = (BYTE)(palette->count + 1);
+	palette->colors[palette->count] = color;
+	palette->hits[palette->count] = 0;
+	return (INT32)palette->count++;
+}
+
+/* Builds the palette of a cell, fails if it has more colors than RLEX can express. */
+static BOOL clear_build_palette(CLEAR_PALETTE* palette, const UINT32* pSrc, UINT32 nSrcStep,
+                                UINT32 width, UINT32 height)
+{
+	palette->count = 0;
+	memset(palette->slotIndex, 0, sizeof(palette->slotIndex));
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const UINT32* line = &pSrc[1ull * y * nSrcStep];
+		UINT32 last = line[0];
+		INT32 index = clear_palette_index(palette, last);
+
+		if (index < 0)
+			return FALSE;
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			if (line[x] != last)
+			{
+				last = line[x];
+				index = clear_palette_index(palette, last);
+
+				if (index < 0)
+					return FALSE;
+			}
+
+			palette->hits[index]++;
+		}
+	}
+
+	return TRUE;
+}
+
+static UINT32 clear_vbar_short_range(const UINT32* column, UINT32 height, UINT32 colorBkg,
+                                     UINT32* pYOn)
+{
+	UINT32 yOn = 0;
+	UINT32 yOff = height;
+
+	while ((yOn < height) && (column[yOn] == colorBkg))
+		yOn++;
+
+	if (yOn == height)
+	{
+		*pYOn = 0;
+		return 0;
+	}
+
+	while (column[yOff - 1] == colorBkg)
+		yOff--;
+
+	*pYOn = yOn;
+	return yOff - yOn;
+}
+
+static void clear_read_column(const UINT32* pSrc, UINT32 nSrcStep, UINT32 height, UINT32* column)
+{
+	for (UINT32 y = 0; y < height; y++)
+		column[y] = pSrc[1ull * y * nSrcStep];
+}
+
+static UINT32 clear_estimate_bands(const CLEAR_CONTEXT* clear, const UINT32* pSrc, UINT32 nSrcStep,
+                                   UINT32 width, UINT32 height, UINT32 colorBkg)
+{
+	UINT32 cost = 11;
+	UINT32 column[CLEARCODEC_VBAR_MAX_HEIGHT];
+	UINT32 previous[CLEARCODEC_VBAR_MAX_HEIGHT];
+
+	for (UINT32 x = 0; x < width; x++)
+	{
+		UINT32 yOn;
+		UINT32 count;
+		clear_read_column(&pSrc[x], nSrcStep, height, column);
+
+		if ((x > 0) && (memcmp(column, previous, height * sizeof(UINT32)) == 0))
+		{
+			cost += 2;
+			continue;
+		}
+
+		memcpy(previous, column, height * sizeof(UINT32));
+
+		if (clear_vbar_mirror_find(&clear->VBarMirror, clear_hash_pixels(column, height, height),
+		                           column, height) >= 0)
+		{
+			cost += 2;
+			continue;
+		}
+
+		count = clear_vbar_short_range(column, height, colorBkg, &yOn);
+
+		if (clear_vbar_mirror_find(&clear->ShortVBarMirror,
+		                           clear_hash_pixels(&column[yOn], count, count), &column[yOn],
+		                           count) >= 0)
+			cost += 3;
+		else
+			cost += 2 + 3 * count;
+	}
+
+	return cost;
+}
+
+static CLEAR_CELL_MODE clear_select_cell_mode(const CLEAR_CONTEXT* clear, CLEAR_PALETTE* palette,
+                                              const UINT32* pSrc, UINT32 nSrcStep, UINT32 width,
+                                              UINT32 height, BOOL allowLossy, UINT32* pColorBkg)
+{
+	UINT32 runs = 0;
+	UINT32 rowRuns = 0;
+	UINT32 last = pSrc[0];
+	UINT32 cost;
+	CLEAR_CELL_MODE mode;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const UINT32* line = &pSrc[1ull * y * nSrcStep];
+
+		if (line[0] != last)
+			runs++;
+
+		rowRuns++;
+
+		for (UINT32 x = 1; x < width; x++)
+		{
+			if (line[x] != line[x - 1])
+			{
+				runs++;
+				rowRuns++;
+			}
+		}
+
+		last = line[width - 1];
+	}
+
+	/* Flat cells are always cheapest as part of the residual layer. */
+	mode = CLEAR_CELL_RESIDUAL;
+	cost = rowRuns * 4;
+
+	if (rowRuns <= height)
+		return mode;
+
+	if (clear_build_palette(palette, pSrc, nSrcStep, width, height))
+	{
+		UINT32 bandsCost;
+		const UINT32 rlexCost = 13 + 1 + 3 * palette->count + 2 * (runs + 1);
+		UINT32 colorBkg = palette->colors[0];
+		UINT32 hits = palette->hits[0];
+
+		for (UINT32 i = 1; i < palette->count; i++)
+		{
+			if (palette->hits[i] > hits)
+			{
+				hits = palette->hits[i];
+				colorBkg = palette->colors[i];
+			}
+		}
+
+		if (rlexCost < cost)
+		{
+			mode = CLEAR_CELL_RLEX;
+			cost = rlexCost;
+		}
+
+		bandsCost = clear_estimate_bands(clear, pSrc, nSrcStep, width, height, colorBkg);
+
+		if (bandsCost < cost)
+		{
+			mode = CLEAR_CELL_BANDS;
+			cost = bandsCost;
+		}
+
+		*pColorBkg = colorBkg;
+	}
+	else if (allowLossy)
+		return CLEAR_CELL_NSCODEC;
+
+	if ((13 + 3 * width * height) < cost)
+		mode = CLEAR_CELL_UNCOMPRESSED;
+
+	return mode;
+}
+
+static BOOL clear_encode_residual(CLEAR_CONTEXT* clear, UINT32 nWidth, UINT32 nHeight,
+                                  UINT32 nCellsX)
+{
+	wStream* s = clear->ResidualStream;
+	BOOL fixed = FALSE;
+	UINT32 color = 0;
+	UINT32 runLength = 0;
+
+	for (UINT32 y = 0; y < nHeight; y++)
+	{
+		const UINT32* line = &clear->EncodeBuffer[1ull * y * nWidth];
+		const BYTE* modes = &clear->CellModes[1ull * (y / CLEARCODEC_VBAR_MAX_HEIGHT) * nCellsX];
+
+		for (UINT32 x = 0; x < nWidth; x++)
+		{
+			/* Pixels covered by bands or subcodecs are overwritten by the decoder,
+			 * so they simply extend whatever run is active. */
+			if (modes[x / CLEARCODEC_CELL_WIDTH] == CLEAR_CELL_RESIDUAL)
+			{
+				if (!fixed)
+				{
+					color = line[x];
+					fixed = TRUE;
+				}
+				else if (line[x] != color)
+				{
+					if (!Stream_EnsureRemainingCapacity(s, 3))
+						return FALSE;
+
+					clear_write_bgr(s, color);
+
+					if (!clear_write_run_length(s, runLength))
+						return FALSE;
+
+					color = line[x];
+					runLength = 0;
+				}
+			}
+
+			runLength++;
+		}
+	}
+
+	if (!fixed)
+		return TRUE;
+
+	if (!Stream_EnsureRemainingCapacity(s, 3))
+		return FALSE;
+
+	clear_write_bgr(s, color);
+	return clear_write_run_length(s, runLength);
+}
+
+static BOOL clear_encode_bands(CLEAR_CONTEXT* clear, const UINT32* pSrc, UINT32 nSrcStep,
+                               UINT32 xStart, UINT32 yStart, UINT32 width, UINT32 height,
+                               UINT32 colorBkg)
+{
+	wStream* s = clear->BandsStream;
+	UINT32 column[CLEARCODEC_VBAR_MAX_HEIGHT];
+
+	if (!Stream_EnsureRemainingCapacity(s, 11))
+		return FALSE;
+
+	Stream_Write_UINT16(s, xStart);
+	Stream_Write_UINT16(s, xStart + width - 1);
+	Stream_Write_UINT16(s, yStart);
+	Stream_Write_UINT16(s, yStart + height - 1);
+	clear_write_bgr(s, colorBkg);
+
+	for (UINT32 x = 0; x < width; x++)
+	{
+		UINT32 yOn;
+		UINT32 count;
+		UINT32 shortHash;
+		INT32 index;
+		clear_read_column(&pSrc[x], nSrcStep, height, column);
+		index = clear_vbar_mirror_find(&clear->VBarMirror,
+		                               clear_hash_pixels(column, height, height), column, height);
+
+		if (!Stream_EnsureRemainingCapacity(s, 2 + 3 * CLEARCODEC_VBAR_MAX_HEIGHT))
+			return FALSE;
+
+		if (index >= 0)
+		{
+			Stream_Write_UINT16(s, 0x8000 | (UINT32)index); /* VBAR_CACHE_HIT */
+			continue;
+		}
+
+		count = clear_vbar_short_range(column, height, colorBkg, &yOn);
+		shortHash = clear_hash_pixels(&column[yOn], count, count);
+		index = clear_vbar_mirror_find(&clear->ShortVBarMirror, shortHash, &column[yOn], count);
+
+		if (index >= 0)
+		{
+			Stream_Write_UINT16(s, 0x4000 | (UINT32)index); /* SHORT_VBAR_CACHE_HIT */
+			Stream_Write_UINT8(s, yOn);
+		}
+		else
+		{
+			Stream_Write_UINT16(s, ((yOn + count) << 8) | yOn); /* SHORT_VBAR_CACHE_MISS */
+
+			for (UINT32 y = 0; y < count; y++)
+				clear_write_bgr(s, column[yOn + y]);
+
+			clear_vbar_mirror_insert(&clear->ShortVBarMirror, shortHash, &column[yOn], count);
+		}
+
+		clear_vbar_mirror_insert(&clear->VBarMirror, clear_hash_pixels(column, height, height),
+		                         column, height);
+	}
+
+	return TRUE;
+}
+
+static BOOL clear_encode_rlex(wStream* s, CLEAR_PALETTE* palette, const UINT32* pSrc,
+                              UINT32 nSrcStep, UINT32 width, UINT32 height)
+{
+	const UINT32 numBits = CLEAR_LOG2_FLOOR[palette->count - 1] + 1;
+	const UINT32 maxDepth = CLEAR_8BIT_MASKS[8 - numBits];
+	const UINT32 pixelCount = width * height;
+	UINT32 pixelIndex = 0;
+
+	if (!Stream_EnsureRemainingCapacity(s, 1 + 3 * palette->count))
+		return FALSE;
+
+	Stream_Write_UINT8(s, palette->count);
+
+	for (UINT32 i = 0; i < palette->count; i++)
+		clear_write_bgr(s, palette->colors[i]);
+
+	while (pixelIndex < pixelCount)
+	{
+		UINT32 runLength = 1;
+		UINT32 suiteDepth = 0;
+		const UINT32 color = pSrc[1ull * (pixelIndex / width) * nSrcStep + (pixelIndex % width)];
+		const UINT32 startIndex = (UINT32)clear_palette_index(palette, color);
+
+		while (pixelIndex + runLength < pixelCount)
+		{
+			const UINT32 next = pixelIndex + runLength;
+
+			if (pSrc[1ull * (next / width) * nSrcStep + (next % width)] != color)
+				break;
+
+			runLength++;
+		}
+
+		/* Extend with a suite of ascending palette indices following the run. */
+		while ((suiteDepth < maxDepth) && (startIndex + suiteDepth + 1 < palette->count) &&
+		       (pixelIndex + runLength + suiteDepth < pixelCount))
+		{
+			const UINT32 next = pixelIndex + runLength + suiteDepth;
+
+			if (pSrc[1ull * (next / width) * nSrcStep + (next % width)] !=
+			    palette->colors[startIndex + suiteDepth + 1])
+				break;
+
+			suiteDepth++;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(s, 1))
+			return FALSE;
+
+		Stream_Write_UINT8(s, (suiteDepth << numBits) | (startIndex + suiteDepth));
+
+		if (!clear_write_run_length(s, runLength - 1))
+			return FALSE;
+
+		pixelIndex += runLength + suiteDepth;
+	}
+
+	return TRUE;
+}
+
+static BOOL clear_encode_subcodec(CLEAR_CONTEXT* clear, CLEAR_PALETTE* palette, const UINT32* pSrc,
+                                  UINT32 nSrcStep, UINT32 xStart, UINT32 yStart, UINT32 width,
+                                  UINT32 height, CLEAR_CELL_MODE mode)
+{
+	BOOL rc;
+	size_t start;
+	size_t end;
+	BYTE subcodecId;
+	wStream* s = clear->SubcodecStream;
+
+	if (!Stream_EnsureRemainingCapacity(s, 13))
+		return FALSE;
+
+	start = Stream_GetPosition(s);
+	Stream_Write_UINT16(s, xStart);
+	Stream_Write_UINT16(s, yStart);
+	Stream_Write_UINT16(s, width);
+	Stream_Write_UINT16(s, height);
+	Stream_Seek(s, 5); /* bitmapDataByteCount and subcodecId are written below */
+
+	switch (mode)
+	{
+		case CLEAR_CELL_RLEX:
+			subcodecId = CLEARCODEC_SUBCODEC_RLEX;
+			rc = clear_encode_rlex(s, palette, pSrc, nSrcStep, width, height);
+			break;
+
+		case CLEAR_CELL_NSCODEC:
+			subcodecId = CLEARCODEC_SUBCODEC_NSCODEC;
+			rc = nsc_compose_message(clear->nsc, s, (const BYTE*)pSrc, width, height,
+			                         nSrcStep * sizeof(UINT32));
+
+			/* NSCodec does not pay off for small or noisy cells, send them raw. */
+			if (rc && ((Stream_GetPosition(s) - start - 13) < 3ull * width * height))
+				break;
+
+			Stream_SetPosition(s, start + 13);
+			/* fallthrough */
+
+		default:
+			subcodecId = CLEARCODEC_SUBCODEC_UNCOMPRESSED;
+			rc = Stream_EnsureRemainingCapacity(s, 3ull * width * height);
+
+			for (UINT32 y = 0; rc && (y < height); y++)
+			{
+				const UINT32* line = &pSrc[1ull * y * nSrcStep];
+
+				for (UINT32 x = 0; x < width; x++)
+					clear_write_bgr(s, line[x]);
+			}
+
+			break;
+	}
+
+	if (!rc)
+		return FALSE;
+
+	end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start + 8);
+	Stream_Write_UINT32(s, (UINT32)(end - start - 13));
+	Stream_Write_UINT8(s, subcodecId);
+	Stream_SetPosition(s, end);
+	return TRUE;
+}
+
+static BOOL clear_encode_composition(CLEAR_CONTEXT* clear, UINT32 nWidth, UINT32 nHeight,
+                                     BOOL allowLossy)
+{
+	BOOL residual = FALSE;
+	CLEAR_PALETTE palette;
+	const UINT32 nCellsX = (nWidth + CLEARCODEC_CELL_WIDTH - 1) / CLEARCODEC_CELL_WIDTH;
+	const UINT32 nCellsY = (nHeight + CLEARCODEC_VBAR_MAX_HEIGHT - 1) / CLEARCODEC_VBAR_MAX_HEIGHT;
+	const size_t nCells = 1ull * nCellsX * nCellsY;
+
+	if (nCells > clear->CellModesSize)
+	{
+		BYTE* tmp = (BYTE*)realloc(clear->CellModes, nCells);
+
+		if (!tmp)
+			return FALSE;
+
+		clear->CellModes = tmp;
+		clear->CellModesSize = nCells;
+	}
+
+	Stream_SetPosition(clear->ResidualStream, 0);
+	Stream_SetPosition(clear->BandsStream, 0);
+	Stream_SetPosition(clear->SubcodecStream, 0);
+
+	/* Bands and subcodecs are emitted while classifying, the residual layer
+	 * needs the complete classification and is built last. */
+	for (UINT32 cy = 0; cy < nCellsY; cy++)
+	{
+		const UINT32 yStart = cy * CLEARCODEC_VBAR_MAX_HEIGHT;
+		const UINT32 height = MIN(CLEARCODEC_VBAR_MAX_HEIGHT, nHeight - yStart);
+
+		for (UINT32 cx = 0; cx < nCellsX; cx++)
+		{
+			UINT32 colorBkg = 0;
+			const UINT32 xStart = cx * CLEARCODEC_CELL_WIDTH;
+			const UINT32 width = MIN(CLEARCODEC_CELL_WIDTH, nWidth - xStart);
+			const UINT32* pSrc = &clear->EncodeBuffer[1ull * yStart * nWidth + xStart];
+			const CLEAR_CELL_MODE mode = clear_select_cell_mode(
+			    clear, &palette, pSrc, nWidth, width, height, allowLossy, &colorBkg);
+			BOOL rc = TRUE;
+			clear->CellModes[1ull * cy * nCellsX + cx] = (BYTE)mode;
+
+			switch (mode)
+			{
+				case CLEAR_CELL_RESIDUAL:
+					residual = TRUE;
+					break;
+
+				case CLEAR_CELL_BANDS:
+					rc = clear_encode_bands(clear, pSrc, nWidth, xStart, yStart, width, height,
+					                        colorBkg);
+					break;
+
+				default:
+					rc = clear_encode_subcodec(clear, &palette, pSrc, nWidth, xStart, yStart,
+					                           width, height, mode);
+					break;
+			}
+
+			if (!rc)
+				return FALSE;
+		}
+	}
+
+	if (residual)
+		return clear_encode_residual(clear, nWidth, nHeight, nCellsX);
+
+	return TRUE;
+}
+
+static INT32 clear_glyph_find(const CLEAR_CONTEXT* clear, UINT32 hash, const UINT32* pixels,
+                              UINT32 nWidth, UINT32 nHeight)
+{
+	for (UINT32 i = 0; i < CLEARCODEC_GLYPH_CACHE_SIZE; i++)
+	{
+		const CLEAR_GLYPH_KEY* key = &clear->GlyphKeys[i];
+
+		if (key->valid && (key->hash == hash) && (key->width == nWidth) &&
+		    (key->height == nHeight) &&
+		    (memcmp(key->pixels, pixels, nWidth * nHeight * sizeof(UINT32)) == 0))
+			return (INT32)i;
+	}
+
+	return -1;
+}
+
+int clear_compress(CLEAR_CONTEXT* clear, const BYTE* pSrcData, UINT32 SrcSize, UINT32 SrcFormat,
+                   UINT32 nWidth, UINT32 nHeight, UINT32 nSrcStep, BYTE** ppDstData,
                    UINT32* pDstSize)
 {
-	WLog_ERR(TAG, "TODO: %s not implemented!", __FUNCTION__);
+	BYTE glyphFlags = 0;
+	UINT32 glyphHash = 0;
+	INT32 glyphIndex = -1;
+	BOOL glyph = FALSE;
+	size_t pixelCount;
+	wStream* s;
+
+	if (!clear || !clear->Compressor || !pSrcData || !ppDstData || !pDstSize)
+		return -1;
+
+	if ((nWidth == 0) || (nHeight == 0) || (nWidth > 0xFFFF) || (nHeight > 0xFFFF))
+		return -1;
+
+	if (nSrcStep == 0)
+		nSrcStep = nWidth * FreeRDPGetBytesPerPixel(SrcFormat);
+
+	if (SrcSize < 1ull * nSrcStep * (nHeight - 1) + nWidth * FreeRDPGetBytesPerPixel(SrcFormat))
+		return -1;
+
+	pixelCount = 1ull * nWidth * nHeight;
+
+	if (pixelCount > clear->EncodeBufferSize)
+	{
+		UINT32* tmp = (UINT32*)realloc(clear->EncodeBuffer, pixelCount * sizeof(UINT32));
+
+		if (!tmp)
+			return -1;
+
+		clear->EncodeBuffer = tmp;
+		clear->EncodeBufferSize = pixelCount;
+	}
+
+	/* Work on 24bpp colors, the alpha channel is not transported */
+	if (!freerdp_image_copy((BYTE*)clear->EncodeBuffer, PIXEL_FORMAT_BGRX32, nWidth * 4, 0, 0,
+	                        nWidth, nHeight, pSrcData, SrcFormat, nSrcStep, 0, 0, NULL,
+	                        FREERDP_FLIP_NONE))
+		return -1;
+
+	for (size_t i = 0; i < pixelCount; i++)
+		clear->EncodeBuffer[i] &= 0x00FFFFFF;
+
+	if (clear->PendingCacheReset)
+		glyphFlags |= CLEARCODEC_FLAG_CACHE_RESET;
+
+	s = clear->Stream;
+	Stream_SetPosition(s, 0);
+
+	if (!Stream_EnsureRemainingCapacity(s, 16))
+		return -1;
+
+	if (pixelCount <= CLEARCODEC_GLYPH_MAX_PIXELS)
+	{
+		glyphHash = clear_hash_pixels(clear->EncodeBuffer, (UINT32)pixelCount, nWidth);
+		glyphIndex = clear_glyph_find(clear, glyphHash, clear->EncodeBuffer, nWidth, nHeight);
+
+		if (glyphIndex >= 0)
+		{
+			Stream_Write_UINT8(s, glyphFlags | CLEARCODEC_FLAG_GLYPH_INDEX |
+			                          CLEARCODEC_FLAG_GLYPH_HIT);
+			Stream_Write_UINT8(s, clear->seqNumber);
+			Stream_Write_UINT16(s, (UINT16)glyphIndex);
+			goto finish;
+		}
+
+		glyph = TRUE;
+		glyphIndex = (INT32)clear->GlyphCursor;
+		glyphFlags |= CLEARCODEC_FLAG_GLYPH_INDEX;
+	}
+
+	/* Glyphs are cached by the client as decoded, so they must be lossless */
+	if (!clear_encode_composition(clear, nWidth, nHeight, !glyph))
+		return -1;
+
+	{
+		const size_t residualByteCount = Stream_GetPosition(clear->ResidualStream);
+		const size_t bandsByteCount = Stream_GetPosition(clear->BandsStream);
+		const size_t subcodecByteCount = Stream_GetPosition(clear->SubcodecStream);
+
+		if (!Stream_EnsureRemainingCapacity(
+		        s, 16 + residualByteCount + bandsByteCount + subcodecByteCount))
+			return -1;
+
+		Stream_Write_UINT8(s, glyphFlags);
+		Stream_Write_UINT8(s, clear->seqNumber);
+
+		if (glyph)
+			Stream_Write_UINT16(s, (UINT16)glyphIndex);
+
+		Stream_Write_UINT32(s, (UINT32)residualByteCount);
+		Stream_Write_UINT32(s, (UINT32)bandsByteCount);
+		Stream_Write_UINT32(s, (UINT32)subcodecByteCount);
+		Stream_Write(s, Stream_Buffer(clear->ResidualStream), residualByteCount);
+		Stream_Write(s, Stream_Buffer(clear->BandsStream), bandsByteCount);
+		Stream_Write(s, Stream_Buffer(clear->SubcodecStream), subcodecByteCount);
+	}
+
+	if (glyph)
+	{
+		CLEAR_GLYPH_KEY* key = &clear->GlyphKeys[glyphIndex];
+		key->valid = TRUE;
+		key->hash = glyphHash;
+		key->width = nWidth;
+		key->height = nHeight;
+		memcpy(key->pixels, clear->EncodeBuffer, pixelCount * sizeof(UINT32));
+		clear->GlyphCursor = (clear->GlyphCursor + 1) % CLEARCODEC_GLYPH_CACHE_SIZE;
+	}
+
+finish:
+	clear->PendingCacheReset = FALSE;
+	clear->seqNumber = (clear->seqNumber + 1) % 256;
+	*ppDstData = Stream_Buffer(s);
+	*pDstSize = (UINT32)Stream_GetPosition(s);
 	return 1;
 }
+
 BOOL clear_context_reset(CLEAR_CONTEXT* clear)
 {
 	if (!clear)
 		return FALSE;
 
 	clear->seqNumber = 0;
+
+	if (clear->Compressor)
+	{
+		clear->PendingCacheReset = TRUE;
+		clear->GlyphCursor = 0;
+
+		if (clear->GlyphKeys)
+		{
+			for (UINT32 i = 0; i < CLEARCODEC_GLYPH_CACHE_SIZE; i++)
+				clear->GlyphKeys[i].valid = FALSE;
+		}
+
+		clear_vbar_mirror_reset(&clear->VBarMirror);
+		clear_vbar_mirror_reset(&clear->ShortVBarMirror);
+	}
+
 	return TRUE;
 }
 CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
@@ -1120,6 +1973,28 @@ CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
 	if (!clear->TempBuffer)
 		goto error_nsc;
 
+	if (Compressor)
+	{
+		clear->Stream = Stream_New(NULL, 4096);
+		clear->ResidualStream = Stream_New(NULL, 4096);
+		clear->BandsStream = Stream_New(NULL, 4096);
+		clear->SubcodecStream = Stream_New(NULL, 4096);
+		clear->GlyphKeys =
+		    (CLEAR_GLYPH_KEY*)calloc(CLEARCODEC_GLYPH_CACHE_SIZE, sizeof(CLEAR_GLYPH_KEY));
+
+		if (!clear->Stream || !clear->ResidualStream || !clear->BandsStream ||
+		    !clear->SubcodecStream || !clear->GlyphKeys)
+			goto error_nsc;
+
+		if (!clear_vbar_mirror_init(&clear->VBarMirror, CLEARCODEC_VBAR_SIZE,
+		                            CLEARCODEC_VBAR_HASH_BITS))
+			goto error_nsc;
+
+		if (!clear_vbar_mirror_init(&clear->ShortVBarMirror, CLEARCODEC_VBAR_SHORT_SIZE,
+		                            CLEARCODEC_VBAR_SHORT_HASH_BITS))
+			goto error_nsc;
+	}
+
 	if (!clear_context_reset(clear))
 		goto error_nsc;
 
@@ -1147,5 +2022,14 @@ void clear_context_free(CLEAR_CONTEXT* clear)
 	for (i = 0; i < 16384; i++)
 		free(clear->ShortVBarStorage[i].pixels);
 
+	Stream_Free(clear->Stream, TRUE);
+	Stream_Free(clear->ResidualStream, TRUE);
+	Stream_Free(clear->BandsStream, TRUE);
+	Stream_Free(clear->SubcodecStream, TRUE);
+	free(clear->EncodeBuffer);
+	free(clear->CellModes);
+	free(clear->GlyphKeys);
+	clear_vbar_mirror_uninit(&clear->VBarMirror);
+	clear_vbar_mirror_uninit(&clear->ShortVBarMirror);
 	free(clear);
 }
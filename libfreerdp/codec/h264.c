@@ -32,9 +32,20 @@
 #include <freerdp/log.h>
 
 #include "h264.h"
+#include "h264_sse2.h"
 
 #define TAG FREERDP_TAG("codec")
 
+#ifndef H264_INIT_SIMD
+#define H264_INIT_SIMD(_h264) \
+	do                        \
+	{                         \
+	} while (0)
+#endif
+
+/* Size of the blocks compared for change detection */
+#define H264_CHANGE_TILE_SIZE 64
+
 static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight);
 
 BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT32 height)
@@ -57,7 +68,7 @@ BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT3
 
 	for (x = 0; x < 3; x++)
 	{
-		if (!h264->pYUVData[x] || !h264->pOldYUVData[x])
+		if (!h264->pYUVData[x])
 			isNull = TRUE;
 	}
 
@@ -72,14 +83,10 @@ BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT3
 
 		for (x = 0; x < 3; x++)
 		{
-			BYTE* tmp1 = _aligned_recalloc(h264->pYUVData[x], h264->iStride[x], pheight, 16);
-			BYTE* tmp2 = _aligned_recalloc(h264->pOldYUVData[x], h264->iStride[x], pheight, 16);
-			if (tmp1)
-				h264->pYUVData[x] = tmp1;
-			if (tmp2)
-				h264->pOldYUVData[x] = tmp2;
-			if (!tmp1 || !tmp2)
+			BYTE* tmp = _aligned_recalloc(h264->pYUVData[x], h264->iStride[x], pheight, 16);
+			if (!tmp)
 				return FALSE;
+			h264->pYUVData[x] = tmp;
 		}
 	}
 
@@ -114,169 +121,237 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	return 1;
 }
 
-static BOOL allocate_h264_metablock(UINT32 QP, RECTANGLE_16* rectangles,
-                                    RDPGFX_H264_METABLOCK* meta, size_t count)
+BOOL h264_tile_equal_c(const BYTE* pData1, const BYTE* pData2, UINT32 nStep, UINT32 nWidth,
+                       UINT32 nHeight)
 {
-	size_t x;
+	UINT32 y;
 
-	/* [MS-RDPEGFX] 2.2.4.4.2 RDPGFX_AVC420_QUANT_QUALITY */
-	if (!meta || (QP > UINT8_MAX))
-		return FALSE;
+	for (y = 0; y < nHeight; y++)
+	{
+		const size_t offset = 1ull * y * nStep;
 
-	meta->regionRects = rectangles;
-	if (count == 0)
-		return TRUE;
+		if (memcmp(&pData1[offset], &pData2[offset], nWidth) != 0)
+			return FALSE;
+	}
 
-	if (count > UINT32_MAX)
-		return FALSE;
+	return TRUE;
+}
 
-	meta->quantQualityVals = calloc(count, sizeof(RDPGFX_H264_QUANT_QUALITY));
+static void h264_copy_tile(BYTE* pDstData, const BYTE* pSrcData, UINT32 nStep, UINT32 nWidth,
+                           UINT32 nHeight)
+{
+	UINT32 y;
 
-	if (!meta->quantQualityVals || !meta->regionRects)
-		return FALSE;
-	meta->numRegionRects = (UINT32)count;
-	for (x = 0; x < count; x++)
+	for (y = 0; y < nHeight; y++)
 	{
-		RDPGFX_H264_QUANT_QUALITY* cur = &meta->quantQualityVals[x];
-		cur->qp = (UINT8)QP;
-
-		/* qpVal bit 6 and 7 are flags, so mask them out here.
-		 * qualityVal is [0-100] so 100 - qpVal [0-64] is always in range */
-		cur->qualityVal = 100 - (QP & 0x3F);
+		const size_t offset = 1ull * y * nStep;
+		memcpy(&pDstData[offset], &pSrcData[offset], nWidth);
 	}
-	return TRUE;
 }
 
-static INLINE BOOL diff_tile(const RECTANGLE_16* regionRect, BYTE* pYUVData[3],
-                             BYTE* pOldYUVData[3], UINT32 const iStride[3])
+static BOOL h264_ensure_change_buffers(H264_CONTEXT* h264, UINT32 nSrcStep, UINT32 nSrcHeight,
+                                       const RECTANGLE_16* regionRect)
 {
-	size_t size, y;
-	if (!regionRect || !pYUVData || !pOldYUVData || !iStride)
-		return FALSE;
-	size = regionRect->right - regionRect->left;
-	if (regionRect->right > iStride[0])
-		return FALSE;
-	if (regionRect->right / 2 > iStride[1])
-		return FALSE;
-	if (regionRect->right / 2 > iStride[2])
-		return FALSE;
+	const size_t size = 1ull * nSrcStep * nSrcHeight;
+	const size_t wc = (regionRect->right - regionRect->left) / H264_CHANGE_TILE_SIZE + 2;
+	const size_t hc = (regionRect->bottom - regionRect->top) / H264_CHANGE_TILE_SIZE + 2;
 
-	for (y = regionRect->top; y < regionRect->bottom; y++)
+	if ((size != h264->OldSrcSize) || (nSrcStep != h264->OldSrcStep) || !h264->pOldSrcData)
 	{
-		const BYTE* cur0 = &pYUVData[0][y * iStride[0]];
-		const BYTE* cur1 = &pYUVData[1][y * iStride[1]];
-		const BYTE* cur2 = &pYUVData[2][y * iStride[2]];
-		const BYTE* old0 = &pOldYUVData[0][y * iStride[0]];
-		const BYTE* old1 = &pOldYUVData[1][y * iStride[1]];
-		const BYTE* old2 = &pOldYUVData[2][y * iStride[2]];
-
-		if (memcmp(&cur0[regionRect->left], &old0[regionRect->left], size) != 0)
-			return TRUE;
-		if (memcmp(&cur1[regionRect->left / 2], &old1[regionRect->left / 2], size / 2) != 0)
-			return TRUE;
-		if (memcmp(&cur2[regionRect->left / 2], &old2[regionRect->left / 2], size / 2) != 0)
-			return TRUE;
+		BYTE* tmp = (BYTE*)realloc(h264->pOldSrcData, size);
+
+		if (!tmp)
+			return FALSE;
+
+		h264->pOldSrcData = tmp;
+		h264->OldSrcSize = size;
+		h264->OldSrcStep = nSrcStep;
+		h264->OldSrcValid = FALSE;
 	}
-	return FALSE;
+
+	if (wc * hc > h264->maxChangedRects)
+	{
+		RECTANGLE_16* rects =
+		    (RECTANGLE_16*)realloc(h264->changedRects, wc * hc * sizeof(RECTANGLE_16));
+
+		if (!rects)
+			return FALSE;
+
+		h264->changedRects = rects;
+		h264->maxChangedRects = wc * hc;
+	}
+
+	return TRUE;
 }
 
-static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE_16* regionRect,
-                           BYTE* pYUVData[3], BYTE* pOldYUVData[3], UINT32 const iStride[3],
-                           RDPGFX_H264_METABLOCK* meta)
+/**
+ * Compares the source frame with the copy of the last encoded one in blocks of
+ * H264_CHANGE_TILE_SIZE and collects the changed blocks in h264->changedRects,
+ * horizontally adjacent blocks are merged. Changed blocks are copied to the old
+ * frame so only they need to be color converted and encoded.
+ * If full is set, or the old frame is not usable, the whole region is returned.
+ */
+static BOOL detect_changes(H264_CONTEXT* h264, BOOL full, const BYTE* pSrcData, DWORD SrcFormat,
+                           UINT32 nSrcStep, UINT32 nSrcHeight, const RECTANGLE_16* regionRect,
+                           UINT32* pCount)
 {
-	size_t count = 0, wc, hc;
-	RECTANGLE_16* rectangles;
+	UINT32 x, y;
+	UINT32 count = 0;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(SrcFormat);
+
+	if (!h264 || !pSrcData || !regionRect || !pCount || (bpp == 0))
+		return FALSE;
 
-	if (!regionRect || !pYUVData || !pOldYUVData || !iStride || !meta)
+	if ((regionRect->right <= regionRect->left) || (regionRect->bottom <= regionRect->top) ||
+	    (regionRect->bottom > nSrcHeight) || (1ull * regionRect->right * bpp > nSrcStep))
 		return FALSE;
 
-	wc = (regionRect->right - regionRect->left) / 64 + 1;
-	hc = (regionRect->bottom - regionRect->top) / 64 + 1;
-	rectangles = calloc(wc * hc, sizeof(RECTANGLE_16));
-	if (!rectangles)
+	if (!h264_ensure_change_buffers(h264, nSrcStep, nSrcHeight, regionRect))
 		return FALSE;
-	if (!firstFrameDone)
+
+	if (full || !h264->OldSrcValid)
 	{
-		rectangles[0] = *regionRect;
-		count = 1;
+		const size_t offset = 1ull * regionRect->top * nSrcStep + 1ull * regionRect->left * bpp;
+
+		h264_copy_tile(&h264->pOldSrcData[offset], &pSrcData[offset], nSrcStep,
+		               (regionRect->right - regionRect->left) * bpp,
+		               regionRect->bottom - regionRect->top);
+		h264->changedRects[count++] = *regionRect;
+		h264->OldSrcValid = TRUE;
+		*pCount = count;
+		return TRUE;
 	}
-	else
+
+	for (y = regionRect->top; y < regionRect->bottom; y += H264_CHANGE_TILE_SIZE)
 	{
-		size_t x, y;
-		for (y = regionRect->top; y < regionRect->bottom; y += 64)
+		const UINT32 height = MIN(H264_CHANGE_TILE_SIZE, regionRect->bottom - y);
+		RECTANGLE_16* last = NULL;
+
+		for (x = regionRect->left; x < regionRect->right; x += H264_CHANGE_TILE_SIZE)
 		{
-			for (x = regionRect->left; x < regionRect->right; x += 64)
+			const UINT32 width = MIN(H264_CHANGE_TILE_SIZE, regionRect->right - x);
+			const size_t offset = 1ull * y * nSrcStep + 1ull * x * bpp;
+
+			if (h264->TileEqual(&h264->pOldSrcData[offset], &pSrcData[offset], nSrcStep,
+			                    width * bpp, height))
+			{
+				last = NULL;
+				continue;
+			}
+
+			h264_copy_tile(&h264->pOldSrcData[offset], &pSrcData[offset], nSrcStep, width * bpp,
+			               height);
+
+			if (last)
 			{
-				RECTANGLE_16 rect;
-				rect.left = (UINT16)MIN(UINT16_MAX, regionRect->left + x);
-				rect.top = (UINT16)MIN(UINT16_MAX, regionRect->top + y);
-				rect.right =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->left + x + 64, regionRect->right));
-				rect.bottom =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->top + y + 64, regionRect->bottom));
-				if (diff_tile(&rect, pYUVData, pOldYUVData, iStride))
-					rectangles[count++] = rect;
+				last->right = (UINT16)(x + width);
+				continue;
 			}
+
+			WINPR_ASSERT(count < h264->maxChangedRects);
+			last = &h264->changedRects[count++];
+			last->left = (UINT16)x;
+			last->top = (UINT16)y;
+			last->right = (UINT16)(x + width);
+			last->bottom = (UINT16)(y + height);
 		}
 	}
-	if (!allocate_h264_metablock(QP, rectangles, meta, count))
+
+	*pCount = count;
+	return TRUE;
+}
+
+static BOOL fill_h264_metablock(H264_CONTEXT* h264, UINT32 count, RDPGFX_H264_METABLOCK* meta)
+{
+	UINT32 x;
+	const UINT32 QP = h264->QP;
+	RDPGFX_H264_METABLOCK m = { 0 };
+
+	/* [MS-RDPEGFX] 2.2.4.4.2 RDPGFX_AVC420_QUANT_QUALITY */
+	if (!meta || (QP > UINT8_MAX))
 		return FALSE;
+
+	*meta = m;
+
+	if (count == 0)
+		return TRUE;
+
+	/* The metablock is owned by the caller and released with free_h264_metablock,
+	 * the context keeps its own buffers for the next frame. */
+	meta->regionRects = (RECTANGLE_16*)calloc(count, sizeof(RECTANGLE_16));
+	meta->quantQualityVals =
+	    (RDPGFX_H264_QUANT_QUALITY*)calloc(count, sizeof(RDPGFX_H264_QUANT_QUALITY));
+
+	if (!meta->regionRects || !meta->quantQualityVals)
+	{
+		free_h264_metablock(meta);
+		return FALSE;
+	}
+
+	memcpy(meta->regionRects, h264->changedRects, count * sizeof(RECTANGLE_16));
+	meta->numRegionRects = count;
+
+	for (x = 0; x < count; x++)
+	{
+		RDPGFX_H264_QUANT_QUALITY* cur = &meta->quantQualityVals[x];
+		cur->qp = (UINT8)QP;
+
+		/* qpVal bit 6 and 7 are flags, so mask them out here.
+		 * qualityVal is [0-100] so 100 - qpVal [0-64] is always in range */
+		cur->qualityVal = 100 - (QP & 0x3F);
+	}
+
 	return TRUE;
 }
 
+static void reset_h264_metablock(RDPGFX_H264_METABLOCK* meta)
+{
+	RDPGFX_H264_METABLOCK m = { 0 };
+
+	if (meta)
+		*meta = m;
+}
+
 INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
                       UINT32 nSrcWidth, UINT32 nSrcHeight, const RECTANGLE_16* regionRect,
                       BYTE** ppDstData, UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta)
 {
 	size_t x;
 	INT32 rc = -1;
-	BYTE* pYUVData[3] = { 0 };
+	UINT32 count = 0;
 	const BYTE* pcYUVData[3] = { 0 };
-	BYTE* pOldYUVData[3] = { 0 };
 
 	if (!h264 || !regionRect || !meta || !h264->Compressor)
 		return -1;
 
+	reset_h264_metablock(meta);
+
 	if (!h264->subsystem->Compress)
 		return -1;
 
 	if (!avc420_ensure_buffer(h264, nSrcStep, nSrcWidth, nSrcHeight))
 		return -1;
 
-	if (h264->encodingBuffer)
-	{
-		for (x = 0; x < 3; x++)
-		{
-			pYUVData[x] = h264->pYUVData[x];
-			pOldYUVData[x] = h264->pOldYUVData[x];
-		}
-	}
-	else
-	{
-		for (x = 0; x < 3; x++)
-		{
-			pYUVData[x] = h264->pOldYUVData[x];
-			pOldYUVData[x] = h264->pYUVData[x];
-		}
-	}
-	h264->encodingBuffer = !h264->encodingBuffer;
-
-	if (!yuv420_context_encode(h264->yuv, pSrcData, nSrcStep, SrcFormat, h264->iStride, pYUVData,
-	                           regionRect, 1))
+	/* Unchanged blocks keep their YUV data from the previous frames */
+	if (!detect_changes(h264, !h264->firstLumaFrameDone, pSrcData, SrcFormat, nSrcStep,
+	                    nSrcHeight, regionRect, &count))
 		goto fail;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, regionRect, pYUVData, pOldYUVData,
-	                    h264->iStride, meta))
-		goto fail;
-
-	if (meta->numRegionRects == 0)
+	if (count == 0)
 	{
 		rc = 0;
 		goto fail;
 	}
 
+	if (!yuv420_context_encode(h264->yuv, pSrcData, nSrcStep, SrcFormat, h264->iStride,
+	                           h264->pYUVData, h264->changedRects, count))
+		goto fail;
+
+	if (!fill_h264_metablock(h264, count, meta))
+		goto fail;
+
 	for (x = 0; x < 3; x++)
-		pcYUVData[x] = pYUVData[x];
+		pcYUVData[x] = h264->pYUVData[x];
 
 	rc = h264->subsystem->Compress(h264, pcYUVData, h264->iStride, ppDstData, pDstSize);
 	if (rc >= 0)
@@ -284,7 +359,11 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 
 fail:
 	if (rc < 0)
+	{
+		/* The old frame already contains the blocks that were not sent */
+		h264->OldSrcValid = FALSE;
 		free_h264_metablock(meta);
+	}
 	return rc;
 }
 
@@ -297,14 +376,16 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	int rc = -1;
 	BYTE* coded;
 	UINT32 codedSize;
+	UINT32 count = 0;
 	BYTE** pYUV444Data;
-	BYTE** pOldYUV444Data;
 	BYTE** pYUVData;
-	BYTE** pOldYUVData;
 
 	if (!h264 || !h264->Compressor)
 		return -1;
 
+	reset_h264_metablock(meta);
+	reset_h264_metablock(auxMeta);
+
 	if (!h264->subsystem->Compress)
 		return -1;
 
@@ -314,31 +395,13 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	if (!avc444_ensure_buffer(h264, nSrcHeight))
 		return -1;
 
-	if (h264->encodingBuffer)
-	{
-		pYUV444Data = h264->pOldYUV444Data;
-		pOldYUV444Data = h264->pYUV444Data;
-		pYUVData = h264->pOldYUVData;
-		pOldYUVData = h264->pYUVData;
-	}
-	else
-	{
-		pYUV444Data = h264->pYUV444Data;
-		pOldYUV444Data = h264->pOldYUV444Data;
-		pYUVData = h264->pYUVData;
-		pOldYUVData = h264->pOldYUVData;
-	}
-	h264->encodingBuffer = !h264->encodingBuffer;
-
-	if (!yuv444_context_encode(h264->yuv, version, pSrcData, nSrcStep, SrcFormat, h264->iStride,
-	                           pYUV444Data, pYUVData, region, 1))
-		goto fail;
+	pYUV444Data = h264->pYUV444Data;
+	pYUVData = h264->pYUVData;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, region, pYUV444Data, pOldYUV444Data,
-	                    h264->iStride, meta))
-		goto fail;
-	if (!detect_changes(h264->firstChromaFrameDone, h264->QP, region, pYUVData, pOldYUVData,
-	                    h264->iStride, auxMeta))
+	/* Unchanged blocks keep their YUV data from the previous frames, so
+	 * RGBToAVC444YUV only runs on the changed ones */
+	if (!detect_changes(h264, !h264->firstLumaFrameDone || !h264->firstChromaFrameDone, pSrcData,
+	                    SrcFormat, nSrcStep, nSrcHeight, region, &count))
 		goto fail;
 
 	/* [MS-RDPEGFX] 2.2.4.5 RFX_AVC444_BITMAP_STREAM
@@ -346,21 +409,25 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	 * 0 ... Luma & Chroma
 	 * 1 ... Luma
 	 * 2 ... Chroma
+	 *
+	 * A changed source block changes both, so either both or none are sent.
 	 */
-	if ((meta->numRegionRects > 0) && (auxMeta->numRegionRects > 0))
-		*op = 0;
-	else if (meta->numRegionRects > 0)
-		*op = 1;
-	else if (auxMeta->numRegionRects > 0)
-		*op = 2;
-	else
+	if (count == 0)
 	{
-		WLog_INFO(TAG, "no changes detected for luma or chroma frame");
+		WLog_DBG(TAG, "no changes detected for luma or chroma frame");
 		rc = 0;
 		goto fail;
 	}
 
-	if ((*op == 0) || (*op == 1))
+	*op = 0;
+
+	if (!yuv444_context_encode(h264->yuv, version, pSrcData, nSrcStep, SrcFormat, h264->iStride,
+	                           pYUV444Data, pYUVData, h264->changedRects, count))
+		goto fail;
+
+	if (!fill_h264_metablock(h264, count, meta) || !fill_h264_metablock(h264, count, auxMeta))
+		goto fail;
+
 	{
 		const BYTE* pcYUV444Data[3] = { pYUV444Data[0], pYUV444Data[1], pYUV444Data[2] };
 
@@ -372,7 +439,6 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 		*pDstSize = codedSize;
 	}
 
-	if ((*op == 0) || (*op == 2))
 	{
 		const BYTE* pcYUVData[3] = { pYUVData[0], pYUVData[1], pYUVData[2] };
 
@@ -387,6 +453,7 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 fail:
 	if (rc < 0)
 	{
+		h264->OldSrcValid = FALSE;
 		free_h264_metablock(meta);
 		free_h264_metablock(auxMeta);
 	}
@@ -400,7 +467,6 @@ static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
 	UINT32* piDstSize = h264->iYUV444Size;
 	UINT32* piDstStride = h264->iYUV444Stride;
 	BYTE** ppYUVDstData = h264->pYUV444Data;
-	BYTE** ppOldYUVDstData = h264->pOldYUV444Data;
 	const UINT32 pad = nDstHeight % 16;
 	UINT32 padDstHeight = nDstHeight; /* Need alignment to 16x16 blocks */
 
@@ -411,18 +477,13 @@ static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
 	{
 		for (x = 0; x < 3; x++)
 		{
-			BYTE* tmp1;
-			BYTE* tmp2;
+			BYTE* tmp;
 			piDstStride[x] = piMainStride[0];
 			piDstSize[x] = piDstStride[x] * padDstHeight;
-			tmp1 = _aligned_recalloc(ppYUVDstData[x], piDstSize[x], 1, 16);
-			if (tmp1)
-				ppYUVDstData[x] = tmp1;
-			tmp2 = _aligned_recalloc(ppOldYUVDstData[x], piDstSize[x], 1, 16);
-			if (tmp2)
-				ppOldYUVDstData[x] = tmp2;
-			if (!tmp1 || !tmp2)
+			tmp = _aligned_recalloc(ppYUVDstData[x], piDstSize[x], 1, 16);
+			if (!tmp)
 				goto fail;
+			ppYUVDstData[x] = tmp;
 		}
 
 		{
@@ -435,7 +496,7 @@ static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
 
 	for (x = 0; x < 3; x++)
 	{
-		if (!ppOldYUVDstData[x] || !ppYUVDstData[x] || (piDstSize[x] == 0) || (piDstStride[x] == 0))
+		if (!ppYUVDstData[x] || (piDstSize[x] == 0) || (piDstStride[x] == 0))
 		{
 			WLog_Print(h264->log, WLOG_ERROR,
 			           "YUV buffer not initialized! check your decoder settings");
@@ -626,6 +687,8 @@ static BOOL h264_context_init(H264_CONTEXT* h264)
 		return FALSE;
 
 	h264->subsystem = NULL;
+	h264->TileEqual = h264_tile_equal_c;
+	H264_INIT_SIMD(h264);
 	InitOnceExecuteOnce(&subsystems_once, h264_register_subsystems, NULL, NULL);
 
 	for (i = 0; i < MAX_SUBSYSTEMS; i++)
@@ -652,6 +715,7 @@ BOOL h264_context_reset(H264_CONTEXT* h264, UINT32 width, UINT32 height)
 
 	h264->width = width;
 	h264->height = height;
+	h264->OldSrcValid = FALSE;
 	return yuv_context_reset(h264->yuv, width, height);
 }
 
@@ -695,14 +759,12 @@ void h264_context_free(H264_CONTEXT* h264)
 		for (x = 0; x < 3; x++)
 		{
 			if (h264->Compressor)
-			{
 				_aligned_free(h264->pYUVData[x]);
-				_aligned_free(h264->pOldYUVData[x]);
-			}
 			_aligned_free(h264->pYUV444Data[x]);
-			_aligned_free(h264->pOldYUV444Data[x]);
 		}
 		_aligned_free(h264->lumaData);
+		free(h264->pOldSrcData);
+		free(h264->changedRects);
 
 		yuv_context_free(h264->yuv);
 		free(h264);
@@ -51,6 +51,10 @@ extern "C"
 	FREERDP_LOCAL BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width,
 	                                        UINT32 height);
 
+	/* Generic TileEqual, the reference for the SIMD versions */
+	FREERDP_LOCAL BOOL h264_tile_equal_c(const BYTE* pData1, const BYTE* pData2, UINT32 nStep,
+	                                     UINT32 nWidth, UINT32 nHeight);
+
 #ifdef WITH_MEDIACODEC
 	extern const H264_CONTEXT_SUBSYSTEM g_Subsystem_mediacodec;
 #endif
@@ -75,6 +75,8 @@ typedef struct
 	AVCodecContext* codecDecoderContext;
 	AVCodec* codecEncoder;
 	AVCodecContext* codecEncoderContext;
+	H264_RATECONTROL_MODE encoderRateControlMode;
+	UINT32 encoderQP;
 	AVCodecParserContext* codecParser;
 	AVFrame* videoFrame;
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100)
@@ -114,6 +116,43 @@ static void libavcodec_destroy_encoder(H264_CONTEXT* h264)
 	sys->codecEncoderContext = NULL;
 }
 
+/**
+ * Applies bit rate and QP changes to a running encoder, encoders supporting
+ * reconfiguration (e.g. libx264) pick them up with the next frame without
+ * restarting the stream.
+ */
+static BOOL libavcodec_update_encoder(H264_CONTEXT* h264)
+{
+	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+
+	WINPR_ASSERT(sys);
+	WINPR_ASSERT(sys->codecEncoderContext);
+
+	switch (h264->RateControlMode)
+	{
+		case H264_RATECONTROL_VBR:
+			if (sys->codecEncoderContext->bit_rate != h264->BitRate)
+				sys->codecEncoderContext->bit_rate = h264->BitRate;
+			break;
+
+		case H264_RATECONTROL_CQP:
+			if (sys->encoderQP != h264->QP)
+			{
+				if (av_opt_set_int(sys->codecEncoderContext, "qp", h264->QP,
+				                   AV_OPT_SEARCH_CHILDREN) < 0)
+					WLog_Print(h264->log, WLOG_DEBUG, "Failed to change the encoder QP");
+
+				sys->encoderQP = h264->QP;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
 static BOOL libavcodec_create_encoder(H264_CONTEXT* h264)
 {
 	BOOL recreate = FALSE;
@@ -133,12 +172,13 @@ static BOOL libavcodec_create_encoder(H264_CONTEXT* h264)
 	if (sys->codecEncoderContext)
 	{
 		if ((sys->codecEncoderContext->width != (int)h264->width) ||
-		    (sys->codecEncoderContext->height != (int)h264->height))
+		    (sys->codecEncoderContext->height != (int)h264->height) ||
+		    (sys->encoderRateControlMode != h264->RateControlMode))
 			recreate = TRUE;
 	}
 
 	if (!recreate)
-		return TRUE;
+		return libavcodec_update_encoder(h264);
 
 	libavcodec_destroy_encoder(h264);
 	sys->codecEncoder = avcodec_find_encoder(AV_CODEC_ID_H264);
@@ -158,13 +198,16 @@ static BOOL libavcodec_create_encoder(H264_CONTEXT* h264)
 			break;
 
 		case H264_RATECONTROL_CQP:
-			/* TODO: sys->codecEncoderContext-> = h264->QP; */
+			av_opt_set_int(sys->codecEncoderContext, "qp", h264->QP, AV_OPT_SEARCH_CHILDREN);
 			break;
 
 		default:
 			break;
 	}
 
+	sys->encoderRateControlMode = h264->RateControlMode;
+	sys->encoderQP = h264->QP;
+
 	sys->codecEncoderContext->width = (int)MIN(INT32_MAX, h264->width);
 	sys->codecEncoderContext->height = (int)MIN(INT32_MAX, h264->height);
 	sys->codecEncoderContext->delay = 0;
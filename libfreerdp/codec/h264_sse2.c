@@ -0,0 +1,75 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * H.264 Bitmap Compression - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <emmintrin.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include "h264_sse2.h"
+
+/* Compares nHeight rows of nWidth bytes, 64 bytes per iteration */
+static BOOL h264_tile_equal_sse2(const BYTE* pData1, const BYTE* pData2, UINT32 nStep,
+                                 UINT32 nWidth, UINT32 nHeight)
+{
+	UINT32 y;
+	const UINT32 nBlocks = nWidth / 64;
+	const UINT32 nTail = nWidth % 64;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		UINT32 x;
+		const BYTE* p1 = &pData1[1ull * y * nStep];
+		const BYTE* p2 = &pData2[1ull * y * nStep];
+
+		for (x = 0; x < nBlocks; x++)
+		{
+			const __m128i a0 = _mm_loadu_si128((const __m128i*)&p1[0]);
+			const __m128i a1 = _mm_loadu_si128((const __m128i*)&p1[16]);
+			const __m128i a2 = _mm_loadu_si128((const __m128i*)&p1[32]);
+			const __m128i a3 = _mm_loadu_si128((const __m128i*)&p1[48]);
+			const __m128i b0 = _mm_loadu_si128((const __m128i*)&p2[0]);
+			const __m128i b1 = _mm_loadu_si128((const __m128i*)&p2[16]);
+			const __m128i b2 = _mm_loadu_si128((const __m128i*)&p2[32]);
+			const __m128i b3 = _mm_loadu_si128((const __m128i*)&p2[48]);
+			__m128i eq = _mm_and_si128(_mm_cmpeq_epi8(a0, b0), _mm_cmpeq_epi8(a1, b1));
+			eq = _mm_and_si128(eq, _mm_cmpeq_epi8(a2, b2));
+			eq = _mm_and_si128(eq, _mm_cmpeq_epi8(a3, b3));
+
+			if (_mm_movemask_epi8(eq) != 0xFFFF)
+				return FALSE;
+
+			p1 += 64;
+			p2 += 64;
+		}
+
+		if ((nTail > 0) && (memcmp(p1, p2, nTail) != 0))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void h264_init_sse2(H264_CONTEXT* h264)
+{
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	h264->TileEqual = h264_tile_equal_sse2;
+}
@@ -32,6 +32,20 @@
 
 #define TAG FREERDP_TAG("codec")
 
+/* Bits of the stream indexing HuffTableLEC and HuffTableLOM */
+#define NCRUSH_LEC_MASK 0x1FFF
+#define NCRUSH_LOM_MASK 0x1FF
+/* Longest LEC code and the copy offset, LOM code and length bits following it */
+#define NCRUSH_LEC_BITS 13
+#define NCRUSH_MATCH_BITS (14 + 9 + 14)
+/* Candidates the encoder checks per position and the length it settles for */
+#define NCRUSH_MAX_CHAIN_DEPTH 16
+#define NCRUSH_GOOD_MATCH_LENGTH 64
+/* The last length code carries 14 extra bits */
+#define NCRUSH_MAX_MATCH_LENGTH (0x3FFF + 2)
+/* Output the encoder writes at most for one token, or for the end of stream */
+#define NCRUSH_MAX_PENDING_BYTES 8
+
 struct s_NCRUSH_CONTEXT
 {
 	ALIGN64 BOOL Compressor;
@@ -46,6 +60,9 @@ struct s_NCRUSH_CONTEXT
 	ALIGN64 UINT16 MatchTable[65536];
 	ALIGN64 BYTE HuffTableCopyOffset[1024];
 	ALIGN64 BYTE HuffTableLOM[4096];
+	/* encoder codes as (bit length << 24) | code, length codes include their extra bits */
+	ALIGN64 UINT32 CodeLEC[294];
+	ALIGN64 UINT32 CodeLOM[770];
 };
 
 static const UINT16 HuffTableLEC[8192] = {
@@ -780,48 +797,6 @@ static const UINT16 HuffTableLOM[512] = {
 	0x2001, 0x4003, 0x3002, 0x5009, 0x2001, 0x4006, 0x3004, 0x901F
 };
 
-static const BYTE HuffTableMask[39] = {
-	0x11, /* 0 */
-	0x9E, /* 1 */
-	0xA1, /* 2 */
-	0x00, /* 3 */
-	0x00, /* 4 */
-	0x01, /* 5 */
-	0x00, /* 6 */
-	0x03, /* 7 */
-	0x00, /* 8 */
-	0x07, /* 9 */
-	0x00, /* 10 */
-	0x0F, /* 11 */
-	0x00, /* 12 */
-	0x1F, /* 13 */
-	0x00, /* 14 */
-	0x3F, /* 15 */
-	0x00, /* 16 */
-	0x7F, /* 17 */
-	0x00, /* 18 */
-	0xFF, /* 19 */
-	0x00, /* 20 */
-	0xFF, /* 21 */
-	0x01, /* 22 */
-	0xFF, /* 23 */
-	0x03, /* 24 */
-	0xFF, /* 25 */
-	0x07, /* 26 */
-	0xFF, /* 27 */
-	0x0F, /* 28 */
-	0xFF, /* 29 */
-	0x1F, /* 30 */
-	0xFF, /* 31 */
-	0x3F, /* 32 */
-	0xFF, /* 33 */
-	0x7F, /* 34 */
-	0xFF, /* 35 */
-	0xFF, /* 36 */
-	0x00, /* 37 */
-	0x00  /* 38 */
-};
-
 static const BYTE HuffLengthLEC[294] = {
 	6,  /* 0 */
 	6,  /* 1 */
@@ -1926,103 +1901,147 @@ static INLINE UINT16 get_word(const BYTE* data)
 	return tmp;
 }
 
-static INLINE UINT32 get_dword(const BYTE* data)
+static INLINE UINT64 get_qword(const BYTE* data)
 {
-	UINT32 tmp;
+	UINT64 tmp = 0;
+	size_t index;
+
 	WINPR_ASSERT(data);
-	tmp = *data++;
-	tmp |= (UINT32)*data++ << 8U;
-	tmp |= (UINT32)*data++ << 16U;
-	tmp |= (UINT32)*data++ << 24U;
+
+	for (index = 0; index < sizeof(tmp); index++)
+		tmp |= (UINT64)data[index] << (8 * index);
+
 	return tmp;
 }
 
-static INLINE BOOL NCrushFetchBits(const BYTE** SrcPtr, const BYTE** SrcEnd, INT32* nbits,
-                                   UINT32* bits)
+/**
+ * Refills the bit accumulator to at least 56 bits while input is left.
+ * That holds several literals or a complete match, so the decoder refills once for
+ * a handful of codes instead of after every code.
+ */
+static INLINE BOOL NCrushFetchBits(const BYTE** SrcPtr, const BYTE* SrcEnd, INT32* nbits,
+                                   UINT64* bits)
 {
 	WINPR_ASSERT(SrcPtr);
 	WINPR_ASSERT(SrcEnd);
 	WINPR_ASSERT(nbits);
 	WINPR_ASSERT(bits);
 
-	if (*nbits < 16)
+	/* more bits were consumed than the input had */
+	if (*nbits < 0)
+		return FALSE;
+
+	if ((SrcEnd - *SrcPtr) >= (SSIZE_T)sizeof(UINT64))
 	{
-		if ((*SrcPtr + 1) >= *SrcEnd)
-		{
-			if (*SrcPtr >= *SrcEnd)
-			{
-				if (*nbits < 0)
-					return FALSE;
-			}
-			else
-			{
-				*bits += *(*SrcPtr)++ << *nbits;
-				*nbits += 8;
-			}
-		}
-		else
+		*bits |= get_qword(*SrcPtr) << *nbits;
+		*SrcPtr += (63 - *nbits) >> 3;
+		*nbits |= 56;
+	}
+	else
+	{
+		while ((*nbits <= 56) && (*SrcPtr < SrcEnd))
 		{
-			UINT16 tmp = *(*SrcPtr)++;
-			tmp |= (*(*SrcPtr)++) << 8;
-			*bits += tmp << *nbits;
-			*nbits += 16;
+			*bits |= (UINT64)(*(*SrcPtr)++) << *nbits;
+			*nbits += 8;
 		}
 	}
 
 	return TRUE;
 }
 
-static INLINE void NCrushWriteStart(UINT32* bits, UINT32* offset, UINT32* accumulator)
+static INLINE UINT32 NCrushReadBits(UINT64* bits, INT32* nbits, UINT32 count)
+{
+	const UINT32 value = (UINT32)(*bits & ((1ULL << count) - 1ULL));
+
+	*bits >>= count;
+	*nbits -= (INT32)count;
+	return value;
+}
+
+static INLINE void NCrushWriteStart(UINT32* offset, UINT64* accumulator)
 {
-	WINPR_ASSERT(bits);
 	WINPR_ASSERT(offset);
 	WINPR_ASSERT(accumulator);
 
-	*bits = 0;
 	*offset = 0;
 	*accumulator = 0;
 }
 
-static INLINE void NCrushWriteBits(BYTE** DstPtr, UINT32* accumulator, UINT32* offset, UINT32 _bits,
+/* Writes up to 32 bits, the output is flushed 32 bits at a time */
+static INLINE void NCrushWriteBits(BYTE** DstPtr, UINT64* accumulator, UINT32* offset, UINT32 _bits,
                                    UINT32 _nbits)
 {
 	WINPR_ASSERT(DstPtr);
 	WINPR_ASSERT(accumulator);
 	WINPR_ASSERT(offset);
+	WINPR_ASSERT(_nbits <= 32);
 
-	*accumulator |= _bits << *offset;
+	*accumulator |= (UINT64)_bits << *offset;
 	*offset += _nbits;
 
-	if (*offset >= 16)
+	if (*offset >= 32)
 	{
-		*(*DstPtr)++ = (*accumulator & 0xFF);
-		*(*DstPtr)++ = ((*accumulator >> 8) & 0xFF);
-		*accumulator >>= 16;
-		*offset -= 16;
+		BYTE* ptr = *DstPtr;
+		ptr[0] = (*accumulator & 0xFF);
+		ptr[1] = ((*accumulator >> 8) & 0xFF);
+		ptr[2] = ((*accumulator >> 16) & 0xFF);
+		ptr[3] = ((*accumulator >> 24) & 0xFF);
+		*DstPtr += 4;
+		*accumulator >>= 32;
+		*offset -= 32;
 	}
 }
 
-static INLINE void NCrushWriteFinish(BYTE** DstPtr, UINT32 accumulator)
+/* Writes a code packed by ncrush_generate_tables as (length << 24) | code */
+static INLINE void NCrushWriteCode(BYTE** DstPtr, UINT64* accumulator, UINT32* offset, UINT32 code)
+{
+	NCrushWriteBits(DstPtr, accumulator, offset, code & 0xFFFFFF, code >> 24);
+}
+
+static INLINE void NCrushWriteFinish(BYTE** DstPtr, UINT64 accumulator, UINT32 offset)
 {
 	WINPR_ASSERT(DstPtr);
 
+	/* the stream is made of 16 bit words, the last one is always written */
+	if (offset >= 16)
+	{
+		*(*DstPtr)++ = accumulator & 0xFF;
+		*(*DstPtr)++ = (accumulator >> 8) & 0xFF;
+		accumulator >>= 16;
+	}
+
 	*(*DstPtr)++ = accumulator & 0xFF;
 	*(*DstPtr)++ = (accumulator >> 8) & 0xFF;
 }
 
+static INLINE BOOL ncrush_decode_length(UINT64* bits, INT32* nbits, UINT32* LengthOfMatch)
+{
+	const UINT16 entry = HuffTableLOM[*bits & NCRUSH_LOM_MASK];
+	const UINT32 index = entry & 0xFFF;
+
+	NCrushReadBits(bits, nbits, entry >> 12);
+
+	if (index >= ARRAYSIZE(LOMBitsLUT))
+		return FALSE;
+
+	*LengthOfMatch = LOMBaseLUT[index];
+
+	if (LOMBitsLUT[index])
+		*LengthOfMatch += NCrushReadBits(bits, nbits, LOMBitsLUT[index]);
+
+	return TRUE;
+}
+
 int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize,
                       const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags)
 {
-	UINT32 index;
-	UINT32 bits;
-	INT32 nbits;
+	size_t index;
+	UINT64 bits = 0;
+	INT32 nbits = 0;
 	const BYTE* SrcPtr;
 	const BYTE* SrcEnd;
-	UINT16 Mask;
-	BYTE Literal;
+	UINT16 Entry;
 	UINT32 IndexLEC;
-	UINT32 BitLength;
-	UINT32 MaskedBits;
 	UINT32 CopyOffset;
 	UINT32 CopyLength;
 	UINT32 OldCopyOffset;
@@ -2034,9 +2053,6 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 	BYTE* HistoryBuffer;
 	BYTE* HistoryBufferEnd;
 	UINT32 CopyOffsetBits;
-	UINT32 CopyOffsetBase;
-	UINT32 LengthOfMatchBits;
-	UINT32 LengthOfMatchBase;
 
 	WINPR_ASSERT(ncrush);
 	WINPR_ASSERT(pSrcData);
@@ -2075,28 +2091,23 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 		return 1;
 	}
 
+	SrcPtr = pSrcData;
 	SrcEnd = &pSrcData[SrcSize];
-	nbits = 32;
-	bits = get_dword(pSrcData);
-	SrcPtr = pSrcData + 4;
 
 	while (1)
 	{
-		while (1)
+		if (nbits < NCRUSH_LEC_BITS)
 		{
-			Mask = get_word(&HuffTableMask[29]);
-			MaskedBits = bits & Mask;
-			IndexLEC = HuffTableLEC[MaskedBits] & 0xFFF;
-			BitLength = HuffTableLEC[MaskedBits] >> 12;
-			bits >>= BitLength;
-			nbits -= BitLength;
-
-			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+			if (!NCrushFetchBits(&SrcPtr, SrcEnd, &nbits, &bits))
 				return -1;
+		}
 
-			if (IndexLEC >= 256)
-				break;
+		Entry = HuffTableLEC[bits & NCRUSH_LEC_MASK];
+		IndexLEC = Entry & 0xFFF;
+		NCrushReadBits(&bits, &nbits, Entry >> 12);
 
+		if (IndexLEC < 256)
+		{
 			if (HistoryPtr >= HistoryBufferEnd)
 			{
 				WLog_ERR(TAG, "ncrush_decompress error: HistoryPtr (%p) >= HistoryBufferEnd (%p)",
@@ -2104,13 +2115,19 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 				return -1003;
 			}
 
-			Literal = (HuffTableLEC[MaskedBits] & 0xFF);
-			*HistoryPtr++ = Literal;
+			*HistoryPtr++ = (BYTE)(Entry & 0xFF);
+			continue;
 		}
 
 		if (IndexLEC == 256)
 			break; /* EOS */
 
+		if (nbits < NCRUSH_MATCH_BITS)
+		{
+			if (!NCrushFetchBits(&SrcPtr, SrcEnd, &nbits, &bits))
+				return -1;
+		}
+
 		CopyOffsetIndex = IndexLEC - 257;
 
 		if (CopyOffsetIndex >= 32)
@@ -2121,30 +2138,9 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 				return -1004;
 
 			CopyOffset = ncrush->OffsetCache[OffsetCacheIndex];
-			Mask = get_word(&HuffTableMask[21]);
-			MaskedBits = bits & Mask;
-			LengthOfMatch = HuffTableLOM[MaskedBits] & 0xFFF;
-			BitLength = HuffTableLOM[MaskedBits] >> 12;
-			bits >>= BitLength;
-			nbits -= BitLength;
-
-			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
-				return -1;
 
-			LengthOfMatchBits = LOMBitsLUT[LengthOfMatch];
-			LengthOfMatchBase = LOMBaseLUT[LengthOfMatch];
-
-			if (LengthOfMatchBits)
-			{
-				Mask = get_word(&HuffTableMask[(2 * LengthOfMatchBits) + 3]);
-				MaskedBits = bits & Mask;
-				bits >>= LengthOfMatchBits;
-				nbits -= LengthOfMatchBits;
-				LengthOfMatchBase += MaskedBits;
-
-				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
-					return -1;
-			}
+			if (!ncrush_decode_length(&bits, &nbits, &LengthOfMatch))
+				return -1;
 
 			OldCopyOffset = ncrush->OffsetCache[OffsetCacheIndex];
 			ncrush->OffsetCache[OffsetCacheIndex] = ncrush->OffsetCache[0];
@@ -2153,46 +2149,14 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 		else
 		{
 			CopyOffsetBits = CopyOffsetBitsLUT[CopyOffsetIndex];
-			CopyOffsetBase = CopyOffsetBaseLUT[CopyOffsetIndex];
-			CopyOffset = CopyOffsetBase - 1;
+			CopyOffset = CopyOffsetBaseLUT[CopyOffsetIndex] - 1;
 
 			if (CopyOffsetBits)
-			{
-				Mask = get_word(&HuffTableMask[(2 * CopyOffsetBits) + 3]);
-				MaskedBits = bits & Mask;
-				CopyOffset = CopyOffsetBase + MaskedBits - 1;
-				bits >>= CopyOffsetBits;
-				nbits -= CopyOffsetBits;
-
-				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
-					return -1;
-			}
-
-			Mask = get_word(&HuffTableMask[21]);
-			MaskedBits = bits & Mask;
-			LengthOfMatch = HuffTableLOM[MaskedBits] & 0xFFF;
-			BitLength = HuffTableLOM[MaskedBits] >> 12;
-			bits >>= BitLength;
-			nbits -= BitLength;
+				CopyOffset += NCrushReadBits(&bits, &nbits, CopyOffsetBits);
 
-			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+			if (!ncrush_decode_length(&bits, &nbits, &LengthOfMatch))
 				return -1;
 
-			LengthOfMatchBits = LOMBitsLUT[LengthOfMatch];
-			LengthOfMatchBase = LOMBaseLUT[LengthOfMatch];
-
-			if (LengthOfMatchBits)
-			{
-				Mask = get_word(&HuffTableMask[(2 * LengthOfMatchBits) + 3]);
-				MaskedBits = bits & Mask;
-				bits >>= LengthOfMatchBits;
-				nbits -= LengthOfMatchBits;
-				LengthOfMatchBase += MaskedBits;
-
-				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
-					return -1;
-			}
-
 			ncrush->OffsetCache[3] = ncrush->OffsetCache[2];
 			ncrush->OffsetCache[2] = ncrush->OffsetCache[1];
 			ncrush->OffsetCache[1] = ncrush->OffsetCache[0];
@@ -2200,7 +2164,6 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 		}
 
 		CopyOffsetPtr = &HistoryBuffer[(HistoryPtr - HistoryBuffer - CopyOffset) & 0xFFFF];
-		LengthOfMatch = LengthOfMatchBase;
 
 		if (LengthOfMatch < 2)
 			return -1005;
@@ -2210,6 +2173,15 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 			return -1006;
 
 		CopyOffsetPtr = HistoryPtr - CopyOffset;
+
+		/* Common case, the match is in the history and does not overlap the output */
+		if ((CopyOffsetPtr >= HistoryBuffer) && (LengthOfMatch <= CopyOffset))
+		{
+			CopyMemory(HistoryPtr, CopyOffsetPtr, LengthOfMatch);
+			HistoryPtr += LengthOfMatch;
+			continue;
+		}
+
 		index = 0;
 		CopyLength = (LengthOfMatch > CopyOffset) ? CopyOffset : LengthOfMatch;
 
@@ -2248,14 +2220,10 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 				LengthOfMatch--;
 			}
 		}
-
-		LengthOfMatch = LengthOfMatchBase;
-
-		if (LengthOfMatch == 2)
-			continue;
 	}
 
-	if (IndexLEC != 256)
+	/* the end of stream code has to be complete */
+	if (nbits < 0)
 		return -1;
 
 	if (ncrush->HistoryBufferFence != 0xABABABAB)
@@ -2295,144 +2263,78 @@ static int ncrush_hash_table_add(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, U
 	return 1;
 }
 
-static int ncrush_find_match_length(const BYTE* Ptr1, const BYTE* Ptr2, BYTE* HistoryPtr)
+static INLINE UINT32 ncrush_find_match_length(const BYTE* Ptr1, const BYTE* Ptr2, UINT32 MaxLength)
 {
-	BYTE val1, val2;
-	const BYTE* Ptr = Ptr1;
+	UINT32 length = 0;
 
 	WINPR_ASSERT(Ptr1);
 	WINPR_ASSERT(Ptr2);
-	WINPR_ASSERT(HistoryPtr);
 
-	do
+	while (length + sizeof(UINT64) <= MaxLength)
 	{
-		if (Ptr1 > HistoryPtr)
+		UINT64 v1 = 0;
+		UINT64 v2 = 0;
+
+		memcpy(&v1, &Ptr1[length], sizeof(v1));
+		memcpy(&v2, &Ptr2[length], sizeof(v2));
+
+		if (v1 != v2)
 			break;
 
-		val1 = *Ptr1++;
-		val2 = *Ptr2++;
-	} while (val1 == val2);
+		length += sizeof(UINT64);
+	}
+
+	while ((length < MaxLength) && (Ptr1[length] == Ptr2[length]))
+		length++;
 
-	return Ptr1 - (Ptr + 1);
+	return length;
 }
 
-static int ncrush_find_best_match(NCRUSH_CONTEXT* ncrush, UINT16 HistoryOffset,
-                                  UINT32* pMatchOffset)
+/**
+ * Walks the hash chain of HistoryOffset for the longest match of at most MaxLength bytes.
+ * The walk stops after NCRUSH_MAX_CHAIN_DEPTH candidates or at the first match of
+ * NCRUSH_GOOD_MATCH_LENGTH bytes. Returns the match length, 0 if there is none.
+ */
+static UINT32 ncrush_find_best_match(NCRUSH_CONTEXT* ncrush, UINT32 HistoryOffset,
+                                     UINT32 MaxLength, UINT32* pMatchOffset)
 {
-	int i, j;
-	int Length;
-	int MatchLength;
-	BYTE* MatchPtr;
-	UINT16 Offset;
-	UINT16 NextOffset;
-	UINT16 MatchOffset;
-	BYTE* HistoryBuffer;
+	UINT32 depth;
+	UINT32 Length;
+	UINT32 MatchLength = 0;
+	UINT32 Offset;
+	const BYTE* HistoryBuffer;
+	const BYTE* Ptr;
 
 	WINPR_ASSERT(ncrush);
 	WINPR_ASSERT(pMatchOffset);
 
-	if (!ncrush->MatchTable[HistoryOffset])
-		return -1;
-
-	MatchLength = 2;
-	Offset = HistoryOffset;
-	HistoryBuffer = (BYTE*)ncrush->HistoryBuffer;
-	ncrush->MatchTable[0] = HistoryOffset;
-	MatchOffset = ncrush->MatchTable[HistoryOffset];
-	NextOffset = ncrush->MatchTable[Offset];
-	MatchPtr = &HistoryBuffer[MatchLength];
+	HistoryBuffer = ncrush->HistoryBuffer;
+	Ptr = &HistoryBuffer[HistoryOffset];
+	Offset = ncrush->MatchTable[HistoryOffset];
 
-	for (i = 0; i < 4; i++)
+	for (depth = 0; Offset && (depth < NCRUSH_MAX_CHAIN_DEPTH); depth++)
 	{
-		j = -1;
-
-		if (j < 0)
-		{
-			Offset = ncrush->MatchTable[NextOffset];
-
-			if (MatchPtr[NextOffset] == HistoryBuffer[HistoryOffset + MatchLength])
-				j = 0;
-		}
-
-		if (j < 0)
-		{
-			NextOffset = ncrush->MatchTable[Offset];
-
-			if (MatchPtr[Offset] == HistoryBuffer[HistoryOffset + MatchLength])
-				j = 1;
-		}
-
-		if (j < 0)
-		{
-			Offset = ncrush->MatchTable[NextOffset];
-
-			if (MatchPtr[NextOffset] == HistoryBuffer[HistoryOffset + MatchLength])
-				j = 2;
-		}
-
-		if (j < 0)
-		{
-			NextOffset = ncrush->MatchTable[Offset];
+		const BYTE* Candidate = &HistoryBuffer[Offset];
 
-			if (MatchPtr[Offset] == HistoryBuffer[HistoryOffset + MatchLength])
-				j = 3;
-		}
-
-		if (j < 0)
-		{
-			Offset = ncrush->MatchTable[NextOffset];
-
-			if (MatchPtr[NextOffset] == HistoryBuffer[HistoryOffset + MatchLength])
-				j = 4;
-		}
-
-		if (j < 0)
+		/* a longer match has to match the byte after the current best one, too */
+		if ((MatchLength < 2) || (Candidate[MatchLength] == Ptr[MatchLength]))
 		{
-			NextOffset = ncrush->MatchTable[Offset];
+			Length = ncrush_find_match_length(Ptr, Candidate, MaxLength);
 
-			if (MatchPtr[Offset] == HistoryBuffer[HistoryOffset + MatchLength])
-				j = 5;
-		}
-
-		if (j >= 0)
-		{
-			if ((j % 2) == 0)
-				Offset = NextOffset;
-
-			if ((Offset != HistoryOffset) && Offset)
+			if (Length > MatchLength)
 			{
-				Length = ncrush_find_match_length(&HistoryBuffer[HistoryOffset + 2],
-				                                  &HistoryBuffer[Offset + 2], ncrush->HistoryPtr) +
-				         2;
-
-				if (Length < 2)
-					return -1;
+				MatchLength = Length;
+				*pMatchOffset = Offset;
 
-				if (Length > 16)
+				if ((Length >= NCRUSH_GOOD_MATCH_LENGTH) || (Length == MaxLength))
 					break;
-
-				if (Length > MatchLength)
-				{
-					MatchLength = Length;
-					MatchOffset = Offset;
-				}
-
-				if ((Length <= MatchLength) ||
-				    (&HistoryBuffer[HistoryOffset + 2] < ncrush->HistoryPtr))
-				{
-					NextOffset = ncrush->MatchTable[Offset];
-					MatchPtr = &HistoryBuffer[MatchLength];
-					continue;
-				}
 			}
-
-			break;
 		}
+
+		Offset = ncrush->MatchTable[Offset];
 	}
 
-	ncrush->MatchTable[0] = 0;
-	*pMatchOffset = MatchOffset;
-	return MatchLength;
+	return (MatchLength < 2) ? 0 : MatchLength;
 }
 
 static int ncrush_move_encoder_windows(NCRUSH_CONTEXT* ncrush, BYTE* HistoryPtr)
@@ -2485,14 +2387,10 @@ static int ncrush_move_encoder_windows(NCRUSH_CONTEXT* ncrush, BYTE* HistoryPtr)
 int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstBuffer,
                     const BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
 {
-	BYTE Literal;
 	const BYTE* SrcPtr;
 	BYTE* DstPtr;
-	UINT32 bits;
 	UINT32 offset;
-	UINT16 Mask;
-	UINT32 MaskedBits;
-	UINT32 accumulator;
+	UINT64 accumulator;
 	const BYTE* SrcEndPtr;
 	BYTE* DstEndPtr;
 	BYTE* HistoryPtr;
@@ -2501,11 +2399,8 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 	BOOL PacketAtFront = FALSE;
 	BOOL PacketFlushed = FALSE;
 	UINT32 MatchLength;
+	UINT32 MaxLength;
 	UINT32 IndexLEC;
-	UINT32 IndexLOM;
-	UINT32 IndexCO;
-	UINT32 CodeLEC;
-	UINT32 BitLength;
 	UINT32 CopyOffset;
 	UINT32 MatchOffset;
 	UINT32 OldCopyOffset;
@@ -2519,8 +2414,6 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 	UINT32 CopyOffsetBits;
 	UINT32 CompressionLevel = 2;
 
-	WINPR_ASSERT(ncrush);
-
 	WINPR_ASSERT(ncrush);
 	WINPR_ASSERT(pSrcData);
 	WINPR_ASSERT(pDstBuffer);
@@ -2549,10 +2442,6 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 			PacketAtFront = TRUE;
 		}
 	}
-	else
-	{
-		*pFlags = 0;
-	}
 
 	pDstData = pDstBuffer;
 	*ppDstData = pDstBuffer;
@@ -2565,12 +2454,13 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 	if (DstSize < SrcSize)
 		return -1003;
 
-	DstSize = SrcSize;
-	NCrushWriteStart(&bits, &offset, &accumulator);
+	/* Once more than SrcSize bytes are out the packet is sent uncompressed anyway */
+	DstSize = MIN(DstSize, SrcSize + NCRUSH_MAX_PENDING_BYTES);
+	NCrushWriteStart(&offset, &accumulator);
 	DstPtr = pDstData;
 	SrcPtr = pSrcData;
 	SrcEndPtr = &pSrcData[SrcSize];
-	DstEndPtr = &pDstData[DstSize - 1];
+	DstEndPtr = &pDstData[DstSize];
 	OffsetCache = ncrush->OffsetCache;
 	HistoryPtr = &HistoryBuffer[ncrush->HistoryOffset];
 	HistoryBufferEndPtr = &HistoryBuffer[65536];
@@ -2586,22 +2476,16 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 		MatchLength = 0;
 		HistoryOffset = HistoryPtr - HistoryBuffer;
 
-		if (ncrush->HistoryPtr && (HistoryPtr > ncrush->HistoryPtr))
-			return -1;
-
 		if (HistoryOffset >= 65536)
 			return -1004;
 
+		if ((DstPtr + NCRUSH_MAX_PENDING_BYTES) > DstEndPtr) /* PACKET_FLUSH #1 */
+			goto flush;
+
 		if (ncrush->MatchTable[HistoryOffset])
 		{
-			int rc;
-
-			MatchOffset = 0;
-			rc = ncrush_find_best_match(ncrush, HistoryOffset, &MatchOffset);
-
-			if (rc < 0)
-				return -1005;
-			MatchLength = (UINT32)rc;
+			MaxLength = MIN((UINT32)(SrcEndPtr - SrcPtr), NCRUSH_MAX_MATCH_LENGTH);
+			MatchLength = ncrush_find_best_match(ncrush, HistoryOffset, MaxLength, &MatchOffset);
 		}
 
 		if (MatchLength)
@@ -2613,161 +2497,62 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 		if (MatchLength == 0)
 		{
 			/* Literal */
-			Literal = *SrcPtr++;
+			NCrushWriteCode(&DstPtr, &accumulator, &offset, ncrush->CodeLEC[*SrcPtr]);
+			SrcPtr++;
 			HistoryPtr++;
+			continue;
+		}
 
-			if ((DstPtr + 2) > DstEndPtr) /* PACKET_FLUSH #1 */
-			{
-				ncrush_context_reset(ncrush, TRUE);
-				*pFlags = PACKET_FLUSHED;
-				*pFlags |= CompressionLevel;
-				*ppDstData = pSrcData;
-				*pDstSize = SrcSize;
-				return 1;
-			}
-
-			IndexLEC = Literal;
-			BitLength = HuffLengthLEC[IndexLEC];
-			CodeLEC = get_word(&HuffCodeLEC[IndexLEC * 2]);
+		HistoryPtr += MatchLength;
+		SrcPtr += MatchLength;
+		OffsetCacheIndex = 5;
 
-			if (BitLength > 15)
-				return -1006;
+		if (CopyOffset == OffsetCache[0])
+			OffsetCacheIndex = 0;
+		else if (CopyOffset == OffsetCache[1])
+			OffsetCacheIndex = 1;
+		else if (CopyOffset == OffsetCache[2])
+			OffsetCacheIndex = 2;
+		else if (CopyOffset == OffsetCache[3])
+			OffsetCacheIndex = 3;
 
-			NCrushWriteBits(&DstPtr, &accumulator, &offset, CodeLEC, BitLength);
+		if (OffsetCacheIndex < 4)
+		{
+			/* CopyOffset in OffsetCache */
+			OldCopyOffset = OffsetCache[OffsetCacheIndex];
+			OffsetCache[OffsetCacheIndex] = OffsetCache[0];
+			OffsetCache[0] = OldCopyOffset;
+			IndexLEC = 289 + OffsetCacheIndex;
+			NCrushWriteCode(&DstPtr, &accumulator, &offset, ncrush->CodeLEC[IndexLEC]);
 		}
 		else
 		{
-			HistoryPtr += MatchLength;
-			SrcPtr += MatchLength;
-
-			if (!MatchLength)
-				return -1007;
-
-			if ((DstPtr + 8) > DstEndPtr) /* PACKET_FLUSH #2 */
-			{
-				ncrush_context_reset(ncrush, TRUE);
-				*pFlags = PACKET_FLUSHED;
-				*pFlags |= CompressionLevel;
-				*ppDstData = pSrcData;
-				*pDstSize = SrcSize;
-				return 1;
-			}
-
-			OffsetCacheIndex = 5;
-
-			if ((CopyOffset == OffsetCache[0]) || (CopyOffset == OffsetCache[1]) ||
-			    (CopyOffset == OffsetCache[2]) || (CopyOffset == OffsetCache[3]))
-			{
-				if (CopyOffset == OffsetCache[3])
-				{
-					OldCopyOffset = OffsetCache[3];
-					OffsetCache[3] = OffsetCache[0];
-					OffsetCache[0] = OldCopyOffset;
-					OffsetCacheIndex = 3;
-				}
-				else
-				{
-					if (CopyOffset == OffsetCache[2])
-					{
-						OldCopyOffset = OffsetCache[2];
-						OffsetCache[2] = OffsetCache[0];
-						OffsetCache[0] = OldCopyOffset;
-						OffsetCacheIndex = 2;
-					}
-					else
-					{
-						if (CopyOffset == OffsetCache[1])
-						{
-							OldCopyOffset = OffsetCache[1];
-							OffsetCache[1] = OffsetCache[0];
-							OffsetCache[0] = OldCopyOffset;
-							OffsetCacheIndex = 1;
-						}
-						else
-						{
-							if (CopyOffset == OffsetCache[0])
-							{
-								OffsetCacheIndex = 0;
-							}
-						}
-					}
-				}
-			}
+			/* CopyOffset not in OffsetCache */
+			OffsetCache[3] = OffsetCache[2];
+			OffsetCache[2] = OffsetCache[1];
+			OffsetCache[1] = OffsetCache[0];
+			OffsetCache[0] = CopyOffset;
+
+			if (CopyOffset >= 256)
+				CopyOffsetIndex = ncrush->HuffTableCopyOffset[(CopyOffset >> 7) + 256 + 2];
 			else
-			{
-				OffsetCache[3] = OffsetCache[2];
-				OffsetCache[2] = OffsetCache[1];
-				OffsetCache[1] = OffsetCache[0];
-				OffsetCache[0] = CopyOffset;
-			}
+				CopyOffsetIndex = ncrush->HuffTableCopyOffset[CopyOffset + 2];
 
-			if (OffsetCacheIndex >= 4)
-			{
-				/* CopyOffset not in OffsetCache */
-				if (CopyOffset >= 256)
-					bits = (CopyOffset >> 7) + 256;
-				else
-					bits = CopyOffset;
-
-				CopyOffsetIndex = ncrush->HuffTableCopyOffset[bits + 2];
-				CopyOffsetBits = CopyOffsetBitsLUT[CopyOffsetIndex];
-				IndexLEC = 257 + CopyOffsetIndex;
-				BitLength = HuffLengthLEC[IndexLEC];
-				CodeLEC = get_word(&HuffCodeLEC[IndexLEC * 2]);
-
-				if (BitLength > 15)
-					return -1008;
-
-				if (CopyOffsetBits > 18)
-					return -1009;
-
-				NCrushWriteBits(&DstPtr, &accumulator, &offset, CodeLEC, BitLength);
-				Mask = ((1 << CopyOffsetBits) - 1);
-				MaskedBits = CopyOffset & Mask;
-				NCrushWriteBits(&DstPtr, &accumulator, &offset, MaskedBits, CopyOffsetBits);
-
-				if ((MatchLength - 2) >= 768)
-					IndexCO = 28;
-				else
-					IndexCO = ncrush->HuffTableLOM[MatchLength];
-
-				BitLength = HuffLengthLOM[IndexCO];
-				IndexLOM = LOMBitsLUT[IndexCO];
-				NCrushWriteBits(&DstPtr, &accumulator, &offset, HuffCodeLOM[IndexCO], BitLength);
-				Mask = ((1 << IndexLOM) - 1);
-				MaskedBits = (MatchLength - 2) & Mask;
-				NCrushWriteBits(&DstPtr, &accumulator, &offset, MaskedBits, IndexLOM);
-
-				if ((MaskedBits + LOMBaseLUT[IndexCO]) != MatchLength)
-					return -1010;
-			}
-			else
-			{
-				/* CopyOffset in OffsetCache */
-				IndexLEC = 289 + OffsetCacheIndex;
-				BitLength = HuffLengthLEC[IndexLEC];
-				CodeLEC = get_word(&HuffCodeLEC[IndexLEC * 2]);
-
-				if (BitLength >= 15)
-					return -1011;
-
-				NCrushWriteBits(&DstPtr, &accumulator, &offset, CodeLEC, BitLength);
-
-				if ((MatchLength - 2) >= 768)
-					IndexCO = 28;
-				else
-					IndexCO = ncrush->HuffTableLOM[MatchLength];
-
-				BitLength = HuffLengthLOM[IndexCO];
-				IndexLOM = LOMBitsLUT[IndexCO];
-				NCrushWriteBits(&DstPtr, &accumulator, &offset, HuffCodeLOM[IndexCO], BitLength);
-				Mask = ((1 << IndexLOM) - 1);
-				MaskedBits = (MatchLength - 2) & Mask;
-				NCrushWriteBits(&DstPtr, &accumulator, &offset, MaskedBits, IndexLOM);
-
-				if ((MaskedBits + LOMBaseLUT[IndexCO]) != MatchLength)
-					return -1012;
-			}
+			CopyOffsetBits = CopyOffsetBitsLUT[CopyOffsetIndex];
+			IndexLEC = 257 + CopyOffsetIndex;
+			NCrushWriteCode(&DstPtr, &accumulator, &offset, ncrush->CodeLEC[IndexLEC]);
+			NCrushWriteBits(&DstPtr, &accumulator, &offset,
+			                CopyOffset & ((1 << CopyOffsetBits) - 1), CopyOffsetBits);
+		}
+
+		if (MatchLength < ARRAYSIZE(ncrush->CodeLOM))
+			NCrushWriteCode(&DstPtr, &accumulator, &offset, ncrush->CodeLOM[MatchLength]);
+		else
+		{
+			/* Long matches share the last length code with 14 extra bits */
+			NCrushWriteBits(&DstPtr, &accumulator, &offset, HuffCodeLOM[28], HuffLengthLOM[28]);
+			NCrushWriteBits(&DstPtr, &accumulator, &offset, (MatchLength - 2) & 0x3FFF,
+			                LOMBitsLUT[28]);
 		}
 
 		if (HistoryPtr >= HistoryBufferEndPtr)
@@ -2776,52 +2561,25 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 
 	while (SrcPtr < SrcEndPtr)
 	{
-		if ((DstPtr + 2) > DstEndPtr) /* PACKET_FLUSH #3 */
-		{
-			ncrush_context_reset(ncrush, TRUE);
-			*pFlags = PACKET_FLUSHED;
-			*pFlags |= CompressionLevel;
-			*ppDstData = pSrcData;
-			*pDstSize = SrcSize;
-			return 1;
-		}
+		if ((DstPtr + NCRUSH_MAX_PENDING_BYTES) > DstEndPtr) /* PACKET_FLUSH #2 */
+			goto flush;
 
-		Literal = *SrcPtr++;
+		NCrushWriteCode(&DstPtr, &accumulator, &offset, ncrush->CodeLEC[*SrcPtr]);
+		SrcPtr++;
 		HistoryPtr++;
-		IndexLEC = Literal;
-		BitLength = HuffLengthLEC[IndexLEC];
-		CodeLEC = get_word(&HuffCodeLEC[IndexLEC * 2]);
-
-		if (BitLength > 15)
-			return -1014;
-
-		NCrushWriteBits(&DstPtr, &accumulator, &offset, CodeLEC, BitLength);
 	}
 
-	if ((DstPtr + 4) >= DstEndPtr) /* PACKET_FLUSH #4 */
-	{
-		ncrush_context_reset(ncrush, TRUE);
-		*pFlags = PACKET_FLUSHED;
-		*pFlags |= CompressionLevel;
-		*ppDstData = pSrcData;
-		*pDstSize = SrcSize;
-		return 1;
-	}
+	if ((DstPtr + NCRUSH_MAX_PENDING_BYTES) > DstEndPtr)
+		goto flush;
 
-	IndexLEC = 256;
-	BitLength = HuffLengthLEC[IndexLEC];
+	NCrushWriteCode(&DstPtr, &accumulator, &offset, ncrush->CodeLEC[256]);
+	NCrushWriteFinish(&DstPtr, accumulator, offset);
 
-	if (BitLength > 15)
-		return -1015;
+	if ((size_t)(DstPtr - pDstData) >= SrcSize) /* PACKET_FLUSH #3 */
+		goto flush;
 
-	bits = get_word(&HuffCodeLEC[IndexLEC * 2]);
-	NCrushWriteBits(&DstPtr, &accumulator, &offset, bits, BitLength);
-	NCrushWriteFinish(&DstPtr, accumulator);
 	*pDstSize = DstPtr - pDstData;
 
-	if (*pDstSize > SrcSize)
-		return -1016;
-
 	*pFlags |= PACKET_COMPRESSED;
 	*pFlags |= CompressionLevel;
 
@@ -2837,6 +2595,15 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 		return -1;
 
 	return 1;
+
+flush:
+	/* The packet does not compress, send it as is and start over with an empty history */
+	ncrush_context_reset(ncrush, TRUE);
+	*pFlags = PACKET_FLUSHED;
+	*pFlags |= CompressionLevel;
+	*ppDstData = pSrcData;
+	*pDstSize = SrcSize;
+	return 1;
 }
 
 static int ncrush_generate_tables(NCRUSH_CONTEXT* context)
@@ -2892,6 +2659,23 @@ static int ncrush_generate_tables(NCRUSH_CONTEXT* context)
 	if ((k + 256) > 1024)
 		return -1;
 
+	for (i = 0; i < ARRAYSIZE(context->CodeLEC); i++)
+	{
+		if (HuffLengthLEC[i] > 15)
+			return -1;
+
+		context->CodeLEC[i] = ((UINT32)HuffLengthLEC[i] << 24) | get_word(&HuffCodeLEC[i * 2]);
+	}
+
+	for (k = 2; k < ARRAYSIZE(context->CodeLOM); k++)
+	{
+		const UINT32 index = context->HuffTableLOM[k];
+		const UINT32 extra = (k - 2) & ((1 << LOMBitsLUT[index]) - 1);
+
+		context->CodeLOM[k] = ((UINT32)(HuffLengthLOM[index] + LOMBitsLUT[index]) << 24) |
+		                      HuffCodeLOM[index] | (extra << HuffLengthLOM[index]);
+	}
+
 	return 1;
 }
 
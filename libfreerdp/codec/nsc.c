@@ -30,6 +30,7 @@
 
 #include <freerdp/codec/nsc.h>
 #include <freerdp/codec/color.h>
+#include <freerdp/settings.h>
 
 #include "nsc_types.h"
 #include "nsc_encode.h"
@@ -46,70 +47,81 @@
 	} while (0)
 #endif
 
-static BOOL nsc_decode(NSC_CONTEXT* context)
+/* Rows handed to a single worker are kept above this many pixels */
+#define NSC_PARALLEL_MIN_PIXELS 16384
+
+static BOOL nsc_decode_row(void* arg, size_t index, BYTE** scratch)
 {
+	NSC_CONTEXT* context = (NSC_CONTEXT*)arg;
+	const UINT16 y = (UINT16)index;
 	UINT16 x;
-	UINT16 y;
 	UINT16 rw;
 	BYTE shift;
 	BYTE* bmpdata;
-	size_t pos = 0;
+	const BYTE* yplane;
+	const BYTE* coplane;
+	const BYTE* cgplane;
+	const BYTE* aplane;
+	const size_t pos = 4ull * y * context->width;
 
-	if (!context)
+	WINPR_UNUSED(scratch);
+
+	if (pos + 4ull * context->width > context->BitmapDataLength)
 		return FALSE;
 
 	rw = ROUND_UP_TO(context->width, 8);
 	shift = context->ColorLossLevel - 1; /* colorloss recovery + YCoCg shift */
-	bmpdata = context->BitmapData;
+	bmpdata = &context->BitmapData[pos];
+	aplane = context->priv->PlaneBuffers[3] + y * context->width; /* A */
 
-	if (!bmpdata)
-		return FALSE;
+	if (context->ChromaSubsamplingLevel)
+	{
+		yplane = context->priv->PlaneBuffers[0] + y * rw;                /* Y */
+		coplane = context->priv->PlaneBuffers[1] + (y >> 1) * (rw >> 1); /* Co, supersampled */
+		cgplane = context->priv->PlaneBuffers[2] + (y >> 1) * (rw >> 1); /* Cg, supersampled */
+	}
+	else
+	{
+		yplane = context->priv->PlaneBuffers[0] + y * context->width;  /* Y */
+		coplane = context->priv->PlaneBuffers[1] + y * context->width; /* Co */
+		cgplane = context->priv->PlaneBuffers[2] + y * context->width; /* Cg */
+	}
 
-	for (y = 0; y < context->height; y++)
+	for (x = 0; x < context->width; x++)
 	{
-		const BYTE* yplane;
-		const BYTE* coplane;
-		const BYTE* cgplane;
-		const BYTE* aplane = context->priv->PlaneBuffers[3] + y * context->width; /* A */
+		INT16 y_val = (INT16)*yplane;
+		INT16 co_val = (INT16)(INT8)(*coplane << shift);
+		INT16 cg_val = (INT16)(INT8)(*cgplane << shift);
+		INT16 r_val = y_val + co_val - cg_val;
+		INT16 g_val = y_val + cg_val;
+		INT16 b_val = y_val - co_val - cg_val;
+		*bmpdata++ = MINMAX(b_val, 0, 0xFF);
+		*bmpdata++ = MINMAX(g_val, 0, 0xFF);
+		*bmpdata++ = MINMAX(r_val, 0, 0xFF);
+		*bmpdata++ = *aplane;
+		yplane++;
+		coplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
+		cgplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
+		aplane++;
+	}
 
-		if (context->ChromaSubsamplingLevel)
-		{
-			yplane = context->priv->PlaneBuffers[0] + y * rw;                /* Y */
-			coplane = context->priv->PlaneBuffers[1] + (y >> 1) * (rw >> 1); /* Co, supersampled */
-			cgplane = context->priv->PlaneBuffers[2] + (y >> 1) * (rw >> 1); /* Cg, supersampled */
-		}
-		else
-		{
-			yplane = context->priv->PlaneBuffers[0] + y * context->width;  /* Y */
-			coplane = context->priv->PlaneBuffers[1] + y * context->width; /* Co */
-			cgplane = context->priv->PlaneBuffers[2] + y * context->width; /* Cg */
-		}
+	return TRUE;
+}
 
-		for (x = 0; x < context->width; x++)
-		{
-			INT16 y_val = (INT16)*yplane;
-			INT16 co_val = (INT16)(INT8)(*coplane << shift);
-			INT16 cg_val = (INT16)(INT8)(*cgplane << shift);
-			INT16 r_val = y_val + co_val - cg_val;
-			INT16 g_val = y_val + cg_val;
-			INT16 b_val = y_val - co_val - cg_val;
-
-			if (pos + 4 > context->BitmapDataLength)
-				return FALSE;
+static BOOL nsc_decode(NSC_CONTEXT* context)
+{
+	size_t grain;
 
-			pos += 4;
-			*bmpdata++ = MINMAX(b_val, 0, 0xFF);
-			*bmpdata++ = MINMAX(g_val, 0, 0xFF);
-			*bmpdata++ = MINMAX(r_val, 0, 0xFF);
-			*bmpdata++ = *aplane;
-			yplane++;
-			coplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
-			cgplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
-			aplane++;
-		}
-	}
+	if (!context || !context->BitmapData)
+		return FALSE;
 
-	return TRUE;
+	if (context->width == 0)
+		return TRUE;
+
+	/* Each row only depends on the plane buffers, bands of rows are decoded in parallel */
+	grain = NSC_PARALLEL_MIN_PIXELS / context->width;
+	return parallel_for_run(context->priv->ParallelFor, context->height, grain, nsc_decode_row,
+	                        context);
 }
 
 static BOOL nsc_rle_decode(BYTE* in, BYTE* out, UINT32 outSize, UINT32 originalSize)
@@ -174,50 +186,58 @@ static BOOL nsc_rle_decode(BYTE* in, BYTE* out, UINT32 outSize, UINT32 originalS
 	return TRUE;
 }
 
-static BOOL nsc_rle_decompress_data(NSC_CONTEXT* context)
+static BOOL nsc_rle_decompress_plane(void* arg, size_t index, BYTE** scratch)
 {
-	UINT16 i;
-	BYTE* rle;
-	UINT32 planeSize;
-	UINT32 originalSize;
+	NSC_CONTEXT* context = (NSC_CONTEXT*)arg;
+	const UINT32 originalSize = context->OrgByteCount[index];
+	const UINT32 planeSize = context->PlaneByteCount[index];
+	BYTE* rle = context->Planes;
+	size_t i;
 
-	if (!context)
-		return FALSE;
+	WINPR_UNUSED(scratch);
 
-	rle = context->Planes;
+	for (i = 0; i < index; i++)
+		rle += context->PlaneByteCount[i];
 
-	for (i = 0; i < 4; i++)
+	if (planeSize == 0)
 	{
-		originalSize = context->OrgByteCount[i];
-		planeSize = context->PlaneByteCount[i];
-
-		if (planeSize == 0)
-		{
-			if (context->priv->PlaneBuffersLength < originalSize)
-				return FALSE;
-
-			FillMemory(context->priv->PlaneBuffers[i], originalSize, 0xFF);
-		}
-		else if (planeSize < originalSize)
-		{
-			if (!nsc_rle_decode(rle, context->priv->PlaneBuffers[i],
-			                    context->priv->PlaneBuffersLength, originalSize))
-				return FALSE;
-		}
-		else
-		{
-			if (context->priv->PlaneBuffersLength < originalSize)
-				return FALSE;
+		if (context->priv->PlaneBuffersLength < originalSize)
+			return FALSE;
 
-			CopyMemory(context->priv->PlaneBuffers[i], rle, originalSize);
-		}
+		FillMemory(context->priv->PlaneBuffers[index], originalSize, 0xFF);
+	}
+	else if (planeSize < originalSize)
+	{
+		if (!nsc_rle_decode(rle, context->priv->PlaneBuffers[index],
+		                    context->priv->PlaneBuffersLength, originalSize))
+			return FALSE;
+	}
+	else
+	{
+		if (context->priv->PlaneBuffersLength < originalSize)
+			return FALSE;
 
-		rle += planeSize;
+		CopyMemory(context->priv->PlaneBuffers[index], rle, originalSize);
 	}
 
 	return TRUE;
 }
 
+static BOOL nsc_rle_decompress_data(NSC_CONTEXT* context)
+{
+	size_t grain = 1;
+
+	if (!context)
+		return FALSE;
+
+	/* The planes are independent, only split them across threads when worth it */
+	if (1ull * context->width * context->height < NSC_PARALLEL_MIN_PIXELS)
+		grain = 4;
+
+	return parallel_for_run(context->priv->ParallelFor, 4, grain, nsc_rle_decompress_plane,
+	                        context);
+}
+
 static BOOL nsc_stream_initialize(NSC_CONTEXT* context, wStream* s)
 {
 	int i;
@@ -328,8 +348,14 @@ BOOL nsc_context_reset(NSC_CONTEXT* context, UINT32 width, UINT32 height)
 }
 
 NSC_CONTEXT* nsc_context_new(void)
+{
+	return nsc_context_new_ex(0);
+}
+
+NSC_CONTEXT* nsc_context_new_ex(UINT32 ThreadingFlags)
 {
 	NSC_CONTEXT* context;
+	const BOOL threaded = (ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS) ? FALSE : TRUE;
 	context = (NSC_CONTEXT*)calloc(1, sizeof(NSC_CONTEXT));
 
 	if (!context)
@@ -343,6 +369,11 @@ NSC_CONTEXT* nsc_context_new(void)
 	context->priv->log = WLog_Get("com.freerdp.codec.nsc");
 	WLog_OpenAppender(context->priv->log);
 	context->BitmapData = NULL;
+	context->priv->ParallelFor = parallel_for_new(threaded, NULL, NULL, 0);
+
+	if (!context->priv->ParallelFor)
+		goto error;
+
 	context->decode = nsc_decode;
 	context->encode = nsc_encode;
 
@@ -373,6 +404,7 @@ void nsc_context_free(NSC_CONTEXT* context)
 		for (i = 0; i < 5; i++)
 			free(context->priv->PlaneBuffers[i]);
 
+		parallel_for_free(context->priv->ParallelFor);
 		nsc_profiler_print(context->priv);
 		PROFILER_FREE(context->priv->prof_nsc_rle_decompress_data)
 		PROFILER_FREE(context->priv->prof_nsc_decode)
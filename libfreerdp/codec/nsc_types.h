@@ -30,6 +30,8 @@
 #include <freerdp/utils/profiler.h>
 #include <freerdp/codec/nsc.h>
 
+#include "parallel.h"
+
 #define ROUND_UP_TO(_b, _n) (_b + ((~(_b & (_n - 1)) + 0x1) & (_n - 1)))
 #define MINMAX(_v, _l, _h) ((_v) < (_l) ? (_l) : ((_v) > (_h) ? (_h) : (_v)))
 
@@ -40,6 +42,8 @@ typedef struct
 	BYTE* PlaneBuffers[5];     /* Decompressed Plane Buffers in the respective order */
 	UINT32 PlaneBuffersLength; /* Lengths of each plane buffer */
 
+	PARALLEL_FOR* ParallelFor;
+
 	/* profilers */
 	PROFILER_DEFINE(prof_nsc_rle_decompress_data)
 	PROFILER_DEFINE(prof_nsc_decode)
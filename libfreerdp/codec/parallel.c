@@ -0,0 +1,220 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Parallel For
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/log.h>
+
+#include "parallel.h"
+
+#define TAG FREERDP_TAG("codec.parallel")
+
+/* Ranges per processor, more than one lets idle threads steal a share of a slow range */
+#define PARALLEL_FOR_CHUNKS_PER_CPU 4
+
+typedef struct
+{
+	PARALLEL_FOR* pf;
+	size_t first;
+	size_t last;
+} PARALLEL_FOR_CHUNK;
+
+struct S_PARALLEL_FOR
+{
+	BOOL threaded;
+	PTP_CALLBACK_ENVIRON env;
+	wBufferPool* scratchPool;
+	size_t nscratch;
+
+	size_t maxChunks;
+	size_t numWorks;
+	PTP_WORK* works;
+	PARALLEL_FOR_CHUNK* chunks;
+
+	/* state of the running loop */
+	parallel_for_fn fn;
+	void* arg;
+	volatile LONG failed;
+};
+
+static BOOL parallel_for_range(PARALLEL_FOR* pf, size_t first, size_t last)
+{
+	size_t index;
+	BOOL rc = TRUE;
+	BYTE* scratch[PARALLEL_FOR_MAX_SCRATCH] = { 0 };
+
+	for (index = 0; index < pf->nscratch; index++)
+	{
+		if (!(scratch[index] = (BYTE*)BufferPool_Take(pf->scratchPool, -1)))
+		{
+			rc = FALSE;
+			goto out;
+		}
+	}
+
+	for (index = first; index < last; index++)
+	{
+		if (!pf->fn(pf->arg, index, scratch))
+			rc = FALSE;
+	}
+
+out:
+	for (index = 0; index < pf->nscratch; index++)
+	{
+		if (scratch[index])
+			BufferPool_Return(pf->scratchPool, scratch[index]);
+	}
+
+	return rc;
+}
+
+static void CALLBACK parallel_for_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                                PTP_WORK work)
+{
+	PARALLEL_FOR_CHUNK* chunk = (PARALLEL_FOR_CHUNK*)context;
+
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	if (!parallel_for_range(chunk->pf, chunk->first, chunk->last))
+		InterlockedExchange(&chunk->pf->failed, TRUE);
+}
+
+static BOOL parallel_for_ensure_works(PARALLEL_FOR* pf, size_t count)
+{
+	while (pf->numWorks < count)
+	{
+		PARALLEL_FOR_CHUNK* chunk = &pf->chunks[pf->numWorks];
+		chunk->pf = pf;
+
+		if (!(pf->works[pf->numWorks] =
+		          CreateThreadpoolWork(parallel_for_work_callback, chunk, pf->env)))
+		{
+			WLog_ERR(TAG, "CreateThreadpoolWork failed.");
+			return FALSE;
+		}
+
+		pf->numWorks++;
+	}
+
+	return TRUE;
+}
+
+PARALLEL_FOR* parallel_for_new(BOOL threaded, PTP_CALLBACK_ENVIRON env, wBufferPool* scratchPool,
+                               size_t nscratch)
+{
+	SYSTEM_INFO sysinfo = { 0 };
+	PARALLEL_FOR* pf;
+
+	if ((nscratch > PARALLEL_FOR_MAX_SCRATCH) || ((nscratch > 0) && !scratchPool))
+		return NULL;
+
+	pf = (PARALLEL_FOR*)calloc(1, sizeof(PARALLEL_FOR));
+
+	if (!pf)
+		return NULL;
+
+	pf->threaded = threaded;
+	pf->env = env;
+	pf->scratchPool = scratchPool;
+	pf->nscratch = nscratch;
+
+	if (!pf->threaded)
+		return pf;
+
+	GetNativeSystemInfo(&sysinfo);
+	pf->maxChunks = sysinfo.dwNumberOfProcessors * PARALLEL_FOR_CHUNKS_PER_CPU;
+
+	if (pf->maxChunks < 2)
+		pf->maxChunks = 2;
+
+	pf->works = (PTP_WORK*)calloc(pf->maxChunks, sizeof(PTP_WORK));
+	pf->chunks = (PARALLEL_FOR_CHUNK*)calloc(pf->maxChunks, sizeof(PARALLEL_FOR_CHUNK));
+
+	if (!pf->works || !pf->chunks)
+	{
+		parallel_for_free(pf);
+		return NULL;
+	}
+
+	return pf;
+}
+
+void parallel_for_free(PARALLEL_FOR* pf)
+{
+	size_t index;
+
+	if (!pf)
+		return;
+
+	for (index = 0; index < pf->numWorks; index++)
+		CloseThreadpoolWork(pf->works[index]);
+
+	free(pf->works);
+	free(pf->chunks);
+	free(pf);
+}
+
+BOOL parallel_for_run(PARALLEL_FOR* pf, size_t count, size_t grain, parallel_for_fn fn, void* arg)
+{
+	size_t index;
+	size_t numChunks;
+
+	WINPR_ASSERT(pf);
+	WINPR_ASSERT(fn);
+
+	if (count == 0)
+		return TRUE;
+
+	if (grain < 1)
+		grain = 1;
+
+	pf->fn = fn;
+	pf->arg = arg;
+	pf->failed = FALSE;
+	numChunks = (count + grain - 1) / grain;
+
+	if (!pf->threaded || (numChunks < 2))
+		return parallel_for_range(pf, 0, count);
+
+	if (numChunks > pf->maxChunks)
+		numChunks = pf->maxChunks;
+
+	if (!parallel_for_ensure_works(pf, numChunks))
+		return parallel_for_range(pf, 0, count);
+
+	for (index = 0; index < numChunks; index++)
+	{
+		PARALLEL_FOR_CHUNK* chunk = &pf->chunks[index];
+		chunk->first = index * count / numChunks;
+		chunk->last = (index + 1) * count / numChunks;
+	}
+
+	/* chunk 0 runs on the calling thread instead of waiting idle */
+	SubmitThreadpoolWorkBatch(&pf->works[1], numChunks - 1);
+	parallel_for_work_callback(NULL, &pf->chunks[0], NULL);
+
+	for (index = 1; index < numChunks; index++)
+		WaitForThreadpoolWorkCallbacks(pf->works[index], FALSE);
+
+	return !pf->failed;
+}
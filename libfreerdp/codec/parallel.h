@@ -0,0 +1,58 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Parallel For
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_PARALLEL_H
+#define FREERDP_LIB_CODEC_PARALLEL_H
+
+#include <winpr/pool.h>
+#include <winpr/collections.h>
+
+#include <freerdp/api.h>
+
+/* Maximum number of scratch buffers handed to each chunk */
+#define PARALLEL_FOR_MAX_SCRATCH 2
+
+typedef struct S_PARALLEL_FOR PARALLEL_FOR;
+
+/**
+ * Processes item index of a parallel_for_run call.
+ * scratch holds the buffers taken from the scratch pool for the calling chunk,
+ * they are reused for every item of the chunk.
+ */
+typedef BOOL (*parallel_for_fn)(void* arg, size_t index, BYTE** scratch);
+
+/**
+ * Creates a parallel for helper.
+ * If threaded is FALSE all work is done on the calling thread, a NULL env uses the
+ * default thread pool.
+ * nscratch buffers (at most PARALLEL_FOR_MAX_SCRATCH) are taken from scratchPool per chunk.
+ * The work objects are created on demand and kept until parallel_for_free.
+ */
+FREERDP_LOCAL PARALLEL_FOR* parallel_for_new(BOOL threaded, PTP_CALLBACK_ENVIRON env,
+                                             wBufferPool* scratchPool, size_t nscratch);
+FREERDP_LOCAL void parallel_for_free(PARALLEL_FOR* pf);
+
+/**
+ * Calls fn for every index in [0, count), split into contiguous ranges of at least
+ * grain items. The calling thread processes the first range itself and returns
+ * once all ranges are done.
+ * Returns FALSE if any fn call failed or scratch buffers could not be acquired.
+ */
+FREERDP_LOCAL BOOL parallel_for_run(PARALLEL_FOR* pf, size_t count, size_t grain,
+                                    parallel_for_fn fn, void* arg);
+
+#endif /* FREERDP_LIB_CODEC_PARALLEL_H */
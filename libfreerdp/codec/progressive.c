@@ -849,13 +849,12 @@ static INLINE void progressive_rfx_dwt_2d_decode_block(INT16* buffer, INT16* tem
 }
 
 static INLINE int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* progressive, INT16* buffer,
-                                                INT16* current, BOOL coeffDiff, BOOL extrapolate,
-                                                BOOL reverse)
+                                                INT16* current, INT16* temp, BOOL coeffDiff,
+                                                BOOL extrapolate, BOOL reverse)
 {
 	const primitives_t* prims = primitives_get();
-	INT16* temp;
 
-	if (!progressive || !buffer || !current)
+	if (!progressive || !buffer || !current || !temp)
 		return -1;
 
 	if (coeffDiff)
@@ -865,9 +864,6 @@ static INLINE int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* progressive
 		CopyMemory(buffer, current, 4096 * 2);
 	else
 		CopyMemory(current, buffer, 4096 * 2);
-	temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1); /* DWT buffer */
-	if (!temp)
-		return -2;
 
 	if (!extrapolate)
 	{
@@ -879,7 +875,6 @@ static INLINE int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* progressive
 		progressive_rfx_dwt_2d_decode_block(&buffer[3007], temp, 2);
 		progressive_rfx_dwt_2d_decode_block(&buffer[0], temp, 1);
 	}
-	BufferPool_Return(progressive->bufferPool, temp);
 	return 1;
 }
 
@@ -895,8 +890,9 @@ static INLINE void progressive_rfx_decode_block(const primitives_t* prims, INT16
 static INLINE int progressive_rfx_decode_component(PROGRESSIVE_CONTEXT* progressive,
                                                    const RFX_COMPONENT_CODEC_QUANT* shift,
                                                    const BYTE* data, UINT32 length, INT16* buffer,
-                                                   INT16* current, INT16* sign, BOOL coeffDiff,
-                                                   BOOL subbandDiff, BOOL extrapolate)
+                                                   INT16* current, INT16* sign, INT16* temp,
+                                                   BOOL coeffDiff, BOOL subbandDiff,
+                                                   BOOL extrapolate)
 {
 	int status;
 	const primitives_t* prims = primitives_get();
@@ -935,18 +931,18 @@ static INLINE int progressive_rfx_decode_component(PROGRESSIVE_CONTEXT* progress
 		rfx_differential_decode(&buffer[4015], 81);                           /* LL3 */
 		progressive_rfx_decode_block(prims, &buffer[4015], 81, shift->LL3);   /* LL3 */
 	}
-	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, coeffDiff, extrapolate,
-	                                     FALSE);
+	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, temp, coeffDiff,
+	                                     extrapolate, FALSE);
 }
 
 static INLINE int progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* progressive,
                                                     RFX_PROGRESSIVE_TILE* tile,
                                                     PROGRESSIVE_BLOCK_REGION* region,
-                                                    const PROGRESSIVE_BLOCK_CONTEXT* context)
+                                                    const PROGRESSIVE_BLOCK_CONTEXT* context,
+                                                    BYTE* pBuffer, INT16* temp)
 {
 	int rc;
 	BOOL diff, sub, extrapolate;
-	BYTE* pBuffer;
 	INT16* pSign[3];
 	INT16* pSrcDst[3];
 	INT16* pCurrent[3];
@@ -1047,31 +1043,28 @@ static INLINE int progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* progres
 	pCurrent[1] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pCurrent[2] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
-	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
 	pSrcDst[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
 	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
 	rc = progressive_rfx_decode_component(progressive, &shiftY, tile->yData, tile->yLen, pSrcDst[0],
-	                                      pCurrent[0], pSign[0], diff, sub, extrapolate); /* Y */
+	                                      pCurrent[0], pSign[0], temp, diff, sub,
+	                                      extrapolate); /* Y */
 	if (rc < 0)
-		goto fail;
+		return rc;
 	rc = progressive_rfx_decode_component(progressive, &shiftCb, tile->cbData, tile->cbLen,
-	                                      pSrcDst[1], pCurrent[1], pSign[1], diff, sub,
+	                                      pSrcDst[1], pCurrent[1], pSign[1], temp, diff, sub,
 	                                      extrapolate); /* Cb */
 	if (rc < 0)
-		goto fail;
+		return rc;
 	rc = progressive_rfx_decode_component(progressive, &shiftCr, tile->crData, tile->crLen,
-	                                      pSrcDst[2], pCurrent[2], pSign[2], diff, sub,
+	                                      pSrcDst[2], pCurrent[2], pSign[2], temp, diff, sub,
 	                                      extrapolate); /* Cr */
 	if (rc < 0)
-		goto fail;
+		return rc;
 
-	rc = prims->yCbCrToRGB_16s8u_P3AC4R((const INT16* const*)pSrcDst, 64 * 2, tile->data,
-	                                    tile->stride, progressive->format, &roi_64x64);
-fail:
-	BufferPool_Return(progressive->bufferPool, pBuffer);
-	return rc;
+	return prims->yCbCrToRGB_16s8u_P3AC4R((const INT16* const*)pSrcDst, 64 * 2, tile->data,
+	                                      tile->stride, progressive->format, &roi_64x64);
 }
 
 static INLINE INT16 progressive_rfx_srl_read(RFX_PROGRESSIVE_UPGRADE_STATE* state, UINT32 numBits)
@@ -1247,7 +1240,7 @@ static INLINE int progressive_rfx_upgrade_block(RFX_PROGRESSIVE_UPGRADE_STATE* s
 static INLINE int progressive_rfx_upgrade_component(
     PROGRESSIVE_CONTEXT* progressive, const RFX_COMPONENT_CODEC_QUANT* shift,
     const RFX_COMPONENT_CODEC_QUANT* bitPos, const RFX_COMPONENT_CODEC_QUANT* numBits,
-    INT16* buffer, INT16* current, INT16* sign, const BYTE* srlData, UINT32 srlLen,
+    INT16* buffer, INT16* current, INT16* sign, INT16* temp, const BYTE* srlData, UINT32 srlLen,
     const BYTE* rawData, UINT32 rawLen, BOOL coeffDiff, BOOL subbandDiff, BOOL extrapolate)
 {
 	int rc;
@@ -1335,18 +1328,18 @@ static INLINE int progressive_rfx_upgrade_component(
 		return -1;
 	}
 
-	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, coeffDiff, extrapolate,
-	                                     TRUE);
+	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, temp, coeffDiff,
+	                                     extrapolate, TRUE);
 }
 
 static INLINE int progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* progressive,
                                                       RFX_PROGRESSIVE_TILE* tile,
                                                       PROGRESSIVE_BLOCK_REGION* region,
-                                                      const PROGRESSIVE_BLOCK_CONTEXT* context)
+                                                      const PROGRESSIVE_BLOCK_CONTEXT* context,
+                                                      BYTE* pBuffer, INT16* temp)
 {
 	int status;
 	BOOL coeffDiff, sub, extrapolate;
-	BYTE* pBuffer;
 	INT16* pSign[3] = { 0 };
 	INT16* pSrcDst[3] = { 0 };
 	INT16* pCurrent[3] = { 0 };
@@ -1472,40 +1465,36 @@ static INLINE int progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* progr
 	pCurrent[1] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pCurrent[2] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
-	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
 	pSrcDst[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
 	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
 	status = progressive_rfx_upgrade_component(progressive, &shiftY, quantProgY, &yNumBits,
-	                                           pSrcDst[0], pCurrent[0], pSign[0], tile->ySrlData,
-	                                           tile->ySrlLen, tile->yRawData, tile->yRawLen,
-	                                           coeffDiff, sub, extrapolate); /* Y */
+	                                           pSrcDst[0], pCurrent[0], pSign[0], temp,
+	                                           tile->ySrlData, tile->ySrlLen, tile->yRawData,
+	                                           tile->yRawLen, coeffDiff, sub, extrapolate); /* Y */
 
 	if (status < 0)
-		goto fail;
+		return status;
 
 	status = progressive_rfx_upgrade_component(progressive, &shiftCb, quantProgCb, &cbNumBits,
-	                                           pSrcDst[1], pCurrent[1], pSign[1], tile->cbSrlData,
-	                                           tile->cbSrlLen, tile->cbRawData, tile->cbRawLen,
-	                                           coeffDiff, sub, extrapolate); /* Cb */
+	                                           pSrcDst[1], pCurrent[1], pSign[1], temp,
+	                                           tile->cbSrlData, tile->cbSrlLen, tile->cbRawData,
+	                                           tile->cbRawLen, coeffDiff, sub, extrapolate); /* Cb */
 
 	if (status < 0)
-		goto fail;
+		return status;
 
 	status = progressive_rfx_upgrade_component(progressive, &shiftCr, quantProgCr, &crNumBits,
-	                                           pSrcDst[2], pCurrent[2], pSign[2], tile->crSrlData,
-	                                           tile->crSrlLen, tile->crRawData, tile->crRawLen,
-	                                           coeffDiff, sub, extrapolate); /* Cr */
+	                                           pSrcDst[2], pCurrent[2], pSign[2], temp,
+	                                           tile->crSrlData, tile->crSrlLen, tile->crRawData,
+	                                           tile->crRawLen, coeffDiff, sub, extrapolate); /* Cr */
 
 	if (status < 0)
-		goto fail;
+		return status;
 
-	status = prims->yCbCrToRGB_16s8u_P3AC4R((const INT16* const*)pSrcDst, 64 * 2, tile->data,
-	                                        tile->stride, progressive->format, &roi_64x64);
-fail:
-	BufferPool_Return(progressive->bufferPool, pBuffer);
-	return status;
+	return prims->yCbCrToRGB_16s8u_P3AC4R((const INT16* const*)pSrcDst, 64 * 2, tile->data,
+	                                      tile->stride, progressive->format, &roi_64x64);
 }
 
 static INLINE BOOL progressive_tile_read_upgrade(PROGRESSIVE_CONTEXT* progressive, wStream* s,
@@ -1653,35 +1642,32 @@ typedef struct
 	PROGRESSIVE_CONTEXT* progressive;
 	PROGRESSIVE_BLOCK_REGION* region;
 	const PROGRESSIVE_BLOCK_CONTEXT* context;
-	RFX_PROGRESSIVE_TILE* tile;
-} PROGRESSIVE_TILE_PROCESS_WORK_PARAM;
+} PROGRESSIVE_TILE_PROCESS_PARAM;
 
-static void CALLBACK progressive_process_tiles_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                                  void* context, PTP_WORK work)
+static BOOL progressive_process_tile(void* arg, size_t index, BYTE** scratch)
 {
-	PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = (PROGRESSIVE_TILE_PROCESS_WORK_PARAM*)context;
+	PROGRESSIVE_TILE_PROCESS_PARAM* param = (PROGRESSIVE_TILE_PROCESS_PARAM*)arg;
+	RFX_PROGRESSIVE_TILE* tile = param->region->tiles[index];
 
-	WINPR_UNUSED(instance);
-	WINPR_UNUSED(work);
-
-	switch (param->tile->blockType)
+	switch (tile->blockType)
 	{
 		case PROGRESSIVE_WBT_TILE_SIMPLE:
 		case PROGRESSIVE_WBT_TILE_FIRST:
-			progressive_decompress_tile_first(param->progressive, param->tile, param->region,
-			                                  param->context);
+			progressive_decompress_tile_first(param->progressive, tile, param->region,
+			                                  param->context, scratch[0], (INT16*)scratch[1]);
 			break;
 
 		case PROGRESSIVE_WBT_TILE_UPGRADE:
-			progressive_decompress_tile_upgrade(param->progressive, param->tile, param->region,
-			                                    param->context);
+			progressive_decompress_tile_upgrade(param->progressive, tile, param->region,
+			                                    param->context, scratch[0], (INT16*)scratch[1]);
 			break;
 		default:
 			WLog_Print(param->progressive->log, WLOG_ERROR, "Invalid block type %04 (%s)" PRIx16,
-			           param->tile->blockType,
-			           progressive_get_block_type_string(param->tile->blockType));
+			           tile->blockType, progressive_get_block_type_string(tile->blockType));
 			break;
 	}
+
+	return TRUE;
 }
 
 static INLINE int progressive_process_tiles(PROGRESSIVE_CONTEXT* progressive, wStream* s,
@@ -1689,16 +1675,12 @@ static INLINE int progressive_process_tiles(PROGRESSIVE_CONTEXT* progressive, wS
                                             PROGRESSIVE_SURFACE_CONTEXT* surface,
                                             const PROGRESSIVE_BLOCK_CONTEXT* context)
 {
-	int status = 0;
 	size_t end;
 	const size_t start = Stream_GetPosition(s);
-	UINT16 index;
 	UINT16 blockType;
 	UINT32 blockLen;
 	UINT32 count = 0;
-	PTP_WORK* work_objects = NULL;
-	PROGRESSIVE_TILE_PROCESS_WORK_PARAM* params = NULL;
-	UINT16 close_cnt = 0;
+	PROGRESSIVE_TILE_PROCESS_PARAM param = { 0 };
 
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(region);
@@ -1778,77 +1760,18 @@ static INLINE int progressive_process_tiles(PROGRESSIVE_CONTEXT* progressive, wS
 		return -1044;
 	}
 
-	if (progressive->rfx_context->priv->UseThreads)
-	{
-		work_objects = (PTP_WORK*)calloc(region->numTiles, sizeof(PTP_WORK));
-		if (!work_objects)
-			return -1;
-	}
-
-	params = (PROGRESSIVE_TILE_PROCESS_WORK_PARAM*)calloc(
-	    region->numTiles, sizeof(PROGRESSIVE_TILE_PROCESS_WORK_PARAM));
-	if (!params)
-	{
-		free(work_objects);
-		return -1;
-	}
-
 	WINPR_ASSERT(region->tiles || (region->numTiles == 0));
-	for (index = 0; index < region->numTiles; index++)
-	{
-		RFX_PROGRESSIVE_TILE* tile = region->tiles[index];
-		PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = &params[index];
-		param->progressive = progressive;
-		param->region = region;
-		param->context = context;
-		param->tile = tile;
-
-		if (progressive->rfx_context->priv->UseThreads)
-		{
-			if (!(work_objects[index] = CreateThreadpoolWork(
-			          progressive_process_tiles_tile_work_callback, (void*)&params[index],
-			          &progressive->rfx_context->priv->ThreadPoolEnv)))
-			{
-				WLog_ERR(TAG, "CreateThreadpoolWork failed.");
-				status = -1;
-				break;
-			}
-
-			SubmitThreadpoolWork(work_objects[index]);
-			close_cnt = index + 1;
-		}
-		else
-		{
-			progressive_process_tiles_tile_work_callback(0, &params[index], 0);
-		}
-
-		if (status < 0)
-		{
-			WLog_Print(progressive->log, WLOG_ERROR, "Failed to decompress %s at %" PRIu16,
-			           progressive_get_block_type_string(tile->blockType), index);
-			goto fail;
-		}
-	}
-
-	if (status < 0)
-		WLog_Print(progressive->log, WLOG_ERROR,
-		           "Failed to create ThreadpoolWork for tile %" PRIu16, index);
+	param.progressive = progressive;
+	param.region = region;
+	param.context = context;
 
-	if (progressive->rfx_context->priv->UseThreads)
+	if (!parallel_for_run(progressive->parallel, region->numTiles, 1, progressive_process_tile,
+	                      &param))
 	{
-		for (index = 0; index < close_cnt; index++)
-		{
-			WaitForThreadpoolWorkCallbacks(work_objects[index], FALSE);
-			CloseThreadpoolWork(work_objects[index]);
-		}
-	}
-
-fail:
-	free(work_objects);
-	free(params);
-
-	if (status < 0)
+		WLog_Print(progressive->log, WLOG_ERROR, "Failed to decompress %" PRIu16 " tiles",
+		           region->numTiles);
 		return -1;
+	}
 
 	return (int)(end - start);
 }
@@ -1882,90 +1805,95 @@ static INLINE BOOL progressive_write_wb_context(PROGRESSIVE_CONTEXT* progressive
 	Stream_Write_UINT32(s, blockLen);                /* blockLen (4 bytes) */
 	Stream_Write_UINT8(s, 0);                        /* ctxId (1 byte) */
 	Stream_Write_UINT16(s, 64);                      /* tileSize (2 bytes) */
-	Stream_Write_UINT8(s, 0);                        /* flags (1 byte) */
+	Stream_Write_UINT8(s, RFX_SUBBAND_DIFFING);      /* flags (1 byte) */
 	return TRUE;
 }
 
+static INLINE void progressive_component_codec_quant_write(wStream* s,
+                                                           const RFX_COMPONENT_CODEC_QUANT* quantVal)
+{
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LL3 | (quantVal->HL3 << 4))); /* LL3, HL3 */
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LH3 | (quantVal->HH3 << 4))); /* LH3, HH3 */
+	Stream_Write_UINT8(s, (BYTE)(quantVal->HL2 | (quantVal->LH2 << 4))); /* HL2, LH2 */
+	Stream_Write_UINT8(s, (BYTE)(quantVal->HH2 | (quantVal->HL1 << 4))); /* HH2, HL1 */
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LH1 | (quantVal->HH1 << 4))); /* LH1, HH1 */
+}
+
 static INLINE BOOL progressive_write_region(PROGRESSIVE_CONTEXT* progressive, wStream* s,
-                                            const RFX_MESSAGE* msg)
+                                            const RFX_RECT* rects, UINT16 numRects,
+                                            const RFX_COMPONENT_CODEC_QUANT* quantVals,
+                                            BYTE numQuant,
+                                            const RFX_PROGRESSIVE_CODEC_QUANT* quantProgVals,
+                                            BYTE numProgQuant, UINT16 numTiles,
+                                            const BYTE* tilesData, UINT32 tilesDataSize)
 {
 	/* RFX_PROGRESSIVE_REGION */
 	UINT32 blockLen = 18;
 	UINT16 i;
-	UINT32* qv;
-	UINT32 tilesDataSize;
 
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(s);
-	WINPR_ASSERT(msg);
-
-	blockLen += msg->numRects * 8;
-	blockLen += msg->numQuant * 5;
-	tilesDataSize = msg->numTiles * 22UL;
-	for (i = 0; i < msg->numTiles; i++)
-	{
-		const RFX_TILE* tile = msg->tiles[i];
-		WINPR_ASSERT(tile);
-		tilesDataSize += tile->YLen + tile->CbLen + tile->CrLen;
-	}
+	WINPR_ASSERT(rects);
+	WINPR_ASSERT(quantVals);
+	WINPR_ASSERT(quantProgVals || (numProgQuant == 0));
+	WINPR_ASSERT(tilesData || (tilesDataSize == 0));
+
+	blockLen += numRects * 8;
+	blockLen += numQuant * 5;
+	blockLen += numProgQuant * 16;
 	blockLen += tilesDataSize;
 
 	if (!Stream_EnsureRemainingCapacity(s, blockLen))
 		return FALSE;
 
-	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION); /* blockType (2 bytes) */
-	Stream_Write_UINT32(s, blockLen);               /* blockLen (4 bytes) */
-	Stream_Write_UINT8(s, 64);                      /* tileSize (1 byte) */
-	Stream_Write_UINT16(s, msg->numRects);          /* numRects (2 bytes) */
-	Stream_Write_UINT8(s, msg->numQuant);           /* numQuant (1 byte) */
-	Stream_Write_UINT8(s, 0);                       /* numProgQuant (1 byte) */
-	Stream_Write_UINT8(s, 0);                       /* flags (1 byte) */
-	Stream_Write_UINT16(s, msg->numTiles);          /* numTiles (2 bytes) */
-	Stream_Write_UINT32(s, tilesDataSize);          /* tilesDataSize (4 bytes) */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION);     /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, blockLen);                   /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 64);                          /* tileSize (1 byte) */
+	Stream_Write_UINT16(s, numRects);                   /* numRects (2 bytes) */
+	Stream_Write_UINT8(s, numQuant);                    /* numQuant (1 byte) */
+	Stream_Write_UINT8(s, numProgQuant);                /* numProgQuant (1 byte) */
+	Stream_Write_UINT8(s, RFX_DWT_REDUCE_EXTRAPOLATE); /* flags (1 byte) */
+	Stream_Write_UINT16(s, numTiles);                   /* numTiles (2 bytes) */
+	Stream_Write_UINT32(s, tilesDataSize);              /* tilesDataSize (4 bytes) */
 
-	for (i = 0; i < msg->numRects; i++)
+	for (i = 0; i < numRects; i++)
 	{
 		/* TS_RFX_RECT */
-		Stream_Write_UINT16(s, msg->rects[i].x);      /* x (2 bytes) */
-		Stream_Write_UINT16(s, msg->rects[i].y);      /* y (2 bytes) */
-		Stream_Write_UINT16(s, msg->rects[i].width);  /* width (2 bytes) */
-		Stream_Write_UINT16(s, msg->rects[i].height); /* height (2 bytes) */
+		Stream_Write_UINT16(s, rects[i].x);      /* x (2 bytes) */
+		Stream_Write_UINT16(s, rects[i].y);      /* y (2 bytes) */
+		Stream_Write_UINT16(s, rects[i].width);  /* width (2 bytes) */
+		Stream_Write_UINT16(s, rects[i].height); /* height (2 bytes) */
 	}
 
-	/**
-	 * Note: The RFX_COMPONENT_CODEC_QUANT structure differs from the
-	 * TS_RFX_CODEC_QUANT ([MS-RDPRFX] section 2.2.2.1.5) structure with respect
-	 * to the order of the bands.
-	 *             0    1    2   3     4    5    6    7    8    9
-	 * RDPRFX:   LL3, LH3, HL3, HH3, LH2, HL2, HH2, LH1, HL1, HH1
-	 * RDPEGFX:  LL3, HL3, LH3, HH3, HL2, LH2, HH2, HL1, LH1, HH1
-	 */
-	for (i = 0, qv = msg->quantVals; i < msg->numQuant; i++, qv += 10)
+	for (i = 0; i < numQuant; i++)
+		progressive_component_codec_quant_write(s, &quantVals[i]);
+
+	for (i = 0; i < numProgQuant; i++)
 	{
-		/* RFX_COMPONENT_CODEC_QUANT */
-		Stream_Write_UINT8(s, (UINT8)(qv[0] + (qv[2] << 4))); /* LL3 (4-bit), HL3 (4-bit) */
-		Stream_Write_UINT8(s, (UINT8)(qv[1] + (qv[3] << 4))); /* LH3 (4-bit), HH3 (4-bit) */
-		Stream_Write_UINT8(s, (UINT8)(qv[5] + (qv[4] << 4))); /* HL2 (4-bit), LH2 (4-bit) */
-		Stream_Write_UINT8(s, (UINT8)(qv[6] + (qv[8] << 4))); /* HH2 (4-bit), HL1 (4-bit) */
-		Stream_Write_UINT8(s, (UINT8)(qv[7] + (qv[9] << 4))); /* LH1 (4-bit), HH1 (4-bit) */
+		/* RFX_PROGRESSIVE_CODEC_QUANT */
+		Stream_Write_UINT8(s, quantProgVals[i].quality);
+		progressive_component_codec_quant_write(s, &quantProgVals[i].yQuantValues);
+		progressive_component_codec_quant_write(s, &quantProgVals[i].cbQuantValues);
+		progressive_component_codec_quant_write(s, &quantProgVals[i].crQuantValues);
 	}
+
+	Stream_Write(s, tilesData, tilesDataSize);
 	return TRUE;
 }
 
 static INLINE BOOL progressive_write_frame_begin(PROGRESSIVE_CONTEXT* progressive, wStream* s,
-                                                 const RFX_MESSAGE* msg)
+                                                 UINT32 frameIndex)
 {
 	const UINT32 blockLen = 12;
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(s);
-	WINPR_ASSERT(msg);
 
 	if (!Stream_EnsureRemainingCapacity(s, blockLen))
 		return FALSE;
 
 	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_BEGIN); /* blockType (2 bytes) */
 	Stream_Write_UINT32(s, blockLen);                    /* blockLen (4 bytes) */
-	Stream_Write_UINT32(s, msg->frameIdx);               /* frameIndex (4 bytes) */
+	Stream_Write_UINT32(s, frameIndex);                  /* frameIndex (4 bytes) */
 	Stream_Write_UINT16(s, 1);                           /* regionCount (2 bytes) */
 
 	return TRUE;
@@ -1986,33 +1914,76 @@ static INLINE BOOL progressive_write_frame_end(PROGRESSIVE_CONTEXT* progressive,
 	return TRUE;
 }
 
-static INLINE BOOL progressive_write_tile_simple(PROGRESSIVE_CONTEXT* progressive, wStream* s,
-                                                 const RFX_TILE* tile)
+static INLINE BOOL progressive_write_tile_first(PROGRESSIVE_CONTEXT* progressive, wStream* s,
+                                                UINT16 xIdx, UINT16 yIdx, BYTE quality,
+                                                const BYTE* const data[3], const UINT16 len[3])
 {
 	UINT32 blockLen;
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(s);
-	WINPR_ASSERT(tile);
 
-	blockLen = 22 + tile->YLen + tile->CbLen + tile->CrLen;
+	blockLen = 23 + len[0] + len[1] + len[2];
 	if (!Stream_EnsureRemainingCapacity(s, blockLen))
 		return FALSE;
 
-	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_SIMPLE); /* blockType (2 bytes) */
-	Stream_Write_UINT32(s, blockLen);                    /* blockLen (4 bytes) */
-	Stream_Write_UINT8(s, tile->quantIdxY);              /* quantIdxY (1 byte) */
-	Stream_Write_UINT8(s, tile->quantIdxCb);             /* quantIdxCb (1 byte) */
-	Stream_Write_UINT8(s, tile->quantIdxCr);             /* quantIdxCr (1 byte) */
-	Stream_Write_UINT16(s, tile->xIdx);                  /* xIdx (2 bytes) */
-	Stream_Write_UINT16(s, tile->yIdx);                  /* yIdx (2 bytes) */
-	Stream_Write_UINT8(s, 0);                            /* flags (1 byte) */
-	Stream_Write_UINT16(s, tile->YLen);                  /* YLen (2 bytes) */
-	Stream_Write_UINT16(s, tile->CbLen);                 /* CbLen (2 bytes) */
-	Stream_Write_UINT16(s, tile->CrLen);                 /* CrLen (2 bytes) */
-	Stream_Write_UINT16(s, 0);                           /* tailLen (2 bytes) */
-	Stream_Write(s, tile->YData, tile->YLen);            /* YData */
-	Stream_Write(s, tile->CbData, tile->CbLen);          /* CbData */
-	Stream_Write(s, tile->CrData, tile->CrLen);          /* CrData */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_FIRST); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, blockLen);                   /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, xIdx);                       /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, yIdx);                       /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, 0);                           /* flags (1 byte) */
+	Stream_Write_UINT8(s, quality);                     /* quality (1 byte) */
+	Stream_Write_UINT16(s, len[0]);                     /* yLen (2 bytes) */
+	Stream_Write_UINT16(s, len[1]);                     /* cbLen (2 bytes) */
+	Stream_Write_UINT16(s, len[2]);                     /* crLen (2 bytes) */
+	Stream_Write_UINT16(s, 0);                          /* tailLen (2 bytes) */
+	Stream_Write(s, data[0], len[0]);                   /* yData */
+	Stream_Write(s, data[1], len[1]);                   /* cbData */
+	Stream_Write(s, data[2], len[2]);                   /* crData */
+
+	return TRUE;
+}
+
+static INLINE BOOL progressive_write_tile_upgrade(PROGRESSIVE_CONTEXT* progressive, wStream* s,
+                                                  UINT16 xIdx, UINT16 yIdx, BYTE quality,
+                                                  const BYTE* const srlData[3],
+                                                  const UINT16 srlLen[3],
+                                                  const BYTE* const rawData[3],
+                                                  const UINT16 rawLen[3])
+{
+	size_t i;
+	UINT32 blockLen = 26;
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(s);
+
+	for (i = 0; i < 3; i++)
+		blockLen += srlLen[i] + rawLen[i];
+
+	if (!Stream_EnsureRemainingCapacity(s, blockLen))
+		return FALSE;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_UPGRADE); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, blockLen);                     /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, xIdx);                         /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, yIdx);                         /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, quality);                       /* quality (1 byte) */
+	Stream_Write_UINT16(s, srlLen[0]);                    /* ySrlLen (2 bytes) */
+	Stream_Write_UINT16(s, rawLen[0]);                    /* yRawLen (2 bytes) */
+	Stream_Write_UINT16(s, srlLen[1]);                    /* cbSrlLen (2 bytes) */
+	Stream_Write_UINT16(s, rawLen[1]);                    /* cbRawLen (2 bytes) */
+	Stream_Write_UINT16(s, srlLen[2]);                    /* crSrlLen (2 bytes) */
+	Stream_Write_UINT16(s, rawLen[2]);                    /* crRawLen (2 bytes) */
+
+	for (i = 0; i < 3; i++)
+	{
+		Stream_Write(s, srlData[i], srlLen[i]); /* srlData */
+		Stream_Write(s, rawData[i], rawLen[i]); /* rawData */
+	}
 
 	return TRUE;
 }
@@ -2582,45 +2553,549 @@ fail:
 	return rc;
 }
 
-static BOOL progressive_rfx_write_message_progressive_simple(PROGRESSIVE_CONTEXT* progressive,
-                                                             wStream* s, const RFX_MESSAGE* msg)
+/**
+ * The encoder always uses the reduce-extrapolate DWT with subband diffing, the only layout
+ * the upgrade passes can refine. Tiles are sent coarse first and refined through the
+ * progressive quantization levels below until they reach the base quantization.
+ */
+
+#define PROGRESSIVE_ENCODER_NUM_PROG_QUANT 2
+#define PROGRESSIVE_ENCODER_LEVEL_FULL PROGRESSIVE_ENCODER_NUM_PROG_QUANT
+#define PROGRESSIVE_ENCODER_STREAM_SIZE 0x8000
+#define PROGRESSIVE_ENCODER_UPGRADE_BUDGET (64 * 1024)
+
+static const RFX_COMPONENT_CODEC_QUANT progressive_encoder_quant = { 6, 6, 6, 6, 6,
+	                                                                 6, 6, 6, 6, 6 };
+
+static const RFX_PROGRESSIVE_CODEC_QUANT
+    progressive_encoder_quant_prog[PROGRESSIVE_ENCODER_NUM_PROG_QUANT] = {
+	    { 0,
+	      { 2, 3, 3, 4, 4, 4, 5, 5, 5, 6 },
+	      { 3, 4, 4, 5, 5, 5, 6, 6, 6, 7 },
+	      { 3, 4, 4, 5, 5, 5, 6, 6, 6, 7 } },
+	    { 1,
+	      { 1, 1, 1, 2, 2, 2, 3, 3, 3, 4 },
+	      { 2, 2, 2, 3, 3, 3, 4, 4, 4, 5 },
+	      { 2, 2, 2, 3, 3, 3, 4, 4, 4, 5 } }
+    };
+
+/* Subbands in the order of the upgrade pass: HL1, LH1, HH1, HL2, LH2, HH2, HL3, LH3, HH3, LL3 */
+static const UINT32 progressive_band_offset[10] = { 0,    1023, 2046, 3007, 3279,
+	                                                3551, 3807, 3879, 3951, 4015 };
+static const UINT32 progressive_band_length[10] = { 1023, 1023, 961, 272, 272,
+	                                                256,  72,   72,  64,  81 };
+
+typedef struct
 {
-	UINT32 i;
-	RFX_CONTEXT* context;
+	wBitStream* srl;
+	wBitStream* raw;
 
-	WINPR_ASSERT(progressive);
-	WINPR_ASSERT(s);
-	WINPR_ASSERT(msg);
-	context = progressive->rfx_context;
-	WINPR_ASSERT(context);
-	if (context->mode != RLGR1)
+	/* SRL state */
+
+	UINT32 kp;
+	UINT32 nz;
+} RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE;
+
+static INLINE BYTE progressive_encoder_quality(BYTE level)
+{
+	return (level < PROGRESSIVE_ENCODER_NUM_PROG_QUANT) ? level : 0xFF;
+}
+
+static void progressive_encoder_bit_pos(BYTE level, size_t component, BYTE bitPos[10])
+{
+	RFX_COMPONENT_CODEC_QUANT q = progressive_encoder_quant;
+
+	if (level < PROGRESSIVE_ENCODER_NUM_PROG_QUANT)
 	{
-		WLog_ERR(TAG, "%s: error, RLGR1 mode is required!", __FUNCTION__);
-		return FALSE;
+		const RFX_PROGRESSIVE_CODEC_QUANT* prog = &progressive_encoder_quant_prog[level];
+		const RFX_COMPONENT_CODEC_QUANT* val = &prog->yQuantValues;
+
+		if (component == 1)
+			val = &prog->cbQuantValues;
+		else if (component == 2)
+			val = &prog->crQuantValues;
+
+		progressive_rfx_quant_add(&progressive_encoder_quant, val, &q);
 	}
 
-	if (!progressive_write_wb_sync(progressive, s))
-		return FALSE;
+	bitPos[0] = q.HL1;
+	bitPos[1] = q.LH1;
+	bitPos[2] = q.HH1;
+	bitPos[3] = q.HL2;
+	bitPos[4] = q.LH2;
+	bitPos[5] = q.HH2;
+	bitPos[6] = q.HL3;
+	bitPos[7] = q.LH3;
+	bitPos[8] = q.HH3;
+	bitPos[9] = q.LL3;
+}
 
-	if (!progressive_write_wb_context(progressive, s))
-		return FALSE;
+static INLINE INT16 progressive_rfx_clamp(INT32 val)
+{
+	if (val < INT16_MIN)
+		return INT16_MIN;
+	if (val > INT16_MAX)
+		return INT16_MAX;
+	return (INT16)val;
+}
+
+/**
+ * Forward lifting step matching progressive_rfx_idwt_x/progressive_rfx_idwt_y.
+ * The line has nLowCount + nHighCount samples.
+ */
+static INLINE void progressive_rfx_dwt_line(const INT16* pSrc, size_t nSrcStep, INT16* pLowBand,
+                                            size_t nLowStep, INT16* pHighBand, size_t nHighStep,
+                                            size_t nLowCount, size_t nHighCount)
+{
+	size_t j;
+
+	for (j = 0; j < nHighCount; j++)
+	{
+		const INT32 X0 = pSrc[(2 * j) * nSrcStep];
+		const INT32 X1 = pSrc[(2 * j + 1) * nSrcStep];
+		const INT32 X2 = pSrc[(2 * j + 2) * nSrcStep];
+		pHighBand[j * nHighStep] = progressive_rfx_clamp((X1 - ((X0 + X2) / 2)) / 2);
+	}
+
+	pLowBand[0] = progressive_rfx_clamp(pSrc[0] + pHighBand[0]);
+
+	for (j = 1; j < nHighCount; j++)
+	{
+		const INT32 H0 = pHighBand[(j - 1) * nHighStep];
+		const INT32 H1 = pHighBand[j * nHighStep];
+		pLowBand[j * nLowStep] = progressive_rfx_clamp(pSrc[(2 * j) * nSrcStep] + ((H0 + H1) / 2));
+	}
+
+	j = nHighCount;
+	if (nLowCount == nHighCount + 1)
+	{
+		pLowBand[j * nLowStep] =
+		    progressive_rfx_clamp(pSrc[(2 * j) * nSrcStep] + pHighBand[(j - 1) * nHighStep]);
+	}
+	else
+	{
+		/* level 1: 64 samples, 33 low and 31 high coefficients */
+		const INT32 X0 = pSrc[(2 * j) * nSrcStep];
+		const INT32 X1 = pSrc[(2 * j + 1) * nSrcStep];
+		pLowBand[j * nLowStep] = progressive_rfx_clamp(X0 + (pHighBand[(j - 1) * nHighStep] / 2));
+		pLowBand[(j + 1) * nLowStep] = progressive_rfx_clamp((2 * X1) - X0);
+	}
+}
+
+static INLINE void progressive_rfx_dwt_2d_encode_block(INT16* buffer, size_t nSrcStep, INT16* temp,
+                                                       size_t level)
+{
+	size_t i;
+	INT16 *HL, *LH, *HH, *LL;
+	INT16 *L, *H;
+	const size_t nBandL = progressive_rfx_get_band_l_count(level);
+	const size_t nBandH = progressive_rfx_get_band_h_count(level);
+	const size_t nStep = nBandL + nBandH;
+
+	L = &temp[0];
+	H = &temp[nBandL * nStep];
 
-	if (!progressive_write_frame_begin(progressive, s, msg))
+	/* vertical (buffer -> L + H), consumes the whole input before it is overwritten */
+	for (i = 0; i < nStep; i++)
+		progressive_rfx_dwt_line(&buffer[i], nSrcStep, &L[i], nStep, &H[i], nStep, nBandL, nBandH);
+
+	HL = &buffer[0];
+	LH = &HL[nBandL * nBandH];
+	HH = &LH[nBandH * nBandL];
+	LL = &HH[nBandH * nBandH];
+
+	/* horizontal (L -> LL + HL) */
+	for (i = 0; i < nBandL; i++)
+		progressive_rfx_dwt_line(&L[i * nStep], 1, &LL[i * nBandL], 1, &HL[i * nBandH], 1, nBandL,
+		                         nBandH);
+
+	/* horizontal (H -> LH + HH) */
+	for (i = 0; i < nBandH; i++)
+		progressive_rfx_dwt_line(&H[i * nStep], 1, &LH[i * nBandL], 1, &HH[i * nBandH], 1, nBandL,
+		                         nBandH);
+}
+
+static INLINE void progressive_rfx_dwt_2d_encode(INT16* buffer, INT16* temp)
+{
+	progressive_rfx_dwt_2d_encode_block(&buffer[0], 64, temp, 1);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3007], 33, temp, 2);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3807], 17, temp, 3);
+}
+
+static BOOL progressive_encoder_load_tile(const BYTE* pSrcData, UINT32 SrcFormat, UINT32 ScanLine,
+                                          UINT32 Width, UINT32 Height,
+                                          const PROGRESSIVE_ENCODER_TILE* tile, BYTE* pDstData)
+{
+	UINT32 x, y;
+	const UINT32 nXSrc = tile->xIdx * 64;
+	const UINT32 nYSrc = tile->yIdx * 64;
+	const UINT32 width = MIN(64, Width - nXSrc);
+	const UINT32 height = MIN(64, Height - nYSrc);
+
+	if (!freerdp_image_copy(pDstData, PIXEL_FORMAT_BGRX32, 64 * 4, 0, 0, width, height, pSrcData,
+	                        SrcFormat, ScanLine, nXSrc, nYSrc, NULL, FREERDP_FLIP_NONE))
 		return FALSE;
 
-	if (!progressive_write_region(progressive, s, msg))
+	/* Pad partial tiles by repeating the last column and row */
+	for (y = 0; y < height; y++)
+	{
+		UINT32* line = (UINT32*)&pDstData[y * 64 * 4];
+
+		for (x = width; x < 64; x++)
+			line[x] = line[width - 1];
+	}
+
+	for (y = height; y < 64; y++)
+		CopyMemory(&pDstData[y * 64 * 4], &pDstData[(height - 1) * 64 * 4], 64 * 4);
+
+	return TRUE;
+}
+
+static BOOL progressive_encoder_tile_coefficients(const BYTE* data, INT16* pSrcDst[3], INT16* temp)
+{
+	size_t i;
+	union
+	{
+		const INT16** cpv;
+		INT16** pv;
+	} cnv;
+	static const prim_size_t roi_64x64 = { 64, 64 };
+	const primitives_t* prims = primitives_get();
+
+	for (i = 0; i < 64 * 64; i++)
+	{
+		const BYTE* pixel = &data[i * 4];
+		pSrcDst[0][i] = pixel[2]; /* R */
+		pSrcDst[1][i] = pixel[1]; /* G */
+		pSrcDst[2][i] = pixel[0]; /* B */
+	}
+
+	cnv.pv = pSrcDst;
+	if (prims->RGBToYCbCr_16s16s_P3P3(cnv.cpv, 64 * sizeof(INT16), pSrcDst, 64 * sizeof(INT16),
+	                                  &roi_64x64) != PRIMITIVES_SUCCESS)
 		return FALSE;
 
-	for (i = 0; i < msg->numTiles; i++)
+	for (i = 0; i < 3; i++)
+	{
+		size_t j;
+		INT16* coeffs = pSrcDst[i];
+		/* All passes truncate, so round towards the nearest step of the final quantization */
+		const INT32 half = 1 << (progressive_encoder_quant.LL3 - 2);
+
+		progressive_rfx_dwt_2d_encode(coeffs, temp);
+
+		for (j = 0; j < 4015; j++)
+			coeffs[j] = progressive_rfx_clamp(coeffs[j] + ((coeffs[j] < 0) ? -half : half));
+
+		for (; j < 4096; j++)
+			coeffs[j] = progressive_rfx_clamp(coeffs[j] + half);
+	}
+
+	return TRUE;
+}
+
+static void progressive_rfx_quantize(const INT16* coeffs, INT16* dst, const BYTE bitPos[10])
+{
+	size_t band, index;
+
+	for (band = 0; band < 9; band++)
+	{
+		const UINT32 shift = bitPos[band] - 1;
+		const INT16* src = &coeffs[progressive_band_offset[band]];
+		INT16* q = &dst[progressive_band_offset[band]];
+
+		/* sign-magnitude, the upgrade pass only refines the magnitude */
+		for (index = 0; index < progressive_band_length[band]; index++)
+		{
+			const INT32 val = src[index];
+			q[index] = (INT16)((val < 0) ? -(-val >> shift) : (val >> shift));
+		}
+	}
+
 	{
-		const RFX_TILE* tile = msg->tiles[i];
-		if (!progressive_write_tile_simple(progressive, s, tile))
+		const UINT32 shift = bitPos[9] - 1;
+		const INT16* src = &coeffs[progressive_band_offset[9]];
+		INT16* q = &dst[progressive_band_offset[9]];
+
+		for (index = 0; index < progressive_band_length[9]; index++)
+			q[index] = (INT16)(src[index] >> shift);
+
+		rfx_differential_encode(q, (int)progressive_band_length[9]);
+	}
+}
+
+/**
+ * The RLGR encoder emits a trailing zero as a magnitude of one, but the decoder zero fills
+ * whatever the stream does not cover. Only encode up to the last nonzero coefficient.
+ */
+static int progressive_rfx_rlgr_encode(RFX_CONTEXT* context, const INT16* data, BYTE* buffer,
+                                       UINT32 buffer_size)
+{
+	UINT32 size = 4096;
+
+	while ((size > 0) && (data[size - 1] == 0))
+		size--;
+
+	/* The RLGR encoder expects a zeroed buffer */
+	ZeroMemory(buffer, buffer_size);
+
+	/* an empty stream is rejected, a single zero byte decodes as all zero */
+	if (size == 0)
+		return 1;
+
+	return context->rlgr_encode(RLGR1, data, size, buffer, buffer_size);
+}
+
+static INLINE void progressive_rfx_bits_write(wBitStream* bs, UINT32 bits, UINT32 nbits)
+{
+	if (nbits == 0)
+		return;
+
+	BitStream_Write_Bits(bs, bits & ((1u << nbits) - 1u), nbits);
+}
+
+static INLINE void progressive_rfx_srl_write(RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE* state, INT32 val,
+                                             UINT32 numBits)
+{
+	UINT32 mag;
+	const UINT32 k = state->kp / 8;
+
+	if (val == 0)
+	{
+		/* '0' bit, a run of (1 << k) zeros */
+		state->nz++;
+
+		if (state->nz == (1u << k))
+		{
+			progressive_rfx_bits_write(state->srl, 0, 1);
+			state->nz = 0;
+			state->kp = MIN(state->kp + 4, 80);
+		}
+
+		return;
+	}
+
+	/* '1' bit, the zeros preceding this value in k bits, then the sign */
+	progressive_rfx_bits_write(state->srl, 1, 1);
+	progressive_rfx_bits_write(state->srl, state->nz, k);
+	progressive_rfx_bits_write(state->srl, (val < 0) ? 1 : 0, 1);
+	state->nz = 0;
+	state->kp = (state->kp < 6) ? 0 : state->kp - 6;
+
+	if (numBits == 1)
+		return;
+
+	/* unary magnitude, the terminating '1' is implicit for the maximum value */
+	mag = (UINT32)((val < 0) ? -val : val);
+
+	for (; mag > 1; mag--)
+		progressive_rfx_bits_write(state->srl, 0, 1);
+
+	if ((UINT32)((val < 0) ? -val : val) < ((1u << numBits) - 1))
+		progressive_rfx_bits_write(state->srl, 1, 1);
+}
+
+static void progressive_rfx_upgrade_encode_component(RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE* state,
+                                                     const INT16* coeffs, const BYTE oldBitPos[10],
+                                                     const BYTE newBitPos[10])
+{
+	size_t band, index;
+
+	state->kp = 8;
+	state->nz = 0;
+
+	for (band = 0; band < 10; band++)
+	{
+		const INT16* src = &coeffs[progressive_band_offset[band]];
+		const UINT32 numBits = oldBitPos[band] - newBitPos[band];
+		const UINT32 oldShift = oldBitPos[band] - 1;
+		const UINT32 newShift = newBitPos[band] - 1;
+		const UINT32 mask = (1u << numBits) - 1u;
+
+		if (numBits == 0)
+			continue;
+
+		for (index = 0; index < progressive_band_length[band]; index++)
+		{
+			const INT32 val = src[index];
+			const UINT32 mag = (UINT32)((val < 0) ? -val : val);
+
+			if (band == 9)
+			{
+				/* LL3 is refined with raw bits only */
+				progressive_rfx_bits_write(state->raw, (UINT32)(val >> newShift) & mask, numBits);
+			}
+			else if ((mag >> oldShift) != 0)
+			{
+				/* already significant, raw magnitude bits */
+				progressive_rfx_bits_write(state->raw, (mag >> newShift) & mask, numBits);
+			}
+			else
+			{
+				const INT32 bits = (INT32)((mag >> newShift) & mask);
+				progressive_rfx_srl_write(state, (val < 0) ? -bits : bits, numBits);
+			}
+		}
+	}
+
+	/* flush a pending zero run */
+	if (state->nz > 0)
+		progressive_rfx_bits_write(state->srl, 0, 1);
+}
+
+static INLINE UINT16 progressive_rfx_bits_finish(wBitStream* bs)
+{
+	BitStream_Flush(bs);
+	return (UINT16)((bs->position + 7) / 8);
+}
+
+static BOOL progressive_encoder_tile_first(PROGRESSIVE_CONTEXT* progressive, wStream* s,
+                                           const PROGRESSIVE_ENCODER_TILE* tile,
+                                           INT16* const coeffs[3], INT16* temp)
+{
+	size_t i;
+	const BYTE* data[3];
+	UINT16 len[3];
+	BYTE bitPos[10];
+	BYTE* buffer = progressive->encoder.buffer;
+	RFX_CONTEXT* context = progressive->rfx_context;
+
+	for (i = 0; i < 3; i++)
+	{
+		int rc;
+		BYTE* dst = &buffer[i * PROGRESSIVE_ENCODER_STREAM_SIZE];
+
+		progressive_encoder_bit_pos(tile->level, i, bitPos);
+		progressive_rfx_quantize(coeffs[i], temp, bitPos);
+
+		rc = progressive_rfx_rlgr_encode(context, temp, dst, PROGRESSIVE_ENCODER_STREAM_SIZE);
+		if ((rc < 0) || (rc > UINT16_MAX))
 			return FALSE;
+
+		data[i] = dst;
+		len[i] = (UINT16)rc;
 	}
 
-	if (!progressive_write_frame_end(progressive, s))
+	return progressive_write_tile_first(progressive, s, tile->xIdx, tile->yIdx,
+	                                    progressive_encoder_quality(tile->level), data, len);
+}
+
+static BOOL progressive_encoder_tile_upgrade(PROGRESSIVE_CONTEXT* progressive, wStream* s,
+                                             const PROGRESSIVE_ENCODER_TILE* tile,
+                                             INT16* const coeffs[3])
+{
+	size_t i;
+	const BYTE* srlData[3];
+	const BYTE* rawData[3];
+	UINT16 srlLen[3];
+	UINT16 rawLen[3];
+	BYTE oldBitPos[10];
+	BYTE newBitPos[10];
+	BYTE* buffer = progressive->encoder.buffer;
+
+	WINPR_ASSERT(tile->level > 0);
+
+	for (i = 0; i < 3; i++)
+	{
+		wBitStream srl = { 0 };
+		wBitStream raw = { 0 };
+		RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE state = { 0 };
+		BYTE* pSrl = &buffer[(2 * i) * PROGRESSIVE_ENCODER_STREAM_SIZE];
+		BYTE* pRaw = &buffer[(2 * i + 1) * PROGRESSIVE_ENCODER_STREAM_SIZE];
+
+		BitStream_Attach(&srl, pSrl, PROGRESSIVE_ENCODER_STREAM_SIZE);
+		BitStream_Attach(&raw, pRaw, PROGRESSIVE_ENCODER_STREAM_SIZE);
+		state.srl = &srl;
+		state.raw = &raw;
+
+		progressive_encoder_bit_pos(tile->level - 1, i, oldBitPos);
+		progressive_encoder_bit_pos(tile->level, i, newBitPos);
+		progressive_rfx_upgrade_encode_component(&state, coeffs[i], oldBitPos, newBitPos);
+
+		srlData[i] = pSrl;
+		srlLen[i] = progressive_rfx_bits_finish(&srl);
+		rawData[i] = pRaw;
+		rawLen[i] = progressive_rfx_bits_finish(&raw);
+	}
+
+	return progressive_write_tile_upgrade(progressive, s, tile->xIdx, tile->yIdx,
+	                                      progressive_encoder_quality(tile->level), srlData, srlLen,
+	                                      rawData, rawLen);
+}
+
+static void progressive_encoder_free_tiles(PROGRESSIVE_ENCODER_CONTEXT* encoder)
+{
+	UINT32 index;
+
+	WINPR_ASSERT(encoder);
+
+	for (index = 0; index < encoder->gridSize; index++)
+		free(encoder->tiles[index].data);
+
+	free(encoder->tiles);
+	encoder->tiles = NULL;
+	encoder->gridSize = 0;
+	encoder->gridWidth = 0;
+	encoder->gridHeight = 0;
+	encoder->width = 0;
+	encoder->height = 0;
+	encoder->upgradeIndex = 0;
+}
+
+static BOOL progressive_encoder_resize(PROGRESSIVE_ENCODER_CONTEXT* encoder, UINT32 width,
+                                       UINT32 height)
+{
+	UINT32 xIdx, yIdx;
+
+	WINPR_ASSERT(encoder);
+
+	if (encoder->tiles && (encoder->width == width) && (encoder->height == height))
+		return TRUE;
+
+	progressive_encoder_free_tiles(encoder);
+	encoder->gridWidth = (width + 63) / 64;
+	encoder->gridHeight = (height + 63) / 64;
+	encoder->gridSize = encoder->gridWidth * encoder->gridHeight;
+	encoder->tiles =
+	    (PROGRESSIVE_ENCODER_TILE*)calloc(encoder->gridSize, sizeof(PROGRESSIVE_ENCODER_TILE));
+
+	if (!encoder->tiles)
+	{
+		encoder->gridSize = 0;
 		return FALSE;
+	}
 
+	for (yIdx = 0; yIdx < encoder->gridHeight; yIdx++)
+	{
+		for (xIdx = 0; xIdx < encoder->gridWidth; xIdx++)
+		{
+			PROGRESSIVE_ENCODER_TILE* tile = &encoder->tiles[yIdx * encoder->gridWidth + xIdx];
+			tile->xIdx = (UINT16)xIdx;
+			tile->yIdx = (UINT16)yIdx;
+		}
+	}
+
+	encoder->width = width;
+	encoder->height = height;
+	return TRUE;
+}
+
+static BOOL progressive_encoder_add_rect(PROGRESSIVE_CONTEXT* progressive,
+                                         const PROGRESSIVE_ENCODER_TILE* tile, UINT16* numRects)
+{
+	RFX_RECT* rect;
+	const PROGRESSIVE_ENCODER_CONTEXT* encoder = &progressive->encoder;
+
+	if (!Stream_EnsureRemainingCapacity(progressive->rects, sizeof(RFX_RECT)))
+		return FALSE;
+
+	rect = (RFX_RECT*)Stream_Pointer(progressive->rects);
+	rect->x = tile->xIdx * 64;
+	rect->y = tile->yIdx * 64;
+	rect->width = (UINT16)MIN(64, encoder->width - rect->x);
+	rect->height = (UINT16)MIN(64, encoder->height - rect->y);
+	Stream_Seek(progressive->rects, sizeof(RFX_RECT));
+	(*numRects)++;
 	return TRUE;
 }
 
@@ -2628,13 +3103,17 @@ int progressive_compress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData,
                          UINT32 SrcFormat, UINT32 Width, UINT32 Height, UINT32 ScanLine,
                          const REGION16* invalidRegion, BYTE** ppDstData, UINT32* pDstSize)
 {
-	BOOL rc;
 	int res = -6;
 	wStream* s;
-	UINT32 i, numRects;
-	UINT32 x, y;
-	RFX_RECT* rects = NULL;
-	RFX_MESSAGE* message;
+	wStream* tileData;
+	UINT32 i, x, y;
+	UINT32 numRects;
+	UINT16 numTiles = 0;
+	BYTE* pBuffer = NULL;
+	BYTE* pixels;
+	INT16* temp;
+	INT16* coeffs[3];
+	PROGRESSIVE_ENCODER_CONTEXT* encoder;
 
 	if (!progressive || !pSrcData || !ppDstData || !pDstSize)
 	{
@@ -2663,94 +3142,183 @@ int progressive_compress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData,
 	if (SrcSize < Height * ScanLine)
 		return -4;
 
+	if ((Width == 0) || (Height == 0) || (Width > UINT16_MAX) || (Height > UINT16_MAX))
+		return -3;
+
+	encoder = &progressive->encoder;
+	if (!progressive_encoder_resize(encoder, Width, Height))
+		return -5;
+
+	/* Mark the tiles touched by the invalid region */
 	if (!invalidRegion)
 	{
-		numRects = (Width + 63) / 64;
-		numRects *= (Height + 63) / 64;
+		for (i = 0; i < encoder->gridSize; i++)
+			encoder->tiles[i].updated = TRUE;
 	}
 	else
-		numRects = region16_n_rects(invalidRegion);
+	{
+		const RECTANGLE_16* rects = region16_rects(invalidRegion, &numRects);
 
-	if (numRects == 0)
-		return 0;
+		for (i = 0; i < numRects; i++)
+		{
+			const RECTANGLE_16* r = &rects[i];
+			const UINT32 right = MIN(r->right, Width);
+			const UINT32 bottom = MIN(r->bottom, Height);
 
-	if (!Stream_EnsureCapacity(progressive->rects, numRects * sizeof(RFX_RECT)))
-		return -5;
-	rects = (RFX_RECT*)Stream_Buffer(progressive->rects);
-	if (invalidRegion)
+			for (y = r->top / 64; y < (bottom + 63) / 64; y++)
+			{
+				for (x = r->left / 64; x < (right + 63) / 64; x++)
+					encoder->tiles[y * encoder->gridWidth + x].updated = TRUE;
+			}
+		}
+	}
+
+	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
+	temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1);
+	if (!pBuffer || !temp)
+		goto fail;
+
+	coeffs[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	coeffs[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	coeffs[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+	pixels = (BYTE*)&temp[4096];
+
+	tileData = encoder->tileData;
+	Stream_SetPosition(tileData, 0);
+	Stream_SetPosition(progressive->rects, 0);
+
+	/* First pass for every changed tile */
+	for (i = 0; i < encoder->gridSize; i++)
 	{
-		const RECTANGLE_16* region_rects = region16_rects(invalidRegion, NULL);
-		for (x = 0; x < numRects; x++)
+		PROGRESSIVE_ENCODER_TILE* tile = &encoder->tiles[i];
+
+		if (!tile->updated)
+			continue;
+
+		if (!progressive_encoder_load_tile(pSrcData, SrcFormat, ScanLine, Width, Height, tile,
+		                                   pixels))
+			goto fail;
+
+		if (tile->valid && (memcmp(pixels, tile->data, 64 * 64 * 4) == 0))
 		{
-			const RECTANGLE_16* r = &region_rects[x];
-			RFX_RECT* rect = &rects[x];
+			tile->updated = FALSE;
+			continue;
+		}
 
-			rect->x = r->left;
-			rect->y = r->top;
-			rect->width = r->right - r->left;
-			rect->height = r->bottom - r->top;
+		if (!tile->data)
+		{
+			tile->data = (BYTE*)malloc(64 * 64 * 4);
+			if (!tile->data)
+				goto fail;
 		}
+
+		CopyMemory(tile->data, pixels, 64 * 64 * 4);
+		tile->valid = TRUE;
+		tile->level = 0;
+
+		if (!progressive_encoder_tile_coefficients(tile->data, coeffs, temp))
+			goto fail;
+
+		if (!progressive_encoder_tile_first(progressive, tileData, tile, coeffs, temp))
+			goto fail;
+
+		if (!progressive_encoder_add_rect(progressive, tile, &numTiles))
+			goto fail;
 	}
-	else
+
+	/* Upgrade passes for static tiles, round robin within the remaining budget */
+	for (i = 0, x = encoder->upgradeIndex;
+	     (i < encoder->gridSize) &&
+	     (Stream_GetPosition(tileData) < PROGRESSIVE_ENCODER_UPGRADE_BUDGET);
+	     i++)
 	{
-		x = 0;
-		y = 0;
-		for (i = 0; i < numRects; i++)
-		{
-			RFX_RECT* r = &rects[i];
-			r->x = x;
-			r->y = y;
-			r->width = MIN(64, Width - x);
-			r->height = MIN(64, Height - y);
+		const UINT32 index = (x + i) % encoder->gridSize;
+		PROGRESSIVE_ENCODER_TILE* tile = &encoder->tiles[index];
 
-			if (x + 64 >= Width)
-			{
-				y += 64;
-				x = 0;
-			}
-			else
-				x += 64;
+		if (!tile->valid || tile->updated || (tile->level >= PROGRESSIVE_ENCODER_LEVEL_FULL))
+			continue;
 
-			WINPR_ASSERT(r->x % 64 == 0);
-			WINPR_ASSERT(r->y % 64 == 0);
-			WINPR_ASSERT(r->width <= 64);
-			WINPR_ASSERT(r->height <= 64);
-		}
+		tile->level++;
+
+		if (!progressive_encoder_tile_coefficients(tile->data, coeffs, temp))
+			goto fail;
+
+		if (!progressive_encoder_tile_upgrade(progressive, tileData, tile, coeffs))
+			goto fail;
+
+		if (!progressive_encoder_add_rect(progressive, tile, &numTiles))
+			goto fail;
+
+		encoder->upgradeIndex = (index + 1) % encoder->gridSize;
 	}
-	s = progressive->buffer;
-	Stream_SetPosition(s, 0);
 
-	progressive->rfx_context->mode = RLGR1;
-	progressive->rfx_context->width = Width;
-	progressive->rfx_context->height = Height;
-	rfx_context_set_pixel_format(progressive->rfx_context, SrcFormat);
-	message = rfx_encode_message(progressive->rfx_context, rects, numRects, pSrcData, Width, Height,
-	                             ScanLine);
-	if (!message)
+	for (i = 0; i < encoder->gridSize; i++)
+		encoder->tiles[i].updated = FALSE;
+
+	if (numTiles == 0)
 	{
-		WLog_ERR(TAG, "failed to encode rfx message");
+		res = 0;
 		goto fail;
 	}
 
-	message->freeRects = TRUE;
+	s = progressive->buffer;
+	Stream_SetPosition(s, 0);
 
-	rc = progressive_rfx_write_message_progressive_simple(progressive, s, message);
-	rfx_message_free(progressive->rfx_context, message);
-	if (!rc)
+	if (!progressive_write_wb_sync(progressive, s))
+		goto fail;
+
+	if (!progressive_write_wb_context(progressive, s))
+		goto fail;
+
+	if (!progressive_write_frame_begin(progressive, s, encoder->frameIndex++))
+		goto fail;
+
+	if (!progressive_write_region(progressive, s, (const RFX_RECT*)Stream_Buffer(progressive->rects),
+	                              numTiles, &progressive_encoder_quant, 1,
+	                              progressive_encoder_quant_prog,
+	                              PROGRESSIVE_ENCODER_NUM_PROG_QUANT, numTiles,
+	                              Stream_Buffer(tileData), (UINT32)Stream_GetPosition(tileData)))
+		goto fail;
+
+	if (!progressive_write_frame_end(progressive, s))
 		goto fail;
 
-	*pDstSize = Stream_GetPosition(s);
+	*pDstSize = (UINT32)Stream_GetPosition(s);
 	*ppDstData = Stream_Buffer(s);
 	res = 1;
 fail:
+	if (res < 0)
+		WLog_Print(progressive->log, WLOG_ERROR, "failed to encode progressive message");
+
+	BufferPool_Return(progressive->bufferPool, temp);
+	BufferPool_Return(progressive->bufferPool, pBuffer);
 	return res;
 }
 
+BOOL progressive_compress_pending(PROGRESSIVE_CONTEXT* progressive)
+{
+	UINT32 i;
+
+	if (!progressive || !progressive->Compressor)
+		return FALSE;
+
+	for (i = 0; i < progressive->encoder.gridSize; i++)
+	{
+		const PROGRESSIVE_ENCODER_TILE* tile = &progressive->encoder.tiles[i];
+
+		if (tile->valid && (tile->level < PROGRESSIVE_ENCODER_LEVEL_FULL))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* progressive)
 {
 	if (!progressive)
 		return FALSE;
 
+	progressive_encoder_free_tiles(&progressive->encoder);
 	return TRUE;
 }
 
@@ -2775,9 +3343,24 @@ PROGRESSIVE_CONTEXT* progressive_context_new(BOOL Compressor)
 	progressive->rects = Stream_New(NULL, 1024);
 	if (!progressive->rects)
 		goto fail;
+	if (Compressor)
+	{
+		progressive->encoder.tileData = Stream_New(NULL, 1024);
+		if (!progressive->encoder.tileData)
+			goto fail;
+		progressive->encoder.buffer = (BYTE*)malloc(6 * PROGRESSIVE_ENCODER_STREAM_SIZE);
+		if (!progressive->encoder.buffer)
+			goto fail;
+	}
 	progressive->bufferPool = BufferPool_New(TRUE, (8192 + 32) * 3, 16);
 	if (!progressive->bufferPool)
 		goto fail;
+	/* tiles are decoded on the pool of the RemoteFX context */
+	progressive->parallel = parallel_for_new(progressive->rfx_context->priv->UseThreads,
+	                                         &progressive->rfx_context->priv->ThreadPoolEnv,
+	                                         progressive->bufferPool, 2);
+	if (!progressive->parallel)
+		goto fail;
 	progressive->SurfaceContexts = HashTable_New(TRUE);
 	if (!progressive->SurfaceContexts)
 		goto fail;
@@ -2800,6 +3383,10 @@ void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
 
 	Stream_Free(progressive->buffer, TRUE);
 	Stream_Free(progressive->rects, TRUE);
+	progressive_encoder_free_tiles(&progressive->encoder);
+	Stream_Free(progressive->encoder.tileData, TRUE);
+	free(progressive->encoder.buffer);
+	parallel_for_free(progressive->parallel);
 	rfx_context_free(progressive->rfx_context);
 
 	BufferPool_Free(progressive->bufferPool);
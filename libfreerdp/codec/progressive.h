@@ -26,6 +26,8 @@
 
 #include <freerdp/codec/rfx.h>
 
+#include "parallel.h"
+
 #define RFX_SUBBAND_DIFFING 0x01
 
 #define RFX_TILE_DIFFERENCE 0x01
@@ -197,6 +199,30 @@ typedef struct
 	UINT32* updatedTileIndices;
 } PROGRESSIVE_SURFACE_CONTEXT;
 
+typedef struct
+{
+	UINT16 xIdx;
+	UINT16 yIdx;
+	BOOL valid;
+	BOOL updated;
+	BYTE level;
+	BYTE* data;
+} PROGRESSIVE_ENCODER_TILE;
+
+typedef struct
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 gridWidth;
+	UINT32 gridHeight;
+	UINT32 gridSize;
+	UINT32 upgradeIndex;
+	UINT32 frameIndex;
+	PROGRESSIVE_ENCODER_TILE* tiles;
+	wStream* tileData;
+	BYTE* buffer;
+} PROGRESSIVE_ENCODER_CONTEXT;
+
 typedef enum
 {
 	FLAG_WBT_SYNC = 0x01,
@@ -211,6 +237,7 @@ struct S_PROGRESSIVE_CONTEXT
 	BOOL Compressor;
 
 	wBufferPool* bufferPool;
+	PARALLEL_FOR* parallel;
 
 	UINT32 format;
 	UINT32 state;
@@ -224,6 +251,7 @@ struct S_PROGRESSIVE_CONTEXT
 	wStream* buffer;
 	wStream* rects;
 	RFX_CONTEXT* rfx_context;
+	PROGRESSIVE_ENCODER_CONTEXT encoder;
 };
 
 #endif /* INTERNAL_CODEC_PROGRESSIVE_H */
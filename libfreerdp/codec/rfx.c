@@ -48,6 +48,7 @@
 #include "rfx_dwt.h"
 #include "rfx_rlgr.h"
 
+#include "rfx_avx2.h"
 #include "rfx_sse2.h"
 #include "rfx_neon.h"
 
@@ -335,6 +336,11 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 			SetThreadpoolThreadMaximum(priv->ThreadPool, priv->MaxThreadCount);
 	}
 
+	/* every tile needs a coefficient and a DWT scratch buffer */
+	if (!(priv->ParallelFor =
+	          parallel_for_new(priv->UseThreads, &priv->ThreadPoolEnv, priv->BufferPool, 2)))
+		goto fail;
+
 	/* initialize the default pixel format */
 	rfx_context_set_pixel_format(context, PIXEL_FORMAT_BGRX32);
 	/* create profilers for default decoding routines */
@@ -376,13 +382,12 @@ void rfx_context_free(RFX_CONTEXT* context)
 	if (priv)
 	{
 		ObjectPool_Free(priv->TilePool);
+		parallel_for_free(priv->ParallelFor);
 		if (priv->UseThreads)
 		{
 			if (priv->ThreadPool)
 				CloseThreadpool(priv->ThreadPool);
 			DestroyThreadpoolEnvironment(&priv->ThreadPoolEnv);
-			free(priv->workObjects);
-			free(priv->tileWorkParams);
 #ifdef WITH_PROFILER
 		WLog_VRB(TAG,
 		         "WARNING: Profiling results probably unusable with multithreaded RemoteFX codec!");
@@ -723,22 +728,23 @@ static BOOL rfx_process_message_region(RFX_CONTEXT* context, RFX_MESSAGE* messag
 
 typedef struct
 {
-	RFX_TILE* tile;
 	RFX_CONTEXT* context;
-} RFX_TILE_PROCESS_WORK_PARAM;
+	RFX_MESSAGE* message;
+} RFX_TILE_PROCESS_PARAM;
 
-static void CALLBACK rfx_process_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                            void* context, PTP_WORK work)
+static BOOL rfx_process_message_tile(void* arg, size_t index, BYTE** scratch)
 {
-	RFX_TILE_PROCESS_WORK_PARAM* param = (RFX_TILE_PROCESS_WORK_PARAM*)context;
-	rfx_decode_rgb(param->context, param->tile, param->tile->data, 64 * 4);
+	RFX_TILE_PROCESS_PARAM* param = (RFX_TILE_PROCESS_PARAM*)arg;
+	RFX_TILE* tile = param->message->tiles[index];
+	rfx_decode_rgb(param->context, tile, tile->data, 64 * 4, scratch[0], (INT16*)scratch[1]);
+	return TRUE;
 }
 
 static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* message, wStream* s,
                                         UINT16* pExpectedBlockType)
 {
 	BOOL rc;
-	int i, close_cnt;
+	int i;
 	BYTE quant;
 	RFX_TILE* tile;
 	RFX_TILE** tmpTiles;
@@ -747,8 +753,6 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 	UINT32 blockLen;
 	UINT32 blockType;
 	UINT32 tilesDataSize;
-	PTP_WORK* work_objects = NULL;
-	RFX_TILE_PROCESS_WORK_PARAM* params = NULL;
 	void* pmem;
 
 	if (*pExpectedBlockType != WBT_EXTENSION)
@@ -839,27 +843,7 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 	message->tiles = tmpTiles;
 	message->numTiles = numTiles;
 
-	if (context->priv->UseThreads)
-	{
-		work_objects = (PTP_WORK*)calloc(message->numTiles, sizeof(PTP_WORK));
-		params = (RFX_TILE_PROCESS_WORK_PARAM*)calloc(message->numTiles,
-		                                              sizeof(RFX_TILE_PROCESS_WORK_PARAM));
-
-		if (!work_objects)
-		{
-			free(params);
-			return FALSE;
-		}
-
-		if (!params)
-		{
-			free(work_objects);
-			return FALSE;
-		}
-	}
-
 	/* tiles */
-	close_cnt = 0;
 	rc = FALSE;
 
 	if (Stream_GetRemainingLength(s) >= tilesDataSize)
@@ -944,49 +928,16 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 			}
 			tile->x = tile->xIdx * 64;
 			tile->y = tile->yIdx * 64;
-
-			if (context->priv->UseThreads)
-			{
-				if (!params)
-				{
-					rc = FALSE;
-					break;
-				}
-
-				params[i].context = context;
-				params[i].tile = message->tiles[i];
-
-				if (!(work_objects[i] =
-				          CreateThreadpoolWork(rfx_process_message_tile_work_callback,
-				                               (void*)&params[i], &context->priv->ThreadPoolEnv)))
-				{
-					WLog_ERR(TAG, "CreateThreadpoolWork failed.");
-					rc = FALSE;
-					break;
-				}
-
-				SubmitThreadpoolWork(work_objects[i]);
-				close_cnt = i + 1;
-			}
-			else
-			{
-				rfx_decode_rgb(context, tile, tile->data, 64 * 4);
-			}
 		}
 	}
 
-	if (context->priv->UseThreads)
+	if (rc)
 	{
-		for (i = 0; i < close_cnt; i++)
-		{
-			WaitForThreadpoolWorkCallbacks(work_objects[i], FALSE);
-			CloseThreadpoolWork(work_objects[i]);
-		}
+		RFX_TILE_PROCESS_PARAM param = { context, message };
+		rc = parallel_for_run(context->priv->ParallelFor, message->numTiles, 1,
+		                      rfx_process_message_tile, &param);
 	}
 
-	free(work_objects);
-	free(params);
-
 	for (i = 0; i < message->numTiles; i++)
 	{
 		if (!(tile = message->tiles[i]))
@@ -1362,17 +1313,11 @@ static BOOL rfx_write_tile(RFX_CONTEXT* context, wStream* s, RFX_TILE* tile)
 	return TRUE;
 }
 
-struct S_RFX_TILE_COMPOSE_WORK_PARAM
+static BOOL rfx_compose_message_tile(void* arg, size_t index, BYTE** scratch)
 {
-	RFX_TILE* tile;
-	RFX_CONTEXT* context;
-};
-
-static void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                            void* context, PTP_WORK work)
-{
-	RFX_TILE_COMPOSE_WORK_PARAM* param = (RFX_TILE_COMPOSE_WORK_PARAM*)context;
-	rfx_encode_rgb(param->context, param->tile);
+	RFX_TILE_PROCESS_PARAM* param = (RFX_TILE_PROCESS_PARAM*)arg;
+	rfx_encode_rgb(param->context, param->message->tiles[index], scratch[0], (INT16*)scratch[1]);
+	return TRUE;
 }
 
 static BOOL computeRegion(const RFX_RECT* rects, int numRects, REGION16* region, int width,
@@ -1399,27 +1344,6 @@ static BOOL computeRegion(const RFX_RECT* rects, int numRects, REGION16* region,
 
 #define TILE_NO(v) ((v) / 64)
 
-static BOOL setupWorkers(RFX_CONTEXT* context, int nbTiles)
-{
-	RFX_CONTEXT_PRIV* priv = context->priv;
-	void* pmem;
-
-	if (!context->priv->UseThreads)
-		return TRUE;
-
-	if (!(pmem = realloc((void*)priv->workObjects, sizeof(PTP_WORK) * nbTiles)))
-		return FALSE;
-
-	priv->workObjects = (PTP_WORK*)pmem;
-
-	if (!(pmem =
-	          realloc((void*)priv->tileWorkParams, sizeof(RFX_TILE_COMPOSE_WORK_PARAM) * nbTiles)))
-		return FALSE;
-
-	priv->tileWorkParams = (RFX_TILE_COMPOSE_WORK_PARAM*)pmem;
-	return TRUE;
-}
-
 RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, size_t numRects,
                                 const BYTE* data, UINT32 w, UINT32 h, size_t s)
 {
@@ -1432,8 +1356,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, siz
 	RFX_TILE* tile;
 	RFX_RECT* rfxRect;
 	RFX_MESSAGE* message = NULL;
-	PTP_WORK* workObject = NULL;
-	RFX_TILE_COMPOSE_WORK_PARAM* workParam = NULL;
 	BOOL success = FALSE;
 	REGION16 rectsRegion, tilesRegion;
 	RECTANGLE_16 currentTileRect;
@@ -1487,15 +1409,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, siz
 	if (!(message->tiles = calloc(maxNbTiles, sizeof(RFX_TILE*))))
 		goto skip_encoding_loop;
 
-	if (!setupWorkers(context, maxNbTiles))
-		goto skip_encoding_loop;
-
-	if (context->priv->UseThreads)
-	{
-		workObject = context->priv->workObjects;
-		workParam = context->priv->tileWorkParams;
-	}
-
 	regionRect = region16_rects(&rectsRegion, &regionNbRects);
 
 	if (!(message->rects = calloc(regionNbRects, sizeof(RFX_RECT))))
@@ -1581,34 +1494,18 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, siz
 				message->tiles[message->numTiles] = tile;
 				message->numTiles++;
 
-				if (context->priv->UseThreads)
-				{
-					workParam->context = context;
-					workParam->tile = tile;
-
-					if (!(*workObject = CreateThreadpoolWork(rfx_compose_message_tile_work_callback,
-					                                         (void*)workParam,
-					                                         &context->priv->ThreadPoolEnv)))
-					{
-						goto skip_encoding_loop;
-					}
-
-					SubmitThreadpoolWork(*workObject);
-					workObject++;
-					workParam++;
-				}
-				else
-				{
-					rfx_encode_rgb(context, tile);
-				}
-
 				if (!region16_union_rect(&tilesRegion, &tilesRegion, &currentTileRect))
 					goto skip_encoding_loop;
 			} /* xIdx */
 		}     /* yIdx */
 	}         /* rects */
 
-	success = TRUE;
+	{
+		RFX_TILE_PROCESS_PARAM param = { context, message };
+		success = parallel_for_run(context->priv->ParallelFor, message->numTiles, 1,
+		                           rfx_compose_message_tile, &param);
+	}
+
 skip_encoding_loop:
 
 	if (success && message->numTiles != maxNbTiles)
@@ -1626,29 +1523,12 @@ skip_encoding_loop:
 			success = FALSE;
 	}
 
-	/* when using threads ensure all computations are done */
 	if (success)
 	{
 		message->tilesDataSize = 0;
-		workObject = context->priv->workObjects;
 
 		for (i = 0; i < message->numTiles; i++)
-		{
-			tile = message->tiles[i];
-
-			if (context->priv->UseThreads)
-			{
-				if (*workObject)
-				{
-					WaitForThreadpoolWorkCallbacks(*workObject, FALSE);
-					CloseThreadpoolWork(*workObject);
-				}
-
-				workObject++;
-			}
-
-			message->tilesDataSize += rfx_tile_length(tile);
-		}
+			message->tilesDataSize += rfx_tile_length(message->tiles[i]);
 
 		region16_uninit(&tilesRegion);
 		region16_uninit(&rectsRegion);
@@ -1842,6 +1722,13 @@ static BOOL rfx_write_message_frame_end(RFX_CONTEXT* context, wStream* s,
 	return TRUE;
 }
 
+BOOL rfx_write_message_header(RFX_CONTEXT* context, wStream* s)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(s);
+	return rfx_compose_message_header(context, s);
+}
+
 BOOL rfx_write_message(RFX_CONTEXT* context, wStream* s, const RFX_MESSAGE* message)
 {
 	if (context->state == RFX_STATE_SEND_HEADERS)
@@ -0,0 +1,434 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "rfx_types.h"
+#include "rfx_avx2.h"
+
+/* The arithmetic is identical to rfx_sse2.c, 16 coefficients per register.
+ * The neighbour lookups at the subband borders are built from registers
+ * instead of unaligned loads so nothing outside the tile buffer is touched. */
+
+/* [prev15, v0 .. v14] */
+static INLINE __m256i avx2_shift_in_left(__m256i v, __m256i prev)
+{
+	return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(prev, v, 0x21), 14);
+}
+
+/* [v1 .. v15, next0] */
+static INLINE __m256i avx2_shift_in_right(__m256i v, __m256i next)
+{
+	return _mm256_alignr_epi8(_mm256_permute2x128_si256(v, next, 0x21), v, 2);
+}
+
+/* Interleave a and b and store the 32 results at dst */
+static INLINE void avx2_store_interleaved(INT16* dst, __m256i a, __m256i b)
+{
+	const __m256i lo = _mm256_unpacklo_epi16(a, b);
+	const __m256i hi = _mm256_unpackhi_epi16(a, b);
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*)(dst + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+/* Split 32 values at src into the even and the odd ones. For 8 wide subbands
+ * this splits two rows of 16 with the result lanes holding one row each. */
+static INLINE void avx2_deinterleave(const INT16* src, __m256i* even, __m256i* odd)
+{
+	const __m256i mask = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15, 0,
+	                                      1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+	__m256i a = _mm256_loadu_si256((const __m256i*)src);
+	__m256i b = _mm256_loadu_si256((const __m256i*)(src + 16));
+	a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(a, mask), 0xD8);
+	b = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(b, mask), 0xD8);
+	*even = _mm256_permute2x128_si256(a, b, 0x20);
+	*odd = _mm256_permute2x128_si256(a, b, 0x31);
+}
+
+static INLINE void rfx_quantization_decode_block_avx2(INT16* buffer, const int buffer_size,
+                                                      const UINT32 factor)
+{
+	__m256i* ptr = (__m256i*)buffer;
+	__m256i* buf_end = (__m256i*)(buffer + buffer_size);
+
+	if (factor == 0)
+		return;
+
+	do
+	{
+		const __m256i a = _mm256_loadu_si256(ptr);
+		_mm256_storeu_si256(ptr, _mm256_slli_epi16(a, factor));
+		ptr++;
+	} while (ptr < buf_end);
+}
+
+static void rfx_quantization_decode_avx2(INT16* buffer, const UINT32* quantVals)
+{
+	rfx_quantization_decode_block_avx2(&buffer[0], 1024, quantVals[8] - 1);    /* HL1 */
+	rfx_quantization_decode_block_avx2(&buffer[1024], 1024, quantVals[7] - 1); /* LH1 */
+	rfx_quantization_decode_block_avx2(&buffer[2048], 1024, quantVals[9] - 1); /* HH1 */
+	rfx_quantization_decode_block_avx2(&buffer[3072], 256, quantVals[5] - 1);  /* HL2 */
+	rfx_quantization_decode_block_avx2(&buffer[3328], 256, quantVals[4] - 1);  /* LH2 */
+	rfx_quantization_decode_block_avx2(&buffer[3584], 256, quantVals[6] - 1);  /* HH2 */
+	rfx_quantization_decode_block_avx2(&buffer[3840], 64, quantVals[2] - 1);   /* HL3 */
+	rfx_quantization_decode_block_avx2(&buffer[3904], 64, quantVals[1] - 1);   /* LH3 */
+	rfx_quantization_decode_block_avx2(&buffer[3968], 64, quantVals[3] - 1);   /* HH3 */
+	rfx_quantization_decode_block_avx2(&buffer[4032], 64, quantVals[0] - 1);   /* LL3 */
+}
+
+static INLINE void rfx_quantization_encode_block_avx2(INT16* buffer, const int buffer_size,
+                                                      const UINT32 factor)
+{
+	__m256i* ptr = (__m256i*)buffer;
+	__m256i* buf_end = (__m256i*)(buffer + buffer_size);
+	__m256i half;
+
+	if (factor == 0)
+		return;
+
+	half = _mm256_set1_epi16(1 << (factor - 1));
+
+	do
+	{
+		const __m256i a = _mm256_add_epi16(_mm256_loadu_si256(ptr), half);
+		_mm256_storeu_si256(ptr, _mm256_srai_epi16(a, factor));
+		ptr++;
+	} while (ptr < buf_end);
+}
+
+static void rfx_quantization_encode_avx2(INT16* buffer, const UINT32* quantization_values)
+{
+	rfx_quantization_encode_block_avx2(buffer, 1024, quantization_values[8] - 6);        /* HL1 */
+	rfx_quantization_encode_block_avx2(buffer + 1024, 1024, quantization_values[7] - 6); /* LH1 */
+	rfx_quantization_encode_block_avx2(buffer + 2048, 1024, quantization_values[9] - 6); /* HH1 */
+	rfx_quantization_encode_block_avx2(buffer + 3072, 256, quantization_values[5] - 6);  /* HL2 */
+	rfx_quantization_encode_block_avx2(buffer + 3328, 256, quantization_values[4] - 6);  /* LH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3584, 256, quantization_values[6] - 6);  /* HH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3840, 64, quantization_values[2] - 6);   /* HL3 */
+	rfx_quantization_encode_block_avx2(buffer + 3904, 64, quantization_values[1] - 6);   /* LH3 */
+	rfx_quantization_encode_block_avx2(buffer + 3968, 64, quantization_values[3] - 6);   /* HH3 */
+	rfx_quantization_encode_block_avx2(buffer + 4032, 64, quantization_values[0] - 6);   /* LL3 */
+	rfx_quantization_encode_block_avx2(buffer, 4096, 5);
+}
+
+/* 8 wide subbands, two rows per register, one row per 128 bit lane */
+static INLINE void rfx_dwt_2d_decode_block_horiz8_avx2(INT16* l, INT16* h, INT16* dst)
+{
+	int y;
+	const __m256i one = _mm256_set1_epi16(1);
+
+	for (y = 0; y < 8; y += 2)
+	{
+		/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); h[-1] = h[0] */
+		const __m256i l_n = _mm256_loadu_si256((const __m256i*)l);
+		const __m256i h_n = _mm256_loadu_si256((const __m256i*)h);
+		const __m256i h_n_m = _mm256_blend_epi16(_mm256_slli_si256(h_n, 2), h_n, 0x01);
+		__m256i tmp_n = _mm256_add_epi16(_mm256_add_epi16(h_n, h_n_m), one);
+		const __m256i dst_n = _mm256_sub_epi16(l_n, _mm256_srai_epi16(tmp_n, 1));
+		/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); dst[16] = dst[14] */
+		const __m256i dst_n_p = _mm256_blend_epi16(_mm256_srli_si256(dst_n, 2), dst_n, 0x80);
+		tmp_n = _mm256_srai_epi16(_mm256_add_epi16(dst_n, dst_n_p), 1);
+		tmp_n = _mm256_add_epi16(tmp_n, _mm256_slli_epi16(h_n, 1));
+		avx2_store_interleaved(dst, dst_n, tmp_n);
+		l += 16;
+		h += 16;
+		dst += 32;
+	}
+}
+
+static INLINE void rfx_dwt_2d_decode_block_horiz_avx2(INT16* l, INT16* h, INT16* dst,
+                                                      int subband_width)
+{
+	int y, n;
+	const __m256i one = _mm256_set1_epi16(1);
+
+	if (subband_width == 8)
+	{
+		rfx_dwt_2d_decode_block_horiz8_avx2(l, h, dst);
+		return;
+	}
+
+	for (y = 0; y < subband_width; y++)
+	{
+		__m256i h_prev = _mm256_setzero_si256();
+
+		/* Even coefficients, computed in place in l */
+		for (n = 0; n < subband_width; n += 16)
+		{
+			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+			const __m256i l_n = _mm256_loadu_si256((const __m256i*)&l[n]);
+			const __m256i h_n = _mm256_loadu_si256((const __m256i*)&h[n]);
+			__m256i tmp_n;
+
+			if (n == 0)
+				h_prev = _mm256_broadcastw_epi16(_mm256_castsi256_si128(h_n));
+
+			tmp_n = _mm256_add_epi16(h_n, avx2_shift_in_left(h_n, h_prev));
+			tmp_n = _mm256_srai_epi16(_mm256_add_epi16(tmp_n, one), 1);
+			_mm256_storeu_si256((__m256i*)&l[n], _mm256_sub_epi16(l_n, tmp_n));
+			h_prev = h_n;
+		}
+
+		/* Odd coefficients */
+		for (n = 0; n < subband_width; n += 16)
+		{
+			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+			const __m256i h_n = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)&h[n]), 1);
+			const __m256i dst_n = _mm256_loadu_si256((const __m256i*)&l[n]);
+			const __m256i next = (n == subband_width - 16)
+			                         ? _mm256_set1_epi16(l[n + 15])
+			                         : _mm256_loadu_si256((const __m256i*)&l[n + 16]);
+			__m256i tmp_n = _mm256_add_epi16(dst_n, avx2_shift_in_right(dst_n, next));
+			tmp_n = _mm256_add_epi16(_mm256_srai_epi16(tmp_n, 1), h_n);
+			avx2_store_interleaved(&dst[2 * n], dst_n, tmp_n);
+		}
+
+		l += subband_width;
+		h += subband_width;
+		dst += 2 * subband_width;
+	}
+}
+
+static INLINE void rfx_dwt_2d_decode_block_vert_avx2(INT16* l, INT16* h, INT16* dst,
+                                                     int subband_width)
+{
+	int x, n;
+	INT16* l_ptr = l;
+	INT16* h_ptr = h;
+	INT16* dst_ptr = dst;
+	const int total_width = subband_width + subband_width;
+	const __m256i one = _mm256_set1_epi16(1);
+
+	/* Even coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+			const __m256i l_n = _mm256_loadu_si256((const __m256i*)l_ptr);
+			const __m256i h_n = _mm256_loadu_si256((const __m256i*)h_ptr);
+			const __m256i h_n_m =
+			    (n == 0) ? h_n : _mm256_loadu_si256((const __m256i*)(h_ptr - total_width));
+			__m256i tmp_n = _mm256_add_epi16(_mm256_add_epi16(h_n, one), h_n_m);
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+			_mm256_storeu_si256((__m256i*)dst_ptr, _mm256_sub_epi16(l_n, tmp_n));
+			l_ptr += 16;
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+
+		dst_ptr += total_width;
+	}
+
+	h_ptr = h;
+	dst_ptr = dst + total_width;
+
+	/* Odd coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+			const __m256i h_n = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)h_ptr), 1);
+			const __m256i dst_n_m = _mm256_loadu_si256((const __m256i*)(dst_ptr - total_width));
+			const __m256i dst_n_p =
+			    (n == subband_width - 1)
+			        ? dst_n_m
+			        : _mm256_loadu_si256((const __m256i*)(dst_ptr + total_width));
+			__m256i tmp_n = _mm256_srai_epi16(_mm256_add_epi16(dst_n_m, dst_n_p), 1);
+			_mm256_storeu_si256((__m256i*)dst_ptr, _mm256_add_epi16(tmp_n, h_n));
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+
+		dst_ptr += total_width;
+	}
+}
+
+static INLINE void rfx_dwt_2d_decode_block_avx2(INT16* buffer, INT16* idwt, int subband_width)
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_dst, *h_dst;
+	/* Inverse DWT in horizontal direction, results in 2 sub-bands in L, H order in tmp buffer idwt.
+	 */
+	/* The 4 sub-bands are stored in HL(0), LH(1), HH(2), LL(3) order. */
+	/* The lower part L uses LL(3) and HL(0). */
+	/* The higher part H uses LH(1) and HH(2). */
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	l_dst = idwt;
+	rfx_dwt_2d_decode_block_horiz_avx2(ll, hl, l_dst, subband_width);
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+	h_dst = idwt + subband_width * subband_width * 2;
+	rfx_dwt_2d_decode_block_horiz_avx2(lh, hh, h_dst, subband_width);
+	/* Inverse DWT in vertical direction, results are stored in original buffer. */
+	rfx_dwt_2d_decode_block_vert_avx2(l_dst, h_dst, buffer, subband_width);
+}
+
+static void rfx_dwt_2d_decode_avx2(INT16* buffer, INT16* dwt_buffer)
+{
+	rfx_dwt_2d_decode_block_avx2(&buffer[3840], dwt_buffer, 8);
+	rfx_dwt_2d_decode_block_avx2(&buffer[3072], dwt_buffer, 16);
+	rfx_dwt_2d_decode_block_avx2(&buffer[0], dwt_buffer, 32);
+}
+
+static INLINE void rfx_dwt_2d_encode_block_vert_avx2(INT16* src, INT16* l, INT16* h,
+                                                     int subband_width)
+{
+	int x, n;
+	const int total_width = subband_width << 1;
+
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			const __m256i src_2n = _mm256_loadu_si256((const __m256i*)src);
+			const __m256i src_2n_1 = _mm256_loadu_si256((const __m256i*)(src + total_width));
+			const __m256i src_2n_2 =
+			    (n < subband_width - 1)
+			        ? _mm256_loadu_si256((const __m256i*)(src + 2 * total_width))
+			        : src_2n;
+			__m256i h_n, h_n_m, l_n;
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			h_n = _mm256_srai_epi16(_mm256_add_epi16(src_2n, src_2n_2), 1);
+			h_n = _mm256_srai_epi16(_mm256_sub_epi16(src_2n_1, h_n), 1);
+			_mm256_storeu_si256((__m256i*)h, h_n);
+			h_n_m = (n == 0) ? h_n : _mm256_loadu_si256((const __m256i*)(h - total_width));
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			l_n = _mm256_srai_epi16(_mm256_add_epi16(h_n_m, h_n), 1);
+			_mm256_storeu_si256((__m256i*)l, _mm256_add_epi16(l_n, src_2n));
+			src += 16;
+			l += 16;
+			h += 16;
+		}
+
+		src += total_width;
+	}
+}
+
+/* 8 wide subbands, two rows per register, one row per 128 bit lane */
+static INLINE void rfx_dwt_2d_encode_block_horiz8_avx2(INT16* src, INT16* l, INT16* h)
+{
+	int y;
+
+	for (y = 0; y < 8; y += 2)
+	{
+		__m256i src_2n, src_2n_1, src_2n_2, h_n, h_n_m, l_n;
+		avx2_deinterleave(src, &src_2n, &src_2n_1);
+		src_2n_2 = _mm256_blend_epi16(_mm256_srli_si256(src_2n, 2), src_2n, 0x80);
+		/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+		h_n = _mm256_srai_epi16(_mm256_add_epi16(src_2n, src_2n_2), 1);
+		h_n = _mm256_srai_epi16(_mm256_sub_epi16(src_2n_1, h_n), 1);
+		_mm256_storeu_si256((__m256i*)h, h_n);
+		/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+		h_n_m = _mm256_blend_epi16(_mm256_slli_si256(h_n, 2), h_n, 0x01);
+		l_n = _mm256_srai_epi16(_mm256_add_epi16(h_n_m, h_n), 1);
+		_mm256_storeu_si256((__m256i*)l, _mm256_add_epi16(l_n, src_2n));
+		src += 32;
+		l += 16;
+		h += 16;
+	}
+}
+
+static INLINE void rfx_dwt_2d_encode_block_horiz_avx2(INT16* src, INT16* l, INT16* h,
+                                                      int subband_width)
+{
+	int y, n;
+
+	if (subband_width == 8)
+	{
+		rfx_dwt_2d_encode_block_horiz8_avx2(src, l, h);
+		return;
+	}
+
+	for (y = 0; y < subband_width; y++)
+	{
+		__m256i h_prev = _mm256_setzero_si256();
+
+		for (n = 0; n < subband_width; n += 16)
+		{
+			__m256i src_2n, src_2n_1, src_2n_2, h_n, l_n;
+			const __m256i next = (n == subband_width - 16) ? _mm256_set1_epi16(src[30])
+			                                               : _mm256_set1_epi16(src[32]);
+			avx2_deinterleave(src, &src_2n, &src_2n_1);
+			src_2n_2 = avx2_shift_in_right(src_2n, next);
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			h_n = _mm256_srai_epi16(_mm256_add_epi16(src_2n, src_2n_2), 1);
+			h_n = _mm256_srai_epi16(_mm256_sub_epi16(src_2n_1, h_n), 1);
+			_mm256_storeu_si256((__m256i*)h, h_n);
+
+			if (n == 0)
+				h_prev = _mm256_broadcastw_epi16(_mm256_castsi256_si128(h_n));
+
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			l_n = _mm256_add_epi16(avx2_shift_in_left(h_n, h_prev), h_n);
+			l_n = _mm256_srai_epi16(l_n, 1);
+			_mm256_storeu_si256((__m256i*)l, _mm256_add_epi16(l_n, src_2n));
+			h_prev = h_n;
+			src += 32;
+			l += 16;
+			h += 16;
+		}
+	}
+}
+
+static INLINE void rfx_dwt_2d_encode_block_avx2(INT16* buffer, INT16* dwt, int subband_width)
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_src, *h_src;
+	/* DWT in vertical direction, results in 2 sub-bands in L, H order in tmp buffer dwt. */
+	l_src = dwt;
+	h_src = dwt + subband_width * subband_width * 2;
+	rfx_dwt_2d_encode_block_vert_avx2(buffer, l_src, h_src, subband_width);
+	/* DWT in horizontal direction, results in 4 sub-bands in HL(0), LH(1), HH(2), LL(3) order,
+	 * stored in original buffer. */
+	/* The lower part L generates LL(3) and HL(0). */
+	/* The higher part H generates LH(1) and HH(2). */
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+	rfx_dwt_2d_encode_block_horiz_avx2(l_src, ll, hl, subband_width);
+	rfx_dwt_2d_encode_block_horiz_avx2(h_src, lh, hh, subband_width);
+}
+
+static void rfx_dwt_2d_encode_avx2(INT16* buffer, INT16* dwt_buffer)
+{
+	rfx_dwt_2d_encode_block_avx2(buffer, dwt_buffer, 32);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3072, dwt_buffer, 16);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3840, dwt_buffer, 8);
+}
+
+void rfx_init_avx2(RFX_CONTEXT* context)
+{
+	if (!IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return;
+
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_decode, "rfx_quantization_decode_avx2")
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_encode, "rfx_quantization_encode_avx2")
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_decode, "rfx_dwt_2d_decode_avx2")
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_encode, "rfx_dwt_2d_encode_avx2")
+	context->quantization_decode = rfx_quantization_decode_avx2;
+	context->quantization_encode = rfx_quantization_encode_avx2;
+	context->dwt_2d_decode = rfx_dwt_2d_decode_avx2;
+	context->dwt_2d_encode = rfx_dwt_2d_encode_avx2;
+}
@@ -0,0 +1,41 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_RFX_AVX2_H
+#define FREERDP_LIB_CODEC_RFX_AVX2_H
+
+#include <freerdp/codec/rfx.h>
+#include <freerdp/api.h>
+
+#include "rfx_sse2.h"
+
+FREERDP_LOCAL void rfx_init_avx2(RFX_CONTEXT* context);
+
+/* The AVX2 routines are only installed if the CPU supports them, so keep
+ * the SSE2 ones as the baseline. rfx_sse2.h already defined the SSE2 only
+ * variant, replace it. */
+#ifdef WITH_SSE2
+#undef RFX_INIT_SIMD
+#define RFX_INIT_SIMD(_rfx_context)  \
+	do                               \
+	{                                \
+		rfx_init_sse2(_rfx_context); \
+		rfx_init_avx2(_rfx_context); \
+	} while (0)
+#endif
+
+#endif /* FREERDP_LIB_CODEC_RFX_AVX2_H */
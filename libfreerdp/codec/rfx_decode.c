@@ -36,10 +36,8 @@
 #include "rfx_decode.h"
 
 void rfx_decode_component(RFX_CONTEXT* context, const UINT32* quantization_values, const BYTE* data,
-                          int size, INT16* buffer)
+                          int size, INT16* buffer, INT16* dwt_buffer)
 {
-	INT16* dwt_buffer;
-	dwt_buffer = BufferPool_Take(context->priv->BufferPool, -1); /* dwt_buffer */
 	PROFILER_ENTER(context->priv->prof_rfx_decode_component)
 	PROFILER_ENTER(context->priv->prof_rfx_rlgr_decode)
 	context->rlgr_decode(context->mode, data, size, buffer, 4096);
@@ -54,13 +52,13 @@ void rfx_decode_component(RFX_CONTEXT* context, const UINT32* quantization_value
 	context->dwt_2d_decode(buffer, dwt_buffer);
 	PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_decode)
 	PROFILER_EXIT(context->priv->prof_rfx_decode_component)
-	BufferPool_Return(context->priv->BufferPool, dwt_buffer);
 }
 
 /* rfx_decode_ycbcr_to_rgb code now resides in the primitives library. */
 
 /* stride is bytes between rows in the output buffer. */
-BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer, UINT32 stride)
+BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer, UINT32 stride,
+                    BYTE* pBuffer, INT16* dwt_buffer)
 {
 	union
 	{
@@ -68,7 +66,6 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer
 		INT16** pv;
 	} cnv;
 	BOOL rc = TRUE;
-	BYTE* pBuffer;
 	INT16* pSrcDst[3];
 	UINT32 *y_quants, *cb_quants, *cr_quants;
 	static const prim_size_t roi_64x64 = { 64, 64 };
@@ -77,13 +74,15 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer
 	y_quants = context->quants + (tile->quantIdxY * 10);
 	cb_quants = context->quants + (tile->quantIdxCb * 10);
 	cr_quants = context->quants + (tile->quantIdxCr * 10);
-	pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1);
 	pSrcDst[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16]));             /* y_r_buffer */
 	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16]));             /* cb_g_buffer */
 	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16]));             /* cr_b_buffer */
-	rfx_decode_component(context, y_quants, tile->YData, tile->YLen, pSrcDst[0]); /* YData */
-	rfx_decode_component(context, cb_quants, tile->CbData, tile->CbLen, pSrcDst[1]); /* CbData */
-	rfx_decode_component(context, cr_quants, tile->CrData, tile->CrLen, pSrcDst[2]); /* CrData */
+	rfx_decode_component(context, y_quants, tile->YData, tile->YLen, pSrcDst[0],
+	                     dwt_buffer); /* YData */
+	rfx_decode_component(context, cb_quants, tile->CbData, tile->CbLen, pSrcDst[1],
+	                     dwt_buffer); /* CbData */
+	rfx_decode_component(context, cr_quants, tile->CrData, tile->CrLen, pSrcDst[2],
+	                     dwt_buffer); /* CrData */
 	PROFILER_ENTER(context->priv->prof_rfx_ycbcr_to_rgb)
 
 	cnv.pv = pSrcDst;
@@ -93,6 +92,5 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer
 
 	PROFILER_EXIT(context->priv->prof_rfx_ycbcr_to_rgb)
 	PROFILER_EXIT(context->priv->prof_rfx_decode_rgb)
-	BufferPool_Return(context->priv->BufferPool, pBuffer);
 	return rc;
 }
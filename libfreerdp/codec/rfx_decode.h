@@ -23,9 +23,11 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
-/* stride is bytes between rows in the output buffer. */
+/* stride is bytes between rows in the output buffer.
+ * pBuffer and dwt_buffer are scratch buffers taken from the context BufferPool. */
 FREERDP_LOCAL BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer,
-                                  UINT32 stride);
+                                  UINT32 stride, BYTE* pBuffer, INT16* dwt_buffer);
 FREERDP_LOCAL void rfx_decode_component(RFX_CONTEXT* context, const UINT32* quantization_values,
-                                        const BYTE* data, int size, INT16* buffer);
+                                        const BYTE* data, int size, INT16* buffer,
+                                        INT16* dwt_buffer);
 #endif /* FREERDP_LIB_CODEC_RFX_DECODE_H */
@@ -231,10 +231,9 @@ static void rfx_encode_format_rgb(const BYTE* rgb_data, int width, int height, i
 /* rfx_encode_rgb_to_ycbcr code now resides in the primitives library. */
 
 static void rfx_encode_component(RFX_CONTEXT* context, const UINT32* quantization_values,
-                                 INT16* data, BYTE* buffer, int buffer_size, int* size)
+                                 INT16* data, BYTE* buffer, int buffer_size, int* size,
+                                 INT16* dwt_buffer)
 {
-	INT16* dwt_buffer;
-	dwt_buffer = BufferPool_Take(context->priv->BufferPool, -1); /* dwt_buffer */
 	PROFILER_ENTER(context->priv->prof_rfx_encode_component)
 	PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_encode)
 	context->dwt_2d_encode(data, dwt_buffer);
@@ -249,26 +248,21 @@ static void rfx_encode_component(RFX_CONTEXT* context, const UINT32* quantizatio
 	*size = context->rlgr_encode(context->mode, data, 4096, buffer, buffer_size);
 	PROFILER_EXIT(context->priv->prof_rfx_rlgr_encode)
 	PROFILER_EXIT(context->priv->prof_rfx_encode_component)
-	BufferPool_Return(context->priv->BufferPool, dwt_buffer);
 }
 
-void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile)
+void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile, BYTE* pBuffer, INT16* dwt_buffer)
 {
 	union
 	{
 		const INT16** cpv;
 		INT16** pv;
 	} cnv;
-	BYTE* pBuffer;
 	INT16* pSrcDst[3];
 	int YLen, CbLen, CrLen;
 	UINT32 *YQuant, *CbQuant, *CrQuant;
 	primitives_t* prims = primitives_get();
 	static const prim_size_t roi_64x64 = { 64, 64 };
 
-	if (!(pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1)))
-		return;
-
 	YLen = CbLen = CrLen = 0;
 	YQuant = context->quants + (tile->quantIdxY * 10);
 	CbQuant = context->quants + (tile->quantIdxCb * 10);
@@ -295,12 +289,11 @@ void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile)
 	ZeroMemory(tile->YData, 4096);
 	ZeroMemory(tile->CbData, 4096);
 	ZeroMemory(tile->CrData, 4096);
-	rfx_encode_component(context, YQuant, pSrcDst[0], tile->YData, 4096, &YLen);
-	rfx_encode_component(context, CbQuant, pSrcDst[1], tile->CbData, 4096, &CbLen);
-	rfx_encode_component(context, CrQuant, pSrcDst[2], tile->CrData, 4096, &CrLen);
+	rfx_encode_component(context, YQuant, pSrcDst[0], tile->YData, 4096, &YLen, dwt_buffer);
+	rfx_encode_component(context, CbQuant, pSrcDst[1], tile->CbData, 4096, &CbLen, dwt_buffer);
+	rfx_encode_component(context, CrQuant, pSrcDst[2], tile->CrData, 4096, &CrLen, dwt_buffer);
 	tile->YLen = (UINT16)YLen;
 	tile->CbLen = (UINT16)CbLen;
 	tile->CrLen = (UINT16)CrLen;
 	PROFILER_EXIT(context->priv->prof_rfx_encode_rgb)
-	BufferPool_Return(context->priv->BufferPool, pBuffer);
 }
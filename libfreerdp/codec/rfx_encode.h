@@ -23,6 +23,8 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
-FREERDP_LOCAL void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile);
+/* pBuffer and dwt_buffer are scratch buffers taken from the context BufferPool. */
+FREERDP_LOCAL void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile, BYTE* pBuffer,
+                                  INT16* dwt_buffer);
 
 #endif /* FREERDP_LIB_CODEC_RFX_ENCODE_H */
@@ -30,6 +30,8 @@
 #include <freerdp/log.h>
 #include <freerdp/utils/profiler.h>
 
+#include "parallel.h"
+
 #define RFX_TAG FREERDP_TAG("codec.rfx")
 #ifdef WITH_DEBUG_RFX
 #define DEBUG_RFX(...) WLog_DBG(RFX_TAG, __VA_ARGS__)
@@ -40,16 +42,13 @@
 	} while (0)
 #endif
 
-typedef struct S_RFX_TILE_COMPOSE_WORK_PARAM RFX_TILE_COMPOSE_WORK_PARAM;
-
 struct S_RFX_CONTEXT_PRIV
 {
 	wLog* log;
 	wObjectPool* TilePool;
 
 	BOOL UseThreads;
-	PTP_WORK* workObjects;
-	RFX_TILE_COMPOSE_WORK_PARAM* tileWorkParams;
+	PARALLEL_FOR* ParallelFor;
 
 	DWORD MinThreadCount;
 	DWORD MaxThreadCount;
@@ -71,6 +71,139 @@ fail:
 	return rc;
 }
 
+/* Renders window like content: a flat background, title bar and pseudo text lines. */
+static void test_ClearFillScreen(BYTE* pData, UINT32 width, UINT32 height, UINT32 scroll,
+                                 BOOL gradient)
+{
+	for (UINT32 y = 0; y < height; y++)
+	{
+		UINT32* line = (UINT32*)&pData[4ull * y * width];
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const UINT32 ty = y + scroll;
+			UINT32 color = 0xFFF0F0F0;
+
+			if (y < 24)
+				color = 0xFF3050A0;
+			else if (((ty % 16) < 11) && (x > 8) && (x < width - 8) &&
+			         (((x * 7 + (ty / 16) * 13) % 11) < 4))
+				color = ((x + ty) % 3) ? 0xFF000000 : 0xFF808080;
+			else if (gradient && (x >= width / 2))
+				color = 0xFF000000 | ((x * 255 / width) << 16) | ((y * 255 / height) << 8) |
+				        ((x * y) & 0xFF);
+
+			line[x] = color;
+		}
+	}
+}
+
+static BOOL test_ClearCompressFrame(CLEAR_CONTEXT* encoder, CLEAR_CONTEXT* decoder,
+                                    const BYTE* pSrcData, UINT32 width, UINT32 height,
+                                    BOOL lossless, UINT32* pDstSize)
+{
+	BOOL rc = FALSE;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	BYTE* pOutData = calloc(width * height, 4);
+
+	if (!pOutData)
+		return FALSE;
+
+	if (clear_compress(encoder, pSrcData, width * height * 4, PIXEL_FORMAT_BGRX32, width, height,
+	                   width * 4, &pDstData, &DstSize) < 0)
+		goto fail;
+
+	if (clear_decompress(decoder, pDstData, DstSize, width, height, pOutData, PIXEL_FORMAT_BGRX32,
+	                     width * 4, 0, 0, width, height, NULL) < 0)
+		goto fail;
+
+	for (UINT32 i = 0; lossless && (i < width * height); i++)
+	{
+		const UINT32 expected = ((const UINT32*)pSrcData)[i] & 0x00FFFFFF;
+		const UINT32 actual = ((const UINT32*)pOutData)[i] & 0x00FFFFFF;
+
+		if (expected != actual)
+		{
+			printf("clear round trip mismatch at %" PRIu32 ",%" PRIu32 ": %08" PRIx32
+			       " != %08" PRIx32 "\n",
+			       i % width, i / width, actual, expected);
+			goto fail;
+		}
+	}
+
+	*pDstSize = DstSize;
+	rc = TRUE;
+fail:
+	free(pOutData);
+	return rc;
+}
+
+static BOOL test_ClearCompressRoundTrip(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 333;
+	const UINT32 height = 211;
+	UINT32 size = 0;
+	UINT32 scrolled = 0;
+	UINT32 glyphSize = 0;
+	BYTE* pSrcData = calloc(width * height, 4);
+	CLEAR_CONTEXT* encoder = clear_context_new(TRUE);
+	CLEAR_CONTEXT* decoder = clear_context_new(FALSE);
+
+	if (!pSrcData || !encoder || !decoder)
+		goto fail;
+
+	test_ClearFillScreen(pSrcData, width, height, 0, FALSE);
+
+	if (!test_ClearCompressFrame(encoder, decoder, pSrcData, width, height, TRUE, &size))
+		goto fail;
+
+	/* Scrolled text should mostly be served from the vbar caches */
+	test_ClearFillScreen(pSrcData, width, height, 16, FALSE);
+
+	if (!test_ClearCompressFrame(encoder, decoder, pSrcData, width, height, TRUE, &scrolled))
+		goto fail;
+
+	printf("clear_compress %" PRIu32 "x%" PRIu32 ": %" PRIu32 " bytes, scrolled %" PRIu32
+	       " bytes\n",
+	       width, height, size, scrolled);
+
+	if (scrolled >= size)
+		goto fail;
+
+	/* Small surfaces go to the glyph cache, the second time they are a cache hit */
+	for (UINT32 i = 0; i < 2; i++)
+	{
+		if (!test_ClearCompressFrame(encoder, decoder, pSrcData, 20, 20, TRUE, &glyphSize))
+			goto fail;
+	}
+
+	if (glyphSize != 4)
+		goto fail;
+
+	/* Photo like content may be encoded lossy with NSCodec */
+	test_ClearFillScreen(pSrcData, width, height, 0, TRUE);
+
+	if (!test_ClearCompressFrame(encoder, decoder, pSrcData, width, height, FALSE, &size))
+		goto fail;
+
+	if (!clear_context_reset(encoder) || !clear_context_reset(decoder))
+		goto fail;
+
+	test_ClearFillScreen(pSrcData, width, height, 32, FALSE);
+
+	if (!test_ClearCompressFrame(encoder, decoder, pSrcData, width, height, TRUE, &size))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	clear_context_free(encoder);
+	clear_context_free(decoder);
+	free(pSrcData);
+	return rc;
+}
+
 int TestFreeRDPCodecClear(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -90,5 +223,8 @@ int TestFreeRDPCodecClear(int argc, char* argv[])
 	if (!test_ClearDecompressExample(4, 7, 15, TEST_CLEAR_EXAMPLE_4, sizeof(TEST_CLEAR_EXAMPLE_4)))
 		return -1;
 
+	if (!test_ClearCompressRoundTrip())
+		return -1;
+
 	return 0;
 }
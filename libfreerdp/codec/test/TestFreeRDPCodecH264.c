@@ -0,0 +1,116 @@
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/codec/h264.h>
+
+#include "../h264.h"
+#include "../h264_sse2.h"
+
+typedef BOOL (*pfnTileEqual)(const BYTE* pData1, const BYTE* pData2, UINT32 nStep, UINT32 nWidth,
+                             UINT32 nHeight);
+
+/* Compares tile against the generic version and the expected result */
+static BOOL check_tile_equal(const char* name, pfnTileEqual fkt, const BYTE* pData1,
+                             const BYTE* pData2, UINT32 nStep, UINT32 nWidth, UINT32 nHeight,
+                             BOOL expected)
+{
+	const BOOL generic = h264_tile_equal_c(pData1, pData2, nStep, nWidth, nHeight);
+	const BOOL optimized = fkt(pData1, pData2, nStep, nWidth, nHeight);
+
+	if ((generic == expected) && (optimized == expected))
+		return TRUE;
+
+	fprintf(stderr,
+	        "TileEqual %s mismatch at width %" PRIu32 " height %" PRIu32 ": generic %d, %s %d, "
+	        "expected %d\n",
+	        name, nWidth, nHeight, generic, name, optimized, expected);
+	return FALSE;
+}
+
+/* Odd widths and every position of the tail that is not covered by 64 byte blocks */
+static BOOL test_tile_equal(const char* name, pfnTileEqual fkt)
+{
+	BOOL rc = FALSE;
+	size_t w, h;
+	const UINT32 widths[] = { 1, 3, 15, 16, 17, 63, 64, 65, 127, 128, 129, 191, 255, 256 };
+	const UINT32 heights[] = { 1, 3, 7 };
+	const UINT32 nStep = 256 + 13;
+	const size_t size = 1ull * nStep * 7;
+	BYTE* pData1 = malloc(size);
+	BYTE* pData2 = malloc(size);
+
+	if (!pData1 || !pData2)
+		goto fail;
+
+	for (w = 0; w < ARRAYSIZE(widths); w++)
+	{
+		for (h = 0; h < ARRAYSIZE(heights); h++)
+		{
+			UINT32 x;
+			const UINT32 nWidth = widths[w];
+			const UINT32 nHeight = heights[h];
+			const size_t last = 1ull * (nHeight - 1) * nStep;
+
+			winpr_RAND(pData1, size);
+			memcpy(pData2, pData1, size);
+
+			if (!check_tile_equal(name, fkt, pData1, pData2, nStep, nWidth, nHeight, TRUE))
+				goto fail;
+
+			/* Bytes past the tile width must not matter */
+			pData2[last + nWidth] ^= 0xFF;
+
+			if (!check_tile_equal(name, fkt, pData1, pData2, nStep, nWidth, nHeight, TRUE))
+				goto fail;
+
+			pData2[last + nWidth] = pData1[last + nWidth];
+
+			for (x = 0; x < nWidth; x++)
+			{
+				/* All tail columns, and the first byte of each 16 byte lane otherwise */
+				if ((x < nWidth / 64 * 64) && (x % 16 != 0))
+					continue;
+
+				pData2[last + x] ^= 0x01;
+
+				if (!check_tile_equal(name, fkt, pData1, pData2, nStep, nWidth, nHeight,
+				                      FALSE))
+					goto fail;
+
+				pData2[last + x] = pData1[last + x];
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(pData1);
+	free(pData2);
+	return rc;
+}
+
+int TestFreeRDPCodecH264(int argc, char* argv[])
+{
+	H264_CONTEXT h264 = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	h264.TileEqual = h264_tile_equal_c;
+
+	if (!test_tile_equal("generic", h264.TileEqual))
+		return -1;
+
+#if defined(WITH_SSE2)
+	h264_init_sse2(&h264);
+
+	if (h264.TileEqual == h264_tile_equal_c)
+		printf("SSE2 not available, skipping tier comparison\n");
+	else if (!test_tile_equal("sse2", h264.TileEqual))
+		return -1;
+#endif
+
+	return 0;
+}
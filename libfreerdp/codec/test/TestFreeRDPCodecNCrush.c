@@ -1,8 +1,11 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include "../ncrush.h"
 
+#include "codec_test.h"
+
 static const BYTE TEST_BELLS_DATA[] = "for.whom.the.bell.tolls,.the.bell.tolls.for.thee!";
 
 static const BYTE TEST_BELLS_NCRUSH[] =
@@ -107,10 +110,83 @@ fail:
 	return rc;
 }
 
+/* Round trips a packet stream, the speed is only reported when benchmarking */
+static BOOL test_NCrushStream(BOOL benchmark)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	size_t offset = 0;
+	size_t compressed = 0;
+	UINT64 start;
+	UINT64 compressTime = 0;
+	UINT64 decompressTime = 0;
+	CODEC_TEST_STREAM stream = { 0 };
+	BYTE* OutputBuffer = (BYTE*)malloc(65536);
+	NCRUSH_CONTEXT* compressor = ncrush_context_new(TRUE);
+	NCRUSH_CONTEXT* decompressor = ncrush_context_new(FALSE);
+
+	if (!codec_test_stream_init(&stream) || !OutputBuffer || !compressor || !decompressor)
+		goto fail;
+
+	for (x = 0; x < CODEC_TEST_STREAM_PACKETS; x++)
+	{
+		int status;
+		UINT32 Flags = 0;
+		UINT32 DstSize = 65536;
+		UINT32 PlainSize = 0;
+		const BYTE* pDstData = NULL;
+		const BYTE* pPlainData = NULL;
+		const BYTE* pSrcData = &stream.data[offset];
+
+		start = GetTickCount64();
+		status = ncrush_compress(compressor, pSrcData, stream.sizes[x], OutputBuffer, &pDstData, &DstSize,
+		                         &Flags);
+		compressTime += GetTickCount64() - start;
+
+		if (status < 0)
+		{
+			printf("NCrushStream: compression of packet %" PRIuz " failed\n", x);
+			goto fail;
+		}
+
+		start = GetTickCount64();
+		status = ncrush_decompress(decompressor, pDstData, DstSize, &pPlainData, &PlainSize, Flags);
+		decompressTime += GetTickCount64() - start;
+
+		if (status < 0)
+		{
+			printf("NCrushStream: decompression of packet %" PRIuz " failed\n", x);
+			goto fail;
+		}
+
+		if ((PlainSize != stream.sizes[x]) || (memcmp(pPlainData, pSrcData, PlainSize) != 0))
+		{
+			printf("NCrushStream: packet %" PRIuz " differs after decompression\n", x);
+			goto fail;
+		}
+
+		compressed += DstSize;
+		offset += stream.sizes[x];
+	}
+
+	if (benchmark)
+		printf("NCrushStream: %" PRIuz " bytes -> %" PRIuz " bytes, ratio %.3f, "
+		       "compress %.1f MB/s, decompress %.1f MB/s\n",
+		       stream.total, compressed, (double)compressed / (double)stream.total,
+		       codec_test_rate(stream.total, compressTime),
+		       codec_test_rate(stream.total, decompressTime));
+	rc = TRUE;
+fail:
+	ncrush_context_free(compressor);
+	ncrush_context_free(decompressor);
+	free(OutputBuffer);
+	codec_test_stream_uninit(&stream);
+	return rc;
+}
+
 int TestFreeRDPCodecNCrush(int argc, char* argv[])
 {
-	WINPR_UNUSED(argc);
-	WINPR_UNUSED(argv);
+	const BOOL benchmark = codec_test_benchmark_enabled(argc, argv);
 
 	if (!test_NCrushCompressBells())
 		return -1;
@@ -118,5 +194,8 @@ int TestFreeRDPCodecNCrush(int argc, char* argv[])
 	if (!test_NCrushDecompressBells())
 		return -1;
 
+	if (!test_NCrushStream(benchmark))
+		return -1;
+
 	return 0;
 }
@@ -1044,6 +1044,8 @@ static BOOL test_encode_decode(const char* path)
 	int x, y;
 	BOOL res = FALSE;
 	int rc;
+	UINT32 pass;
+	UINT64 lastError = UINT64_MAX;
 	BYTE* resultData = NULL;
 	BYTE* dstData = NULL;
 	UINT32 dstSize = 0;
@@ -1067,19 +1069,46 @@ static BOOL test_encode_decode(const char* path)
 	if (!resultData)
 		goto fail;
 
-	// Progressive encode
-	rc = progressive_compress(progressiveEnc, image->data, image->scanline * image->height,
-	                          ColorFormat, image->width, image->height, image->scanline, NULL,
-	                          &dstData, &dstSize);
-
-	// Progressive decode
 	rc = progressive_create_surface_context(progressiveDec, 0, image->width, image->height);
 	if (rc <= 0)
 		goto fail;
 
-	rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
-	                            image->scanline, 0, 0, &invalidRegion, 0, 0);
-	if (rc < 0)
+	// Progressive encode and decode, first pass followed by upgrade passes until converged
+	for (pass = 0;; pass++)
+	{
+		UINT64 error = 0;
+
+		rc = progressive_compress(progressiveEnc, image->data, image->scanline * image->height,
+		                          ColorFormat, image->width, image->height, image->scanline, NULL,
+		                          &dstData, &dstSize);
+		if (rc < 0)
+			goto fail;
+		if (rc == 0)
+			break;
+		if (pass >= 64)
+		{
+			printf("progressive encoder did not converge\n");
+			goto fail;
+		}
+
+		rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+		                            image->scanline, 0, 0, &invalidRegion, 0, pass);
+		if (rc < 0)
+			goto fail;
+
+		for (y = 0; y < image->height * image->scanline; y++)
+			error += (UINT64)abs(image->data[y] - resultData[y]);
+
+		if (error > lastError)
+		{
+			printf("pass %u: error %" PRIu64 " increased from %" PRIu64 "\n", pass, error,
+			       lastError);
+			goto fail;
+		}
+		lastError = error;
+	}
+
+	if ((pass < 3) || progressive_compress_pending(progressiveEnc))
 		goto fail;
 
 	// Compare result
@@ -3,6 +3,14 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/rfx.h>
+#include <winpr/crypto.h>
+
+#include "../rfx_types.h"
+#include "../rfx_dwt.h"
+#include "../rfx_quantization.h"
+#if defined(WITH_SSE2)
+#include "../rfx_avx2.h"
+#endif
 
 static BYTE encodeHeaderSample[] = {
 	/* as in 4.2.2 */
@@ -843,6 +851,105 @@ static BOOL fuzzyCompareImage(const UINT32* crefImage, const BYTE* img, size_t n
 	return TRUE;
 }
 
+typedef struct
+{
+	const char* name;
+	void (*quantization_decode)(INT16* buffer, const UINT32* quantization_values);
+	void (*quantization_encode)(INT16* buffer, const UINT32* quantization_values);
+	void (*dwt_2d_decode)(INT16* buffer, INT16* dwt_buffer);
+	void (*dwt_2d_encode)(INT16* buffer, INT16* dwt_buffer);
+} rfx_simd_tier;
+
+/* The first 4096 values hold the encoded coefficients, the second 4096 the decoded tile */
+static void run_rfx_tier(const rfx_simd_tier* tier, const INT16* input, const UINT32* quant,
+                         INT16* output)
+{
+	INT16 dwt[4096] = { 0 };
+
+	memcpy(output, input, 4096 * sizeof(INT16));
+	tier->dwt_2d_encode(output, dwt);
+	tier->quantization_encode(output, quant);
+	memcpy(&output[4096], output, 4096 * sizeof(INT16));
+	tier->quantization_decode(&output[4096], quant);
+	tier->dwt_2d_decode(&output[4096], dwt);
+}
+
+/* All SIMD variants of the quantization and DWT steps must match the generic code */
+static BOOL test_rfx_simd_tiers(void)
+{
+	BOOL rc = FALSE;
+	size_t x, i;
+	UINT32 quant[10];
+	INT16* input = NULL;
+	INT16* expected = NULL;
+	INT16* output = NULL;
+	rfx_simd_tier tiers[3] = { { "generic", rfx_quantization_decode, rfx_quantization_encode,
+		                         rfx_dwt_2d_decode, rfx_dwt_2d_encode } };
+	size_t count = 1;
+	RFX_CONTEXT* context = rfx_context_new(FALSE);
+
+	if (!context)
+		return FALSE;
+
+#if defined(WITH_SSE2)
+	rfx_init_sse2(context);
+	tiers[count].name = "sse2";
+	tiers[count].quantization_decode = context->quantization_decode;
+	tiers[count].quantization_encode = context->quantization_encode;
+	tiers[count].dwt_2d_decode = context->dwt_2d_decode;
+	tiers[count].dwt_2d_encode = context->dwt_2d_encode;
+	count++;
+	rfx_init_avx2(context);
+	tiers[count].name = "avx2";
+	tiers[count].quantization_decode = context->quantization_decode;
+	tiers[count].quantization_encode = context->quantization_encode;
+	tiers[count].dwt_2d_decode = context->dwt_2d_decode;
+	tiers[count].dwt_2d_encode = context->dwt_2d_encode;
+	count++;
+#endif
+
+	input = _aligned_recalloc(NULL, 4096, sizeof(INT16), 32);
+	expected = _aligned_recalloc(NULL, 2 * 4096, sizeof(INT16), 32);
+	output = _aligned_recalloc(NULL, 2 * 4096, sizeof(INT16), 32);
+
+	if (!input || !expected || !output)
+		goto fail;
+
+	for (i = 0; i < 16; i++)
+	{
+		winpr_RAND((BYTE*)input, 4096 * sizeof(INT16));
+		winpr_RAND((BYTE*)quant, sizeof(quant));
+
+		for (x = 0; x < 4096; x++)
+			input[x] = (input[x] % 1024);
+
+		for (x = 0; x < ARRAYSIZE(quant); x++)
+			quant[x] = 6 + quant[x] % 10;
+
+		run_rfx_tier(&tiers[0], input, quant, expected);
+
+		for (x = 1; x < count; x++)
+		{
+			run_rfx_tier(&tiers[x], input, quant, output);
+
+			if (memcmp(expected, output, 2 * 4096 * sizeof(INT16)) != 0)
+			{
+				fprintf(stderr, "RemoteFX %s quantization/DWT output differs from generic\n",
+				        tiers[x].name);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	_aligned_free(input);
+	_aligned_free(expected);
+	_aligned_free(output);
+	rfx_context_free(context);
+	return rc;
+}
+
 int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 {
 	int rc = -1;
@@ -854,6 +961,9 @@ int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 
+	if (!test_rfx_simd_tiers())
+		goto fail;
+
 	/* use default threading options here, pass zero as
 	 * ThreadingFlags */
 	context = rfx_context_new(FALSE);
@@ -1,8 +1,15 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
+#include <freerdp/codec/bulk.h>
+
+#include "../mppc.h"
+#include "../ncrush.h"
 #include "../xcrush.h"
 
+#include "codec_test.h"
+
 static const BYTE TEST_BELLS_DATA[] = "for.whom.the.bell.tolls,.the.bell.tolls.for.thee!";
 
 static const BYTE TEST_BELLS_DATA_XCRUSH[] =
@@ -111,13 +118,178 @@ static const struct test_argument tests[] = {
 #endif
 };
 
+typedef int (*test_compress_fn)(void* context, const BYTE* pSrcData, UINT32 SrcSize,
+                                BYTE* pDstBuffer, const BYTE** ppDstData, UINT32* pDstSize,
+                                UINT32* pFlags);
+
+static int test_mppc_compress(void* context, const BYTE* pSrcData, UINT32 SrcSize,
+                              BYTE* pDstBuffer, const BYTE** ppDstData, UINT32* pDstSize,
+                              UINT32* pFlags)
+{
+	return mppc_compress((MPPC_CONTEXT*)context, pSrcData, SrcSize, pDstBuffer, ppDstData,
+	                     pDstSize, pFlags);
+}
+
+static int test_ncrush_compress(void* context, const BYTE* pSrcData, UINT32 SrcSize,
+                                BYTE* pDstBuffer, const BYTE** ppDstData, UINT32* pDstSize,
+                                UINT32* pFlags)
+{
+	return ncrush_compress((NCRUSH_CONTEXT*)context, pSrcData, SrcSize, pDstBuffer, ppDstData,
+	                       pDstSize, pFlags);
+}
+
+static int test_xcrush_compress(void* context, const BYTE* pSrcData, UINT32 SrcSize,
+                                BYTE* pDstBuffer, const BYTE** ppDstData, UINT32* pDstSize,
+                                UINT32* pFlags)
+{
+	return xcrush_compress((XCRUSH_CONTEXT*)context, pSrcData, SrcSize, pDstBuffer, ppDstData,
+	                       pDstSize, pFlags);
+}
+
+static BOOL test_benchmark(const char* name, const CODEC_TEST_STREAM* stream, void* context,
+                           test_compress_fn fkt)
+{
+	size_t x;
+	size_t offset = 0;
+	size_t compressed = 0;
+	UINT64 start;
+	UINT64 elapsed;
+	BYTE* OutputBuffer = (BYTE*)malloc(65536);
+
+	if (!context || !OutputBuffer)
+	{
+		free(OutputBuffer);
+		return FALSE;
+	}
+
+	start = GetTickCount64();
+
+	for (x = 0; x < CODEC_TEST_STREAM_PACKETS; x++)
+	{
+		UINT32 Flags = 0;
+		UINT32 DstSize = 65536;
+		const BYTE* pDstData = NULL;
+
+		if (fkt(context, &stream->data[offset], stream->sizes[x], OutputBuffer, &pDstData,
+		        &DstSize, &Flags) < 0)
+		{
+			printf("[%s] compression of packet %" PRIuz " failed\n", name, x);
+			free(OutputBuffer);
+			return FALSE;
+		}
+
+		compressed += (Flags & PACKET_COMPRESSED) ? DstSize : stream->sizes[x];
+		offset += stream->sizes[x];
+	}
+
+	elapsed = GetTickCount64() - start;
+	printf("[%s] %" PRIuz " bytes -> %" PRIuz " bytes, ratio %.3f, %.1f MB/s\n", name,
+	       stream->total, compressed, (double)compressed / (double)stream->total,
+	       codec_test_rate(stream->total, elapsed));
+	free(OutputBuffer);
+	return TRUE;
+}
+
+static BOOL test_xcrush_roundtrip(const CODEC_TEST_STREAM* stream)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	size_t offset = 0;
+	BYTE* OutputBuffer = (BYTE*)malloc(65536);
+	XCRUSH_CONTEXT* compressor = xcrush_context_new(TRUE);
+	XCRUSH_CONTEXT* decompressor = xcrush_context_new(FALSE);
+
+	if (!OutputBuffer || !compressor || !decompressor)
+		goto fail;
+
+	for (x = 0; x < CODEC_TEST_STREAM_PACKETS; x++)
+	{
+		UINT32 Flags = 0;
+		UINT32 DstSize = 65536;
+		UINT32 PlainSize = 0;
+		const BYTE* pDstData = NULL;
+		const BYTE* pPlainData = NULL;
+		const BYTE* pSrcData = &stream->data[offset];
+
+		if (xcrush_compress(compressor, pSrcData, stream->sizes[x], OutputBuffer, &pDstData,
+		                    &DstSize, &Flags) < 0)
+			goto fail;
+
+		if (Flags & PACKET_COMPRESSED)
+		{
+			if (xcrush_decompress(decompressor, pDstData, DstSize, &pPlainData, &PlainSize,
+			                      Flags) < 0)
+			{
+				printf("[XCrushRoundtrip] decompression of packet %" PRIuz " failed\n", x);
+				goto fail;
+			}
+		}
+		else
+		{
+			pPlainData = pDstData;
+			PlainSize = DstSize;
+		}
+
+		if ((PlainSize != stream->sizes[x]) || (memcmp(pPlainData, pSrcData, PlainSize) != 0))
+		{
+			printf("[XCrushRoundtrip] packet %" PRIuz " differs after decompression\n", x);
+			goto fail;
+		}
+
+		offset += stream->sizes[x];
+	}
+
+	rc = TRUE;
+fail:
+	xcrush_context_free(compressor);
+	xcrush_context_free(decompressor);
+	free(OutputBuffer);
+	return rc;
+}
+
+static BOOL test_stream(BOOL benchmark)
+{
+	BOOL rc = FALSE;
+	CODEC_TEST_STREAM stream = { 0 };
+	MPPC_CONTEXT* mppc = NULL;
+	NCRUSH_CONTEXT* ncrush = NULL;
+	XCRUSH_CONTEXT* xcrush = NULL;
+
+	if (!codec_test_stream_init(&stream))
+		return FALSE;
+
+	if (!test_xcrush_roundtrip(&stream))
+		goto fail;
+
+	if (!benchmark)
+	{
+		rc = TRUE;
+		goto fail;
+	}
+
+	mppc = mppc_context_new(1, TRUE);
+	ncrush = ncrush_context_new(TRUE);
+	xcrush = xcrush_context_new(TRUE);
+
+	if (!test_benchmark("MPPC-64K", &stream, mppc, test_mppc_compress) ||
+	    !test_benchmark("NCrush", &stream, ncrush, test_ncrush_compress) ||
+	    !test_benchmark("XCrush", &stream, xcrush, test_xcrush_compress))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	mppc_context_free(mppc);
+	ncrush_context_free(ncrush);
+	xcrush_context_free(xcrush);
+	codec_test_stream_uninit(&stream);
+	return rc;
+}
+
 int TestFreeRDPCodecXCrush(int argc, char* argv[])
 {
 	int rc = 0;
 	size_t x;
-
-	WINPR_UNUSED(argc);
-	WINPR_UNUSED(argv);
+	const BOOL benchmark = codec_test_benchmark_enabled(argc, argv);
 
 	for (x = 0; x < ARRAYSIZE(tests); x++)
 	{
@@ -127,5 +299,8 @@ int TestFreeRDPCodecXCrush(int argc, char* argv[])
 			rc = -1;
 	}
 
+	if (!test_stream(benchmark))
+		rc = -1;
+
 	return rc;
 }
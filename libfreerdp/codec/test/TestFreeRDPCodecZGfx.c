@@ -1,6 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/zgfx.h>
@@ -253,8 +254,184 @@ fail:
 	return rc;
 }
 
+/* Generate data resembling a desktop: runs of solid color, repeated glyph
+ * like patterns and some noise. */
+static void test_ZGfxFillSample(BYTE* data, size_t size, UINT32 seed)
+{
+	size_t pos = 0;
+	UINT32 state = seed;
+
+	while (pos < size)
+	{
+		size_t x;
+		size_t len;
+		state = state * 1103515245 + 12345;
+		len = MIN(size - pos, 16 + ((state >> 8) % 512));
+
+		if (((state >> 24) % 4) == 0)
+			memset(&data[pos], (state >> 16) & 0xFF, len);
+		else if ((((state >> 24) % 4) == 1) && (pos > 4096))
+		{
+			const size_t distance = 1 + ((state >> 4) % 4096);
+
+			for (x = 0; x < len; x++)
+				data[pos + x] = data[pos + x - distance];
+		}
+		else
+		{
+			for (x = 0; x < len; x++)
+			{
+				state = state * 1103515245 + 12345;
+				data[pos + x] = (BYTE)(state >> 16);
+			}
+		}
+
+		pos += len;
+	}
+}
+
+static int test_ZGfxCompressRoundTrip(UINT32 level, UINT32 iterations, UINT32 packetSize)
+{
+	int rc = -1;
+	UINT32 i;
+	UINT64 compressed = 0;
+	UINT64 uncompressed = 0;
+	UINT64 ticks = 0;
+	BYTE* pSrcData = NULL;
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!compressor || !decompressor)
+		goto fail;
+
+	if (!zgfx_context_set_compression_level(compressor, level))
+		goto fail;
+
+	pSrcData = malloc(packetSize);
+
+	if (!pSrcData)
+		goto fail;
+
+	for (i = 0; i < iterations; i++)
+	{
+		int status;
+		UINT64 start;
+		UINT32 Flags = 0;
+		UINT32 DstSize = 0;
+		UINT32 CompressedSize = 0;
+		BYTE* pCompressed = NULL;
+		BYTE* pDstData = NULL;
+
+		/* Every other packet repeats an older one to exercise long distance matches */
+		test_ZGfxFillSample(pSrcData, packetSize, (i % 2) ? 42 : i);
+		start = GetTickCount64();
+		status = zgfx_compress(compressor, pSrcData, packetSize, &pCompressed, &CompressedSize,
+		                       &Flags);
+		ticks += GetTickCount64() - start;
+
+		if (status < 0)
+		{
+			free(pCompressed);
+			goto fail;
+		}
+
+		status =
+		    zgfx_decompress(decompressor, pCompressed, CompressedSize, &pDstData, &DstSize, 0);
+		free(pCompressed);
+
+		if (status < 0)
+		{
+			printf("%s: level %" PRIu32 " packet %" PRIu32 " failed to decompress\n", __FUNCTION__,
+			       level, i);
+			free(pDstData);
+			goto fail;
+		}
+
+		if ((DstSize != packetSize) || (memcmp(pDstData, pSrcData, packetSize) != 0))
+		{
+			printf("%s: level %" PRIu32 " packet %" PRIu32 " output mismatch\n", __FUNCTION__,
+			       level, i);
+			free(pDstData);
+			goto fail;
+		}
+
+		free(pDstData);
+		compressed += CompressedSize;
+		uncompressed += packetSize;
+	}
+
+	printf("%s: level %" PRIu32 ": %" PRIu64 " -> %" PRIu64 " bytes (%.2f%%) in %" PRIu64
+	       " ms (%.2f MB/s)\n",
+	       __FUNCTION__, level, uncompressed, compressed, 100.0 * compressed / uncompressed, ticks,
+	       (ticks > 0) ? (uncompressed / 1048576.0) / (ticks / 1000.0) : 0.0);
+
+	if ((level != ZGFX_COMPRESSION_LEVEL_NONE) && (compressed >= uncompressed))
+	{
+		printf("%s: level %" PRIu32 " did not compress\n", __FUNCTION__, level);
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	free(pSrcData);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
+/* Single segments with a small history, as used for dynamic virtual channel data */
+static int test_ZGfxSegmentRoundTrip(UINT32 historySize, UINT32 segmentSize)
+{
+	int rc = -1;
+	UINT32 i;
+	size_t offset;
+	const size_t size = 256 * 1024;
+	BYTE* pSrcData = malloc(size);
+	wStream* sCompressed = Stream_New(NULL, segmentSize + 1);
+	wStream* sDst = Stream_New(NULL, size);
+	ZGFX_CONTEXT* compressor = zgfx_context_new_ex(TRUE, historySize);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new_ex(FALSE, historySize);
+
+	if (!pSrcData || !sCompressed || !sDst || !compressor || !decompressor)
+		goto fail;
+
+	test_ZGfxFillSample(pSrcData, size, 23);
+
+	for (offset = 0, i = 0; offset < size; offset += segmentSize, i++)
+	{
+		const UINT32 length = (UINT32)MIN(segmentSize, size - offset);
+		Stream_SetPosition(sCompressed, 0);
+
+		if (!zgfx_compress_segment_to_stream(compressor, sCompressed, &pSrcData[offset], length))
+			goto fail;
+
+		if (!zgfx_decompress_segment_to_stream(decompressor, Stream_Buffer(sCompressed),
+		                                       (UINT32)Stream_GetPosition(sCompressed), sDst))
+		{
+			printf("%s: segment %" PRIu32 " failed to decompress\n", __FUNCTION__, i);
+			goto fail;
+		}
+	}
+
+	if ((Stream_GetPosition(sDst) != size) || (memcmp(Stream_Buffer(sDst), pSrcData, size) != 0))
+	{
+		printf("%s: output mismatch\n", __FUNCTION__);
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	free(pSrcData);
+	Stream_Free(sCompressed, TRUE);
+	Stream_Free(sDst, TRUE);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
+	UINT32 level;
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 
@@ -270,5 +447,22 @@ int TestFreeRDPCodecZGfx(int argc, char* argv[])
 	if (test_ZGfxCompressConsistent() < 0)
 		return -1;
 
+	if (test_ZGfxSegmentRoundTrip(8192, 1590) < 0)
+		return -1;
+
+	if (test_ZGfxSegmentRoundTrip(64 * 1024, ZGFX_SEGMENTED_MAXSIZE) < 0)
+		return -1;
+
+	/* Small packets exercise the history shared across PDUs, large ones
+	 * the multipart segmentation and the window sliding */
+	for (level = ZGFX_COMPRESSION_LEVEL_NONE; level <= ZGFX_COMPRESSION_LEVEL_BEST; level++)
+	{
+		if (test_ZGfxCompressRoundTrip(level, 64, 4096) < 0)
+			return -1;
+
+		if (test_ZGfxCompressRoundTrip(level, 12, 1024 * 1024) < 0)
+			return -1;
+	}
+
 	return 0;
 }
@@ -0,0 +1,121 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared helpers for the bulk compression codec tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "codec_test.h"
+
+#define CODEC_TEST_SCREEN_SIZE (512 * 1024)
+
+static UINT32 codec_test_rand(UINT32* state)
+{
+	/* deterministic, results must be comparable between runs */
+	*state = *state * 1103515245 + 12345;
+	return *state >> 8;
+}
+
+/*
+ * Builds a stream of update like packets: slices of a synthetic screen (runs of pixels,
+ * repeated glyph rows) with a few bytes changed, similar to what a desktop session sends.
+ */
+BOOL codec_test_stream_init(CODEC_TEST_STREAM* stream)
+{
+	size_t x;
+	size_t pos = 0;
+	UINT32 state = 0x5EED;
+	BYTE* screen = (BYTE*)malloc(CODEC_TEST_SCREEN_SIZE);
+
+	stream->total = 0;
+	stream->data = (BYTE*)malloc(CODEC_TEST_STREAM_PACKETS * CODEC_TEST_STREAM_MAX_PACKET);
+
+	if (!screen || !stream->data)
+	{
+		free(screen);
+		codec_test_stream_uninit(stream);
+		return FALSE;
+	}
+
+	while (pos < CODEC_TEST_SCREEN_SIZE)
+	{
+		const UINT32 kind = codec_test_rand(&state) % 4;
+		size_t len = 16 + codec_test_rand(&state) % 512;
+
+		if (len > CODEC_TEST_SCREEN_SIZE - pos)
+			len = CODEC_TEST_SCREEN_SIZE - pos;
+
+		if ((kind == 0) || (pos < len))
+		{
+			for (x = 0; x < len; x++)
+				screen[pos + x] = (BYTE)codec_test_rand(&state);
+		}
+		else if (kind == 1)
+			memset(&screen[pos], (BYTE)codec_test_rand(&state), len);
+		else
+		{
+			const size_t from = codec_test_rand(&state) % (pos - len + 1);
+			memcpy(&screen[pos], &screen[from], len);
+		}
+
+		pos += len;
+	}
+
+	for (x = 0; x < CODEC_TEST_STREAM_PACKETS; x++)
+	{
+		size_t y;
+		BYTE* packet = &stream->data[stream->total];
+		const UINT32 size =
+		    256 + codec_test_rand(&state) % (CODEC_TEST_STREAM_MAX_PACKET - 256);
+		const UINT32 offset = codec_test_rand(&state) % (CODEC_TEST_SCREEN_SIZE - size);
+
+		memcpy(packet, &screen[offset], size);
+
+		for (y = 0; y < size / 256; y++)
+			packet[codec_test_rand(&state) % size] = (BYTE)codec_test_rand(&state);
+
+		stream->sizes[x] = size;
+		stream->total += size;
+	}
+
+	free(screen);
+	return TRUE;
+}
+
+void codec_test_stream_uninit(CODEC_TEST_STREAM* stream)
+{
+	if (!stream)
+		return;
+
+	free(stream->data);
+	stream->data = NULL;
+	stream->total = 0;
+}
+
+BOOL codec_test_benchmark_enabled(int argc, char* argv[])
+{
+	int x;
+
+	for (x = 1; x < argc; x++)
+	{
+		if (strcmp(argv[x], "--benchmark") == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+double codec_test_rate(size_t bytes, UINT64 elapsed)
+{
+	return elapsed ? (double)bytes * 1000.0 / (1024.0 * 1024.0) / (double)elapsed : 0.0;
+}
@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared helpers for the bulk compression codec tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_TEST_H
+#define FREERDP_LIB_CODEC_TEST_H
+
+#include <winpr/crt.h>
+#include <winpr/wtypes.h>
+
+#define CODEC_TEST_STREAM_PACKETS 256
+#define CODEC_TEST_STREAM_MAX_PACKET 16384
+
+typedef struct
+{
+	BYTE* data;
+	UINT32 sizes[CODEC_TEST_STREAM_PACKETS];
+	size_t total;
+} CODEC_TEST_STREAM;
+
+/* Builds a deterministic stream of update like packets, free with codec_test_stream_uninit */
+BOOL codec_test_stream_init(CODEC_TEST_STREAM* stream);
+void codec_test_stream_uninit(CODEC_TEST_STREAM* stream);
+
+/* Speed reports are only printed if the test is run with --benchmark */
+BOOL codec_test_benchmark_enabled(int argc, char* argv[]);
+double codec_test_rate(size_t bytes, UINT64 elapsed);
+
+#endif /* FREERDP_LIB_CODEC_TEST_H */
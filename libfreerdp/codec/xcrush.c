@@ -31,6 +31,12 @@
 
 #define TAG FREERDP_TAG("codec")
 
+/*
+ * Every chunk signature remembers the history offsets of its last XCRUSH_INDEX_WAYS chunks.
+ * Older chunks are forgotten, which bounds both the index size and the match search.
+ */
+#define XCRUSH_INDEX_WAYS 4
+
 #pragma pack(push, 1)
 
 typedef struct
@@ -40,12 +46,6 @@ typedef struct
 	UINT32 MatchLength;
 } XCRUSH_MATCH_INFO;
 
-typedef struct
-{
-	UINT32 offset;
-	UINT32 next;
-} XCRUSH_CHUNK;
-
 typedef struct
 {
 	UINT16 seed;
@@ -83,10 +83,7 @@ struct s_XCRUSH_CONTEXT
 	ALIGN64 UINT32 SignatureIndex;
 	ALIGN64 UINT32 SignatureCount;
 	ALIGN64 XCRUSH_SIGNATURE Signatures[1000];
-	ALIGN64 UINT32 ChunkHead;
-	ALIGN64 UINT32 ChunkTail;
-	ALIGN64 XCRUSH_CHUNK Chunks[65534];
-	ALIGN64 UINT16 NextChunks[65536];
+	ALIGN64 UINT32 ChunkIndex[65536][XCRUSH_INDEX_WAYS];
 	ALIGN64 UINT32 OriginalMatchCount;
 	ALIGN64 UINT32 OptimizedMatchCount;
 	ALIGN64 XCRUSH_MATCH_INFO OriginalMatches[1000];
@@ -214,12 +211,11 @@ static int xcrush_append_chunk(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT32*
 	return 1;
 }
 
-static int xcrush_compute_chunks(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT32 size,
-                                 UINT32* pIndex)
+static BOOL xcrush_compute_chunks(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT32 size,
+                                  UINT32* pIndex)
 {
 	UINT32 i = 0;
 	UINT32 offset = 0;
-	UINT32 rotation = 0;
 	UINT32 accumulator = 0;
 
 	WINPR_ASSERT(xcrush);
@@ -230,63 +226,30 @@ static int xcrush_compute_chunks(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT3
 	xcrush->SignatureIndex = 0;
 
 	if (size < 128)
-		return 0;
+		return FALSE;
 
 	for (i = 0; i < 32; i++)
-	{
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i] ^ rotation;
-	}
+		accumulator = data[i] ^ _rotl(accumulator, 1);
 
+	/* Rolling hash over a 32 byte window, a chunk ends where the low 7 bits are zero */
 	for (i = 0; i < size - 64; i++)
 	{
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
-
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
-
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
+		accumulator = data[i + 32] ^ data[i] ^ _rotl(accumulator, 1);
 
 		if (!(accumulator & 0x7F))
 		{
 			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
-
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
-
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
-
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
-
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
+				return FALSE;
 		}
 	}
 
 	if ((size == offset) || xcrush_append_chunk(xcrush, data, &offset, size))
 	{
 		*pIndex = xcrush->SignatureIndex;
-		return 1;
+		return TRUE;
 	}
 
-	return 0;
+	return FALSE;
 }
 
 static UINT32 xcrush_compute_signatures(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT32 size)
@@ -299,223 +262,106 @@ static UINT32 xcrush_compute_signatures(XCRUSH_CONTEXT* xcrush, const BYTE* data
 	return 0;
 }
 
-static void xcrush_clear_hash_table_range(XCRUSH_CONTEXT* xcrush, UINT32 beg, UINT32 end)
+static INLINE void xcrush_index_insert(UINT32* bucket, UINT32 offset)
 {
-	UINT32 index;
-
-	WINPR_ASSERT(xcrush);
-
-	for (index = 0; index < 65536; index++)
-	{
-		if (xcrush->NextChunks[index] >= beg)
-		{
-			if (xcrush->NextChunks[index] <= end)
-			{
-				xcrush->NextChunks[index] = 0;
-			}
-		}
-	}
-
-	for (index = 0; index < 65534; index++)
-	{
-		if (xcrush->Chunks[index].next >= beg)
-		{
-			if (xcrush->Chunks[index].next <= end)
-			{
-				xcrush->Chunks[index].next = 0;
-			}
-		}
-	}
+	/* most recent chunk first, the oldest one drops out */
+	MoveMemory(&bucket[1], &bucket[0], (XCRUSH_INDEX_WAYS - 1) * sizeof(UINT32));
+	bucket[0] = offset + 1;
 }
 
-static int xcrush_find_next_matching_chunk(XCRUSH_CONTEXT* xcrush, XCRUSH_CHUNK* chunk,
-                                           XCRUSH_CHUNK** pNextChunk)
+/* Number of equal bytes at a and b, compared a machine word at a time */
+static INLINE UINT32 xcrush_compare_forward(const BYTE* a, const BYTE* b, UINT32 max)
 {
-	UINT32 index;
-	XCRUSH_CHUNK* next = NULL;
-
-	WINPR_ASSERT(xcrush);
+	UINT32 length = 0;
 
-	if (!chunk)
-		return -4001; /* error */
-
-	if (chunk->next)
+	while (length + sizeof(UINT64) <= max)
 	{
-		index = (chunk - xcrush->Chunks) / sizeof(XCRUSH_CHUNK);
-
-		if (index >= 65534)
-			return -4002; /* error */
+		UINT64 va = 0;
+		UINT64 vb = 0;
 
-		if ((index < xcrush->ChunkHead) || (chunk->next >= xcrush->ChunkHead))
-		{
-			if (chunk->next >= 65534)
-				return -4003; /* error */
-
-			next = &xcrush->Chunks[chunk->next];
-		}
-	}
-
-	WINPR_ASSERT(pNextChunk);
-	*pNextChunk = next;
-	return 1;
-}
+		memcpy(&va, &a[length], sizeof(va));
+		memcpy(&vb, &b[length], sizeof(vb));
 
-static int xcrush_insert_chunk(XCRUSH_CONTEXT* xcrush, XCRUSH_SIGNATURE* signature, UINT32 offset,
-                               XCRUSH_CHUNK** pPrevChunk)
-{
-	UINT32 seed;
-	UINT32 index;
-
-	WINPR_ASSERT(xcrush);
-
-	if (xcrush->ChunkHead >= 65530)
-	{
-		xcrush->ChunkHead = 1;
-		xcrush->ChunkTail = 1;
-	}
+		if (va != vb)
+			break;
 
-	if (xcrush->ChunkHead >= xcrush->ChunkTail)
-	{
-		xcrush_clear_hash_table_range(xcrush, xcrush->ChunkTail, xcrush->ChunkTail + 10000);
-		xcrush->ChunkTail += 10000;
+		length += sizeof(UINT64);
 	}
 
-	index = xcrush->ChunkHead++;
-
-	if (xcrush->ChunkHead >= 65534)
-		return -3001; /* error */
-
-	xcrush->Chunks[index].offset = offset;
-	seed = signature->seed;
-
-	if (seed >= 65536)
-		return -3002; /* error */
+	while ((length < max) && (a[length] == b[length]))
+		length++;
 
-	if (xcrush->NextChunks[seed])
-	{
-		if (xcrush->NextChunks[seed] >= 65534)
-			return -3003; /* error */
-
-		WINPR_ASSERT(pPrevChunk);
-		*pPrevChunk = &xcrush->Chunks[xcrush->NextChunks[seed]];
-	}
-
-	xcrush->Chunks[index].next = xcrush->NextChunks[seed] & 0xFFFF;
-	xcrush->NextChunks[seed] = index;
-	return 1;
+	return length;
 }
 
-static int xcrush_find_match_length(XCRUSH_CONTEXT* xcrush, UINT32 MatchOffset, UINT32 ChunkOffset,
-                                    UINT32 HistoryOffset, UINT32 SrcSize, UINT32 MaxMatchLength,
-                                    XCRUSH_MATCH_INFO* MatchInfo)
+static UINT32 xcrush_find_match_length(XCRUSH_CONTEXT* xcrush, UINT32 MatchOffset,
+                                       UINT32 ChunkOffset, UINT32 HistoryOffset, UINT32 SrcEnd,
+                                       UINT32 MaxMatchLength, XCRUSH_MATCH_INFO* MatchInfo)
 {
-	UINT32 MatchSymbol;
-	UINT32 ChunkSymbol;
-	BYTE* ChunkBuffer;
-	BYTE* MatchBuffer;
-	BYTE* MatchStartPtr;
-	BYTE* ForwardChunkPtr;
-	BYTE* ReverseChunkPtr;
-	BYTE* ForwardMatchPtr;
-	BYTE* ReverseMatchPtr;
-	BYTE* HistoryBufferEnd;
+	UINT32 max;
+	UINT32 ChunkLimit;
+	UINT32 TotalMatchLength;
 	UINT32 ReverseMatchLength = 0;
 	UINT32 ForwardMatchLength = 0;
-	UINT32 TotalMatchLength;
-	BYTE* HistoryBuffer;
-	UINT32 HistoryBufferSize;
+	const BYTE* HistoryBuffer;
 
 	WINPR_ASSERT(xcrush);
 	WINPR_ASSERT(MatchInfo);
+	WINPR_ASSERT(MatchOffset < SrcEnd);
+	WINPR_ASSERT(SrcEnd <= xcrush->HistoryBufferSize);
+	WINPR_ASSERT(ChunkOffset < xcrush->HistoryBufferSize);
+	WINPR_ASSERT(MatchOffset != ChunkOffset);
 
 	HistoryBuffer = xcrush->HistoryBuffer;
-	HistoryBufferSize = xcrush->HistoryBufferSize;
-	HistoryBufferEnd = &HistoryBuffer[HistoryOffset + SrcSize];
-
-	if (MatchOffset > HistoryBufferSize)
-		return -2001; /* error */
-
-	MatchBuffer = &HistoryBuffer[MatchOffset];
 
-	if (ChunkOffset > HistoryBufferSize)
-		return -2002; /* error */
+	/* the decoder requires the whole match source inside the history buffer */
+	max = SrcEnd - MatchOffset;
 
-	ChunkBuffer = &HistoryBuffer[ChunkOffset];
+	if (max > xcrush->HistoryBufferSize - 1 - ChunkOffset)
+		max = xcrush->HistoryBufferSize - 1 - ChunkOffset;
 
-	if (MatchOffset == ChunkOffset)
-		return -2003; /* error */
-
-	if (MatchBuffer < HistoryBuffer)
-		return -2004; /* error */
-
-	if (ChunkBuffer < HistoryBuffer)
-		return -2005; /* error */
-
-	ForwardMatchPtr = &HistoryBuffer[MatchOffset];
-	ForwardChunkPtr = &HistoryBuffer[ChunkOffset];
-
-	if ((&MatchBuffer[MaxMatchLength + 1] < HistoryBufferEnd) &&
-	    (MatchBuffer[MaxMatchLength + 1] != ChunkBuffer[MaxMatchLength + 1]))
-	{
+	/* cheap reject of candidates that can not beat the best match so far */
+	if ((MaxMatchLength + 1 < max) &&
+	    (HistoryBuffer[MatchOffset + MaxMatchLength + 1] !=
+	     HistoryBuffer[ChunkOffset + MaxMatchLength + 1]))
 		return 0;
-	}
 
-	while (1)
-	{
-		MatchSymbol = *ForwardMatchPtr++;
-		ChunkSymbol = *ForwardChunkPtr++;
-
-		if (MatchSymbol != ChunkSymbol)
-			break;
-
-		if (ForwardMatchPtr > HistoryBufferEnd)
-			break;
-
-		ForwardMatchLength++;
-	}
+	ForwardMatchLength =
+	    xcrush_compare_forward(&HistoryBuffer[MatchOffset], &HistoryBuffer[ChunkOffset], max);
 
-	ReverseMatchPtr = MatchBuffer - 1;
-	ReverseChunkPtr = ChunkBuffer - 1;
+	/*
+	 * Old data behind the current packet is only valid up to the packet end, everything
+	 * before that is overwritten by the packet itself.
+	 */
+	ChunkLimit = (ChunkOffset > SrcEnd) ? SrcEnd : 0;
 
-	while ((ReverseMatchPtr > &HistoryBuffer[HistoryOffset]) && (ReverseChunkPtr > HistoryBuffer) &&
-	       (*ReverseMatchPtr == *ReverseChunkPtr))
-	{
+	while ((MatchOffset - ReverseMatchLength > HistoryOffset + 1) &&
+	       (ChunkOffset - ReverseMatchLength > ChunkLimit + 1) &&
+	       (HistoryBuffer[MatchOffset - ReverseMatchLength - 1] ==
+	        HistoryBuffer[ChunkOffset - ReverseMatchLength - 1]))
 		ReverseMatchLength++;
-		ReverseMatchPtr--;
-		ReverseChunkPtr--;
-	}
 
-	MatchStartPtr = MatchBuffer - ReverseMatchLength;
 	TotalMatchLength = ReverseMatchLength + ForwardMatchLength;
 
 	if (TotalMatchLength < 11)
 		return 0;
 
-	if (MatchStartPtr < HistoryBuffer)
-		return -2006; /* error */
-
-	MatchInfo->MatchOffset = MatchStartPtr - HistoryBuffer;
-	MatchInfo->ChunkOffset = ChunkBuffer - ReverseMatchLength - HistoryBuffer;
+	MatchInfo->MatchOffset = MatchOffset - ReverseMatchLength;
+	MatchInfo->ChunkOffset = ChunkOffset - ReverseMatchLength;
 	MatchInfo->MatchLength = TotalMatchLength;
-	return (int)TotalMatchLength;
+	return TotalMatchLength;
 }
 
 static int xcrush_find_all_matches(XCRUSH_CONTEXT* xcrush, UINT32 SignatureIndex,
-                                   UINT32 HistoryOffset, UINT32 SrcOffset, UINT32 SrcSize)
+                                   UINT32 HistoryOffset, UINT32 SrcSize)
 {
 	UINT32 i = 0;
-	UINT32 j = 0;
-	int status = 0;
-	UINT32 offset = 0;
-	UINT32 ChunkIndex = 0;
-	UINT32 ChunkCount = 0;
-	XCRUSH_CHUNK* chunk = NULL;
-	UINT32 MatchLength = 0;
-	UINT32 MaxMatchLength = 0;
+	UINT32 way = 0;
+	UINT32 count = 0;
 	UINT32 PrevMatchEnd = 0;
-	XCRUSH_MATCH_INFO MatchInfo = { 0 };
-	XCRUSH_MATCH_INFO MaxMatchInfo = { 0 };
-	XCRUSH_SIGNATURE* Signatures = NULL;
+	UINT32 offset = HistoryOffset;
+	const UINT32 SrcEnd = HistoryOffset + SrcSize;
+	const XCRUSH_SIGNATURE* Signatures = NULL;
 
 	WINPR_ASSERT(xcrush);
 
@@ -523,86 +369,56 @@ static int xcrush_find_all_matches(XCRUSH_CONTEXT* xcrush, UINT32 SignatureIndex
 
 	for (i = 0; i < SignatureIndex; i++)
 	{
-		offset = SrcOffset + HistoryOffset;
+		UINT32* bucket = xcrush->ChunkIndex[Signatures[i].seed];
 
 		if (!Signatures[i].size)
 			return -1001; /* error */
 
-		status = xcrush_insert_chunk(xcrush, &Signatures[i], offset, &chunk);
-
-		if (status < 0)
-			return status;
-
-		if (chunk && (SrcOffset + HistoryOffset + Signatures[i].size >= PrevMatchEnd))
+		if (offset + Signatures[i].size >= PrevMatchEnd)
 		{
-			ChunkCount = 0;
-			MaxMatchLength = 0;
-			ZeroMemory(&MaxMatchInfo, sizeof(XCRUSH_MATCH_INFO));
+			XCRUSH_MATCH_INFO MatchInfo = { 0 };
+			XCRUSH_MATCH_INFO MaxMatchInfo = { 0 };
 
-			while (chunk)
+			for (way = 0; (way < XCRUSH_INDEX_WAYS) && bucket[way]; way++)
 			{
-				if ((chunk->offset < HistoryOffset) || (chunk->offset < offset) ||
-				    (chunk->offset > SrcSize + HistoryOffset))
-				{
-					status = xcrush_find_match_length(xcrush, offset, chunk->offset, HistoryOffset,
-					                                  SrcSize, MaxMatchLength, &MatchInfo);
-
-					if (status < 0)
-						return status; /* error */
+				const UINT32 candidate = bucket[way] - 1;
 
-					MatchLength = (UINT32)status;
+				/* The part of this packet not yet decoded can not be referenced */
+				if ((candidate >= offset) && (candidate <= SrcEnd))
+					continue;
 
-					if (MatchLength > MaxMatchLength)
-					{
-						MaxMatchLength = MatchLength;
-						MaxMatchInfo.MatchOffset = MatchInfo.MatchOffset;
-						MaxMatchInfo.ChunkOffset = MatchInfo.ChunkOffset;
-						MaxMatchInfo.MatchLength = MatchInfo.MatchLength;
+				if (xcrush_find_match_length(xcrush, offset, candidate, HistoryOffset, SrcEnd,
+				                             MaxMatchInfo.MatchLength,
+				                             &MatchInfo) > MaxMatchInfo.MatchLength)
+				{
+					MaxMatchInfo = MatchInfo;
 
-						if (MatchLength > 256)
-							break;
-					}
+					if (MaxMatchInfo.MatchLength > 256)
+						break;
 				}
-
-				ChunkIndex = ChunkCount++;
-
-				if (ChunkIndex > 4)
-					break;
-
-				status = xcrush_find_next_matching_chunk(xcrush, chunk, &chunk);
-
-				if (status < 0)
-					return status; /* error */
 			}
 
-			if (MaxMatchLength)
+			if (MaxMatchInfo.MatchLength)
 			{
-				xcrush->OriginalMatches[j].MatchOffset = MaxMatchInfo.MatchOffset;
-				xcrush->OriginalMatches[j].ChunkOffset = MaxMatchInfo.ChunkOffset;
-				xcrush->OriginalMatches[j].MatchLength = MaxMatchInfo.MatchLength;
-
-				if (xcrush->OriginalMatches[j].MatchOffset < HistoryOffset)
+				if (MaxMatchInfo.MatchOffset < HistoryOffset)
 					return -1002; /* error */
 
-				PrevMatchEnd =
-				    xcrush->OriginalMatches[j].MatchLength + xcrush->OriginalMatches[j].MatchOffset;
-				j++;
+				xcrush->OriginalMatches[count++] = MaxMatchInfo;
+				PrevMatchEnd = MaxMatchInfo.MatchOffset + MaxMatchInfo.MatchLength;
 
-				if (j >= 1000)
+				if (count >= ARRAYSIZE(xcrush->OriginalMatches))
 					return -1003; /* error */
 			}
 		}
 
-		SrcOffset += Signatures[i].size;
+		xcrush_index_insert(bucket, offset);
+		offset += Signatures[i].size;
 
-		if (SrcOffset > SrcSize)
+		if (offset > SrcEnd)
 			return -1004; /* error */
 	}
 
-	if (SrcOffset > SrcSize)
-		return -1005; /* error */
-
-	return (int)j;
+	return (int)count;
 }
 
 static int xcrush_optimize_matches(XCRUSH_CONTEXT* xcrush)
@@ -986,7 +802,7 @@ static int xcrush_compress_l1(XCRUSH_CONTEXT* xcrush, const BYTE* pSrcData, UINT
 
 		if (SignatureIndex)
 		{
-			status = xcrush_find_all_matches(xcrush, SignatureIndex, HistoryOffset, 0, SrcSize);
+			status = xcrush_find_all_matches(xcrush, SignatureIndex, HistoryOffset, SrcSize);
 
 			if (status < 0)
 				return status;
@@ -1091,7 +907,8 @@ int xcrush_compress(XCRUSH_CONTEXT* xcrush, const BYTE* pSrcData, UINT32 SrcSize
 	if (status < 0)
 		return status;
 
-	if (!status || (Level2ComprFlags & PACKET_FLUSHED))
+	/* PACKET_FLUSHED alone only tells the level 2 history restarted, the data may be compressed */
+	if (!status || !(Level2ComprFlags & PACKET_COMPRESSED))
 	{
 		if (CompressedDataSize > DstSize)
 		{
@@ -1141,9 +958,7 @@ void xcrush_context_reset(XCRUSH_CONTEXT* xcrush, BOOL flush)
 	xcrush->SignatureCount = 1000;
 	ZeroMemory(&(xcrush->Signatures), sizeof(XCRUSH_SIGNATURE) * xcrush->SignatureCount);
 	xcrush->CompressionFlags = 0;
-	xcrush->ChunkHead = xcrush->ChunkTail = 1;
-	ZeroMemory(&(xcrush->Chunks), sizeof(xcrush->Chunks));
-	ZeroMemory(&(xcrush->NextChunks), sizeof(xcrush->NextChunks));
+	ZeroMemory(&(xcrush->ChunkIndex), sizeof(xcrush->ChunkIndex));
 	ZeroMemory(&(xcrush->OriginalMatches), sizeof(xcrush->OriginalMatches));
 	ZeroMemory(&(xcrush->OptimizedMatches), sizeof(xcrush->OptimizedMatches));
 
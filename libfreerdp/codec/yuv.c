@@ -740,6 +740,13 @@ static INLINE YUV_ENCODE_WORK_PARAM pool_encode_fill(const RECTANGLE_16* rect, Y
 	return current;
 }
 
+/* Steps start on a macroblock row, so the subsampled chroma rows of two steps never overlap */
+static UINT32 pool_encode_height_step(const YUV_CONTEXT* context)
+{
+	const UINT32 step = (context->heightStep + 15) & ~15u;
+	return MAX(16, step);
+}
+
 static BOOL pool_encode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE* pSrcData,
                         UINT32 nSrcStep, UINT32 SrcFormat, const UINT32 iStride[],
                         BYTE* pYUVLumaData[], BYTE* pYUVChromaData[],
@@ -748,6 +755,7 @@ static BOOL pool_encode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE*
 	BOOL rc = FALSE;
 	primitives_t* prims = primitives_get();
 	UINT32 x, y;
+	UINT32 heightStep;
 	UINT32 waitCount = 0;
 
 	WINPR_ASSERT(context);
@@ -776,20 +784,15 @@ static BOOL pool_encode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE*
 	}
 
 	/* case where we use threads */
-	for (x = 0; x < numRegionRects; x++)
-	{
-		const RECTANGLE_16* rect = &regionRects[x];
-		const UINT32 height = rect->bottom - rect->top;
-		const UINT32 steps = (height + context->heightStep / 2) / context->heightStep;
-
-		waitCount += steps;
-	}
+	heightStep = pool_encode_height_step(context);
 
 	for (x = 0; x < numRegionRects; x++)
 	{
 		const RECTANGLE_16* rect = &regionRects[x];
 		const UINT32 height = rect->bottom - rect->top;
-		const UINT32 steps = (height + context->heightStep / 2) / context->heightStep;
+
+		/* Rectangles smaller than a step, e.g. changed blocks, still need one */
+		const UINT32 steps = MAX(1, (height + heightStep / 2) / heightStep);
 
 		for (y = 0; y < steps; y++)
 		{
@@ -804,7 +807,12 @@ static BOOL pool_encode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE*
 			}
 
 			current = &context->work_enc_params[waitCount];
-			r.top += y * context->heightStep;
+			r.top += y * heightStep;
+
+			/* the last step takes the remaining rows */
+			if (y + 1 < steps)
+				r.bottom = r.top + heightStep;
+
 			*current = pool_encode_fill(&r, context, pSrcData, nSrcStep, SrcFormat, iStride,
 			                            pYUVLumaData, pYUVChromaData);
 			if (!submit_object(&context->work_objects[waitCount], cb, current, context))
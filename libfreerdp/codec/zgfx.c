@@ -40,6 +40,24 @@
  * Minimum match length: 3 bytes
  */
 
+#define ZGFX_HISTORY_SIZE 2500000
+#define ZGFX_MIN_MATCH 3
+#define ZGFX_MAX_MATCH ZGFX_SEGMENTED_MAXSIZE
+
+#define ZGFX_HASH_BITS 18
+#define ZGFX_HASH_SIZE (1 << ZGFX_HASH_BITS)
+
+/* The chain is indexed with the absolute position modulo its size, a power of two
+ * larger than the history so that no live entry is overwritten. */
+#define ZGFX_CHAIN_MIN_BITS 12
+
+/* Rebase absolute positions before they can wrap around */
+#define ZGFX_POSITION_LIMIT 0x7FFFFFFF
+
+/* Literal runs widen the search stride by one every 2^SkipShift misses */
+#define ZGFX_SKIP_MAX 64
+#define ZGFX_PROBE_SIZE 4096
+
 typedef struct
 {
 	UINT32 prefixLength;
@@ -64,9 +82,28 @@ struct S_ZGFX_CONTEXT
 	BYTE OutputBuffer[65536];
 	UINT32 OutputCount;
 
-	BYTE HistoryBuffer[2500000];
+	BYTE HistoryBuffer[ZGFX_HISTORY_SIZE];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+
+	/* Compressor state, only allocated if Compressor is TRUE */
+	UINT32 CompressionLevel;
+	UINT32 MaxChainLength;
+	UINT32 NiceLength;
+	BOOL LazyMatching;
+	UINT32 SkipShift;
+
+	BYTE* Window;
+	UINT32 WindowSize;
+	UINT32 WindowPos;
+	UINT32 WindowBase;
+	UINT32 InsertPos;
+	UINT32* HashHead;
+	UINT32* HashChain;
+	UINT32 ChainMask;
+
+	UINT32 LiteralCode[256];
+	UINT32 LiteralBits[256];
 };
 
 static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
@@ -253,6 +290,10 @@ static BOOL zgfx_decompress_segment(ZGFX_CONTEXT* zgfx, wStream* stream, size_t
 		return TRUE;
 	}
 
+	/* The last byte holds the number of padding bits */
+	if ((cbSegment < 1) || (pbSegment[cbSegment - 1] > 8 * (cbSegment - 1)))
+		return FALSE;
+
 	zgfx->pbInputCurrent = pbSegment;
 	zgfx->pbInputEnd = &pbSegment[cbSegment - 1];
 	/* NumberOfBitsToDecode = ((NumberOfBytesToDecode - 1) * 8) - ValueOfLastByte */
@@ -296,6 +337,9 @@ static BOOL zgfx_decompress_segment(ZGFX_CONTEXT* zgfx, wStream* stream, size_t
 					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
 					distance = ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits;
 
+					if (distance > zgfx->HistoryBufferSize)
+						return FALSE;
+
 					if (distance != 0)
 					{
 						/* Match */
@@ -460,10 +504,333 @@ fail:
 	return status;
 }
 
+typedef struct
+{
+	BYTE* pbOutput;
+	BYTE* pbOutputEnd;
+	UINT64 accumulator;
+	UINT32 offset;
+	BOOL overflow;
+} ZGFX_BIT_WRITER;
+
+static INLINE void zgfx_write_bits(ZGFX_BIT_WRITER* bw, UINT32 value, UINT32 nbits)
+{
+	bw->accumulator = (bw->accumulator << nbits) | (value & ((1ULL << nbits) - 1ULL));
+	bw->offset += nbits;
+
+	while (bw->offset >= 8)
+	{
+		bw->offset -= 8;
+
+		if (bw->pbOutput >= bw->pbOutputEnd)
+		{
+			bw->overflow = TRUE;
+			continue;
+		}
+
+		*bw->pbOutput++ = (BYTE)(bw->accumulator >> bw->offset);
+	}
+}
+
+static INLINE const ZGFX_TOKEN* zgfx_get_distance_token(UINT32 distance)
+{
+	const ZGFX_TOKEN* token;
+
+	for (token = ZGFX_TOKEN_TABLE; token->prefixLength != 0; token++)
+	{
+		if (token->tokenType != 1)
+			continue;
+
+		if ((distance >= token->valueBase) &&
+		    (distance - token->valueBase < (1UL << token->valueBits)))
+			return token;
+	}
+
+	return NULL;
+}
+
+static INLINE UINT32 zgfx_get_length_bits(UINT32 count)
+{
+	UINT32 k = 2;
+
+	if (count == ZGFX_MIN_MATCH)
+		return 1;
+
+	while ((count >> (k + 1)) != 0)
+		k++;
+
+	return 2 * k;
+}
+
+static INLINE void zgfx_write_literal(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* bw, BYTE c)
+{
+	zgfx_write_bits(bw, zgfx->LiteralCode[c], zgfx->LiteralBits[c]);
+}
+
+static INLINE void zgfx_write_match(ZGFX_BIT_WRITER* bw, const ZGFX_TOKEN* token, UINT32 distance,
+                                    UINT32 count)
+{
+	UINT32 k = 2;
+	zgfx_write_bits(bw, token->prefixCode, token->prefixLength);
+	zgfx_write_bits(bw, distance - token->valueBase, token->valueBits);
+
+	if (count == ZGFX_MIN_MATCH)
+	{
+		zgfx_write_bits(bw, 0, 1);
+		return;
+	}
+
+	while ((count >> (k + 1)) != 0)
+		k++;
+
+	/* (k - 1) one bits terminated by a zero bit, followed by k bits of count - 2^k */
+	zgfx_write_bits(bw, ((1UL << (k - 1)) - 1) << 1, k);
+	zgfx_write_bits(bw, count - (1UL << k), k);
+}
+
+/**
+ * Short matches with a large distance can be more expensive than the literals
+ * they replace, so only accept a match if it actually saves bits.
+ */
+static INLINE BOOL zgfx_match_is_cheaper(ZGFX_CONTEXT* zgfx, const ZGFX_TOKEN* token,
+                                         const BYTE* pbLiterals, UINT32 count)
+{
+	UINT32 index;
+	UINT32 literalBits = 0;
+	const UINT32 matchBits =
+	    token->prefixLength + token->valueBits + zgfx_get_length_bits(count);
+
+	/* Literals need at least 5 bits, long matches at most 35 bits */
+	if (count >= 8)
+		return TRUE;
+
+	for (index = 0; index < count; index++)
+		literalBits += zgfx->LiteralBits[pbLiterals[index]];
+
+	return matchBits < literalBits;
+}
+
+static INLINE UINT32 zgfx_hash(const BYTE* p)
+{
+	const UINT32 value = ((UINT32)p[0] << 16) | ((UINT32)p[1] << 8) | p[2];
+	return (UINT32)(value * 2654435761U) >> (32 - ZGFX_HASH_BITS);
+}
+
+static INLINE void zgfx_insert_until(ZGFX_CONTEXT* zgfx, UINT32 index)
+{
+	UINT32 end = 0;
+
+	/* Hashing a position requires two bytes of lookahead */
+	if (zgfx->WindowPos >= ZGFX_MIN_MATCH - 1)
+		end = MIN(index, zgfx->WindowPos - (ZGFX_MIN_MATCH - 1));
+
+	while (zgfx->InsertPos < end)
+	{
+		const UINT32 position = zgfx->WindowBase + zgfx->InsertPos;
+		const UINT32 hash = zgfx_hash(&zgfx->Window[zgfx->InsertPos]);
+		zgfx->HashChain[position & zgfx->ChainMask] = zgfx->HashHead[hash];
+		zgfx->HashHead[hash] = position;
+		zgfx->InsertPos++;
+	}
+}
+
+static UINT32 zgfx_find_match(ZGFX_CONTEXT* zgfx, UINT32 index, UINT32 end, UINT32* pDistance)
+{
+	const BYTE* pbCurrent = &zgfx->Window[index];
+	const UINT32 position = zgfx->WindowBase + index;
+	const UINT32 maxLength = MIN(end - index, ZGFX_MAX_MATCH);
+	const UINT32 maxDistance = MIN(index, zgfx->HistoryBufferSize);
+	UINT32 chainLength = zgfx->MaxChainLength;
+	UINT32 bestLength = 0;
+	UINT32 candidate;
+
+	if (maxLength < ZGFX_MIN_MATCH)
+		return 0;
+
+	candidate = zgfx->HashHead[zgfx_hash(pbCurrent)];
+
+	while (chainLength-- > 0)
+	{
+		UINT32 next;
+		const UINT32 distance = position - candidate;
+		const BYTE* pbMatch = pbCurrent - distance;
+
+		if ((candidate >= position) || (distance > maxDistance))
+			break;
+
+		if ((pbMatch[bestLength] == pbCurrent[bestLength]) && (pbMatch[0] == pbCurrent[0]))
+		{
+			UINT32 length = 1;
+
+			while ((length < maxLength) && (pbMatch[length] == pbCurrent[length]))
+				length++;
+
+			if (length > bestLength)
+			{
+				bestLength = length;
+				*pDistance = distance;
+
+				if ((length >= zgfx->NiceLength) || (length == maxLength))
+					break;
+			}
+		}
+
+		next = zgfx->HashChain[candidate & zgfx->ChainMask];
+
+		if (next >= candidate)
+			break;
+
+		candidate = next;
+	}
+
+	return (bestLength >= ZGFX_MIN_MATCH) ? bestLength : 0;
+}
+
+static void zgfx_window_append(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize)
+{
+	if (zgfx->WindowPos + SrcSize > zgfx->WindowSize)
+	{
+		/* Slide the window, keeping the full history the decoder can reference */
+		const UINT32 keep = MIN(zgfx->WindowPos, zgfx->HistoryBufferSize);
+		const UINT32 delta = zgfx->WindowPos - keep;
+		MoveMemory(zgfx->Window, &zgfx->Window[delta], keep);
+		zgfx->WindowBase += delta;
+		zgfx->WindowPos = keep;
+		zgfx->InsertPos = (zgfx->InsertPos > delta) ? zgfx->InsertPos - delta : 0;
+
+		if (zgfx->WindowBase > ZGFX_POSITION_LIMIT - zgfx->WindowSize)
+		{
+			/* Restart absolute positions, the retained history is re-indexed lazily */
+			ZeroMemory(zgfx->HashHead, ZGFX_HASH_SIZE * sizeof(UINT32));
+			zgfx->WindowBase = 0;
+			zgfx->InsertPos = 0;
+		}
+	}
+
+	CopyMemory(&zgfx->Window[zgfx->WindowPos], pSrcData, SrcSize);
+	zgfx->WindowPos += SrcSize;
+}
+
+/**
+ * Encode the window range [start, WindowPos) as a compressed RDP8 segment.
+ * Returns FALSE if the encoded data would not be smaller than DstCapacity.
+ *
+ * Runs without matches are searched with an increasing stride, and segments
+ * that do not shrink within the first ZGFX_PROBE_SIZE bytes are given up
+ * early, so already compressed codec payloads cost little more than a copy.
+ */
+static BOOL zgfx_compress_window(ZGFX_CONTEXT* zgfx, UINT32 start, BYTE* pDstData,
+                                 UINT32 DstCapacity, UINT32* pDstSize)
+{
+	UINT32 pad;
+	UINT32 index = start;
+	UINT32 misses = 0;
+	UINT32 skip = 0;
+	UINT32 pendingLength = 0;
+	UINT32 pendingDistance = 0;
+	const UINT32 end = zgfx->WindowPos;
+	ZGFX_BIT_WRITER bw = { 0 };
+
+	/* Reserve the last byte for the number of padding bits */
+	if (DstCapacity < 2)
+		return FALSE;
+
+	bw.pbOutput = pDstData;
+	bw.pbOutputEnd = &pDstData[DstCapacity - 1];
+
+	while ((index < end) && !bw.overflow)
+	{
+		UINT32 length;
+		UINT32 distance = 0;
+		const ZGFX_TOKEN* token = NULL;
+
+		if (skip > 0)
+		{
+			/* Index the last searched position but none of the skipped ones */
+			zgfx_insert_until(zgfx, index);
+			zgfx_write_literal(zgfx, &bw, zgfx->Window[index++]);
+			zgfx->InsertPos = MAX(zgfx->InsertPos, index);
+			skip--;
+			continue;
+		}
+
+		if ((index - start >= ZGFX_PROBE_SIZE) &&
+		    ((size_t)(bw.pbOutput - pDstData) >= (index - start)))
+			bw.overflow = TRUE;
+
+		zgfx_insert_until(zgfx, index);
+
+		if (pendingLength > 0)
+		{
+			length = pendingLength;
+			distance = pendingDistance;
+			pendingLength = 0;
+		}
+		else
+			length = zgfx_find_match(zgfx, index, end, &distance);
+
+		if (zgfx->LazyMatching && (length > 0) && (length < zgfx->NiceLength) &&
+		    (index + 1 < end))
+		{
+			UINT32 nextDistance = 0;
+			UINT32 nextLength;
+			zgfx_insert_until(zgfx, index + 1);
+			nextLength = zgfx_find_match(zgfx, index + 1, end, &nextDistance);
+
+			if (nextLength > length)
+			{
+				/* Defer: emit a literal now and take the longer match next */
+				pendingLength = nextLength;
+				pendingDistance = nextDistance;
+				length = 0;
+			}
+		}
+
+		if (length > 0)
+			token = zgfx_get_distance_token(distance);
+
+		if (token && zgfx_match_is_cheaper(zgfx, token, &zgfx->Window[index], length))
+		{
+			zgfx_write_match(&bw, token, distance, length);
+			index += length;
+			pendingLength = 0;
+			misses = 0;
+		}
+		else
+		{
+			zgfx_write_literal(zgfx, &bw, zgfx->Window[index]);
+			index++;
+
+			if ((pendingLength == 0) && (zgfx->SkipShift > 0))
+				skip = MIN(++misses >> zgfx->SkipShift, ZGFX_SKIP_MAX);
+		}
+	}
+
+	if (bw.overflow)
+	{
+		/* The segment is sent raw, do not index incompressible data */
+		zgfx->InsertPos = MAX(zgfx->InsertPos, end);
+		return FALSE;
+	}
+
+	zgfx_insert_until(zgfx, end);
+
+	pad = (8 - bw.offset) % 8;
+	zgfx_write_bits(&bw, 0, pad);
+
+	if (bw.overflow)
+		return FALSE;
+
+	*bw.pbOutput++ = (BYTE)pad;
+	*pDstSize = (UINT32)(bw.pbOutput - pDstData);
+	return TRUE;
+}
+
 static BOOL zgfx_compress_segment(ZGFX_CONTEXT* zgfx, wStream* s, const BYTE* pSrcData,
                                   UINT32 SrcSize, UINT32* pFlags)
 {
-	/* FIXME: Currently compression not implemented. Just copy the raw source */
+	BYTE header;
+
 	if (!Stream_EnsureRemainingCapacity(s, SrcSize + 1))
 	{
 		WLog_ERR(TAG, "Stream_EnsureRemainingCapacity failed!");
@@ -471,7 +838,34 @@ static BOOL zgfx_compress_segment(ZGFX_CONTEXT* zgfx, wStream* s, const BYTE* pS
 	}
 
 	(*pFlags) |= ZGFX_PACKET_COMPR_TYPE_RDP8; /* RDP 8.0 compression format */
-	Stream_Write_UINT8(s, (*pFlags));         /* header (1 byte) */
+	header = (BYTE)(*pFlags);
+
+	if (zgfx->Window && (SrcSize > 0))
+	{
+		UINT32 DstSize = 0;
+
+		/* The decoder adds every segment to its history, compressed or not */
+		zgfx_window_append(zgfx, pSrcData, SrcSize);
+
+		if (zgfx->CompressionLevel != ZGFX_COMPRESSION_LEVEL_NONE)
+		{
+			const size_t pos = Stream_GetPosition(s);
+			Stream_Write_UINT8(s, header | PACKET_COMPRESSED); /* header (1 byte) */
+
+			if (zgfx_compress_window(zgfx, zgfx->WindowPos - SrcSize, Stream_Pointer(s),
+			                         SrcSize, &DstSize) &&
+			    (DstSize < SrcSize))
+			{
+				Stream_Seek(s, DstSize);
+				return TRUE;
+			}
+
+			/* Incompressible, fall back to sending the raw data */
+			Stream_SetPosition(s, pos);
+		}
+	}
+
+	Stream_Write_UINT8(s, header); /* header (1 byte) */
 	Stream_Write(s, pSrcData, SrcSize);
 	return TRUE;
 }
@@ -570,20 +964,177 @@ int zgfx_compress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BYTE
 	return status;
 }
 
+BOOL zgfx_compress_segment_to_stream(ZGFX_CONTEXT* zgfx, wStream* sDst, const BYTE* pSrcData,
+                                     UINT32 SrcSize)
+{
+	UINT32 flags = 0;
+
+	if (!zgfx || !zgfx->Compressor || !sDst || (!pSrcData && (SrcSize > 0)) ||
+	    (SrcSize > ZGFX_SEGMENTED_MAXSIZE))
+		return FALSE;
+
+	return zgfx_compress_segment(zgfx, sDst, pSrcData, SrcSize, &flags);
+}
+
+BOOL zgfx_decompress_segment_to_stream(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize,
+                                       wStream* sDst)
+{
+	wStream sbuffer = { 0 };
+	wStream* s;
+
+	if (!zgfx || !pSrcData || !sDst)
+		return FALSE;
+
+	s = Stream_StaticConstInit(&sbuffer, pSrcData, SrcSize);
+
+	if (!zgfx_decompress_segment(zgfx, s, SrcSize))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(sDst, zgfx->OutputCount))
+		return FALSE;
+
+	Stream_Write(sDst, zgfx->OutputBuffer, zgfx->OutputCount);
+	return TRUE;
+}
+
 void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush)
 {
+	WINPR_UNUSED(flush);
 	zgfx->HistoryIndex = 0;
+
+	if (zgfx->HashHead)
+	{
+		/* Positions keep increasing, so everything indexed so far lies beyond the
+		 * history of the next segment and the hash table only needs clearing when
+		 * positions restart. */
+		if (zgfx->WindowBase + zgfx->WindowPos > ZGFX_POSITION_LIMIT - zgfx->WindowSize)
+		{
+			ZeroMemory(zgfx->HashHead, ZGFX_HASH_SIZE * sizeof(UINT32));
+			zgfx->WindowBase = 0;
+		}
+		else
+			zgfx->WindowBase += zgfx->WindowPos;
+	}
+
+	zgfx->WindowPos = 0;
+	zgfx->InsertPos = 0;
+}
+
+BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* zgfx, UINT32 level)
+{
+	if (!zgfx)
+		return FALSE;
+
+	switch (level)
+	{
+		case ZGFX_COMPRESSION_LEVEL_NONE:
+			zgfx->MaxChainLength = 0;
+			zgfx->NiceLength = 0;
+			zgfx->LazyMatching = FALSE;
+			zgfx->SkipShift = 0;
+			break;
+
+		case ZGFX_COMPRESSION_LEVEL_FAST:
+			zgfx->MaxChainLength = 4;
+			zgfx->NiceLength = 32;
+			zgfx->LazyMatching = FALSE;
+			zgfx->SkipShift = 4;
+			break;
+
+		case ZGFX_COMPRESSION_LEVEL_DEFAULT:
+			zgfx->MaxChainLength = 32;
+			zgfx->NiceLength = 128;
+			zgfx->LazyMatching = TRUE;
+			zgfx->SkipShift = 6;
+			break;
+
+		case ZGFX_COMPRESSION_LEVEL_BEST:
+			zgfx->MaxChainLength = 512;
+			zgfx->NiceLength = ZGFX_MAX_MATCH;
+			zgfx->LazyMatching = TRUE;
+			zgfx->SkipShift = 0;
+			break;
+
+		default:
+			WLog_ERR(TAG, "invalid compression level %" PRIu32, level);
+			return FALSE;
+	}
+
+	zgfx->CompressionLevel = level;
+	return TRUE;
+}
+
+static void zgfx_init_literal_table(ZGFX_CONTEXT* zgfx)
+{
+	size_t index;
+	const ZGFX_TOKEN* token;
+
+	/* Generic literal: prefix '0' followed by the 8 bit value */
+	for (index = 0; index < ARRAYSIZE(zgfx->LiteralCode); index++)
+	{
+		zgfx->LiteralCode[index] = (UINT32)index;
+		zgfx->LiteralBits[index] = 9;
+	}
+
+	for (token = ZGFX_TOKEN_TABLE; token->prefixLength != 0; token++)
+	{
+		if ((token->tokenType != 0) || (token->valueBits != 0))
+			continue;
+
+		if (token->prefixLength < zgfx->LiteralBits[token->valueBase])
+		{
+			zgfx->LiteralCode[token->valueBase] = token->prefixCode;
+			zgfx->LiteralBits[token->valueBase] = token->prefixLength;
+		}
+	}
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
+{
+	return zgfx_context_new_ex(Compressor, ZGFX_HISTORY_SIZE);
+}
+
+ZGFX_CONTEXT* zgfx_context_new_ex(BOOL Compressor, UINT32 HistorySize)
 {
 	ZGFX_CONTEXT* zgfx;
+
+	if ((HistorySize == 0) || (HistorySize > ZGFX_HISTORY_SIZE))
+	{
+		WLog_ERR(TAG, "invalid history size %" PRIu32, HistorySize);
+		return NULL;
+	}
+
 	zgfx = (ZGFX_CONTEXT*)calloc(1, sizeof(ZGFX_CONTEXT));
 
 	if (zgfx)
 	{
 		zgfx->Compressor = Compressor;
-		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
+		zgfx->HistoryBufferSize = HistorySize;
+
+		if (Compressor)
+		{
+			UINT32 chainBits = ZGFX_CHAIN_MIN_BITS;
+
+			while ((1UL << chainBits) <= HistorySize)
+				chainBits++;
+
+			/* Room for the history plus the largest segment */
+			zgfx->WindowSize = HistorySize + MAX(HistorySize, ZGFX_SEGMENTED_MAXSIZE);
+			zgfx->ChainMask = (1UL << chainBits) - 1;
+			zgfx->Window = (BYTE*)malloc(zgfx->WindowSize);
+			zgfx->HashHead = (UINT32*)calloc(ZGFX_HASH_SIZE, sizeof(UINT32));
+			zgfx->HashChain = (UINT32*)calloc(zgfx->ChainMask + 1, sizeof(UINT32));
+
+			if (!zgfx->Window || !zgfx->HashHead || !zgfx->HashChain)
+			{
+				zgfx_context_free(zgfx);
+				return NULL;
+			}
+
+			zgfx_init_literal_table(zgfx);
+			zgfx_context_set_compression_level(zgfx, ZGFX_COMPRESSION_LEVEL_DEFAULT);
+		}
+
 		zgfx_context_reset(zgfx, FALSE);
 	}
 
@@ -592,5 +1143,11 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->Window);
+	free(zgfx->HashHead);
+	free(zgfx->HashChain);
 	free(zgfx);
 }
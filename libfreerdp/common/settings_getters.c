@@ -99,6 +99,9 @@ BOOL freerdp_settings_get_bool(const rdpSettings* settings, size_t id)
 		case FreeRDP_ColorPointerFlag:
 			return settings->ColorPointerFlag;
 
+		case FreeRDP_CompressionAdaptive:
+			return settings->CompressionAdaptive;
+
 		case FreeRDP_CompressionEnabled:
 			return settings->CompressionEnabled;
 
@@ -168,6 +171,9 @@ BOOL freerdp_settings_get_bool(const rdpSettings* settings, size_t id)
 		case FreeRDP_DumpRemoteFx:
 			return settings->DumpRemoteFx;
 
+		case FreeRDP_DynamicChannelCompression:
+			return settings->DynamicChannelCompression;
+
 		case FreeRDP_DynamicDaylightTimeDisabled:
 			return settings->DynamicDaylightTimeDisabled;
 
@@ -237,6 +243,12 @@ BOOL freerdp_settings_get_bool(const rdpSettings* settings, size_t id)
 		case FreeRDP_GfxAVC444v2:
 			return settings->GfxAVC444v2;
 
+		case FreeRDP_GfxClearCodec:
+			return settings->GfxClearCodec;
+
+		case FreeRDP_GfxDirectOutput:
+			return settings->GfxDirectOutput;
+
 		case FreeRDP_GfxH264:
 			return settings->GfxH264;
 
@@ -513,6 +525,9 @@ BOOL freerdp_settings_get_bool(const rdpSettings* settings, size_t id)
 		case FreeRDP_TcpKeepAlive:
 			return settings->TcpKeepAlive;
 
+		case FreeRDP_TlsKernelOffload:
+			return settings->TlsKernelOffload;
+
 		case FreeRDP_TlsSecurity:
 			return settings->TlsSecurity;
 
@@ -661,6 +676,10 @@ BOOL freerdp_settings_set_bool(rdpSettings* settings, size_t id, BOOL val)
 			settings->ColorPointerFlag = cnv.c;
 			break;
 
+		case FreeRDP_CompressionAdaptive:
+			settings->CompressionAdaptive = cnv.c;
+			break;
+
 		case FreeRDP_CompressionEnabled:
 			settings->CompressionEnabled = cnv.c;
 			break;
@@ -753,6 +772,10 @@ BOOL freerdp_settings_set_bool(rdpSettings* settings, size_t id, BOOL val)
 			settings->DumpRemoteFx = cnv.c;
 			break;
 
+		case FreeRDP_DynamicChannelCompression:
+			settings->DynamicChannelCompression = cnv.c;
+			break;
+
 		case FreeRDP_DynamicDaylightTimeDisabled:
 			settings->DynamicDaylightTimeDisabled = cnv.c;
 			break;
@@ -845,6 +868,14 @@ BOOL freerdp_settings_set_bool(rdpSettings* settings, size_t id, BOOL val)
 			settings->GfxAVC444v2 = cnv.c;
 			break;
 
+		case FreeRDP_GfxClearCodec:
+			settings->GfxClearCodec = cnv.c;
+			break;
+
+		case FreeRDP_GfxDirectOutput:
+			settings->GfxDirectOutput = cnv.c;
+			break;
+
 		case FreeRDP_GfxH264:
 			settings->GfxH264 = cnv.c;
 			break;
@@ -1213,6 +1244,10 @@ BOOL freerdp_settings_set_bool(rdpSettings* settings, size_t id, BOOL val)
 			settings->TcpKeepAlive = cnv.c;
 			break;
 
+		case FreeRDP_TlsKernelOffload:
+			settings->TlsKernelOffload = cnv.c;
+			break;
+
 		case FreeRDP_TlsSecurity:
 			settings->TlsSecurity = cnv.c;
 			break;
@@ -1492,6 +1527,9 @@ UINT32 freerdp_settings_get_uint32(const rdpSettings* settings, size_t id)
 		case FreeRDP_GlyphSupportLevel:
 			return settings->GlyphSupportLevel;
 
+		case FreeRDP_InputCoalesceInterval:
+			return settings->InputCoalesceInterval;
+
 		case FreeRDP_JpegCodecId:
 			return settings->JpegCodecId;
 
@@ -1911,6 +1949,10 @@ BOOL freerdp_settings_set_uint32(rdpSettings* settings, size_t id, UINT32 val)
 			settings->GlyphSupportLevel = cnv.c;
 			break;
 
+		case FreeRDP_InputCoalesceInterval:
+			settings->InputCoalesceInterval = cnv.c;
+			break;
+
 		case FreeRDP_JpegCodecId:
 			settings->JpegCodecId = cnv.c;
 			break;
@@ -2361,6 +2403,9 @@ const char* freerdp_settings_get_string(const rdpSettings* settings, size_t id)
 		case FreeRDP_AuthenticationServiceClass:
 			return settings->AuthenticationServiceClass;
 
+		case FreeRDP_BitmapCachePersistFile:
+			return settings->BitmapCachePersistFile;
+
 		case FreeRDP_CardName:
 			return settings->CardName;
 
@@ -2436,6 +2481,9 @@ const char* freerdp_settings_get_string(const rdpSettings* settings, size_t id)
 		case FreeRDP_GatewayUsername:
 			return settings->GatewayUsername;
 
+		case FreeRDP_GfxCachePersistFile:
+			return settings->GfxCachePersistFile;
+
 		case FreeRDP_HomePath:
 			return settings->HomePath;
 
@@ -2619,6 +2667,9 @@ char* freerdp_settings_get_string_writable(rdpSettings* settings, size_t id)
 		case FreeRDP_AuthenticationServiceClass:
 			return settings->AuthenticationServiceClass;
 
+		case FreeRDP_BitmapCachePersistFile:
+			return settings->BitmapCachePersistFile;
+
 		case FreeRDP_CardName:
 			return settings->CardName;
 
@@ -2694,6 +2745,9 @@ char* freerdp_settings_get_string_writable(rdpSettings* settings, size_t id)
 		case FreeRDP_GatewayUsername:
 			return settings->GatewayUsername;
 
+		case FreeRDP_GfxCachePersistFile:
+			return settings->GfxCachePersistFile;
+
 		case FreeRDP_HomePath:
 			return settings->HomePath;
 
@@ -2887,6 +2941,9 @@ BOOL freerdp_settings_set_string_(rdpSettings* settings, size_t id, const char*
 		case FreeRDP_AuthenticationServiceClass:
 			return update_string(&settings->AuthenticationServiceClass, cnv.cc, len, cleanup);
 
+		case FreeRDP_BitmapCachePersistFile:
+			return update_string(&settings->BitmapCachePersistFile, cnv.cc, len, cleanup);
+
 		case FreeRDP_CardName:
 			return update_string(&settings->CardName, cnv.cc, len, cleanup);
 
@@ -2962,6 +3019,9 @@ BOOL freerdp_settings_set_string_(rdpSettings* settings, size_t id, const char*
 		case FreeRDP_GatewayUsername:
 			return update_string(&settings->GatewayUsername, cnv.cc, len, cleanup);
 
+		case FreeRDP_GfxCachePersistFile:
+			return update_string(&settings->GfxCachePersistFile, cnv.cc, len, cleanup);
+
 		case FreeRDP_HomePath:
 			return update_string(&settings->HomePath, cnv.cc, len, cleanup);
 
@@ -36,6 +36,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_CertificateCallbackPreferPEM, 0, "FreeRDP_CertificateCallbackPreferPEM" },
 	{ FreeRDP_CertificateUseKnownHosts, 0, "FreeRDP_CertificateUseKnownHosts" },
 	{ FreeRDP_ColorPointerFlag, 0, "FreeRDP_ColorPointerFlag" },
+	{ FreeRDP_CompressionAdaptive, 0, "FreeRDP_CompressionAdaptive" },
 	{ FreeRDP_CompressionEnabled, 0, "FreeRDP_CompressionEnabled" },
 	{ FreeRDP_ConsoleSession, 0, "FreeRDP_ConsoleSession" },
 	{ FreeRDP_CredentialsFromStdin, 0, "FreeRDP_CredentialsFromStdin" },
@@ -59,6 +60,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_DrawGdiPlusEnabled, 0, "FreeRDP_DrawGdiPlusEnabled" },
 	{ FreeRDP_DrawNineGridEnabled, 0, "FreeRDP_DrawNineGridEnabled" },
 	{ FreeRDP_DumpRemoteFx, 0, "FreeRDP_DumpRemoteFx" },
+	{ FreeRDP_DynamicChannelCompression, 0, "FreeRDP_DynamicChannelCompression" },
 	{ FreeRDP_DynamicDaylightTimeDisabled, 0, "FreeRDP_DynamicDaylightTimeDisabled" },
 	{ FreeRDP_DynamicResolutionUpdate, 0, "FreeRDP_DynamicResolutionUpdate" },
 	{ FreeRDP_EmbeddedWindow, 0, "FreeRDP_EmbeddedWindow" },
@@ -82,6 +84,8 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_GatewayUseSameCredentials, 0, "FreeRDP_GatewayUseSameCredentials" },
 	{ FreeRDP_GfxAVC444, 0, "FreeRDP_GfxAVC444" },
 	{ FreeRDP_GfxAVC444v2, 0, "FreeRDP_GfxAVC444v2" },
+	{ FreeRDP_GfxClearCodec, 0, "FreeRDP_GfxClearCodec" },
+	{ FreeRDP_GfxDirectOutput, 0, "FreeRDP_GfxDirectOutput" },
 	{ FreeRDP_GfxH264, 0, "FreeRDP_GfxH264" },
 	{ FreeRDP_GfxPlanar, 0, "FreeRDP_GfxPlanar" },
 	{ FreeRDP_GfxProgressive, 0, "FreeRDP_GfxProgressive" },
@@ -174,6 +178,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_SurfaceFrameMarkerEnabled, 0, "FreeRDP_SurfaceFrameMarkerEnabled" },
 	{ FreeRDP_SuspendInput, 0, "FreeRDP_SuspendInput" },
 	{ FreeRDP_TcpKeepAlive, 0, "FreeRDP_TcpKeepAlive" },
+	{ FreeRDP_TlsKernelOffload, 0, "FreeRDP_TlsKernelOffload" },
 	{ FreeRDP_TlsSecurity, 0, "FreeRDP_TlsSecurity" },
 	{ FreeRDP_ToggleFullscreen, 0, "FreeRDP_ToggleFullscreen" },
 	{ FreeRDP_TransportDump, 0, "FreeRDP_TransportDump" },
@@ -233,6 +238,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_GatewayUsageMethod, 3, "FreeRDP_GatewayUsageMethod" },
 	{ FreeRDP_GfxCapsFilter, 3, "FreeRDP_GfxCapsFilter" },
 	{ FreeRDP_GlyphSupportLevel, 3, "FreeRDP_GlyphSupportLevel" },
+	{ FreeRDP_InputCoalesceInterval, 3, "FreeRDP_InputCoalesceInterval" },
 	{ FreeRDP_JpegCodecId, 3, "FreeRDP_JpegCodecId" },
 	{ FreeRDP_JpegQuality, 3, "FreeRDP_JpegQuality" },
 	{ FreeRDP_KeySpec, 3, "FreeRDP_KeySpec" },
@@ -316,6 +322,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_AlternateShell, 7, "FreeRDP_AlternateShell" },
 	{ FreeRDP_AssistanceFile, 7, "FreeRDP_AssistanceFile" },
 	{ FreeRDP_AuthenticationServiceClass, 7, "FreeRDP_AuthenticationServiceClass" },
+	{ FreeRDP_BitmapCachePersistFile, 7, "FreeRDP_BitmapCachePersistFile" },
 	{ FreeRDP_CardName, 7, "FreeRDP_CardName" },
 	{ FreeRDP_CertificateAcceptedFingerprints, 7, "FreeRDP_CertificateAcceptedFingerprints" },
 	{ FreeRDP_CertificateContent, 7, "FreeRDP_CertificateContent" },
@@ -341,6 +348,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_GatewayHostname, 7, "FreeRDP_GatewayHostname" },
 	{ FreeRDP_GatewayPassword, 7, "FreeRDP_GatewayPassword" },
 	{ FreeRDP_GatewayUsername, 7, "FreeRDP_GatewayUsername" },
+	{ FreeRDP_GfxCachePersistFile, 7, "FreeRDP_GfxCachePersistFile" },
 	{ FreeRDP_HomePath, 7, "FreeRDP_HomePath" },
 	{ FreeRDP_ImeFileName, 7, "FreeRDP_ImeFileName" },
 	{ FreeRDP_KerberosArmor, 7, "FreeRDP_KerberosArmor" },
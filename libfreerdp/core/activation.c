@@ -21,6 +21,8 @@
 
 #include <winpr/assert.h>
 
+#include <freerdp/cache/persistent.h>
+
 #include "activation.h"
 #include "display.h"
 
@@ -236,54 +238,176 @@ BOOL rdp_send_client_control_pdu(rdpRdp* rdp, UINT16 action)
 	return rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_CONTROL, rdp->mcs->userId);
 }
 
-static BOOL rdp_write_persistent_list_entry(wStream* s, UINT32 key1, UINT32 key2)
+typedef struct
 {
-	WINPR_ASSERT(s);
+	UINT32 totalEntries[5];
+	UINT32 sentEntries[5];
+	UINT64* keys[5];
+} RDP_PERSISTENT_KEY_LIST;
 
-	if (Stream_GetRemainingCapacity(s) < 8)
+static void rdp_free_persistent_keys(RDP_PERSISTENT_KEY_LIST* list)
+{
+	size_t x;
+
+	WINPR_ASSERT(list);
+
+	for (x = 0; x < ARRAYSIZE(list->keys); x++)
+		free(list->keys[x]);
+}
+
+/**
+ * Collect the keys of the persistent bitmap cache file.
+ * Entries are assigned with persistent_cache_limits_accept, like the bitmap cache loads them.
+ */
+static BOOL rdp_load_persistent_keys(const rdpSettings* settings, RDP_PERSISTENT_KEY_LIST* list)
+{
+	UINT32 x;
+	int status;
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+	PERSISTENT_CACHE_LIMITS limits = { 0 };
+	rdpPersistentCache* persistent;
+	const char* filename = freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile);
+
+	if (!filename)
+		return TRUE;
+
+	if (!persistent_cache_limits_init(&limits, settings))
 		return FALSE;
-	Stream_Write_UINT32(s, key1); /* key1 (4 bytes) */
-	Stream_Write_UINT32(s, key2); /* key2 (4 bytes) */
-	return TRUE;
+
+	for (x = 0; x < limits.numCells; x++)
+	{
+		if (limits.maxEntries[x] == 0)
+			continue;
+
+		list->keys[x] = (UINT64*)calloc(limits.maxEntries[x], sizeof(UINT64));
+
+		if (!list->keys[x])
+			return FALSE;
+	}
+
+	persistent = persistent_cache_new();
+
+	if (!persistent)
+		return FALSE;
+
+	/* A missing store simply means there is nothing to advertise */
+	if (!persistent_cache_open(persistent, filename, FALSE))
+	{
+		persistent_cache_free(persistent);
+		return TRUE;
+	}
+
+	while ((status = persistent_cache_read_entry(persistent, &entry)) > 0)
+	{
+		UINT32 index = 0;
+
+		if (!persistent_cache_limits_accept(&limits, entry.cacheId, &index))
+			continue;
+
+		list->keys[entry.cacheId][index] = entry.key64;
+	}
+
+	for (x = 0; x < limits.numCells; x++)
+		list->totalEntries[x] = limits.numEntries[x];
+
+	persistent_cache_free(persistent);
+	WLog_DBG(TAG, "advertising %" PRIu32 " persistent bitmap cache keys", limits.total);
+	return status >= 0;
 }
 
-static BOOL rdp_write_client_persistent_key_list_pdu(wStream* s, const rdpSettings* settings)
+static BOOL rdp_write_client_persistent_key_list_pdu(wStream* s, RDP_PERSISTENT_KEY_LIST* list)
 {
+	size_t x;
+	UINT32 i;
+	BYTE flags = 0;
+	UINT32 available = PERSISTENT_KEYS_MAX_PER_PDU;
+	UINT32 numEntries[5] = { 0 };
+	BOOL first = TRUE;
+	BOOL last = TRUE;
+
 	WINPR_ASSERT(s);
-	WINPR_ASSERT(settings);
+	WINPR_ASSERT(list);
+
+	for (x = 0; x < ARRAYSIZE(numEntries); x++)
+	{
+		const UINT32 remaining = list->totalEntries[x] - list->sentEntries[x];
+
+		if (list->sentEntries[x] > 0)
+			first = FALSE;
+
+		numEntries[x] = MIN(remaining, available);
+		available -= numEntries[x];
+
+		if (numEntries[x] < remaining)
+			last = FALSE;
+	}
+
+	if (first)
+		flags |= PERSIST_FIRST_PDU;
+
+	if (last)
+		flags |= PERSIST_LAST_PDU;
+
+	if (!Stream_EnsureRemainingCapacity(s, 24 + (PERSISTENT_KEYS_MAX_PER_PDU - available) * 8ull))
+		return FALSE;
+
+	for (x = 0; x < ARRAYSIZE(numEntries); x++)
+		Stream_Write_UINT16(s, (UINT16)numEntries[x]); /* numEntriesCacheX (2 bytes) */
+
+	for (x = 0; x < ARRAYSIZE(numEntries); x++)
+		Stream_Write_UINT16(s, (UINT16)list->totalEntries[x]); /* totalEntriesCacheX (2 bytes) */
+
+	Stream_Write_UINT8(s, flags); /* bBitMask (1 byte) */
+	Stream_Write_UINT8(s, 0);     /* pad1 (1 byte) */
+	Stream_Write_UINT16(s, 0);    /* pad3 (2 bytes) */
+
+	/* entries */
+	for (x = 0; x < ARRAYSIZE(numEntries); x++)
+	{
+		for (i = 0; i < numEntries[x]; i++)
+		{
+			const UINT64 key64 = list->keys[x][list->sentEntries[x]++];
+			Stream_Write_UINT32(s, (UINT32)(key64 & 0xFFFFFFFF)); /* key1 (4 bytes) */
+			Stream_Write_UINT32(s, (UINT32)(key64 >> 32));        /* key2 (4 bytes) */
+		}
+	}
 
-	if (Stream_GetRemainingCapacity(s) < 24)
-		return FALSE;
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache0 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache1 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache2 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache3 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache4 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache0 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache1 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache2 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache3 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache4 (2 bytes) */
-	Stream_Write_UINT8(s, PERSIST_FIRST_PDU | PERSIST_LAST_PDU); /* bBitMask (1 byte) */
-	Stream_Write_UINT8(s, 0);                                    /* pad1 (1 byte) */
-	Stream_Write_UINT16(s, 0);                                   /* pad3 (2 bytes) */
-	                                                             /* entries */
 	return TRUE;
 }
 
 BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp)
 {
-	wStream* s = rdp_data_pdu_init(rdp);
-	if (!s)
-		return FALSE;
-	if (!rdp_write_client_persistent_key_list_pdu(s, rdp->settings))
+	BOOL rc = FALSE;
+	RDP_PERSISTENT_KEY_LIST list = { 0 };
+
+	WINPR_ASSERT(rdp);
+
+	if (!rdp_load_persistent_keys(rdp->settings, &list))
+		goto fail;
+
+	do
 	{
-		Stream_Free(s, TRUE);
-		return FALSE;
-	}
+		wStream* s = rdp_data_pdu_init(rdp);
 
-	WINPR_ASSERT(rdp->mcs);
-	return rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST, rdp->mcs->userId);
+		if (!s)
+			goto fail;
+
+		if (!rdp_write_client_persistent_key_list_pdu(s, &list))
+		{
+			Stream_Free(s, TRUE);
+			goto fail;
+		}
+
+		WINPR_ASSERT(rdp->mcs);
+		if (!rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST,
+		                       rdp->mcs->userId))
+			goto fail;
+	} while (memcmp(list.sentEntries, list.totalEntries, sizeof(list.sentEntries)) != 0);
+
+	rc = TRUE;
+fail:
+	rdp_free_persistent_keys(&list);
+	return rc;
 }
 
 BOOL rdp_recv_client_font_list_pdu(wStream* s)
@@ -97,7 +97,7 @@ BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width
 
 	if ((flags & FREERDP_CODEC_NSCODEC))
 	{
-		if (!(codecs->nsc = nsc_context_new()))
+		if (!(codecs->nsc = nsc_context_new_ex(codecs->context->settings->ThreadingFlags)))
 		{
 			WLog_ERR(TAG, "Failed to create nsc codec context");
 			return FALSE;
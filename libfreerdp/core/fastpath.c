@@ -1148,7 +1148,7 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 
 		if (settings->CompressionEnabled && !skipCompression)
 		{
-			if (bulk_compress(rdp->bulk, pSrcData, SrcSize, &pDstData, &DstSize,
+			if (bulk_compress(rdp->bulk, updateCode, pSrcData, SrcSize, &pDstData, &DstSize,
 			                  &compressionFlags) >= 0)
 			{
 				if (compressionFlags)
@@ -1202,6 +1202,25 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 		fastpath_write_update_pdu_header(fs, &fpUpdatePduHeader, rdp);
 		fastpath_write_update_header(fs, &fpUpdateHeader);
 
+		if (!(rdp->sec_flags & SEC_ENCRYPT))
+		{
+			/* Send the payload from the update or compressor buffer instead of copying it */
+			wStream payload;
+			wStream* streams[2];
+			streams[0] = fs;
+			streams[1] = Stream_StaticConstInit(&payload, pDstData, DstSize);
+			Stream_SetPosition(streams[1], DstSize);
+
+			if (transport_writev(rdp->transport, streams, ARRAYSIZE(streams)) < 0)
+			{
+				status = FALSE;
+				break;
+			}
+
+			Stream_Seek(s, SrcSize);
+			continue;
+		}
+
 		if (Stream_GetRemainingCapacity(fs) < (size_t)DstSize + pad)
 			return FALSE;
 		Stream_Write(fs, pDstData, DstSize);
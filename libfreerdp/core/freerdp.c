@@ -287,6 +287,9 @@ BOOL freerdp_check_fds(freerdp* instance)
 	rdp = instance->context->rdp;
 	status = rdp_check_fds(rdp);
 
+	if ((status >= 0) && !input_flush_pending(rdp->input, FALSE))
+		status = -1;
+
 	if (status < 0)
 	{
 		TerminateEventArgs e;
@@ -323,6 +326,9 @@ DWORD freerdp_get_event_handles(rdpContext* context, HANDLE* events, DWORD count
 	else
 		return 0;
 
+	if (nCount < count)
+		nCount += input_get_event_handles(context->rdp->input, &events[nCount], count - nCount);
+
 	return nCount;
 }
 
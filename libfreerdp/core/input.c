@@ -274,64 +274,304 @@ static BOOL input_send_keyboard_pause_event(rdpInput* input)
 	                                 RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
 }
 
-static BOOL input_send_fastpath_synchronize_event(rdpInput* input, UINT32 flags)
+/* Interval of the coalescing statistics in the debug log */
+#define INPUT_COALESCE_REPORT_INTERVAL 10000
+
+static void input_coalesce_report(rdp_input_internal* in, UINT64 now, BOOL force)
+{
+	const rdpInputCoalesceStats* stats;
+
+	WINPR_ASSERT(in);
+	stats = &in->stats;
+
+	if (!force && (now - stats->lastReport < INPUT_COALESCE_REPORT_INTERVAL))
+		return;
+
+	in->stats.lastReport = now;
+
+	if (stats->pdus == 0)
+		return;
+
+	WLog_DBG(TAG,
+	         "input: %" PRIu64 " events in %" PRIu64 " PDUs, %" PRIu64 " of %" PRIu64
+	         " moves coalesced, %" PRIu64 " delayed by %" PRIu64 " ms on average (max %" PRIu64
+	         " ms)",
+	         stats->events, stats->pdus, stats->coalesced, stats->moves, stats->delayed,
+	         stats->delayed ? stats->latencySum / stats->delayed : 0, stats->latencyMax);
+}
+
+static void input_coalesce_arm_timer(rdp_input_internal* in, UINT64 timeout)
+{
+	LARGE_INTEGER due;
+
+	WINPR_ASSERT(in);
+
+	if (!in->coalesceTimer)
+		return;
+
+	due.QuadPart = -(LONGLONG)(timeout * 10000ULL); /* relative, 100 ns units */
+
+	if (!SetWaitableTimer(in->coalesceTimer, &due, 0, NULL, NULL, FALSE))
+		WLog_WARN(TAG, "failed to arm the input coalescing timer");
+}
+
+/* Must be called with in->lock held */
+static void input_coalesce_account_sent(rdp_input_internal* in, UINT64 now)
+{
+	const UINT64 latency = now - in->moveQueued;
+
+	in->movePending = FALSE;
+	in->lastMoveSent = now;
+	in->stats.delayed++;
+	in->stats.latencySum += latency;
+
+	if (latency > in->stats.latencyMax)
+		in->stats.latencyMax = latency;
+}
+
+/**
+ * Decides what to do with a fast-path mouse event.
+ * The first move of an interval is sent right away, later moves only update the pending
+ * position which is sent when the interval expires or prepended to the next event.
+ * Returns TRUE if the event was queued and must not be sent by the caller.
+ */
+static BOOL input_coalesce_mouse_move(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
+{
+	BOOL queued = FALSE;
+	UINT64 now;
+	rdp_input_internal* in = input_cast(input);
+
+	if ((in->coalesceInterval == 0) || (flags != PTR_FLAGS_MOVE))
+		return FALSE;
+
+	now = GetTickCount64();
+	EnterCriticalSection(&in->lock);
+	in->stats.moves++;
+
+	if (in->movePending)
+	{
+		in->stats.coalesced++;
+
+		/* The client loop did not get to the timer yet, this move replaces the pending one */
+		if (now - in->lastMoveSent >= in->coalesceInterval)
+			input_coalesce_account_sent(in, now);
+		else
+		{
+			in->moveX = x;
+			in->moveY = y;
+			queued = TRUE;
+		}
+	}
+	else if (now - in->lastMoveSent < in->coalesceInterval)
+	{
+		in->movePending = TRUE;
+		in->moveX = x;
+		in->moveY = y;
+		in->moveQueued = now;
+		input_coalesce_arm_timer(in, in->coalesceInterval - (now - in->lastMoveSent));
+		queued = TRUE;
+	}
+	else
+		in->lastMoveSent = now;
+
+	LeaveCriticalSection(&in->lock);
+	return queued;
+}
+
+/**
+ * Starts a fast-path input PDU. A pending mouse move is written as first event so it
+ * reaches the server before the event that caused the flush.
+ * count receives the number of events already written.
+ */
+static wStream* input_fastpath_pdu_init_header(rdpInput* input, size_t* count)
 {
 	wStream* s;
 	rdpRdp* rdp;
+	rdp_input_internal* in = input_cast(input);
 
-	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
+	WINPR_ASSERT(count);
 
 	rdp = input->context->rdp;
 	WINPR_ASSERT(rdp);
 
+	*count = 0;
+	s = fastpath_input_pdu_init_header(rdp->fastpath);
+
+	if (!s)
+		return NULL;
+
+	EnterCriticalSection(&in->lock);
+
+	if (in->movePending)
+	{
+		Stream_Write_UINT8(s, FASTPATH_INPUT_EVENT_MOUSE << 5); /* eventHeader (1 byte) */
+		input_write_mouse_event(s, PTR_FLAGS_MOVE, in->moveX, in->moveY);
+		input_coalesce_account_sent(in, GetTickCount64());
+		*count = 1;
+	}
+
+	LeaveCriticalSection(&in->lock);
+	return s;
+}
+
+static wStream* input_fastpath_pdu_init(rdpInput* input, BYTE eventFlags, BYTE eventCode,
+                                        size_t* count)
+{
+	wStream* s = input_fastpath_pdu_init_header(input, count);
+
+	if (!s)
+		return NULL;
+
+	Stream_Write_UINT8(s, eventFlags | (eventCode << 5)); /* eventHeader (1 byte) */
+	return s;
+}
+
+static BOOL input_fastpath_send(rdpInput* input, wStream* s, size_t count)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	WINPR_ASSERT(input->context);
+	WINPR_ASSERT(input->context->rdp);
+
+	if (in->coalesceInterval > 0)
+	{
+		EnterCriticalSection(&in->lock);
+		in->stats.events += count;
+		in->stats.pdus++;
+		input_coalesce_report(in, GetTickCount64(), FALSE);
+		LeaveCriticalSection(&in->lock);
+	}
+
+	return fastpath_send_multiple_input_pdu(input->context->rdp->fastpath, s, count);
+}
+
+BOOL input_flush_pending(rdpInput* input, BOOL force)
+{
+	BOOL due = FALSE;
+	size_t count = 0;
+	wStream* s;
+	rdpRdp* rdp;
+	rdp_input_internal* in;
+
+	if (!input || !input->context)
+		return FALSE;
+
+	in = input_cast(input);
+
+	if (in->coalesceInterval == 0)
+		return TRUE;
+
+	EnterCriticalSection(&in->lock);
+
+	if (in->movePending)
+	{
+		const UINT64 elapsed = GetTickCount64() - in->lastMoveSent;
+
+		due = force || (elapsed >= in->coalesceInterval);
+
+		/* Woken up early (timer and tick count granularity differ), wait for the rest */
+		if (!due)
+			input_coalesce_arm_timer(in, in->coalesceInterval - elapsed);
+	}
+
+	LeaveCriticalSection(&in->lock);
+
+	if (!due)
+		return TRUE;
+
+	rdp = input->context->rdp;
+	WINPR_ASSERT(rdp);
+
+	/* The server is (re)activating, the position is outdated once it is back */
+	if (rdp_get_state(rdp) != CONNECTION_STATE_ACTIVE)
+	{
+		EnterCriticalSection(&in->lock);
+		in->movePending = FALSE;
+		LeaveCriticalSection(&in->lock);
+		return TRUE;
+	}
+
+	s = input_fastpath_pdu_init_header(input, &count);
+
+	if (!s)
+		return FALSE;
+
+	/* Another thread sent the move with its own event in the meantime */
+	if (count == 0)
+	{
+		Stream_Release(s);
+		return TRUE;
+	}
+
+	return input_fastpath_send(input, s, count);
+}
+
+DWORD input_get_event_handles(rdpInput* input, HANDLE* events, DWORD count)
+{
+	rdp_input_internal* in;
+
+	if (!input || !events || (count == 0))
+		return 0;
+
+	in = input_cast(input);
+
+	if (!in->coalesceTimer)
+		return 0;
+
+	events[0] = in->coalesceTimer;
+	return 1;
+}
+
+static BOOL input_send_fastpath_synchronize_event(rdpInput* input, UINT32 flags)
+{
+	wStream* s;
+	size_t count = 0;
+
+	WINPR_ASSERT(input);
+	WINPR_ASSERT(input->context);
+
 	/* The FastPath Synchronization eventFlags has identical values as SlowPath */
-	s = fastpath_input_pdu_init(rdp->fastpath, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC);
+	s = input_fastpath_pdu_init(input, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC, &count);
 
 	if (!s)
 		return FALSE;
 
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	return input_fastpath_send(input, s, count + 1);
 }
 
 static BOOL input_send_fastpath_keyboard_event(rdpInput* input, UINT16 flags, UINT8 code)
 {
 	wStream* s;
+	size_t count = 0;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED) ? FASTPATH_INPUT_KBDFLAGS_EXTENDED : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED1) ? FASTPATH_INPUT_KBDFLAGS_PREFIX_E1 : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE);
+	s = input_fastpath_pdu_init(input, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE, &count);
 
 	if (!s)
 		return FALSE;
 
 	WINPR_ASSERT(code <= UINT8_MAX);
 	Stream_Write_UINT8(s, (UINT8)code); /* keyCode (1 byte) */
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	return input_fastpath_send(input, s, count + 1);
 }
 
 static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
 {
 	wStream* s;
+	size_t count = 0;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!freerdp_settings_get_bool(input->context->settings, FreeRDP_UnicodeInput))
 	{
 		WLog_WARN(TAG, "Unicode input not supported by server.");
@@ -339,27 +579,24 @@ static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 f
 	}
 
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_UNICODE);
+	s = input_fastpath_pdu_init(input, eventFlags, FASTPATH_INPUT_EVENT_UNICODE, &count);
 
 	if (!s)
 		return FALSE;
 
 	Stream_Write_UINT16(s, code); /* unicodeCode (2 bytes) */
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	return input_fastpath_send(input, s, count + 1);
 }
 
 static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
 {
 	wStream* s;
-	rdpRdp* rdp;
+	size_t count = 0;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!freerdp_settings_get_bool(input->context->settings, FreeRDP_HasHorizontalWheel))
 	{
 		if (flags & PTR_FLAGS_HWHEEL)
@@ -372,27 +609,27 @@ static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT1
 		}
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSE);
+	if (input_coalesce_mouse_move(input, flags, x, y))
+		return TRUE;
+
+	s = input_fastpath_pdu_init(input, 0, FASTPATH_INPUT_EVENT_MOUSE, &count);
 
 	if (!s)
 		return FALSE;
 
 	input_write_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	return input_fastpath_send(input, s, count + 1);
 }
 
 static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 flags, UINT16 x,
                                                      UINT16 y)
 {
 	wStream* s;
-	rdpRdp* rdp;
+	size_t count = 0;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!freerdp_settings_get_bool(input->context->settings, FreeRDP_HasExtendedMouseEvent))
 	{
 		WLog_WARN(TAG,
@@ -402,28 +639,25 @@ static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 fla
 		return TRUE;
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSEX);
+	s = input_fastpath_pdu_init(input, 0, FASTPATH_INPUT_EVENT_MOUSEX, &count);
 
 	if (!s)
 		return FALSE;
 
 	input_write_extended_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	return input_fastpath_send(input, s, count + 1);
 }
 
 static BOOL input_send_fastpath_focus_in_event(rdpInput* input, UINT16 toggleStates)
 {
 	wStream* s;
+	size_t count = 0;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
-	s = fastpath_input_pdu_init_header(rdp->fastpath);
+	s = input_fastpath_pdu_init_header(input, &count);
 
 	if (!s)
 		return FALSE;
@@ -439,7 +673,7 @@ static BOOL input_send_fastpath_focus_in_event(rdpInput* input, UINT16 toggleSta
 	eventFlags = FASTPATH_INPUT_KBDFLAGS_RELEASE | FASTPATH_INPUT_EVENT_SCANCODE << 5;
 	Stream_Write_UINT8(s, eventFlags); /* Key Release event (1 byte) */
 	Stream_Write_UINT8(s, 0x0f);       /* keyCode (1 byte) */
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 3);
+	return input_fastpath_send(input, s, count + 3);
 }
 
 static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
@@ -449,17 +683,14 @@ static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
 	 * it sending the following sequence:
 	 */
 	wStream* s;
+	size_t count = 0;
 	const BYTE keyDownEvent = FASTPATH_INPUT_EVENT_SCANCODE << 5;
 	const BYTE keyUpEvent = (FASTPATH_INPUT_EVENT_SCANCODE << 5) | FASTPATH_INPUT_KBDFLAGS_RELEASE;
-	rdpRdp* rdp;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
-	s = fastpath_input_pdu_init_header(rdp->fastpath);
+	s = input_fastpath_pdu_init_header(input, &count);
 
 	if (!s)
 		return FALSE;
@@ -476,7 +707,7 @@ static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
 	/* Numlock down (0x45) */
 	Stream_Write_UINT8(s, keyUpEvent);
 	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 4);
+	return input_fastpath_send(input, s, count + 4);
 }
 
 static BOOL input_recv_sync_event(rdpInput* input, wStream* s)
@@ -676,6 +907,7 @@ BOOL input_recv(rdpInput* input, wStream* s)
 BOOL input_register_client_callbacks(rdpInput* input)
 {
 	rdpSettings* settings;
+	rdp_input_internal* in = input_cast(input);
 
 	if (!input->context)
 		return FALSE;
@@ -685,8 +917,25 @@ BOOL input_register_client_callbacks(rdpInput* input)
 	if (!settings)
 		return FALSE;
 
+	EnterCriticalSection(&in->lock);
+	in->movePending = FALSE;
+	in->coalesceInterval = 0;
+	LeaveCriticalSection(&in->lock);
+
 	if (freerdp_settings_get_bool(settings, FreeRDP_FastPathInput))
 	{
+		const UINT32 interval =
+		    freerdp_settings_get_uint32(settings, FreeRDP_InputCoalesceInterval);
+
+		/* The timer flushes the last move of a burst from the client event loop */
+		if ((interval > 0) && !in->coalesceTimer)
+			in->coalesceTimer = CreateWaitableTimerA(NULL, FALSE, "input-coalesce-timer");
+
+		if (in->coalesceTimer)
+			in->coalesceInterval = interval;
+		else if (interval > 0)
+			WLog_WARN(TAG, "failed to create the input coalescing timer, sending every move");
+
 		input->SynchronizeEvent = input_send_fastpath_synchronize_event;
 		input->KeyboardEvent = input_send_fastpath_keyboard_event;
 		input->KeyboardPauseEvent = input_send_fastpath_keyboard_pause_event;
@@ -828,6 +1077,13 @@ rdpInput* input_new(rdpRdp* rdp)
 		return NULL;
 	}
 
+	if (!InitializeCriticalSectionAndSpinCount(&input->lock, 4000))
+	{
+		MessageQueue_Free(input->queue);
+		free(input);
+		return NULL;
+	}
+
 	return &input->common;
 }
 
@@ -837,6 +1093,13 @@ void input_free(rdpInput* input)
 	{
 		rdp_input_internal* in = input_cast(input);
 
+		if (in->coalesceInterval > 0)
+			input_coalesce_report(in, GetTickCount64(), TRUE);
+
+		if (in->coalesceTimer)
+			CloseHandle(in->coalesceTimer);
+
+		DeleteCriticalSection(&in->lock);
 		MessageQueue_Free(in->queue);
 		free(in);
 	}
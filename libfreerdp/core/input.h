@@ -28,8 +28,21 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/api.h>
 
+#include <winpr/synch.h>
 #include <winpr/stream.h>
 
+typedef struct
+{
+	UINT64 events;
+	UINT64 pdus;
+	UINT64 moves;
+	UINT64 coalesced;
+	UINT64 delayed;
+	UINT64 latencySum;
+	UINT64 latencyMax;
+	UINT64 lastReport;
+} rdpInputCoalesceStats;
+
 typedef struct
 {
 	rdpInput common;
@@ -37,6 +50,17 @@ typedef struct
 
 	rdpInputProxy* proxy;
 	wMessageQueue* queue;
+
+	/* fast-path mouse move coalescing, protected by lock */
+	CRITICAL_SECTION lock;
+	HANDLE coalesceTimer;
+	UINT32 coalesceInterval;
+	BOOL movePending;
+	UINT16 moveX;
+	UINT16 moveY;
+	UINT64 moveQueued;
+	UINT64 lastMoveSent;
+	rdpInputCoalesceStats stats;
 } rdp_input_internal;
 
 static INLINE rdp_input_internal* input_cast(rdpInput* input)
@@ -54,6 +78,8 @@ static INLINE rdp_input_internal* input_cast(rdpInput* input)
 FREERDP_LOCAL BOOL input_recv(rdpInput* input, wStream* s);
 
 FREERDP_LOCAL int input_process_events(rdpInput* input);
+FREERDP_LOCAL BOOL input_flush_pending(rdpInput* input, BOOL force);
+FREERDP_LOCAL DWORD input_get_event_handles(rdpInput* input, HANDLE* events, DWORD count);
 FREERDP_LOCAL BOOL input_register_client_callbacks(rdpInput* input);
 
 FREERDP_LOCAL rdpInput* input_new(rdpRdp* rdp);
@@ -164,6 +164,8 @@ static BOOL wts_read_drdynvc_capabilities_response(rdpPeerChannel* channel, UINT
 	Stream_Seek_UINT8(channel->receiveData); /* Pad (1 byte) */
 	Stream_Read_UINT16(channel->receiveData, Version);
 	DEBUG_DVC("Version: %" PRIu16 "", Version);
+	/* Version 3 is only offered with a compressor, the client accepted it */
+	channel->vcm->dvc_compress = (Version >= 3) && channel->vcm->zgfxOut;
 	channel->vcm->drdynvc_state = DRDYNVC_STATE_READY;
 	return TRUE;
 }
@@ -194,31 +196,39 @@ static BOOL wts_read_drdynvc_create_response(rdpPeerChannel* channel, wStream* s
 	return TRUE;
 }
 
-static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int cbLen,
-                                        UINT32 length)
+static BOOL wts_begin_drdynvc_data(rdpPeerChannel* channel, UINT32 totalLength, const BYTE* data,
+                                   UINT32 length)
 {
-	int value;
 	WINPR_ASSERT(channel);
-	WINPR_ASSERT(s);
-	value = wts_read_variable_uint(s, cbLen, &channel->dvc_total_length);
 
-	if (value == 0)
-		return FALSE;
-
-	length -= value;
-
-	if (length > channel->dvc_total_length)
+	if (length > totalLength)
 		return FALSE;
 
+	channel->dvc_total_length = totalLength;
 	Stream_SetPosition(channel->receiveData, 0);
 
 	if (!Stream_EnsureRemainingCapacity(channel->receiveData, channel->dvc_total_length))
 		return FALSE;
 
-	Stream_Write(channel->receiveData, Stream_Pointer(s), length);
+	Stream_Write(channel->receiveData, data, length);
 	return TRUE;
 }
 
+static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int cbLen,
+                                        UINT32 length)
+{
+	int value;
+	UINT32 totalLength;
+	WINPR_ASSERT(channel);
+	WINPR_ASSERT(s);
+	value = wts_read_variable_uint(s, cbLen, &totalLength);
+
+	if (value == 0)
+		return FALSE;
+
+	return wts_begin_drdynvc_data(channel, totalLength, Stream_Pointer(s), length - value);
+}
+
 static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 length)
 {
 	BOOL ret = FALSE;
@@ -253,6 +263,55 @@ static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 le
 	return ret;
 }
 
+static BOOL wts_read_drdynvc_data_compressed(WTSVirtualChannelManager* vcm,
+                                             rdpPeerChannel* channel, wStream* s, BOOL first,
+                                             int cbLen, UINT32 length)
+{
+	int value;
+	UINT32 totalLength = 0;
+	wStream* data;
+
+	WINPR_ASSERT(vcm);
+	WINPR_ASSERT(s);
+	data = vcm->dvc_decompressed;
+
+	if (first)
+	{
+		value = wts_read_variable_uint(s, cbLen, &totalLength);
+
+		if (value == 0)
+			return FALSE;
+
+		length -= value;
+	}
+
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, length))
+		return FALSE;
+
+	/* Always decompress, the history must be kept even for unknown channels */
+	Stream_SetPosition(data, 0);
+
+	if (!zgfx_decompress_segment_to_stream(vcm->zgfxIn, Stream_Pointer(s), length, data))
+	{
+		WLog_ERR(TAG, "failed to decompress dynamic channel data");
+		return FALSE;
+	}
+
+	if (!channel)
+	{
+		DEBUG_DVC("ChannelId not exists.");
+		return TRUE;
+	}
+
+	length = (UINT32)Stream_GetPosition(data);
+	Stream_SetPosition(data, 0);
+
+	if (first)
+		return wts_begin_drdynvc_data(channel, totalLength, Stream_Pointer(data), length);
+
+	return wts_read_drdynvc_data(channel, data, length);
+}
+
 static void wts_read_drdynvc_close_response(rdpPeerChannel* channel)
 {
 	WINPR_ASSERT(channel);
@@ -313,6 +372,12 @@ static BOOL wts_read_drdynvc_pdu(rdpPeerChannel* channel)
 
 			DEBUG_DVC("Cmd %d ChannelId %" PRIu32 " length %" PRIu32 "", Cmd, ChannelId, length);
 			dvc = wts_get_dvc_channel_by_id(channel->vcm, ChannelId);
+
+			if ((Cmd == DATA_FIRST_COMPRESSED_PDU) || (Cmd == DATA_COMPRESSED_PDU))
+				return wts_read_drdynvc_data_compressed(channel->vcm, dvc, channel->receiveData,
+				                                        Cmd == DATA_FIRST_COMPRESSED_PDU, Sp,
+				                                        length);
+
 			if (!dvc)
 			{
 				DEBUG_DVC("ChannelId %" PRIu32 " not exists.", ChannelId);
@@ -335,11 +400,6 @@ static BOOL wts_read_drdynvc_pdu(rdpPeerChannel* channel)
 				wts_read_drdynvc_close_response(dvc);
 				break;
 
-			case DATA_FIRST_COMPRESSED_PDU:
-			case DATA_COMPRESSED_PDU:
-				WLog_ERR(TAG, "Compressed data not handled");
-				break;
-
 			case SOFT_SYNC_RESPONSE_PDU:
 				WLog_ERR(TAG, "SoftSync response not handled yet(and rather strange to receive that packet as our code doesn't send SoftSync requests");
 				break;
@@ -543,10 +603,24 @@ static BOOL WTSVirtualChannelManagerOpen(WTSVirtualChannelManager* vcm)
 		{
 			ULONG written;
 			vcm->drdynvc_channel = channel;
-			dynvc_caps = 0x00010050; /* DYNVC_CAPS_VERSION1 (4 bytes) */
 
-			if (!WTSVirtualChannelWrite(channel, (PCHAR)&dynvc_caps, sizeof(dynvc_caps), &written))
-				return FALSE;
+			if (vcm->zgfxOut)
+			{
+				/* DYNVC_CAPS_VERSION3 (12 bytes), all priority charges 0 */
+				BYTE dynvc_caps3[12] = { 0x50, 0x00, 0x03, 0x00 };
+
+				if (!WTSVirtualChannelWrite(channel, (PCHAR)dynvc_caps3, sizeof(dynvc_caps3),
+				                            &written))
+					return FALSE;
+			}
+			else
+			{
+				dynvc_caps = 0x00010050; /* DYNVC_CAPS_VERSION1 (4 bytes) */
+
+				if (!WTSVirtualChannelWrite(channel, (PCHAR)&dynvc_caps, sizeof(dynvc_caps),
+				                            &written))
+					return FALSE;
+			}
 		}
 	}
 
@@ -944,9 +1018,30 @@ HANDLE WINAPI FreeRDP_WTSOpenServerA(LPSTR pServerName)
 		WINPR_ASSERT(obj);
 		obj->fnObjectFree = array_channel_free;
 	}
+
+	InitializeCriticalSection(&vcm->zgfxLock);
+	vcm->zgfxIn = zgfx_context_new_ex(FALSE, DRDYNVC_COMPRESSION_HISTORY_SIZE);
+	vcm->dvc_decompressed = Stream_New(NULL, DRDYNVC_COMPRESSED_MAX_SIZE);
+
+	if (!vcm->zgfxIn || !vcm->dvc_decompressed)
+		goto error_compression;
+
+	if (freerdp_settings_get_bool(context->settings, FreeRDP_DynamicChannelCompression))
+	{
+		vcm->zgfxOut = zgfx_context_new_ex(TRUE, DRDYNVC_COMPRESSION_HISTORY_SIZE);
+
+		if (!vcm->zgfxOut)
+			goto error_compression;
+	}
+
 	client->ReceiveChannelData = WTSReceiveChannelData;
 	hServer = (HANDLE)vcm;
 	return hServer;
+error_compression:
+	zgfx_context_free(vcm->zgfxIn);
+	Stream_Free(vcm->dvc_decompressed, TRUE);
+	DeleteCriticalSection(&vcm->zgfxLock);
+	ArrayList_Free(vcm->dynamicVirtualChannels);
 error_dynamicVirtualChannels:
 	MessageQueue_Free(vcm->queue);
 error_queue:
@@ -986,6 +1081,10 @@ VOID WINAPI FreeRDP_WTSCloseServer(HANDLE hServer)
 		}
 
 		MessageQueue_Free(vcm->queue);
+		zgfx_context_free(vcm->zgfxIn);
+		zgfx_context_free(vcm->zgfxOut);
+		Stream_Free(vcm->dvc_decompressed, TRUE);
+		DeleteCriticalSection(&vcm->zgfxLock);
 		free(vcm);
 	}
 }
@@ -1457,6 +1556,71 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelRead(HANDLE hChannelHandle, ULONG TimeOut,
 	return TRUE;
 }
 
+/* The send history is shared by all channels, the PDUs are queued in the order they
+ * were compressed */
+static BOOL wts_write_drdynvc_data_compressed(rdpPeerChannel* channel, const BYTE* Buffer,
+                                              UINT32 Length)
+{
+	BOOL ret = TRUE;
+	const UINT32 totalLength = Length;
+	WTSVirtualChannelManager* vcm;
+
+	WINPR_ASSERT(channel);
+	vcm = channel->vcm;
+	WINPR_ASSERT(vcm);
+	EnterCriticalSection(&vcm->zgfxLock);
+
+	while (ret && (Length > 0))
+	{
+		wStream* s;
+		BYTE* buffer;
+		UINT32 length;
+		int cbLen = 0;
+		int cbChId;
+		BYTE Cmd = DATA_COMPRESSED_PDU;
+		const UINT32 chunkLength = MIN(Length, DRDYNVC_COMPRESSED_MAX_SIZE);
+
+		/* header, ChannelId, Length and the segment header */
+		s = Stream_New(NULL, 10 + chunkLength);
+
+		if (!s)
+		{
+			WLog_ERR(TAG, "Stream_New failed!");
+			SetLastError(E_OUTOFMEMORY);
+			ret = FALSE;
+			break;
+		}
+
+		Stream_Seek_UINT8(s);
+		cbChId = wts_write_variable_uint(s, channel->channelId);
+
+		if ((totalLength > DRDYNVC_COMPRESSED_MAX_SIZE) && (Length == totalLength))
+		{
+			Cmd = DATA_FIRST_COMPRESSED_PDU;
+			cbLen = wts_write_variable_uint(s, totalLength);
+		}
+
+		if (!zgfx_compress_segment_to_stream(vcm->zgfxOut, s, Buffer, chunkLength))
+		{
+			WLog_ERR(TAG, "zgfx_compress_segment_to_stream failed!");
+			Stream_Free(s, TRUE);
+			ret = FALSE;
+			break;
+		}
+
+		buffer = Stream_Buffer(s);
+		buffer[0] = (Cmd << 4) | (cbLen << 2) | cbChId;
+		length = Stream_GetPosition(s);
+		Stream_Free(s, FALSE);
+		Length -= chunkLength;
+		Buffer += chunkLength;
+		ret = wts_queue_send_item(vcm->drdynvc_channel, buffer, length);
+	}
+
+	LeaveCriticalSection(&vcm->zgfxLock);
+	return ret;
+}
+
 BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer, ULONG Length,
                                            PULONG pBytesWritten)
 {
@@ -1495,6 +1659,11 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 		DEBUG_DVC("drdynvc not ready");
 		return FALSE;
 	}
+	else if (channel->vcm->dvc_compress)
+	{
+		totalWritten = Length;
+		ret = wts_write_drdynvc_data_compressed(channel, (const BYTE*)Buffer, Length);
+	}
 	else
 	{
 		rdpContext* context;
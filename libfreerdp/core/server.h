@@ -29,6 +29,8 @@
 #include <winpr/stream.h>
 #include <winpr/collections.h>
 
+#include <freerdp/codec/zgfx.h>
+
 typedef struct rdp_peer_channel rdpPeerChannel;
 typedef struct WTSVirtualChannelManager WTSVirtualChannelManager;
 
@@ -81,6 +83,13 @@ struct WTSVirtualChannelManager
 	LONG dvc_channel_id_seq;
 
 	wArrayList* dynamicVirtualChannels;
+
+	/* Compression history per direction, shared by all dynamic channels */
+	BOOL dvc_compress;
+	ZGFX_CONTEXT* zgfxIn;
+	ZGFX_CONTEXT* zgfxOut;
+	wStream* dvc_decompressed;
+	CRITICAL_SECTION zgfxLock;
 };
 
 FREERDP_LOCAL BOOL WINAPI FreeRDP_WTSStartRemoteControlSessionW(LPWSTR pTargetServerName,
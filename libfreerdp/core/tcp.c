@@ -25,6 +25,7 @@
 #include <fcntl.h>
 
 #include <winpr/crt.h>
+#include <winpr/assert.h>
 #include <winpr/platform.h>
 #include <winpr/winsock.h>
 
@@ -36,6 +37,7 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -76,6 +78,10 @@
 
 #endif
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 #include <freerdp/log.h>
 
 #include <winpr/stream.h>
@@ -83,6 +89,18 @@
 #include "tcp.h"
 #include "../crypto/opensslcompat.h"
 
+#if defined(HAVE_LINUX_TLS_H) && defined(BIO_CTRL_GET_KTLS_SEND) && !defined(OPENSSL_NO_KTLS)
+#define TRANSPORT_HAVE_KTLS
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
 #define TAG FREERDP_TAG("core")
 
 /* Simple Socket BIO */
@@ -91,6 +109,9 @@ typedef struct
 {
 	SOCKET socket;
 	HANDLE hEvent;
+	BOOL ktlsSend;
+	BOOL ktlsCtrlMsg;
+	BYTE ktlsRecordType;
 } WINPR_BIO_SIMPLE_SOCKET;
 
 static int transport_bio_simple_init(BIO* bio, SOCKET socket, int shutdown);
@@ -102,17 +123,9 @@ static long transport_bio_simple_callback(BIO* bio, int mode, const char* argp,
 	return 1;
 }
 
-static int transport_bio_simple_write(BIO* bio, const char* buf, int size)
+static void transport_bio_simple_check_write(BIO* bio, int status)
 {
 	int error;
-	int status = 0;
-	WINPR_BIO_SIMPLE_SOCKET* ptr = (WINPR_BIO_SIMPLE_SOCKET*)BIO_get_data(bio);
-
-	if (!buf)
-		return 0;
-
-	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
-	status = _send(ptr->socket, buf, size, 0);
 
 	if (status <= 0)
 	{
@@ -128,7 +141,177 @@ static int transport_bio_simple_write(BIO* bio, const char* buf, int size)
 			BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
 		}
 	}
+}
+
+#if defined(TRANSPORT_HAVE_KTLS)
+/**
+ * Hands the TLS transmit keys from OpenSSL to the kernel.
+ * Only sending is offloaded, received records are still decrypted by OpenSSL.
+ */
+static int transport_bio_simple_set_ktls(BIO* bio, const void* cryptoInfo, long isTx)
+{
+	socklen_t length;
+	const struct tls_crypto_info* info = (const struct tls_crypto_info*)cryptoInfo;
+	WINPR_BIO_SIMPLE_SOCKET* ptr = (WINPR_BIO_SIMPLE_SOCKET*)BIO_get_data(bio);
 
+	if (!isTx || !info || !ptr)
+		return 0;
+
+	switch (info->cipher_type)
+	{
+#if defined(TLS_CIPHER_AES_GCM_128)
+		case TLS_CIPHER_AES_GCM_128:
+			length = sizeof(struct tls12_crypto_info_aes_gcm_128);
+			break;
+#endif
+#if defined(TLS_CIPHER_AES_GCM_256)
+		case TLS_CIPHER_AES_GCM_256:
+			length = sizeof(struct tls12_crypto_info_aes_gcm_256);
+			break;
+#endif
+#if defined(TLS_CIPHER_AES_CCM_128)
+		case TLS_CIPHER_AES_CCM_128:
+			length = sizeof(struct tls12_crypto_info_aes_ccm_128);
+			break;
+#endif
+#if defined(TLS_CIPHER_CHACHA20_POLY1305)
+		case TLS_CIPHER_CHACHA20_POLY1305:
+			length = sizeof(struct tls12_crypto_info_chacha20_poly1305);
+			break;
+#endif
+		default:
+			return 0;
+	}
+
+	if ((setsockopt(ptr->socket, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) &&
+	    (errno != EEXIST))
+	{
+		WLog_DBG(TAG, "kernel TLS not available (errno=%d)", errno);
+		return 0;
+	}
+
+	if (setsockopt(ptr->socket, SOL_TLS, TLS_TX, info, length) != 0)
+	{
+		WLog_DBG(TAG, "kernel TLS rejected cipher %" PRIu16 " (errno=%d)", info->cipher_type,
+		         errno);
+		return 0;
+	}
+
+	ptr->ktlsSend = TRUE;
+	return 1;
+}
+
+/* Sends a non application data record, the kernel needs its content type */
+static int transport_bio_simple_send_record(WINPR_BIO_SIMPLE_SOCKET* ptr, const char* buf,
+                                            int size)
+{
+	struct iovec iov;
+	struct msghdr msg = { 0 };
+	struct cmsghdr* cmsg;
+	char control[CMSG_SPACE(sizeof(BYTE))] = { 0 };
+
+	iov.iov_base = (void*)buf;
+	iov.iov_len = (size_t)size;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(BYTE));
+	*((BYTE*)CMSG_DATA(cmsg)) = ptr->ktlsRecordType;
+	msg.msg_controllen = cmsg->cmsg_len;
+
+	return (int)sendmsg(ptr->socket, &msg, MSG_NOSIGNAL);
+}
+#endif
+
+static int transport_bio_simple_write(BIO* bio, const char* buf, int size)
+{
+	int status = 0;
+	WINPR_BIO_SIMPLE_SOCKET* ptr = (WINPR_BIO_SIMPLE_SOCKET*)BIO_get_data(bio);
+
+	if (!buf)
+		return 0;
+
+	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
+#if defined(TRANSPORT_HAVE_KTLS)
+	if (ptr->ktlsCtrlMsg)
+	{
+		/* like the OpenSSL socket BIO, a record is never sent partially */
+		status = transport_bio_simple_send_record(ptr, buf, size);
+
+		if (status >= 0)
+		{
+			ptr->ktlsCtrlMsg = FALSE;
+			status = size;
+		}
+	}
+	else
+#endif
+		status = _send(ptr->socket, buf, size, 0);
+
+	transport_bio_simple_check_write(bio, status);
+	return status;
+}
+
+/* Sends all chunks with a single system call */
+static int transport_bio_simple_writev(BIO* bio, const DataChunk* chunks, size_t count)
+{
+	size_t index;
+	size_t total = 0;
+	int status = 0;
+	WINPR_BIO_SIMPLE_SOCKET* ptr = (WINPR_BIO_SIMPLE_SOCKET*)BIO_get_data(bio);
+#ifdef _WIN32
+	DWORD sent = 0;
+	WSABUF buffers[BIO_WRITEV_MAX_CHUNKS];
+#else
+	struct msghdr msg = { 0 };
+	struct iovec buffers[BIO_WRITEV_MAX_CHUNKS];
+#endif
+
+	if (!chunks || (count == 0))
+		return 0;
+
+	if (ptr->ktlsCtrlMsg)
+		return transport_bio_simple_write(bio, (const char*)chunks[0].data,
+		                                  (int)MIN(chunks[0].size, INT_MAX));
+
+	if (count > BIO_WRITEV_MAX_CHUNKS)
+		count = BIO_WRITEV_MAX_CHUNKS;
+
+	for (index = 0; index < count; index++)
+	{
+		size_t size = chunks[index].size;
+
+		/* the result must fit the int return value, the caller sends the rest later */
+		if (size > INT_MAX - total)
+			size = INT_MAX - total;
+
+#ifdef _WIN32
+		buffers[index].buf = (CHAR*)chunks[index].data;
+		buffers[index].len = (ULONG)size;
+#else
+		buffers[index].iov_base = (void*)chunks[index].data;
+		buffers[index].iov_len = size;
+#endif
+		total += size;
+	}
+
+	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
+#ifdef _WIN32
+	if (WSASend(ptr->socket, buffers, (DWORD)count, &sent, 0, NULL, NULL) == 0)
+		status = (int)sent;
+	else
+		status = -1;
+#else
+	msg.msg_iov = buffers;
+	msg.msg_iovlen = count;
+	status = (int)sendmsg(ptr->socket, &msg, MSG_NOSIGNAL);
+#endif
+	transport_bio_simple_check_write(bio, status);
 	return status;
 }
 
@@ -198,6 +381,8 @@ static long transport_bio_simple_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
 
 			*((SOCKET*)arg2) = ptr->socket;
 			return 1;
+		case BIO_C_WRITEV:
+			return transport_bio_simple_writev(bio, (const DataChunk*)arg2, (size_t)arg1);
 		case BIO_C_GET_EVENT:
 			if (!BIO_get_init(bio) || !arg2)
 				return 0;
@@ -337,6 +522,27 @@ static long transport_bio_simple_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
 			status = 1;
 			break;
 
+#if defined(TRANSPORT_HAVE_KTLS)
+		case BIO_CTRL_SET_KTLS:
+			status = transport_bio_simple_set_ktls(bio, arg2, arg1);
+			break;
+
+		case BIO_CTRL_GET_KTLS_SEND:
+			status = ptr->ktlsSend ? 1 : 0;
+			break;
+
+		case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+			ptr->ktlsCtrlMsg = TRUE;
+			ptr->ktlsRecordType = (BYTE)arg1;
+			status = 0;
+			break;
+
+		case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+			ptr->ktlsCtrlMsg = FALSE;
+			status = 0;
+			break;
+#endif
+
 		default:
 			status = 0;
 			break;
@@ -452,6 +658,7 @@ typedef struct
 	BIO* bufferedBio;
 	BOOL readBlocked;
 	BOOL writeBlocked;
+	BOOL ktlsCtrlMsg;
 	RingBuffer xmitBuffer;
 } WINPR_BIO_BUFFERED_SOCKET;
 
@@ -461,64 +668,160 @@ static long transport_bio_buffered_callback(BIO* bio, int mode, const char* argp
 	return 1;
 }
 
-static int transport_bio_buffered_write(BIO* bio, const char* buf, int num)
+/* Skips the first bytes of the chunk list, emptied chunks are dropped from the front */
+static void transport_bio_chunks_advance(DataChunk** chunks, size_t* count, size_t bytes)
+{
+	while ((*count > 0) && (bytes >= (*chunks)->size))
+	{
+		bytes -= (*chunks)->size;
+		(*chunks)++;
+		(*count)--;
+	}
+
+	if (*count > 0)
+	{
+		(*chunks)->data += bytes;
+		(*chunks)->size -= bytes;
+	}
+}
+
+/**
+ * Sends the pending xmit data followed by chunks straight from the caller buffers,
+ * only what the socket did not accept is copied to the xmit buffer.
+ */
+static int transport_bio_buffered_writev(BIO* bio, const DataChunk* chunks, size_t count)
 {
-	int i, ret;
 	int status;
-	int nchunks;
-	int committedBytes;
-	DataChunk chunks[2];
+	size_t index;
+	size_t nchunks;
+	size_t pending;
+	size_t total = 0;
+	size_t committedBytes = 0;
+	DataChunk vector[BIO_WRITEV_MAX_CHUNKS];
+	DataChunk* cur = vector;
 	WINPR_BIO_BUFFERED_SOCKET* ptr = (WINPR_BIO_BUFFERED_SOCKET*)BIO_get_data(bio);
-	BIO* next_bio = NULL;
-	ret = num;
+	BIO* next_bio = BIO_next(bio);
 	ptr->writeBlocked = FALSE;
 	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
 
-	/* we directly append extra bytes in the xmit buffer, this could be prevented
-	 * but for now it makes the code more simple.
-	 */
-	if (buf && num && !ringbuffer_write(&ptr->xmitBuffer, (const BYTE*)buf, num))
+	pending = ringbuffer_used(&ptr->xmitBuffer);
+	nchunks = (size_t)ringbuffer_peek(&ptr->xmitBuffer, vector, pending);
+
+	for (index = 0; index < count; index++)
 	{
-		WLog_ERR(TAG, "an error occurred when writing (num: %d)", num);
-		return -1;
+		total += chunks[index].size;
+
+		if ((nchunks < BIO_WRITEV_MAX_CHUNKS) && (chunks[index].size > 0))
+			vector[nchunks++] = chunks[index];
 	}
 
-	committedBytes = 0;
-	nchunks = ringbuffer_peek(&ptr->xmitBuffer, chunks, ringbuffer_used(&ptr->xmitBuffer));
-	next_bio = BIO_next(bio);
+	if (total > INT_MAX)
+		return -1;
 
-	for (i = 0; i < nchunks; i++)
+	while (nchunks > 0)
 	{
-		while (chunks[i].size)
-		{
-			status = BIO_write(next_bio, chunks[i].data, chunks[i].size);
+		status = transport_bio_writev(next_bio, cur, nchunks);
 
-			if (status <= 0)
+		if (status <= 0)
+		{
+			if (!BIO_should_retry(next_bio))
 			{
-				if (!BIO_should_retry(next_bio))
-				{
-					BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
-					ret = -1; /* fatal error */
-					goto out;
-				}
-
-				if (BIO_should_write(next_bio))
-				{
-					BIO_set_flags(bio, BIO_FLAGS_WRITE);
-					ptr->writeBlocked = TRUE;
-					goto out; /* EWOULDBLOCK */
-				}
+				BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+				ringbuffer_commit_read_bytes(&ptr->xmitBuffer, MIN(committedBytes, pending));
+				return -1; /* fatal error */
 			}
 
-			committedBytes += status;
-			chunks[i].size -= status;
-			chunks[i].data += status;
+			if (BIO_should_write(next_bio))
+				BIO_set_flags(bio, BIO_FLAGS_WRITE);
+
+			ptr->writeBlocked = TRUE;
+			break; /* EWOULDBLOCK */
+		}
+
+		committedBytes += (size_t)status;
+		transport_bio_chunks_advance(&cur, &nchunks, (size_t)status);
+	}
+
+	ringbuffer_commit_read_bytes(&ptr->xmitBuffer, MIN(committedBytes, pending));
+	committedBytes = (committedBytes > pending) ? committedBytes - pending : 0;
+
+	/* keep the part the socket did not take */
+	for (index = 0; index < count; index++)
+	{
+		const BYTE* data = chunks[index].data;
+		size_t size = chunks[index].size;
+
+		if (committedBytes >= size)
+		{
+			committedBytes -= size;
+			continue;
+		}
+
+		if (!ringbuffer_write(&ptr->xmitBuffer, data + committedBytes, size - committedBytes))
+		{
+			WLog_ERR(TAG, "an error occurred when writing (num: %" PRIuz ")", total);
+			return -1;
 		}
+
+		committedBytes = 0;
 	}
 
-out:
-	ringbuffer_commit_read_bytes(&ptr->xmitBuffer, committedBytes);
-	return ret;
+	return (int)total;
+}
+
+/**
+ * With kernel TLS a control record must reach the socket as a single write after
+ * everything queued before it, it is never put into the xmit buffer.
+ */
+static int transport_bio_buffered_write_record(BIO* bio, const char* buf, int num)
+{
+	int status;
+	WINPR_BIO_BUFFERED_SOCKET* ptr = (WINPR_BIO_BUFFERED_SOCKET*)BIO_get_data(bio);
+	BIO* next_bio = BIO_next(bio);
+
+	if (transport_bio_buffered_writev(bio, NULL, 0) < 0)
+		return -1;
+
+	if (ringbuffer_used(&ptr->xmitBuffer) > 0)
+	{
+		BIO_set_flags(bio, BIO_FLAGS_WRITE | BIO_FLAGS_SHOULD_RETRY);
+		return -1;
+	}
+
+	status = BIO_write(next_bio, buf, num);
+
+	if (status <= 0)
+	{
+		if (BIO_should_retry(next_bio))
+			BIO_set_flags(bio, BIO_FLAGS_WRITE | BIO_FLAGS_SHOULD_RETRY);
+		else
+			BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+	}
+	else
+	{
+		/* OpenSSL expects the BIO to reset the flag once the record is out, like the
+		 * simple BIO does */
+		ptr->ktlsCtrlMsg = FALSE;
+	}
+
+	return status;
+}
+
+static int transport_bio_buffered_write(BIO* bio, const char* buf, int num)
+{
+	DataChunk chunk = { 0 };
+	WINPR_BIO_BUFFERED_SOCKET* ptr = (WINPR_BIO_BUFFERED_SOCKET*)BIO_get_data(bio);
+
+	if (ptr->ktlsCtrlMsg && buf && (num > 0))
+		return transport_bio_buffered_write_record(bio, buf, num);
+
+	if (buf && (num > 0))
+	{
+		chunk.data = (const BYTE*)buf;
+		chunk.size = (size_t)num;
+	}
+
+	return transport_bio_buffered_writev(bio, &chunk, 1);
 }
 
 static int transport_bio_buffered_read(BIO* bio, char* buf, int size)
@@ -593,6 +896,29 @@ static long transport_bio_buffered_ctrl(BIO* bio, int cmd, long arg1, void* arg2
 			status = (int)ptr->writeBlocked;
 			break;
 
+		case BIO_C_WRITEV:
+			status = transport_bio_buffered_writev(bio, (const DataChunk*)arg2, (size_t)arg1);
+			break;
+
+		case BIO_CTRL_SET_KTLS:
+			/* queued records are already encrypted, the kernel must not encrypt them again */
+			if (ringbuffer_used(&ptr->xmitBuffer) > 0)
+				status = 0;
+			else
+				status = BIO_ctrl(BIO_next(bio), cmd, arg1, arg2);
+
+			break;
+
+		case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+			ptr->ktlsCtrlMsg = TRUE;
+			status = BIO_ctrl(BIO_next(bio), cmd, arg1, arg2);
+			break;
+
+		case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+			ptr->ktlsCtrlMsg = FALSE;
+			status = BIO_ctrl(BIO_next(bio), cmd, arg1, arg2);
+			break;
+
 		default:
 			status = BIO_ctrl(BIO_next(bio), cmd, arg1, arg2);
 			break;
@@ -655,6 +981,33 @@ BIO_METHOD* BIO_s_buffered_socket(void)
 	return bio_methods;
 }
 
+int transport_bio_writev(BIO* bio, const DataChunk* chunks, size_t count)
+{
+	size_t index;
+
+	WINPR_ASSERT(bio);
+	WINPR_ASSERT(chunks || (count == 0));
+
+	switch (BIO_method_type(bio))
+	{
+		case BIO_TYPE_SIMPLE:
+		case BIO_TYPE_BUFFERED:
+		case BIO_TYPE_RDP_TLS:
+			return (int)BIO_ctrl(bio, BIO_C_WRITEV, (long)count, (void*)chunks);
+
+		default:
+			break;
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		if (chunks[index].size > 0)
+			return BIO_write(bio, chunks[index].data, (int)MIN(chunks[index].size, INT_MAX));
+	}
+
+	return 0;
+}
+
 char* freerdp_tcp_address_to_string(const struct sockaddr_storage* addr, BOOL* pIPv6)
 {
 	char ipAddress[INET6_ADDRSTRLEN + 1] = { 0 };
@@ -41,6 +41,7 @@
 #define BIO_TYPE_TSG 65
 #define BIO_TYPE_SIMPLE 66
 #define BIO_TYPE_BUFFERED 67
+#define BIO_TYPE_RDP_TLS 68
 
 #define BIO_C_SET_SOCKET 1101
 #define BIO_C_GET_SOCKET 1102
@@ -50,6 +51,7 @@
 #define BIO_C_WRITE_BLOCKED 1106
 #define BIO_C_WAIT_READ 1107
 #define BIO_C_WAIT_WRITE 1108
+#define BIO_C_WRITEV 1109
 
 #define BIO_set_socket(b, s, c) BIO_ctrl(b, BIO_C_SET_SOCKET, c, s);
 #define BIO_get_socket(b, c) BIO_ctrl(b, BIO_C_GET_SOCKET, 0, (char*)c)
@@ -60,9 +62,34 @@
 #define BIO_wait_read(b, c) BIO_ctrl(b, BIO_C_WAIT_READ, c, NULL)
 #define BIO_wait_write(b, c) BIO_ctrl(b, BIO_C_WAIT_WRITE, c, NULL)
 
+/*
+ * Controls OpenSSL uses to hand the kernel TLS transmit state to the BIO the
+ * SSL object writes to. They are not part of the public OpenSSL headers.
+ */
+#ifndef BIO_CTRL_SET_KTLS
+#define BIO_CTRL_SET_KTLS 72
+#endif
+#ifndef BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG
+#define BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG 74
+#endif
+#ifndef BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG
+#define BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG 75
+#endif
+
+/* Maximum number of chunks a single vectored write passes down the BIO chain */
+#define BIO_WRITEV_MAX_CHUNKS 16
+
 FREERDP_LOCAL BIO_METHOD* BIO_s_simple_socket(void);
 FREERDP_LOCAL BIO_METHOD* BIO_s_buffered_socket(void);
 
+/**
+ * Writes the concatenation of chunks to bio, with the same return value and retry
+ * semantics as BIO_write.
+ * BIOs supporting BIO_C_WRITEV get all chunks in one call, for all others only the
+ * first non empty chunk is written.
+ */
+FREERDP_LOCAL int transport_bio_writev(BIO* bio, const DataChunk* chunks, size_t count);
+
 FREERDP_LOCAL BOOL freerdp_tcp_set_keep_alive_mode(const rdpSettings* settings, int sockfd);
 
 FREERDP_LOCAL int freerdp_tcp_connect(rdpContext* context, const char* hostname, int port,
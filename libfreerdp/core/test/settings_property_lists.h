@@ -25,6 +25,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_CertificateCallbackPreferPEM,
 	FreeRDP_CertificateUseKnownHosts,
 	FreeRDP_ColorPointerFlag,
+	FreeRDP_CompressionAdaptive,
 	FreeRDP_CompressionEnabled,
 	FreeRDP_ConsoleSession,
 	FreeRDP_CredentialsFromStdin,
@@ -48,6 +49,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_DrawGdiPlusEnabled,
 	FreeRDP_DrawNineGridEnabled,
 	FreeRDP_DumpRemoteFx,
+	FreeRDP_DynamicChannelCompression,
 	FreeRDP_DynamicDaylightTimeDisabled,
 	FreeRDP_DynamicResolutionUpdate,
 	FreeRDP_EmbeddedWindow,
@@ -71,6 +73,8 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_GatewayUseSameCredentials,
 	FreeRDP_GfxAVC444,
 	FreeRDP_GfxAVC444v2,
+	FreeRDP_GfxClearCodec,
+	FreeRDP_GfxDirectOutput,
 	FreeRDP_GfxH264,
 	FreeRDP_GfxPlanar,
 	FreeRDP_GfxProgressive,
@@ -163,6 +167,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_SurfaceFrameMarkerEnabled,
 	FreeRDP_SuspendInput,
 	FreeRDP_TcpKeepAlive,
+	FreeRDP_TlsKernelOffload,
 	FreeRDP_TlsSecurity,
 	FreeRDP_ToggleFullscreen,
 	FreeRDP_TransportDump,
@@ -230,6 +235,7 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_GatewayUsageMethod,
 	FreeRDP_GfxCapsFilter,
 	FreeRDP_GlyphSupportLevel,
+	FreeRDP_InputCoalesceInterval,
 	FreeRDP_JpegCodecId,
 	FreeRDP_JpegQuality,
 	FreeRDP_KeySpec,
@@ -325,6 +331,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_AlternateShell,
 	FreeRDP_AssistanceFile,
 	FreeRDP_AuthenticationServiceClass,
+	FreeRDP_BitmapCachePersistFile,
 	FreeRDP_CardName,
 	FreeRDP_CertificateAcceptedFingerprints,
 	FreeRDP_CertificateContent,
@@ -350,6 +357,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_GatewayHostname,
 	FreeRDP_GatewayPassword,
 	FreeRDP_GatewayUsername,
+	FreeRDP_GfxCachePersistFile,
 	FreeRDP_HomePath,
 	FreeRDP_ImeFileName,
 	FreeRDP_KerberosArmor,
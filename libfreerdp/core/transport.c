@@ -56,6 +56,8 @@
 #define TAG FREERDP_TAG("core.transport")
 
 #define BUFFER_SIZE 16384
+/* PDUs collected while corked, up to one TLS record */
+#define TRANSPORT_CORK_SIZE 16384
 
 struct rdp_transport
 {
@@ -81,6 +83,8 @@ struct rdp_transport
 	BOOL haveMoreBytesToRead;
 	wLog* log;
 	rdpTransportIo io;
+	BOOL corked;
+	wStream* corkBuffer;
 };
 
 static void transport_ssl_cb(SSL* ssl, int where, int ret)
@@ -873,41 +877,25 @@ int transport_write(rdpTransport* transport, wStream* s)
 	return IFCALLRESULT(-1, transport->io.WritePdu, transport, s);
 }
 
-static int transport_default_write(rdpTransport* transport, wStream* s)
+/* Writes the chunks to the front BIO, called with the write lock held */
+static int transport_write_chunks(rdpTransport* transport, DataChunk* chunks, size_t count)
 {
-	size_t length;
-	int status = -1;
-	int writtenlength = 0;
-	rdpRdp* rdp;
+	size_t sent;
+	size_t length = 0;
+	size_t index;
+	size_t nchunks = count;
+	int status = 0;
+	DataChunk* cur = chunks;
 	rdpContext* context = transport_get_context(transport);
 
-	WINPR_ASSERT(transport);
 	WINPR_ASSERT(context);
 
-	if (!s)
-		return -1;
-
-	rdp = context->rdp;
-	if (!rdp)
-		goto fail;
-
-	EnterCriticalSection(&(transport->WriteLock));
-	if (!transport->frontBio)
-		goto out_cleanup;
-
-	length = Stream_GetPosition(s);
-	writtenlength = length;
-	Stream_SetPosition(s, 0);
-
-	if (length > 0)
-	{
-		rdp->outBytes += length;
-		WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
-	}
+	for (index = 0; index < count; index++)
+		length += chunks[index].size;
 
 	while (length > 0)
 	{
-		status = BIO_write(transport->frontBio, Stream_Pointer(s), length);
+		status = transport_bio_writev(transport->frontBio, cur, nchunks);
 
 		if (status <= 0)
 		{
@@ -960,10 +948,23 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 		}
 
 		length -= status;
-		Stream_Seek(s, status);
+		sent = (size_t)status;
+
+		/* drop the chunks that went out completely */
+		while ((nchunks > 0) && (sent >= cur->size))
+		{
+			sent -= cur->size;
+			cur++;
+			nchunks--;
+		}
+
+		if (nchunks > 0)
+		{
+			cur->data += sent;
+			cur->size -= sent;
+		}
 	}
 
-	transport->written += writtenlength;
 out_cleanup:
 
 	if (status < 0)
@@ -973,12 +974,174 @@ out_cleanup:
 		freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
 	}
 
+	return status;
+}
+
+/* Sends what was collected while corked, called with the write lock held */
+static int transport_flush_cork(rdpTransport* transport)
+{
+	DataChunk chunk;
+
+	if (!transport->corkBuffer || (Stream_GetPosition(transport->corkBuffer) == 0))
+		return 0;
+
+	chunk.data = Stream_Buffer(transport->corkBuffer);
+	chunk.size = Stream_GetPosition(transport->corkBuffer);
+	Stream_SetPosition(transport->corkBuffer, 0);
+	return transport_write_chunks(transport, &chunk, 1);
+}
+
+static int transport_default_writev(rdpTransport* transport, wStream** streams, size_t count)
+{
+	size_t index;
+	size_t length = 0;
+	size_t pending = 0;
+	int status = -1;
+	rdpRdp* rdp;
+	DataChunk chunks[BIO_WRITEV_MAX_CHUNKS + 1];
+	DataChunk* cur = &chunks[1];
+	rdpContext* context = transport_get_context(transport);
+
+	WINPR_ASSERT(transport);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(streams);
+
+	if (count > BIO_WRITEV_MAX_CHUNKS)
+	{
+		WLog_Print(transport->log, WLOG_ERROR, "too many streams for a single write: %" PRIuz,
+		           count);
+		goto fail;
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		if (!streams[index])
+			goto fail;
+
+		cur[index].data = Stream_Buffer(streams[index]);
+		cur[index].size = Stream_GetPosition(streams[index]);
+		length += cur[index].size;
+	}
+
+	if (length > INT_MAX)
+		goto fail;
+
+	rdp = context->rdp;
+	if (!rdp)
+		goto fail;
+
+	EnterCriticalSection(&(transport->WriteLock));
+	if (!transport->frontBio)
+		goto out_cleanup;
+
+	if (length > 0)
+	{
+		rdp->outBytes += length;
+
+		for (index = 0; index < count; index++)
+			WLog_Packet(transport->log, WLOG_TRACE, cur[index].data, cur[index].size,
+			            WLOG_PACKET_OUTBOUND);
+	}
+
+	if (transport->corkBuffer)
+		pending = Stream_GetPosition(transport->corkBuffer);
+
+	if (transport->corked && (pending + length <= TRANSPORT_CORK_SIZE))
+	{
+		/* Small PDUs are collected until the batch is uncorked and share a TLS record */
+		if (!transport->corkBuffer)
+			transport->corkBuffer = Stream_New(NULL, TRANSPORT_CORK_SIZE);
+
+		if (!transport->corkBuffer)
+			goto out_cleanup;
+
+		for (index = 0; index < count; index++)
+			Stream_Write(transport->corkBuffer, cur[index].data, cur[index].size);
+
+		status = (int)length;
+	}
+	else
+	{
+		/* Anything collected so far goes first, in the same write */
+		if (pending > 0)
+		{
+			cur--;
+			cur->data = Stream_Buffer(transport->corkBuffer);
+			cur->size = pending;
+			Stream_SetPosition(transport->corkBuffer, 0);
+		}
+
+		status = transport_write_chunks(transport, cur, count + ((pending > 0) ? 1 : 0));
+	}
+
+	if (status >= 0)
+		transport->written += length;
+
+out_cleanup:
 	LeaveCriticalSection(&(transport->WriteLock));
 fail:
-	Stream_Release(s);
+	for (index = 0; index < count; index++)
+	{
+		if (streams[index])
+			Stream_Release(streams[index]);
+	}
+
 	return status;
 }
 
+static int transport_default_write(rdpTransport* transport, wStream* s)
+{
+	return transport_default_writev(transport, &s, 1);
+}
+
+BOOL transport_cork(rdpTransport* transport, BOOL cork)
+{
+	int status = 0;
+
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteLock));
+	transport->corked = cork;
+
+	if (!cork && transport->frontBio)
+		status = transport_flush_cork(transport);
+
+	LeaveCriticalSection(&(transport->WriteLock));
+	return status >= 0;
+}
+
+int transport_writev(rdpTransport* transport, wStream** streams, size_t count)
+{
+	size_t index;
+	size_t length = 0;
+	wStream* s;
+
+	if (!transport || !streams || (count == 0))
+		return -1;
+
+	if (transport->io.WritePdu == transport_default_write)
+		return transport_default_writev(transport, streams, count);
+
+	/* A custom WritePdu expects whole PDUs, hand it a single stream */
+	for (index = 0; index < count; index++)
+		length += Stream_GetPosition(streams[index]);
+
+	s = transport_send_stream_init(transport, length);
+
+	for (index = 0; index < count; index++)
+	{
+		if (s)
+			Stream_Write(s, Stream_Buffer(streams[index]), Stream_GetPosition(streams[index]));
+
+		Stream_Release(streams[index]);
+	}
+
+	if (!s)
+		return -1;
+
+	return transport_write(transport, s);
+}
+
 DWORD transport_get_event_handles(rdpTransport* transport, HANDLE* events, DWORD count)
 {
 	DWORD nCount = 1; /* always the reread Event */
@@ -1335,6 +1498,7 @@ void transport_free(rdpTransport* transport)
 	CloseHandle(transport->rereadEvent);
 	DeleteCriticalSection(&(transport->ReadLock));
 	DeleteCriticalSection(&(transport->WriteLock));
+	Stream_Free(transport->corkBuffer, TRUE);
 	free(transport);
 }
 
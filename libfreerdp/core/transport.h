@@ -67,6 +67,21 @@ FREERDP_LOCAL BOOL transport_accept_nla(rdpTransport* transport);
 FREERDP_LOCAL int transport_read_pdu(rdpTransport* transport, wStream* s);
 FREERDP_LOCAL int transport_write(rdpTransport* transport, wStream* s);
 
+/**
+ * Sends the streams as one message, e.g. a PDU header and its payload, without
+ * copying them into a single buffer first.
+ * At most BIO_WRITEV_MAX_CHUNKS streams, all of them are released like with
+ * transport_write.
+ */
+FREERDP_LOCAL int transport_writev(rdpTransport* transport, wStream** streams, size_t count);
+
+/**
+ * While corked, writes are collected and sent together once the collected data
+ * would exceed a TLS record or the transport is uncorked, e.g. around the PDUs
+ * of one frame. Uncorking sends what is left.
+ */
+FREERDP_LOCAL BOOL transport_cork(rdpTransport* transport, BOOL cork);
+
 #if defined(WITH_FREERDP_DEPRECATED)
 FREERDP_LOCAL void transport_get_fds(rdpTransport* transport, void** rfds, int* rcount);
 #endif
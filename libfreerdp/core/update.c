@@ -1254,10 +1254,15 @@ static BOOL update_send_surface_frame_marker(rdpContext* context,
 	rdpRdp* rdp = context->rdp;
 	BOOL ret = FALSE;
 	update_force_flush(context);
+
+	/* The PDUs of a frame are collected and sent in as few TLS records as possible */
+	if (surfaceFrameMarker->frameAction == SURFACECMD_FRAMEACTION_BEGIN)
+		transport_cork(rdp->transport, TRUE);
+
 	s = fastpath_update_pdu_init(rdp->fastpath);
 
 	if (!s)
-		return FALSE;
+		goto out_fail;
 
 	if (!update_write_surfcmd_frame_marker(s, surfaceFrameMarker->frameAction,
 	                                       surfaceFrameMarker->frameId) ||
@@ -1267,7 +1272,15 @@ static BOOL update_send_surface_frame_marker(rdpContext* context,
 	update_force_flush(context);
 	ret = TRUE;
 out_fail:
-	Stream_Release(s);
+	if (s)
+		Stream_Release(s);
+
+	if ((surfaceFrameMarker->frameAction == SURFACECMD_FRAMEACTION_END) || !ret)
+	{
+		if (!transport_cork(rdp->transport, FALSE))
+			ret = FALSE;
+	}
+
 	return ret;
 }
 
@@ -1278,10 +1291,14 @@ static BOOL update_send_surface_frame_bits(rdpContext* context, const SURFACE_BI
 	rdpRdp* rdp = context->rdp;
 	BOOL ret = FALSE;
 	update_force_flush(context);
+
+	if (first)
+		transport_cork(rdp->transport, TRUE);
+
 	s = fastpath_update_pdu_init(rdp->fastpath);
 
 	if (!s)
-		return FALSE;
+		goto out_fail;
 
 	if (first)
 	{
@@ -1302,7 +1319,15 @@ static BOOL update_send_surface_frame_bits(rdpContext* context, const SURFACE_BI
 	                               cmd->skipCompression);
 	update_force_flush(context);
 out_fail:
-	Stream_Release(s);
+	if (s)
+		Stream_Release(s);
+
+	if (last || !ret)
+	{
+		if (!transport_cork(rdp->transport, FALSE))
+			ret = FALSE;
+	}
+
 	return ret;
 }
 
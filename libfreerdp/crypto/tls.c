@@ -68,10 +68,14 @@
  * #define MICROSOFT_IOS_SNI_BUG
  */
 
+/* Maximum plaintext size of a TLS record, smaller chunks are gathered up to this size */
+#define BIO_RDP_TLS_GATHER_SIZE 16384
+
 typedef struct
 {
 	SSL* ssl;
 	CRITICAL_SECTION lock;
+	BYTE* gather;
 } BIO_RDP_TLS;
 
 static int tls_verify_certificate(rdpTls* tls, CryptoCert cert, const char* hostname, UINT16 port);
@@ -135,6 +139,88 @@ static int bio_rdp_tls_write(BIO* bio, const char* buf, int size)
 	return status;
 }
 
+/**
+ * Writes a chunk list, small chunks are gathered so that they end up in a single
+ * TLS record instead of one record each. Chunks larger than a record are passed
+ * to SSL_write without a copy.
+ * The split only depends on the chunks, a retried write presents the same data
+ * to SSL_write again.
+ */
+static int bio_rdp_tls_writev(BIO* bio, const DataChunk* chunks, size_t count)
+{
+	int status;
+	int total = 0;
+	size_t index = 0;
+	size_t offset = 0;
+	BIO_RDP_TLS* tls = (BIO_RDP_TLS*)BIO_get_data(bio);
+
+	if (!chunks || !tls)
+		return 0;
+
+	while (index < count)
+	{
+		const BYTE* data;
+		size_t size = chunks[index].size - offset;
+
+		if (size == 0)
+		{
+			index++;
+			offset = 0;
+			continue;
+		}
+
+		if ((size >= BIO_RDP_TLS_GATHER_SIZE) || (index + 1 == count))
+			data = &chunks[index].data[offset];
+		else
+		{
+			size_t next = index;
+			size_t nextOffset = offset;
+
+			if (!tls->gather && !(tls->gather = (BYTE*)malloc(BIO_RDP_TLS_GATHER_SIZE)))
+				return (total > 0) ? total : -1;
+
+			size = 0;
+
+			while ((next < count) && (size < BIO_RDP_TLS_GATHER_SIZE))
+			{
+				size_t length = MIN(chunks[next].size - nextOffset, BIO_RDP_TLS_GATHER_SIZE - size);
+				CopyMemory(&tls->gather[size], &chunks[next].data[nextOffset], length);
+				size += length;
+				nextOffset += length;
+
+				if (nextOffset == chunks[next].size)
+				{
+					next++;
+					nextOffset = 0;
+				}
+			}
+
+			data = tls->gather;
+		}
+
+		size = MIN(size, (size_t)(INT_MAX - total));
+
+		if (size == 0)
+			break;
+
+		status = bio_rdp_tls_write(bio, (const char*)data, (int)size);
+
+		if (status <= 0)
+			return (total > 0) ? total : status;
+
+		total += status;
+		offset += (size_t)status;
+
+		while ((index < count) && (offset >= chunks[index].size))
+		{
+			offset -= chunks[index].size;
+			index++;
+		}
+	}
+
+	return total;
+}
+
 static int bio_rdp_tls_read(BIO* bio, char* buf, int size)
 {
 	int error;
@@ -267,6 +353,10 @@ static long bio_rdp_tls_ctrl(BIO* bio, int cmd, long num, void* ptr)
 			status = BIO_ctrl(ssl_rbio, cmd, num, ptr);
 			break;
 
+		case BIO_C_WRITEV:
+			status = bio_rdp_tls_writev(bio, (const DataChunk*)ptr, (size_t)num);
+			break;
+
 		case BIO_CTRL_INFO:
 			status = 0;
 			break;
@@ -476,6 +566,7 @@ static int bio_rdp_tls_free(BIO* bio)
 	}
 
 	DeleteCriticalSection(&tls->lock);
+	free(tls->gather);
 	free(tls);
 
 	return 1;
@@ -516,8 +607,6 @@ static long bio_rdp_tls_callback_ctrl(BIO* bio, int cmd, bio_info_cb* fp)
 	return status;
 }
 
-#define BIO_TYPE_RDP_TLS 68
-
 static BIO_METHOD* BIO_s_rdp_tls(void)
 {
 	static BIO_METHOD* bio_methods = NULL;
@@ -665,6 +754,11 @@ static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int op
 	SSL_CTX_set_mode(tls->ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_ENABLE_PARTIAL_WRITE);
 	SSL_CTX_set_options(tls->ctx, options);
 	SSL_CTX_set_read_ahead(tls->ctx, 1);
+#if defined(SSL_OP_ENABLE_KTLS)
+	/* OpenSSL keeps encrypting in user space if the kernel or the cipher lack support */
+	if (settings->TlsKernelOffload)
+		SSL_CTX_set_options(tls->ctx, SSL_OP_ENABLE_KTLS);
+#endif
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
 	SSL_CTX_set_min_proto_version(tls->ctx, TLS1_VERSION); /* min version */
 	SSL_CTX_set_max_proto_version(tls->ctx, 0); /* highest supported version by library */
@@ -694,6 +788,26 @@ static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int op
 	return TRUE;
 }
 
+static void tls_log_kernel_offload(rdpTls* tls)
+{
+	WINPR_ASSERT(tls);
+	WINPR_ASSERT(tls->settings);
+
+	if (!tls->settings->TlsKernelOffload)
+		return;
+
+#if defined(SSL_OP_ENABLE_KTLS)
+	if (BIO_get_ktls_send(SSL_get_wbio(tls->ssl)))
+	{
+		WLog_INFO(TAG, "TLS records are encrypted by the kernel");
+		return;
+	}
+#endif
+
+	WLog_INFO(TAG, "kernel TLS offload not available for %s, using OpenSSL",
+	          SSL_get_cipher_name(tls->ssl));
+}
+
 static int tls_do_handshake(rdpTls* tls, BOOL clientMode)
 {
 	CryptoCert cert;
@@ -781,6 +895,7 @@ static int tls_do_handshake(rdpTls* tls, BOOL clientMode)
 #endif
 	} while (TRUE);
 
+	tls_log_kernel_offload(tls);
 	cert = tls_get_certificate(tls, clientMode);
 
 	if (!cert)
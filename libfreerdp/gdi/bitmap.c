@@ -37,10 +37,14 @@
 
 #include "brush.h"
 #include "clipping.h"
+#include "rop3.h"
 #include "../gdi/gdi.h"
 
 #define TAG FREERDP_TAG("gdi.bitmap")
 
+/* Row buffers up to this width are kept on the stack by the ROP3 kernel path */
+#define BITBLT_ROP3_STACK_PIXELS 256
+
 /**
  * Get pixel at the given coordinates. msdn{dd144909}
  * @param hdc device context
@@ -447,14 +451,182 @@ static BOOL adjust_src_dst_coordinates(HGDI_DC hdcDest, INT32* pnXSrc, INT32* pn
 	return TRUE;
 }
 
+static BOOL BitBlt_rop3_format_supported(UINT32 format)
+{
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+static INLINE UINT32 BitBlt_rop3_raw_color(UINT32 format, UINT32 color)
+{
+	UINT32 raw = 0;
+	FreeRDPWriteColor((BYTE*)&raw, format, color);
+	return raw;
+}
+
+/**
+ * Check if a blit can be done with the specialized ROP3 row kernels.
+ *
+ * The kernels work on raw 32bpp pixel values, which gives the same result as
+ * the interpreter in process_rop as long as source, pattern and destination
+ * share a pixel format with 8 bit channels. BLACKNESS and WHITENESS use
+ * format dependent constants and stay on the interpreter.
+ */
+static BOOL BitBlt_rop3_usable(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth,
+                               INT32 nHeight, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, DWORD rop,
+                               BOOL useSrc, BOOL usePat, UINT32 style)
+{
+	const BYTE code = (rop >> 16) & 0xFF;
+
+	if ((code == 0x00) || (code == 0xFF) || (gdi_rop3_code(code) != rop))
+		return FALSE;
+
+	if ((nWidth <= 0) || (nHeight <= 0))
+		return FALSE;
+
+	if (!BitBlt_rop3_format_supported(hdcDest->format))
+		return FALSE;
+
+	if (!gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest) ||
+	    !gdi_get_bitmap_pointer(hdcDest, nXDest + nWidth - 1, nYDest + nHeight - 1))
+		return FALSE;
+
+	if (useSrc)
+	{
+		if (hdcSrc->format != hdcDest->format)
+			return FALSE;
+
+		if (!gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc) ||
+		    !gdi_get_bitmap_pointer(hdcSrc, nXSrc + nWidth - 1, nYSrc + nHeight - 1))
+			return FALSE;
+	}
+
+	if (usePat && (style != GDI_BS_SOLID))
+	{
+		const HGDI_BITMAP hBmpBrush = hdcDest->brush->pattern;
+
+		if (!hBmpBrush || (hBmpBrush->width == 0) || (hBmpBrush->height == 0) ||
+		    (FreeRDPGetBytesPerPixel(hBmpBrush->format) != 4))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL BitBlt_rop3_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth,
+                                INT32 nHeight, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, DWORD rop,
+                                BOOL useSrc, BOOL usePat, UINT32 style, const gdiPalette* palette)
+{
+	INT32 i, x;
+	UINT32 srcAnd = 0xFFFFFFFF;
+	UINT32 srcOr = 0;
+	UINT32 stackBuffer[3 * BITBLT_ROP3_STACK_PIXELS];
+	UINT32* buffer = stackBuffer;
+	UINT32* srcRow;
+	UINT32* patRow;
+	UINT32* zeroRow;
+	const UINT32 format = hdcDest->format;
+	const gdi_rop3_row_fn kernel = gdi_rop3_get_row_kernels()[(rop >> 16) & 0xFF];
+
+	if (nWidth > BITBLT_ROP3_STACK_PIXELS)
+	{
+		buffer = calloc(3 * (size_t)nWidth, sizeof(UINT32));
+
+		if (!buffer)
+			return FALSE;
+	}
+
+	srcRow = &buffer[0];
+	patRow = &buffer[nWidth];
+	zeroRow = &buffer[2 * nWidth];
+	memset(zeroRow, 0, nWidth * sizeof(UINT32));
+
+	if (useSrc)
+	{
+		/* FreeRDPConvertColor only fixes up the alpha byte for same format conversions,
+		 * so it reduces to a mask on the raw pixel value. */
+		const UINT32 ones = 0xFFFFFFFF;
+		const UINT32 zero = 0;
+		srcAnd = BitBlt_rop3_raw_color(
+		    format, FreeRDPConvertColor(FreeRDPReadColor((const BYTE*)&ones, format), format,
+		                                format, palette));
+		srcOr = BitBlt_rop3_raw_color(
+		    format, FreeRDPConvertColor(FreeRDPReadColor((const BYTE*)&zero, format), format,
+		                                format, palette));
+	}
+
+	if (usePat && (style == GDI_BS_SOLID))
+	{
+		const UINT32 color = BitBlt_rop3_raw_color(format, hdcDest->brush->color);
+
+		for (x = 0; x < nWidth; x++)
+			patRow[x] = color;
+	}
+
+	/* Rows are processed in the same vertical order as the interpreter, each source
+	 * row is copied before the destination is written so horizontal overlap is safe. */
+	for (i = 0; i < nHeight; i++)
+	{
+		const INT32 y = (nYDest > nYSrc) ? nHeight - 1 - i : i;
+		UINT32* dstp = (UINT32*)gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+
+		if (useSrc)
+		{
+			const BYTE* srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
+			memmove(srcRow, srcp, nWidth * sizeof(UINT32));
+
+			if ((srcAnd != 0xFFFFFFFF) || (srcOr != 0))
+			{
+				for (x = 0; x < nWidth; x++)
+					srcRow[x] = (srcRow[x] & srcAnd) | srcOr;
+			}
+		}
+
+		if (usePat && (style != GDI_BS_SOLID))
+		{
+			const INT32 period = MIN(nWidth, (INT32)hdcDest->brush->pattern->width);
+
+			for (x = 0; x < period; x++)
+			{
+				const BYTE* patp = gdi_get_brush_pointer(hdcDest, nXDest + x, nYDest + y);
+				memcpy(&patRow[x], patp, sizeof(UINT32));
+			}
+
+			for (; x < nWidth; x++)
+				patRow[x] = patRow[x - period];
+		}
+
+		kernel(dstp, useSrc ? srcRow : zeroRow, usePat ? patRow : zeroRow, (UINT32)nWidth);
+	}
+
+	if (buffer != stackBuffer)
+		free(buffer);
+
+	return TRUE;
+}
+
 static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth, INT32 nHeight,
-                           HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, const char* rop,
+                           HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, DWORD dwRop,
                            const gdiPalette* palette)
 {
 	INT32 x, y;
 	UINT32 style = 0;
 	BOOL useSrc = FALSE;
 	BOOL usePat = FALSE;
+	const char* rop = gdi_rop_to_string(dwRop);
 	const char* iter = rop;
 
 	while (*iter != '\0')
@@ -506,6 +678,11 @@ static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nW
 		}
 	}
 
+	if (BitBlt_rop3_usable(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, dwRop,
+	                       useSrc, usePat, style))
+		return BitBlt_rop3_process(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc,
+		                           dwRop, useSrc, usePat, style, palette);
+
 	if ((nXDest > nXSrc) && (nYDest > nYSrc))
 	{
 		for (y = nHeight - 1; y >= 0; y--)
@@ -637,8 +814,8 @@ BOOL gdi_BitBlt(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth, INT32
 			break;
 
 		default:
-			if (!BitBlt_process(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc,
-			                    gdi_rop_to_string(rop), palette))
+			if (!BitBlt_process(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, rop,
+			                    palette))
 				return FALSE;
 
 			break;
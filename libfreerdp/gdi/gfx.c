@@ -62,6 +62,24 @@ static BOOL is_within_surface(const gdiGfxSurface* surface, const RDPGFX_SURFACE
 	return TRUE;
 }
 
+static BOOL is_within_surface_rects(const gdiGfxSurface* surface, const RECTANGLE_16* rects,
+                                    UINT32 count)
+{
+	UINT32 index;
+
+	for (index = 0; index < count; index++)
+	{
+		if (!is_rect_valid(&rects[index], surface->width, surface->height))
+		{
+			WLog_ERR(TAG, "%s: Region rect %" PRIu32 " not within bounds of %" PRIu32 "x%" PRIu32,
+			         __FUNCTION__, index, surface->width, surface->height);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 static DWORD gfx_align_scanline(DWORD widthInBytes, DWORD alignment)
 {
 	const UINT32 align = alignment;
@@ -74,6 +92,175 @@ static DWORD gfx_align_scanline(DWORD widthInBytes, DWORD alignment)
 	return scanline;
 }
 
+static void gdi_surface_reset_h264(gdiGfxSurface* surface)
+{
+#ifdef WITH_GFX_H264
+	if (surface->h264)
+		h264_context_reset(surface->h264, surface->width, surface->height);
+#else
+	WINPR_UNUSED(surface);
+#endif
+}
+
+static BOOL gdi_surface_output_rect(const gdiGfxSurface* surface, RECTANGLE_16* rect)
+{
+	rect->left = (UINT16)surface->outputOriginX;
+	rect->top = (UINT16)surface->outputOriginY;
+	rect->right = (UINT16)(surface->outputOriginX + surface->outputTargetWidth);
+	rect->bottom = (UINT16)(surface->outputOriginY + surface->outputTargetHeight);
+	return surface->outputMapped;
+}
+
+/* FALSE if the primary buffer a direct surface points into was replaced by a resize */
+static BOOL gdi_surface_output_valid(rdpGdi* gdi, const gdiGfxSurface* surface)
+{
+	if (!gdi->primary_buffer || (surface->scanline != gdi->stride))
+		return FALSE;
+
+	if ((surface->width > (UINT32)gdi->width) ||
+	    (surface->outputOriginY + surface->height > (UINT32)gdi->height))
+		return FALSE;
+
+	return surface->data == &gdi->primary_buffer[1ull * surface->outputOriginY * gdi->stride];
+}
+
+/**
+ * Moves a surface decoding into the primary buffer back into its own buffer.
+ * If keep is set the current pixels are preserved.
+ */
+static void gdi_surface_output_buffered(rdpGdi* gdi, gdiGfxSurface* surface, BOOL keep)
+{
+	if (!surface->outputDirect)
+		return;
+
+	if (keep && gdi_surface_output_valid(gdi, surface))
+	{
+		if (!freerdp_image_copy(surface->buffer, surface->format, surface->bufferScanline, 0, 0,
+		                        surface->width, surface->height, surface->data, surface->format,
+		                        surface->scanline, 0, 0, NULL, FREERDP_FLIP_NONE))
+			WLog_WARN(TAG, "%s: failed to preserve surface %" PRIu16, __FUNCTION__,
+			          surface->surfaceId);
+	}
+
+	surface->data = surface->buffer;
+	surface->scanline = surface->bufferScanline;
+	surface->width = surface->bufferWidth;
+	surface->height = surface->bufferHeight;
+	surface->outputDirect = FALSE;
+	gdi_surface_reset_h264(surface);
+}
+
+static void gdi_surface_check_output(rdpGdi* gdi, gdiGfxSurface* surface)
+{
+	if (surface && surface->outputDirect && !gdi_surface_output_valid(gdi, surface))
+		gdi_surface_output_buffered(gdi, surface, FALSE);
+}
+
+static BOOL gdi_surface_can_output_direct(rdpGdi* gdi, const gdiGfxSurface* surface)
+{
+	if (!freerdp_settings_get_bool(gdi->context->settings, FreeRDP_GfxDirectOutput))
+		return FALSE;
+
+	if (!surface->buffer || !surface->outputMapped || (surface->windowId != 0))
+		return FALSE;
+
+	if (!gdi->primary_buffer)
+		return FALSE;
+
+	/* Codecs derive their clipping width from the stride, the surface has to start at the left
+	 * edge to stay within its rows */
+	if (surface->outputOriginX != 0)
+		return FALSE;
+
+	if ((surface->outputTargetWidth != surface->mappedWidth) ||
+	    (surface->outputTargetHeight != surface->mappedHeight))
+		return FALSE;
+
+	if ((FreeRDPGetBytesPerPixel(surface->format) != FreeRDPGetBytesPerPixel(gdi->dstFormat)) ||
+	    !AreColorFormatsEqualNoAlpha(surface->format, gdi->dstFormat))
+		return FALSE;
+
+	return (surface->mappedWidth <= (UINT32)gdi->width) &&
+	       (surface->outputOriginY + surface->mappedHeight <= (UINT32)gdi->height);
+}
+
+/**
+ * Lets a surface decode straight into the primary buffer.
+ * The surface is clipped to the primary buffer, the padding rows and columns of its own
+ * buffer are only ever written by commands outside of the mapped size, which are rejected.
+ */
+static BOOL gdi_surface_output_direct(rdpGdi* gdi, gdiGfxSurface* surface)
+{
+	const UINT32 width = MIN(surface->bufferWidth, (UINT32)gdi->width);
+	const UINT32 height = MIN(surface->bufferHeight, (UINT32)gdi->height - surface->outputOriginY);
+	BYTE* data = &gdi->primary_buffer[1ull * surface->outputOriginY * gdi->stride];
+
+	if (!freerdp_image_copy(data, surface->format, gdi->stride, 0, 0, width, height,
+	                        surface->buffer, surface->format, surface->bufferScanline, 0, 0, NULL,
+	                        FREERDP_FLIP_NONE))
+		return FALSE;
+
+	surface->data = data;
+	surface->scanline = gdi->stride;
+	surface->width = width;
+	surface->height = height;
+	surface->outputDirect = TRUE;
+	gdi_surface_reset_h264(surface);
+	return TRUE;
+}
+
+/**
+ * Moves overlapping surfaces out of the primary buffer, a direct surface must be the only one
+ * drawing to its area. Returns TRUE if any other surface overlaps the output of surface.
+ */
+static BOOL gdi_surface_release_overlapping(rdpGdi* gdi, RdpgfxClientContext* context,
+                                            const gdiGfxSurface* surface)
+{
+	UINT16 count = 0;
+	UINT16 index;
+	BOOL overlaps = FALSE;
+	UINT16* pSurfaceIds = NULL;
+	RECTANGLE_16 rect;
+
+	if (!gdi_surface_output_rect(surface, &rect))
+		return FALSE;
+
+	context->GetSurfaceIds(context, &pSurfaceIds, &count);
+
+	for (index = 0; index < count; index++)
+	{
+		RECTANGLE_16 other;
+		gdiGfxSurface* cur = (gdiGfxSurface*)context->GetSurfaceData(context, pSurfaceIds[index]);
+
+		if (!cur || (cur == surface) || !gdi_surface_output_rect(cur, &other))
+			continue;
+
+		if (!rectangles_intersects(&rect, &other))
+			continue;
+
+		overlaps = TRUE;
+		gdi_surface_output_buffered(gdi, cur, TRUE);
+	}
+
+	free(pSurfaceIds);
+	return overlaps;
+}
+
+/* Called after the output mapping of a surface changed */
+static void gdi_surface_update_output(rdpGdi* gdi, RdpgfxClientContext* context,
+                                      gdiGfxSurface* surface)
+{
+	if (gdi_surface_release_overlapping(gdi, context, surface))
+		return;
+
+	if (!gdi_surface_can_output_direct(gdi, surface))
+		return;
+
+	if (!gdi_surface_output_direct(gdi, surface))
+		WLog_WARN(TAG, "%s: failed to map surface %" PRIu16 " directly", __FUNCTION__,
+		          surface->surfaceId);
+}
+
 /**
  * Function description
  *
@@ -128,6 +315,8 @@ static UINT gdi_ResetGraphics(RdpgfxClientContext* context,
 		if (!surface)
 			continue;
 
+		/* The primary buffer was just replaced, nothing to preserve */
+		gdi_surface_output_buffered(gdi, surface, FALSE);
 		memset(surface->data, 0xFF, (size_t)surface->scanline * surface->height);
 		if (!surface->outputMapped)
 			continue;
@@ -173,6 +362,7 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 	if (gdi->suppressOutput)
 		return CHANNEL_RC_OK;
 
+	gdi_surface_check_output(gdi, surface);
 	surfaceX = surface->outputOriginX;
 	surfaceY = surface->outputOriginY;
 	surfaceRect.left = 0;
@@ -200,7 +390,9 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 		const UINT32 dwidth = MIN((UINT32)(swidth * sx), (UINT32)gdi->width - nXDst);
 		const UINT32 dheight = MIN((UINT32)(sheight * sy), (UINT32)gdi->height - nYDst);
 
-		if (!freerdp_image_scale(gdi->primary_buffer, gdi->dstFormat, gdi->stride, nXDst, nYDst,
+		/* Direct surfaces already decoded into the primary buffer */
+		if (!surface->outputDirect &&
+		    !freerdp_image_scale(gdi->primary_buffer, gdi->dstFormat, gdi->stride, nXDst, nYDst,
 		                         dwidth, dheight, surface->data, surface->format, surface->scanline,
 		                         nXSrc, nYSrc, swidth, sheight))
 		{
@@ -590,6 +782,10 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 		return ERROR_INTERNAL_ERROR;
 
 	meta = &(bs->meta);
+
+	if (!is_within_surface_rects(surface, meta->regionRects, meta->numRegionRects))
+		return ERROR_INVALID_DATA;
+
 	rc = avc420_decompress(surface->h264, bs->data, bs->length, surface->data, surface->format,
 	                       surface->scanline, surface->width, surface->height, meta->regionRects,
 	                       meta->numRegionRects);
@@ -681,6 +877,11 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 	avc2 = &bs->bitstream[1];
 	meta1 = &avc1->meta;
 	meta2 = &avc2->meta;
+
+	if (!is_within_surface_rects(surface, meta1->regionRects, meta1->numRegionRects) ||
+	    !is_within_surface_rects(surface, meta2->regionRects, meta2->numRegionRects))
+		return ERROR_INVALID_DATA;
+
 	rc = avc444_decompress(surface->h264, bs->LC, meta1->regionRects, meta1->numRegionRects,
 	                       avc1->data, avc1->length, meta2->regionRects, meta2->numRegionRects,
 	                       avc2->data, avc2->length, surface->data, surface->format,
@@ -1005,6 +1206,9 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 	           cmd->left, cmd->top, cmd->right, cmd->bottom, cmd->width, cmd->height, cmd->length,
 	           (void*)cmd->data, (void*)cmd->extra);
 
+	gdi_surface_check_output(gdi,
+	                         (gdiGfxSurface*)context->GetSurfaceData(context, cmd->surfaceId));
+
 	switch (cmd->codecId)
 	{
 		case RDPGFX_CODECID_UNCOMPRESSED:
@@ -1132,6 +1336,10 @@ static UINT gdi_CreateSurface(RdpgfxClientContext* context,
 	}
 
 	memset(surface->data, 0xFF, (size_t)surface->scanline * surface->height);
+	surface->buffer = surface->data;
+	surface->bufferScanline = surface->scanline;
+	surface->bufferWidth = surface->width;
+	surface->bufferHeight = surface->height;
 	surface->outputMapped = FALSE;
 	region16_init(&surface->invalidRegion);
 	rc = context->SetSurfaceData(context, surface->surfaceId, (void*)surface);
@@ -1166,7 +1374,7 @@ static UINT gdi_DeleteSurface(RdpgfxClientContext* context,
 #endif
 		region16_uninit(&surface->invalidRegion);
 		codecs = surface->codecs;
-		_aligned_free(surface->data);
+		_aligned_free(surface->buffer);
 		free(surface);
 	}
 
@@ -1203,6 +1411,11 @@ static UINT gdi_SolidFill(RdpgfxClientContext* context, const RDPGFX_SOLID_FILL_
 	if (!surface)
 		goto fail;
 
+	gdi_surface_check_output(gdi, surface);
+
+	if (!is_within_surface_rects(surface, solidFill->fillRects, solidFill->fillRectCount))
+		goto fail;
+
 	b = solidFill->fillPixel.B;
 	g = solidFill->fillPixel.G;
 	r = solidFill->fillPixel.R;
@@ -1280,6 +1493,9 @@ static UINT gdi_SurfaceToSurface(RdpgfxClientContext* context,
 	if (!surfaceSrc || !surfaceDst)
 		goto fail;
 
+	gdi_surface_check_output(gdi, surfaceSrc);
+	gdi_surface_check_output(gdi, surfaceDst);
+
 	if (!is_rect_valid(rectSrc, surfaceSrc->width, surfaceSrc->height))
 		goto fail;
 
@@ -1322,6 +1538,45 @@ fail:
 	return status;
 }
 
+/**
+ * Cache entries are stored without row padding so they can be exported to
+ * the persistent cache as is.
+ */
+static gdiGfxCacheEntry* gdi_GfxCacheEntryNew(UINT64 cacheKey, UINT32 width, UINT32 height,
+                                              UINT32 format)
+{
+	gdiGfxCacheEntry* cacheEntry = (gdiGfxCacheEntry*)calloc(1, sizeof(gdiGfxCacheEntry));
+
+	if (!cacheEntry)
+		return NULL;
+
+	cacheEntry->cacheKey = cacheKey;
+	cacheEntry->width = width;
+	cacheEntry->height = height;
+	cacheEntry->format = format;
+	cacheEntry->scanline = width * FreeRDPGetBytesPerPixel(format);
+
+	if ((cacheEntry->width > 0) && (cacheEntry->height > 0))
+		cacheEntry->data = (BYTE*)calloc(cacheEntry->height, cacheEntry->scanline);
+
+	if (!cacheEntry->data)
+	{
+		free(cacheEntry);
+		return NULL;
+	}
+
+	return cacheEntry;
+}
+
+static void gdi_GfxCacheEntryFree(gdiGfxCacheEntry* cacheEntry)
+{
+	if (!cacheEntry)
+		return;
+
+	free(cacheEntry->data);
+	free(cacheEntry);
+}
+
 /**
  * Function description
  *
@@ -1334,6 +1589,7 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	gdiGfxSurface* surface;
 	gdiGfxCacheEntry* cacheEntry;
 	UINT rc = ERROR_INTERNAL_ERROR;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	rect = &(surfaceToCache->rectSrc);
 	surface = (gdiGfxSurface*)context->GetSurfaceData(context, surfaceToCache->surfaceId);
@@ -1341,32 +1597,22 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	if (!surface)
 		goto fail;
 
+	gdi_surface_check_output(gdi, surface);
+
 	if (!is_rect_valid(rect, surface->width, surface->height))
 		goto fail;
 
-	cacheEntry = (gdiGfxCacheEntry*)calloc(1, sizeof(gdiGfxCacheEntry));
+	cacheEntry = gdi_GfxCacheEntryNew(surfaceToCache->cacheKey, (UINT32)(rect->right - rect->left),
+	                                  (UINT32)(rect->bottom - rect->top), surface->format);
 
 	if (!cacheEntry)
 		goto fail;
 
-	cacheEntry->width = (UINT32)(rect->right - rect->left);
-	cacheEntry->height = (UINT32)(rect->bottom - rect->top);
-	cacheEntry->format = surface->format;
-	cacheEntry->scanline = gfx_align_scanline(cacheEntry->width * 4, 16);
-	cacheEntry->data = (BYTE*)calloc(cacheEntry->height, cacheEntry->scanline);
-
-	if (!cacheEntry->data)
-	{
-		free(cacheEntry);
-		goto fail;
-	}
-
 	if (!freerdp_image_copy(cacheEntry->data, cacheEntry->format, cacheEntry->scanline, 0, 0,
 	                        cacheEntry->width, cacheEntry->height, surface->data, surface->format,
 	                        surface->scanline, rect->left, rect->top, NULL, FREERDP_FLIP_NONE))
 	{
-		free(cacheEntry->data);
-		free(cacheEntry);
+		gdi_GfxCacheEntryFree(cacheEntry);
 		goto fail;
 	}
 
@@ -1397,6 +1643,8 @@ static UINT gdi_CacheToSurface(RdpgfxClientContext* context,
 	if (!surface || !cacheEntry)
 		goto fail;
 
+	gdi_surface_check_output(gdi, surface);
+
 	for (index = 0; index < cacheToSurface->destPtsCount; index++)
 	{
 		const RDPGFX_POINT16* destPt = &cacheToSurface->destPts[index];
@@ -1463,8 +1711,7 @@ static UINT gdi_EvictCacheEntry(RdpgfxClientContext* context,
 
 	if (cacheEntry)
 	{
-		free(cacheEntry->data);
-		free(cacheEntry);
+		gdi_GfxCacheEntryFree(cacheEntry);
 		rc = context->SetCacheSlotData(context, evictCacheEntry->cacheSlot, NULL);
 	}
 
@@ -1472,6 +1719,76 @@ static UINT gdi_EvictCacheEntry(RdpgfxClientContext* context,
 	return rc;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_ImportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                 const PERSISTENT_CACHE_ENTRY* importCacheEntry)
+{
+	gdiGfxCacheEntry* cacheEntry;
+	UINT rc = ERROR_INTERNAL_ERROR;
+
+	if (!importCacheEntry)
+		return ERROR_BAD_ARGUMENTS;
+
+	cacheEntry = gdi_GfxCacheEntryNew(importCacheEntry->key64, importCacheEntry->width,
+	                                  importCacheEntry->height, importCacheEntry->format);
+
+	if (!cacheEntry)
+		return CHANNEL_RC_NO_MEMORY;
+
+	if (importCacheEntry->size != cacheEntry->scanline * cacheEntry->height)
+		goto fail;
+
+	CopyMemory(cacheEntry->data, importCacheEntry->data, importCacheEntry->size);
+	EnterCriticalSection(&context->mux);
+	gdi_GfxCacheEntryFree((gdiGfxCacheEntry*)context->GetCacheSlotData(context, cacheSlot));
+	rc = context->SetCacheSlotData(context, cacheSlot, (void*)cacheEntry);
+	LeaveCriticalSection(&context->mux);
+
+	if (rc == CHANNEL_RC_OK)
+		return rc;
+
+fail:
+	gdi_GfxCacheEntryFree(cacheEntry);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_ExportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                 PERSISTENT_CACHE_ENTRY* exportCacheEntry)
+{
+	gdiGfxCacheEntry* cacheEntry;
+	UINT rc = ERROR_NOT_FOUND;
+
+	if (!exportCacheEntry)
+		return ERROR_BAD_ARGUMENTS;
+
+	EnterCriticalSection(&context->mux);
+	cacheEntry = (gdiGfxCacheEntry*)context->GetCacheSlotData(context, cacheSlot);
+
+	if (cacheEntry)
+	{
+		exportCacheEntry->key64 = cacheEntry->cacheKey;
+		exportCacheEntry->cacheId = 0;
+		exportCacheEntry->width = cacheEntry->width;
+		exportCacheEntry->height = cacheEntry->height;
+		exportCacheEntry->format = cacheEntry->format;
+		exportCacheEntry->size = cacheEntry->scanline * cacheEntry->height;
+		exportCacheEntry->data = cacheEntry->data;
+		rc = CHANNEL_RC_OK;
+	}
+
+	LeaveCriticalSection(&context->mux);
+	return rc;
+}
+
 /**
  * Function description
  *
@@ -1482,18 +1799,21 @@ static UINT gdi_MapSurfaceToOutput(RdpgfxClientContext* context,
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
 	gdiGfxSurface* surface;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	surface = (gdiGfxSurface*)context->GetSurfaceData(context, surfaceToOutput->surfaceId);
 
 	if (!surface)
 		goto fail;
 
+	gdi_surface_output_buffered(gdi, surface, TRUE);
 	surface->outputMapped = TRUE;
 	surface->outputOriginX = surfaceToOutput->outputOriginX;
 	surface->outputOriginY = surfaceToOutput->outputOriginY;
 	surface->outputTargetWidth = surface->mappedWidth;
 	surface->outputTargetHeight = surface->mappedHeight;
 	region16_clear(&surface->invalidRegion);
+	gdi_surface_update_output(gdi, context, surface);
 	rc = CHANNEL_RC_OK;
 fail:
 	LeaveCriticalSection(&context->mux);
@@ -1506,18 +1826,21 @@ gdi_MapSurfaceToScaledOutput(RdpgfxClientContext* context,
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
 	gdiGfxSurface* surface;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	surface = (gdiGfxSurface*)context->GetSurfaceData(context, surfaceToOutput->surfaceId);
 
 	if (!surface)
 		goto fail;
 
+	gdi_surface_output_buffered(gdi, surface, TRUE);
 	surface->outputMapped = TRUE;
 	surface->outputOriginX = surfaceToOutput->outputOriginX;
 	surface->outputOriginY = surfaceToOutput->outputOriginY;
 	surface->outputTargetWidth = surfaceToOutput->targetWidth;
 	surface->outputTargetHeight = surfaceToOutput->targetHeight;
 	region16_clear(&surface->invalidRegion);
+	gdi_surface_update_output(gdi, context, surface);
 	rc = CHANNEL_RC_OK;
 fail:
 	LeaveCriticalSection(&context->mux);
@@ -1534,6 +1857,7 @@ static UINT gdi_MapSurfaceToWindow(RdpgfxClientContext* context,
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
 	gdiGfxSurface* surface;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	surface = (gdiGfxSurface*)context->GetSurfaceData(context, surfaceToWindow->surfaceId);
 
@@ -1546,6 +1870,7 @@ static UINT gdi_MapSurfaceToWindow(RdpgfxClientContext* context,
 			goto fail;
 	}
 
+	gdi_surface_output_buffered(gdi, surface, TRUE);
 	surface->windowId = surfaceToWindow->windowId;
 	surface->mappedWidth = surfaceToWindow->mappedWidth;
 	surface->mappedHeight = surfaceToWindow->mappedHeight;
@@ -1564,6 +1889,7 @@ gdi_MapSurfaceToScaledWindow(RdpgfxClientContext* context,
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
 	gdiGfxSurface* surface;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	surface = (gdiGfxSurface*)context->GetSurfaceData(context, surfaceToWindow->surfaceId);
 
@@ -1576,6 +1902,7 @@ gdi_MapSurfaceToScaledWindow(RdpgfxClientContext* context,
 			goto fail;
 	}
 
+	gdi_surface_output_buffered(gdi, surface, TRUE);
 	surface->windowId = surfaceToWindow->windowId;
 	surface->mappedWidth = surfaceToWindow->mappedWidth;
 	surface->mappedHeight = surfaceToWindow->mappedHeight;
@@ -1622,6 +1949,8 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 	gfx->CacheToSurface = gdi_CacheToSurface;
 	gfx->CacheImportReply = gdi_CacheImportReply;
 	gfx->EvictCacheEntry = gdi_EvictCacheEntry;
+	gfx->ImportCacheEntry = gdi_ImportCacheEntry;
+	gfx->ExportCacheEntry = gdi_ExportCacheEntry;
 	gfx->MapSurfaceToOutput = gdi_MapSurfaceToOutput;
 	gfx->MapSurfaceToWindow = gdi_MapSurfaceToWindow;
 	gfx->MapSurfaceToScaledOutput = gdi_MapSurfaceToScaledOutput;
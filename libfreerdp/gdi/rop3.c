@@ -0,0 +1,84 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Row Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include "rop3.h"
+#include "rop3_table.h"
+
+#define ROP_ZERO 0
+#define ROP_ONE 0xFFFFFFFF
+#define ROP_NOT(_a) (~(_a))
+#define ROP_AND(_a, _b) ((_a) & (_b))
+#define ROP_OR(_a, _b) ((_a) | (_b))
+#define ROP_XOR(_a, _b) ((_a) ^ (_b))
+
+#define ROP3_GENERIC_KERNEL(_code, _expr)                                           \
+	static void rop3_row_##_code(UINT32* dst, const UINT32* src, const UINT32* pat, \
+	                             UINT32 width)                                      \
+	{                                                                               \
+		UINT32 x;                                                                   \
+                                                                                    \
+		for (x = 0; x < width; x++)                                                 \
+		{                                                                           \
+			const UINT32 D = dst[x];                                                \
+			const UINT32 S = src[x];                                                \
+			const UINT32 P = pat[x];                                                \
+			WINPR_UNUSED(D);                                                        \
+			WINPR_UNUSED(S);                                                        \
+			WINPR_UNUSED(P);                                                        \
+			dst[x] = _expr;                                                         \
+		}                                                                           \
+	}
+
+ROP3_FOR_EACH(ROP3_GENERIC_KERNEL)
+
+#define ROP3_GENERIC_ENTRY(_code, _expr) kernels[_code] = rop3_row_##_code;
+
+void gdi_rop3_init_generic(gdi_rop3_row_fn* kernels)
+{
+	ROP3_FOR_EACH(ROP3_GENERIC_ENTRY)
+}
+
+static INIT_ONCE rop3_init_once = INIT_ONCE_STATIC_INIT;
+static gdi_rop3_row_fn rop3_kernels[256];
+
+static BOOL CALLBACK rop3_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	gdi_rop3_init_generic(rop3_kernels);
+#if defined(WITH_SSE2)
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		gdi_rop3_init_sse2(rop3_kernels);
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		gdi_rop3_init_avx2(rop3_kernels);
+#endif
+	return TRUE;
+}
+
+const gdi_rop3_row_fn* gdi_rop3_get_row_kernels(void)
+{
+	InitOnceExecuteOnce(&rop3_init_once, rop3_init, NULL, NULL);
+	return rop3_kernels;
+}
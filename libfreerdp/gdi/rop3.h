@@ -0,0 +1,52 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Row Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_ROP3_H
+#define FREERDP_LIB_GDI_ROP3_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+
+/**
+ * Apply a ternary raster operation to a row of 32bpp pixels.
+ *
+ * The operation works on the raw pixel values, so all three rows must be
+ * in the same pixel format. src and pat must point to width pixels even if
+ * the operation does not use them.
+ */
+typedef void (*gdi_rop3_row_fn)(UINT32* dst, const UINT32* src, const UINT32* pat, UINT32 width);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/* The fastest kernels for this CPU, indexed by ROP3 code */
+	FREERDP_LOCAL const gdi_rop3_row_fn* gdi_rop3_get_row_kernels(void);
+
+	FREERDP_LOCAL void gdi_rop3_init_generic(gdi_rop3_row_fn* kernels);
+#if defined(WITH_SSE2)
+	FREERDP_LOCAL void gdi_rop3_init_sse2(gdi_rop3_row_fn* kernels);
+	FREERDP_LOCAL void gdi_rop3_init_avx2(gdi_rop3_row_fn* kernels);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_GDI_ROP3_H */
@@ -0,0 +1,64 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Row Kernels (SSE2)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <emmintrin.h>
+
+#include "rop3.h"
+#include "rop3_table.h"
+
+#define ROP_ZERO _mm_setzero_si128()
+#define ROP_ONE _mm_set1_epi32(-1)
+#define ROP_NOT(_a) _mm_xor_si128((_a), _mm_set1_epi32(-1))
+#define ROP_AND(_a, _b) _mm_and_si128((_a), (_b))
+#define ROP_OR(_a, _b) _mm_or_si128((_a), (_b))
+#define ROP_XOR(_a, _b) _mm_xor_si128((_a), (_b))
+
+/* Remaining pixels of a row are handled by the generic kernels */
+static gdi_rop3_row_fn rop3_generic[256];
+
+#define ROP3_SSE2_KERNEL(_code, _expr)                                                   \
+	static void rop3_row_sse2_##_code(UINT32* dst, const UINT32* src, const UINT32* pat, \
+	                                  UINT32 width)                                      \
+	{                                                                                    \
+		UINT32 x = 0;                                                                    \
+                                                                                         \
+		for (; x + 4 <= width; x += 4)                                                   \
+		{                                                                                \
+			const __m128i D = _mm_loadu_si128((const __m128i*)&dst[x]);                  \
+			const __m128i S = _mm_loadu_si128((const __m128i*)&src[x]);                  \
+			const __m128i P = _mm_loadu_si128((const __m128i*)&pat[x]);                  \
+			WINPR_UNUSED(D);                                                             \
+			WINPR_UNUSED(S);                                                             \
+			WINPR_UNUSED(P);                                                             \
+			_mm_storeu_si128((__m128i*)&dst[x], _expr);                                  \
+		}                                                                                \
+                                                                                         \
+		if (x < width)                                                                   \
+			rop3_generic[_code](&dst[x], &src[x], &pat[x], width - x);                   \
+	}
+
+ROP3_FOR_EACH(ROP3_SSE2_KERNEL)
+
+#define ROP3_SSE2_ENTRY(_code, _expr) kernels[_code] = rop3_row_sse2_##_code;
+
+void gdi_rop3_init_sse2(gdi_rop3_row_fn* kernels)
+{
+	gdi_rop3_init_generic(rop3_generic);
+	ROP3_FOR_EACH(ROP3_SSE2_ENTRY)
+}
@@ -0,0 +1,287 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Expression Table
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_ROP3_TABLE_H
+#define FREERDP_LIB_GDI_ROP3_TABLE_H
+
+/**
+ * All 256 ternary raster operations as nested expressions, generated from
+ * the postfix strings of rop3_code_table in gdi.c.
+ *
+ * Users define X(code, expr) and the operators ROP_NOT, ROP_AND, ROP_OR,
+ * ROP_XOR, the constants ROP_ZERO, ROP_ONE and the operands D, S and P
+ * before expanding ROP3_FOR_EACH(X).
+ */
+#define ROP3_FOR_EACH(X)                                                                           \
+	X(0x00, ROP_ZERO) /* 0 */                                                                      \
+	X(0x01, ROP_NOT(ROP_OR(D, ROP_OR(P, S)))) /* DPSoon */                                         \
+	X(0x02, ROP_AND(D, ROP_NOT(ROP_OR(P, S)))) /* DPSona */                                        \
+	X(0x03, ROP_NOT(ROP_OR(P, S))) /* PSon */                                                      \
+	X(0x04, ROP_AND(S, ROP_NOT(ROP_OR(D, P)))) /* SDPona */                                        \
+	X(0x05, ROP_NOT(ROP_OR(D, P))) /* DPon */                                                      \
+	X(0x06, ROP_NOT(ROP_OR(P, ROP_NOT(ROP_XOR(D, S))))) /* PDSxnon */                              \
+	X(0x07, ROP_NOT(ROP_OR(P, ROP_AND(D, S)))) /* PDSaon */                                        \
+	X(0x08, ROP_AND(S, ROP_AND(D, ROP_NOT(P)))) /* SDPnaa */                                       \
+	X(0x09, ROP_NOT(ROP_OR(P, ROP_XOR(D, S)))) /* PDSxon */                                        \
+	X(0x0A, ROP_AND(D, ROP_NOT(P))) /* DPna */                                                     \
+	X(0x0B, ROP_NOT(ROP_OR(P, ROP_AND(S, ROP_NOT(D))))) /* PSDnaon */                              \
+	X(0x0C, ROP_AND(S, ROP_NOT(P))) /* SPna */                                                     \
+	X(0x0D, ROP_NOT(ROP_OR(P, ROP_AND(D, ROP_NOT(S))))) /* PDSnaon */                              \
+	X(0x0E, ROP_NOT(ROP_OR(P, ROP_NOT(ROP_OR(D, S))))) /* PDSonon */                               \
+	X(0x0F, ROP_NOT(P)) /* Pn */                                                                   \
+	X(0x10, ROP_AND(P, ROP_NOT(ROP_OR(D, S)))) /* PDSona */                                        \
+	X(0x11, ROP_NOT(ROP_OR(D, S))) /* DSon */                                                      \
+	X(0x12, ROP_NOT(ROP_OR(S, ROP_NOT(ROP_XOR(D, P))))) /* SDPxnon */                              \
+	X(0x13, ROP_NOT(ROP_OR(S, ROP_AND(D, P)))) /* SDPaon */                                        \
+	X(0x14, ROP_NOT(ROP_OR(D, ROP_NOT(ROP_XOR(P, S))))) /* DPSxnon */                              \
+	X(0x15, ROP_NOT(ROP_OR(D, ROP_AND(P, S)))) /* DPSaon */                                        \
+	X(0x16, ROP_XOR(P, ROP_XOR(S, ROP_AND(D, ROP_NOT(ROP_AND(P, S)))))) /* PSDPSanaxx */           \
+	X(0x17, ROP_NOT(ROP_XOR(S, ROP_AND(ROP_XOR(S, P), ROP_XOR(D, S))))) /* SSPxDSxaxn */           \
+	X(0x18, ROP_AND(ROP_XOR(S, P), ROP_XOR(P, D))) /* SPxPDxa */                                   \
+	X(0x19, ROP_NOT(ROP_XOR(S, ROP_AND(D, ROP_NOT(ROP_AND(P, S)))))) /* SDPSanaxn */               \
+	X(0x1A, ROP_XOR(P, ROP_OR(D, ROP_AND(S, P)))) /* PDSPaox */                                    \
+	X(0x1B, ROP_NOT(ROP_XOR(S, ROP_AND(D, ROP_XOR(P, S))))) /* SDPSxaxn */                         \
+	X(0x1C, ROP_XOR(P, ROP_OR(S, ROP_AND(D, P)))) /* PSDPaox */                                    \
+	X(0x1D, ROP_NOT(ROP_XOR(D, ROP_AND(S, ROP_XOR(P, D))))) /* DSPDxaxn */                         \
+	X(0x1E, ROP_XOR(P, ROP_OR(D, S))) /* PDSox */                                                  \
+	X(0x1F, ROP_NOT(ROP_AND(P, ROP_OR(D, S)))) /* PDSoan */                                        \
+	X(0x20, ROP_AND(D, ROP_AND(P, ROP_NOT(S)))) /* DPSnaa */                                       \
+	X(0x21, ROP_NOT(ROP_OR(S, ROP_XOR(D, P)))) /* SDPxon */                                        \
+	X(0x22, ROP_AND(D, ROP_NOT(S))) /* DSna */                                                     \
+	X(0x23, ROP_NOT(ROP_OR(S, ROP_AND(P, ROP_NOT(D))))) /* SPDnaon */                              \
+	X(0x24, ROP_AND(ROP_XOR(S, P), ROP_XOR(D, S))) /* SPxDSxa */                                   \
+	X(0x25, ROP_NOT(ROP_XOR(P, ROP_AND(D, ROP_NOT(ROP_AND(S, P)))))) /* PDSPanaxn */               \
+	X(0x26, ROP_XOR(S, ROP_OR(D, ROP_AND(P, S)))) /* SDPSaox */                                    \
+	X(0x27, ROP_XOR(S, ROP_OR(D, ROP_NOT(ROP_XOR(P, S))))) /* SDPSxnox */                          \
+	X(0x28, ROP_AND(D, ROP_XOR(P, S))) /* DPSxa */                                                 \
+	X(0x29, ROP_NOT(ROP_XOR(P, ROP_XOR(S, ROP_OR(D, ROP_AND(P, S)))))) /* PSDPSaoxxn */            \
+	X(0x2A, ROP_AND(D, ROP_NOT(ROP_AND(P, S)))) /* DPSana */                                       \
+	X(0x2B, ROP_NOT(ROP_XOR(S, ROP_AND(ROP_XOR(S, P), ROP_XOR(P, D))))) /* SSPxPDxaxn */           \
+	X(0x2C, ROP_XOR(S, ROP_AND(P, ROP_OR(D, S)))) /* SPDSoax */                                    \
+	X(0x2D, ROP_XOR(P, ROP_OR(S, ROP_NOT(D)))) /* PSDnox */                                        \
+	X(0x2E, ROP_XOR(P, ROP_OR(S, ROP_XOR(D, P)))) /* PSDPxox */                                    \
+	X(0x2F, ROP_NOT(ROP_AND(P, ROP_OR(S, ROP_NOT(D))))) /* PSDnoan */                              \
+	X(0x30, ROP_AND(P, ROP_NOT(S))) /* PSna */                                                     \
+	X(0x31, ROP_NOT(ROP_OR(S, ROP_AND(D, ROP_NOT(P))))) /* SDPnaon */                              \
+	X(0x32, ROP_XOR(S, ROP_OR(D, ROP_OR(P, S)))) /* SDPSoox */                                     \
+	X(0x33, ROP_NOT(S)) /* Sn */                                                                   \
+	X(0x34, ROP_XOR(S, ROP_OR(P, ROP_AND(D, S)))) /* SPDSaox */                                    \
+	X(0x35, ROP_XOR(S, ROP_OR(P, ROP_NOT(ROP_XOR(D, S))))) /* SPDSxnox */                          \
+	X(0x36, ROP_XOR(S, ROP_OR(D, P))) /* SDPox */                                                  \
+	X(0x37, ROP_NOT(ROP_AND(S, ROP_OR(D, P)))) /* SDPoan */                                        \
+	X(0x38, ROP_XOR(P, ROP_AND(S, ROP_OR(D, P)))) /* PSDPoax */                                    \
+	X(0x39, ROP_XOR(S, ROP_OR(P, ROP_NOT(D)))) /* SPDnox */                                        \
+	X(0x3A, ROP_XOR(S, ROP_OR(P, ROP_XOR(D, S)))) /* SPDSxox */                                    \
+	X(0x3B, ROP_NOT(ROP_AND(S, ROP_OR(P, ROP_NOT(D))))) /* SPDnoan */                              \
+	X(0x3C, ROP_XOR(P, S)) /* PSx */                                                               \
+	X(0x3D, ROP_XOR(S, ROP_OR(P, ROP_NOT(ROP_OR(D, S))))) /* SPDSonox */                           \
+	X(0x3E, ROP_XOR(S, ROP_OR(P, ROP_AND(D, ROP_NOT(S))))) /* SPDSnaox */                          \
+	X(0x3F, ROP_NOT(ROP_AND(P, S))) /* PSan */                                                     \
+	X(0x40, ROP_AND(P, ROP_AND(S, ROP_NOT(D)))) /* PSDnaa */                                       \
+	X(0x41, ROP_NOT(ROP_OR(D, ROP_XOR(P, S)))) /* DPSxon */                                        \
+	X(0x42, ROP_AND(ROP_XOR(S, D), ROP_XOR(P, D))) /* SDxPDxa */                                   \
+	X(0x43, ROP_NOT(ROP_XOR(S, ROP_AND(P, ROP_NOT(ROP_AND(D, S)))))) /* SPDSanaxn */               \
+	X(0x44, ROP_AND(S, ROP_NOT(D))) /* SDna */                                                     \
+	X(0x45, ROP_NOT(ROP_OR(D, ROP_AND(P, ROP_NOT(S))))) /* DPSnaon */                              \
+	X(0x46, ROP_XOR(D, ROP_OR(S, ROP_AND(P, D)))) /* DSPDaox */                                    \
+	X(0x47, ROP_NOT(ROP_XOR(P, ROP_AND(S, ROP_XOR(D, P))))) /* PSDPxaxn */                         \
+	X(0x48, ROP_AND(S, ROP_XOR(D, P))) /* SDPxa */                                                 \
+	X(0x49, ROP_NOT(ROP_XOR(P, ROP_XOR(D, ROP_OR(S, ROP_AND(P, D)))))) /* PDSPDaoxxn */            \
+	X(0x4A, ROP_XOR(D, ROP_AND(P, ROP_OR(S, D)))) /* DPSDoax */                                    \
+	X(0x4B, ROP_XOR(P, ROP_OR(D, ROP_NOT(S)))) /* PDSnox */                                        \
+	X(0x4C, ROP_AND(S, ROP_NOT(ROP_AND(D, P)))) /* SDPana */                                       \
+	X(0x4D, ROP_NOT(ROP_XOR(S, ROP_OR(ROP_XOR(S, P), ROP_XOR(D, S))))) /* SSPxDSxoxn */            \
+	X(0x4E, ROP_XOR(P, ROP_OR(D, ROP_XOR(S, P)))) /* PDSPxox */                                    \
+	X(0x4F, ROP_NOT(ROP_AND(P, ROP_OR(D, ROP_NOT(S))))) /* PDSnoan */                              \
+	X(0x50, ROP_AND(P, ROP_NOT(D))) /* PDna */                                                     \
+	X(0x51, ROP_NOT(ROP_OR(D, ROP_AND(S, ROP_NOT(P))))) /* DSPnaon */                              \
+	X(0x52, ROP_XOR(D, ROP_OR(P, ROP_AND(S, D)))) /* DPSDaox */                                    \
+	X(0x53, ROP_NOT(ROP_XOR(S, ROP_AND(P, ROP_XOR(D, S))))) /* SPDSxaxn */                         \
+	X(0x54, ROP_NOT(ROP_OR(D, ROP_NOT(ROP_OR(P, S))))) /* DPSonon */                               \
+	X(0x55, ROP_NOT(D)) /* Dn */                                                                   \
+	X(0x56, ROP_XOR(D, ROP_OR(P, S))) /* DPSox */                                                  \
+	X(0x57, ROP_NOT(ROP_AND(D, ROP_OR(P, S)))) /* DPSoan */                                        \
+	X(0x58, ROP_XOR(P, ROP_AND(D, ROP_OR(S, P)))) /* PDSPoax */                                    \
+	X(0x59, ROP_XOR(D, ROP_OR(P, ROP_NOT(S)))) /* DPSnox */                                        \
+	X(0x5A, ROP_XOR(D, P)) /* DPx */                                                               \
+	X(0x5B, ROP_XOR(D, ROP_OR(P, ROP_NOT(ROP_OR(S, D))))) /* DPSDonox */                           \
+	X(0x5C, ROP_XOR(D, ROP_OR(P, ROP_XOR(S, D)))) /* DPSDxox */                                    \
+	X(0x5D, ROP_NOT(ROP_AND(D, ROP_OR(P, ROP_NOT(S))))) /* DPSnoan */                              \
+	X(0x5E, ROP_XOR(D, ROP_OR(P, ROP_AND(S, ROP_NOT(D))))) /* DPSDnaox */                          \
+	X(0x5F, ROP_NOT(ROP_AND(D, P))) /* DPan */                                                     \
+	X(0x60, ROP_AND(P, ROP_XOR(D, S))) /* PDSxa */                                                 \
+	X(0x61, ROP_NOT(ROP_XOR(D, ROP_XOR(S, ROP_OR(P, ROP_AND(D, S)))))) /* DSPDSaoxxn */            \
+	X(0x62, ROP_XOR(D, ROP_AND(S, ROP_OR(P, D)))) /* DSPDoax */                                    \
+	X(0x63, ROP_XOR(S, ROP_OR(D, ROP_NOT(P)))) /* SDPnox */                                        \
+	X(0x64, ROP_XOR(S, ROP_AND(D, ROP_OR(P, S)))) /* SDPSoax */                                    \
+	X(0x65, ROP_XOR(D, ROP_OR(S, ROP_NOT(P)))) /* DSPnox */                                        \
+	X(0x66, ROP_XOR(D, S)) /* DSx */                                                               \
+	X(0x67, ROP_XOR(S, ROP_OR(D, ROP_NOT(ROP_OR(P, S))))) /* SDPSonox */                           \
+	X(0x68, ROP_NOT(ROP_XOR(D, ROP_XOR(S, ROP_OR(P, ROP_NOT(ROP_OR(D, S))))))) /* DSPDSonoxxn */   \
+	X(0x69, ROP_NOT(ROP_XOR(P, ROP_XOR(D, S)))) /* PDSxxn */                                       \
+	X(0x6A, ROP_XOR(D, ROP_AND(P, S))) /* DPSax */                                                 \
+	X(0x6B, ROP_NOT(ROP_XOR(P, ROP_XOR(S, ROP_AND(D, ROP_OR(P, S)))))) /* PSDPSoaxxn */            \
+	X(0x6C, ROP_XOR(S, ROP_AND(D, P))) /* SDPax */                                                 \
+	X(0x6D, ROP_NOT(ROP_XOR(P, ROP_XOR(D, ROP_AND(S, ROP_OR(P, D)))))) /* PDSPDoaxxn */            \
+	X(0x6E, ROP_XOR(S, ROP_AND(D, ROP_OR(P, ROP_NOT(S))))) /* SDPSnoax */                          \
+	X(0x6F, ROP_NOT(ROP_AND(P, ROP_NOT(ROP_XOR(D, S))))) /* PDSxnan */                             \
+	X(0x70, ROP_AND(P, ROP_NOT(ROP_AND(D, S)))) /* PDSana */                                       \
+	X(0x71, ROP_NOT(ROP_XOR(S, ROP_AND(ROP_XOR(S, D), ROP_XOR(P, D))))) /* SSDxPDxaxn */           \
+	X(0x72, ROP_XOR(S, ROP_OR(D, ROP_XOR(P, S)))) /* SDPSxox */                                    \
+	X(0x73, ROP_NOT(ROP_AND(S, ROP_OR(D, ROP_NOT(P))))) /* SDPnoan */                              \
+	X(0x74, ROP_XOR(D, ROP_OR(S, ROP_XOR(P, D)))) /* DSPDxox */                                    \
+	X(0x75, ROP_NOT(ROP_AND(D, ROP_OR(S, ROP_NOT(P))))) /* DSPnoan */                              \
+	X(0x76, ROP_XOR(S, ROP_OR(D, ROP_AND(P, ROP_NOT(S))))) /* SDPSnaox */                          \
+	X(0x77, ROP_NOT(ROP_AND(D, S))) /* DSan */                                                     \
+	X(0x78, ROP_XOR(P, ROP_AND(D, S))) /* PDSax */                                                 \
+	X(0x79, ROP_NOT(ROP_XOR(D, ROP_XOR(S, ROP_AND(P, ROP_OR(D, S)))))) /* DSPDSoaxxn */            \
+	X(0x7A, ROP_XOR(D, ROP_AND(P, ROP_OR(S, ROP_NOT(D))))) /* DPSDnoax */                          \
+	X(0x7B, ROP_NOT(ROP_AND(S, ROP_NOT(ROP_XOR(D, P))))) /* SDPxnan */                             \
+	X(0x7C, ROP_XOR(S, ROP_AND(P, ROP_OR(D, ROP_NOT(S))))) /* SPDSnoax */                          \
+	X(0x7D, ROP_NOT(ROP_AND(D, ROP_NOT(ROP_XOR(P, S))))) /* DPSxnan */                             \
+	X(0x7E, ROP_OR(ROP_XOR(S, P), ROP_XOR(D, S))) /* SPxDSxo */                                    \
+	X(0x7F, ROP_NOT(ROP_AND(D, ROP_AND(P, S)))) /* DPSaan */                                       \
+	X(0x80, ROP_AND(D, ROP_AND(P, S))) /* DPSaa */                                                 \
+	X(0x81, ROP_NOT(ROP_OR(ROP_XOR(S, P), ROP_XOR(D, S)))) /* SPxDSxon */                          \
+	X(0x82, ROP_AND(D, ROP_NOT(ROP_XOR(P, S)))) /* DPSxna */                                       \
+	X(0x83, ROP_NOT(ROP_XOR(S, ROP_AND(P, ROP_OR(D, ROP_NOT(S)))))) /* SPDSnoaxn */                \
+	X(0x84, ROP_AND(S, ROP_NOT(ROP_XOR(D, P)))) /* SDPxna */                                       \
+	X(0x85, ROP_NOT(ROP_XOR(P, ROP_AND(D, ROP_OR(S, ROP_NOT(P)))))) /* PDSPnoaxn */                \
+	X(0x86, ROP_XOR(D, ROP_XOR(S, ROP_AND(P, ROP_OR(D, S))))) /* DSPDSoaxx */                      \
+	X(0x87, ROP_NOT(ROP_XOR(P, ROP_AND(D, S)))) /* PDSaxn */                                       \
+	X(0x88, ROP_AND(D, S)) /* DSa */                                                               \
+	X(0x89, ROP_NOT(ROP_XOR(S, ROP_OR(D, ROP_AND(P, ROP_NOT(S)))))) /* SDPSnaoxn */                \
+	X(0x8A, ROP_AND(D, ROP_OR(S, ROP_NOT(P)))) /* DSPnoa */                                        \
+	X(0x8B, ROP_NOT(ROP_XOR(D, ROP_OR(S, ROP_XOR(P, D))))) /* DSPDxoxn */                          \
+	X(0x8C, ROP_AND(S, ROP_OR(D, ROP_NOT(P)))) /* SDPnoa */                                        \
+	X(0x8D, ROP_NOT(ROP_XOR(S, ROP_OR(D, ROP_XOR(P, S))))) /* SDPSxoxn */                          \
+	X(0x8E, ROP_XOR(S, ROP_AND(ROP_XOR(S, D), ROP_XOR(P, D)))) /* SSDxPDxax */                     \
+	X(0x8F, ROP_NOT(ROP_AND(P, ROP_NOT(ROP_AND(D, S))))) /* PDSanan */                             \
+	X(0x90, ROP_AND(P, ROP_NOT(ROP_XOR(D, S)))) /* PDSxna */                                       \
+	X(0x91, ROP_NOT(ROP_XOR(S, ROP_AND(D, ROP_OR(P, ROP_NOT(S)))))) /* SDPSnoaxn */                \
+	X(0x92, ROP_XOR(D, ROP_XOR(P, ROP_AND(S, ROP_OR(D, P))))) /* DPSDPoaxx */                      \
+	X(0x93, ROP_NOT(ROP_XOR(S, ROP_AND(P, D)))) /* SPDaxn */                                       \
+	X(0x94, ROP_XOR(P, ROP_XOR(S, ROP_AND(D, ROP_OR(P, S))))) /* PSDPSoaxx */                      \
+	X(0x95, ROP_NOT(ROP_XOR(D, ROP_AND(P, S)))) /* DPSaxn */                                       \
+	X(0x96, ROP_XOR(D, ROP_XOR(P, S))) /* DPSxx */                                                 \
+	X(0x97, ROP_XOR(P, ROP_XOR(S, ROP_OR(D, ROP_NOT(ROP_OR(P, S)))))) /* PSDPSonoxx */             \
+	X(0x98, ROP_NOT(ROP_XOR(S, ROP_OR(D, ROP_NOT(ROP_OR(P, S)))))) /* SDPSonoxn */                 \
+	X(0x99, ROP_NOT(ROP_XOR(D, S))) /* DSxn */                                                     \
+	X(0x9A, ROP_XOR(D, ROP_AND(P, ROP_NOT(S)))) /* DPSnax */                                       \
+	X(0x9B, ROP_NOT(ROP_XOR(S, ROP_AND(D, ROP_OR(P, S))))) /* SDPSoaxn */                          \
+	X(0x9C, ROP_XOR(S, ROP_AND(P, ROP_NOT(D)))) /* SPDnax */                                       \
+	X(0x9D, ROP_NOT(ROP_XOR(D, ROP_AND(S, ROP_OR(P, D))))) /* DSPDoaxn */                          \
+	X(0x9E, ROP_XOR(D, ROP_XOR(S, ROP_OR(P, ROP_AND(D, S))))) /* DSPDSaoxx */                      \
+	X(0x9F, ROP_NOT(ROP_AND(P, ROP_XOR(D, S)))) /* PDSxan */                                       \
+	X(0xA0, ROP_AND(D, P)) /* DPa */                                                               \
+	X(0xA1, ROP_NOT(ROP_XOR(P, ROP_OR(D, ROP_AND(S, ROP_NOT(P)))))) /* PDSPnaoxn */                \
+	X(0xA2, ROP_AND(D, ROP_OR(P, ROP_NOT(S)))) /* DPSnoa */                                        \
+	X(0xA3, ROP_NOT(ROP_XOR(D, ROP_OR(P, ROP_XOR(S, D))))) /* DPSDxoxn */                          \
+	X(0xA4, ROP_NOT(ROP_XOR(P, ROP_OR(D, ROP_NOT(ROP_OR(S, P)))))) /* PDSPonoxn */                 \
+	X(0xA5, ROP_NOT(ROP_XOR(P, D))) /* PDxn */                                                     \
+	X(0xA6, ROP_XOR(D, ROP_AND(S, ROP_NOT(P)))) /* DSPnax */                                       \
+	X(0xA7, ROP_NOT(ROP_XOR(P, ROP_AND(D, ROP_OR(S, P))))) /* PDSPoaxn */                          \
+	X(0xA8, ROP_AND(D, ROP_OR(P, S))) /* DPSoa */                                                  \
+	X(0xA9, ROP_NOT(ROP_XOR(D, ROP_OR(P, S)))) /* DPSoxn */                                        \
+	X(0xAA, D) /* D */                                                                             \
+	X(0xAB, ROP_OR(D, ROP_NOT(ROP_OR(P, S)))) /* DPSono */                                         \
+	X(0xAC, ROP_XOR(S, ROP_AND(P, ROP_XOR(D, S)))) /* SPDSxax */                                   \
+	X(0xAD, ROP_NOT(ROP_XOR(D, ROP_OR(P, ROP_AND(S, D))))) /* DPSDaoxn */                          \
+	X(0xAE, ROP_OR(D, ROP_AND(S, ROP_NOT(P)))) /* DSPnao */                                        \
+	X(0xAF, ROP_OR(D, ROP_NOT(P))) /* DPno */                                                      \
+	X(0xB0, ROP_AND(P, ROP_OR(D, ROP_NOT(S)))) /* PDSnoa */                                        \
+	X(0xB1, ROP_NOT(ROP_XOR(P, ROP_OR(D, ROP_XOR(S, P))))) /* PDSPxoxn */                          \
+	X(0xB2, ROP_XOR(S, ROP_OR(ROP_XOR(S, P), ROP_XOR(D, S)))) /* SSPxDSxox */                      \
+	X(0xB3, ROP_NOT(ROP_AND(S, ROP_NOT(ROP_AND(D, P))))) /* SDPanan */                             \
+	X(0xB4, ROP_XOR(P, ROP_AND(S, ROP_NOT(D)))) /* PSDnax */                                       \
+	X(0xB5, ROP_NOT(ROP_XOR(D, ROP_AND(P, ROP_OR(S, D))))) /* DPSDoaxn */                          \
+	X(0xB6, ROP_XOR(D, ROP_XOR(P, ROP_OR(S, ROP_AND(D, P))))) /* DPSDPaoxx */                      \
+	X(0xB7, ROP_NOT(ROP_AND(S, ROP_XOR(D, P)))) /* SDPxan */                                       \
+	X(0xB8, ROP_XOR(P, ROP_AND(S, ROP_XOR(D, P)))) /* PSDPxax */                                   \
+	X(0xB9, ROP_NOT(ROP_XOR(D, ROP_OR(S, ROP_AND(P, D))))) /* DSPDaoxn */                          \
+	X(0xBA, ROP_OR(D, ROP_AND(P, ROP_NOT(S)))) /* DPSnao */                                        \
+	X(0xBB, ROP_OR(D, ROP_NOT(S))) /* DSno */                                                      \
+	X(0xBC, ROP_XOR(S, ROP_AND(P, ROP_NOT(ROP_AND(D, S))))) /* SPDSanax */                         \
+	X(0xBD, ROP_NOT(ROP_AND(ROP_XOR(S, D), ROP_XOR(P, D)))) /* SDxPDxan */                         \
+	X(0xBE, ROP_OR(D, ROP_XOR(P, S))) /* DPSxo */                                                  \
+	X(0xBF, ROP_OR(D, ROP_NOT(ROP_AND(P, S)))) /* DPSano */                                        \
+	X(0xC0, ROP_AND(P, S)) /* PSa */                                                               \
+	X(0xC1, ROP_NOT(ROP_XOR(S, ROP_OR(P, ROP_AND(D, ROP_NOT(S)))))) /* SPDSnaoxn */                \
+	X(0xC2, ROP_NOT(ROP_XOR(S, ROP_OR(P, ROP_NOT(ROP_OR(D, S)))))) /* SPDSonoxn */                 \
+	X(0xC3, ROP_NOT(ROP_XOR(P, S))) /* PSxn */                                                     \
+	X(0xC4, ROP_AND(S, ROP_OR(P, ROP_NOT(D)))) /* SPDnoa */                                        \
+	X(0xC5, ROP_NOT(ROP_XOR(S, ROP_OR(P, ROP_XOR(D, S))))) /* SPDSxoxn */                          \
+	X(0xC6, ROP_XOR(S, ROP_AND(D, ROP_NOT(P)))) /* SDPnax */                                       \
+	X(0xC7, ROP_NOT(ROP_XOR(P, ROP_AND(S, ROP_OR(D, P))))) /* PSDPoaxn */                          \
+	X(0xC8, ROP_AND(S, ROP_OR(D, P))) /* SDPoa */                                                  \
+	X(0xC9, ROP_NOT(ROP_XOR(S, ROP_OR(P, D)))) /* SPDoxn */                                        \
+	X(0xCA, ROP_XOR(D, ROP_AND(P, ROP_XOR(S, D)))) /* DPSDxax */                                   \
+	X(0xCB, ROP_NOT(ROP_XOR(S, ROP_OR(P, ROP_AND(D, S))))) /* SPDSaoxn */                          \
+	X(0xCC, S) /* S */                                                                             \
+	X(0xCD, ROP_OR(S, ROP_NOT(ROP_OR(D, P)))) /* SDPono */                                         \
+	X(0xCE, ROP_OR(S, ROP_AND(D, ROP_NOT(P)))) /* SDPnao */                                        \
+	X(0xCF, ROP_OR(S, ROP_NOT(P))) /* SPno */                                                      \
+	X(0xD0, ROP_AND(P, ROP_OR(S, ROP_NOT(D)))) /* PSDnoa */                                        \
+	X(0xD1, ROP_NOT(ROP_XOR(P, ROP_OR(S, ROP_XOR(D, P))))) /* PSDPxoxn */                          \
+	X(0xD2, ROP_XOR(P, ROP_AND(D, ROP_NOT(S)))) /* PDSnax */                                       \
+	X(0xD3, ROP_NOT(ROP_XOR(S, ROP_AND(P, ROP_OR(D, S))))) /* SPDSoaxn */                          \
+	X(0xD4, ROP_XOR(S, ROP_AND(ROP_XOR(S, P), ROP_XOR(P, D)))) /* SSPxPDxax */                     \
+	X(0xD5, ROP_NOT(ROP_AND(D, ROP_NOT(ROP_AND(P, S))))) /* DPSanan */                             \
+	X(0xD6, ROP_XOR(P, ROP_XOR(S, ROP_OR(D, ROP_AND(P, S))))) /* PSDPSaoxx */                      \
+	X(0xD7, ROP_NOT(ROP_AND(D, ROP_XOR(P, S)))) /* DPSxan */                                       \
+	X(0xD8, ROP_XOR(P, ROP_AND(D, ROP_XOR(S, P)))) /* PDSPxax */                                   \
+	X(0xD9, ROP_NOT(ROP_XOR(S, ROP_OR(D, ROP_AND(P, S))))) /* SDPSaoxn */                          \
+	X(0xDA, ROP_XOR(D, ROP_AND(P, ROP_NOT(ROP_AND(S, D))))) /* DPSDanax */                         \
+	X(0xDB, ROP_NOT(ROP_AND(ROP_XOR(S, P), ROP_XOR(D, S)))) /* SPxDSxan */                         \
+	X(0xDC, ROP_OR(S, ROP_AND(P, ROP_NOT(D)))) /* SPDnao */                                        \
+	X(0xDD, ROP_OR(S, ROP_NOT(D))) /* SDno */                                                      \
+	X(0xDE, ROP_OR(S, ROP_XOR(D, P))) /* SDPxo */                                                  \
+	X(0xDF, ROP_OR(S, ROP_NOT(ROP_AND(D, P)))) /* SDPano */                                        \
+	X(0xE0, ROP_AND(P, ROP_OR(D, S))) /* PDSoa */                                                  \
+	X(0xE1, ROP_NOT(ROP_XOR(P, ROP_OR(D, S)))) /* PDSoxn */                                        \
+	X(0xE2, ROP_XOR(D, ROP_AND(S, ROP_XOR(P, D)))) /* DSPDxax */                                   \
+	X(0xE3, ROP_NOT(ROP_XOR(P, ROP_OR(S, ROP_AND(D, P))))) /* PSDPaoxn */                          \
+	X(0xE4, ROP_XOR(S, ROP_AND(D, ROP_XOR(P, S)))) /* SDPSxax */                                   \
+	X(0xE5, ROP_NOT(ROP_XOR(P, ROP_OR(D, ROP_AND(S, P))))) /* PDSPaoxn */                          \
+	X(0xE6, ROP_XOR(S, ROP_AND(D, ROP_NOT(ROP_AND(P, S))))) /* SDPSanax */                         \
+	X(0xE7, ROP_NOT(ROP_AND(ROP_XOR(S, P), ROP_XOR(P, D)))) /* SPxPDxan */                         \
+	X(0xE8, ROP_XOR(S, ROP_AND(ROP_XOR(S, P), ROP_XOR(D, S)))) /* SSPxDSxax */                     \
+	X(0xE9, ROP_NOT(ROP_XOR(D, ROP_XOR(S, ROP_AND(P, ROP_NOT(ROP_AND(D, S))))))) /* DSPDSanaxxn */ \
+	X(0xEA, ROP_OR(D, ROP_AND(P, S))) /* DPSao */                                                  \
+	X(0xEB, ROP_OR(D, ROP_NOT(ROP_XOR(P, S)))) /* DPSxno */                                        \
+	X(0xEC, ROP_OR(S, ROP_AND(D, P))) /* SDPao */                                                  \
+	X(0xED, ROP_OR(S, ROP_NOT(ROP_XOR(D, P)))) /* SDPxno */                                        \
+	X(0xEE, ROP_OR(D, S)) /* DSo */                                                                \
+	X(0xEF, ROP_OR(S, ROP_OR(D, ROP_NOT(P)))) /* SDPnoo */                                         \
+	X(0xF0, P) /* P */                                                                             \
+	X(0xF1, ROP_OR(P, ROP_NOT(ROP_OR(D, S)))) /* PDSono */                                         \
+	X(0xF2, ROP_OR(P, ROP_AND(D, ROP_NOT(S)))) /* PDSnao */                                        \
+	X(0xF3, ROP_OR(P, ROP_NOT(S))) /* PSno */                                                      \
+	X(0xF4, ROP_OR(P, ROP_AND(S, ROP_NOT(D)))) /* PSDnao */                                        \
+	X(0xF5, ROP_OR(P, ROP_NOT(D))) /* PDno */                                                      \
+	X(0xF6, ROP_OR(P, ROP_XOR(D, S))) /* PDSxo */                                                  \
+	X(0xF7, ROP_OR(P, ROP_NOT(ROP_AND(D, S)))) /* PDSano */                                        \
+	X(0xF8, ROP_OR(P, ROP_AND(D, S))) /* PDSao */                                                  \
+	X(0xF9, ROP_OR(P, ROP_NOT(ROP_XOR(D, S)))) /* PDSxno */                                        \
+	X(0xFA, ROP_OR(D, P)) /* DPo */                                                                \
+	X(0xFB, ROP_OR(D, ROP_OR(P, ROP_NOT(S)))) /* DPSnoo */                                         \
+	X(0xFC, ROP_OR(P, S)) /* PSo */                                                                \
+	X(0xFD, ROP_OR(P, ROP_OR(S, ROP_NOT(D)))) /* PSDnoo */                                         \
+	X(0xFE, ROP_OR(D, ROP_OR(P, S))) /* DPSoo */                                                   \
+	X(0xFF, ROP_ONE) /* 1 */
+
+#endif /* FREERDP_LIB_GDI_ROP3_TABLE_H */
@@ -0,0 +1,416 @@
+#include <freerdp/gdi/gdi.h>
+
+#include <freerdp/gdi/dc.h>
+#include <freerdp/gdi/bitmap.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include "brush.h"
+#include "rop3.h"
+
+#define TEST_WIDTH 37
+#define TEST_HEIGHT 11
+#define BENCH_SIZE 256
+#define BENCH_ROUNDS 20
+
+/* Same semantics as process_rop in bitmap.c, kept here as reference */
+static UINT32 reference_rop(UINT32 src, UINT32 dst, UINT32 pat, const char* rop, UINT32 format)
+{
+	UINT32 stack[10] = { 0 };
+	UINT32 stackp = 0;
+
+	while (*rop != '\0')
+	{
+		const char op = *rop++;
+
+		switch (op)
+		{
+			case '0':
+				stack[stackp++] = FreeRDPGetColor(format, 0, 0, 0, 0xFF);
+				break;
+
+			case '1':
+				stack[stackp++] = FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF);
+				break;
+
+			case 'D':
+				stack[stackp++] = dst;
+				break;
+
+			case 'S':
+				stack[stackp++] = src;
+				break;
+
+			case 'P':
+				stack[stackp++] = pat;
+				break;
+
+			case 'x':
+				stackp--;
+				stack[stackp - 1] ^= stack[stackp];
+				break;
+
+			case 'a':
+				stackp--;
+				stack[stackp - 1] &= stack[stackp];
+				break;
+
+			case 'o':
+				stackp--;
+				stack[stackp - 1] |= stack[stackp];
+				break;
+
+			case 'n':
+				stack[stackp - 1] = ~stack[stackp - 1];
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return stack[0];
+}
+
+static void fill_random(UINT32* data, size_t count)
+{
+	winpr_RAND((BYTE*)data, count * sizeof(UINT32));
+}
+
+static BOOL test_row_kernels(const char* name, const gdi_rop3_row_fn* kernels)
+{
+	UINT32 code;
+	UINT32 x;
+	UINT32 src[TEST_WIDTH];
+	UINT32 pat[TEST_WIDTH];
+	UINT32 dst[TEST_WIDTH];
+	UINT32 expected[TEST_WIDTH];
+
+	/* BLACKNESS and WHITENESS depend on the pixel format and are never dispatched */
+	for (code = 0x01; code < 0xFF; code++)
+	{
+		const char* rop = gdi_rop3_code_string((BYTE)code);
+		fill_random(src, ARRAYSIZE(src));
+		fill_random(pat, ARRAYSIZE(pat));
+		fill_random(dst, ARRAYSIZE(dst));
+
+		for (x = 0; x < TEST_WIDTH; x++)
+			expected[x] = reference_rop(src[x], dst[x], pat[x], rop, PIXEL_FORMAT_ARGB32);
+
+		kernels[code](dst, src, pat, TEST_WIDTH);
+
+		if (memcmp(dst, expected, sizeof(dst)) != 0)
+		{
+			fprintf(stderr, "[%s] kernel 0x%02" PRIX32 " [%s] mismatch\n", name, code, rop);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static HGDI_BITMAP create_random_bitmap(UINT32 width, UINT32 height, UINT32 format)
+{
+	HGDI_BITMAP bmp;
+	const size_t size = 1ull * width * height * FreeRDPGetBytesPerPixel(format);
+	BYTE* data = _aligned_malloc(size, 16);
+
+	if (!data)
+		return NULL;
+
+	winpr_RAND(data, size);
+	bmp = gdi_CreateBitmap(width, height, format, data);
+
+	if (!bmp)
+		_aligned_free(data);
+
+	return bmp;
+}
+
+static BOOL reference_bitblt(HGDI_BITMAP expected, INT32 nXDst, INT32 nYDst, INT32 nWidth,
+                             INT32 nHeight, HGDI_BITMAP src, INT32 nXSrc, INT32 nYSrc,
+                             HGDI_DC hdcDst, DWORD rop)
+{
+	INT32 x, y;
+	const char* str = gdi_rop_to_string(rop);
+	const UINT32 format = expected->format;
+	const size_t bpp = FreeRDPGetBytesPerPixel(format);
+	BYTE* copy = NULL;
+
+	/* Snapshot the source so overlapping blits read unmodified pixels */
+	if (src)
+	{
+		copy = malloc(1ull * src->scanline * src->height);
+
+		if (!copy)
+			return FALSE;
+
+		memcpy(copy, src->data, 1ull * src->scanline * src->height);
+	}
+
+	for (y = 0; y < nHeight; y++)
+	{
+		for (x = 0; x < nWidth; x++)
+		{
+			BYTE* dstp = &expected->data[(nYDst + y) * expected->scanline + (nXDst + x) * bpp];
+			const UINT32 colorD = FreeRDPReadColor(dstp, format);
+			UINT32 colorS = 0;
+			UINT32 colorP = 0;
+
+			if (copy)
+			{
+				const BYTE* srcp = &copy[(nYSrc + y) * src->scanline + (nXSrc + x) * bpp];
+				colorS = FreeRDPConvertColor(FreeRDPReadColor(srcp, src->format), src->format,
+				                             format, NULL);
+			}
+
+			switch (gdi_GetBrushStyle(hdcDst))
+			{
+				case GDI_BS_SOLID:
+					colorP = hdcDst->brush->color;
+					break;
+
+				case GDI_BS_PATTERN:
+				{
+					const HGDI_BITMAP pattern = hdcDst->brush->pattern;
+					const INT32 px = (nXDst + x) % pattern->width;
+					const INT32 py = (nYDst + y) % pattern->height;
+					colorP = FreeRDPReadColor(&pattern->data[py * pattern->scanline + px * bpp],
+					                          format);
+				}
+				break;
+
+				default:
+					break;
+			}
+
+			FreeRDPWriteColor(dstp, format, reference_rop(colorS, colorD, colorP, str, format));
+		}
+	}
+
+	free(copy);
+	return TRUE;
+}
+
+static BOOL bitmaps_equal(HGDI_BITMAP a, HGDI_BITMAP b)
+{
+	return memcmp(a->data, b->data, 1ull * a->scanline * a->height) == 0;
+}
+
+static BOOL test_bitblt_format(UINT32 format)
+{
+	BOOL rc = FALSE;
+	UINT32 code;
+	UINT32 brushIndex;
+	HGDI_DC hdcSrc = NULL;
+	HGDI_DC hdcDst = NULL;
+	HGDI_BITMAP hBmpSrc = NULL;
+	HGDI_BITMAP hBmpDst = NULL;
+	HGDI_BITMAP hBmpExpected = NULL;
+	HGDI_BITMAP hBmpPattern = NULL;
+	HGDI_BRUSH brushes[2] = { 0 };
+	const size_t size = 1ull * TEST_WIDTH * TEST_HEIGHT * FreeRDPGetBytesPerPixel(format);
+
+	if (!(hdcSrc = gdi_GetDC()) || !(hdcDst = gdi_GetDC()))
+		goto fail;
+
+	hdcSrc->format = format;
+	hdcDst->format = format;
+	hBmpSrc = create_random_bitmap(TEST_WIDTH, TEST_HEIGHT, format);
+	hBmpDst = create_random_bitmap(TEST_WIDTH, TEST_HEIGHT, format);
+	hBmpExpected = create_random_bitmap(TEST_WIDTH, TEST_HEIGHT, format);
+	hBmpPattern = create_random_bitmap(8, 8, format);
+
+	if (!hBmpSrc || !hBmpDst || !hBmpExpected || !hBmpPattern)
+		goto fail;
+
+	brushes[0] = gdi_CreateSolidBrush(FreeRDPGetColor(format, 0x12, 0x34, 0x56, 0x78));
+	brushes[1] = gdi_CreatePatternBrush(hBmpPattern);
+
+	if (!brushes[0] || !brushes[1])
+		goto fail;
+
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT)hBmpSrc);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)hBmpDst);
+
+	for (brushIndex = 0; brushIndex < ARRAYSIZE(brushes); brushIndex++)
+	{
+		gdi_SelectObject(hdcDst, (HGDIOBJECT)brushes[brushIndex]);
+
+		for (code = 0; code < 256; code++)
+		{
+			const DWORD rop = gdi_rop3_code((BYTE)code);
+
+			if ((rop == GDI_SRCCOPY) || (rop == GDI_DSTCOPY))
+				continue;
+
+			/* Separate source bitmap */
+			winpr_RAND(hBmpDst->data, size);
+			memcpy(hBmpExpected->data, hBmpDst->data, size);
+
+			if (!reference_bitblt(hBmpExpected, 3, 2, 29, 7, hBmpSrc, 1, 4, hdcDst, rop))
+				goto fail;
+
+			if (!gdi_BitBlt(hdcDst, 3, 2, 29, 7, hdcSrc, 1, 4, rop, NULL))
+				goto fail;
+
+			if (!bitmaps_equal(hBmpDst, hBmpExpected))
+			{
+				fprintf(stderr, "[%s] gdi_BitBlt %s brush=%" PRIu32 " mismatch\n",
+				        FreeRDPGetColorFormatName(format), gdi_rop3_code_string((BYTE)code),
+				        brushIndex);
+				goto fail;
+			}
+
+			/* Overlapping blit within the destination bitmap */
+			winpr_RAND(hBmpDst->data, size);
+			memcpy(hBmpExpected->data, hBmpDst->data, size);
+
+			if (!reference_bitblt(hBmpExpected, 5, 1, 30, 9, hBmpExpected, 2, 2, hdcDst, rop))
+				goto fail;
+
+			if (!gdi_BitBlt(hdcDst, 5, 1, 30, 9, hdcDst, 2, 2, rop, NULL))
+				goto fail;
+
+			if (!bitmaps_equal(hBmpDst, hBmpExpected))
+			{
+				fprintf(stderr, "[%s] overlapping gdi_BitBlt %s brush=%" PRIu32 " mismatch\n",
+				        FreeRDPGetColorFormatName(format), gdi_rop3_code_string((BYTE)code),
+				        brushIndex);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	gdi_SelectObject(hdcDst, NULL);
+
+	for (brushIndex = 0; brushIndex < ARRAYSIZE(brushes); brushIndex++)
+		gdi_DeleteObject((HGDIOBJECT)brushes[brushIndex]);
+
+	gdi_DeleteObject((HGDIOBJECT)hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT)hBmpDst);
+	gdi_DeleteObject((HGDIOBJECT)hBmpExpected);
+	gdi_DeleteObject((HGDIOBJECT)hBmpPattern);
+	gdi_DeleteDC(hdcSrc);
+	gdi_DeleteDC(hdcDst);
+	return rc;
+}
+
+static BOOL benchmark_rop(DWORD rop)
+{
+	BOOL rc = FALSE;
+	UINT32 x;
+	UINT64 start;
+	UINT64 interpreter;
+	UINT64 kernels;
+	HGDI_DC hdcSrc = NULL;
+	HGDI_DC hdcDst = NULL;
+	HGDI_BITMAP hBmpSrc = NULL;
+	HGDI_BITMAP hBmpDst = NULL;
+	HGDI_BRUSH brush = NULL;
+	const UINT32 format = PIXEL_FORMAT_BGRX32;
+
+	if (!(hdcSrc = gdi_GetDC()) || !(hdcDst = gdi_GetDC()))
+		goto fail;
+
+	hdcSrc->format = format;
+	hdcDst->format = format;
+	hBmpSrc = create_random_bitmap(BENCH_SIZE, BENCH_SIZE, format);
+	hBmpDst = create_random_bitmap(BENCH_SIZE, BENCH_SIZE, format);
+	brush = gdi_CreateSolidBrush(FreeRDPGetColor(format, 0x12, 0x34, 0x56, 0xFF));
+
+	if (!hBmpSrc || !hBmpDst || !brush)
+		goto fail;
+
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT)hBmpSrc);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)hBmpDst);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)brush);
+
+	/* The per pixel reference is what BitBlt_write did for every ROP before */
+	start = winpr_GetTickCount64();
+
+	for (x = 0; x < BENCH_ROUNDS; x++)
+	{
+		if (!reference_bitblt(hBmpDst, 0, 0, BENCH_SIZE, BENCH_SIZE, hBmpSrc, 0, 0, hdcDst, rop))
+			goto fail;
+	}
+
+	interpreter = winpr_GetTickCount64() - start;
+	start = winpr_GetTickCount64();
+
+	for (x = 0; x < BENCH_ROUNDS; x++)
+	{
+		if (!gdi_BitBlt(hdcDst, 0, 0, BENCH_SIZE, BENCH_SIZE, hdcSrc, 0, 0, rop, NULL))
+			goto fail;
+	}
+
+	kernels = winpr_GetTickCount64() - start;
+	printf("%-10s %" PRIu32 "x %dx%d: interpreter %" PRIu64 "ms, kernels %" PRIu64 "ms\n",
+	       gdi_rop_to_string(rop), BENCH_ROUNDS, BENCH_SIZE, BENCH_SIZE, interpreter, kernels);
+	rc = TRUE;
+fail:
+	gdi_SelectObject(hdcDst, NULL);
+	gdi_DeleteObject((HGDIOBJECT)brush);
+	gdi_DeleteObject((HGDIOBJECT)hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT)hBmpDst);
+	gdi_DeleteDC(hdcSrc);
+	gdi_DeleteDC(hdcDst);
+	return rc;
+}
+
+int TestGdiRop3Kernels(int argc, char* argv[])
+{
+	UINT32 x;
+	gdi_rop3_row_fn kernels[256] = { 0 };
+	const UINT32 formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_BGRX32,
+		                       PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_RGBX32, PIXEL_FORMAT_XBGR32,
+		                       PIXEL_FORMAT_RGB16 };
+	const DWORD benchmarks[] = { GDI_SRCAND, GDI_PATINVERT, GDI_DSPDxax };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	gdi_rop3_init_generic(kernels);
+
+	if (!test_row_kernels("generic", kernels))
+		return -1;
+
+#if defined(WITH_SSE2)
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+	{
+		gdi_rop3_init_sse2(kernels);
+
+		if (!test_row_kernels("sse2", kernels))
+			return -1;
+	}
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		gdi_rop3_init_avx2(kernels);
+
+		if (!test_row_kernels("avx2", kernels))
+			return -1;
+	}
+#endif
+
+	if (!test_row_kernels("dispatch", gdi_rop3_get_row_kernels()))
+		return -1;
+
+	for (x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		if (!test_bitblt_format(formats[x]))
+			return -1;
+	}
+
+	for (x = 0; x < ARRAYSIZE(benchmarks); x++)
+	{
+		if (!benchmark_rop(benchmarks[x]))
+			return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,642 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized YUV/RGB conversion operations using AVX2
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+
+#include <immintrin.h>
+
+#if !defined(WITH_SSE2)
+#error "This file needs WITH_SSE2 enabled!"
+#endif
+
+/* The arithmetic mirrors prim_YUV_ssse3.c so both tiers produce identical
+ * output, only the register width differs. Most AVX2 instructions operate on
+ * two independent 128 bit lanes, the permutes below restore the pixel order
+ * after the in-lane packs and horizontal adds. */
+
+static primitives_t* sse = NULL;
+
+/****************************************************************************/
+/* AVX2 YUV -> RGB conversion                                               */
+/****************************************************************************/
+
+/* Converts 16 pixels and stores them as BGRX, the alpha bytes at dst are kept. */
+static INLINE void avx2_YUV444Pixel16(BYTE* dst, __m128i Yraw, __m128i Uraw, __m128i Vraw)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c128 = _mm256_set1_epi16(128);
+	const __m256i Y = _mm256_cvtepu8_epi16(Yraw);
+	const __m256i D = _mm256_sub_epi16(_mm256_cvtepu8_epi16(Uraw), c128); /* D = U - 128 */
+	const __m256i E = _mm256_sub_epi16(_mm256_cvtepu8_epi16(Vraw), c128); /* E = V - 128 */
+	const __m256i Ylo = _mm256_slli_epi32(_mm256_unpacklo_epi16(Y, zero), 8);
+	const __m256i Yhi = _mm256_slli_epi32(_mm256_unpackhi_epi16(Y, zero), 8);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	__m256i R, G, B;
+	{
+		/* R = (256 * Y + 403 * E) >> 8 */
+		const __m256i f = _mm256_set1_epi16(403);
+		const __m256i lo = _mm256_add_epi32(Ylo, _mm256_madd_epi16(_mm256_unpacklo_epi16(E, zero), f));
+		const __m256i hi = _mm256_add_epi32(Yhi, _mm256_madd_epi16(_mm256_unpackhi_epi16(E, zero), f));
+		R = _mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8));
+	}
+	{
+		/* G = (256 * Y - 48 * D - 120 * E) >> 8 */
+		const __m256i f =
+		    _mm256_unpacklo_epi16(_mm256_set1_epi16(-48), _mm256_set1_epi16(-120));
+		const __m256i lo = _mm256_add_epi32(Ylo, _mm256_madd_epi16(_mm256_unpacklo_epi16(D, E), f));
+		const __m256i hi = _mm256_add_epi32(Yhi, _mm256_madd_epi16(_mm256_unpackhi_epi16(D, E), f));
+		G = _mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8));
+	}
+	{
+		/* B = (256 * Y + 475 * D) >> 8 */
+		const __m256i f = _mm256_set1_epi16(475);
+		const __m256i lo = _mm256_add_epi32(Ylo, _mm256_madd_epi16(_mm256_unpacklo_epi16(D, zero), f));
+		const __m256i hi = _mm256_add_epi32(Yhi, _mm256_madd_epi16(_mm256_unpackhi_epi16(D, zero), f));
+		B = _mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8));
+	}
+	{
+		/* The saturating packs clip to [0, 255]. Per lane: B0..B7 R0..R7 and G0..G7 00..00 */
+		const __m256i br = _mm256_packus_epi16(B, R);
+		const __m256i g0 = _mm256_packus_epi16(G, zero);
+		const __m256i bg = _mm256_unpacklo_epi8(br, g0);
+		const __m256i r0 = _mm256_unpackhi_epi8(br, g0);
+		const __m256i lo = _mm256_unpacklo_epi16(bg, r0); /* pixels 0-3 | 8-11 */
+		const __m256i hi = _mm256_unpackhi_epi16(bg, r0); /* pixels 4-7 | 12-15 */
+		__m256i* d = (__m256i*)dst;
+		const __m256i a0 = _mm256_and_si256(_mm256_loadu_si256(d), alpha);
+		const __m256i a1 = _mm256_and_si256(_mm256_loadu_si256(d + 1), alpha);
+		_mm256_storeu_si256(d, _mm256_or_si256(a0, _mm256_permute2x128_si256(lo, hi, 0x20)));
+		_mm256_storeu_si256(d + 1, _mm256_or_si256(a1, _mm256_permute2x128_si256(lo, hi, 0x31)));
+	}
+}
+
+static pstatus_t avx2_YUV420ToRGB_BGRX(const BYTE* const* pSrc, const UINT32* srcStep, BYTE* pDst,
+                                       UINT32 dstStep, const prim_size_t* roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+	const UINT32 pad = roi->width % 16;
+	UINT32 y;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		UINT32 x;
+		BYTE* dst = pDst + 1ULL * dstStep * y;
+		const BYTE* YData = pSrc[0] + 1ULL * y * srcStep[0];
+		const BYTE* UData = pSrc[1] + 1ULL * (y / 2) * srcStep[1];
+		const BYTE* VData = pSrc[2] + 1ULL * (y / 2) * srcStep[2];
+
+		for (x = 0; x < nWidth - pad; x += 16)
+		{
+			const __m128i Y = _mm_loadu_si128((const __m128i*)&YData[x]);
+			const __m128i uRaw = _mm_loadl_epi64((const __m128i*)&UData[x / 2]);
+			const __m128i vRaw = _mm_loadl_epi64((const __m128i*)&VData[x / 2]);
+			avx2_YUV444Pixel16(&dst[4 * x], Y, _mm_unpacklo_epi8(uRaw, uRaw),
+			                   _mm_unpacklo_epi8(vRaw, vRaw));
+		}
+
+		for (; x < nWidth; x++)
+		{
+			const BYTE Y = YData[x];
+			const BYTE U = UData[x / 2];
+			const BYTE V = VData[x / 2];
+			const BYTE r = YUV2R(Y, U, V);
+			const BYTE g = YUV2G(Y, U, V);
+			const BYTE b = YUV2B(Y, U, V);
+			writePixelBGRX(&dst[4 * x], 4, PIXEL_FORMAT_BGRX32, r, g, b, 0);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV420ToRGB(const BYTE* const* pSrc, const UINT32* srcStep, BYTE* pDst,
+                                  UINT32 dstStep, UINT32 DstFormat, const prim_size_t* roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUV420ToRGB_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return sse->YUV420ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+static pstatus_t avx2_YUV444ToRGB_8u_P3AC4R_BGRX(const BYTE* const* pSrc, const UINT32* srcStep,
+                                                 BYTE* pDst, UINT32 dstStep,
+                                                 const prim_size_t* roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+	const UINT32 pad = roi->width % 16;
+	UINT32 y;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		UINT32 x;
+		BYTE* dst = pDst + 1ULL * dstStep * y;
+		const BYTE* YData = pSrc[0] + 1ULL * y * srcStep[0];
+		const BYTE* UData = pSrc[1] + 1ULL * y * srcStep[1];
+		const BYTE* VData = pSrc[2] + 1ULL * y * srcStep[2];
+
+		for (x = 0; x < nWidth - pad; x += 16)
+		{
+			const __m128i Y = _mm_loadu_si128((const __m128i*)&YData[x]);
+			const __m128i U = _mm_loadu_si128((const __m128i*)&UData[x]);
+			const __m128i V = _mm_loadu_si128((const __m128i*)&VData[x]);
+			avx2_YUV444Pixel16(&dst[4 * x], Y, U, V);
+		}
+
+		for (; x < nWidth; x++)
+		{
+			const BYTE Y = YData[x];
+			const BYTE U = UData[x];
+			const BYTE V = VData[x];
+			const BYTE r = YUV2R(Y, U, V);
+			const BYTE g = YUV2G(Y, U, V);
+			const BYTE b = YUV2B(Y, U, V);
+			writePixelBGRX(&dst[4 * x], 4, PIXEL_FORMAT_BGRX32, r, g, b, 0);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV444ToRGB_8u_P3AC4R(const BYTE* const* pSrc, const UINT32* srcStep,
+                                            BYTE* pDst, UINT32 dstStep, UINT32 DstFormat,
+                                            const prim_size_t* roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUV444ToRGB_8u_P3AC4R_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return sse->YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> YUV conversion                                               */
+/****************************************************************************/
+
+/* See prim_YUV_ssse3.c for the derivation of the factors, these are the
+ * same B, G, R, X byte factors repeated for 8 pixels. */
+#define BGRX_Y_FACTORS _mm256_set1_epi32(0x001B5C09)  /*   9,   92,  27, 0 */
+#define BGRX_U_FACTORS _mm256_set1_epi32(0x00E39D7F)  /* 127,  -99, -29, 0 */
+#define BGRX_V_FACTORS _mm256_set1_epi32(0x007F8CF4)  /* -12, -116, 127, 0 */
+#define CONST128_FACTORS _mm256_set1_epi8(-128)
+
+#define Y_SHIFT 7
+#define U_SHIFT 8
+#define V_SHIFT 8
+
+/* Undoes the lane interleave of packing two hadd results:
+ * dwords [0 1 2 3 | 4 5 6 7] -> [0 4 1 5 | 2 6 3 7] */
+#define AVX2_ORDER_DWORDS _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)
+
+static INLINE void avx2_load_bgrx32(const BYTE* src, __m256i px[4])
+{
+	const __m256i* argb = (const __m256i*)src;
+	px[0] = _mm256_loadu_si256(argb);
+	px[1] = _mm256_loadu_si256(argb + 1);
+	px[2] = _mm256_loadu_si256(argb + 2);
+	px[3] = _mm256_loadu_si256(argb + 3);
+}
+
+/* Weighted sums of 32 pixels. The words of *lo hold pixels [0-3, 8-11 | 4-7, 12-15],
+ * *hi the same for pixels 16-31. */
+static INLINE void avx2_bgrx_madd(const __m256i px[4], __m256i factors, __m256i* lo, __m256i* hi)
+{
+	*lo = _mm256_hadd_epi16(_mm256_maddubs_epi16(px[0], factors),
+	                        _mm256_maddubs_epi16(px[1], factors));
+	*hi = _mm256_hadd_epi16(_mm256_maddubs_epi16(px[2], factors),
+	                        _mm256_maddubs_epi16(px[3], factors));
+}
+
+/* 32 luma bytes in pixel order */
+static INLINE __m256i avx2_bgrx_to_y(const __m256i px[4])
+{
+	__m256i lo, hi;
+	avx2_bgrx_madd(px, BGRX_Y_FACTORS, &lo, &hi);
+	lo = _mm256_srli_epi16(lo, Y_SHIFT);
+	hi = _mm256_srli_epi16(hi, Y_SHIFT);
+	return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), AVX2_ORDER_DWORDS);
+}
+
+/* Signed chroma words of 32 pixels, not yet offset by 128 */
+static INLINE void avx2_bgrx_to_uv16(const __m256i px[4], __m256i factors, __m256i* lo,
+                                     __m256i* hi)
+{
+	avx2_bgrx_madd(px, factors, lo, hi);
+	*lo = _mm256_srai_epi16(*lo, U_SHIFT);
+	*hi = _mm256_srai_epi16(*hi, U_SHIFT);
+}
+
+/* 32 chroma bytes in pixel order */
+static INLINE __m256i avx2_uv16_to_bytes(__m256i lo, __m256i hi)
+{
+	const __m256i packed = _mm256_packs_epi16(lo, hi);
+	return _mm256_sub_epi8(_mm256_permutevar8x32_epi32(packed, AVX2_ORDER_DWORDS),
+	                       CONST128_FACTORS);
+}
+
+/* The 2x2 average of the chroma words of an even and an odd row, 16 bytes in pixel order.
+ * floor(sum / 4) + 128 of the signed values equals the average of the biased bytes
+ * the SSSE3 AVC444 v1 code builds. */
+static INLINE __m128i avx2_uv16_avg(__m256i evenLo, __m256i evenHi, __m256i oddLo, __m256i oddHi)
+{
+	const __m256i even = _mm256_hadd_epi16(evenLo, evenHi);
+	const __m256i odd = _mm256_hadd_epi16(oddLo, oddHi);
+	__m256i sum = _mm256_srai_epi16(_mm256_add_epi16(even, odd), 2);
+	sum = _mm256_permutevar8x32_epi32(sum, AVX2_ORDER_DWORDS);
+	sum = _mm256_permute4x64_epi64(_mm256_packs_epi16(sum, sum), 0xD8);
+	return _mm256_castsi256_si128(_mm256_sub_epi8(sum, CONST128_FACTORS));
+}
+
+/* Low 128 bits: the 16 bytes at even positions, high 128 bits: the 16 odd ones */
+static INLINE __m256i avx2_split_even_odd(__m256i v)
+{
+	const __m256i mask = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15, 0,
+	                                      2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, mask), 0xD8);
+}
+
+/* Low 64 bits: the bytes at positions 4x, next 64 bits: the bytes at positions 4x+2 */
+static INLINE __m128i avx2_split_4x(__m256i v)
+{
+	const __m256i mask = _mm256_setr_epi8(0, 4, 8, 12, 2, 6, 10, 14, -128, -128, -128, -128, -128,
+	                                      -128, -128, -128, 0, 4, 8, 12, 2, 6, 10, 14, -128, -128,
+	                                      -128, -128, -128, -128, -128, -128);
+	const __m256i shuffled = _mm256_shuffle_epi8(v, mask);
+	return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(shuffled, AVX2_ORDER_DWORDS));
+}
+
+static INLINE void avx2_RGBToYUV420_BGRX_Y(const BYTE* src, BYTE* dst, UINT32 width)
+{
+	UINT32 x;
+
+	for (x = 0; x < width; x += 32)
+	{
+		__m256i px[4];
+		avx2_load_bgrx32(&src[4 * x], px);
+		_mm256_storeu_si256((__m256i*)&dst[x], avx2_bgrx_to_y(px));
+	}
+}
+
+/* Subsample 2x2 blocks with pavgb the same way the SSSE3 code does, 16 of them per call */
+static INLINE __m256i avx2_bgrx_subsample(const BYTE* src1, const BYTE* src2)
+{
+	const __m256i x0 = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)src1),
+	                                   _mm256_loadu_si256((const __m256i*)src2));
+	const __m256i x1 = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)src1 + 1),
+	                                   _mm256_loadu_si256((const __m256i*)src2 + 1));
+	const __m256 f0 = _mm256_castsi256_ps(x0);
+	const __m256 f1 = _mm256_castsi256_ps(x1);
+	const __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(f0, f1, 0x88));
+	const __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(f0, f1, 0xdd));
+	/* [0 1 4 5 | 2 3 6 7] -> [0 1 2 3 | 4 5 6 7] */
+	return _mm256_permute4x64_epi64(_mm256_avg_epu8(odd, even), 0xD8);
+}
+
+static INLINE void avx2_RGBToYUV420_BGRX_UV(const BYTE* src1, const BYTE* src2, BYTE* dst1,
+                                            BYTE* dst2, UINT32 width)
+{
+	UINT32 x;
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+
+	for (x = 0; x < width; x += 32)
+	{
+		const __m256i a = avx2_bgrx_subsample(&src1[4 * x], &src2[4 * x]);
+		const __m256i b = avx2_bgrx_subsample(&src1[4 * x + 64], &src2[4 * x + 64]);
+		__m256i u = _mm256_hadd_epi16(_mm256_maddubs_epi16(a, u_factors),
+		                              _mm256_maddubs_epi16(b, u_factors));
+		__m256i v = _mm256_hadd_epi16(_mm256_maddubs_epi16(a, v_factors),
+		                              _mm256_maddubs_epi16(b, v_factors));
+		__m256i uv;
+		u = _mm256_srai_epi16(u, U_SHIFT);
+		v = _mm256_srai_epi16(v, V_SHIFT);
+		/* the lower 16 bytes go to the u plane, the upper 16 bytes to the v plane */
+		uv = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(u, v), AVX2_ORDER_DWORDS);
+		uv = _mm256_sub_epi8(uv, CONST128_FACTORS);
+		_mm_storeu_si128((__m128i*)&dst1[x / 2], _mm256_castsi256_si128(uv));
+		_mm_storeu_si128((__m128i*)&dst2[x / 2], _mm256_extracti128_si256(uv, 1));
+	}
+}
+
+static pstatus_t avx2_RGBToYUV420_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                       BYTE* pDst[3], const UINT32 dstStep[3],
+                                       const prim_size_t* roi)
+{
+	UINT32 y;
+	const BYTE* argb = pSrc;
+	BYTE* ydst = pDst[0];
+	BYTE* udst = pDst[1];
+	BYTE* vdst = pDst[2];
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return sse->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+	for (y = 0; y < roi->height - 1; y += 2)
+	{
+		const BYTE* line1 = argb;
+		const BYTE* line2 = argb + srcStep;
+		avx2_RGBToYUV420_BGRX_UV(line1, line2, udst, vdst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line1, ydst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line2, ydst + dstStep[0], roi->width);
+		argb += 2ULL * srcStep;
+		ydst += 2ULL * dstStep[0];
+		udst += 1ULL * dstStep[1];
+		vdst += 1ULL * dstStep[2];
+	}
+
+	if (roi->height & 1)
+	{
+		/* pass the same last line of an odd height twice for UV */
+		avx2_RGBToYUV420_BGRX_UV(argb, argb, udst, vdst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(argb, ydst, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToYUV420(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                  BYTE* pDst[3], const UINT32 dstStep[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToYUV420_BGRX(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+		default:
+			return sse->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> AVC444-YUV conversion                                        */
+/****************************************************************************/
+
+/* Chroma of one double row for the AVC444 v1 layout, see
+ * ssse3_RGBToAVC444YUV_BGRX_DOUBLE_ROW for the distribution:
+ * 2x   2y    -> lumaDst (b2/b3)
+ * x    2y+1  -> chromaOdd (b4/b5)
+ * 2x+1 2y    -> chromaEven (b6/b7) */
+static INLINE void avx2_RGBToAVC444YUV_BGRX_CHROMA(const __m256i xe[4], const __m256i xo[4],
+                                                   BOOL haveOdd, __m256i factors, BYTE* lumaDst,
+                                                   BYTE* chromaOdd, BYTE* chromaEven)
+{
+	__m256i eLo, eHi, oLo, oHi, split;
+	avx2_bgrx_to_uv16(xe, factors, &eLo, &eHi);
+	split = avx2_split_even_odd(avx2_uv16_to_bytes(eLo, eHi));
+
+	if (haveOdd)
+	{
+		avx2_bgrx_to_uv16(xo, factors, &oLo, &oHi);
+		_mm_storeu_si128((__m128i*)lumaDst, avx2_uv16_avg(eLo, eHi, oLo, oHi));
+		_mm256_storeu_si256((__m256i*)chromaOdd, avx2_uv16_to_bytes(oLo, oHi));
+	}
+	else
+		_mm_storeu_si128((__m128i*)lumaDst, _mm256_castsi256_si128(split));
+
+	_mm_storeu_si128((__m128i*)chromaEven, _mm256_extracti128_si256(split, 1));
+}
+
+static INLINE void avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(const BYTE* srcEven, const BYTE* srcOdd,
+                                                       BYTE* b1Even, BYTE* b1Odd, BYTE* b2,
+                                                       BYTE* b3, BYTE* b4, BYTE* b5, BYTE* b6,
+                                                       BYTE* b7, UINT32 width)
+{
+	UINT32 x;
+
+	for (x = 0; x < width; x += 32)
+	{
+		__m256i xe[4], xo[4];
+		avx2_load_bgrx32(&srcEven[4 * x], xe);
+		avx2_load_bgrx32(&srcOdd[4 * x], xo);
+		/* store y [b1] */
+		_mm256_storeu_si256((__m256i*)&b1Even[x], avx2_bgrx_to_y(xe));
+
+		if (b1Odd)
+			_mm256_storeu_si256((__m256i*)&b1Odd[x], avx2_bgrx_to_y(xo));
+
+		avx2_RGBToAVC444YUV_BGRX_CHROMA(xe, xo, b1Odd != NULL, BGRX_U_FACTORS, &b2[x / 2], &b4[x],
+		                                &b6[x / 2]);
+		avx2_RGBToAVC444YUV_BGRX_CHROMA(xe, xo, b1Odd != NULL, BGRX_V_FACTORS, &b3[x / 2], &b5[x],
+		                                &b7[x / 2]);
+	}
+}
+
+static pstatus_t avx2_RGBToAVC444YUV_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                          BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                          const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	UINT32 y;
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return sse->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+		                           roi);
+
+	for (y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y >= (roi->height - 1));
+		const BYTE* srcEven = pSrc + 1ULL * y * srcStep;
+		const BYTE* srcOdd = !last ? srcEven + srcStep : srcEven;
+		const UINT32 i = y >> 1;
+		const UINT32 n = (i & ~7) + i;
+		BYTE* b1Even = pDst1[0] + 1ULL * y * dst1Step[0];
+		BYTE* b1Odd = !last ? (b1Even + dst1Step[0]) : NULL;
+		BYTE* b2 = pDst1[1] + 1ULL * (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + 1ULL * (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + 1ULL * dst2Step[0] * n;
+		BYTE* b5 = b4 + 8ULL * dst2Step[0];
+		BYTE* b6 = pDst2[1] + 1ULL * (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + 1ULL * (y / 2) * dst2Step[2];
+		avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6, b7,
+		                                    roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUV(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                     BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                     const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUV_BGRX(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                dst2Step, roi);
+
+		default:
+			return sse->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+			                           roi);
+	}
+}
+
+/* Chroma of one double row for the AVC444 v2 layout, see
+ * ssse3_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW for the distribution:
+ * 2x   2y    -> lumaDst
+ * 2x+1  y    -> evenChromaDst / oddChromaDst
+ * 4x   2y+1  -> chromaDst1
+ * 4x+2 2y+1  -> chromaDst2 */
+static INLINE void avx2_RGBToAVC444YUVv2_BGRX_CHROMA(const __m256i xe[4], const __m256i xo[4],
+                                                     BOOL haveOdd, __m256i factors, BYTE* lumaDst,
+                                                     BYTE* evenChromaDst, BYTE* oddChromaDst,
+                                                     BYTE* chromaDst1, BYTE* chromaDst2)
+{
+	__m256i eLo, eHi, oLo, oHi, split;
+	avx2_bgrx_to_uv16(xe, factors, &eLo, &eHi);
+	split = avx2_split_even_odd(avx2_uv16_to_bytes(eLo, eHi));
+
+	_mm_storeu_si128((__m128i*)evenChromaDst, _mm256_extracti128_si256(split, 1));
+
+	if (haveOdd)
+	{
+		__m256i o;
+		__m128i quad;
+		avx2_bgrx_to_uv16(xo, factors, &oLo, &oHi);
+		o = avx2_uv16_to_bytes(oLo, oHi);
+		_mm_storeu_si128((__m128i*)oddChromaDst, _mm256_extracti128_si256(avx2_split_even_odd(o), 1));
+		quad = avx2_split_4x(o);
+		_mm_storel_epi64((__m128i*)chromaDst1, quad);
+		_mm_storel_epi64((__m128i*)chromaDst2, _mm_srli_si128(quad, 8));
+		_mm_storeu_si128((__m128i*)lumaDst, avx2_uv16_avg(eLo, eHi, oLo, oHi));
+	}
+	else
+		_mm_storeu_si128((__m128i*)lumaDst, _mm256_castsi256_si128(split));
+}
+
+static INLINE void avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+    const BYTE* srcEven, const BYTE* srcOdd, BYTE* yLumaDstEven, BYTE* yLumaDstOdd, BYTE* uLumaDst,
+    BYTE* vLumaDst, BYTE* yEvenChromaDst1, BYTE* yEvenChromaDst2, BYTE* yOddChromaDst1,
+    BYTE* yOddChromaDst2, BYTE* uChromaDst1, BYTE* uChromaDst2, BYTE* vChromaDst1,
+    BYTE* vChromaDst2, UINT32 width)
+{
+	UINT32 x;
+
+	for (x = 0; x < width; x += 32)
+	{
+		__m256i xe[4], xo[4];
+		avx2_load_bgrx32(&srcEven[4 * x], xe);
+		avx2_load_bgrx32(&srcOdd[4 * x], xo);
+		_mm256_storeu_si256((__m256i*)&yLumaDstEven[x], avx2_bgrx_to_y(xe));
+
+		if (yLumaDstOdd)
+			_mm256_storeu_si256((__m256i*)&yLumaDstOdd[x], avx2_bgrx_to_y(xo));
+
+		avx2_RGBToAVC444YUVv2_BGRX_CHROMA(xe, xo, yLumaDstOdd != NULL, BGRX_U_FACTORS,
+		                                  &uLumaDst[x / 2], &yEvenChromaDst1[x / 2],
+		                                  &yOddChromaDst1[x / 2], &uChromaDst1[x / 4],
+		                                  &vChromaDst1[x / 4]);
+		avx2_RGBToAVC444YUVv2_BGRX_CHROMA(xe, xo, yLumaDstOdd != NULL, BGRX_V_FACTORS,
+		                                  &vLumaDst[x / 2], &yEvenChromaDst2[x / 2],
+		                                  &yOddChromaDst2[x / 2], &uChromaDst2[x / 4],
+		                                  &vChromaDst2[x / 4]);
+	}
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                            BYTE* pDst1[3], const UINT32 dst1Step[3],
+                                            BYTE* pDst2[3], const UINT32 dst2Step[3],
+                                            const prim_size_t* roi)
+{
+	UINT32 y;
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return sse->RGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+		                             roi);
+
+	for (y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y >= (roi->height - 1));
+		const BYTE* srcEven = (pSrc + 1ULL * y * srcStep);
+		const BYTE* srcOdd = !last ? (srcEven + srcStep) : srcEven;
+		BYTE* dstLumaYEven = (pDst1[0] + 1ULL * y * dst1Step[0]);
+		BYTE* dstLumaYOdd = !last ? (dstLumaYEven + dst1Step[0]) : NULL;
+		BYTE* dstLumaU = (pDst1[1] + 1ULL * (y / 2) * dst1Step[1]);
+		BYTE* dstLumaV = (pDst1[2] + 1ULL * (y / 2) * dst1Step[2]);
+		BYTE* dstEvenChromaY1 = (pDst2[0] + 1ULL * y * dst2Step[0]);
+		BYTE* dstEvenChromaY2 = dstEvenChromaY1 + roi->width / 2;
+		BYTE* dstOddChromaY1 = dstEvenChromaY1 + dst2Step[0];
+		BYTE* dstOddChromaY2 = dstEvenChromaY2 + dst2Step[0];
+		BYTE* dstChromaU1 = (pDst2[1] + 1ULL * (y / 2) * dst2Step[1]);
+		BYTE* dstChromaV1 = (pDst2[2] + 1ULL * (y / 2) * dst2Step[2]);
+		BYTE* dstChromaU2 = dstChromaU1 + roi->width / 4;
+		BYTE* dstChromaV2 = dstChromaV1 + roi->width / 4;
+		avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(srcEven, srcOdd, dstLumaYEven, dstLumaYOdd, dstLumaU,
+		                                      dstLumaV, dstEvenChromaY1, dstEvenChromaY2,
+		                                      dstOddChromaY1, dstOddChromaY2, dstChromaU1,
+		                                      dstChromaU2, dstChromaV1, dstChromaV2, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                       BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                       const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUVv2_BGRX(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                  dst2Step, roi);
+
+		default:
+			return sse->RGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                             dst2Step, roi);
+	}
+}
+
+void primitives_init_YUV_avx2(primitives_t* prims)
+{
+	sse = primitives_get_sse();
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->RGBToYUV420_8u_P3AC4R = avx2_RGBToYUV420;
+		prims->RGBToAVC444YUV = avx2_RGBToAVC444YUV;
+		prims->RGBToAVC444YUVv2 = avx2_RGBToAVC444YUVv2;
+		prims->YUV420ToRGB_8u_P3AC4R = avx2_YUV420ToRGB;
+		prims->YUV444ToRGB_8u_P3AC4R = avx2_YUV444ToRGB_8u_P3AC4R;
+	}
+}
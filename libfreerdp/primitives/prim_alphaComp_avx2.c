@@ -0,0 +1,120 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 alpha blending routines.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * Same arithmetic as sse2_alphaComp_argb, 8 pixels per iteration.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+static primitives_t* sse = NULL;
+
+/* ------------------------------------------------------------------------- */
+static INLINE __m256i avx2_alphaComp_half(__m256i src1, __m256i src2)
+{
+	const __m256i one = _mm256_set1_epi16(1);
+	/* Broadcast the source alpha to all four channels of a pixel */
+	__m256i alpha = _mm256_shufflelo_epi16(src1, 0xff);
+	alpha = _mm256_shufflehi_epi16(alpha, 0xff);
+	alpha = _mm256_adds_epi16(alpha, one);
+	/* dst = ((alpha + 1) * (src1 - src2) >> 8) + src2 */
+	__m256i val = _mm256_mullo_epi16(alpha, _mm256_subs_epi16(src1, src2));
+	val = _mm256_srai_epi16(val, 8);
+	val = _mm256_adds_epi16(val, src2);
+	/* Must mask off remainders or pack gets confused */
+	return _mm256_and_si256(val, _mm256_set1_epi16(0x00ff));
+}
+
+static pstatus_t avx2_alphaComp_argb(const BYTE* pSrc1, UINT32 src1Step, const BYTE* pSrc2,
+                                     UINT32 src2Step, BYTE* pDst, UINT32 dstStep, UINT32 width,
+                                     UINT32 height)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	UINT32 y;
+
+	if ((width == 0) || (height == 0))
+		return PRIMITIVES_SUCCESS;
+
+	if (width < 8) /* pointless if too small */
+	{
+		return sse->alphaComp_argb(pSrc1, src1Step, pSrc2, src2Step, pDst, dstStep, width,
+		                           height);
+	}
+
+	for (y = 0; y < height; y++)
+	{
+		const UINT32* sptr1 = (const UINT32*)&pSrc1[1ULL * y * src1Step];
+		const UINT32* sptr2 = (const UINT32*)&pSrc2[1ULL * y * src2Step];
+		UINT32* dptr = (UINT32*)&pDst[1ULL * y * dstStep];
+		/* The SSE tier blends the pixels up to the first 16 byte aligned one (or the whole
+		 * row if there is none) with the generic code, which rounds differently. Leave them
+		 * to it so both tiers produce identical output. */
+		UINT32 x = ((ULONG_PTR)dptr & 0x03) ? width : ((16 - ((ULONG_PTR)dptr & 0x0f)) & 0x0f) / 4;
+
+		if (x > width)
+			x = width;
+
+		if (x > 0)
+		{
+			const pstatus_t status = sse->alphaComp_argb((const BYTE*)sptr1, src1Step,
+			                                             (const BYTE*)sptr2, src2Step,
+			                                             (BYTE*)dptr, dstStep, x, 1);
+
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m256i src1 = _mm256_loadu_si256((const __m256i*)&sptr1[x]);
+			const __m256i src2 = _mm256_loadu_si256((const __m256i*)&sptr2[x]);
+			/* unpack/pack stay within 128 bit lanes, so the pixel order is preserved */
+			const __m256i lo = avx2_alphaComp_half(_mm256_unpacklo_epi8(src1, zero),
+			                                       _mm256_unpacklo_epi8(src2, zero));
+			const __m256i hi = avx2_alphaComp_half(_mm256_unpackhi_epi8(src1, zero),
+			                                       _mm256_unpackhi_epi8(src2, zero));
+			_mm256_storeu_si256((__m256i*)&dptr[x], _mm256_packus_epi16(lo, hi));
+		}
+
+		/* Finish off the remainder. */
+		if (x < width)
+		{
+			const pstatus_t status =
+			    sse->alphaComp_argb((const BYTE*)&sptr1[x], src1Step, (const BYTE*)&sptr2[x],
+			                        src2Step, (BYTE*)&dptr[x], dstStep, width - x, 1);
+
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_alphaComp_avx2(primitives_t* prims)
+{
+	sse = primitives_get_sse();
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->alphaComp_argb = avx2_alphaComp_argb;
+	}
+}
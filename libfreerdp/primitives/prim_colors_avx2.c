@@ -0,0 +1,141 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 Color conversion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+static primitives_t* sse = NULL;
+
+/*---------------------------------------------------------------------------*/
+/* Uses the same 14 bit fixed point factors as the SSE2 version, see
+ * sse2_yCbCrToRGB_16s8u_P3AC4R_BGRX for the derivation.
+ * If swap is set the red and blue channels are exchanged (RGBX output).
+ */
+static INLINE pstatus_t avx2_yCbCrToRGB_16s8u_P3AC4R_X(const INT16* const pSrc[3], UINT32 srcStep,
+                                                       BYTE* pDst, UINT32 dstStep,
+                                                       const prim_size_t* roi, BOOL swap)
+{
+	const __m256i r_cr = _mm256_set1_epi16(22986);  /*  1.403 << 14 */
+	const __m256i g_cb = _mm256_set1_epi16(-5636);  /* -0.344 << 14 */
+	const __m256i g_cr = _mm256_set1_epi16(-11698); /* -0.714 << 14 */
+	const __m256i b_cb = _mm256_set1_epi16(28999);  /*  1.770 << 14 */
+	const __m256i c4096 = _mm256_set1_epi16(4096);
+	const __m256i alpha = _mm256_set1_epi16(0xFF);
+	const UINT32 pad = roi->width % 16;
+	const UINT32 width = roi->width - pad;
+	UINT32 yp;
+
+	for (yp = 0; yp < roi->height; yp++)
+	{
+		const INT16* y_buf = (const INT16*)((const BYTE*)pSrc[0] + 1ULL * yp * srcStep);
+		const INT16* cb_buf = (const INT16*)((const BYTE*)pSrc[1] + 1ULL * yp * srcStep);
+		const INT16* cr_buf = (const INT16*)((const BYTE*)pSrc[2] + 1ULL * yp * srcStep);
+		BYTE* d_buf = &pDst[1ULL * yp * dstStep];
+		UINT32 i;
+
+		for (i = 0; i < width; i += 16)
+		{
+			__m256i y = _mm256_loadu_si256((const __m256i*)&y_buf[i]);
+			const __m256i cb = _mm256_loadu_si256((const __m256i*)&cb_buf[i]);
+			const __m256i cr = _mm256_loadu_si256((const __m256i*)&cr_buf[i]);
+			__m256i r, g, b, first, second, bg, ra, lo, hi;
+			/* y = (y + 4096) >> 2 */
+			y = _mm256_srai_epi16(_mm256_add_epi16(y, c4096), 2);
+			/* (y + HIWORD(cr*22986)) >> 3 */
+			r = _mm256_srai_epi16(_mm256_add_epi16(y, _mm256_mulhi_epi16(cr, r_cr)), 3);
+			/* (y + HIWORD(cb*-5636) + HIWORD(cr*-11698)) >> 3 */
+			g = _mm256_add_epi16(y, _mm256_mulhi_epi16(cb, g_cb));
+			g = _mm256_srai_epi16(_mm256_add_epi16(g, _mm256_mulhi_epi16(cr, g_cr)), 3);
+			/* (y + HIWORD(cb*28999)) >> 3 */
+			b = _mm256_srai_epi16(_mm256_add_epi16(y, _mm256_mulhi_epi16(cb, b_cb)), 3);
+			/* The saturating pack doubles as the CLIP to [0, 255].
+			 * Per 128 bit lane: first = C0..C7 R0..R7, second = G0..G7 FF..FF */
+			first = swap ? _mm256_packus_epi16(r, b) : _mm256_packus_epi16(b, r);
+			second = _mm256_packus_epi16(g, alpha);
+			bg = _mm256_unpacklo_epi8(first, second);  /* C0 G0 C1 G1 ... */
+			ra = _mm256_unpackhi_epi8(first, second);  /* C0 FF C1 FF ... */
+			lo = _mm256_unpacklo_epi16(bg, ra);        /* pixels 0-3 | 8-11 */
+			hi = _mm256_unpackhi_epi16(bg, ra);        /* pixels 4-7 | 12-15 */
+			_mm256_storeu_si256((__m256i*)&d_buf[4 * i], _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i*)&d_buf[4 * i + 32],
+			                    _mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+
+		for (; i < roi->width; i++)
+		{
+			const INT32 divisor = 16;
+			const INT32 Y = (y_buf[i] + 4096) << divisor;
+			const INT32 Cb = cb_buf[i];
+			const INT32 Cr = cr_buf[i];
+			const INT32 CrR = Cr * (INT32)(1.402525f * (1 << divisor));
+			const INT32 CrG = Cr * (INT32)(0.714401f * (1 << divisor));
+			const INT32 CbG = Cb * (INT32)(0.343730f * (1 << divisor));
+			const INT32 CbB = Cb * (INT32)(1.769905f * (1 << divisor));
+			const INT16 R = ((INT16)((CrR + Y) >> divisor) >> 5);
+			const INT16 G = ((INT16)((Y - CbG - CrG) >> divisor) >> 5);
+			const INT16 B = ((INT16)((CbB + Y) >> divisor) >> 5);
+			BYTE* dst = &d_buf[4 * i];
+			dst[0] = swap ? CLIP(R) : CLIP(B);
+			dst[1] = CLIP(G);
+			dst[2] = swap ? CLIP(B) : CLIP(R);
+			dst[3] = 0xFF;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_yCbCrToRGB_16s8u_P3AC4R(const INT16* const pSrc[3], UINT32 srcStep,
+                                              BYTE* pDst, UINT32 dstStep, UINT32 DstFormat,
+                                              const prim_size_t* roi) /* region of interest */
+{
+	/* The SSE tier falls back to the generic code for these, which rounds differently. Do
+	 * the same so both tiers produce identical output. */
+	if (((ULONG_PTR)(pSrc[0]) & 0x0f) || ((ULONG_PTR)(pSrc[1]) & 0x0f) ||
+	    ((ULONG_PTR)(pSrc[2]) & 0x0f) || ((ULONG_PTR)(pDst)&0x0f) || (srcStep & 0x0f) ||
+	    (dstStep & 0x0f))
+		return sse->yCbCrToRGB_16s8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			return avx2_yCbCrToRGB_16s8u_P3AC4R_X(pSrc, srcStep, pDst, dstStep, roi, FALSE);
+
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			return avx2_yCbCrToRGB_16s8u_P3AC4R_X(pSrc, srcStep, pDst, dstStep, roi, TRUE);
+
+		default:
+			return sse->yCbCrToRGB_16s8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_colors_avx2(primitives_t* prims)
+{
+	sse = primitives_get_sse();
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->yCbCrToRGB_16s8u_P3AC4R = avx2_yCbCrToRGB_16s8u_P3AC4R;
+	}
+}
@@ -0,0 +1,133 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 copy routines
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+static primitives_t* sse = NULL;
+
+/* Below this size memcpy wins over the alignment prologue. */
+#define AVX2_COPY_THRESHOLD 256
+
+static INLINE BOOL avx2_regions_overlap(const BYTE* p1, const BYTE* p2, size_t len)
+{
+	const ULONG_PTR a = (ULONG_PTR)p1;
+	const ULONG_PTR b = (ULONG_PTR)p2;
+	return (a < b + len) && (b < a + len);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Copy non overlapping memory, 32-byte aligned stores and unaligned loads. */
+static INLINE void avx2_copy_row(const BYTE* src, BYTE* dst, size_t len)
+{
+	size_t count;
+
+	while (((ULONG_PTR)dst & 0x1f) && len)
+	{
+		*dst++ = *src++;
+		len--;
+	}
+
+	count = len >> 7;
+
+	while (count--)
+	{
+		const __m256i a = _mm256_loadu_si256((const __m256i*)src);
+		const __m256i b = _mm256_loadu_si256((const __m256i*)(src + 32));
+		const __m256i c = _mm256_loadu_si256((const __m256i*)(src + 64));
+		const __m256i d = _mm256_loadu_si256((const __m256i*)(src + 96));
+		_mm256_store_si256((__m256i*)dst, a);
+		_mm256_store_si256((__m256i*)(dst + 32), b);
+		_mm256_store_si256((__m256i*)(dst + 64), c);
+		_mm256_store_si256((__m256i*)(dst + 96), d);
+		src += 128;
+		dst += 128;
+	}
+
+	count = (len & 0x7f) >> 5;
+
+	while (count--)
+	{
+		_mm256_store_si256((__m256i*)dst, _mm256_loadu_si256((const __m256i*)src));
+		src += 32;
+		dst += 32;
+	}
+
+	len &= 0x1f;
+
+	if (len)
+		memcpy(dst, src, len);
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_copy_8u(const BYTE* pSrc, BYTE* pDst, INT32 len)
+{
+	if ((len < AVX2_COPY_THRESHOLD) || avx2_regions_overlap(pSrc, pDst, (size_t)len))
+		return sse->copy_8u(pSrc, pDst, len);
+
+	avx2_copy_row(pSrc, pDst, (size_t)len);
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_copy_8u_AC4r(const BYTE* pSrc, INT32 srcStep, BYTE* pDst, INT32 dstStep,
+                                   INT32 width, INT32 height)
+{
+	const size_t rowbytes = (size_t)width * sizeof(UINT32);
+	size_t extent;
+	INT32 y;
+
+	if ((width <= 0) || (height <= 0))
+		return PRIMITIVES_SUCCESS;
+
+	if ((rowbytes < AVX2_COPY_THRESHOLD) || (srcStep < 0) || (dstStep < 0))
+		return sse->copy_8u_AC4r(pSrc, srcStep, pDst, dstStep, width, height);
+
+	/* Leave anything where the bounding ranges intersect to the checked fallback. */
+	extent = (size_t)((srcStep > dstStep) ? srcStep : dstStep) * (size_t)(height - 1) + rowbytes;
+
+	if (avx2_regions_overlap(pSrc, pDst, extent))
+		return sse->copy_8u_AC4r(pSrc, srcStep, pDst, dstStep, width, height);
+
+	for (y = 0; y < height; y++)
+	{
+		avx2_copy_row(pSrc, pDst, rowbytes);
+		pSrc += srcStep;
+		pDst += dstStep;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_copy_avx2(primitives_t* prims)
+{
+	sse = primitives_get_sse();
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->copy_8u = avx2_copy_8u;
+		prims->copy_8u_AC4r = avx2_copy_8u_AC4r;
+		/* This is just an alias with void* parameters */
+		prims->copy = (__copy_t)(prims->copy_8u);
+	}
+}
@@ -275,6 +275,17 @@ FREERDP_LOCAL void primitives_init_YCoCg_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_YUV_opt(primitives_t* prims);
 #endif
 
+#if defined(WITH_SSE2)
+/* The AVX2 routines fall back to the SSE tier for unsupported layouts and sizes. */
+FREERDP_LOCAL void primitives_init_copy_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_set_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_alphaComp_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_colors_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_YUV_avx2(primitives_t* prims);
+
+FREERDP_LOCAL primitives_t* primitives_get_sse(void);
+#endif
+
 #if defined(WITH_OPENCL)
 FREERDP_LOCAL BOOL primitives_init_opencl(primitives_t* prims);
 #endif
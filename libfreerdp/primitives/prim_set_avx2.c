@@ -0,0 +1,128 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 routines to set a chunk of memory to a constant.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+static primitives_t* sse = NULL;
+
+/* ------------------------------------------------------------------------- */
+/* Fill len bytes starting at a 32-byte aligned dptr with the value in ymm. */
+static INLINE BYTE* avx2_fill_aligned(BYTE* dptr, __m256i ymm, size_t len)
+{
+	size_t count = len >> 7;
+
+	/* Do 128-byte chunks using one YMM register. */
+	while (count--)
+	{
+		_mm256_store_si256((__m256i*)dptr, ymm);
+		_mm256_store_si256((__m256i*)(dptr + 32), ymm);
+		_mm256_store_si256((__m256i*)(dptr + 64), ymm);
+		_mm256_store_si256((__m256i*)(dptr + 96), ymm);
+		dptr += 128;
+	}
+
+	count = (len & 0x7f) >> 5;
+
+	while (count--)
+	{
+		_mm256_store_si256((__m256i*)dptr, ymm);
+		dptr += 32;
+	}
+
+	return dptr;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_set_8u(BYTE val, BYTE* pDst, UINT32 len)
+{
+	BYTE* dptr = pDst;
+
+	if (len < 64)
+		return sse->set_8u(val, pDst, len);
+
+	/* Seek 32-byte alignment. */
+	while ((ULONG_PTR)dptr & 0x1f)
+	{
+		*dptr++ = val;
+		len--;
+	}
+
+	dptr = avx2_fill_aligned(dptr, _mm256_set1_epi8((char)val), len);
+
+	/* Do leftover bytes. */
+	len &= 0x1f;
+
+	while (len--)
+		*dptr++ = val;
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_set_32u(UINT32 val, UINT32* pDst, UINT32 len)
+{
+	UINT32* dptr = pDst;
+
+	/* Unaligned words can not be brought to a 32-byte boundary */
+	if ((len < 32) || ((ULONG_PTR)pDst & 0x03))
+		return sse->set_32u(val, pDst, len);
+
+	/* Seek 32-byte alignment. */
+	while ((ULONG_PTR)dptr & 0x1f)
+	{
+		*dptr++ = val;
+		len--;
+	}
+
+	dptr = (UINT32*)avx2_fill_aligned((BYTE*)dptr, _mm256_set1_epi32((int)val),
+	                                  (size_t)len * sizeof(UINT32));
+
+	/* Do leftover words. */
+	len &= 0x07;
+
+	while (len--)
+		*dptr++ = val;
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_set_32s(INT32 val, INT32* pDst, UINT32 len)
+{
+	UINT32 uval = *((UINT32*)&val);
+	return avx2_set_32u(uval, (UINT32*)pDst, len);
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_set_avx2(primitives_t* prims)
+{
+	sse = primitives_get_sse();
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->set_8u = avx2_set_8u;
+		prims->set_32s = avx2_set_32s;
+		prims->set_32u = avx2_set_32u;
+	}
+}
@@ -53,6 +53,12 @@ static INIT_ONCE generic_primitives_InitOnce = INIT_ONCE_STATIC_INIT;
 static primitives_t pPrimitivesCpu = { 0 };
 static INIT_ONCE cpu_primitives_InitOnce = INIT_ONCE_STATIC_INIT;
 
+#endif
+#if defined(WITH_SSE2)
+/* CPU optimized primitives without the AVX2 tier, used as fallback by it */
+static primitives_t pPrimitivesSse = { 0 };
+static INIT_ONCE sse_primitives_InitOnce = INIT_ONCE_STATIC_INIT;
+
 #endif
 #if defined(WITH_OPENCL)
 static primitives_t pPrimitivesGpu = { 0 };
@@ -109,6 +115,25 @@ static BOOL primitives_init_optimized(primitives_t* prims)
 	return TRUE;
 }
 
+#if defined(WITH_SSE2)
+static BOOL primitives_init_avx2(primitives_t* prims)
+{
+	if (!primitives_init_optimized(prims))
+		return FALSE;
+
+	if (!IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return TRUE;
+
+	primitives_init_alphaComp_avx2(prims);
+	primitives_init_copy_avx2(prims);
+	primitives_init_set_avx2(prims);
+	primitives_init_colors_avx2(prims);
+	primitives_init_YUV_avx2(prims);
+	prims->flags |= PRIM_FLAGS_HAVE_EXTAVX2;
+	return TRUE;
+}
+#endif
+
 typedef struct
 {
 	BYTE* channels[3];
@@ -289,13 +314,29 @@ static BOOL CALLBACK primitives_init_cpu_cb(PINIT_ONCE once, PVOID param, PVOID*
 	WINPR_UNUSED(param);
 	WINPR_UNUSED(context);
 
+#if defined(WITH_SSE2)
+	if (!primitives_init_avx2(&pPrimitivesCpu))
+		return FALSE;
+#else
 	if (!primitives_init_optimized(&pPrimitivesCpu))
 		return FALSE;
+#endif
 
 	return TRUE;
 }
 #endif
 
+#if defined(WITH_SSE2)
+static BOOL CALLBACK primitives_init_sse_cb(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	return primitives_init_optimized(&pPrimitivesSse);
+}
+#endif
+
 static BOOL CALLBACK primitives_auto_init_cb(PINIT_ONCE once, PVOID param, PVOID* context)
 {
 	WINPR_UNUSED(once);
@@ -339,6 +380,10 @@ void primitives_uninit(void)
 #if defined(HAVE_CPU_OPTIMIZED_PRIMITIVES)
 	if (pPrimitivesCpu.uninit)
 		pPrimitivesCpu.uninit();
+#endif
+#if defined(WITH_SSE2)
+	if (pPrimitivesSse.uninit)
+		pPrimitivesSse.uninit();
 #endif
 	if (pPrimitivesGeneric.uninit)
 		pPrimitivesGeneric.uninit();
@@ -369,6 +414,14 @@ primitives_t* primitives_get_generic(void)
 	return &pPrimitivesGeneric;
 }
 
+#if defined(WITH_SSE2)
+primitives_t* primitives_get_sse(void)
+{
+	InitOnceExecuteOnce(&sse_primitives_InitOnce, primitives_init_sse_cb, NULL, NULL);
+	return &pPrimitivesSse;
+}
+#endif
+
 primitives_t* primitives_get_by_type(DWORD type)
 {
 	InitOnceExecuteOnce(&generic_primitives_InitOnce, primitives_init_generic_cb, NULL, NULL);
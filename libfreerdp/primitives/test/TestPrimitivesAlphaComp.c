@@ -159,6 +159,60 @@ static BOOL test_alphaComp_func(void)
 	return TRUE;
 }
 
+/* ------------------------------------------------------------------------- */
+/* The AVX2 tier must produce output identical to the SSE tier it replaces. */
+static BOOL test_alphaComp_avx2_func(void)
+{
+	/* Widths below, at and above the 8 pixel vector width, odd ones for the tail */
+	const UINT32 widths[] = { 1, 7, 8, 9, 15, 16, 31, 33, 67, 128 };
+	const UINT32 step = 4 * (128 + 3);
+	const UINT32 height = 5;
+	const size_t size = 1ULL * step * height;
+	BOOL rc = FALSE;
+	size_t x;
+	BYTE* src1 = malloc(size);
+	BYTE* src2 = malloc(size);
+	BYTE* dst1 = calloc(1, size);
+	BYTE* dst2 = calloc(1, size);
+
+	if (!avx2 || !sse)
+	{
+		printf("AVX2 not available, skipping tier comparison\n");
+		rc = TRUE;
+		goto fail;
+	}
+
+	if (!src1 || !src2 || !dst1 || !dst2)
+		goto fail;
+
+	winpr_RAND(src1, size);
+	winpr_RAND(src2, size);
+
+	for (x = 0; x < sizeof(widths) / sizeof(widths[0]); x++)
+	{
+		if ((sse->alphaComp_argb(src1 + 4, step, src2 + 8, step, dst1 + 12, step, widths[x],
+		                         height - 1) != PRIMITIVES_SUCCESS) ||
+		    (avx2->alphaComp_argb(src1 + 4, step, src2 + 8, step, dst2 + 12, step, widths[x],
+		                          height - 1) != PRIMITIVES_SUCCESS))
+			goto fail;
+
+		if (memcmp(dst1, dst2, size) != 0)
+		{
+			printf("alphaComp_argb differs between the SSE and AVX2 tiers: width=%" PRIu32 "\n",
+			       widths[x]);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src1);
+	free(src2);
+	free(dst1);
+	free(dst2);
+	return rc;
+}
+
 static int test_alphaComp_speed(void)
 {
 	BYTE ALIGN(src1[SRC1_WIDTH * SRC1_HEIGHT]) = { 0 };
@@ -199,6 +253,9 @@ int TestPrimitivesAlphaComp(int argc, char* argv[])
 	if (!test_alphaComp_func())
 		return -1;
 
+	if (!test_alphaComp_avx2_func())
+		return -1;
+
 	if (g_TestPrimitivesPerformance)
 	{
 		if (!test_alphaComp_speed())
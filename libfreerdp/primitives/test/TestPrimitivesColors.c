@@ -116,6 +116,72 @@ fail:
 	return !failed;
 }
 
+/* ------------------------------------------------------------------------- */
+/* The AVX2 tier must produce output identical to the SSE tier it replaces. */
+static BOOL test_yCbCrToRGB_16s8u_P3AC4R_avx2_func(prim_size_t roi, DWORD DstFormat)
+{
+	BOOL rc = FALSE;
+	UINT32 x;
+	const INT16* ptrs[3];
+	INT16* yCbCr[3] = { 0 };
+	const UINT32 srcStride = roi.width * 2;
+	const UINT32 dstStride = roi.width * 4;
+	const size_t srcSize = 1ULL * srcStride * roi.height;
+	const size_t dstSize = 1ULL * dstStride * roi.height;
+	BYTE* out1 = _aligned_recalloc(NULL, 1, dstSize, 16);
+	BYTE* out2 = _aligned_recalloc(NULL, 1, dstSize, 16);
+
+	if (!avx2 || !sse)
+	{
+		printf("AVX2 not available, skipping tier comparison\n");
+		rc = TRUE;
+		goto fail;
+	}
+
+	if (!out1 || !out2)
+		goto fail;
+
+	for (x = 0; x < 3; x++)
+	{
+		size_t i;
+		yCbCr[x] = _aligned_recalloc(NULL, 1, srcSize, 16);
+
+		if (!yCbCr[x])
+			goto fail;
+
+		/* Decoded RemoteFX coefficients are 11.5 fixed point in [-4096, 4095] */
+		winpr_RAND((BYTE*)yCbCr[x], srcSize);
+
+		for (i = 0; i < srcSize / 2; i++)
+			yCbCr[x][i] = (INT16)(yCbCr[x][i] % 4096);
+
+		ptrs[x] = yCbCr[x];
+	}
+
+	if ((sse->yCbCrToRGB_16s8u_P3AC4R(ptrs, srcStride, out1, dstStride, DstFormat, &roi) !=
+	     PRIMITIVES_SUCCESS) ||
+	    (avx2->yCbCrToRGB_16s8u_P3AC4R(ptrs, srcStride, out2, dstStride, DstFormat, &roi) !=
+	     PRIMITIVES_SUCCESS))
+		goto fail;
+
+	if (memcmp(out1, out2, dstSize) != 0)
+	{
+		printf("yCbCrToRGB_16s8u_P3AC4R differs between the SSE and AVX2 tiers: %" PRIu32
+		       "x%" PRIu32 " [%s]\n",
+		       roi.width, roi.height, FreeRDPGetColorFormatName(DstFormat));
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	for (x = 0; x < 3; x++)
+		_aligned_free(yCbCr[x]);
+
+	_aligned_free(out1);
+	_aligned_free(out2);
+	return rc;
+}
+
 /* ------------------------------------------------------------------------- */
 static BOOL test_RGBToRGB_16s8u_P3AC4R_speed(void)
 {
@@ -266,6 +332,8 @@ int TestPrimitivesColors(int argc, char* argv[])
 		                      PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32 };
 	DWORD x;
 	prim_size_t roi = { 1920 / 4, 1080 / 4 };
+	const prim_size_t roi64x64 = { 64, 64 };
+	const prim_size_t roiOdd = { 37, 5 };
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 	prim_test_setup(FALSE);
@@ -275,6 +343,11 @@ int TestPrimitivesColors(int argc, char* argv[])
 		if (!test_RGBToRGB_16s8u_P3AC4R_func(roi, formats[x]))
 			return 1;
 
+		/* 64x64 is the RemoteFX tile, the odd sizes take the tail paths */
+		if (!test_yCbCrToRGB_16s8u_P3AC4R_avx2_func(roi64x64, formats[x]) ||
+		    !test_yCbCrToRGB_16s8u_P3AC4R_avx2_func(roiOdd, formats[x]))
+			return 1;
+
 #if 0
 
 		if (g_TestPrimitivesPerformance)
@@ -60,6 +60,78 @@ static BOOL test_copy8u_func(void)
 	return TRUE;
 }
 
+/* ------------------------------------------------------------------------- */
+/* The AVX2 tier must produce output identical to the SSE tier it replaces. */
+static BOOL test_copy_avx2_func(void)
+{
+	/* Row lengths around the AVX2 threshold and its 128 byte loop, odd widths for the tail */
+	const INT32 widths[] = { 1, 63, 64, 65, 97, 129, 200, 257 };
+	const INT32 stride = 260 * 4 + 32;
+	const INT32 height = 7;
+	const size_t size = (size_t)stride * height + 32;
+	BOOL rc = FALSE;
+	size_t x;
+	INT32 length;
+	BYTE* data = malloc(size);
+	BYTE* dest1 = calloc(1, size);
+	BYTE* dest2 = calloc(1, size);
+
+	if (!avx2 || !sse)
+	{
+		printf("AVX2 not available, skipping tier comparison\n");
+		rc = TRUE;
+		goto fail;
+	}
+
+	if (!data || !dest1 || !dest2)
+		goto fail;
+
+	winpr_RAND(data, size);
+
+	for (x = 0; x < 32; x += 3)
+	{
+		for (length = 1; length < 1024; length += 7)
+		{
+			if ((sse->copy_8u(data + x, dest1 + 31 - x, length) != PRIMITIVES_SUCCESS) ||
+			    (avx2->copy_8u(data + x, dest2 + 31 - x, length) != PRIMITIVES_SUCCESS))
+				goto fail;
+
+			if (memcmp(dest1, dest2, size) != 0)
+			{
+				printf("copy_8u differs between the SSE and AVX2 tiers: off=%" PRIuz
+				       " len=%" PRId32 "\n",
+				       x, length);
+				goto fail;
+			}
+		}
+	}
+
+	for (x = 0; x < sizeof(widths) / sizeof(widths[0]); x++)
+	{
+		const INT32 width = widths[x];
+
+		if ((sse->copy_8u_AC4r(data + 4, stride, dest1 + 12, stride, width, height) !=
+		     PRIMITIVES_SUCCESS) ||
+		    (avx2->copy_8u_AC4r(data + 4, stride, dest2 + 12, stride, width, height) !=
+		     PRIMITIVES_SUCCESS))
+			goto fail;
+
+		if (memcmp(dest1, dest2, size) != 0)
+		{
+			printf("copy_8u_AC4r differs between the SSE and AVX2 tiers: width=%" PRId32 "\n",
+			       width);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(data);
+	free(dest1);
+	free(dest2);
+	return rc;
+}
+
 /* ------------------------------------------------------------------------- */
 static BOOL test_copy8u_speed(void)
 {
@@ -86,6 +158,9 @@ int TestPrimitivesCopy(int argc, char* argv[])
 	if (!test_copy8u_func())
 		return 1;
 
+	if (!test_copy_avx2_func())
+		return 1;
+
 	if (g_TestPrimitivesPerformance)
 	{
 		if (!test_copy8u_speed())
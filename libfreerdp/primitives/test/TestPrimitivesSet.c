@@ -262,6 +262,65 @@ static BOOL test_set32s_speed(void)
 	return TRUE;
 }
 
+/* ------------------------------------------------------------------------- */
+/* The AVX2 tier must produce output identical to the SSE tier it replaces. */
+static BOOL test_set_avx2_func(void)
+{
+	UINT32 off;
+	UINT32 ALIGN(dest1[1024]);
+	UINT32 ALIGN(dest2[1024]);
+
+	if (!avx2 || !sse)
+	{
+		printf("AVX2 not available, skipping tier comparison\n");
+		return TRUE;
+	}
+
+	/* Lengths beyond a few 32 byte blocks with every start alignment cover the prologue,
+	 * the vector loop and the tail */
+	for (off = 0; off < 32; ++off)
+	{
+		UINT32 len;
+
+		for (len = 1; len < 512 - off; ++len)
+		{
+			memset(dest1, 3, sizeof(dest1));
+			memset(dest2, 3, sizeof(dest2));
+
+			if ((sse->set_8u(0xa5, (BYTE*)dest1 + off, len) != PRIMITIVES_SUCCESS) ||
+			    (avx2->set_8u(0xa5, (BYTE*)dest2 + off, len) != PRIMITIVES_SUCCESS))
+				return FALSE;
+
+			if (memcmp(dest1, dest2, sizeof(dest1)) != 0)
+			{
+				printf("set_8u differs between the SSE and AVX2 tiers: off=%" PRIu32
+				       " len=%" PRIu32 "\n",
+				       off, len);
+				return FALSE;
+			}
+
+			if ((off >= 8) || (len >= 1024 - off))
+				continue;
+
+			if ((sse->set_32s(-0x12345678, (INT32*)dest1 + off, len) != PRIMITIVES_SUCCESS) ||
+			    (avx2->set_32s(-0x12345678, (INT32*)dest2 + off, len) != PRIMITIVES_SUCCESS) ||
+			    (sse->set_32u(0xABCDEF12, dest1 + off + 1, len - 1) != PRIMITIVES_SUCCESS) ||
+			    (avx2->set_32u(0xABCDEF12, dest2 + off + 1, len - 1) != PRIMITIVES_SUCCESS))
+				return FALSE;
+
+			if (memcmp(dest1, dest2, sizeof(dest1)) != 0)
+			{
+				printf("set_32s/set_32u differ between the SSE and AVX2 tiers: off=%" PRIu32
+				       " len=%" PRIu32 "\n",
+				       off, len);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
 int TestPrimitivesSet(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -277,6 +336,9 @@ int TestPrimitivesSet(int argc, char* argv[])
 	if (!test_set32u_func())
 		return -1;
 
+	if (!test_set_avx2_func())
+		return -1;
+
 	if (g_TestPrimitivesPerformance)
 	{
 		if (!test_set8u_speed())
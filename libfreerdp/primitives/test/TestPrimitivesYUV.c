@@ -7,6 +7,7 @@
 
 #include <winpr/wlog.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/primitives.h>
 #include <freerdp/utils/profiler.h>
 
@@ -867,6 +868,202 @@ fail:
 	return res;
 }
 
+static BOOL compare_planes(const char* name, BYTE** a, BYTE** b, const UINT32 step[3],
+                           UINT32 width, UINT32 height)
+{
+	UINT32 x;
+
+	for (x = 0; x < 3; x++)
+	{
+		const UINT32 h = (x == 0) ? height : (height + 1) / 2;
+
+		if (memcmp(a[x], b[x], 1ULL * step[x] * h) != 0)
+		{
+			fprintf(stderr, "%s: plane %" PRIu32 " differs between the SSE and AVX2 tiers\n", name,
+			        x);
+			return FALSE;
+		}
+	}
+
+	WINPR_UNUSED(width);
+	return TRUE;
+}
+
+/* The AVX2 tier must produce output identical to the SSE tier it replaces. */
+static BOOL TestPrimitiveYUVAVX2(prim_size_t roi)
+{
+	union
+	{
+		const BYTE** cpv;
+		BYTE** pv;
+	} cnv;
+	BOOL res = FALSE;
+	UINT32 x, y;
+	BYTE* rgb = NULL;
+	BYTE* rgbSse = NULL;
+	BYTE* rgbAvx2 = NULL;
+	BYTE* luma[2][3] = { 0 };
+	BYTE* chroma[2][3] = { 0 };
+	BYTE* yuv444[3] = { 0 };
+	UINT32 yuv_step[3];
+	UINT32 yuv444_step[3];
+	const UINT32 awidth = roi.width + (16 - roi.width % 16) % 16;
+	const UINT32 aheight = roi.height + (16 - roi.height % 16) % 16;
+	const UINT32 stride = awidth * sizeof(UINT32);
+	const size_t size = 1ULL * stride * aheight;
+	const size_t padding = 0x1000;
+	const UINT32 formats[] = { PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_XRGB32 };
+	UINT64 start, sseTime, avx2Time;
+
+	if (!avx2 || !sse)
+	{
+		printf("AVX2 not available, skipping tier comparison\n");
+		return TRUE;
+	}
+
+	fprintf(stderr, "Comparing SSE and AVX2 tiers on frame size %" PRIu32 "x%" PRIu32 "\n",
+	        roi.width, roi.height);
+
+	if (!(rgb = set_padding(size, padding)) || !(rgbSse = set_padding(size, padding)) ||
+	    !(rgbAvx2 = set_padding(size, padding)))
+		goto fail;
+
+	for (x = 0; x < 2; x++)
+	{
+		if (!allocate_yuv420(luma[x], awidth, aheight, padding) ||
+		    !allocate_yuv420(chroma[x], awidth, aheight, padding))
+			goto fail;
+	}
+
+	for (x = 0; x < 3; x++)
+	{
+		if (!(yuv444[x] = set_padding(1ULL * awidth * aheight, padding)))
+			goto fail;
+
+		winpr_RAND(yuv444[x], 1ULL * awidth * aheight);
+	}
+
+	winpr_RAND(rgb, size);
+	yuv_step[0] = awidth;
+	yuv_step[1] = (awidth + 1) / 2;
+	yuv_step[2] = (awidth + 1) / 2;
+	yuv444_step[0] = yuv444_step[1] = yuv444_step[2] = awidth;
+
+	for (x = 0; x < sizeof(formats) / sizeof(formats[0]); x++)
+	{
+		const UINT32 format = formats[x];
+		printf("Testing color format %s\n", FreeRDPGetColorFormatName(format));
+
+		start = GetTickCount64();
+		if (sse->RGBToYUV420_8u_P3AC4R(rgb, format, stride, luma[0], yuv_step, &roi) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+		sseTime = GetTickCount64() - start;
+		start = GetTickCount64();
+		if (avx2->RGBToYUV420_8u_P3AC4R(rgb, format, stride, luma[1], yuv_step, &roi) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+		avx2Time = GetTickCount64() - start;
+		printf("RGBToYUV420: sse %" PRIu64 "ms, avx2 %" PRIu64 "ms\n", sseTime, avx2Time);
+
+		if (!compare_planes("RGBToYUV420", luma[0], luma[1], yuv_step, awidth, aheight))
+			goto fail;
+
+		for (y = 1; y <= 2; y++)
+		{
+			const __RGBToAVC444YUV_t fsse = (y == 1) ? sse->RGBToAVC444YUV : sse->RGBToAVC444YUVv2;
+			const __RGBToAVC444YUV_t favx2 =
+			    (y == 1) ? avx2->RGBToAVC444YUV : avx2->RGBToAVC444YUVv2;
+
+			start = GetTickCount64();
+			if (fsse(rgb, format, stride, luma[0], yuv_step, chroma[0], yuv_step, &roi) !=
+			    PRIMITIVES_SUCCESS)
+				goto fail;
+			sseTime = GetTickCount64() - start;
+			start = GetTickCount64();
+			if (favx2(rgb, format, stride, luma[1], yuv_step, chroma[1], yuv_step, &roi) !=
+			    PRIMITIVES_SUCCESS)
+				goto fail;
+			avx2Time = GetTickCount64() - start;
+			printf("RGBToAVC444YUV v%" PRIu32 ": sse %" PRIu64 "ms, avx2 %" PRIu64 "ms\n", y,
+			       sseTime, avx2Time);
+
+			if (!compare_planes("RGBToAVC444YUV luma", luma[0], luma[1], yuv_step, awidth,
+			                    aheight) ||
+			    !compare_planes("RGBToAVC444YUV chroma", chroma[0], chroma[1], yuv_step, awidth,
+			                    aheight))
+				goto fail;
+		}
+
+		/* The destination alpha is left alone, so start from identical buffers */
+		memcpy(rgbSse, rgb, size);
+		memcpy(rgbAvx2, rgb, size);
+		cnv.pv = luma[0];
+		start = GetTickCount64();
+		if (sse->YUV420ToRGB_8u_P3AC4R(cnv.cpv, yuv_step, rgbSse, stride, format, &roi) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+		sseTime = GetTickCount64() - start;
+		start = GetTickCount64();
+		if (avx2->YUV420ToRGB_8u_P3AC4R(cnv.cpv, yuv_step, rgbAvx2, stride, format, &roi) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+		avx2Time = GetTickCount64() - start;
+		printf("YUV420ToRGB: sse %" PRIu64 "ms, avx2 %" PRIu64 "ms\n", sseTime, avx2Time);
+
+		if (memcmp(rgbSse, rgbAvx2, size) != 0)
+		{
+			fprintf(stderr, "YUV420ToRGB differs between the SSE and AVX2 tiers\n");
+			goto fail;
+		}
+
+		cnv.pv = yuv444;
+		start = GetTickCount64();
+		if (sse->YUV444ToRGB_8u_P3AC4R(cnv.cpv, yuv444_step, rgbSse, stride, format, &roi) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+		sseTime = GetTickCount64() - start;
+		start = GetTickCount64();
+		if (avx2->YUV444ToRGB_8u_P3AC4R(cnv.cpv, yuv444_step, rgbAvx2, stride, format, &roi) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+		avx2Time = GetTickCount64() - start;
+		printf("YUV444ToRGB: sse %" PRIu64 "ms, avx2 %" PRIu64 "ms\n", sseTime, avx2Time);
+
+		if (memcmp(rgbSse, rgbAvx2, size) != 0)
+		{
+			fprintf(stderr, "YUV444ToRGB differs between the SSE and AVX2 tiers\n");
+			goto fail;
+		}
+	}
+
+	res = check_padding(rgb, size, padding, "rgb") && check_padding(rgbSse, size, padding, "sse") &&
+	      check_padding(rgbAvx2, size, padding, "avx2");
+
+	for (x = 0; x < 2; x++)
+	{
+		if (!check_yuv420(luma[x], awidth, aheight, padding) ||
+		    !check_yuv420(chroma[x], awidth, aheight, padding))
+			res = FALSE;
+	}
+
+fail:
+	free_padding(rgb, padding);
+	free_padding(rgbSse, padding);
+	free_padding(rgbAvx2, padding);
+
+	for (x = 0; x < 2; x++)
+	{
+		free_yuv420(luma[x], padding);
+		free_yuv420(chroma[x], padding);
+	}
+
+	for (x = 0; x < 3; x++)
+		free_padding(yuv444[x], padding);
+
+	return res;
+}
+
 int TestPrimitivesYUV(int argc, char* argv[])
 {
 	BOOL large = (argc > 1);
@@ -877,6 +1074,21 @@ int TestPrimitivesYUV(int argc, char* argv[])
 	prim_test_setup(FALSE);
 	primitives_t* prims = primitives_get();
 
+	{
+		/* widths that are a multiple of 32 take the AVX2 code paths, odd heights the last row
+		 * special cases */
+		const prim_size_t sizes[] = { { 1920, 1080 }, { 96, 17 }, { 80, 33 } };
+
+		for (x = 0; x < ARRAYSIZE(sizes); x++)
+		{
+			if (!TestPrimitiveYUVAVX2(sizes[x]))
+			{
+				printf("TestPrimitiveYUVAVX2 failed.\n");
+				goto end;
+			}
+		}
+	}
+
 	for (x = 0; x < 5; x++)
 	{
 		prim_size_t roi;
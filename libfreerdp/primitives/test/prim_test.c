@@ -15,6 +15,7 @@
 #include <freerdp/config.h>
 
 #include "prim_test.h"
+#include "../prim_internal.h"
 
 #ifndef _WIN32
 #include <fcntl.h>
@@ -32,6 +33,8 @@
 
 primitives_t* generic = NULL;
 primitives_t* optimized = NULL;
+primitives_t* sse = NULL;
+primitives_t* avx2 = NULL;
 BOOL g_TestPrimitivesPerformance = FALSE;
 UINT32 g_Iterations = 1000;
 
@@ -95,6 +98,13 @@ void prim_test_setup(BOOL performance)
 {
 	generic = primitives_get_generic();
 	optimized = primitives_get();
+#if defined(WITH_SSE2)
+	sse = primitives_get_sse();
+	avx2 = primitives_get_by_type(PRIMITIVES_ONLY_CPU);
+
+	if (!avx2 || !(primitives_flags(avx2) & PRIM_FLAGS_HAVE_EXTAVX2))
+		avx2 = NULL;
+#endif
 	g_TestPrimitivesPerformance = performance;
 }
 
@@ -48,6 +48,9 @@ extern UINT32 g_Iterations;
 
 extern primitives_t* generic;
 extern primitives_t* optimized;
+/* The SSE tier and, if the CPU supports it, the AVX2 tier on top of it (NULL otherwise) */
+extern primitives_t* sse;
+extern primitives_t* avx2;
 
 void prim_test_setup(BOOL performance);
 
@@ -644,6 +644,7 @@ static void pf_client_set_security_settings(pClientContext* pc)
 	freerdp_settings_set_bool(settings, FreeRDP_RdpSecurity, config->ClientRdpSecurity);
 	freerdp_settings_set_bool(settings, FreeRDP_TlsSecurity, config->ClientTlsSecurity);
 	freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity, config->ClientNlaSecurity);
+	freerdp_settings_set_bool(settings, FreeRDP_TlsKernelOffload, config->TlsKernelOffload);
 
 	/* Smartcard authentication currently does not work with NLA */
 	if (pf_client_use_proxy_smartcard_auth(settings))
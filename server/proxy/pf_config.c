@@ -251,6 +251,7 @@ static BOOL pf_config_load_security(wIniFile* ini, proxyConfig* config)
 	config->ClientRdpSecurity = pf_config_get_bool(ini, "Security", "ClientRdpSecurity", TRUE);
 	config->ClientAllowFallbackToTls =
 	    pf_config_get_bool(ini, "Security", "ClientAllowFallbackToTls", TRUE);
+	config->TlsKernelOffload = pf_config_get_bool(ini, "Security", "TlsKernelOffload", FALSE);
 	return TRUE;
 }
 
@@ -513,6 +514,8 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueString(ini, "Security", "ClientAllowFallbackToTls", "true") < 0)
 		goto fail;
+	if (IniFile_SetKeyValueString(ini, "Security", "TlsKernelOffload", "false") < 0)
+		goto fail;
 
 	/* Module configuration */
 	if (IniFile_SetKeyValueString(ini, "Plugins", "Modules", "module1,module2,...") < 0)
@@ -652,6 +655,7 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_BOOL(config, ClientTlsSecurity);
 	CONFIG_PRINT_BOOL(config, ClientRdpSecurity);
 	CONFIG_PRINT_BOOL(config, ClientAllowFallbackToTls);
+	CONFIG_PRINT_BOOL(config, TlsKernelOffload);
 
 	CONFIG_PRINT_SECTION("Channels");
 	CONFIG_PRINT_BOOL(config, GFX);
@@ -502,6 +502,7 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	settings->RdpSecurity = config->ServerRdpSecurity;
 	settings->TlsSecurity = config->ServerTlsSecurity;
 	settings->NlaSecurity = config->ServerNlaSecurity;
+	settings->TlsKernelOffload = config->TlsKernelOffload;
 	settings->EncryptionLevel = ENCRYPTION_LEVEL_CLIENT_COMPATIBLE;
 	settings->ColorDepth = 32;
 	settings->SuppressOutput = TRUE;
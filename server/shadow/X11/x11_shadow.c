@@ -759,9 +759,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	XImage* image;
 	rdpShadowServer* server;
 	rdpShadowSurface* surface;
-	RECTANGLE_16 invalidRect;
+	REGION16 invalidRegion;
 	RECTANGLE_16 surfaceRect;
-	const RECTANGLE_16* extents;
 	server = subsystem->common.server;
 	surface = server->surface;
 	count = ArrayList_Count(server->clients);
@@ -769,6 +768,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	if (count < 1)
 		return 1;
 
+	region16_init(&invalidRegion);
 	EnterCriticalSection(&surface->lock);
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
@@ -790,9 +790,9 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		          subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
 
 		EnterCriticalSection(&surface->lock);
-		status = shadow_capture_compare(surface->data, surface->scanline, surface->width,
-		                                surface->height, (BYTE*)&(image->data[surface->width * 4]),
-		                                image->bytes_per_line, &invalidRect);
+		status = shadow_capture_compare_region(
+		    server->capture, surface->data, surface->scanline, surface->width, surface->height,
+		    (BYTE*)&(image->data[surface->width * 4]), image->bytes_per_line, &invalidRegion);
 		LeaveCriticalSection(&surface->lock);
 	}
 	else
@@ -803,9 +803,9 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 		if (image)
 		{
-			status = shadow_capture_compare(surface->data, surface->scanline, surface->width,
-			                                surface->height, (BYTE*)image->data,
-			                                image->bytes_per_line, &invalidRect);
+			status = shadow_capture_compare_region(
+			    server->capture, surface->data, surface->scanline, surface->width,
+			    surface->height, (BYTE*)image->data, image->bytes_per_line, &invalidRegion);
 		}
 		LeaveCriticalSection(&surface->lock);
 		if (!image)
@@ -823,32 +823,47 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	XSync(subsystem->display, False);
 	XUnlockDisplay(subsystem->display);
 
-	if (status)
+	if (status > 0)
 	{
 		BOOL empty;
+		UINT32 index;
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects;
 		EnterCriticalSection(&surface->lock);
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
+		rects = region16_rects(&invalidRegion, &numRects);
+
+		for (index = 0; index < numRects; index++)
+		{
+			region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
+			                    &rects[index]);
+		}
+
 		region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), &surfaceRect);
 		empty = region16_is_empty(&(surface->invalidRegion));
 		LeaveCriticalSection(&surface->lock);
 
 		if (!empty)
 		{
-			BOOL success;
+			BOOL success = TRUE;
 			EnterCriticalSection(&surface->lock);
-			extents = region16_extents(&(surface->invalidRegion));
-			x = extents->left;
-			y = extents->top;
-			width = extents->right - extents->left;
-			height = extents->bottom - extents->top;
+			rects = region16_rects(&(surface->invalidRegion), &numRects);
 			WINPR_ASSERT(image);
 			WINPR_ASSERT(image->bytes_per_line >= 0);
-			WINPR_ASSERT(width >= 0);
-			WINPR_ASSERT(height >= 0);
-			success = freerdp_image_copy(surface->data, surface->format, surface->scanline, x, y,
-			                             (UINT32)width, (UINT32)height, (BYTE*)image->data,
-			                             PIXEL_FORMAT_BGRX32, (UINT32)image->bytes_per_line, x, y,
-			                             NULL, FREERDP_FLIP_NONE);
+
+			/* Only the changed tiles are copied to the surface */
+			for (index = 0; success && (index < numRects); index++)
+			{
+				const RECTANGLE_16* rect = &rects[index];
+				x = rect->left;
+				y = rect->top;
+				width = rect->right - rect->left;
+				height = rect->bottom - rect->top;
+				success = freerdp_image_copy(surface->data, surface->format, surface->scanline, x,
+				                             y, (UINT32)width, (UINT32)height, (BYTE*)image->data,
+				                             PIXEL_FORMAT_BGRX32, (UINT32)image->bytes_per_line, x,
+				                             y, NULL, FREERDP_FLIP_NONE);
+			}
+
 			LeaveCriticalSection(&surface->lock);
 			if (!success)
 				goto fail_capture;
@@ -875,6 +890,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 	rc = 1;
 fail_capture:
+	region16_uninit(&invalidRegion);
 	if (!subsystem->use_xshm && image)
 		XDestroyImage(image);
 
@@ -26,6 +26,7 @@
 #include "shadow_screen.h"
 #include "shadow_surface.h"
 #include "shadow_encoder.h"
+#include "shadow_encoder_group.h"
 #include "shadow_capture.h"
 #include "shadow_channels.h"
 #include "shadow_subsystem.h"
@@ -20,6 +20,11 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
+
+#if defined(WITH_SSE2)
+#include <emmintrin.h>
+#endif
 
 #include <freerdp/log.h>
 
@@ -29,6 +34,29 @@
 
 #define TAG SERVER_TAG("shadow")
 
+/* Frames are compared in stripes of at least this many tile rows */
+#define SHADOW_CAPTURE_MIN_STRIPE_ROWS 8
+
+static void shadow_capture_free_stripes(rdpShadowCapture* capture)
+{
+	size_t index;
+
+	if (capture->stripeWorks)
+	{
+		for (index = 0; index < capture->numStripes; index++)
+		{
+			if (capture->stripeWorks[index])
+				CloseThreadpoolWork(capture->stripeWorks[index]);
+		}
+	}
+
+	free(capture->stripeWorks);
+	free(capture->stripes);
+	capture->stripeWorks = NULL;
+	capture->stripes = NULL;
+	capture->numStripes = 0;
+}
+
 int shadow_capture_align_clip_rect(RECTANGLE_16* rect, RECTANGLE_16* clip)
 {
 	int dx, dy;
@@ -77,149 +105,295 @@ int shadow_capture_align_clip_rect(RECTANGLE_16* rect, RECTANGLE_16* clip)
 	return 1;
 }
 
-int shadow_capture_compare(BYTE* pData1, UINT32 nStep1, UINT32 nWidth, UINT32 nHeight, BYTE* pData2,
-                           UINT32 nStep2, RECTANGLE_16* rect)
+static BOOL shadow_capture_tile_row_equal(const BYTE* p1, const BYTE* p2, UINT32 size, BOOL sse2)
 {
-	BOOL equal;
-	BOOL allEqual;
-	UINT32 tw, th;
-	UINT32 tx, ty, k;
-	UINT32 nrow, ncol;
-	UINT32 l, t, r, b;
-	BYTE *p1, *p2;
-	BOOL rows[1024];
-#ifdef WITH_DEBUG_SHADOW_CAPTURE
-	BOOL cols[1024];
-#endif
-	allEqual = TRUE;
-	ZeroMemory(rect, sizeof(RECTANGLE_16));
-	FillMemory(rows, sizeof(rows), 0xFF);
-#ifdef WITH_DEBUG_SHADOW_CAPTURE
-	FillMemory(cols, sizeof(cols), 0xFF);
+#if defined(WITH_SSE2)
+	if (sse2 && (size == SHADOW_CAPTURE_TILE_SIZE * 4))
+	{
+		const __m128i a0 = _mm_loadu_si128((const __m128i*)&p1[0]);
+		const __m128i a1 = _mm_loadu_si128((const __m128i*)&p1[16]);
+		const __m128i a2 = _mm_loadu_si128((const __m128i*)&p1[32]);
+		const __m128i a3 = _mm_loadu_si128((const __m128i*)&p1[48]);
+		const __m128i b0 = _mm_loadu_si128((const __m128i*)&p2[0]);
+		const __m128i b1 = _mm_loadu_si128((const __m128i*)&p2[16]);
+		const __m128i b2 = _mm_loadu_si128((const __m128i*)&p2[32]);
+		const __m128i b3 = _mm_loadu_si128((const __m128i*)&p2[48]);
+		__m128i eq = _mm_and_si128(_mm_cmpeq_epi32(a0, b0), _mm_cmpeq_epi32(a1, b1));
+		eq = _mm_and_si128(eq, _mm_cmpeq_epi32(a2, b2));
+		eq = _mm_and_si128(eq, _mm_cmpeq_epi32(a3, b3));
+		return _mm_movemask_epi8(eq) == 0xFFFF;
+	}
+#else
+	WINPR_UNUSED(sse2);
 #endif
-	nrow = (nHeight + 15) / 16;
-	ncol = (nWidth + 15) / 16;
-	l = ncol + 1;
-	r = 0;
-	t = nrow + 1;
-	b = 0;
 
-	for (ty = 0; ty < nrow; ty++)
+	return memcmp(p1, p2, size) == 0;
+}
+
+/**
+ * Compares the tile rows [firstRow, lastRow) of both frames and marks every
+ * differing tile in the dirty map. The frames are walked scanline by scanline so
+ * both buffers are read sequentially, tiles already known to be dirty are skipped.
+ */
+static void shadow_capture_compare_stripe(const SHADOW_CAPTURE_STRIPE* stripe)
+{
+	UINT32 ty;
+	const SHADOW_CAPTURE_FRAME* frame = stripe->frame;
+	const UINT32 ncol = (frame->nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	const UINT32 lastWidth = frame->nWidth - (ncol - 1) * SHADOW_CAPTURE_TILE_SIZE;
+
+	for (ty = stripe->firstRow; ty < stripe->lastRow; ty++)
 	{
-		th = ((ty + 1) == nrow) ? (nHeight % 16) : 16;
+		UINT32 k;
+		UINT32 tx;
+		UINT32 clean = ncol;
+		BYTE* dirty = &frame->dirty[1ull * ty * ncol];
+		const UINT32 y = ty * SHADOW_CAPTURE_TILE_SIZE;
+		UINT32 th = frame->nHeight - y;
 
-		if (!th)
-			th = 16;
+		if (th > SHADOW_CAPTURE_TILE_SIZE)
+			th = SHADOW_CAPTURE_TILE_SIZE;
 
-		for (tx = 0; tx < ncol; tx++)
+		ZeroMemory(dirty, ncol);
+
+		for (k = 0; (k < th) && (clean > 0); k++)
 		{
-			equal = TRUE;
-			tw = ((tx + 1) == ncol) ? (nWidth % 16) : 16;
+			const BYTE* p1 = &frame->pData1[1ull * (y + k) * frame->nStep1];
+			const BYTE* p2 = &frame->pData2[1ull * (y + k) * frame->nStep2];
 
-			if (!tw)
-				tw = 16;
+			for (tx = 0; tx < ncol; tx++)
+			{
+				const size_t offset = 4ull * tx * SHADOW_CAPTURE_TILE_SIZE;
+				const UINT32 tw = ((tx + 1) == ncol) ? lastWidth : SHADOW_CAPTURE_TILE_SIZE;
 
-			p1 = &pData1[(ty * 16 * nStep1) + (tx * 16 * 4)];
-			p2 = &pData2[(ty * 16 * nStep2) + (tx * 16 * 4)];
+				if (dirty[tx])
+					continue;
 
-			for (k = 0; k < th; k++)
-			{
-				if (memcmp(p1, p2, tw * 4) != 0)
+				if (!shadow_capture_tile_row_equal(&p1[offset], &p2[offset], tw * 4, frame->sse2))
 				{
-					equal = FALSE;
-					break;
+					dirty[tx] = 1;
+					clean--;
 				}
-
-				p1 += nStep1;
-				p2 += nStep2;
 			}
+		}
+	}
+}
 
-			if (!equal)
-			{
-				rows[ty] = FALSE;
-#ifdef WITH_DEBUG_SHADOW_CAPTURE
-				cols[tx] = FALSE;
-#endif
-
-				if (l > tx)
-					l = tx;
+static void CALLBACK shadow_capture_stripe_work(PTP_CALLBACK_INSTANCE instance, void* context,
+                                                PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	shadow_capture_compare_stripe((const SHADOW_CAPTURE_STRIPE*)context);
+}
 
-				if (r < tx)
-					r = tx;
-			}
-		}
+static BOOL shadow_capture_ensure_dirty_map(rdpShadowCapture* capture, size_t size)
+{
+	BYTE* tmp;
 
-		if (!rows[ty])
-		{
-			allEqual = FALSE;
+	if (capture->dirtyTilesSize >= size)
+		return TRUE;
 
-			if (t > ty)
-				t = ty;
+	tmp = (BYTE*)realloc(capture->dirtyTiles, size);
 
-			if (b < ty)
-				b = ty;
-		}
-	}
+	if (!tmp)
+		return FALSE;
 
-	if (allEqual)
-		return 0;
+	capture->dirtyTiles = tmp;
+	capture->dirtyTilesSize = size;
+	return TRUE;
+}
 
-	WINPR_ASSERT(l * 16 <= UINT16_MAX);
-	WINPR_ASSERT(t * 16 <= UINT16_MAX);
-	WINPR_ASSERT((r + 1) * 16 <= UINT16_MAX);
-	WINPR_ASSERT((b + 1) * 16 <= UINT16_MAX);
-	rect->left = (UINT16)l * 16;
-	rect->top = (UINT16)t * 16;
-	rect->right = (UINT16)(r + 1) * 16;
-	rect->bottom = (UINT16)(b + 1) * 16;
+static BOOL shadow_capture_ensure_stripes(rdpShadowCapture* capture)
+{
+	size_t index;
+	SYSTEM_INFO sysinfo = { 0 };
 
-	WINPR_ASSERT(nWidth <= UINT16_MAX);
-	if (rect->right > nWidth)
-		rect->right = (UINT16)nWidth;
+	if (capture->stripeWorks)
+		return TRUE;
 
-	WINPR_ASSERT(nHeight <= UINT16_MAX);
-	if (rect->bottom > nHeight)
-		rect->bottom = (UINT16)nHeight;
+	/* Set once parallel compare is not possible, so it is not retried every frame */
+	if (capture->serialCompare)
+		return FALSE;
 
-#ifdef WITH_DEBUG_SHADOW_CAPTURE
-	size_t size = ncol + 1;
-	char* col_str = calloc(size, sizeof(char));
+	GetNativeSystemInfo(&sysinfo);
+	capture->numStripes = sysinfo.dwNumberOfProcessors;
 
-	if (!col_str)
+	if (capture->numStripes < 2)
 	{
-		WLog_ERR(TAG, "calloc failed!");
-		return 1;
+		capture->numStripes = 0;
+		capture->serialCompare = TRUE;
+		return FALSE;
 	}
 
-	for (tx = 0; tx < ncol; tx++)
-		sprintf_s(&col_str[tx], size - tx, "-");
+	capture->stripes =
+	    (SHADOW_CAPTURE_STRIPE*)calloc(capture->numStripes, sizeof(SHADOW_CAPTURE_STRIPE));
+	capture->stripeWorks = (PTP_WORK*)calloc(capture->numStripes, sizeof(PTP_WORK));
 
-	WLog_INFO(TAG, "%s", col_str);
+	if (!capture->stripes || !capture->stripeWorks)
+		goto fail;
 
-	for (tx = 0; tx < ncol; tx++)
-		sprintf_s(&col_str[tx], size - tx, "%c", cols[tx] ? 'O' : 'X');
+	for (index = 0; index < capture->numStripes; index++)
+	{
+		capture->stripes[index].frame = &capture->frame;
+		capture->stripeWorks[index] =
+		    CreateThreadpoolWork(shadow_capture_stripe_work, &capture->stripes[index], NULL);
 
-	WLog_INFO(TAG, "%s", col_str);
+		if (!capture->stripeWorks[index])
+			goto fail;
+	}
 
-	for (tx = 0; tx < ncol; tx++)
-		sprintf_s(&col_str[tx], size - tx, "-");
+	return TRUE;
+fail:
+	WLog_WARN(TAG, "Failed to set up parallel frame compare, comparing on the capture thread");
+	shadow_capture_free_stripes(capture);
+	capture->serialCompare = TRUE;
+	return FALSE;
+}
 
-	WLog_INFO(TAG, "%s", col_str);
+static BOOL shadow_capture_dirty_to_region(const SHADOW_CAPTURE_FRAME* frame, REGION16* region)
+{
+	UINT32 tx;
+	UINT32 ty;
+	const UINT32 nrow = (frame->nHeight + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	const UINT32 ncol = (frame->nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
 
 	for (ty = 0; ty < nrow; ty++)
 	{
+		const BYTE* dirty = &frame->dirty[1ull * ty * ncol];
+
 		for (tx = 0; tx < ncol; tx++)
-			sprintf_s(&col_str[tx], size - tx, "%c", cols[tx] ? 'O' : 'X');
+		{
+			RECTANGLE_16 rect;
+			const UINT32 first = tx;
 
-		WLog_INFO(TAG, "%s", col_str);
-		WLog_INFO(TAG, "|%s|", rows[ty] ? "O" : "X");
+			if (!dirty[tx])
+				continue;
+
+			/* merge horizontal runs of dirty tiles into a single rectangle */
+			while (((tx + 1) < ncol) && dirty[tx + 1])
+				tx++;
+
+			rect.left = (UINT16)(first * SHADOW_CAPTURE_TILE_SIZE);
+			rect.top = (UINT16)(ty * SHADOW_CAPTURE_TILE_SIZE);
+			rect.right = (UINT16)MIN((tx + 1) * SHADOW_CAPTURE_TILE_SIZE, frame->nWidth);
+			rect.bottom = (UINT16)MIN((ty + 1) * SHADOW_CAPTURE_TILE_SIZE, frame->nHeight);
+
+			if (!region16_union_rect(region, region, &rect))
+				return FALSE;
+		}
 	}
 
-	WLog_INFO(TAG, "left: %d top: %d right: %d bottom: %d ncol: %d nrow: %d", l, t, r, b, ncol,
-	          nrow);
-	free(col_str);
+	return TRUE;
+}
+
+int shadow_capture_compare_region(rdpShadowCapture* capture, const BYTE* pData1, UINT32 nStep1,
+                                  UINT32 nWidth, UINT32 nHeight, const BYTE* pData2, UINT32 nStep2,
+                                  REGION16* region)
+{
+	int status = -1;
+	UINT32 nrow;
+	UINT32 ncol;
+	size_t index;
+	size_t numStripes = 1;
+	SHADOW_CAPTURE_FRAME local = { 0 };
+	SHADOW_CAPTURE_FRAME* frame = &local;
+
+	if (!pData1 || !pData2 || !region)
+		return -1;
+
+	if ((nWidth > UINT16_MAX) || (nHeight > UINT16_MAX))
+		return -1;
+
+	region16_clear(region);
+
+	if ((nWidth == 0) || (nHeight == 0))
+		return 0;
+
+	nrow = (nHeight + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	ncol = (nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+
+	if (capture)
+	{
+		EnterCriticalSection(&capture->lock);
+
+		if (!shadow_capture_ensure_dirty_map(capture, 1ull * nrow * ncol))
+			goto out;
+
+		frame = &capture->frame;
+		frame->dirty = capture->dirtyTiles;
+
+		if ((nrow >= 2 * SHADOW_CAPTURE_MIN_STRIPE_ROWS) && shadow_capture_ensure_stripes(capture))
+			numStripes = MIN(capture->numStripes, nrow / SHADOW_CAPTURE_MIN_STRIPE_ROWS);
+	}
+	else if (!(frame->dirty = (BYTE*)malloc(1ull * nrow * ncol)))
+		return -1;
+
+	frame->pData1 = pData1;
+	frame->nStep1 = nStep1;
+	frame->pData2 = pData2;
+	frame->nStep2 = nStep2;
+	frame->nWidth = nWidth;
+	frame->nHeight = nHeight;
+#if defined(WITH_SSE2)
+	frame->sse2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
 #endif
-	return 1;
+
+	if (numStripes > 1)
+	{
+		for (index = 0; index < numStripes; index++)
+		{
+			SHADOW_CAPTURE_STRIPE* stripe = &capture->stripes[index];
+			stripe->firstRow = (UINT32)(index * nrow / numStripes);
+			stripe->lastRow = (UINT32)((index + 1) * nrow / numStripes);
+		}
+
+		/* the first stripe is compared on the calling thread */
+		SubmitThreadpoolWorkBatch(&capture->stripeWorks[1], numStripes - 1);
+		shadow_capture_compare_stripe(&capture->stripes[0]);
+
+		for (index = 1; index < numStripes; index++)
+			WaitForThreadpoolWorkCallbacks(capture->stripeWorks[index], FALSE);
+	}
+	else
+	{
+		SHADOW_CAPTURE_STRIPE stripe = { 0 };
+		stripe.frame = frame;
+		stripe.firstRow = 0;
+		stripe.lastRow = nrow;
+		shadow_capture_compare_stripe(&stripe);
+	}
+
+	if (!shadow_capture_dirty_to_region(frame, region))
+		goto out;
+
+	status = region16_is_empty(region) ? 0 : 1;
+out:
+	if (capture)
+		LeaveCriticalSection(&capture->lock);
+	else
+		free(local.dirty);
+
+	return status;
+}
+
+int shadow_capture_compare(BYTE* pData1, UINT32 nStep1, UINT32 nWidth, UINT32 nHeight, BYTE* pData2,
+                           UINT32 nStep2, RECTANGLE_16* rect)
+{
+	int status;
+	REGION16 region;
+
+	WINPR_ASSERT(rect);
+	ZeroMemory(rect, sizeof(RECTANGLE_16));
+	region16_init(&region);
+	status = shadow_capture_compare_region(NULL, pData1, nStep1, nWidth, nHeight, pData2, nStep2,
+	                                       &region);
+
+	if (status > 0)
+		*rect = *region16_extents(&region);
+
+	region16_uninit(&region);
+	return status;
 }
 
 rdpShadowCapture* shadow_capture_new(rdpShadowServer* server)
@@ -246,6 +420,8 @@ void shadow_capture_free(rdpShadowCapture* capture)
 	if (!capture)
 		return;
 
+	shadow_capture_free_stripes(capture);
+	free(capture->dirtyTiles);
 	DeleteCriticalSection(&(capture->lock));
 	free(capture);
 }
@@ -23,6 +23,28 @@
 
 #include <winpr/crt.h>
 #include <winpr/synch.h>
+#include <winpr/pool.h>
+
+#define SHADOW_CAPTURE_TILE_SIZE 16
+
+typedef struct
+{
+	const BYTE* pData1;
+	UINT32 nStep1;
+	const BYTE* pData2;
+	UINT32 nStep2;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	BOOL sse2;
+	BYTE* dirty; /* one flag per tile, row major */
+} SHADOW_CAPTURE_FRAME;
+
+typedef struct
+{
+	const SHADOW_CAPTURE_FRAME* frame;
+	UINT32 firstRow;
+	UINT32 lastRow;
+} SHADOW_CAPTURE_STRIPE;
 
 struct rdp_shadow_capture
 {
@@ -32,6 +54,14 @@ struct rdp_shadow_capture
 	int height;
 
 	CRITICAL_SECTION lock;
+
+	SHADOW_CAPTURE_FRAME frame;
+	BYTE* dirtyTiles;
+	size_t dirtyTilesSize;
+	size_t numStripes;
+	SHADOW_CAPTURE_STRIPE* stripes;
+	PTP_WORK* stripeWorks;
+	BOOL serialCompare;
 };
 
 #ifdef __cplusplus
@@ -36,6 +36,22 @@
 
 #define TAG CLIENT_TAG("shadow")
 
+/* Intervals between two autodetect probes in ms */
+#define SHADOW_CLIENT_RTT_INTERVAL 1000
+#define SHADOW_CLIENT_BANDWIDTH_INTERVAL 2000
+
+/* Smaller frames arrive too fast for a meaningful bandwidth measurement */
+#define SHADOW_CLIENT_BANDWIDTH_MIN_FRAME_SIZE (32 * 1024)
+
+/* Tiles with at most this many colors are text or UI and sent with ClearCodec,
+ * the tile size matches the RemoteFX/progressive grid so the codecs never overlap */
+#define SHADOW_CLIENT_CLEAR_TILE_SIZE 64
+#define SHADOW_CLIENT_CLEAR_MAX_COLORS 64
+
+/* Subsystems only signal damage, upgrade passes for a static desktop are sent at this
+ * interval in ms */
+#define SHADOW_CLIENT_UPGRADE_INTERVAL 50
+
 typedef struct
 {
 	BOOL gfxOpened;
@@ -82,6 +98,13 @@ static INLINE BOOL shadow_client_rdpgfx_new_surface(rdpShadowClient* client)
 		return FALSE;
 	}
 
+	/* The new surface is blank, drop the per tile state of the progressive encoder */
+	if (client->encoder && client->encoder->progressive)
+	{
+		if (!progressive_context_reset(client->encoder->progressive))
+			return FALSE;
+	}
+
 	return TRUE;
 }
 
@@ -152,6 +175,32 @@ static INLINE void shadow_client_free_queued_message(void* obj)
 	}
 }
 
+static BOOL shadow_client_rtt_measure_response(rdpContext* context, UINT16 sequenceNumber)
+{
+	rdpShadowClient* client = (rdpShadowClient*)context;
+
+	WINPR_UNUSED(sequenceNumber);
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(context->autodetect);
+
+	shadow_encoder_network_characteristics(client->encoder, context->autodetect->netCharAverageRTT,
+	                                       0);
+	return TRUE;
+}
+
+static BOOL shadow_client_bandwidth_measure_results(rdpContext* context, UINT16 sequenceNumber)
+{
+	rdpShadowClient* client = (rdpShadowClient*)context;
+
+	WINPR_UNUSED(sequenceNumber);
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(context->autodetect);
+
+	shadow_encoder_network_characteristics(client->encoder, 0,
+	                                       context->autodetect->netCharBandwidth);
+	return TRUE;
+}
+
 static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 {
 	BOOL NSCodec;
@@ -193,6 +242,9 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 	settings->DrawAllowColorSubsampling = TRUE;
 	settings->DrawAllowDynamicColorFidelity = TRUE;
 	settings->CompressionLevel = PACKET_COMPR_TYPE_RDP6;
+	settings->CompressionAdaptive = srvSettings->CompressionAdaptive;
+	settings->DynamicChannelCompression = srvSettings->DynamicChannelCompression;
+	settings->TlsKernelOffload = srvSettings->TlsKernelOffload;
 
 	if (!freerdp_settings_set_string(settings, FreeRDP_CertificateFile, server->CertificateFile))
 		goto fail_cert_file;
@@ -228,6 +280,11 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 	if (!(client->encoder = shadow_encoder_new(client)))
 		goto fail_encoder_new;
 
+	/* Network characteristics feed the encoder rate control */
+	WINPR_ASSERT(context->autodetect);
+	context->autodetect->RTTMeasureResponse = shadow_client_rtt_measure_response;
+	context->autodetect->BandwidthMeasureResults = shadow_client_bandwidth_measure_results;
+
 	if (ArrayList_Append(server->clients, (void*)client))
 		return TRUE;
 
@@ -338,10 +395,21 @@ static INLINE BOOL shadow_client_recalc_desktop_size(rdpShadowClient* client)
 	WINPR_ASSERT(server->surface);
 	WINPR_ASSERT(settings);
 
-	WINPR_ASSERT(server->surface->width <= UINT16_MAX);
-	WINPR_ASSERT(server->surface->height <= UINT16_MAX);
-	viewport.right = (UINT16)server->surface->width;
-	viewport.bottom = (UINT16)server->surface->height;
+	/* Once published the clients follow the size of the frame they encode from */
+	if (server->surface->frameData)
+	{
+		WINPR_ASSERT(server->surface->frameWidth <= UINT16_MAX);
+		WINPR_ASSERT(server->surface->frameHeight <= UINT16_MAX);
+		viewport.right = (UINT16)server->surface->frameWidth;
+		viewport.bottom = (UINT16)server->surface->frameHeight;
+	}
+	else
+	{
+		WINPR_ASSERT(server->surface->width <= UINT16_MAX);
+		WINPR_ASSERT(server->surface->height <= UINT16_MAX);
+		viewport.right = (UINT16)server->surface->width;
+		viewport.bottom = (UINT16)server->surface->height;
+	}
 
 	if (server->shareSubRect)
 	{
@@ -682,7 +750,8 @@ fail:
 	return rc;
 }
 
-static INLINE void shadow_client_common_frame_acknowledge(rdpShadowClient* client, UINT32 frameId)
+static INLINE void shadow_client_common_frame_acknowledge(rdpShadowClient* client, UINT32 frameId,
+                                                          UINT32 queueDepth)
 {
 	/*
 	 * Record the last client acknowledged frame id to
@@ -694,19 +763,15 @@ static INLINE void shadow_client_common_frame_acknowledge(rdpShadowClient* clien
 	 */
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->encoder);
-	client->encoder->lastAckframeId = frameId;
+	shadow_encoder_frame_acknowledged(client->encoder, frameId, queueDepth);
 }
 
 static BOOL shadow_client_surface_frame_acknowledge(rdpContext* context, UINT32 frameId)
 {
 	rdpShadowClient* client = (rdpShadowClient*)context;
-	shadow_client_common_frame_acknowledge(client, frameId);
-	/*
-	 * Reset queueDepth for legacy none RDPGFX acknowledge
-	 */
-	WINPR_ASSERT(client);
-	WINPR_ASSERT(client->encoder);
-	client->encoder->queueDepth = QUEUE_DEPTH_UNAVAILABLE;
+
+	/* No queueDepth for legacy none RDPGFX acknowledge */
+	shadow_client_common_frame_acknowledge(client, frameId, QUEUE_DEPTH_UNAVAILABLE);
 	return TRUE;
 }
 
@@ -720,14 +785,62 @@ shadow_client_rdpgfx_frame_acknowledge(RdpgfxServerContext* context,
 	WINPR_ASSERT(frameAcknowledge);
 
 	client = (rdpShadowClient*)context->custom;
-	shadow_client_common_frame_acknowledge(client, frameAcknowledge->frameId);
-
-	WINPR_ASSERT(client);
-	WINPR_ASSERT(client->encoder);
-	client->encoder->queueDepth = frameAcknowledge->queueDepth;
+	shadow_client_common_frame_acknowledge(client, frameAcknowledge->frameId,
+	                                       frameAcknowledge->queueDepth);
 	return CHANNEL_RC_OK;
 }
 
+/**
+ * Sends the periodic autodetect probes feeding the encoder rate control.
+ * The bandwidth is measured on large frames only, the client reports how long
+ * the data between the start and the stop PDU took to arrive.
+ * The stop PDU is sent by shadow_client_autodetect_end once the frame left the
+ * virtual channel queue.
+ */
+static void shadow_client_autodetect_begin(rdpShadowClient* client, size_t frameSize)
+{
+	rdpContext* context = (rdpContext*)client;
+	rdpAutoDetect* autodetect = context->autodetect;
+	SHADOW_RATE_CONTROL* rc = &client->encoder->rateControl;
+	const UINT64 now = GetTickCount64();
+
+	if (!autodetect || !freerdp_settings_get_bool(context->settings, FreeRDP_NetworkAutoDetect))
+		return;
+
+	if (autodetect->RTTMeasureRequest && (now - rc->lastRttRequest >= SHADOW_CLIENT_RTT_INTERVAL))
+	{
+		rc->lastRttRequest = now;
+
+		if (!autodetect->RTTMeasureRequest(context, rc->sequenceNumber++))
+			WLog_WARN(TAG, "Failed to send RTT measure request");
+	}
+
+	if (rc->bandwidthPending || (frameSize < SHADOW_CLIENT_BANDWIDTH_MIN_FRAME_SIZE) ||
+	    (now - rc->lastBandwidthRequest < SHADOW_CLIENT_BANDWIDTH_INTERVAL))
+		return;
+
+	if (!autodetect->BandwidthMeasureStart || !autodetect->BandwidthMeasureStop)
+		return;
+
+	rc->lastBandwidthRequest = now;
+	rc->bandwidthPending = autodetect->BandwidthMeasureStart(context, rc->sequenceNumber);
+}
+
+static void shadow_client_autodetect_end(rdpShadowClient* client)
+{
+	rdpContext* context = (rdpContext*)client;
+	rdpAutoDetect* autodetect = context->autodetect;
+	SHADOW_RATE_CONTROL* rc = &client->encoder->rateControl;
+
+	if (!rc->bandwidthPending)
+		return;
+
+	rc->bandwidthPending = FALSE;
+
+	if (!autodetect->BandwidthMeasureStop(context, rc->sequenceNumber++))
+		WLog_WARN(TAG, "Failed to send bandwidth measure stop");
+}
+
 static BOOL shadow_are_caps_filtered(const rdpSettings* settings, UINT32 caps)
 {
 	UINT32 filter;
@@ -781,6 +894,7 @@ static BOOL shadow_client_caps_test_version(RdpgfxServerContext* context, rdpSha
 		{
 			UINT32 flags;
 			BOOL planar = FALSE;
+			BOOL clear = FALSE;
 			BOOL rfx = FALSE;
 			BOOL avc444v2 = FALSE;
 			BOOL avc444 = FALSE;
@@ -816,6 +930,9 @@ static BOOL shadow_client_caps_test_version(RdpgfxServerContext* context, rdpSha
 			planar = freerdp_settings_get_bool(srvSettings, FreeRDP_GfxPlanar);
 			freerdp_settings_set_bool(clientSettings, FreeRDP_GfxPlanar, planar);
 
+			clear = freerdp_settings_get_bool(srvSettings, FreeRDP_GfxClearCodec);
+			freerdp_settings_set_bool(clientSettings, FreeRDP_GfxClearCodec, clear);
+
 			if (!avc444v2 && !avc444 && !avc420)
 				pdu.capsSet->flags |= RDPGFX_CAPS_FLAG_AVC_DISABLED;
 
@@ -980,6 +1097,567 @@ static INLINE UINT32 rdpgfx_estimate_h264_avc420(RDPGFX_AVC420_BITMAP_STREAM* ha
 	       havc420->length;
 }
 
+/**
+ * Counts the distinct colors of a tile, up to SHADOW_CLIENT_CLEAR_MAX_COLORS + 1.
+ * A tile with few colors is text, glyphs or flat UI which ClearCodec compresses
+ * losslessly and much better than a transform codec.
+ */
+static BOOL shadow_client_is_clear_tile(const BYTE* pSrcData, UINT32 nSrcStep, UINT32 nWidth,
+                                        UINT32 nHeight)
+{
+	UINT32 x, y;
+	UINT32 colors = 0;
+	UINT32 table[SHADOW_CLIENT_CLEAR_MAX_COLORS * 2] = { 0 };
+	BOOL used[SHADOW_CLIENT_CLEAR_MAX_COLORS * 2] = { 0 };
+
+	for (y = 0; y < nHeight; y++)
+	{
+		const UINT32* line = (const UINT32*)&pSrcData[1ull * y * nSrcStep];
+		UINT32 last = 0;
+
+		for (x = 0; x < nWidth; x++)
+		{
+			/* The alpha/padding byte does not matter for the output */
+			const UINT32 color = line[x] & 0x00FFFFFF;
+			UINT32 slot;
+
+			if ((x > 0) && (color == last))
+				continue;
+
+			last = color;
+			slot = ((color * 2654435761U) >> 16) % ARRAYSIZE(table);
+
+			while (used[slot] && (table[slot] != color))
+				slot = (slot + 1) % ARRAYSIZE(table);
+
+			if (used[slot])
+				continue;
+
+			if (++colors > SHADOW_CLIENT_CLEAR_MAX_COLORS)
+				return FALSE;
+
+			used[slot] = TRUE;
+			table[slot] = color;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Splits rect into the tiles for ClearCodec and the area left for the other codec.
+ */
+static BOOL shadow_client_classify_clear(const BYTE* pSrcData, UINT32 nSrcStep, UINT32 SrcFormat,
+                                         const RECTANGLE_16* rect, REGION16* clearRegion,
+                                         REGION16* codecRegion)
+{
+	UINT32 x, y;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(SrcFormat);
+
+	/* Only 32 bit sources are classified, anything else stays with ClearCodec */
+	if (bpp != 4)
+		return region16_union_rect(clearRegion, clearRegion, rect);
+
+	for (y = rect->top - rect->top % SHADOW_CLIENT_CLEAR_TILE_SIZE; y < rect->bottom;
+	     y += SHADOW_CLIENT_CLEAR_TILE_SIZE)
+	{
+		for (x = rect->left - rect->left % SHADOW_CLIENT_CLEAR_TILE_SIZE; x < rect->right;
+		     x += SHADOW_CLIENT_CLEAR_TILE_SIZE)
+		{
+			RECTANGLE_16 tile;
+			REGION16* target;
+
+			tile.left = (UINT16)MAX(x, rect->left);
+			tile.top = (UINT16)MAX(y, rect->top);
+			tile.right = (UINT16)MIN(x + SHADOW_CLIENT_CLEAR_TILE_SIZE, rect->right);
+			tile.bottom = (UINT16)MIN(y + SHADOW_CLIENT_CLEAR_TILE_SIZE, rect->bottom);
+
+			if (shadow_client_is_clear_tile(
+			        &pSrcData[1ull * tile.top * nSrcStep + 1ull * tile.left * bpp], nSrcStep,
+			        tile.right - tile.left, tile.bottom - tile.top))
+				target = clearRegion;
+			else
+				target = codecRegion;
+
+			if (!region16_union_rect(target, target, &tile))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * RemoteFX and progressive messages carry their rectangles relative to the
+ * command origin, the shadow server always sends them in frame coordinates.
+ */
+static void shadow_client_surface_command_frame(RDPGFX_SURFACE_COMMAND* cmd, UINT32 frameWidth,
+                                                UINT32 frameHeight)
+{
+	cmd->left = 0;
+	cmd->top = 0;
+	cmd->right = frameWidth;
+	cmd->bottom = frameHeight;
+	cmd->width = frameWidth;
+	cmd->height = frameHeight;
+}
+
+/**
+ * Sends the rectangles of region as ClearCodec surface commands. *ppStart is
+ * sent with the first command and cleared, the last one carries end.
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_send_surface_clear(rdpShadowClient* client, const BYTE* pSrcData,
+                                             UINT32 nSrcStep, UINT32 SrcFormat,
+                                             const RDPGFX_SURFACE_COMMAND* base,
+                                             const REGION16* region,
+                                             const RDPGFX_START_FRAME_PDU** ppStart,
+                                             const RDPGFX_END_FRAME_PDU* end)
+{
+	UINT32 x;
+	UINT32 numRects = 0;
+	rdpShadowEncoder* encoder = client->encoder;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(SrcFormat);
+	const RECTANGLE_16* rects = region16_rects(region, &numRects);
+
+	if (shadow_encoder_prepare(encoder, FREERDP_CODEC_CLEARCODEC) < 0)
+	{
+		WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_CLEARCODEC");
+		return FALSE;
+	}
+
+	for (x = 0; x < numRects; x++)
+	{
+		INT32 rc;
+		UINT error = CHANNEL_RC_OK;
+		RDPGFX_SURFACE_COMMAND cmd = *base;
+		const RECTANGLE_16* rect = &rects[x];
+		const UINT32 width = rect->right - rect->left;
+		const UINT32 height = rect->bottom - rect->top;
+		const BYTE* src = &pSrcData[1ull * rect->top * nSrcStep + 1ull * rect->left * bpp];
+
+		rc = clear_compress(encoder->clear, src, nSrcStep * (height - 1) + width * bpp,
+		                    SrcFormat, width, height, nSrcStep, &cmd.data, &cmd.length);
+		if (rc < 0)
+		{
+			WLog_ERR(TAG, "clear_compress failed");
+			return FALSE;
+		}
+
+		cmd.codecId = RDPGFX_CODECID_CLEARCODEC;
+		cmd.left = rect->left;
+		cmd.top = rect->top;
+		cmd.right = rect->right;
+		cmd.bottom = rect->bottom;
+		cmd.width = width;
+		cmd.height = height;
+
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, *ppStart,
+		          (x + 1 == numRects) ? end : NULL);
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+
+		*ppStart = NULL;
+	}
+
+	return TRUE;
+}
+
+typedef struct
+{
+	const rdpSettings* settings;
+	const BYTE* pSrcData;
+	UINT32 nSrcStep;
+	UINT32 SrcFormat;
+	const REGION16* region;
+	UINT16 nXSrc;
+	UINT16 nYSrc;
+	UINT16 nWidth;
+	UINT16 nHeight;
+} SHADOW_SURFACE_BITS_ARGS;
+
+static BOOL shadow_client_encode_rfx(RFX_CONTEXT* rfx, const SHADOW_SURFACE_BITS_ARGS* args,
+                                     SHADOW_ENCODED_FRAME* frame)
+{
+	size_t i;
+	BOOL ret = TRUE;
+	UINT32 index;
+	size_t numMessages = 0;
+	UINT32 numRects = 0;
+	const rdpSettings* settings = args->settings;
+	const RECTANGLE_16* rects = region16_rects(args->region, &numRects);
+	const RECTANGLE_16* extents = region16_extents(args->region);
+	RFX_RECT* rfxRects;
+	RFX_MESSAGE* messages;
+	RFX_RECT* messageRects = NULL;
+
+	if (!(rfxRects = (RFX_RECT*)calloc(MAX(numRects, 1), sizeof(RFX_RECT))))
+		return FALSE;
+
+	/* Encode only the damaged rectangles instead of their bounding box */
+	for (index = 0; index < numRects; index++)
+	{
+		rfxRects[index].x = rects[index].left - extents->left + args->nXSrc;
+		rfxRects[index].y = rects[index].top - extents->top + args->nYSrc;
+		rfxRects[index].width = rects[index].right - rects[index].left;
+		rfxRects[index].height = rects[index].bottom - rects[index].top;
+	}
+
+	if (numRects == 0)
+	{
+		rfxRects[0].x = args->nXSrc;
+		rfxRects[0].y = args->nYSrc;
+		rfxRects[0].width = args->nWidth;
+		rfxRects[0].height = args->nHeight;
+		numRects = 1;
+	}
+
+	messages = rfx_encode_messages(rfx, rfxRects, numRects, args->pSrcData,
+	                               settings->DesktopWidth, settings->DesktopHeight, args->nSrcStep,
+	                               &numMessages, settings->MultifragMaxRequestSize);
+	free(rfxRects);
+
+	if (!messages)
+	{
+		WLog_ERR(TAG, "rfx_encode_messages failed");
+		return FALSE;
+	}
+
+	if (numMessages > 0)
+		messageRects = messages[0].rects;
+
+	for (i = 0; i < numMessages; i++)
+	{
+		wStream* s = ret ? Stream_New(NULL, 1024) : NULL;
+
+		if (ret && (!s || !rfx_write_message(rfx, s, &messages[i]) ||
+		            !shadow_encoded_frame_add_packet(frame, s)))
+		{
+			WLog_ERR(TAG, "rfx_write_message failed");
+			Stream_Free(s, TRUE);
+			ret = FALSE;
+		}
+
+		rfx_message_free(rfx, &messages[i]);
+	}
+
+	free(messageRects);
+	free(messages);
+	return ret;
+}
+
+static BOOL shadow_client_encode_nsc(NSC_CONTEXT* nsc, const SHADOW_SURFACE_BITS_ARGS* args,
+                                     SHADOW_ENCODED_FRAME* frame)
+{
+	const BYTE* pSrcData = &args->pSrcData[(args->nYSrc * args->nSrcStep) + (args->nXSrc * 4)];
+	wStream* s = Stream_New(NULL, 1024);
+
+	if (!s)
+		return FALSE;
+
+	if (!nsc_compose_message(nsc, s, pSrcData, args->nWidth, args->nHeight, args->nSrcStep) ||
+	    !shadow_encoded_frame_add_packet(frame, s))
+	{
+		Stream_Free(s, TRUE);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Graphics pipeline RemoteFX, a single message with a rectangle per region rectangle */
+static BOOL shadow_client_encode_rfx_gfx(RFX_CONTEXT* rfx, const SHADOW_SURFACE_BITS_ARGS* args,
+                                         SHADOW_ENCODED_FRAME* frame)
+{
+	UINT32 x;
+	BOOL rc;
+	wStream* s;
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = region16_rects(args->region, &numRects);
+	RFX_RECT* rfxRects = (RFX_RECT*)calloc(MAX(numRects, 1), sizeof(RFX_RECT));
+
+	if (!rfxRects)
+		return FALSE;
+
+	for (x = 0; x < numRects; x++)
+	{
+		rfxRects[x].x = rects[x].left;
+		rfxRects[x].y = rects[x].top;
+		rfxRects[x].width = rects[x].right - rects[x].left;
+		rfxRects[x].height = rects[x].bottom - rects[x].top;
+	}
+
+	s = Stream_New(NULL, 1024);
+	rc = s && rfx_compose_message(rfx, s, rfxRects, numRects, args->pSrcData,
+	                              args->settings->DesktopWidth, args->settings->DesktopHeight,
+	                              args->nSrcStep);
+	free(rfxRects);
+
+	if (!rc || !shadow_encoded_frame_add_packet(frame, s))
+	{
+		WLog_ERR(TAG, "rfx_compose_message failed");
+		Stream_Free(s, TRUE);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL shadow_client_encode_planar(BITMAP_PLANAR_CONTEXT* planar,
+                                        const SHADOW_SURFACE_BITS_ARGS* args,
+                                        SHADOW_ENCODED_FRAME* frame)
+{
+	BYTE* data;
+	wStream* s;
+	UINT32 length = 0;
+	const BYTE* src = &args->pSrcData[args->nYSrc * args->nSrcStep +
+	                                  args->nXSrc * FreeRDPGetBytesPerPixel(args->SrcFormat)];
+
+	if (!freerdp_bitmap_planar_context_reset(planar, args->nWidth, args->nHeight))
+		return FALSE;
+
+	freerdp_planar_topdown_image(planar, TRUE);
+	data = freerdp_bitmap_compress_planar(planar, src, args->SrcFormat, args->nWidth,
+	                                      args->nHeight, args->nSrcStep, NULL, &length);
+
+	if (!data || !(s = Stream_New(data, length)))
+	{
+		free(data);
+		return FALSE;
+	}
+
+	Stream_SetPosition(s, length);
+
+	if (!shadow_encoded_frame_add_packet(frame, s))
+	{
+		Stream_Free(s, TRUE);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL shadow_client_encode_group(rdpShadowEncoderGroup* group, void* arg,
+                                       SHADOW_ENCODED_FRAME* frame)
+{
+	const SHADOW_SURFACE_BITS_ARGS* args = (const SHADOW_SURFACE_BITS_ARGS*)arg;
+
+	switch (group->key.codec)
+	{
+		case FREERDP_CODEC_REMOTEFX:
+			if (group->key.gfx)
+				return shadow_client_encode_rfx_gfx(group->rfx, args, frame);
+
+			return shadow_client_encode_rfx(group->rfx, args, frame);
+
+		case FREERDP_CODEC_NSCODEC:
+			return shadow_client_encode_nsc(group->nsc, args, frame);
+
+		case FREERDP_CODEC_PLANAR:
+			return shadow_client_encode_planar(group->planar, args, frame);
+
+		default:
+			return FALSE;
+	}
+}
+
+/**
+ * Encodes the surface bits for codec. The frame is taken from the encoder group
+ * shared with all clients using the same codec parameters, if that is not possible
+ * it is encoded with the client's own encoder.
+ * If the client still needs the RemoteFX headers they are written to the encoder's
+ * bitstream buffer.
+ *
+ * @return the encoded frame, release with shadow_encoded_frame_release
+ */
+static SHADOW_ENCODED_FRAME* shadow_client_encode_surface_bits(rdpShadowClient* client,
+                                                               UINT32 codec,
+                                                               const SHADOW_SURFACE_BITS_ARGS* args)
+{
+	BOOL rc = FALSE;
+	rdpShadowServer* server = client->server;
+	rdpShadowEncoder* encoder = client->encoder;
+	const rdpSettings* settings = args->settings;
+	SHADOW_ENCODED_FRAME* frame = NULL;
+	const UINT64 generation = server->surface->generation;
+
+	Stream_SetPosition(encoder->bs, 0);
+
+	if (!client->inLobby)
+	{
+		SHADOW_ENCODER_GROUP_KEY key = { 0 };
+		rdpShadowEncoderGroup* group;
+
+		key.codec = codec;
+		key.width = settings->DesktopWidth;
+		key.height = settings->DesktopHeight;
+
+		if (codec == FREERDP_CODEC_REMOTEFX)
+			key.maxPacketSize = settings->MultifragMaxRequestSize;
+		else
+		{
+			key.colorLossLevel = settings->NSCodecColorLossLevel;
+			key.allowSubsampling = settings->NSCodecAllowSubsampling;
+			key.allowDynamicColorFidelity = settings->NSCodecAllowDynamicColorFidelity;
+		}
+
+		group = shadow_encoder_group_acquire(server, &key, generation);
+
+		if (group)
+		{
+			frame = shadow_encoder_group_encode(group, generation, args->region,
+			                                    shadow_client_encode_group, (void*)args);
+
+			if (frame && (codec == FREERDP_CODEC_REMOTEFX) && !encoder->rfxHeaderSent)
+			{
+				const size_t length = Stream_GetPosition(group->rfxHeader);
+
+				if (!Stream_EnsureRemainingCapacity(encoder->bs, length))
+				{
+					shadow_encoded_frame_release(frame);
+					frame = NULL;
+				}
+				else
+				{
+					Stream_Write(encoder->bs, Stream_Buffer(group->rfxHeader), length);
+					encoder->rfxHeaderSent = TRUE;
+				}
+			}
+
+			shadow_encoder_group_release(server, group);
+		}
+	}
+
+	if (frame)
+		return frame;
+
+	/* Per client fallback */
+	if (shadow_encoder_prepare(encoder, codec) < 0)
+	{
+		WLog_ERR(TAG, "Failed to prepare encoder 0x%08" PRIx32, codec);
+		return NULL;
+	}
+
+	if (!(frame = shadow_encoded_frame_new(generation, args->region)))
+		return NULL;
+
+	if (codec == FREERDP_CODEC_REMOTEFX)
+		rc = shadow_client_encode_rfx(encoder->rfx, args, frame);
+	else
+		rc = shadow_client_encode_nsc(encoder->nsc, args, frame);
+
+	if (!rc)
+	{
+		shadow_encoded_frame_release(frame);
+		return NULL;
+	}
+
+	return frame;
+}
+
+/**
+ * Encodes a graphics pipeline surface command with RemoteFX or planar. Like
+ * shadow_client_encode_surface_bits the frame is taken from the encoder group if
+ * possible, otherwise it is encoded with the client's own encoder.
+ * The RemoteFX headers are prepended to the first message after each reset of the
+ * client's encoder, the shared frames never contain them.
+ *
+ * @return the encoded frame, release with shadow_encoded_frame_release
+ */
+static SHADOW_ENCODED_FRAME* shadow_client_encode_gfx(rdpShadowClient* client, UINT32 codec,
+                                                      const SHADOW_SURFACE_BITS_ARGS* args)
+{
+	BOOL rc;
+	rdpShadowServer* server = client->server;
+	rdpShadowEncoder* encoder = client->encoder;
+	const rdpSettings* settings = args->settings;
+	SHADOW_ENCODED_FRAME* frame = NULL;
+	const UINT64 generation = server->surface->generation;
+
+	if (shadow_encoder_prepare(encoder, codec) < 0)
+	{
+		WLog_ERR(TAG, "Failed to prepare encoder 0x%08" PRIx32, codec);
+		return NULL;
+	}
+
+	if (!client->inLobby)
+	{
+		SHADOW_ENCODER_GROUP_KEY key = { 0 };
+		rdpShadowEncoderGroup* group;
+
+		key.codec = codec;
+		key.gfx = TRUE;
+		key.width = settings->DesktopWidth;
+		key.height = settings->DesktopHeight;
+
+		if (codec == FREERDP_CODEC_PLANAR)
+			key.allowSkipAlpha = settings->DrawAllowSkipAlpha;
+
+		group = shadow_encoder_group_acquire(server, &key, generation);
+
+		if (group)
+		{
+			frame = shadow_encoder_group_encode(group, generation, args->region,
+			                                    shadow_client_encode_group, (void*)args);
+			shadow_encoder_group_release(server, group);
+		}
+	}
+
+	if (frame && (codec == FREERDP_CODEC_REMOTEFX) &&
+	    (encoder->rfx->state == RFX_STATE_SEND_HEADERS))
+	{
+		wStream* s = frame->packets[0];
+		wStream* packet = Stream_New(NULL, 64 + Stream_GetPosition(s));
+		SHADOW_ENCODED_FRAME* copy = shadow_encoded_frame_new(generation, args->region);
+
+		rc = packet && copy && rfx_write_message_header(encoder->rfx, packet) &&
+		     Stream_EnsureRemainingCapacity(packet, Stream_GetPosition(s));
+
+		if (rc)
+		{
+			Stream_Write(packet, Stream_Buffer(s), Stream_GetPosition(s));
+			rc = shadow_encoded_frame_add_packet(copy, packet);
+		}
+
+		shadow_encoded_frame_release(frame);
+		frame = NULL;
+
+		if (!rc)
+		{
+			Stream_Free(packet, TRUE);
+			shadow_encoded_frame_release(copy);
+			return NULL;
+		}
+
+		encoder->rfx->state = RFX_STATE_SEND_FRAME_DATA;
+		frame = copy;
+	}
+
+	if (frame)
+		return frame;
+
+	/* Per client fallback */
+	if (!(frame = shadow_encoded_frame_new(generation, args->region)))
+		return NULL;
+
+	if (codec == FREERDP_CODEC_REMOTEFX)
+		rc = shadow_client_encode_rfx_gfx(encoder->rfx, args, frame);
+	else
+		rc = shadow_client_encode_planar(encoder->planar, args, frame);
+
+	if (!rc)
+	{
+		shadow_encoded_frame_release(frame);
+		return NULL;
+	}
+
+	return frame;
+}
+
 /**
  * Function description
  *
@@ -990,6 +1668,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
                                            UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight)
 {
 	UINT32 id;
+	BOOL ret = FALSE;
 	UINT error = CHANNEL_RC_OK;
 	const rdpContext* context = (const rdpContext*)client;
 	const rdpSettings* settings;
@@ -997,7 +1676,13 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	RDPGFX_SURFACE_COMMAND cmd = { 0 };
 	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
 	RDPGFX_END_FRAME_PDU cmdend = { 0 };
+	const RDPGFX_START_FRAME_PDU* pStart = &cmdstart;
+	const RDPGFX_END_FRAME_PDU* pEnd = &cmdend;
 	SYSTEMTIME sTime = { 0 };
+	RECTANGLE_16 cmdRect;
+	REGION16 clearRegion;
+	REGION16 codecRegion;
+	UINT32 frameWidth, frameHeight;
 
 	if (!context || !pSrcData)
 		return FALSE;
@@ -1008,6 +1693,10 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	if (!settings || !encoder)
 		return FALSE;
 
+	/* Partial updates are placed in the full frame buffer */
+	frameWidth = settings->DesktopWidth;
+	frameHeight = settings->DesktopHeight;
+
 	if (client->first_frame)
 	{
 		rfx_context_reset(encoder->rfx, nWidth, nHeight);
@@ -1029,7 +1718,55 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	cmd.height = nHeight;
 
 	id = freerdp_settings_get_uint32(settings, FreeRDP_RemoteFxCodecId);
-	if (settings->GfxAVC444 || settings->GfxAVC444v2)
+	cmdRect.left = nXSrc;
+	cmdRect.top = nYSrc;
+	cmdRect.right = (UINT16)(nXSrc + nWidth);
+	cmdRect.bottom = (UINT16)(nYSrc + nHeight);
+	region16_init(&clearRegion);
+	region16_init(&codecRegion);
+
+	/* With H.264 the whole frame is encoded anyway. Otherwise text and UI tiles go to
+	 * ClearCodec and the configured codec only encodes the rest, if there is none
+	 * ClearCodec takes everything. */
+	if (!settings->GfxAVC444 && !settings->GfxAVC444v2 && !settings->GfxH264 &&
+	    freerdp_settings_get_bool(settings, FreeRDP_GfxClearCodec))
+	{
+		BOOL classified;
+
+		if ((freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (id != 0)) ||
+		    freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive) ||
+		    freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar))
+			classified = shadow_client_classify_clear(pSrcData, nSrcStep, SrcFormat, &cmdRect,
+			                                          &clearRegion, &codecRegion);
+		else
+			classified = region16_union_rect(&clearRegion, &clearRegion, &cmdRect);
+
+		if (!classified)
+			goto fail;
+	}
+	else if (!region16_union_rect(&codecRegion, &codecRegion, &cmdRect))
+		goto fail;
+
+	if (!region16_is_empty(&clearRegion))
+		pEnd = NULL;
+
+	if (!region16_is_empty(&codecRegion))
+	{
+		/* Codecs that take a single rectangle cover the extents of the rest */
+		const RECTANGLE_16* extents = region16_extents(&codecRegion);
+		cmd.left = extents->left;
+		cmd.top = extents->top;
+		cmd.right = extents->right;
+		cmd.bottom = extents->bottom;
+		cmd.width = cmd.right - cmd.left;
+		cmd.height = cmd.bottom - cmd.top;
+	}
+
+	if (region16_is_empty(&codecRegion))
+	{
+		/* Everything is sent with ClearCodec below */
+	}
+	else if (settings->GfxAVC444 || settings->GfxAVC444v2)
 	{
 		INT32 rc;
 		RDPGFX_AVC444_BITMAP_STREAM avc444 = { 0 };
@@ -1039,7 +1776,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC444) < 0)
 		{
 			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC444");
-			return FALSE;
+			goto fail;
 		}
 
 		WINPR_ASSERT(cmd.left <= UINT16_MAX);
@@ -1058,7 +1795,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		if (rc < 0)
 		{
 			WLog_ERR(TAG, "avc420_compress failed for avc444");
-			return FALSE;
+			goto fail;
 		}
 
 		/* rc > 0 means new data */
@@ -1067,6 +1804,8 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			avc444.cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444.bitstream[0]);
 			cmd.codecId = settings->GfxAVC444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
 			cmd.extra = (void*)&avc444;
+			shadow_client_autodetect_begin(client, 1ull * avc444.bitstream[0].length +
+			                                           avc444.bitstream[1].length);
 			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
 			          &cmdend);
 		}
@@ -1076,7 +1815,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			goto fail;
 		}
 	}
 	else if (settings->GfxH264)
@@ -1088,7 +1827,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC420) < 0)
 		{
 			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC420");
-			return FALSE;
+			goto fail;
 		}
 
 		WINPR_ASSERT(cmd.left <= UINT16_MAX);
@@ -1104,7 +1843,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		if (rc < 0)
 		{
 			WLog_ERR(TAG, "avc420_compress failed");
-			return FALSE;
+			goto fail;
 		}
 
 		/* rc > 0 means new data */
@@ -1112,6 +1851,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		{
 			cmd.codecId = RDPGFX_CODECID_AVC420;
 			cmd.extra = (void*)&avc420;
+			shadow_client_autodetect_begin(client, avc420.length);
 
 			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
 			          &cmdend);
@@ -1121,92 +1861,60 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			goto fail;
 		}
 	}
 	else if (freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (id != 0))
 	{
-		BOOL rc;
-		wStream* s;
-		RFX_RECT rect;
-
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_REMOTEFX");
-			return FALSE;
-		}
+		SHADOW_ENCODED_FRAME* frame;
+		SHADOW_SURFACE_BITS_ARGS args = { 0 };
+		size_t pos;
 
-		s = Stream_New(NULL, 1024);
-		WINPR_ASSERT(s);
+		args.settings = settings;
+		args.pSrcData = pSrcData;
+		args.nSrcStep = nSrcStep;
+		args.SrcFormat = SrcFormat;
+		args.region = &codecRegion;
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		rect.x = (UINT16)cmd.left;
-		rect.y = (UINT16)cmd.top;
-		rect.width = (UINT16)cmd.right - cmd.left;
-		rect.height = (UINT16)cmd.bottom - cmd.top;
-
-		rc = rfx_compose_message(encoder->rfx, s, &rect, 1, pSrcData, nWidth, nHeight, nSrcStep);
-
-		if (!rc)
-		{
-			WLog_ERR(TAG, "rfx_compose_message failed");
-			Stream_Free(s, TRUE);
-			return FALSE;
-		}
+		if (!(frame = shadow_client_encode_gfx(client, FREERDP_CODEC_REMOTEFX, &args)))
+			goto fail;
 
-		/* rc > 0 means new data */
-		if (rc > 0)
-		{
-			const size_t pos = Stream_GetPosition(s);
-			WINPR_ASSERT(pos <= UINT32_MAX);
+		shadow_client_surface_command_frame(&cmd, frameWidth, frameHeight);
+		pos = Stream_GetPosition(frame->packets[0]);
+		WINPR_ASSERT(pos <= UINT32_MAX);
 
-			cmd.codecId = RDPGFX_CODECID_CAVIDEO;
-			cmd.data = Stream_Buffer(s);
-			cmd.length = (UINT32)pos;
+		cmd.codecId = RDPGFX_CODECID_CAVIDEO;
+		cmd.data = Stream_Buffer(frame->packets[0]);
+		cmd.length = (UINT32)pos;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
-		}
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, pStart, pEnd);
+		pStart = NULL;
+		shadow_encoded_frame_release(frame);
 
-		Stream_Free(s, TRUE);
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			goto fail;
 		}
 	}
 	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
 	{
 		INT32 rc;
-		REGION16 region;
-		RECTANGLE_16 regionRect;
 
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PROGRESSIVE) < 0)
 		{
 			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PROGRESSIVE");
-			return FALSE;
+			goto fail;
 		}
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		regionRect.left = (UINT16)cmd.left;
-		regionRect.top = (UINT16)cmd.top;
-		regionRect.right = (UINT16)cmd.right;
-		regionRect.bottom = (UINT16)cmd.bottom;
-		region16_init(&region);
-		region16_union_rect(&region, &region, &regionRect);
-		rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * nHeight, cmd.format,
-		                          nWidth, nHeight, nSrcStep, &region, &cmd.data, &cmd.length);
-		region16_uninit(&region);
+		rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * frameHeight,
+		                          cmd.format, frameWidth, frameHeight, nSrcStep, &codecRegion,
+		                          &cmd.data, &cmd.length);
+		shadow_client_surface_command_frame(&cmd, frameWidth, frameHeight);
 		if (rc < 0)
 		{
 			WLog_ERR(TAG, "progressive_compress failed");
-			return FALSE;
+			goto fail;
 		}
 
 		/* rc > 0 means new data */
@@ -1214,46 +1922,62 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		{
 			cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, pStart,
+			          pEnd);
+			pStart = NULL;
 		}
 
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			goto fail;
 		}
 	}
 	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar))
 	{
-		BOOL rc;
-		const UINT32 w = cmd.right - cmd.left;
-		const UINT32 h = cmd.bottom - cmd.top;
-		const BYTE* src =
-		    &pSrcData[cmd.top * nSrcStep + cmd.left * FreeRDPGetBytesPerPixel(SrcFormat)];
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PLANAR) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PLANAR");
-			return FALSE;
-		}
-
-		rc = freerdp_bitmap_planar_context_reset(encoder->planar, w, h);
-		WINPR_ASSERT(rc);
-		freerdp_planar_topdown_image(encoder->planar, TRUE);
-
-		cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, w, h, nSrcStep,
-		                                          NULL, &cmd.length);
-		WINPR_ASSERT(cmd.data || (cmd.length == 0));
+		SHADOW_ENCODED_FRAME* frame;
+		SHADOW_SURFACE_BITS_ARGS args = { 0 };
+		REGION16 planarRegion;
+		RECTANGLE_16 planarRect;
+
+		/* The region identifies the shared frame, planar encodes the extents */
+		planarRect.left = (UINT16)cmd.left;
+		planarRect.top = (UINT16)cmd.top;
+		planarRect.right = (UINT16)cmd.right;
+		planarRect.bottom = (UINT16)cmd.bottom;
+		region16_init(&planarRegion);
+
+		args.settings = settings;
+		args.pSrcData = pSrcData;
+		args.nSrcStep = nSrcStep;
+		args.SrcFormat = SrcFormat;
+		args.region = &planarRegion;
+		args.nXSrc = planarRect.left;
+		args.nYSrc = planarRect.top;
+		args.nWidth = planarRect.right - planarRect.left;
+		args.nHeight = planarRect.bottom - planarRect.top;
+
+		frame = region16_union_rect(&planarRegion, &planarRegion, &planarRect)
+		            ? shadow_client_encode_gfx(client, FREERDP_CODEC_PLANAR, &args)
+		            : NULL;
+		region16_uninit(&planarRegion);
+
+		if (!frame)
+			goto fail;
 
 		cmd.codecId = RDPGFX_CODECID_PLANAR;
+		cmd.data = Stream_Buffer(frame->packets[0]);
+		cmd.length = (UINT32)Stream_GetPosition(frame->packets[0]);
+
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, pStart,
+		          pEnd);
+		pStart = NULL;
+		shadow_encoded_frame_release(frame);
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
-		free(cmd.data);
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			goto fail;
 		}
 	}
 	else
@@ -1274,16 +1998,28 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		cmd.length = length;
 		cmd.codecId = RDPGFX_CODECID_UNCOMPRESSED;
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, pStart,
+		          pEnd);
+		pStart = NULL;
 		free(data);
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			goto fail;
 		}
 	}
-	return TRUE;
+
+	/* The lossless tiles go last so they are not painted over */
+	if (!region16_is_empty(&clearRegion) &&
+	    !shadow_client_send_surface_clear(client, pSrcData, nSrcStep, SrcFormat, &cmd,
+	                                      &clearRegion, &pStart, &cmdend))
+		goto fail;
+
+	ret = TRUE;
+fail:
+	region16_uninit(&clearRegion);
+	region16_uninit(&codecRegion);
+	return ret;
 }
 
 /**
@@ -1292,21 +2028,22 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
  * @return TRUE on success
  */
 static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcData,
-                                            UINT32 nSrcStep, UINT16 nXSrc, UINT16 nYSrc,
-                                            UINT16 nWidth, UINT16 nHeight)
+                                            UINT32 nSrcStep, const REGION16* region, UINT16 nXSrc,
+                                            UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight)
 {
 	BOOL ret = TRUE;
 	size_t i;
 	BOOL first;
 	BOOL last;
 	wStream* s;
-	size_t numMessages;
 	UINT32 frameId = 0;
 	rdpUpdate* update;
 	rdpContext* context = (rdpContext*)client;
 	rdpSettings* settings;
 	rdpShadowEncoder* encoder;
 	SURFACE_BITS_COMMAND cmd = { 0 };
+	SHADOW_SURFACE_BITS_ARGS args = { 0 };
+	SHADOW_ENCODED_FRAME* frame;
 	UINT32 nsID, rfxID;
 
 	if (!context || !pSrcData)
@@ -1322,33 +2059,21 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 	if (encoder->frameAck)
 		frameId = shadow_encoder_create_frame_id(encoder);
 
+	args.settings = settings;
+	args.pSrcData = pSrcData;
+	args.nSrcStep = nSrcStep;
+	args.region = region;
+	args.nXSrc = nXSrc;
+	args.nYSrc = nYSrc;
+	args.nWidth = nWidth;
+	args.nHeight = nHeight;
+
 	nsID = freerdp_settings_get_uint32(settings, FreeRDP_NSCodecId);
 	rfxID = freerdp_settings_get_uint32(settings, FreeRDP_RemoteFxCodecId);
 	if (freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (rfxID != 0))
 	{
-		RFX_RECT rect;
-		RFX_MESSAGE* messages;
-		RFX_RECT* messageRects = NULL;
-
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_REMOTEFX");
+		if (!(frame = shadow_client_encode_surface_bits(client, FREERDP_CODEC_REMOTEFX, &args)))
 			return FALSE;
-		}
-
-		s = encoder->bs;
-		rect.x = nXSrc;
-		rect.y = nYSrc;
-		rect.width = nWidth;
-		rect.height = nHeight;
-
-		if (!(messages = rfx_encode_messages(
-		          encoder->rfx, &rect, 1, pSrcData, settings->DesktopWidth, settings->DesktopHeight,
-		          nSrcStep, &numMessages, settings->MultifragMaxRequestSize)))
-		{
-			WLog_ERR(TAG, "rfx_encode_messages failed");
-			return FALSE;
-		}
 
 		cmd.cmdType = CMDTYPE_STREAM_SURFACE_BITS;
 		WINPR_ASSERT(rfxID <= UINT16_MAX);
@@ -1365,31 +2090,30 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		cmd.bmp.height = (UINT16)settings->DesktopHeight;
 		cmd.skipCompression = TRUE;
 
-		if (numMessages > 0)
-			messageRects = messages[0].rects;
-
-		for (i = 0; i < numMessages; i++)
+		for (i = 0; i < frame->count; i++)
 		{
-			Stream_SetPosition(s, 0);
+			s = frame->packets[i];
 
-			if (!rfx_write_message(encoder->rfx, s, &messages[i]))
+			/* The first message to a client is preceded by the RemoteFX headers */
+			if (Stream_GetPosition(encoder->bs) > 0)
 			{
-				while (i < numMessages)
+				const size_t length = Stream_GetPosition(s);
+
+				if (!Stream_EnsureRemainingCapacity(encoder->bs, length))
 				{
-					rfx_message_free(encoder->rfx, &messages[i++]);
+					ret = FALSE;
+					break;
 				}
 
-				WLog_ERR(TAG, "rfx_write_message failed");
-				ret = FALSE;
-				break;
+				Stream_Write(encoder->bs, Stream_Buffer(s), length);
+				s = encoder->bs;
 			}
 
-			rfx_message_free(encoder->rfx, &messages[i]);
 			WINPR_ASSERT(Stream_GetPosition(s) <= UINT32_MAX);
 			cmd.bmp.bitmapDataLength = (UINT32)Stream_GetPosition(s);
 			cmd.bmp.bitmapData = Stream_Buffer(s);
 			first = (i == 0) ? TRUE : FALSE;
-			last = ((i + 1) == numMessages) ? TRUE : FALSE;
+			last = ((i + 1) == frame->count) ? TRUE : FALSE;
 
 			if (!encoder->frameAck)
 				IFCALLRET(update->SurfaceBits, ret, update->context, &cmd);
@@ -1397,6 +2121,8 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 				IFCALLRET(update->SurfaceFrameBits, ret, update->context, &cmd, first, last,
 				          frameId);
 
+			Stream_SetPosition(encoder->bs, 0);
+
 			if (!ret)
 			{
 				WLog_ERR(TAG, "Send surface bits(RemoteFxCodec) failed");
@@ -1404,21 +2130,15 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 			}
 		}
 
-		free(messageRects);
-		free(messages);
+		shadow_encoded_frame_release(frame);
 	}
 	if (freerdp_settings_get_bool(settings, FreeRDP_NSCodec) && (nsID != 0))
 	{
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_NSCODEC) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_NSCODEC");
+		if (!(frame = shadow_client_encode_surface_bits(client, FREERDP_CODEC_NSCODEC, &args)))
 			return FALSE;
-		}
 
-		s = encoder->bs;
-		Stream_SetPosition(s, 0);
-		pSrcData = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
-		nsc_compose_message(encoder->nsc, s, pSrcData, nWidth, nHeight, nSrcStep);
+		WINPR_ASSERT(frame->count == 1);
+		s = frame->packets[0];
 		cmd.cmdType = CMDTYPE_SET_SURFACE_BITS;
 		cmd.bmp.bpp = 32;
 		WINPR_ASSERT(nsID <= UINT16_MAX);
@@ -1444,6 +2164,8 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		{
 			WLog_ERR(TAG, "Send surface bits(NSCodec) failed");
 		}
+
+		shadow_encoded_frame_release(frame);
 	}
 
 	return ret;
@@ -1669,12 +2391,41 @@ out:
 	return ret;
 }
 
+static BOOL shadow_client_progressive_pending(rdpShadowClient* client, SHADOW_GFX_STATUS* pStatus)
+{
+	rdpSettings* settings;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pStatus);
+	settings = ((rdpContext*)client)->settings;
+	WINPR_ASSERT(settings);
+	encoder = client->encoder;
+
+	if (!settings->SupportGraphicsPipeline || !pStatus->gfxOpened ||
+	    !pStatus->gfxSurfaceCreated)
+		return FALSE;
+
+	if (!encoder || !encoder->progressive ||
+	    !freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
+		return FALSE;
+
+	/* Only send upgrades when the client keeps up with the frames already sent */
+	if (shadow_encoder_inflight_frames(encoder) > 0)
+		return FALSE;
+
+	return progressive_compress_pending(encoder->progressive);
+}
+
 /**
  * Function description
+ * With upgradeOnly set there is no new frame, only progressive upgrade passes for the
+ * frame already sent (and regions the client asked for) are encoded.
  *
  * @return TRUE on success (or nothing need to be updated)
  */
-static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GFX_STATUS* pStatus)
+static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GFX_STATUS* pStatus,
+                                              BOOL upgradeOnly)
 {
 	BOOL ret = TRUE;
 	INT64 nXSrc, nYSrc;
@@ -1686,11 +2437,15 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	REGION16 invalidRegion;
 	RECTANGLE_16 surfaceRect;
 	const RECTANGLE_16* extents;
+	const REGION16* surfaceRegion;
 	BYTE* pSrcData;
 	UINT32 nSrcStep, SrcFormat;
 	UINT32 index;
 	UINT32 numRects = 0;
 	const RECTANGLE_16* rects;
+	UINT32 surfaceWidth, surfaceHeight;
+	BOOL locked = FALSE;
+	UINT64 start = 0;
 
 	if (!context || !pStatus)
 		return FALSE;
@@ -1712,18 +2467,54 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	region16_clear(&(client->invalidRegion));
 	LeaveCriticalSection(&(client->lock));
 
-	EnterCriticalSection(&surface->lock);
-	rects = region16_rects(&(surface->invalidRegion), &numRects);
+	if (client->inLobby || upgradeOnly)
+	{
+		/* The lobby is drawn in place and the published frame only stays unchanged while
+		 * the update event is set, keep it locked while encoding */
+		EnterCriticalSection(&surface->lock);
+		locked = TRUE;
+	}
 
-	for (index = 0; index < numRects; index++)
-		region16_union_rect(&invalidRegion, &invalidRegion, &rects[index]);
+	if (client->inLobby)
+	{
+		surfaceRegion = &(surface->invalidRegion);
+		surfaceWidth = surface->width;
+		surfaceHeight = surface->height;
+		pSrcData = surface->data;
+		nSrcStep = surface->scanline;
+	}
+	else
+	{
+		/*
+		 * The published frame does not change until every client consumed the
+		 * update event, so it is read without the surface lock while the
+		 * subsystem captures the next frame into surface->data.
+		 */
+		surfaceRegion = &(surface->frameRegion);
+		surfaceWidth = surface->frameWidth;
+		surfaceHeight = surface->frameHeight;
+		pSrcData = surface->frameData;
+		nSrcStep = surface->frameScanline;
+
+		if (!pSrcData)
+			goto out;
+	}
+
+	/* The damage of the published frame was sent with it */
+	if (!upgradeOnly)
+	{
+		rects = region16_rects(surfaceRegion, &numRects);
+
+		for (index = 0; index < numRects; index++)
+			region16_union_rect(&invalidRegion, &invalidRegion, &rects[index]);
+	}
 
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
-	WINPR_ASSERT(surface->width <= UINT16_MAX);
-	WINPR_ASSERT(surface->height <= UINT16_MAX);
-	surfaceRect.right = (UINT16)surface->width;
-	surfaceRect.bottom = (UINT16)surface->height;
+	WINPR_ASSERT(surfaceWidth <= UINT16_MAX);
+	WINPR_ASSERT(surfaceHeight <= UINT16_MAX);
+	surfaceRect.right = (UINT16)surfaceWidth;
+	surfaceRect.bottom = (UINT16)surfaceHeight;
 	region16_intersect_rect(&invalidRegion, &invalidRegion, &surfaceRect);
 
 	if (server->shareSubRect)
@@ -1733,8 +2524,22 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 
 	if (region16_is_empty(&invalidRegion))
 	{
-		/* No image region need to be updated. Success */
-		goto out;
+		/* Use idle frames to stream progressive upgrade passes for static tiles */
+		if (!shadow_client_progressive_pending(client, pStatus))
+		{
+			/* No image region need to be updated. Success */
+			goto out;
+		}
+
+		region16_union_rect(&invalidRegion, &invalidRegion, &surfaceRect);
+
+		if (server->shareSubRect)
+		{
+			region16_intersect_rect(&invalidRegion, &invalidRegion, &(server->subRect));
+		}
+
+		if (region16_is_empty(&invalidRegion))
+			goto out;
 	}
 
 	extents = region16_extents(&invalidRegion);
@@ -1742,9 +2547,8 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	nYSrc = extents->top;
 	nWidth = extents->right - extents->left;
 	nHeight = extents->bottom - extents->top;
-	pSrcData = surface->data;
-	nSrcStep = surface->scanline;
 	SrcFormat = surface->format;
+	start = GetTickCount64();
 
 	/* Move to new pSrcData / nXSrc / nYSrc according to sub rect */
 	if (server->shareSubRect)
@@ -1766,9 +2570,18 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 
 	if (settings->SupportGraphicsPipeline && pStatus->gfxOpened)
 	{
-		/* GFX/h264 always full screen encoded */
-		nWidth = settings->DesktopWidth;
-		nHeight = settings->DesktopHeight;
+		/* GFX/h264 always full screen encoded, ClearCodec only needs the damaged area */
+		const BOOL fullScreen = settings->GfxH264 || settings->GfxAVC444 ||
+		                        settings->GfxAVC444v2 || !pStatus->gfxSurfaceCreated ||
+		                        !freerdp_settings_get_bool(settings, FreeRDP_GfxClearCodec);
+
+		if (fullScreen)
+		{
+			nXSrc = 0;
+			nYSrc = 0;
+			nWidth = settings->DesktopWidth;
+			nHeight = settings->DesktopHeight;
+		}
 
 		/* Create primary surface if have not */
 		if (!pStatus->gfxSurfaceCreated)
@@ -1787,8 +2600,12 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 		WINPR_ASSERT(nWidth <= UINT16_MAX);
 		WINPR_ASSERT(nHeight >= 0);
 		WINPR_ASSERT(nHeight <= UINT16_MAX);
-		ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, 0, 0,
-		                                     (UINT16)nWidth, (UINT16)nHeight);
+		WINPR_ASSERT(nXSrc >= 0);
+		WINPR_ASSERT(nXSrc <= UINT16_MAX);
+		WINPR_ASSERT(nYSrc >= 0);
+		WINPR_ASSERT(nYSrc <= UINT16_MAX);
+		ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, (UINT16)nXSrc,
+		                                     (UINT16)nYSrc, (UINT16)nWidth, (UINT16)nHeight);
 	}
 	else if (settings->RemoteFxCodec || freerdp_settings_get_bool(settings, FreeRDP_NSCodec))
 	{
@@ -1800,8 +2617,9 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 		WINPR_ASSERT(nWidth <= UINT16_MAX);
 		WINPR_ASSERT(nHeight >= 0);
 		WINPR_ASSERT(nHeight <= UINT16_MAX);
-		ret = shadow_client_send_surface_bits(client, pSrcData, nSrcStep, (UINT16)nXSrc,
-		                                      (UINT16)nYSrc, (UINT16)nWidth, (UINT16)nHeight);
+		ret = shadow_client_send_surface_bits(client, pSrcData, nSrcStep, &invalidRegion,
+		                                      (UINT16)nXSrc, (UINT16)nYSrc, (UINT16)nWidth,
+		                                      (UINT16)nHeight);
 	}
 	else
 	{
@@ -1818,7 +2636,17 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	}
 
 out:
-	LeaveCriticalSection(&surface->lock);
+	if (locked)
+		LeaveCriticalSection(&surface->lock);
+	else if (start > 0)
+	{
+		const UINT64 elapsed = GetTickCount64() - start;
+
+		EnterCriticalSection(&surface->lock);
+		surface->stats.encodeMs += elapsed;
+		LeaveCriticalSection(&surface->lock);
+	}
+
 	region16_uninit(&invalidRegion);
 	return ret;
 }
@@ -1906,13 +2734,14 @@ static INLINE BOOL shadow_client_no_surface_update(rdpShadowClient* client,
                                                    SHADOW_GFX_STATUS* pStatus)
 {
 	rdpShadowServer* server;
-	rdpShadowSurface* surface;
 	WINPR_UNUSED(pStatus);
 	WINPR_ASSERT(client);
 	server = client->server;
 	WINPR_ASSERT(server);
-	surface = client->inLobby ? server->lobby : server->surface;
-	return shadow_client_surface_update(client, &(surface->invalidRegion));
+	if (client->inLobby)
+		return shadow_client_surface_update(client, &(server->lobby->invalidRegion));
+
+	return shadow_client_surface_update(client, &(server->surface->frameRegion));
 }
 
 static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMessage* message)
@@ -2034,6 +2863,7 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	BOOL rc;
 	DWORD status;
 	DWORD nCount;
+	DWORD timeout;
 	wMessage message;
 	wMessage pointerPositionMsg;
 	wMessage pointerAlphaMsg;
@@ -2051,6 +2881,7 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	/* This should only be visited in client thread */
 	SHADOW_GFX_STATUS gfxstatus = { 0 };
 	rdpUpdate* update;
+	UINT64 nextUpgrade = 0;
 
 	WINPR_ASSERT(client);
 
@@ -2122,20 +2953,47 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 		}
 		events[nCount++] = ChannelEvent;
 		events[nCount++] = MessageQueue_Event(MsgQueue);
-		status = WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+		timeout = INFINITE;
+
+		/* No update event comes for a static desktop, wake up for the upgrade passes */
+		if (client->activated && !client->suppressOutput &&
+		    shadow_client_progressive_pending(client, &gfxstatus))
+		{
+			const UINT64 now = GetTickCount64();
+
+			if (nextUpgrade == 0)
+				nextUpgrade = now + SHADOW_CLIENT_UPGRADE_INTERVAL;
+
+			timeout = (nextUpgrade > now) ? (DWORD)(nextUpgrade - now) : 0;
+		}
+		else
+			nextUpgrade = 0;
+
+		status = WaitForMultipleObjects(nCount, events, FALSE, timeout);
 
 		if (status == WAIT_FAILED)
 			goto fail;
 
+		if ((nextUpgrade > 0) && (GetTickCount64() >= nextUpgrade) &&
+		    (WaitForSingleObject(UpdateEvent, 0) != WAIT_OBJECT_0))
+		{
+			nextUpgrade = 0;
+
+			if (!shadow_client_send_surface_update(client, &gfxstatus, TRUE))
+			{
+				WLog_ERR(TAG, "Failed to send progressive upgrade");
+				break;
+			}
+		}
+
 		if (WaitForSingleObject(UpdateEvent, 0) == WAIT_OBJECT_0)
 		{
 			/* The UpdateEvent means to start sending current frame. It is
-			 * triggered from subsystem implementation and it should ensure
-			 * that the screen and primary surface meta data (width, height,
-			 * scanline, invalid region, etc) is not changed until it is reset
-			 * (at shadow_multiclient_consume). As best practice, subsystem
-			 * implementation should invoke shadow_subsystem_frame_update which
-			 * triggers the event and then wait for completion */
+			 * triggered from shadow_subsystem_frame_update which publishes a
+			 * copy of the primary surface (frameData, frameRegion, etc). The
+			 * published frame is not changed until the event is reset
+			 * (at shadow_multiclient_consume), the subsystem may capture the
+			 * next frame meanwhile */
 			if (client->activated && !client->suppressOutput)
 			{
 				/* Send screen update or resize to this client */
@@ -2153,7 +3011,7 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 				else
 				{
 					/* Send frame */
-					if (!shadow_client_send_surface_update(client, &gfxstatus))
+					if (!shadow_client_send_surface_update(client, &gfxstatus, FALSE))
 					{
 						WLog_ERR(TAG, "Failed to send surface update");
 						break;
@@ -2247,6 +3105,9 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 				WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
 				goto fail;
 			}
+
+			/* The measured frame has been sent now */
+			shadow_client_autodetect_end(client);
 		}
 
 		if (WaitForSingleObject(MessageQueue_Event(MsgQueue), 0) == WAIT_OBJECT_0)
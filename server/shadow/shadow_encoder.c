@@ -19,6 +19,7 @@
 #include <freerdp/config.h>
 
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include "shadow.h"
 
@@ -27,6 +28,18 @@
 #include <freerdp/log.h>
 #define TAG CLIENT_TAG("shadow")
 
+/* Minimum time between two bit rate / quality adjustments in ms */
+#define SHADOW_RATE_CONTROL_INTERVAL 250
+
+/* Acknowledge latency on top of the network round trip that counts as congestion in ms */
+#define SHADOW_RATE_CONTROL_LATENCY_BUDGET 150
+
+/* Frames queued on the client (RDPGFX queueDepth) that count as congestion */
+#define SHADOW_RATE_CONTROL_MAX_QUEUE_DEPTH 2
+
+#define SHADOW_RATE_CONTROL_MIN_BITRATE 256000
+#define SHADOW_RATE_CONTROL_MAX_QP 40
+
 UINT32 shadow_encoder_preferred_fps(rdpShadowEncoder* encoder)
 {
 	/* Return preferred fps calculated according to the last
@@ -49,10 +62,41 @@ UINT32 shadow_encoder_inflight_frames(rdpShadowEncoder* encoder)
 	           : encoder->frameId - encoder->lastAckframeId;
 }
 
-UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
+static void shadow_encoder_rate_control_reset(rdpShadowEncoder* encoder)
 {
-	UINT32 frameId;
-	UINT32 inFlightFrames = shadow_encoder_inflight_frames(encoder);
+	SHADOW_RATE_CONTROL* rc = &encoder->rateControl;
+	const UINT32 rtt = rc->rtt;
+	const UINT32 bandwidth = rc->bandwidth;
+
+	/* The network characteristics outlive an encoder reset */
+	ZeroMemory(rc, sizeof(SHADOW_RATE_CONTROL));
+	rc->rtt = rtt;
+	rc->bandwidth = bandwidth;
+	rc->bitRate = encoder->server->h264BitRate;
+	rc->qp = encoder->server->h264QP;
+}
+
+/**
+ * Frames are considered congested if the client does not keep up (frames in
+ * flight or queued on the client) or acknowledges them much later than the
+ * network round trip. Congestion reduces the frame rate, bit rate and (in
+ * constant QP mode) quality multiplicatively, otherwise they recover additively
+ * up to the configured values.
+ */
+static void shadow_encoder_rate_control(rdpShadowEncoder* encoder)
+{
+	BOOL congested;
+	SHADOW_RATE_CONTROL* rc = &encoder->rateControl;
+	const UINT64 now = GetTickCount64();
+	const UINT32 inFlightFrames = shadow_encoder_inflight_frames(encoder);
+	const UINT32 maxBitRate = encoder->server->h264BitRate;
+	const UINT32 minQP = encoder->server->h264QP;
+	const BOOL cqp = encoder->server->h264RateControlMode == H264_RATECONTROL_CQP;
+
+	congested = (inFlightFrames > 1) ||
+	            (rc->latency > rc->rtt + SHADOW_RATE_CONTROL_LATENCY_BUDGET) ||
+	            ((encoder->queueDepth != SUSPEND_FRAME_ACKNOWLEDGEMENT) &&
+	             (encoder->queueDepth > SHADOW_RATE_CONTROL_MAX_QUEUE_DEPTH));
 
 	/*
 	 * Calculate preferred fps according to how much frames are
@@ -63,6 +107,10 @@ UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
 	{
 		encoder->fps = (100 / (inFlightFrames + 1) * encoder->maxFps) / 100;
 	}
+	else if (congested)
+	{
+		encoder->fps = encoder->fps * 3 / 4;
+	}
 	else
 	{
 		encoder->fps += 2;
@@ -74,10 +122,103 @@ UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
 	if (encoder->fps < 1)
 		encoder->fps = 1;
 
+	/* Give the encoder time to follow the last change */
+	if (now - rc->lastUpdate >= SHADOW_RATE_CONTROL_INTERVAL)
+	{
+		const UINT32 bitRate = rc->bitRate;
+		const UINT32 qp = rc->qp;
+
+		rc->lastUpdate = now;
+
+		if (congested)
+		{
+			rc->bitRate = rc->bitRate / 4 * 3;
+
+			/* When congested the measured bandwidth is what the link really carries */
+			if ((rc->bandwidth > 0) && (rc->bandwidth < UINT32_MAX / 1000))
+				rc->bitRate = MIN(rc->bitRate, rc->bandwidth / 10 * 9 * 1000);
+
+			rc->bitRate = MAX(rc->bitRate, MIN(maxBitRate, SHADOW_RATE_CONTROL_MIN_BITRATE));
+
+			if (cqp)
+				rc->qp = MIN(rc->qp + 4, MAX(minQP, SHADOW_RATE_CONTROL_MAX_QP));
+		}
+		else
+		{
+			rc->bitRate = MIN(maxBitRate, rc->bitRate + maxBitRate / 16);
+
+			if (rc->qp > minQP)
+				rc->qp--;
+		}
+
+		if ((rc->bitRate != bitRate) || (rc->qp != qp))
+			WLog_DBG(TAG,
+			         "%s: bitrate %" PRIu32 ", qp %" PRIu32 ", fps %" PRIu32
+			         " (latency %" PRIu32 "ms, rtt %" PRIu32 "ms, bandwidth %" PRIu32
+			         "kbit/s, in flight %" PRIu32 ", queue %" PRIu32 ")",
+			         congested ? "congested" : "recovering", rc->bitRate, rc->qp, encoder->fps,
+			         rc->latency, rc->rtt, rc->bandwidth, inFlightFrames, encoder->queueDepth);
+	}
+
+	if (encoder->h264)
+	{
+		encoder->h264->BitRate = rc->bitRate;
+		encoder->h264->QP = rc->qp;
+		encoder->h264->FrameRate = MIN(encoder->server->h264FrameRate, encoder->fps);
+	}
+}
+
+UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
+{
+	UINT32 frameId;
+
+	shadow_encoder_rate_control(encoder);
+
 	frameId = ++encoder->frameId;
+	encoder->rateControl.sentTime[frameId % SHADOW_RATE_CONTROL_HISTORY] = GetTickCount64();
 	return frameId;
 }
 
+void shadow_encoder_frame_acknowledged(rdpShadowEncoder* encoder, UINT32 frameId,
+                                       UINT32 queueDepth)
+{
+	SHADOW_RATE_CONTROL* rc;
+	UINT64* sentTime;
+
+	WINPR_ASSERT(encoder);
+
+	rc = &encoder->rateControl;
+	encoder->lastAckframeId = frameId;
+	encoder->queueDepth = queueDepth;
+
+	/* Frames older than the history were overwritten by newer ones */
+	if ((frameId > encoder->frameId) || (encoder->frameId - frameId >= SHADOW_RATE_CONTROL_HISTORY))
+		return;
+
+	sentTime = &rc->sentTime[frameId % SHADOW_RATE_CONTROL_HISTORY];
+
+	if (*sentTime > 0)
+	{
+		const UINT64 latency = GetTickCount64() - *sentTime;
+		const UINT32 sample = (UINT32)MIN(latency, UINT32_MAX / 4);
+
+		rc->latency = (rc->latency > 0) ? (rc->latency * 3 + sample) / 4 : sample;
+		*sentTime = 0;
+	}
+}
+
+void shadow_encoder_network_characteristics(rdpShadowEncoder* encoder, UINT32 rtt,
+                                            UINT32 bandwidth)
+{
+	WINPR_ASSERT(encoder);
+
+	if (rtt > 0)
+		encoder->rateControl.rtt = rtt;
+
+	if (bandwidth > 0)
+		encoder->rateControl.bandwidth = bandwidth;
+}
+
 static int shadow_encoder_init_grid(rdpShadowEncoder* encoder)
 {
 	UINT32 i, j, k;
@@ -155,7 +296,7 @@ static int shadow_encoder_init_nsc(rdpShadowEncoder* encoder)
 	rdpSettings* settings = context->settings;
 
 	if (!encoder->nsc)
-		encoder->nsc = nsc_context_new();
+		encoder->nsc = nsc_context_new_ex(encoder->server->settings->ThreadingFlags);
 
 	if (!encoder->nsc)
 		goto fail;
@@ -272,12 +413,33 @@ fail:
 	return -1;
 }
 
+static int shadow_encoder_init_clear(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	if (!encoder->clear)
+		encoder->clear = clear_context_new(TRUE);
+
+	if (!encoder->clear)
+		goto fail;
+
+	if (!clear_context_reset(encoder->clear))
+		goto fail;
+
+	encoder->codecs |= FREERDP_CODEC_CLEARCODEC;
+	return 1;
+fail:
+	clear_context_free(encoder->clear);
+	encoder->clear = NULL;
+	return -1;
+}
+
 static int shadow_encoder_init(rdpShadowEncoder* encoder)
 {
 	encoder->width = encoder->server->screen->width;
 	encoder->height = encoder->server->screen->height;
 	encoder->maxTileWidth = 64;
 	encoder->maxTileHeight = 64;
+	encoder->rfxHeaderSent = FALSE;
 	shadow_encoder_init_grid(encoder);
 
 	if (!encoder->bs)
@@ -362,6 +524,19 @@ static int shadow_encoder_uninit_progressive(rdpShadowEncoder* encoder)
 	return 1;
 }
 
+static int shadow_encoder_uninit_clear(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	if (encoder->clear)
+	{
+		clear_context_free(encoder->clear);
+		encoder->clear = NULL;
+	}
+
+	encoder->codecs &= (UINT32)~FREERDP_CODEC_CLEARCODEC;
+	return 1;
+}
+
 static int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 {
 	shadow_encoder_uninit_grid(encoder);
@@ -383,6 +558,8 @@ static int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 
 	    shadow_encoder_uninit_progressive(encoder);
 
+	    shadow_encoder_uninit_clear(encoder);
+
 	    return 1;
 }
 
@@ -412,6 +589,7 @@ int shadow_encoder_reset(rdpShadowEncoder* encoder)
 	encoder->frameId = 0;
 	encoder->lastAckframeId = 0;
 	encoder->frameAck = settings->SurfaceFrameMarkerEnabled;
+	shadow_encoder_rate_control_reset(encoder);
 	return 1;
 }
 
@@ -474,6 +652,15 @@ int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs)
 			return -1;
 	}
 
+	if ((codecs & FREERDP_CODEC_CLEARCODEC) && !(encoder->codecs & FREERDP_CODEC_CLEARCODEC))
+	{
+		WLog_DBG(TAG, "initializing ClearCodec encoder");
+		status = shadow_encoder_init_clear(encoder);
+
+		if (status < 0)
+			return -1;
+	}
+
 	return 1;
 }
 
@@ -490,6 +677,7 @@ rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client)
 	encoder->server = server;
 	encoder->fps = 16;
 	encoder->maxFps = 32;
+	shadow_encoder_rate_control_reset(encoder);
 
 	if (shadow_encoder_init(encoder) < 0)
 	{
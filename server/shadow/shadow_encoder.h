@@ -27,6 +27,26 @@
 
 #include <freerdp/server/shadow.h>
 
+/* Send times of this many frames are kept to measure the acknowledge latency */
+#define SHADOW_RATE_CONTROL_HISTORY 32
+
+typedef struct
+{
+	UINT64 sentTime[SHADOW_RATE_CONTROL_HISTORY]; /* indexed by frameId */
+	UINT32 latency;   /* smoothed frame acknowledge latency in ms */
+	UINT32 rtt;       /* last autodetect round trip time in ms, 0 if unknown */
+	UINT32 bandwidth; /* last autodetect bandwidth in kbit/s, 0 if unknown */
+	UINT32 bitRate;
+	UINT32 qp;
+	UINT64 lastUpdate;
+
+	/* autodetect probes sent by the client thread */
+	UINT16 sequenceNumber;
+	BOOL bandwidthPending;
+	UINT64 lastRttRequest;
+	UINT64 lastBandwidthRequest;
+} SHADOW_RATE_CONTROL;
+
 struct rdp_shadow_encoder
 {
 	rdpShadowClient* client;
@@ -51,6 +71,7 @@ struct rdp_shadow_encoder
 	BITMAP_INTERLEAVED_CONTEXT* interleaved;
 	H264_CONTEXT* h264;
 	PROGRESSIVE_CONTEXT* progressive;
+	CLEAR_CONTEXT* clear;
 
 	UINT32 fps;
 	UINT32 maxFps;
@@ -58,6 +79,10 @@ struct rdp_shadow_encoder
 	UINT32 frameId;
 	UINT32 lastAckframeId;
 	UINT32 queueDepth;
+	SHADOW_RATE_CONTROL rateControl;
+
+	/* shared RemoteFX frames carry no headers, they are sent once per client */
+	BOOL rfxHeaderSent;
 };
 
 #ifdef __cplusplus
@@ -68,6 +93,10 @@ extern "C"
 	int shadow_encoder_reset(rdpShadowEncoder* encoder);
 	int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs);
 	UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder);
+	void shadow_encoder_frame_acknowledged(rdpShadowEncoder* encoder, UINT32 frameId,
+	                                       UINT32 queueDepth);
+	void shadow_encoder_network_characteristics(rdpShadowEncoder* encoder, UINT32 rtt,
+	                                            UINT32 bandwidth);
 
 	rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client);
 	void shadow_encoder_free(rdpShadowEncoder* encoder);
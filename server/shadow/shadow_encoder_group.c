@@ -0,0 +1,349 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/log.h>
+
+#include "shadow_encoder_group.h"
+
+#define TAG SERVER_TAG("shadow.encoder")
+
+/* Groups nobody used for this many frames are freed */
+#define SHADOW_ENCODER_GROUP_MAX_IDLE_FRAMES 64
+
+SHADOW_ENCODED_FRAME* shadow_encoded_frame_new(UINT64 generation, const REGION16* region)
+{
+	SHADOW_ENCODED_FRAME* frame = (SHADOW_ENCODED_FRAME*)calloc(1, sizeof(SHADOW_ENCODED_FRAME));
+
+	if (!frame)
+		return NULL;
+
+	frame->refs = 1;
+	frame->generation = generation;
+	region16_init(&frame->region);
+
+	if (region && !region16_copy(&frame->region, region))
+	{
+		shadow_encoded_frame_release(frame);
+		return NULL;
+	}
+
+	return frame;
+}
+
+BOOL shadow_encoded_frame_add_packet(SHADOW_ENCODED_FRAME* frame, wStream* s)
+{
+	wStream** tmp;
+
+	WINPR_ASSERT(frame);
+	WINPR_ASSERT(s);
+
+	tmp = (wStream**)realloc(frame->packets, (frame->count + 1) * sizeof(wStream*));
+
+	if (!tmp)
+		return FALSE;
+
+	frame->packets = tmp;
+	frame->packets[frame->count++] = s;
+	return TRUE;
+}
+
+void shadow_encoded_frame_release(SHADOW_ENCODED_FRAME* frame)
+{
+	size_t index;
+
+	if (!frame)
+		return;
+
+	if (InterlockedDecrement(&frame->refs) > 0)
+		return;
+
+	for (index = 0; index < frame->count; index++)
+		Stream_Free(frame->packets[index], TRUE);
+
+	free(frame->packets);
+	region16_uninit(&frame->region);
+	free(frame);
+}
+
+static BOOL shadow_encoder_group_region_equal(const REGION16* a, const REGION16* b)
+{
+	UINT32 numA = 0;
+	UINT32 numB = 0;
+	const RECTANGLE_16* rectsA = region16_rects(a, &numA);
+	const RECTANGLE_16* rectsB = region16_rects(b, &numB);
+
+	if (numA != numB)
+		return FALSE;
+
+	if (numA == 0)
+		return TRUE;
+
+	return memcmp(rectsA, rectsB, numA * sizeof(RECTANGLE_16)) == 0;
+}
+
+static void shadow_encoder_group_free(void* obj)
+{
+	rdpShadowEncoderGroup* group = (rdpShadowEncoderGroup*)obj;
+
+	if (!group)
+		return;
+
+	shadow_encoded_frame_release(group->frame);
+	rfx_context_free(group->rfx);
+	nsc_context_free(group->nsc);
+	freerdp_bitmap_planar_context_free(group->planar);
+	Stream_Free(group->rfxHeader, TRUE);
+	DeleteCriticalSection(&group->lock);
+	free(group);
+}
+
+static BOOL shadow_encoder_group_init_rfx(rdpShadowServer* server, rdpShadowEncoderGroup* group)
+{
+	if (!(group->rfx = rfx_context_new_ex(TRUE, server->settings->ThreadingFlags)))
+		return FALSE;
+
+	if (!rfx_context_reset(group->rfx, group->key.width, group->key.height))
+		return FALSE;
+
+	group->rfx->mode = server->rfxMode;
+	rfx_context_set_pixel_format(group->rfx, PIXEL_FORMAT_BGRX32);
+
+	/* The headers are sent once per client, the shared frames never contain them */
+	if (!(group->rfxHeader = Stream_New(NULL, 64)))
+		return FALSE;
+
+	if (!rfx_write_message_header(group->rfx, group->rfxHeader))
+		return FALSE;
+
+	group->rfx->state = RFX_STATE_SEND_FRAME_DATA;
+	return TRUE;
+}
+
+static BOOL shadow_encoder_group_init_nsc(rdpShadowServer* server, rdpShadowEncoderGroup* group)
+{
+	if (!(group->nsc = nsc_context_new_ex(server->settings->ThreadingFlags)))
+		return FALSE;
+
+	if (!nsc_context_reset(group->nsc, group->key.width, group->key.height))
+		return FALSE;
+
+	if (!nsc_context_set_parameters(group->nsc, NSC_COLOR_LOSS_LEVEL, group->key.colorLossLevel))
+		return FALSE;
+
+	if (!nsc_context_set_parameters(group->nsc, NSC_ALLOW_SUBSAMPLING,
+	                                (UINT32)group->key.allowSubsampling))
+		return FALSE;
+
+	if (!nsc_context_set_parameters(group->nsc, NSC_DYNAMIC_COLOR_FIDELITY,
+	                                (UINT32)group->key.allowDynamicColorFidelity))
+		return FALSE;
+
+	return nsc_context_set_parameters(group->nsc, NSC_COLOR_FORMAT, PIXEL_FORMAT_BGRX32);
+}
+
+static BOOL shadow_encoder_group_init_planar(rdpShadowEncoderGroup* group)
+{
+	DWORD planarFlags = PLANAR_FORMAT_HEADER_RLE;
+
+	if (group->key.allowSkipAlpha)
+		planarFlags |= PLANAR_FORMAT_HEADER_NA;
+
+	/* reset to the size of each frame before it is encoded */
+	group->planar = freerdp_bitmap_planar_context_new(planarFlags, 64, 64);
+	return group->planar != NULL;
+}
+
+static rdpShadowEncoderGroup* shadow_encoder_group_new(rdpShadowServer* server,
+                                                       const SHADOW_ENCODER_GROUP_KEY* key)
+{
+	BOOL rc = FALSE;
+	rdpShadowEncoderGroup* group =
+	    (rdpShadowEncoderGroup*)calloc(1, sizeof(rdpShadowEncoderGroup));
+
+	if (!group)
+		return NULL;
+
+	group->key = *key;
+
+	if (!InitializeCriticalSectionAndSpinCount(&group->lock, 4000))
+	{
+		free(group);
+		return NULL;
+	}
+
+	switch (key->codec)
+	{
+		case FREERDP_CODEC_REMOTEFX:
+			rc = shadow_encoder_group_init_rfx(server, group);
+			break;
+
+		case FREERDP_CODEC_NSCODEC:
+			rc = shadow_encoder_group_init_nsc(server, group);
+			break;
+
+		case FREERDP_CODEC_PLANAR:
+			rc = shadow_encoder_group_init_planar(group);
+			break;
+
+		default:
+			break;
+	}
+
+	if (!rc)
+	{
+		WLog_ERR(TAG, "Failed to create shared encoder for codec 0x%08" PRIx32, key->codec);
+		shadow_encoder_group_free(group);
+		return NULL;
+	}
+
+	return group;
+}
+
+wArrayList* shadow_encoder_groups_new(void)
+{
+	wObject* obj;
+	wArrayList* groups = ArrayList_New(TRUE);
+
+	if (!groups)
+		return NULL;
+
+	obj = ArrayList_Object(groups);
+	obj->fnObjectFree = shadow_encoder_group_free;
+	return groups;
+}
+
+void shadow_encoder_groups_free(wArrayList* groups)
+{
+	ArrayList_Free(groups);
+}
+
+rdpShadowEncoderGroup* shadow_encoder_group_acquire(rdpShadowServer* server,
+                                                    const SHADOW_ENCODER_GROUP_KEY* key,
+                                                    UINT64 generation)
+{
+	size_t index;
+	rdpShadowEncoderGroup* found = NULL;
+
+	WINPR_ASSERT(server);
+	WINPR_ASSERT(key);
+
+	if (!server->encoderGroups)
+		return NULL;
+
+	ArrayList_Lock(server->encoderGroups);
+
+	for (index = ArrayList_Count(server->encoderGroups); index > 0; index--)
+	{
+		rdpShadowEncoderGroup* group =
+		    (rdpShadowEncoderGroup*)ArrayList_GetItem(server->encoderGroups, index - 1);
+
+		if (memcmp(&group->key, key, sizeof(SHADOW_ENCODER_GROUP_KEY)) == 0)
+		{
+			found = group;
+			continue;
+		}
+
+		/* Drop groups left behind by resized or disconnected clients */
+		if ((group->users == 0) &&
+		    (group->lastUsed + SHADOW_ENCODER_GROUP_MAX_IDLE_FRAMES < generation))
+			ArrayList_RemoveAt(server->encoderGroups, index - 1);
+	}
+
+	if (!found)
+	{
+		found = shadow_encoder_group_new(server, key);
+
+		if (found && !ArrayList_Append(server->encoderGroups, found))
+		{
+			shadow_encoder_group_free(found);
+			found = NULL;
+		}
+	}
+
+	if (found)
+	{
+		found->users++;
+
+		if (found->lastUsed < generation)
+			found->lastUsed = generation;
+	}
+
+	ArrayList_Unlock(server->encoderGroups);
+	return found;
+}
+
+void shadow_encoder_group_release(rdpShadowServer* server, rdpShadowEncoderGroup* group)
+{
+	WINPR_ASSERT(server);
+
+	if (!group)
+		return;
+
+	ArrayList_Lock(server->encoderGroups);
+	WINPR_ASSERT(group->users > 0);
+	group->users--;
+	ArrayList_Unlock(server->encoderGroups);
+}
+
+SHADOW_ENCODED_FRAME* shadow_encoder_group_encode(rdpShadowEncoderGroup* group,
+                                                  UINT64 generation, const REGION16* region,
+                                                  pfnShadowEncoderGroupEncode fkt, void* arg)
+{
+	SHADOW_ENCODED_FRAME* frame;
+
+	WINPR_ASSERT(group);
+	WINPR_ASSERT(region);
+	WINPR_ASSERT(fkt);
+
+	EnterCriticalSection(&group->lock);
+	frame = group->frame;
+
+	if (frame && (frame->generation == generation))
+	{
+		/* A client with extra damage (e.g. a refresh request) encodes on its own */
+		if (shadow_encoder_group_region_equal(&frame->region, region))
+			InterlockedIncrement(&frame->refs);
+		else
+			frame = NULL;
+
+		goto out;
+	}
+
+	shadow_encoded_frame_release(group->frame);
+	group->frame = NULL;
+
+	if (!(frame = shadow_encoded_frame_new(generation, region)))
+		goto out;
+
+	if (!fkt(group, arg, frame))
+	{
+		shadow_encoded_frame_release(frame);
+		frame = NULL;
+		goto out;
+	}
+
+	/* one reference for the cache, one for the caller */
+	InterlockedIncrement(&frame->refs);
+	group->frame = frame;
+out:
+	LeaveCriticalSection(&group->lock);
+	return frame;
+}
@@ -0,0 +1,109 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_ENCODER_GROUP_H
+#define FREERDP_SERVER_SHADOW_ENCODER_GROUP_H
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/stream.h>
+#include <winpr/collections.h>
+
+#include <freerdp/codecs.h>
+#include <freerdp/codec/region.h>
+
+#include <freerdp/server/shadow.h>
+
+/*
+ * Clients watching the same surface with identical codec parameters share an
+ * encoder group. The first client to reach a frame encodes it, all other clients
+ * of the group send the cached bitstream.
+ * Only codecs without per client bitstream state (RemoteFX, NSCodec and planar)
+ * are shared. H.264, progressive and ClearCodec depend on what the client already
+ * received and are encoded per client.
+ */
+
+typedef struct rdp_shadow_encoder_group rdpShadowEncoderGroup;
+
+/* Everything that changes the bitstream produced for a frame */
+typedef struct
+{
+	UINT32 codec; /* FREERDP_CODEC_REMOTEFX, FREERDP_CODEC_NSCODEC or FREERDP_CODEC_PLANAR */
+	BOOL gfx;     /* graphics pipeline surface command instead of surface bits */
+	UINT32 width;
+	UINT32 height;
+	UINT32 maxPacketSize;
+	UINT32 colorLossLevel;
+	BOOL allowSubsampling;
+	BOOL allowDynamicColorFidelity;
+	BOOL allowSkipAlpha;
+} SHADOW_ENCODER_GROUP_KEY;
+
+typedef struct
+{
+	volatile LONG refs;
+	UINT64 generation;
+	REGION16 region;
+	size_t count;
+	wStream** packets;
+} SHADOW_ENCODED_FRAME;
+
+struct rdp_shadow_encoder_group
+{
+	SHADOW_ENCODER_GROUP_KEY key;
+	CRITICAL_SECTION lock;
+
+	/* protected by the group list lock */
+	size_t users;
+	UINT64 lastUsed;
+
+	RFX_CONTEXT* rfx;
+	NSC_CONTEXT* nsc;
+	BITMAP_PLANAR_CONTEXT* planar;
+	wStream* rfxHeader;
+
+	SHADOW_ENCODED_FRAME* frame;
+};
+
+typedef BOOL (*pfnShadowEncoderGroupEncode)(rdpShadowEncoderGroup* group, void* arg,
+                                            SHADOW_ENCODED_FRAME* frame);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	wArrayList* shadow_encoder_groups_new(void);
+	void shadow_encoder_groups_free(wArrayList* groups);
+
+	rdpShadowEncoderGroup* shadow_encoder_group_acquire(rdpShadowServer* server,
+	                                                    const SHADOW_ENCODER_GROUP_KEY* key,
+	                                                    UINT64 generation);
+	void shadow_encoder_group_release(rdpShadowServer* server, rdpShadowEncoderGroup* group);
+
+	SHADOW_ENCODED_FRAME* shadow_encoder_group_encode(rdpShadowEncoderGroup* group,
+	                                                  UINT64 generation, const REGION16* region,
+	                                                  pfnShadowEncoderGroupEncode fkt, void* arg);
+
+	SHADOW_ENCODED_FRAME* shadow_encoded_frame_new(UINT64 generation, const REGION16* region);
+	BOOL shadow_encoded_frame_add_packet(SHADOW_ENCODED_FRAME* frame, wStream* s);
+	void shadow_encoded_frame_release(SHADOW_ENCODED_FRAME* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_ENCODER_GROUP_H */
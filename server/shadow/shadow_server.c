@@ -346,6 +346,18 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 		{
 			settings->ExtSecurity = arg->Value ? TRUE : FALSE;
 		}
+		CommandLineSwitchCase(arg, "tls-kernel-offload")
+		{
+			settings->TlsKernelOffload = arg->Value ? TRUE : FALSE;
+		}
+		CommandLineSwitchCase(arg, "compression-adaptive")
+		{
+			settings->CompressionAdaptive = arg->Value ? TRUE : FALSE;
+		}
+		CommandLineSwitchCase(arg, "dvc-compression")
+		{
+			settings->DynamicChannelCompression = arg->Value ? TRUE : FALSE;
+		}
 		CommandLineSwitchCase(arg, "sam-file")
 		{
 			freerdp_settings_set_string(settings, FreeRDP_NtlmSamFile, arg->Value);
@@ -379,6 +391,12 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxPlanar, arg->Value ? TRUE : FALSE))
 				return COMMAND_LINE_ERROR;
 		}
+		CommandLineSwitchCase(arg, "gfx-clear")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxClearCodec,
+			                               arg->Value ? TRUE : FALSE))
+				return COMMAND_LINE_ERROR;
+		}
 		CommandLineSwitchCase(arg, "gfx-avc420")
 		{
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxH264, arg->Value ? TRUE : FALSE))
@@ -809,6 +827,9 @@ int shadow_server_init(rdpShadowServer* server)
 	if (!(server->clients = ArrayList_New(TRUE)))
 		goto fail_client_array;
 
+	if (!(server->encoderGroups = shadow_encoder_groups_new()))
+		goto fail_encoder_groups;
+
 	if (!(server->StopEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
 		goto fail_stop_event;
 
@@ -860,6 +881,9 @@ fail_server_lock:
 	CloseHandle(server->StopEvent);
 	server->StopEvent = NULL;
 fail_stop_event:
+	shadow_encoder_groups_free(server->encoderGroups);
+	server->encoderGroups = NULL;
+fail_encoder_groups:
 	ArrayList_Free(server->clients);
 	server->clients = NULL;
 fail_client_array:
@@ -888,6 +912,8 @@ int shadow_server_uninit(rdpShadowServer* server)
 	server->StopEvent = NULL;
 	ArrayList_Free(server->clients);
 	server->clients = NULL;
+	shadow_encoder_groups_free(server->encoderGroups);
+	server->encoderGroups = NULL;
 	return 1;
 }
 
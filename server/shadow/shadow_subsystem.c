@@ -18,10 +18,16 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/sysinfo.h>
+
+#include <freerdp/log.h>
+
 #include "shadow.h"
 
 #include "shadow_subsystem.h"
 
+#define TAG SERVER_TAG("shadow.subsystem")
+
 static pfnShadowSubsystemEntry pSubsystemEntry = NULL;
 
 void shadow_subsystem_set_entry(pfnShadowSubsystemEntry pEntry)
@@ -166,6 +172,9 @@ int shadow_subsystem_stop(rdpShadowSubsystem* subsystem)
 
 	status = subsystem->ep.Stop(subsystem);
 
+	/* Let the clients finish the last published frame */
+	shadow_multiclient_wait(subsystem->updateEvent);
+
 	return status;
 }
 
@@ -279,5 +288,19 @@ int shadow_subsystem_pointer_convert_alpha_pointer_data(
 
 void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem)
 {
-	shadow_multiclient_publish_and_wait(subsystem->updateEvent);
+	UINT64 start;
+	rdpShadowSurface* surface = subsystem->server ? subsystem->server->surface : NULL;
+
+	/*
+	 * The clients encode from the published copy of the surface, so capturing the
+	 * next frame overlaps with encoding this one. Only the publication itself has
+	 * to wait until every client is done with the previous frame.
+	 */
+	start = GetTickCount64();
+	shadow_multiclient_wait(subsystem->updateEvent);
+
+	if (surface && !shadow_surface_publish(surface, GetTickCount64() - start))
+		WLog_ERR(TAG, "Failed to publish the shadow surface");
+
+	shadow_multiclient_publish(subsystem->updateEvent);
 }
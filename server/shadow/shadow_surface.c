@@ -18,9 +18,19 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/sysinfo.h>
+
+#include <freerdp/log.h>
+
 #include "shadow.h"
 
 #include "shadow_surface.h"
+
+#define TAG SERVER_TAG("shadow")
+
+/* Frames between two timing statistics log entries */
+#define SHADOW_SURFACE_STATS_INTERVAL 300
+
 #define ALIGN_SCREEN_SIZE(size, align) \
 	((((size) % (align)) != 0) ? ((size) + (align) - ((size) % (align))) : (size))
 
@@ -56,6 +66,7 @@ rdpShadowSurface* shadow_surface_new(rdpShadowServer* server, UINT16 x, UINT16 y
 	}
 
 	region16_init(&(surface->invalidRegion));
+	region16_init(&(surface->frameRegion));
 	return surface;
 }
 
@@ -65,8 +76,10 @@ void shadow_surface_free(rdpShadowSurface* surface)
 		return;
 
 	free(surface->data);
+	free(surface->frameData);
 	DeleteCriticalSection(&(surface->lock));
 	region16_uninit(&(surface->invalidRegion));
+	region16_uninit(&(surface->frameRegion));
 	free(surface);
 }
 
@@ -102,3 +115,89 @@ BOOL shadow_surface_resize(rdpShadowSurface* surface, UINT16 x, UINT16 y, UINT32
 
 	return FALSE;
 }
+
+static void shadow_surface_log_stats(const rdpShadowSurface* surface)
+{
+	const SHADOW_SURFACE_STATS* stats = &surface->stats;
+
+	WLog_DBG(TAG,
+	         "%" PRIu64 " frames, per frame: capture %" PRIu64 "ms, stall %" PRIu64
+	         "ms, publish %" PRIu64 "ms, encode %" PRIu64 "ms",
+	         stats->frames, stats->captureMs / stats->frames, stats->stallMs / stats->frames,
+	         stats->publishMs / stats->frames, stats->encodeMs / stats->frames);
+}
+
+BOOL shadow_surface_publish(rdpShadowSurface* surface, UINT64 stallMs)
+{
+	BOOL rc = TRUE;
+	UINT64 start;
+	UINT32 index;
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects;
+
+	WINPR_ASSERT(surface);
+
+	EnterCriticalSection(&(surface->lock));
+	start = GetTickCount64();
+
+	if (!surface->frameData || (surface->frameWidth != surface->width) ||
+	    (surface->frameHeight != surface->height) || (surface->frameScanline != surface->scanline))
+	{
+		/* New or resized surface, copy the whole frame */
+		const size_t size = 1ull * surface->scanline * surface->height;
+		BYTE* buffer = (BYTE*)realloc(surface->frameData, size);
+
+		if (!buffer)
+		{
+			rc = FALSE;
+			goto out;
+		}
+
+		CopyMemory(buffer, surface->data, size);
+		surface->frameData = buffer;
+		surface->frameWidth = surface->width;
+		surface->frameHeight = surface->height;
+		surface->frameScanline = surface->scanline;
+	}
+	else
+	{
+		rects = region16_rects(&(surface->invalidRegion), &numRects);
+
+		for (index = 0; index < numRects; index++)
+		{
+			const RECTANGLE_16* rect = &rects[index];
+
+			if (!freerdp_image_copy(surface->frameData, surface->format, surface->frameScanline,
+			                        rect->left, rect->top, rect->right - rect->left,
+			                        rect->bottom - rect->top, surface->data, surface->format,
+			                        surface->scanline, rect->left, rect->top, NULL,
+			                        FREERDP_FLIP_NONE))
+			{
+				rc = FALSE;
+				goto out;
+			}
+		}
+	}
+
+	if (!region16_copy(&(surface->frameRegion), &(surface->invalidRegion)))
+	{
+		rc = FALSE;
+		goto out;
+	}
+
+	surface->generation++;
+	surface->stats.frames++;
+	surface->stats.stallMs += stallMs;
+	surface->stats.publishMs += GetTickCount64() - start;
+
+	if (surface->lastPublished > 0)
+		surface->stats.captureMs += start - surface->lastPublished - stallMs;
+
+	if ((surface->stats.frames % SHADOW_SURFACE_STATS_INTERVAL) == 0)
+		shadow_surface_log_stats(surface);
+
+out:
+	surface->lastPublished = GetTickCount64();
+	LeaveCriticalSection(&(surface->lock));
+	return rc;
+}
@@ -35,6 +35,12 @@ extern "C"
 	BOOL shadow_surface_resize(rdpShadowSurface* surface, UINT16 x, UINT16 y, UINT32 width,
 	                           UINT32 height);
 
+	/**
+	 * Copies the invalid region of the surface into the published frame and bumps
+	 * the generation. Must only be called while no client encodes from the frame.
+	 */
+	BOOL shadow_surface_publish(rdpShadowSurface* surface, UINT64 stallMs);
+
 #ifdef __cplusplus
 }
 #endif
@@ -234,6 +234,14 @@ extern "C"
 
 #endif /* WINPR_THREAD_POOL */
 
+	/**
+	 * Submits several work objects at once, equivalent to calling
+	 * SubmitThreadpoolWork for each of them but cheaper for large batches.
+	 */
+	WINPR_API VOID winpr_SubmitThreadpoolWorkBatch(PTP_WORK* works, size_t count);
+
+#define SubmitThreadpoolWorkBatch winpr_SubmitThreadpoolWorkBatch
+
 #if !defined(_WIN32)
 #define WINPR_CALLBACK_ENVIRON 1
 #elif defined(_WIN32) && (_WIN32_WINNT < 0x0600)
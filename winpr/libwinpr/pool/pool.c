@@ -22,6 +22,8 @@
 #include <winpr/crt.h>
 #include <winpr/pool.h>
 #include <winpr/library.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
 
 #include "pool.h"
 
@@ -48,105 +50,427 @@ static BOOL CALLBACK init_module(PINIT_ONCE once, PVOID param, PVOID* context)
 }
 #endif
 
-static TP_POOL DEFAULT_POOL = {
-	0,    /* DWORD Minimum */
-	500,  /* DWORD Maximum */
-	NULL, /* wArrayList* Threads */
-	NULL, /* wQueue* PendingQueue */
-	NULL, /* HANDLE TerminateEvent */
-	NULL, /* wCountdownEvent* WorkComplete */
-};
+/* Thread count used when neither a minimum is requested nor more processors are available */
+#define TP_POOL_DEFAULT_THREADS 4
+#define TP_POOL_DEQUE_SIZE 64
+
+static TP_POOL DEFAULT_POOL = { 0 };
+
+static BOOL deque_init(TP_WORK_DEQUE* deque)
+{
+	if (!InitializeCriticalSectionAndSpinCount(&deque->Lock, 4000))
+		return FALSE;
+
+	deque->Capacity = TP_POOL_DEQUE_SIZE;
+	deque->Head = 0;
+	deque->Count = 0;
+
+	if (!(deque->Items = (PTP_WORK*)calloc(deque->Capacity, sizeof(PTP_WORK))))
+	{
+		DeleteCriticalSection(&deque->Lock);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void deque_uninit(TP_WORK_DEQUE* deque)
+{
+	DeleteCriticalSection(&deque->Lock);
+	free(deque->Items);
+	deque->Items = NULL;
+}
+
+/* Called with the deque lock held, linearizes the ring into a larger buffer. */
+static BOOL deque_grow(TP_WORK_DEQUE* deque, size_t required)
+{
+	size_t index;
+	size_t capacity = deque->Capacity;
+	PTP_WORK* items;
+
+	while (capacity < required)
+		capacity *= 2;
+
+	if (!(items = (PTP_WORK*)calloc(capacity, sizeof(PTP_WORK))))
+		return FALSE;
+
+	for (index = 0; index < deque->Count; index++)
+		items[index] = deque->Items[(deque->Head + index) & (deque->Capacity - 1)];
+
+	free(deque->Items);
+	deque->Items = items;
+	deque->Capacity = capacity;
+	deque->Head = 0;
+	return TRUE;
+}
+
+static BOOL deque_push(TP_WORK_DEQUE* deque, PTP_WORK* works, size_t count)
+{
+	BOOL rc = TRUE;
+	size_t index;
+	size_t tail;
+
+	EnterCriticalSection(&deque->Lock);
+
+	if (deque->Count + count > deque->Capacity)
+		rc = deque_grow(deque, deque->Count + count);
+
+	if (rc)
+	{
+		tail = deque->Head + deque->Count;
+
+		for (index = 0; index < count; index++)
+			deque->Items[(tail + index) & (deque->Capacity - 1)] = works[index];
+
+		deque->Count += count;
+	}
+
+	LeaveCriticalSection(&deque->Lock);
+	return rc;
+}
+
+/* The owner takes the most recently pushed item */
+static PTP_WORK deque_pop_tail(TP_WORK_DEQUE* deque)
+{
+	PTP_WORK work = NULL;
+
+	if (deque->Count == 0)
+		return NULL;
+
+	EnterCriticalSection(&deque->Lock);
+
+	if (deque->Count > 0)
+	{
+		deque->Count--;
+		work = deque->Items[(deque->Head + deque->Count) & (deque->Capacity - 1)];
+	}
+
+	LeaveCriticalSection(&deque->Lock);
+	return work;
+}
+
+/* Thieves take the oldest item */
+static PTP_WORK deque_pop_head(TP_WORK_DEQUE* deque)
+{
+	PTP_WORK work = NULL;
+
+	if (deque->Count == 0)
+		return NULL;
+
+	EnterCriticalSection(&deque->Lock);
+
+	if (deque->Count > 0)
+	{
+		work = deque->Items[deque->Head];
+		deque->Head = (deque->Head + 1) & (deque->Capacity - 1);
+		deque->Count--;
+	}
+
+	LeaveCriticalSection(&deque->Lock);
+	return work;
+}
+
+static PTP_WORK thread_pool_find_work(PTP_POOL pool, TP_WORKER* worker)
+{
+	LONG index;
+	const LONG count = pool->WorkerCount;
+	PTP_WORK work = deque_pop_tail(&worker->Deque);
+
+	if (work)
+		return work;
+
+	for (index = 1; index < count; index++)
+	{
+		TP_WORKER* victim = pool->Workers[(worker->Index + index) % count];
+
+		if (victim && (work = deque_pop_head(&victim->Deque)))
+			return work;
+	}
+
+	return NULL;
+}
+
+static void thread_pool_run(PTP_POOL pool, PTP_WORK work)
+{
+	TP_CALLBACK_INSTANCE instance = { 0 };
+
+	instance.Work = work;
+	work->WorkCallback(&instance, work->CallbackParameter, work);
+
+	if (InterlockedDecrement(&pool->Pending) == 0)
+		SetEvent(pool->CompleteEvent);
+}
+
+/* A wakeup not caused by submitted work consumes a retirement request if there is one. */
+static BOOL thread_pool_retire(PTP_POOL pool, TP_WORKER* worker)
+{
+	LONG retiring;
+
+	do
+	{
+		retiring = InterlockedCompareExchange(&pool->Retiring, 0, 0);
+
+		if (retiring <= 0)
+			return FALSE;
+	} while (InterlockedCompareExchange(&pool->Retiring, retiring - 1, retiring) != retiring);
+
+	/* nobody claimed our idle registration, the wakeup was a retirement token */
+	InterlockedDecrement(&pool->Idle);
+	InterlockedDecrement(&pool->ActiveCount);
+	InterlockedExchange(&worker->Retired, TRUE);
+	return TRUE;
+}
 
 static DWORD WINAPI thread_pool_work_func(LPVOID arg)
 {
 	DWORD status;
-	PTP_POOL pool;
 	PTP_WORK work;
 	HANDLE events[2];
-	PTP_CALLBACK_INSTANCE callbackInstance;
-
-	pool = (PTP_POOL)arg;
+	TP_WORKER* worker = (TP_WORKER*)arg;
+	PTP_POOL pool = worker->Pool;
 
 	events[0] = pool->TerminateEvent;
-	events[1] = Queue_Event(pool->PendingQueue);
+	events[1] = pool->WorkSemaphore;
 
 	while (1)
 	{
+		if ((work = thread_pool_find_work(pool, worker)))
+		{
+			thread_pool_run(pool, work);
+			continue;
+		}
+
+		/**
+		 * Announce that we are about to sleep and look once more,
+		 * a submitter either sees the registration or we see its work.
+		 */
+		InterlockedIncrement(&pool->Idle);
+
+		if ((work = thread_pool_find_work(pool, worker)))
+		{
+			InterlockedDecrement(&pool->Idle);
+			thread_pool_run(pool, work);
+			continue;
+		}
+
 		status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
 
-		if (status == WAIT_OBJECT_0)
+		if (status != (WAIT_OBJECT_0 + 1))
 			break;
 
-		if (status != (WAIT_OBJECT_0 + 1))
+		if (thread_pool_retire(pool, worker))
 			break;
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+static void thread_pool_wake(PTP_POOL pool, size_t count)
+{
+	LONG idle;
+	LONG wake;
+
+	do
+	{
+		idle = InterlockedCompareExchange(&pool->Idle, 0, 0);
 
-		callbackInstance = (PTP_CALLBACK_INSTANCE)Queue_Dequeue(pool->PendingQueue);
+		if (idle <= 0)
+			return;
 
-		if (callbackInstance)
+		wake = (count < (size_t)idle) ? (LONG)count : idle;
+	} while (InterlockedCompareExchange(&pool->Idle, idle - wake, idle) != idle);
+
+	ReleaseSemaphore(pool->WorkSemaphore, wake, NULL);
+}
+
+/* Called with the pool lock held */
+static BOOL thread_pool_start_worker(PTP_POOL pool)
+{
+	LONG index;
+	TP_WORKER* worker = NULL;
+
+	/* reuse the slot of a worker that retired, its deque may still hold work */
+	for (index = 0; index < pool->WorkerCount; index++)
+	{
+		TP_WORKER* cur = pool->Workers[index];
+
+		if (cur->Retired && (WaitForSingleObject(cur->Thread, 0) == WAIT_OBJECT_0))
 		{
-			work = callbackInstance->Work;
-			work->WorkCallback(callbackInstance, work->CallbackParameter, work);
-			CountdownEvent_Signal(pool->WorkComplete, 1);
-			free(callbackInstance);
+			CloseHandle(cur->Thread);
+			cur->Thread = NULL;
+			worker = cur;
+			break;
 		}
 	}
 
-	ExitThread(0);
-	return 0;
+	if (!worker)
+	{
+		if (pool->WorkerCount >= TP_POOL_MAX_WORKERS)
+			return FALSE;
+
+		if (!(worker = (TP_WORKER*)calloc(1, sizeof(TP_WORKER))))
+			return FALSE;
+
+		if (!deque_init(&worker->Deque))
+		{
+			free(worker);
+			return FALSE;
+		}
+
+		worker->Pool = pool;
+		worker->Index = (DWORD)pool->WorkerCount;
+		pool->Workers[pool->WorkerCount] = worker;
+		InterlockedIncrement(&pool->WorkerCount);
+	}
+
+	worker->Retired = FALSE;
+
+	if (!(worker->Thread = CreateThread(NULL, 0, thread_pool_work_func, (void*)worker, 0, NULL)))
+	{
+		worker->Retired = TRUE;
+		return FALSE;
+	}
+
+	InterlockedIncrement(&pool->ActiveCount);
+	return TRUE;
 }
 
-static void threads_close(void* thread)
+/* Called with the pool lock held */
+static BOOL thread_pool_resize(PTP_POOL pool)
 {
-	WaitForSingleObject(thread, INFINITE);
-	CloseHandle(thread);
+	LONG excess;
+
+	while ((DWORD)pool->ActiveCount < pool->Minimum)
+	{
+		if (!thread_pool_start_worker(pool))
+			return FALSE;
+	}
+
+	excess = pool->ActiveCount - pool->Retiring - (LONG)pool->Maximum;
+
+	if (excess > 0)
+	{
+		InterlockedExchangeAdd(&pool->Retiring, excess);
+		ReleaseSemaphore(pool->WorkSemaphore, excess, NULL);
+	}
+
+	return TRUE;
 }
 
 static BOOL InitializeThreadpool(PTP_POOL pool)
 {
-	BOOL rc = FALSE;
-	int index;
-	wObject* obj;
-	HANDLE thread;
+	SYSTEM_INFO sysinfo = { 0 };
+	DWORD index;
+	DWORD count;
 
-	if (pool->Threads)
+	if (pool->TerminateEvent)
 		return TRUE;
 
 	pool->Minimum = 0;
 	pool->Maximum = 500;
 
-	if (!(pool->PendingQueue = Queue_New(TRUE, -1, -1)))
-		goto fail;
-
-	if (!(pool->WorkComplete = CountdownEvent_New(0)))
-		goto fail;
+	if (!InitializeCriticalSectionAndSpinCount(&pool->Lock, 4000))
+		return FALSE;
 
 	if (!(pool->TerminateEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
-		goto fail;
+		return FALSE;
+
+	if (!(pool->WorkSemaphore = CreateSemaphore(NULL, 0, INT32_MAX, NULL)))
+		return FALSE;
+
+	if (!(pool->CompleteEvent = CreateEvent(NULL, TRUE, TRUE, NULL)))
+		return FALSE;
 
-	if (!(pool->Threads = ArrayList_New(TRUE)))
-		goto fail;
+	GetNativeSystemInfo(&sysinfo);
+	count = sysinfo.dwNumberOfProcessors;
 
-	obj = ArrayList_Object(pool->Threads);
-	obj->fnObjectFree = threads_close;
+	if (count < TP_POOL_DEFAULT_THREADS)
+		count = TP_POOL_DEFAULT_THREADS;
 
-	for (index = 0; index < 4; index++)
+	if (count > pool->Maximum)
+		count = pool->Maximum;
+
+	EnterCriticalSection(&pool->Lock);
+
+	for (index = 0; index < count; index++)
 	{
-		if (!(thread = CreateThread(NULL, 0, thread_pool_work_func, (void*)pool, 0, NULL)))
+		if (!thread_pool_start_worker(pool))
 		{
-			goto fail;
+			LeaveCriticalSection(&pool->Lock);
+			return FALSE;
 		}
+	}
+
+	LeaveCriticalSection(&pool->Lock);
+	return TRUE;
+}
+
+BOOL ThreadpoolSubmitWork(PTP_POOL pool, PTP_WORK* works, size_t count)
+{
+	size_t offset = 0;
+	LONG active;
+	ULONG start;
+	LONG index;
+
+	if (count == 0)
+		return TRUE;
+
+	InterlockedExchangeAdd(&pool->Pending, (LONG)count);
+
+	/**
+	 * Spread the items in contiguous chunks over the workers so a batch costs
+	 * one lock per worker, thieves rebalance whatever ends up uneven.
+	 */
+	active = pool->WorkerCount;
+	start = (ULONG)InterlockedIncrement(&pool->NextWorker);
+
+	for (index = 0; (index < active) && (offset < count); index++)
+	{
+		TP_WORKER* worker = pool->Workers[(start + (ULONG)index) % (ULONG)active];
+		const size_t left = (size_t)(active - index);
+		const size_t chunk = (count - offset + left - 1) / left;
+
+		if (worker->Retired && (index + 1 < active))
+			continue;
 
-		if (!ArrayList_Append(pool->Threads, thread))
+		if (!deque_push(&worker->Deque, &works[offset], chunk))
 		{
-			CloseHandle(thread);
-			goto fail;
+			const LONG dropped = (LONG)(count - offset);
+
+			if (InterlockedExchangeAdd(&pool->Pending, -dropped) == dropped)
+				SetEvent(pool->CompleteEvent);
+
+			thread_pool_wake(pool, offset);
+			return FALSE;
 		}
+
+		offset += chunk;
 	}
 
-	rc = TRUE;
+	thread_pool_wake(pool, count);
+	return TRUE;
+}
 
-fail:
-	return rc;
+VOID ThreadpoolWaitForWork(PTP_POOL pool)
+{
+	while (InterlockedCompareExchange(&pool->Pending, 0, 0) > 0)
+	{
+		/**
+		 * Completions set the event on the transition to zero,
+		 * reset it here and check again so a completion racing
+		 * with the reset is never lost.
+		 */
+		ResetEvent(pool->CompleteEvent);
+
+		if (InterlockedCompareExchange(&pool->Pending, 0, 0) == 0)
+		{
+			SetEvent(pool->CompleteEvent);
+			break;
+		}
+
+		WaitForSingleObject(pool->CompleteEvent, INFINITE);
+	}
 }
 
 PTP_POOL GetDefaultThreadpool(void)
@@ -185,6 +509,7 @@ PTP_POOL winpr_CreateThreadpool(PVOID reserved)
 
 VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 {
+	LONG index;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 	if (pCloseThreadpool)
@@ -195,9 +520,29 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 #endif
 	SetEvent(ptpp->TerminateEvent);
 
-	ArrayList_Free(ptpp->Threads);
-	Queue_Free(ptpp->PendingQueue);
-	CountdownEvent_Free(ptpp->WorkComplete);
+	/* thieves look at every deque, join all threads before freeing any */
+	for (index = 0; index < ptpp->WorkerCount; index++)
+	{
+		TP_WORKER* worker = ptpp->Workers[index];
+
+		if (worker->Thread)
+		{
+			WaitForSingleObject(worker->Thread, INFINITE);
+			CloseHandle(worker->Thread);
+		}
+	}
+
+	for (index = 0; index < ptpp->WorkerCount; index++)
+	{
+		deque_uninit(&ptpp->Workers[index]->Deque);
+		free(ptpp->Workers[index]);
+	}
+
+	if (ptpp->TerminateEvent)
+		DeleteCriticalSection(&ptpp->Lock);
+
+	CloseHandle(ptpp->WorkSemaphore);
+	CloseHandle(ptpp->CompleteEvent);
 	CloseHandle(ptpp->TerminateEvent);
 
 	{
@@ -211,29 +556,21 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 
 BOOL winpr_SetThreadpoolThreadMinimum(PTP_POOL ptpp, DWORD cthrdMic)
 {
-	HANDLE thread;
+	BOOL rc;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 	if (pSetThreadpoolThreadMinimum)
 		return pSetThreadpoolThreadMinimum(ptpp, cthrdMic);
 #endif
+	EnterCriticalSection(&ptpp->Lock);
 	ptpp->Minimum = cthrdMic;
 
-	while (ArrayList_Count(ptpp->Threads) < (INT64)ptpp->Minimum)
-	{
-		if (!(thread = CreateThread(NULL, 0, thread_pool_work_func, (void*)ptpp, 0, NULL)))
-		{
-			return FALSE;
-		}
+	if (ptpp->Maximum < ptpp->Minimum)
+		ptpp->Maximum = ptpp->Minimum;
 
-		if (!ArrayList_Append(ptpp->Threads, thread))
-		{
-			CloseHandle(thread);
-			return FALSE;
-		}
-	}
-
-	return TRUE;
+	rc = thread_pool_resize(ptpp);
+	LeaveCriticalSection(&ptpp->Lock);
+	return rc;
 }
 
 VOID winpr_SetThreadpoolThreadMaximum(PTP_POOL ptpp, DWORD cthrdMost)
@@ -246,7 +583,21 @@ VOID winpr_SetThreadpoolThreadMaximum(PTP_POOL ptpp, DWORD cthrdMost)
 		return;
 	}
 #endif
+	/* a pool without threads would never run anything */
+	if (cthrdMost < 1)
+		cthrdMost = 1;
+
+	if (cthrdMost > TP_POOL_MAX_WORKERS)
+		cthrdMost = TP_POOL_MAX_WORKERS;
+
+	EnterCriticalSection(&ptpp->Lock);
 	ptpp->Maximum = cthrdMost;
+
+	if (ptpp->Minimum > ptpp->Maximum)
+		ptpp->Minimum = ptpp->Maximum;
+
+	thread_pool_resize(ptpp);
+	LeaveCriticalSection(&ptpp->Lock);
 }
 
 #endif /* WINPR_THREAD_POOL defined */
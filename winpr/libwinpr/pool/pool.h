@@ -26,6 +26,32 @@
 #include <winpr/thread.h>
 #include <winpr/collections.h>
 
+/* Upper bound on the worker slots of a pool, thieves scan the slots without locking. */
+#define TP_POOL_MAX_WORKERS 512
+
+/**
+ * Double ended queue owned by a single worker.
+ * The owner pushes and pops at the tail (most recently submitted first),
+ * idle workers steal from the head (oldest first).
+ */
+typedef struct
+{
+	CRITICAL_SECTION Lock;
+	PTP_WORK* Items;
+	size_t Capacity; /* always a power of two */
+	size_t Head;
+	volatile size_t Count;
+} TP_WORK_DEQUE;
+
+typedef struct
+{
+	PTP_POOL Pool;
+	DWORD Index;
+	HANDLE Thread;
+	volatile LONG Retired;
+	TP_WORK_DEQUE Deque;
+} TP_WORKER;
+
 #if defined(_WIN32)
 #if (_WIN32_WINNT < _WIN32_WINNT_WIN6) || defined(__MINGW32__)
 struct _TP_CALLBACK_INSTANCE
@@ -37,10 +63,17 @@ struct _TP_POOL
 {
 	DWORD Minimum;
 	DWORD Maximum;
-	wArrayList* Threads;
-	wQueue* PendingQueue;
+	CRITICAL_SECTION Lock;
+	TP_WORKER* Workers[TP_POOL_MAX_WORKERS];
+	volatile LONG WorkerCount;
+	volatile LONG ActiveCount;
+	volatile LONG NextWorker;
+	volatile LONG Idle;
+	volatile LONG Retiring;
+	volatile LONG Pending;
+	HANDLE WorkSemaphore;
 	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	HANDLE CompleteEvent;
 };
 
 struct _TP_WORK
@@ -81,10 +114,17 @@ struct S_TP_POOL
 {
 	DWORD Minimum;
 	DWORD Maximum;
-	wArrayList* Threads;
-	wQueue* PendingQueue;
+	CRITICAL_SECTION Lock;
+	TP_WORKER* Workers[TP_POOL_MAX_WORKERS];
+	volatile LONG WorkerCount;
+	volatile LONG ActiveCount;
+	volatile LONG NextWorker;
+	volatile LONG Idle;
+	volatile LONG Retiring;
+	volatile LONG Pending;
+	HANDLE WorkSemaphore;
 	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	HANDLE CompleteEvent;
 };
 
 struct S_TP_WORK
@@ -118,5 +158,7 @@ struct S_TP_CLEANUP_GROUP
 #endif
 
 PTP_POOL GetDefaultThreadpool(void);
+BOOL ThreadpoolSubmitWork(PTP_POOL pool, PTP_WORK* works, size_t count);
+VOID ThreadpoolWaitForWork(PTP_POOL pool);
 
 #endif /* WINPR_POOL_PRIVATE_H */
@@ -123,6 +123,118 @@ fail:
 	return rc;
 }
 
+#define TEST_BATCH_SIZE 2048
+
+static LONG batchCount = 0;
+
+static void CALLBACK test_BatchCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                        PTP_WORK work)
+{
+	LONG* hits = (LONG*)context;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	InterlockedIncrement(hits);
+	InterlockedIncrement(&batchCount);
+}
+
+static BOOL test3_round(PTP_WORK* works, LONG* hits, LONG expected)
+{
+	size_t index;
+
+	batchCount = 0;
+	SubmitThreadpoolWorkBatch(works, TEST_BATCH_SIZE);
+	WaitForThreadpoolWorkCallbacks(works[0], FALSE);
+
+	if (batchCount != TEST_BATCH_SIZE)
+	{
+		printf("batch ran %" PRId32 " of %d callbacks\n", batchCount, TEST_BATCH_SIZE);
+		return FALSE;
+	}
+
+	for (index = 0; index < TEST_BATCH_SIZE; index++)
+	{
+		if (hits[index] != expected)
+		{
+			printf("work %" PRIuz " ran %" PRId32 " times, expected %" PRId32 "\n", index,
+			       hits[index], expected);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test3(void)
+{
+	BOOL rc = FALSE;
+	size_t index;
+	PTP_POOL pool;
+	TP_CALLBACK_ENVIRON environment;
+	PTP_WORK* works = NULL;
+	LONG* hits = NULL;
+	printf("Batch submission\n");
+
+	if (!(pool = CreateThreadpool(NULL)))
+	{
+		printf("CreateThreadpool failure\n");
+		return FALSE;
+	}
+
+	InitializeThreadpoolEnvironment(&environment);
+	SetThreadpoolCallbackPool(&environment, pool);
+	works = (PTP_WORK*)calloc(TEST_BATCH_SIZE, sizeof(PTP_WORK));
+	hits = (LONG*)calloc(TEST_BATCH_SIZE, sizeof(LONG));
+
+	if (!works || !hits)
+		goto fail;
+
+	for (index = 0; index < TEST_BATCH_SIZE; index++)
+	{
+		if (!(works[index] = CreateThreadpoolWork(test_BatchCallback, &hits[index], &environment)))
+		{
+			printf("CreateThreadpoolWork failure\n");
+			goto fail;
+		}
+	}
+
+	if (!test3_round(works, hits, 1))
+		goto fail;
+
+	/* shrink the pool, the retiring threads must not lose queued work */
+	SetThreadpoolThreadMaximum(pool, 2);
+
+	if (!test3_round(works, hits, 2))
+		goto fail;
+
+	/* and grow it again */
+	if (!SetThreadpoolThreadMinimum(pool, 16))
+	{
+		printf("SetThreadpoolThreadMinimum failure\n");
+		goto fail;
+	}
+
+	if (!test3_round(works, hits, 3))
+		goto fail;
+
+	rc = TRUE;
+fail:
+
+	if (works)
+	{
+		for (index = 0; index < TEST_BATCH_SIZE; index++)
+		{
+			if (works[index])
+				CloseThreadpoolWork(works[index]);
+		}
+	}
+
+	free(works);
+	free(hits);
+	DestroyThreadpoolEnvironment(&environment);
+	CloseThreadpool(pool);
+	return rc;
+}
+
 int TestPoolWork(int argc, char* argv[])
 {
 
@@ -135,5 +247,8 @@ int TestPoolWork(int argc, char* argv[])
 	if (!test2())
 		return -1;
 
+	if (!test3())
+		return -1;
+
 	return 0;
 }
@@ -124,8 +124,6 @@ VOID winpr_CloseThreadpoolWork(PTP_WORK pwk)
 
 VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 {
-	PTP_POOL pool;
-	PTP_CALLBACK_INSTANCE callbackInstance;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 
@@ -136,14 +134,39 @@ VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 	}
 
 #endif
-	pool = pwk->CallbackEnvironment->Pool;
-	callbackInstance = (PTP_CALLBACK_INSTANCE)calloc(1, sizeof(TP_CALLBACK_INSTANCE));
+	if (!ThreadpoolSubmitWork(pwk->CallbackEnvironment->Pool, &pwk, 1))
+		WLog_ERR(TAG, "failed to submit work");
+}
+
+VOID winpr_SubmitThreadpoolWorkBatch(PTP_WORK* works, size_t count)
+{
+	size_t first = 0;
+	size_t index;
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 
-	if (callbackInstance)
+	if (pSubmitThreadpoolWork)
 	{
-		callbackInstance->Work = pwk;
-		CountdownEvent_AddCount(pool->WorkComplete, 1);
-		Queue_Enqueue(pool->PendingQueue, callbackInstance);
+		for (index = 0; index < count; index++)
+			pSubmitThreadpoolWork(works[index]);
+
+		return;
+	}
+
+#endif
+
+	/* hand over each run of works sharing a pool in one go */
+	for (index = 1; index <= count; index++)
+	{
+		PTP_POOL pool = works[first]->CallbackEnvironment->Pool;
+
+		if ((index < count) && (works[index]->CallbackEnvironment->Pool == pool))
+			continue;
+
+		if (!ThreadpoolSubmitWork(pool, &works[first], index - first))
+			WLog_ERR(TAG, "failed to submit %" PRIuz " work items", index - first);
+
+		first = index;
 	}
 }
 
@@ -163,8 +186,6 @@ BOOL winpr_TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK pfns, PVOID pv,
 
 VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk, BOOL fCancelPendingCallbacks)
 {
-	HANDLE event;
-	PTP_POOL pool;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 
@@ -175,11 +196,18 @@ VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk, BOOL fCancelPendingCallb
 	}
 
 #endif
-	pool = pwk->CallbackEnvironment->Pool;
-	event = CountdownEvent_WaitHandle(pool->WorkComplete);
+	WINPR_UNUSED(fCancelPendingCallbacks);
+	ThreadpoolWaitForWork(pwk->CallbackEnvironment->Pool);
+}
+
+#else
+
+VOID winpr_SubmitThreadpoolWorkBatch(PTP_WORK* works, size_t count)
+{
+	size_t index;
 
-	if (WaitForSingleObject(event, INFINITE) != WAIT_OBJECT_0)
-		WLog_ERR(TAG, "error waiting on work completion");
+	for (index = 0; index < count; index++)
+		SubmitThreadpoolWork(works[index]);
 }
 
 #endif /* WINPR_THREAD_POOL defined */